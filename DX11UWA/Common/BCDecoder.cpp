@@ -0,0 +1,835 @@
+﻿#include "BCDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Texels are converted between RGBA8 and float, and BC7 palettes built, a register at a time: AVX2
+// where the compiler targets it, SSE2 on any x86 or x64, scalar elsewhere. AVX2 builds use the SSE2
+// paths for everything AVX2 does not widen.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BC_DECODER_AVX2
+#define BC_DECODER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_DECODER_SSE2
+#endif
+
+// BC6H halves become floats four at a time where F16C can be assumed; MSVC has no macro for it,
+// but every AVX2 CPU has it.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define BC_DECODER_F16C
+#endif
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t kBlockTexels = 16;
+	const float kInv255 = 1.0f / 255.0f;
+
+	// Where each index sits between the two endpoints, in 64ths, for 2, 3 and 4 bit indices.
+	const int kWeights2[4] = { 0, 21, 43, 64 };
+	const int kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	const int* const kWeights[3] = { kWeights2, kWeights3, kWeights4 };
+
+	// The 64 two subset partitions of BC7, which BC6H shares the first 32 of: bit t is set when
+	// texel t is in subset 1.
+	const uint16_t kPartitions2[64] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+	};
+
+	// The 64 three subset partitions of BC7: bits 2t and 2t + 1 hold the subset of texel t.
+	const uint32_t kPartitions3[64] =
+	{
+		0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+		0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+		0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+		0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+		0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+		0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+		0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+		0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+	};
+
+	// The texel of each subset after the first whose index is stored a bit short, its top bit
+	// being clear; texel 0 is the first subset's.
+	const uint8_t kAnchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+	const uint8_t kAnchors3Second[64] =
+	{
+		3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+		3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+		8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+		3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+	};
+	const uint8_t kAnchors3Third[64] =
+	{
+		15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+		15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+		15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+		15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+	};
+
+	// The fields of a BC7 mode, in the order they are stored; a mode's number is the count of zero
+	// bits below the first set bit of the block.
+	struct BC7Mode
+	{
+		uint8_t	subsets;
+		uint8_t	partitionBits;
+		uint8_t	rotationBits;
+		uint8_t	indexSelectionBits;
+		uint8_t	colorBits;
+		uint8_t	alphaBits;			// 0 for opaque modes
+		uint8_t	endpointPBits;		// a low bit for every endpoint
+		uint8_t	sharedPBits;		// a low bit for both endpoints of a subset
+		uint8_t	indexBits;
+		uint8_t	secondaryIndexBits;	// 0, or the bits of the separate alpha or colour indices
+	};
+
+	const BC7Mode kBC7Modes[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	// What a run of BC6H header bits holds: endpoint w, x, y or z of red, green or blue, named
+	// as the format's documentation does, at field & 3 and field >> 2, or the partition.
+	enum BC6HField
+	{
+		RW, RX, RY, RZ,
+		GW, GX, GY, GZ,
+		BW, BX, BY, BZ,
+		PARTITION,
+		END
+	};
+
+	// Bits first to last of a field, read in that order; a few modes store bits high to low.
+	struct BC6HRun
+	{
+		uint8_t	field;
+		uint8_t	first;
+		uint8_t	last;
+	};
+
+	struct BC6HMode
+	{
+		uint8_t	value;			// of the 2 mode bits, or 5 when the low 2 are both set
+		bool	partitioned;
+		bool	transformed;	// endpoints after the first are stored as signed deltas from it
+		uint8_t	endpointBits;
+		uint8_t	deltaBits[3];
+		BC6HRun	runs[25];
+	};
+
+	const BC6HMode kBC6HModes[14] =
+	{
+		{ 0, true, true, 10, { 5, 5, 5 }, {
+			{ GY, 4, 4 }, { BY, 4, 4 }, { BZ, 4, 4 }, { RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { GZ, 4, 4 },
+			{ GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 },
+			{ BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 1, true, true, 7, { 6, 6, 6 }, {
+			{ GY, 5, 5 }, { GZ, 4, 4 }, { GZ, 5, 5 }, { RW, 0, 6 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 6 },
+			{ BY, 5, 5 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 6 }, { BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 5 },
+			{ GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { PARTITION, 0, 4 },
+			{ END, 0, 0 } } },
+		{ 2, true, true, 11, { 5, 4, 4 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 4 }, { RW, 10, 10 }, { GY, 0, 3 }, { GX, 0, 3 }, { GW, 10, 10 },
+			{ BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 },
+			{ RZ, 0, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 6, true, true, 11, { 4, 5, 4 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 },
+			{ GW, 10, 10 }, { GZ, 0, 3 }, { BX, 0, 3 }, { BW, 10, 10 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 3 }, { BZ, 0, 0 },
+			{ BZ, 2, 2 }, { RZ, 0, 3 }, { GY, 4, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 10, true, true, 11, { 4, 4, 5 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 10, 10 }, { BY, 4, 4 }, { GY, 0, 3 }, { GX, 0, 3 },
+			{ GW, 10, 10 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BW, 10, 10 }, { BY, 0, 3 }, { RY, 0, 3 }, { BZ, 1, 1 },
+			{ BZ, 2, 2 }, { RZ, 0, 3 }, { BZ, 4, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 14, true, true, 9, { 5, 5, 5 }, {
+			{ RW, 0, 8 }, { BY, 4, 4 }, { GW, 0, 8 }, { GY, 4, 4 }, { BW, 0, 8 }, { BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 },
+			{ GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 }, { BY, 0, 3 }, { RY, 0, 4 },
+			{ BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 18, true, true, 8, { 6, 5, 5 }, {
+			{ RW, 0, 7 }, { GZ, 4, 4 }, { BY, 4, 4 }, { GW, 0, 7 }, { BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 7 }, { BZ, 3, 3 },
+			{ BZ, 4, 4 }, { RX, 0, 5 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+			{ BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 22, true, true, 8, { 5, 6, 5 }, {
+			{ RW, 0, 7 }, { BZ, 0, 0 }, { BY, 4, 4 }, { GW, 0, 7 }, { GY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 }, { GZ, 5, 5 },
+			{ BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 4 }, { BZ, 1, 1 },
+			{ BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 26, true, true, 8, { 5, 5, 6 }, {
+			{ RW, 0, 7 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 7 }, { BY, 5, 5 }, { GY, 4, 4 }, { BW, 0, 7 }, { BZ, 5, 5 },
+			{ BZ, 4, 4 }, { RX, 0, 4 }, { GZ, 4, 4 }, { GY, 0, 3 }, { GX, 0, 4 }, { BZ, 0, 0 }, { GZ, 0, 3 }, { BX, 0, 5 },
+			{ BY, 0, 3 }, { RY, 0, 4 }, { BZ, 2, 2 }, { RZ, 0, 4 }, { BZ, 3, 3 }, { PARTITION, 0, 4 }, { END, 0, 0 } } },
+		{ 30, true, false, 6, { 6, 6, 6 }, {
+			{ RW, 0, 5 }, { GZ, 4, 4 }, { BZ, 0, 0 }, { BZ, 1, 1 }, { BY, 4, 4 }, { GW, 0, 5 }, { GY, 5, 5 }, { BY, 5, 5 },
+			{ BZ, 2, 2 }, { GY, 4, 4 }, { BW, 0, 5 }, { GZ, 5, 5 }, { BZ, 3, 3 }, { BZ, 5, 5 }, { BZ, 4, 4 }, { RX, 0, 5 },
+			{ GY, 0, 3 }, { GX, 0, 5 }, { GZ, 0, 3 }, { BX, 0, 5 }, { BY, 0, 3 }, { RY, 0, 5 }, { RZ, 0, 5 }, { PARTITION, 0, 4 },
+			{ END, 0, 0 } } },
+		{ 3, false, false, 10, { 10, 10, 10 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 9 }, { GX, 0, 9 }, { BX, 0, 9 }, { END, 0, 0 } } },
+		{ 7, false, true, 11, { 9, 9, 9 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 8 }, { RW, 10, 10 }, { GX, 0, 8 }, { GW, 10, 10 }, { BX, 0, 8 },
+			{ BW, 10, 10 }, { END, 0, 0 } } },
+		{ 11, false, true, 12, { 8, 8, 8 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 7 }, { RW, 11, 10 }, { GX, 0, 7 }, { GW, 11, 10 }, { BX, 0, 7 },
+			{ BW, 11, 10 }, { END, 0, 0 } } },
+		{ 15, false, true, 16, { 4, 4, 4 }, {
+			{ RW, 0, 9 }, { GW, 0, 9 }, { BW, 0, 9 }, { RX, 0, 3 }, { RW, 15, 10 }, { GX, 0, 3 }, { GW, 15, 10 }, { BX, 0, 3 },
+			{ BW, 15, 10 }, { END, 0, 0 } } }
+	};
+
+	// Reads the bits of a block from bit 0 up, held as two 64 bit words.
+	class BlockReader
+	{
+	public:
+		explicit BlockReader(const uint8_t* block) :
+			m_low(0),
+			m_high(0),
+			m_position(0)
+		{
+			for (int i = 7; i >= 0; --i)
+			{
+				m_low = (m_low << 8) | block[i];
+				m_high = (m_high << 8) | block[8 + i];
+			}
+		}
+
+		// Up to 32 bits.
+		uint32_t Read(uint32_t bitCount)
+		{
+			uint64_t bits;
+			if (m_position >= 64)
+				bits = m_high >> (m_position - 64);
+			else if (m_position == 0)
+				bits = m_low;
+			else
+				bits = (m_low >> m_position) | (m_high << (64 - m_position));
+			m_position += bitCount;
+			return static_cast<uint32_t>(bits & ((1ull << bitCount) - 1));
+		}
+
+	private:
+		uint64_t	m_low;
+		uint64_t	m_high;
+		uint32_t	m_position;
+	};
+
+	int SignExtend(int value, uint32_t bitCount)
+	{
+		const int sign = 1 << (bitCount - 1);
+		return ((value & ((sign << 1) - 1)) ^ sign) - sign;
+	}
+
+	int Expand(int value, uint32_t bitCount)
+	{
+		return (value << (8 - bitCount)) | (value >> (2 * bitCount - 8));
+	}
+
+	// The colours of a BC1 block in index order, rounded; the fourth is transparent black in
+	// three colour blocks, which BC2 and BC3 never are.
+	void GetColorPalette(const uint8_t* block, bool forceFourColors, uint8_t (*outColors)[4])
+	{
+		const uint32_t color0 = block[0] | (block[1] << 8);
+		const uint32_t color1 = block[2] | (block[3] << 8);
+		const int c0[3] = { Expand(color0 >> 11, 5), Expand((color0 >> 5) & 63, 6), Expand(color0 & 31, 5) };
+		const int c1[3] = { Expand(color1 >> 11, 5), Expand((color1 >> 5) & 63, 6), Expand(color1 & 31, 5) };
+		const bool fourColors = forceFourColors || color0 > color1;
+		for (int c = 0; c < 3; ++c)
+		{
+			outColors[0][c] = static_cast<uint8_t>(c0[c]);
+			outColors[1][c] = static_cast<uint8_t>(c1[c]);
+			outColors[2][c] = static_cast<uint8_t>(fourColors ? (2 * c0[c] + c1[c] + 1) / 3 : (c0[c] + c1[c] + 1) / 2);
+			outColors[3][c] = static_cast<uint8_t>(fourColors ? (c0[c] + 2 * c1[c] + 1) / 3 : 0);
+		}
+		outColors[0][3] = outColors[1][3] = outColors[2][3] = 255;
+		outColors[3][3] = fourColors ? 255 : 0;
+	}
+
+	void DecodeColorBlock(const uint8_t* block, bool forceFourColors, uint8_t* outRgba)
+	{
+		uint8_t colors[4][4];
+		GetColorPalette(block, forceFourColors, colors);
+		const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+			memcpy(outRgba + t * 4, colors[(indices >> (t * 2)) & 3], 4);
+	}
+
+	// BC2 alpha: 4 bits a texel.
+	void DecodeExplicitAlpha(const uint8_t* block, uint8_t* outRgba)
+	{
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+			outRgba[t * 4 + 3] = static_cast<uint8_t>(((block[t / 2] >> ((t & 1) * 4)) & 15) * 17);
+	}
+
+	// The eight values of a BC3 alpha or BC4 channel block in index order, in 255ths, or in
+	// 127ths when signed, where -128 reads as -127.
+	void GetChannelPalette(const uint8_t* block, bool isSigned, float* outValues)
+	{
+		const int value0 = isSigned ? std::max<int>(static_cast<int8_t>(block[0]), -127) : block[0];
+		const int value1 = isSigned ? std::max<int>(static_cast<int8_t>(block[1]), -127) : block[1];
+		outValues[0] = static_cast<float>(value0);
+		outValues[1] = static_cast<float>(value1);
+		if (value0 > value1)
+		{
+			for (int i = 1; i < 7; ++i)
+				outValues[i + 1] = ((7 - i) * value0 + i * value1) / 7.0f;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				outValues[i + 1] = ((5 - i) * value0 + i * value1) / 5.0f;
+			outValues[6] = isSigned ? -127.0f : 0.0f;
+			outValues[7] = isSigned ? 127.0f : 255.0f;
+		}
+	}
+
+	uint64_t GetChannelIndices(const uint8_t* block)
+	{
+		uint64_t indices = 0;
+		for (int i = 5; i >= 0; --i)
+			indices = (indices << 8) | block[2 + i];
+		return indices;
+	}
+
+	// BC3 alpha, rounded to the nearest 8 bit value.
+	void DecodeInterpolatedAlpha(const uint8_t* block, uint8_t* outRgba)
+	{
+		float values[8];
+		GetChannelPalette(block, false, values);
+		uint8_t alphas[8];
+		for (int i = 0; i < 8; ++i)
+			alphas[i] = static_cast<uint8_t>(values[i] + 0.5f);
+		const uint64_t indices = GetChannelIndices(block);
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+			outRgba[t * 4 + 3] = alphas[(indices >> (t * 3)) & 7];
+	}
+
+	// One channel of BC4 or BC5 into channel of the float texels.
+	void DecodeChannel(const uint8_t* block, bool isSigned, uint32_t channel, float* outRgba)
+	{
+		float values[8];
+		GetChannelPalette(block, isSigned, values);
+		const float scale = isSigned ? 1.0f / 127.0f : kInv255;
+		for (int i = 0; i < 8; ++i)
+			values[i] *= scale;
+		const uint64_t indices = GetChannelIndices(block);
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+			outRgba[t * 4 + channel] = values[(indices >> (t * 3)) & 7];
+	}
+
+	// Entries of the line between two RGBA8 endpoints for indices of indexBits bits.
+	void GetBC7Palette(const int* endpoint0, const int* endpoint1, uint32_t indexBits, uint8_t (*outEntries)[4])
+	{
+		const int* weights = kWeights[indexBits - 2];
+		const uint32_t count = 1u << indexBits;
+#if defined(BC_DECODER_SSE2)
+		// Two entries a register, as eight 16 bit lanes
+		const __m128i start = _mm_setr_epi16(static_cast<short>(endpoint0[0]), static_cast<short>(endpoint0[1]), static_cast<short>(endpoint0[2]),
+			static_cast<short>(endpoint0[3]), static_cast<short>(endpoint0[0]), static_cast<short>(endpoint0[1]), static_cast<short>(endpoint0[2]),
+			static_cast<short>(endpoint0[3]));
+		const __m128i end = _mm_setr_epi16(static_cast<short>(endpoint1[0]), static_cast<short>(endpoint1[1]), static_cast<short>(endpoint1[2]),
+			static_cast<short>(endpoint1[3]), static_cast<short>(endpoint1[0]), static_cast<short>(endpoint1[1]), static_cast<short>(endpoint1[2]),
+			static_cast<short>(endpoint1[3]));
+		const __m128i full = _mm_set1_epi16(64);
+		const __m128i rounding = _mm_set1_epi16(32);
+		for (uint32_t i = 0; i < count; i += 2)
+		{
+			const __m128i weight = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(weights[i])), _mm_set1_epi16(static_cast<short>(weights[i + 1])));
+			__m128i value = _mm_add_epi16(_mm_mullo_epi16(start, _mm_sub_epi16(full, weight)), _mm_mullo_epi16(end, weight));
+			value = _mm_srli_epi16(_mm_add_epi16(value, rounding), 6);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(outEntries[i]), _mm_packus_epi16(value, value));
+		}
+#else
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				outEntries[i][c] = static_cast<uint8_t>(((64 - weights[i]) * endpoint0[c] + weights[i] * endpoint1[c] + 32) >> 6);
+		}
+#endif
+	}
+
+	void DecodeBC7Block(const uint8_t* block, uint8_t* outRgba)
+	{
+		uint32_t modeIndex = 0;
+		while (modeIndex < 8 && !(block[0] & (1u << modeIndex)))
+			++modeIndex;
+		if (modeIndex == 8)
+		{
+			memset(outRgba, 0, kBlockTexels * 4);
+			return;
+		}
+
+		const BC7Mode& mode = kBC7Modes[modeIndex];
+		BlockReader reader(block);
+		reader.Read(modeIndex + 1);
+		const uint32_t partition = reader.Read(mode.partitionBits);
+		const uint32_t rotation = reader.Read(mode.rotationBits);
+		const uint32_t indexSelection = reader.Read(mode.indexSelectionBits);
+
+		const uint32_t endpointCount = mode.subsets * 2u;
+		int endpoints[6][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			const uint32_t bits = c < 3 ? mode.colorBits : mode.alphaBits;
+			for (uint32_t e = 0; e < endpointCount; ++e)
+				endpoints[e][c] = static_cast<int>(reader.Read(bits));
+		}
+		int pBits[6] = {};
+		for (uint32_t e = 0; e < endpointCount && mode.endpointPBits; ++e)
+			pBits[e] = static_cast<int>(reader.Read(1));
+		for (uint32_t s = 0; s < mode.subsets && mode.sharedPBits; ++s)
+			pBits[s * 2] = pBits[s * 2 + 1] = static_cast<int>(reader.Read(1));
+
+		const bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+		for (uint32_t e = 0; e < endpointCount; ++e)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				const uint32_t bits = c < 3 ? mode.colorBits : mode.alphaBits;
+				if (bits == 0)
+					endpoints[e][c] = 255;
+				else if (hasPBits)
+					endpoints[e][c] = Expand((endpoints[e][c] << 1) | pBits[e], bits + 1);
+				else
+					endpoints[e][c] = Expand(endpoints[e][c], bits);
+			}
+		}
+
+		uint32_t subsets[kBlockTexels] = {};
+		uint32_t anchor1 = 0;
+		uint32_t anchor2 = 0;
+		if (mode.subsets == 2)
+		{
+			anchor1 = kAnchors2[partition];
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+				subsets[t] = (kPartitions2[partition] >> t) & 1;
+		}
+		else if (mode.subsets == 3)
+		{
+			anchor1 = kAnchors3Second[partition];
+			anchor2 = kAnchors3Third[partition];
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+				subsets[t] = (kPartitions3[partition] >> (t * 2)) & 3;
+		}
+
+		uint32_t indices[kBlockTexels];
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+		{
+			const bool anchor = t == 0 || (mode.subsets > 1 && t == anchor1) || (mode.subsets > 2 && t == anchor2);
+			indices[t] = reader.Read(mode.indexBits - (anchor ? 1 : 0));
+		}
+
+		// Each subset's palette, and for modes 4 and 5 a second one for the second set of indices
+		uint8_t palettes[3][16][4];
+		for (uint32_t s = 0; s < mode.subsets; ++s)
+			GetBC7Palette(endpoints[s * 2], endpoints[s * 2 + 1], mode.indexBits, palettes[s]);
+		if (!mode.secondaryIndexBits)
+		{
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+				memcpy(outRgba + t * 4, palettes[subsets[t]][indices[t]], 4);
+		}
+		else
+		{
+			uint8_t secondary[8][4];
+			GetBC7Palette(endpoints[0], endpoints[1], mode.secondaryIndexBits, secondary);
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+			{
+				const uint32_t index = reader.Read(mode.secondaryIndexBits - (t == 0 ? 1 : 0));
+				const uint8_t* color = indexSelection ? secondary[index] : palettes[0][indices[t]];
+				const uint8_t* alpha = indexSelection ? palettes[0][indices[t]] : secondary[index];
+				memcpy(outRgba + t * 4, color, 3);
+				outRgba[t * 4 + 3] = alpha[3];
+			}
+		}
+
+		if (rotation)
+		{
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+				std::swap(outRgba[t * 4 + 3], outRgba[t * 4 + rotation - 1]);
+		}
+	}
+
+	// A BC6H endpoint of bitCount bits scaled to the full 16 bit range, or 15 and a sign.
+	int UnquantizeBC6H(int value, uint32_t bitCount, bool isSigned)
+	{
+		if (!isSigned)
+		{
+			if (bitCount >= 15 || value == 0)
+				return value;
+			if (value == (1 << bitCount) - 1)
+				return 0xffff;
+			return ((value << 16) + 0x8000) >> bitCount;
+		}
+
+		if (bitCount >= 16)
+			return value;
+		const bool negative = value < 0;
+		const int magnitude = negative ? -value : value;
+		int scaled;
+		if (magnitude == 0)
+			scaled = 0;
+		else if (magnitude >= (1 << (bitCount - 1)) - 1)
+			scaled = 0x7fff;
+		else
+			scaled = ((magnitude << 15) + 0x4000) >> (bitCount - 1);
+		return negative ? -scaled : scaled;
+	}
+
+	// An interpolated value as the bits of a half: 31/64ths of it, which keeps it below infinity.
+	uint16_t FinishBC6H(int value, bool isSigned)
+	{
+		if (!isSigned)
+			return static_cast<uint16_t>((value * 31) >> 6);
+		return static_cast<uint16_t>(value < 0 ? 0x8000 | ((-value * 31) >> 5) : (value * 31) >> 5);
+	}
+
+#if !defined(BC_DECODER_F16C)
+	float HalfToFloat(uint16_t half)
+	{
+		const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+		const uint32_t exponent = (half >> 10) & 31;
+		const uint32_t mantissa = half & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0)
+		{
+			// Zero or denormal: the mantissa over 2^24, which a float holds exactly
+			float value = mantissa / 16777216.0f;
+			memcpy(&bits, &value, sizeof(bits));
+			bits |= sign;
+		}
+		else if (exponent == 31)
+		{
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+#endif
+
+	void DecodeBC6HBlock(const uint8_t* block, bool isSigned, float* outRgba)
+	{
+		BlockReader reader(block);
+		uint32_t value = reader.Read(2);
+		if (value >= 2)
+			value |= reader.Read(3) << 2;
+		const BC6HMode* mode = nullptr;
+		for (size_t m = 0; m < sizeof(kBC6HModes) / sizeof(kBC6HModes[0]) && !mode; ++m)
+			mode = kBC6HModes[m].value == value ? &kBC6HModes[m] : nullptr;
+
+		uint16_t halves[kBlockTexels * 3] = {};
+		if (mode)
+		{
+			int endpoints[4][3] = {};
+			uint32_t partition = 0;
+			for (const BC6HRun* run = mode->runs; run->field != END; ++run)
+			{
+				uint32_t bits = 0;
+				if (run->first <= run->last)
+				{
+					bits = reader.Read(run->last - run->first + 1u) << run->first;
+				}
+				else
+				{
+					for (int bit = run->first; bit >= run->last; --bit)
+						bits |= reader.Read(1) << bit;
+				}
+				if (run->field == PARTITION)
+					partition |= bits;
+				else
+					endpoints[run->field & 3][run->field >> 2] |= static_cast<int>(bits);
+			}
+
+			// w is stored whole and the others, in most modes, as deltas from it that wrap
+			const uint32_t endpointCount = mode->partitioned ? 4 : 2;
+			const int mask = (1 << mode->endpointBits) - 1;
+			for (int c = 0; c < 3; ++c)
+			{
+				if (isSigned)
+					endpoints[0][c] = SignExtend(endpoints[0][c], mode->endpointBits);
+				for (uint32_t e = 1; e < endpointCount; ++e)
+				{
+					if (mode->transformed)
+					{
+						endpoints[e][c] = (endpoints[0][c] + SignExtend(endpoints[e][c], mode->deltaBits[c])) & mask;
+						if (isSigned)
+							endpoints[e][c] = SignExtend(endpoints[e][c], mode->endpointBits);
+					}
+					else if (isSigned)
+					{
+						endpoints[e][c] = SignExtend(endpoints[e][c], mode->endpointBits);
+					}
+				}
+				for (uint32_t e = 0; e < endpointCount; ++e)
+					endpoints[e][c] = UnquantizeBC6H(endpoints[e][c], mode->endpointBits, isSigned);
+			}
+
+			const uint32_t indexBits = mode->partitioned ? 3 : 4;
+			const int* weights = kWeights[indexBits - 2];
+			for (uint32_t t = 0; t < kBlockTexels; ++t)
+			{
+				const uint32_t subset = mode->partitioned ? (kPartitions2[partition] >> t) & 1 : 0;
+				const bool anchor = t == 0 || (mode->partitioned && t == kAnchors2[partition]);
+				const int weight = weights[reader.Read(indexBits - (anchor ? 1 : 0))];
+				const int* start = endpoints[subset * 2];
+				const int* end = endpoints[subset * 2 + 1];
+				for (int c = 0; c < 3; ++c)
+					halves[t * 3 + c] = FinishBC6H(((64 - weight) * start[c] + weight * end[c] + 32) >> 6, isSigned);
+			}
+		}
+
+		float rgb[kBlockTexels * 3];
+#if defined(BC_DECODER_F16C)
+		for (uint32_t i = 0; i < kBlockTexels * 3; i += 4)
+			_mm_storeu_ps(rgb + i, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(halves + i))));
+#else
+		for (uint32_t i = 0; i < kBlockTexels * 3; ++i)
+			rgb[i] = HalfToFloat(halves[i]);
+#endif
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+		{
+			memcpy(outRgba + t * 4, rgb + t * 3, sizeof(float) * 3);
+			outRgba[t * 4 + 3] = 1.0f;
+		}
+	}
+
+	// BC4, BC5 and BC6H decode to floats and the rest to RGBA8, each converted to the other on
+	// demand; isSigned is set for the SNORM and SF16 formats.
+	bool DecodesToFloat(DXGI_FORMAT format, bool& outSigned)
+	{
+		outSigned = format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM || format == DXGI_FORMAT_BC6H_SF16;
+		switch (format)
+		{
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	void DecodeRgba8Block(DXGI_FORMAT format, const uint8_t* block, uint8_t* outRgba)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			DecodeColorBlock(block, false, outRgba);
+			break;
+
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			DecodeColorBlock(block + 8, true, outRgba);
+			DecodeExplicitAlpha(block, outRgba);
+			break;
+
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			DecodeColorBlock(block + 8, true, outRgba);
+			DecodeInterpolatedAlpha(block, outRgba);
+			break;
+
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			DecodeBC7Block(block, outRgba);
+			break;
+
+		default:
+			memset(outRgba, 0, kBlockTexels * 4);
+			break;
+		}
+	}
+
+	void DecodeFloatBlock(DXGI_FORMAT format, const uint8_t* block, bool isSigned, float* outRgba)
+	{
+		if (format == DXGI_FORMAT_BC6H_TYPELESS || format == DXGI_FORMAT_BC6H_UF16 || format == DXGI_FORMAT_BC6H_SF16)
+		{
+			DecodeBC6HBlock(block, isSigned, outRgba);
+			return;
+		}
+
+		const bool twoChannels = format == DXGI_FORMAT_BC5_TYPELESS || format == DXGI_FORMAT_BC5_UNORM || format == DXGI_FORMAT_BC5_SNORM;
+		for (uint32_t t = 0; t < kBlockTexels; ++t)
+		{
+			outRgba[t * 4 + 1] = 0.0f;
+			outRgba[t * 4 + 2] = 0.0f;
+			outRgba[t * 4 + 3] = 1.0f;
+		}
+		DecodeChannel(block, isSigned, 0, outRgba);
+		if (twoChannels)
+			DecodeChannel(block + 8, isSigned, 1, outRgba);
+	}
+
+	void Rgba8ToFloat(const uint8_t* in, float* out)
+	{
+#if defined(BC_DECODER_AVX2)
+		const __m256 scale = _mm256_set1_ps(kInv255);
+		for (uint32_t i = 0; i < kBlockTexels * 4; i += 8)
+		{
+			const __m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+		}
+#elif defined(BC_DECODER_SSE2)
+		const __m128 scale = _mm_set1_ps(kInv255);
+		const __m128i zero = _mm_setzero_si128();
+		for (uint32_t i = 0; i < kBlockTexels * 4; i += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+			_mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+			_mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+		}
+#else
+		for (uint32_t i = 0; i < kBlockTexels * 4; ++i)
+			out[i] = in[i] * kInv255;
+#endif
+	}
+
+	// Clamped to 0..1, or -1..1 when signed, and rounded to the nearest of 256 steps over it.
+	void FloatToRgba8(const float* in, bool isSigned, uint8_t* out)
+	{
+		const float low = isSigned ? -1.0f : 0.0f;
+		const float scale = isSigned ? 127.5f : 255.0f;
+		const float bias = isSigned ? 128.0f : 0.5f;
+#if defined(BC_DECODER_SSE2)
+		const __m128 lowest = _mm_set1_ps(low);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scales = _mm_set1_ps(scale);
+		const __m128 biases = _mm_set1_ps(bias);
+		__m128i values[4];
+		for (uint32_t i = 0; i < kBlockTexels * 4; i += 16)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + j * 4), lowest), one);
+				values[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scales), biases));
+			}
+			const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(values[0], values[1]), _mm_packs_epi32(values[2], values[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+		}
+#else
+		for (uint32_t i = 0; i < kBlockTexels * 4; ++i)
+		{
+			const float clamped = std::min(std::max(in[i], low), 1.0f);
+			out[i] = static_cast<uint8_t>(std::min(clamped * scale + bias, 255.0f));
+		}
+#endif
+	}
+
+	template <typename Texel>
+	void DecodeImage(DXGI_FORMAT format, const uint8_t* blocks, uint32_t width, uint32_t height, Texel* outRgba, size_t rowPitch)
+	{
+		if (!IsBlockCompressed(format))
+			return;
+
+		const size_t blockBytes = BitsPerPixel(format) * kBlockTexels / 8;
+		const uint32_t blocksWide = (width + 3) / 4;
+		const uint32_t blocksHigh = (height + 3) / 4;
+		Texel texels[kBlockTexels * 4];
+		for (uint32_t by = 0; by < blocksHigh; ++by)
+		{
+			for (uint32_t bx = 0; bx < blocksWide; ++bx, blocks += blockBytes)
+			{
+				DecodeBCBlock(format, blocks, texels);
+				const uint32_t columns = std::min(4u, width - bx * 4);
+				const uint32_t rows = std::min(4u, height - by * 4);
+				for (uint32_t y = 0; y < rows; ++y)
+				{
+					uint8_t* row = reinterpret_cast<uint8_t*>(outRgba) + (static_cast<size_t>(by) * 4 + y) * rowPitch;
+					memcpy(row + static_cast<size_t>(bx) * 4 * 4 * sizeof(Texel), texels + y * 16, columns * 4 * sizeof(Texel));
+				}
+			}
+		}
+	}
+}
+
+const char* DX::GetBCDecoderInstructionSet(void)
+{
+#if defined(BC_DECODER_AVX2)
+	return "avx2";
+#elif defined(BC_DECODER_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+void DX::DecodeBCBlock(DXGI_FORMAT format, const uint8_t* block, uint8_t* outRgba)
+{
+	bool isSigned = false;
+	if (!DecodesToFloat(format, isSigned))
+	{
+		DecodeRgba8Block(format, block, outRgba);
+		return;
+	}
+
+	// BC6H is clamped to 0..1 whether or not it is signed
+	float texels[kBlockTexels * 4];
+	DecodeFloatBlock(format, block, isSigned, texels);
+	FloatToRgba8(texels, isSigned && format != DXGI_FORMAT_BC6H_SF16, outRgba);
+}
+
+void DX::DecodeBCBlock(DXGI_FORMAT format, const uint8_t* block, float* outRgba)
+{
+	bool isSigned = false;
+	if (DecodesToFloat(format, isSigned))
+	{
+		DecodeFloatBlock(format, block, isSigned, outRgba);
+		return;
+	}
+
+	uint8_t texels[kBlockTexels * 4];
+	DecodeRgba8Block(format, block, texels);
+	Rgba8ToFloat(texels, outRgba);
+}
+
+void DX::DecodeBCImage(DXGI_FORMAT format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* outRgba, size_t rowPitch)
+{
+	DecodeImage(format, blocks, width, height, outRgba, rowPitch);
+}
+
+void DX::DecodeBCImage(DXGI_FORMAT format, const uint8_t* blocks, uint32_t width, uint32_t height, float* outRgba, size_t rowPitch)
+{
+	DecodeImage(format, blocks, width, height, outRgba, rowPitch);
+}
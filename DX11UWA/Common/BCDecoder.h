@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include "DDSFile.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DX
+{
+	// Instruction set the texel conversions were built for: "avx2", "sse2" or "scalar".
+	const char* GetBCDecoderInstructionSet(void);
+
+	// Decodes one block of any BC1 to BC7 format, IsBlockCompressed says which, into 4x4 texels
+	// row by row, as the GPU samples them: channels a format lacks read 0, and alpha 1. Typeless
+	// formats decode as UNORM and BC6H_TYPELESS as UF16. Reserved BC6H and BC7 modes decode to 0.
+	// The float texels are exact for BC4, BC5 and BC6H and the RGBA8 ones over 255 for the rest;
+	// RGBA8 texels of SNORM formats map -1..1 to 0..255, and those of BC6H clamp to 0..1.
+	void DecodeBCBlock(DXGI_FORMAT format, const uint8_t* block, uint8_t* outRgba);
+	void DecodeBCBlock(DXGI_FORMAT format, const uint8_t* block, float* outRgba);
+
+	// Decodes the rows of blocks of a width by height mip, as a DDS file lays them out, into
+	// width by height texels with rows rowPitch bytes apart, dropping those past the edges. Formats
+	// that are not block compressed are left alone.
+	void DecodeBCImage(DXGI_FORMAT format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* outRgba, size_t rowPitch);
+	void DecodeBCImage(DXGI_FORMAT format, const uint8_t* blocks, uint32_t width, uint32_t height, float* outRgba, size_t rowPitch);
+}
@@ -0,0 +1,694 @@
+﻿#include "BCEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// The palette search is the inner loop of every format, so it has a path for each instruction set
+// a build can assume: AVX2 where the compiler targets it, SSE2 on any x86 or x64, scalar elsewhere.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BC_ENCODER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_ENCODER_SSE2
+#endif
+
+using namespace DX;
+
+namespace
+{
+	typedef std::function<void(unsigned int)> Work;
+
+	const uint32_t kPaletteSize = 16;
+	// Passes of least squares endpoint refinement after the first fit.
+	const uint32_t kRefinePasses = 2;
+	// Far enough from every texel that its error, at least (1023 - 255)^2, is more than the
+	// 4 * 255^2 of any real entry.
+	const int16_t kUnusedChannel = 1023;
+
+	// Where each index sits between the two endpoints.
+	const float kColorWeights4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	const float kColorWeights3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+	const int kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	const float kBC7Weights4Float[16] = { 0.0f, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+		34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 1.0f };
+
+	const uint32_t kBC7Mode6 = 0x40;
+
+	// Entries in the pairs _mm_madd_epi16 squares and sums: red and green of entry i at rg[2 * i],
+	// blue and alpha at ba[2 * i].
+	struct Palette
+	{
+		int16_t	rg[kPaletteSize * 2];
+		int16_t	ba[kPaletteSize * 2];
+	};
+
+	void SetPaletteEntry(Palette& palette, uint32_t entry, int r, int g, int b, int a)
+	{
+		palette.rg[entry * 2] = static_cast<int16_t>(r);
+		palette.rg[entry * 2 + 1] = static_cast<int16_t>(g);
+		palette.ba[entry * 2] = static_cast<int16_t>(b);
+		palette.ba[entry * 2 + 1] = static_cast<int16_t>(a);
+	}
+
+	void ClearPalette(Palette& palette)
+	{
+		for (uint32_t i = 0; i < kPaletteSize; ++i)
+			SetPaletteEntry(palette, i, kUnusedChannel, 0, 0, 0);
+	}
+
+	// Sets the index of each texel in mask to its nearest of the first count palette entries and
+	// returns their summed squared error. Ties go to the lower index.
+	uint32_t FindIndices(const Palette& palette, uint32_t count, const uint8_t* texels, uint32_t mask, uint8_t* outIndices)
+	{
+		uint32_t total = 0;
+#if defined(BC_ENCODER_AVX2)
+		// Eight entries a register. The error and index are packed into one key, error << 4 | index,
+		// so one minimum finds both; keys of real entries stay below 2^24 and convert to float exactly.
+		const uint32_t groups = (count + 7) / 8;
+		__m256i rg[2];
+		__m256i ba[2];
+		__m256i entries[2];
+		for (uint32_t g = 0; g < groups; ++g)
+		{
+			rg[g] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(palette.rg + g * 16));
+			ba[g] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(palette.ba + g * 16));
+			entries[g] = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(g * 8)));
+		}
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+
+			const uint8_t* texel = texels + t * 4;
+			const __m256i texelRG = _mm256_set1_epi32(texel[0] | (texel[1] << 16));
+			const __m256i texelBA = _mm256_set1_epi32(texel[2] | (texel[3] << 16));
+			__m256 best = _mm256_set1_ps(FLT_MAX);
+			for (uint32_t g = 0; g < groups; ++g)
+			{
+				__m256i difference = _mm256_sub_epi16(rg[g], texelRG);
+				__m256i error = _mm256_madd_epi16(difference, difference);
+				difference = _mm256_sub_epi16(ba[g], texelBA);
+				error = _mm256_add_epi32(error, _mm256_madd_epi16(difference, difference));
+				best = _mm256_min_ps(best, _mm256_cvtepi32_ps(_mm256_or_si256(_mm256_slli_epi32(error, 4), entries[g])));
+			}
+			__m128 key = _mm_min_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+			key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(1, 0, 3, 2)));
+			key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(2, 3, 0, 1)));
+			const uint32_t packed = static_cast<uint32_t>(_mm_cvtss_si32(key));
+			outIndices[t] = static_cast<uint8_t>(packed & 15);
+			total += packed >> 4;
+		}
+#elif defined(BC_ENCODER_SSE2)
+		// As above, four entries a register.
+		const uint32_t groups = (count + 3) / 4;
+		__m128i rg[4];
+		__m128i ba[4];
+		__m128i entries[4];
+		for (uint32_t g = 0; g < groups; ++g)
+		{
+			rg[g] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.rg + g * 8));
+			ba[g] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.ba + g * 8));
+			entries[g] = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(g * 4)));
+		}
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+
+			const uint8_t* texel = texels + t * 4;
+			const __m128i texelRG = _mm_set1_epi32(texel[0] | (texel[1] << 16));
+			const __m128i texelBA = _mm_set1_epi32(texel[2] | (texel[3] << 16));
+			__m128 key = _mm_set1_ps(FLT_MAX);
+			for (uint32_t g = 0; g < groups; ++g)
+			{
+				__m128i difference = _mm_sub_epi16(rg[g], texelRG);
+				__m128i error = _mm_madd_epi16(difference, difference);
+				difference = _mm_sub_epi16(ba[g], texelBA);
+				error = _mm_add_epi32(error, _mm_madd_epi16(difference, difference));
+				key = _mm_min_ps(key, _mm_cvtepi32_ps(_mm_or_si128(_mm_slli_epi32(error, 4), entries[g])));
+			}
+			key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(1, 0, 3, 2)));
+			key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(2, 3, 0, 1)));
+			const uint32_t packed = static_cast<uint32_t>(_mm_cvtss_si32(key));
+			outIndices[t] = static_cast<uint8_t>(packed & 15);
+			total += packed >> 4;
+		}
+#else
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+
+			const uint8_t* texel = texels + t * 4;
+			uint32_t bestError = UINT32_MAX;
+			uint32_t bestIndex = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const int dr = palette.rg[i * 2] - texel[0];
+				const int dg = palette.rg[i * 2 + 1] - texel[1];
+				const int db = palette.ba[i * 2] - texel[2];
+				const int da = palette.ba[i * 2 + 1] - texel[3];
+				const uint32_t error = static_cast<uint32_t>(dr * dr + dg * dg + db * db + da * da);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = i;
+				}
+			}
+			outIndices[t] = static_cast<uint8_t>(bestIndex);
+			total += bestError;
+		}
+#endif
+		return total;
+	}
+
+	// The principal axis through the mean of the texels in mask, over the first channelCount
+	// channels, clipped to where they project onto it.
+	void FitLine(const uint8_t* texels, uint32_t mask, uint32_t channelCount, float* outStart, float* outEnd)
+	{
+		float mean[4] = {};
+		uint32_t count = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+			for (uint32_t c = 0; c < channelCount; ++c)
+				mean[c] += texels[t * 4 + c];
+			++count;
+		}
+		for (uint32_t c = 0; c < channelCount; ++c)
+			mean[c] /= std::max(count, 1u);
+
+		float covariance[4][4] = {};
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+			for (uint32_t i = 0; i < channelCount; ++i)
+			{
+				for (uint32_t j = 0; j < channelCount; ++j)
+					covariance[i][j] += (texels[t * 4 + i] - mean[i]) * (texels[t * 4 + j] - mean[j]);
+			}
+		}
+
+		// Power iteration, from the row of the channel that varies most
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channelCount; ++c)
+			widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+		float axis[4] = {};
+		for (uint32_t c = 0; c < channelCount; ++c)
+			axis[c] = covariance[widest][c];
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (uint32_t i = 0; i < channelCount; ++i)
+			{
+				for (uint32_t j = 0; j < channelCount; ++j)
+					next[i] += covariance[i][j] * axis[j];
+				largest = std::max(largest, std::fabs(next[i]));
+			}
+			if (largest == 0.0f)
+				break;
+			for (uint32_t c = 0; c < channelCount; ++c)
+				axis[c] = next[c] / largest;
+		}
+
+		float length = 0.0f;
+		for (uint32_t c = 0; c < channelCount; ++c)
+			length += axis[c] * axis[c];
+		float low = 0.0f;
+		float high = 0.0f;
+		if (length > 0.0f)
+		{
+			low = FLT_MAX;
+			high = -FLT_MAX;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				if (!(mask & (1u << t)))
+					continue;
+				float projection = 0.0f;
+				for (uint32_t c = 0; c < channelCount; ++c)
+					projection += (texels[t * 4 + c] - mean[c]) * axis[c];
+				low = std::min(low, projection / length);
+				high = std::max(high, projection / length);
+			}
+		}
+
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			outStart[c] = std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f);
+			outEnd[c] = std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f);
+		}
+	}
+
+	// Least squares endpoints for the texels in mask, given the indices they took and where each
+	// index sits between the endpoints. False, leaving the endpoints, when the indices cannot pin
+	// both down, as when every texel took the same one.
+	bool RefineLine(const uint8_t* texels, uint32_t mask, uint32_t channelCount, const uint8_t* indices, const float* weights, float* start, float* end)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			if (!(mask & (1u << t)))
+				continue;
+			const float b = weights[indices[t]];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				ax[c] += a * texels[t * 4 + c];
+				bx[c] += b * texels[t * 4 + c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			return false;
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			start[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+			end[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	class BitWriter
+	{
+	public:
+		BitWriter(uint8_t* out, size_t size) :
+			m_out(out),
+			m_position(0)
+		{
+			memset(out, 0, size);
+		}
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; ++i, ++m_position)
+				m_out[m_position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (m_position & 7));
+		}
+
+	private:
+		uint8_t*	m_out;
+		uint32_t	m_position;
+	};
+
+	uint16_t PackColor565(const float* color)
+	{
+		const int r = std::min(std::max(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+		const int g = std::min(std::max(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+		const int b = std::min(std::max(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackColor565(uint16_t color, int* outRGB)
+	{
+		const int r = color >> 11;
+		const int g = (color >> 5) & 63;
+		const int b = color & 31;
+		outRGB[0] = (r << 3) | (r >> 2);
+		outRGB[1] = (g << 2) | (g >> 4);
+		outRGB[2] = (b << 3) | (b >> 2);
+	}
+
+	// The colours of a BC1 block in index order, alpha last, rounded as BCDecoder rounds them; the
+	// fourth is transparent black in three colour blocks.
+	void GetColorPalette(uint16_t color0, uint16_t color1, bool fourColors, int (*outColors)[4])
+	{
+		UnpackColor565(color0, outColors[0]);
+		UnpackColor565(color1, outColors[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			const int c0 = outColors[0][c];
+			const int c1 = outColors[1][c];
+			outColors[2][c] = fourColors ? (2 * c0 + c1 + 1) / 3 : (c0 + c1 + 1) / 2;
+			outColors[3][c] = fourColors ? (c0 + 2 * c1 + 1) / 3 : 0;
+		}
+		outColors[0][3] = outColors[1][3] = outColors[2][3] = 255;
+		outColors[3][3] = fourColors ? 255 : 0;
+	}
+
+	// The eight alphas of a BC3 block in index order, rounded as BCDecoder rounds them.
+	void GetAlphaPalette(int alpha0, int alpha1, int* outAlphas)
+	{
+		outAlphas[0] = alpha0;
+		outAlphas[1] = alpha1;
+		if (alpha0 > alpha1)
+		{
+			for (int i = 1; i < 7; ++i)
+				outAlphas[i + 1] = ((7 - i) * alpha0 + i * alpha1 + 3) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				outAlphas[i + 1] = ((5 - i) * alpha0 + i * alpha1 + 2) / 5;
+			outAlphas[6] = 0;
+			outAlphas[7] = 255;
+		}
+	}
+
+	// Texels with alpha below 128 become transparent when allowTransparent; otherwise alpha is
+	// ignored and, as BC2 and BC3 require, the block is written with four colours.
+	void EncodeColorBlock(const uint8_t* rgba, uint8_t* outBlock, bool allowTransparent)
+	{
+		// Alpha is zeroed here and in the palette, so the search ignores it
+		uint8_t texels[BC_BLOCK_TEXELS * 4];
+		uint32_t mask = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			memcpy(texels + t * 4, rgba + t * 4, 3);
+			texels[t * 4 + 3] = 0;
+			if (!allowTransparent || rgba[t * 4 + 3] >= 128)
+				mask |= 1u << t;
+		}
+		const bool transparent = mask != 0xffff;
+
+		uint8_t indices[BC_BLOCK_TEXELS];
+		uint8_t bestIndices[BC_BLOCK_TEXELS];
+		uint16_t best0 = 0;
+		uint16_t best1 = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			indices[t] = bestIndices[t] = 3;
+
+		if (mask != 0)
+		{
+			float start[3];
+			float end[3];
+			FitLine(texels, mask, 3, start, end);
+
+			uint32_t bestError = UINT32_MAX;
+			for (uint32_t pass = 0; pass <= kRefinePasses; ++pass)
+			{
+				// Three colour blocks need color0 <= color1 and four colour ones color0 > color1,
+				// which equal endpoints cannot have, so they search the three entries that match
+				uint16_t color0 = PackColor565(start);
+				uint16_t color1 = PackColor565(end);
+				if (transparent ? color0 > color1 : color0 < color1)
+				{
+					std::swap(color0, color1);
+					std::swap(start, end);
+				}
+				const bool fourColors = !transparent && color0 != color1;
+
+				int colors[4][4];
+				GetColorPalette(color0, color1, fourColors, colors);
+				Palette palette;
+				ClearPalette(palette);
+				for (uint32_t i = 0; i < 4; ++i)
+					SetPaletteEntry(palette, i, colors[i][0], colors[i][1], colors[i][2], 0);
+
+				const uint32_t error = FindIndices(palette, fourColors ? 4 : 3, texels, mask, indices);
+				if (error < bestError)
+				{
+					bestError = error;
+					best0 = color0;
+					best1 = color1;
+					memcpy(bestIndices, indices, sizeof(indices));
+				}
+				if (error == 0 || !RefineLine(texels, mask, 3, indices, fourColors ? kColorWeights4 : kColorWeights3, start, end))
+					break;
+			}
+		}
+
+		uint32_t packed = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			packed |= static_cast<uint32_t>(bestIndices[t]) << (t * 2);
+		outBlock[0] = static_cast<uint8_t>(best0);
+		outBlock[1] = static_cast<uint8_t>(best0 >> 8);
+		outBlock[2] = static_cast<uint8_t>(best1);
+		outBlock[3] = static_cast<uint8_t>(best1 >> 8);
+		memcpy(outBlock + 4, &packed, sizeof(packed));
+	}
+
+	uint32_t FindAlphaIndices(const uint8_t* rgba, const int* alphas, uint8_t* outIndices)
+	{
+		uint32_t total = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			uint32_t bestError = UINT32_MAX;
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				const int difference = alphas[i] - rgba[t * 4 + 3];
+				const uint32_t error = static_cast<uint32_t>(difference * difference);
+				if (error < bestError)
+				{
+					bestError = error;
+					outIndices[t] = i;
+				}
+			}
+			total += bestError;
+		}
+		return total;
+	}
+
+	// Tries the span of all the alphas with eight steps and the span of those strictly between
+	// 0 and 255 with six, leaving the ends to the two exact ones.
+	void EncodeAlphaBlock(const uint8_t* rgba, uint8_t* outBlock)
+	{
+		int low = 255;
+		int high = 0;
+		int innerLow = 255;
+		int innerHigh = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			const int alpha = rgba[t * 4 + 3];
+			low = std::min(low, alpha);
+			high = std::max(high, alpha);
+			if (alpha != 0 && alpha != 255)
+			{
+				innerLow = std::min(innerLow, alpha);
+				innerHigh = std::max(innerHigh, alpha);
+			}
+		}
+		if (innerLow > innerHigh)
+			innerLow = innerHigh = 0;
+
+		int alphas[8];
+		uint8_t indices[BC_BLOCK_TEXELS];
+		uint8_t bestIndices[BC_BLOCK_TEXELS];
+		int best0 = high;
+		int best1 = low;
+		GetAlphaPalette(high, low, alphas);
+		uint32_t bestError = FindAlphaIndices(rgba, alphas, bestIndices);
+
+		GetAlphaPalette(innerLow, innerHigh, alphas);
+		if (bestError > 0 && FindAlphaIndices(rgba, alphas, indices) < bestError)
+		{
+			best0 = innerLow;
+			best1 = innerHigh;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+
+		outBlock[0] = static_cast<uint8_t>(best0);
+		outBlock[1] = static_cast<uint8_t>(best1);
+		uint64_t packed = 0;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			packed |= static_cast<uint64_t>(bestIndices[t]) << (t * 3);
+		for (int i = 0; i < 6; ++i)
+			outBlock[2 + i] = static_cast<uint8_t>(packed >> (i * 8));
+	}
+
+	void GetBC7Palette(const int* endpoint0, const int* endpoint1, Palette& palette)
+	{
+		for (uint32_t i = 0; i < kPaletteSize; ++i)
+		{
+			int color[4];
+			for (int c = 0; c < 4; ++c)
+				color[c] = ((64 - kBC7Weights4[i]) * endpoint0[c] + kBC7Weights4[i] * endpoint1[c] + 32) >> 6;
+			SetPaletteEntry(palette, i, color[0], color[1], color[2], color[3]);
+		}
+	}
+
+	// Mode 6: one RGBA line whose endpoints are 7 bits a channel plus a shared low bit each, and
+	// 4 bit indices. Every combination of the two low bits is tried on each pass, except in an
+	// opaque block: alpha only reaches 255 with both low bits set, so those are kept and alpha
+	// pinned there rather than left to a fit that can settle on 254.
+	void EncodeBC7Block(const uint8_t* rgba, uint8_t* outBlock)
+	{
+		bool opaque = true;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			opaque = opaque && rgba[t * 4 + 3] == 255;
+
+		float start[4];
+		float end[4];
+		FitLine(rgba, 0xffff, 4, start, end);
+
+		uint8_t indices[BC_BLOCK_TEXELS];
+		uint8_t bestIndices[BC_BLOCK_TEXELS] = {};
+		int best0[4] = {};
+		int best1[4] = {};
+		uint32_t bestError = UINT32_MAX;
+		for (uint32_t pass = 0; pass <= kRefinePasses; ++pass)
+		{
+			uint32_t passError = UINT32_MAX;
+			uint8_t passIndices[BC_BLOCK_TEXELS] = {};
+			for (int bits = opaque ? 3 : 0; bits < 4; ++bits)
+			{
+				const int bit0 = bits & 1;
+				const int bit1 = bits >> 1;
+				int endpoint0[4];
+				int endpoint1[4];
+				for (int c = 0; c < 4; ++c)
+				{
+					endpoint0[c] = (std::min(std::max(static_cast<int>((start[c] - bit0) * 0.5f + 0.5f), 0), 127) << 1) | bit0;
+					endpoint1[c] = (std::min(std::max(static_cast<int>((end[c] - bit1) * 0.5f + 0.5f), 0), 127) << 1) | bit1;
+				}
+				if (opaque)
+					endpoint0[3] = endpoint1[3] = 255;
+
+				Palette palette;
+				GetBC7Palette(endpoint0, endpoint1, palette);
+				const uint32_t error = FindIndices(palette, kPaletteSize, rgba, 0xffff, indices);
+				if (error < passError)
+				{
+					passError = error;
+					memcpy(passIndices, indices, sizeof(indices));
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					memcpy(best0, endpoint0, sizeof(endpoint0));
+					memcpy(best1, endpoint1, sizeof(endpoint1));
+					memcpy(bestIndices, indices, sizeof(indices));
+				}
+			}
+			if (bestError == 0 || !RefineLine(rgba, 0xffff, 4, passIndices, kBC7Weights4Float, start, end))
+				break;
+		}
+
+		// The first texel's index is stored without its top bit, which has to be clear
+		if (bestIndices[0] & 8)
+		{
+			std::swap(best0, best1);
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				bestIndices[t] = static_cast<uint8_t>(15 - bestIndices[t]);
+		}
+
+		BitWriter writer(outBlock, 16);
+		writer.Write(kBC7Mode6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Write(static_cast<uint32_t>(best0[c] >> 1), 7);
+			writer.Write(static_cast<uint32_t>(best1[c] >> 1), 7);
+		}
+		writer.Write(static_cast<uint32_t>(best0[0] & 1), 1);
+		writer.Write(static_cast<uint32_t>(best1[0] & 1), 1);
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			writer.Write(bestIndices[t], t == 0 ? 3 : 4);
+	}
+
+	// Runs work(0) to work(count - 1) at once, work(0) on the calling thread.
+	void RunParallel(unsigned int count, const Work& work)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(count > 0 ? count - 1 : 0);
+		for (unsigned int i = 1; i < count; ++i)
+			threads.push_back(std::thread([&work, i]() { work(i); }));
+		if (count > 0)
+			work(0);
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+
+	unsigned int ResolveThreadCount(unsigned int threadCount)
+	{
+		return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+const char* DX::GetBCEncoderInstructionSet(void)
+{
+#if defined(BC_ENCODER_AVX2)
+	return "avx2";
+#elif defined(BC_ENCODER_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+size_t DX::GetBCBlockBytes(BCFormat format)
+{
+	return format == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+DXGI_FORMAT DX::GetBCDXGIFormat(BCFormat format, bool srgb)
+{
+	switch (format)
+	{
+	case BC_FORMAT_BC1:	return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case BC_FORMAT_BC3:	return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case BC_FORMAT_BC7:	return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	default:			return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+void DX::EncodeBCBlock(BCFormat format, const uint8_t* rgba, uint8_t* outBlock)
+{
+	switch (format)
+	{
+	case BC_FORMAT_BC1:
+		EncodeColorBlock(rgba, outBlock, true);
+		break;
+
+	case BC_FORMAT_BC3:
+		EncodeAlphaBlock(rgba, outBlock);
+		EncodeColorBlock(rgba, outBlock + 8, false);
+		break;
+
+	case BC_FORMAT_BC7:
+		EncodeBC7Block(rgba, outBlock);
+		break;
+
+	default:
+		break;
+	}
+}
+
+unsigned int DX::EncodeBCImage(BCFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* outBlocks,
+	unsigned int threadCount)
+{
+	if (width == 0 || height == 0)
+		return 0;
+
+	const uint32_t blocksWide = (width + 3) / 4;
+	const uint32_t blocksHigh = (height + 3) / 4;
+	const size_t blockBytes = GetBCBlockBytes(format);
+	const size_t rowBytes = blocksWide * blockBytes;
+	const unsigned int workerCount = std::min(ResolveThreadCount(threadCount), blocksHigh);
+
+	// Rows are handed out one at a time, as blocks cost very different amounts to search
+	std::atomic<uint32_t> nextRow(0);
+	RunParallel(workerCount, [&](unsigned int)
+	{
+		uint8_t texels[BC_BLOCK_TEXELS * 4];
+		for (uint32_t row = nextRow++; row < blocksHigh; row = nextRow++)
+		{
+			for (uint32_t column = 0; column < blocksWide; ++column)
+			{
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					const uint8_t* source = rgba + std::min(row * 4 + y, height - 1) * rowPitch;
+					for (uint32_t x = 0; x < 4; ++x)
+						memcpy(texels + (y * 4 + x) * 4, source + std::min(column * 4 + x, width - 1) * 4, 4);
+				}
+				EncodeBCBlock(format, texels, outBlocks + row * rowBytes + column * blockBytes);
+			}
+		}
+	});
+	return workerCount;
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "DDSFile.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DX
+{
+	enum BCFormat
+	{
+		BC_FORMAT_BC1,		// RGB in 4 bits a texel, alpha only as cut-out
+		BC_FORMAT_BC3,		// RGBA in 8 bits a texel, alpha interpolated on its own
+		BC_FORMAT_BC7,		// RGBA in 8 bits a texel, 7 bit endpoints and 16 shades a block
+		BC_FORMAT_COUNT
+	};
+
+	const uint32_t BC_BLOCK_TEXELS = 16;
+
+	// Instruction set the block search was built for: "avx2", "sse2" or "scalar".
+	const char* GetBCEncoderInstructionSet(void);
+	size_t GetBCBlockBytes(BCFormat format);
+	DXGI_FORMAT GetBCDXGIFormat(BCFormat format, bool srgb);
+
+	// Encodes one block of 4x4 RGBA8 texels, row by row, into GetBCBlockBytes(format) bytes. BC1
+	// keeps alpha only as its transparent texels, for blocks holding any alpha below 128. BC7
+	// writes every block in mode 6, a single RGBA line with 7 bit endpoints and 4 bit indices.
+	// BCDecoder's DecodeBCBlock is the inverse.
+	void EncodeBCBlock(BCFormat format, const uint8_t* rgba, uint8_t* outBlock);
+
+	// Encodes a width by height RGBA8 image with rows rowPitch bytes apart into rows of blocks,
+	// laid out as a DDS mip is. Blocks past the right and bottom edges repeat the last column and
+	// row. Rows of blocks are shared between threadCount threads, or one a core for 0; returns the
+	// number of threads used.
+	unsigned int EncodeBCImage(BCFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* outBlocks,
+		unsigned int threadCount = 0);
+}
@@ -0,0 +1,1630 @@
+﻿#include "CompressedFile.h"
+
+#include "FileIO.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t kZstdMagic = 0xFD2FB528;
+	const uint32_t kZstdSkippableMagic = 0x184D2A50;	// the low 4 bits are free
+	const size_t kZstdMaxBlock = 128 << 10;
+	const size_t kDeflateWindow = 32 << 10;
+	const size_t kDeflateMaxMatch = 258;
+	// Output one Inflate call produces before handing it to the reader.
+	const size_t kInflateStep = 64 << 10;
+	// Codes up to this long decode with one table lookup; longer ones a bit at a time.
+	const uint32_t kInflateFastBits = 10;
+
+	const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+		8193, 12289, 16385, 24577 };
+	const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	// Order the code length code lengths of a dynamic block are stored in.
+	const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	const uint32_t kLiteralLengthBase[36] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512,
+		1024, 2048, 4096, 8192, 16384, 32768, 65536 };
+	const uint8_t kLiteralLengthExtra[36] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	const uint32_t kMatchLengthBase[53] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+		35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539 };
+	const uint8_t kMatchLengthExtra[53] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+	// The predefined distributions sequences use until a block sends its own.
+	const int16_t kDefaultLiteralLengths[36] = { 4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1 };
+	const int16_t kDefaultMatchLengths[53] = { 1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1 };
+	const int16_t kDefaultOffsets[29] = { 1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1 };
+
+	inline uint32_t LoadLE16(const uint8_t* p)
+	{
+		return p[0] | (p[1] << 8);
+	}
+
+	inline uint32_t LoadLE32(const uint8_t* p)
+	{
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+	}
+
+	inline uint64_t LoadLE64(const uint8_t* p)
+	{
+		return uint64_t(LoadLE32(p)) | (uint64_t(LoadLE32(p + 4)) << 32);
+	}
+
+	// Index of the highest set bit; value must not be 0.
+	inline uint32_t HighBit(uint32_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+			++bit;
+		return bit;
+	}
+
+	// Copies a match that may overlap its own output, as LZ77 back-references do.
+	inline void CopyMatch(uint8_t* to, size_t distance, size_t length)
+	{
+		const uint8_t* from = to - distance;
+		if (distance >= length)
+		{
+			memcpy(to, from, length);
+			return;
+		}
+		for (size_t i = 0; i < length; ++i)
+			to[i] = from[i];
+	}
+
+	struct Crc32Table
+	{
+		uint32_t entries[256];
+
+		Crc32Table(void)
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t crc = n;
+				for (int k = 0; k < 8; ++k)
+					crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+				entries[n] = crc;
+			}
+		}
+	};
+
+	uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		static const Crc32Table table;
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	const uint64_t kXxPrime1 = 11400714785074694791ull;
+	const uint64_t kXxPrime2 = 14029467366897019727ull;
+	const uint64_t kXxPrime3 = 1609587929392839161ull;
+	const uint64_t kXxPrime4 = 9650029242287828579ull;
+	const uint64_t kXxPrime5 = 2870177450012600261ull;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline uint64_t XxRound(uint64_t accumulator, uint64_t input)
+	{
+		return RotateLeft(accumulator + input * kXxPrime2, 31) * kXxPrime1;
+	}
+
+	inline uint64_t XxMerge(uint64_t accumulator, uint64_t lane)
+	{
+		return (accumulator ^ XxRound(0, lane)) * kXxPrime1 + kXxPrime4;
+	}
+
+	// XXH64 with seed 0, fed a piece at a time. zstd frames end with its low 32 bits.
+	struct Xxh64
+	{
+		uint64_t	lanes[4];
+		uint64_t	length;
+		uint8_t		pending[32];
+		size_t		pendingSize;
+
+		void Reset(void)
+		{
+			lanes[0] = kXxPrime1 + kXxPrime2;
+			lanes[1] = kXxPrime2;
+			lanes[2] = 0;
+			lanes[3] = 0 - kXxPrime1;
+			length = 0;
+			pendingSize = 0;
+		}
+
+		void Consume(const uint8_t* stripe)
+		{
+			for (int i = 0; i < 4; ++i)
+				lanes[i] = XxRound(lanes[i], LoadLE64(stripe + 8 * i));
+		}
+
+		void Update(const uint8_t* data, size_t size)
+		{
+			length += size;
+			if (pendingSize + size < sizeof(pending))
+			{
+				memcpy(pending + pendingSize, data, size);
+				pendingSize += size;
+				return;
+			}
+			if (pendingSize)
+			{
+				size_t fill = sizeof(pending) - pendingSize;
+				memcpy(pending + pendingSize, data, fill);
+				Consume(pending);
+				data += fill;
+				size -= fill;
+				pendingSize = 0;
+			}
+			for (; size >= sizeof(pending); data += sizeof(pending), size -= sizeof(pending))
+				Consume(data);
+			memcpy(pending, data, size);
+			pendingSize = size;
+		}
+
+		uint64_t Digest(void) const
+		{
+			uint64_t hash = kXxPrime5;
+			if (length >= sizeof(pending))
+			{
+				hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+				for (int i = 0; i < 4; ++i)
+					hash = XxMerge(hash, lanes[i]);
+			}
+			hash += length;
+
+			const uint8_t* p = pending;
+			const uint8_t* end = pending + pendingSize;
+			for (; p + 8 <= end; p += 8)
+				hash = RotateLeft(hash ^ XxRound(0, LoadLE64(p)), 27) * kXxPrime1 + kXxPrime4;
+			if (p + 4 <= end)
+			{
+				hash = RotateLeft(hash ^ (uint64_t(LoadLE32(p)) * kXxPrime1), 23) * kXxPrime2 + kXxPrime3;
+				p += 4;
+			}
+			for (; p < end; ++p)
+				hash = RotateLeft(hash ^ (*p * kXxPrime5), 11) * kXxPrime1;
+
+			hash ^= hash >> 33;
+			hash *= kXxPrime2;
+			hash ^= hash >> 29;
+			hash *= kXxPrime3;
+			hash ^= hash >> 32;
+			return hash;
+		}
+	};
+
+	// Canonical Huffman code of a deflate block. Codes up to kInflateFastBits long resolve with
+	// one lookup of their bit-reversed prefix; longer ones walk count and symbols a bit at a time.
+	struct InflateTable
+	{
+		uint16_t	fast[1 << kInflateFastBits];	// symbol << 4 | length, or 0
+		uint16_t	count[16];						// codes of each length
+		uint16_t	symbols[288];					// in code order
+	};
+
+	// Over-subscribed codes fail; incomplete ones are allowed and fail only when a missing code is read.
+	bool BuildInflateTable(const uint8_t* lengths, uint32_t symbolCount, InflateTable& table)
+	{
+		memset(table.count, 0, sizeof(table.count));
+		for (uint32_t i = 0; i < symbolCount; ++i)
+			++table.count[lengths[i]];
+		table.count[0] = 0;
+
+		int left = 1;
+		for (uint32_t length = 1; length < 16; ++length)
+		{
+			left = (left << 1) - table.count[length];
+			if (left < 0)
+				return false;
+		}
+
+		uint16_t offsets[16];
+		offsets[1] = 0;
+		for (uint32_t length = 1; length < 15; ++length)
+			offsets[length + 1] = offsets[length] + table.count[length];
+		for (uint32_t i = 0; i < symbolCount; ++i)
+		{
+			if (lengths[i])
+				table.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+		}
+
+		memset(table.fast, 0, sizeof(table.fast));
+		uint32_t code = 0;
+		uint32_t index = 0;
+		for (uint32_t length = 1; length <= kInflateFastBits; ++length)
+		{
+			for (uint32_t i = 0; i < table.count[length]; ++i, ++code, ++index)
+			{
+				uint32_t reversed = 0;
+				for (uint32_t bit = 0; bit < length; ++bit)
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+				uint16_t entry = static_cast<uint16_t>((table.symbols[index] << 4) | length);
+				for (uint32_t slot = reversed; slot < (1u << kInflateFastBits); slot += 1u << length)
+					table.fast[slot] = entry;
+			}
+			code <<= 1;
+		}
+		return true;
+	}
+
+	// A zstd backward bit stream: read from the end of the data towards its start, after the
+	// 1 bit that marks where the last byte's padding ends.
+	struct BackwardBits
+	{
+		const uint8_t*	data;
+		size_t			size;
+		int64_t			position;	// bits left; negative once reads went past the start
+
+		bool Init(const uint8_t* bytes, size_t count)
+		{
+			if (!count || !bytes[count - 1])
+				return false;
+			data = bytes;
+			size = count;
+			position = static_cast<int64_t>(count) * 8 - 8 + HighBit(bytes[count - 1]);
+			return true;
+		}
+
+		// count is at most 56. Bits before the start of the stream read as zeros.
+		uint64_t Peek(uint32_t count) const
+		{
+			if (!count)
+				return 0;
+			int64_t low = position - count;
+			uint64_t value = 0;
+			if (low >= 0)
+			{
+				size_t byte = static_cast<size_t>(low >> 3);
+				memcpy(&value, data + byte, std::min<size_t>(8, size - byte));
+				value >>= low & 7;
+			}
+			else if (position > 0)
+			{
+				memcpy(&value, data, std::min<size_t>(8, size));
+				value <<= -low;
+			}
+			return value & ((1ull << count) - 1);
+		}
+
+		uint64_t Read(uint32_t count)
+		{
+			uint64_t value = Peek(count);
+			position -= count;
+			return value;
+		}
+	};
+
+	struct FseEntry
+	{
+		uint16_t	base;		// next state before the bits read are added
+		uint8_t		symbol;
+		uint8_t		bits;
+	};
+
+	struct FseTable
+	{
+		FseEntry	entries[1 << 9];
+		uint32_t	accuracyLog;
+	};
+
+	// Reads the normalized counts an FSE table is built from. Bits past the end read as zeros
+	// so that the last count can be peeked, but using them fails.
+	bool ReadFseDescription(const uint8_t* data, size_t size, uint32_t maxSymbol, uint32_t maxAccuracy, int16_t* outCounts, uint32_t& outSymbolCount,
+		uint32_t& outAccuracyLog, size_t& outConsumed)
+	{
+		const uint64_t totalBits = static_cast<uint64_t>(size) * 8;
+		uint64_t bit = 0;
+		auto peek = [&](uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint64_t at = bit + i;
+				if (at < totalBits)
+					value |= ((data[at >> 3] >> (at & 7)) & 1u) << i;
+			}
+			return value;
+		};
+
+		if (totalBits < 4)
+			return false;
+		uint32_t accuracyLog = peek(4) + 5;
+		bit += 4;
+		if (accuracyLog > maxAccuracy)
+			return false;
+
+		int32_t remaining = (1 << accuracyLog) + 1;
+		int32_t threshold = 1 << accuracyLog;
+		uint32_t bitCount = accuracyLog + 1;
+		uint32_t symbol = 0;
+		bool previousZero = false;
+		while (remaining > 1)
+		{
+			if (previousZero)
+			{
+				// A zero count is followed by 2-bit repeat counts of further zeros, 3 meaning more follow.
+				uint32_t repeat;
+				do
+				{
+					repeat = peek(2);
+					bit += 2;
+					for (uint32_t i = 0; i < repeat; ++i)
+					{
+						if (symbol > maxSymbol)
+							return false;
+						outCounts[symbol++] = 0;
+					}
+				}
+				while (repeat == 3 && bit <= totalBits);
+			}
+			if (symbol > maxSymbol || bit > totalBits)
+				return false;
+
+			// Values below max fit in one bit fewer.
+			int32_t max = (2 * threshold - 1) - remaining;
+			uint32_t value = peek(bitCount);
+			int32_t count;
+			if (static_cast<int32_t>(value & (threshold - 1)) < max)
+			{
+				count = value & (threshold - 1);
+				bit += bitCount - 1;
+			}
+			else
+			{
+				count = value & (2 * threshold - 1);
+				if (count >= threshold)
+					count -= max;
+				bit += bitCount;
+			}
+			--count;	// -1 is a probability below one
+			remaining -= count < 0 ? -count : count;
+			outCounts[symbol++] = static_cast<int16_t>(count);
+			previousZero = count == 0;
+			if (remaining < 1 || bit > totalBits)
+				return false;
+			while (remaining < threshold)
+			{
+				--bitCount;
+				threshold >>= 1;
+			}
+		}
+
+		outSymbolCount = symbol;
+		outAccuracyLog = accuracyLog;
+		outConsumed = static_cast<size_t>((bit + 7) / 8);
+		return true;
+	}
+
+	bool BuildFseTable(const int16_t* counts, uint32_t symbolCount, uint32_t accuracyLog, FseTable& table)
+	{
+		const int32_t size = 1 << accuracyLog;
+		int32_t high = size - 1;
+		uint16_t next[256];
+		for (uint32_t s = 0; s < symbolCount; ++s)
+		{
+			if (counts[s] == -1)
+			{
+				// Below-one probabilities take a state each at the top of the table.
+				if (high < 0)
+					return false;
+				table.entries[high--].symbol = static_cast<uint8_t>(s);
+				next[s] = 1;
+			}
+			else
+			{
+				next[s] = static_cast<uint16_t>(counts[s]);
+			}
+		}
+
+		const int32_t step = (size >> 1) + (size >> 3) + 3;
+		int32_t position = 0;
+		for (uint32_t s = 0; s < symbolCount; ++s)
+		{
+			for (int32_t i = 0; i < counts[s]; ++i)
+			{
+				table.entries[position].symbol = static_cast<uint8_t>(s);
+				do
+				{
+					position = (position + step) & (size - 1);
+				}
+				while (position > high);
+			}
+		}
+		if (position != 0)
+			return false;
+
+		for (int32_t u = 0; u < size; ++u)
+		{
+			FseEntry& entry = table.entries[u];
+			uint32_t state = next[entry.symbol]++;
+			entry.bits = static_cast<uint8_t>(accuracyLog - HighBit(state));
+			entry.base = static_cast<uint16_t>((state << entry.bits) - size);
+		}
+		table.accuracyLog = accuracyLog;
+		return true;
+	}
+
+	// Sets up the table one of a block's sequence fields is coded with.
+	bool ReadSequenceTable(uint32_t mode, const uint8_t*& p, const uint8_t* end, const int16_t* defaults, uint32_t defaultCount, uint32_t defaultAccuracy,
+		uint32_t maxSymbol, uint32_t maxAccuracy, FseTable& table, bool& hasTable)
+	{
+		switch (mode)
+		{
+		case 0:	// predefined
+			BuildFseTable(defaults, defaultCount, defaultAccuracy, table);
+			break;
+		case 1:	// one symbol repeated
+			if (p >= end || *p > maxSymbol)
+				return false;
+			table.entries[0].symbol = *p++;
+			table.entries[0].bits = 0;
+			table.entries[0].base = 0;
+			table.accuracyLog = 0;
+			break;
+		case 2:	// sent with the block
+		{
+			int16_t counts[256];
+			uint32_t symbolCount, accuracyLog;
+			size_t consumed;
+			if (!ReadFseDescription(p, end - p, maxSymbol, maxAccuracy, counts, symbolCount, accuracyLog, consumed) ||
+				!BuildFseTable(counts, symbolCount, accuracyLog, table))
+			{
+				return false;
+			}
+			p += consumed;
+			break;
+		}
+		default:	// the previous block's
+			if (!hasTable)
+				return false;
+			break;
+		}
+		hasTable = true;
+		return true;
+	}
+
+	struct HuffmanEntry
+	{
+		uint8_t	symbol;
+		uint8_t	bits;
+	};
+
+	// Literal code of a zstd block, indexed by the next maxBits bits of the stream.
+	struct ZstdHuffman
+	{
+		HuffmanEntry	entries[1 << 11];
+		uint32_t		maxBits;
+	};
+
+	bool ReadHuffmanTree(const uint8_t* data, size_t size, ZstdHuffman& table, size_t& outConsumed)
+	{
+		if (size < 1)
+			return false;
+
+		uint8_t weights[256];
+		uint32_t count = 0;
+		uint32_t header = data[0];
+		if (header >= 128)
+		{
+			// Weights stored directly, 4 bits each.
+			count = header - 127;
+			outConsumed = 1 + (count + 1) / 2;
+			if (outConsumed > size)
+				return false;
+			for (uint32_t i = 0; i < count; ++i)
+				weights[i] = (i & 1) ? data[1 + i / 2] & 15 : data[1 + i / 2] >> 4;
+		}
+		else
+		{
+			// Weights compressed with FSE, two states interleaved until the stream runs out.
+			outConsumed = 1 + header;
+			if (outConsumed > size)
+				return false;
+			int16_t counts[256];
+			uint32_t symbolCount, accuracyLog;
+			size_t descriptionSize;
+			FseTable fse;
+			BackwardBits bits;
+			if (!ReadFseDescription(data + 1, header, 255, 6, counts, symbolCount, accuracyLog, descriptionSize) ||
+				!BuildFseTable(counts, symbolCount, accuracyLog, fse) ||
+				!bits.Init(data + 1 + descriptionSize, header - descriptionSize))
+			{
+				return false;
+			}
+
+			uint32_t states[2];
+			states[0] = static_cast<uint32_t>(bits.Read(accuracyLog));
+			states[1] = static_cast<uint32_t>(bits.Read(accuracyLog));
+			for (uint32_t current = 0;; current ^= 1)
+			{
+				if (count >= 255)
+					return false;
+				const FseEntry& entry = fse.entries[states[current]];
+				weights[count++] = entry.symbol;
+				states[current] = entry.base + static_cast<uint32_t>(bits.Read(entry.bits));
+				if (bits.position < 0)
+				{
+					if (count >= 255)
+						return false;
+					weights[count++] = fse.entries[states[current ^ 1]].symbol;
+					break;
+				}
+			}
+		}
+
+		// The last weight is implied: it completes the total to the next power of two.
+		uint32_t rankCount[13] = { 0 };
+		uint32_t total = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (weights[i] > 11)
+				return false;
+			++rankCount[weights[i]];
+			total += weights[i] ? 1u << (weights[i] - 1) : 0;
+		}
+		if (!total)
+			return false;
+		uint32_t maxBits = HighBit(total) + 1;
+		uint32_t rest = (1u << maxBits) - total;
+		if (maxBits > 11 || (rest & (rest - 1)))
+			return false;
+		uint32_t lastWeight = HighBit(rest) + 1;
+		weights[count++] = static_cast<uint8_t>(lastWeight);
+		++rankCount[lastWeight];
+
+		// Longer codes (lower weights) take the lower table slots.
+		uint32_t next[13];
+		next[1] = 0;
+		for (uint32_t weight = 1; weight < maxBits; ++weight)
+			next[weight + 1] = next[weight] + (rankCount[weight] << (weight - 1));
+		for (uint32_t s = 0; s < count; ++s)
+		{
+			uint32_t weight = weights[s];
+			if (!weight)
+				continue;
+			HuffmanEntry entry = { static_cast<uint8_t>(s), static_cast<uint8_t>(maxBits + 1 - weight) };
+			uint32_t length = 1u << (weight - 1);
+			for (uint32_t i = 0; i < length; ++i)
+				table.entries[next[weight] + i] = entry;
+			next[weight] += length;
+		}
+		table.maxBits = maxBits;
+		return true;
+	}
+
+	// A Huffman stream must decode to exactly count symbols using every bit.
+	bool DecodeHuffmanStream(const ZstdHuffman& table, const uint8_t* data, size_t size, uint8_t* out, size_t count)
+	{
+		BackwardBits bits;
+		if (!bits.Init(data, size))
+			return false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const HuffmanEntry& entry = table.entries[bits.Peek(table.maxBits)];
+			out[i] = entry.symbol;
+			bits.position -= entry.bits;
+		}
+		return bits.position == 0;
+	}
+}
+
+struct CompressedFile::InflateState
+{
+	enum Stage
+	{
+		INFLATE_MEMBER,		// gzip header next
+		INFLATE_BLOCK,		// deflate block header next
+		INFLATE_STORED,
+		INFLATE_CODES,
+		INFLATE_TRAILER,
+	};
+
+	Stage				stage;
+	bool				lastBlock;
+	uint32_t			storedLeft;
+	uint32_t			crc;
+	const InflateTable*	lengthCodes;	// literals and lengths of the current block
+	const InflateTable*	distanceCodes;
+	InflateTable		dynamicLengths;
+	InflateTable		dynamicDistances;
+	InflateTable		fixedLengths;
+	InflateTable		fixedDistances;
+	bool				fixedBuilt;
+};
+
+struct CompressedFile::ZstdState
+{
+	enum Stage
+	{
+		ZSTD_FRAME,		// frame or skippable frame header next
+		ZSTD_BLOCK,
+		ZSTD_FRAME_END,
+	};
+
+	Stage					stage;
+	bool					hasChecksum;
+	uint64_t				contentSize;	// UINT64_MAX when the frame does not say
+	size_t					blockMax;
+	Xxh64					hash;
+	ZstdHuffman				huffman;
+	bool					hasHuffman;
+	FseTable				tables[3];		// literal lengths, offsets, match lengths
+	bool					hasTable[3];
+	uint64_t				repeats[3];		// the last three offsets, most recent first
+	std::vector<uint8_t>	literals;
+	const uint8_t*			literalData;	// this block's literals, in literals or the block itself
+	size_t					literalCount;
+};
+
+CompressionFormat DX::DetectCompression(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	if (size >= 3 && bytes[0] == 0x1F && bytes[1] == 0x8B && bytes[2] == 8)
+		return COMPRESSION_GZIP;
+	if (size >= 4 && (LoadLE32(bytes) == kZstdMagic || (LoadLE32(bytes) & ~15u) == kZstdSkippableMagic))
+		return COMPRESSION_ZSTD;
+	return COMPRESSION_NONE;
+}
+
+CompressedFile::CompressedFile(void) :
+	m_file(nullptr),
+	m_input(nullptr),
+	m_inputBegin(0),
+	m_inputEnd(0),
+	m_inputLoaded(0),
+	m_format(COMPRESSION_NONE),
+	m_failed(false),
+	m_ended(false),
+	m_window(0),
+	m_outputBegin(0),
+	m_outputEnd(0),
+	m_produced(0),
+	m_bytesRead(0),
+	m_bitBuffer(0),
+	m_bitCount(0)
+{
+}
+
+CompressedFile::~CompressedFile(void)
+{
+	Close();
+}
+
+bool CompressedFile::Open(const char* path, size_t bufferSize)
+{
+	Close();
+	m_file = OpenFile(path, "rb");
+	if (!m_file)
+		return false;
+	m_buffer.resize(std::max(bufferSize, kZstdMaxBlock + 64));
+	m_input = m_buffer.data();
+	return Start();
+}
+
+#if defined(_WIN32)
+bool CompressedFile::Open(const wchar_t* path, size_t bufferSize)
+{
+	Close();
+	m_file = OpenFile(path, L"rb");
+	if (!m_file)
+		return false;
+	m_buffer.resize(std::max(bufferSize, kZstdMaxBlock + 64));
+	m_input = m_buffer.data();
+	return Start();
+}
+#endif
+
+bool CompressedFile::Open(const void* data, size_t size)
+{
+	Close();
+	m_input = static_cast<const uint8_t*>(data);
+	m_inputEnd = size;
+	m_inputLoaded = size;
+	return Start();
+}
+
+void CompressedFile::Close(void)
+{
+	if (m_file)
+		fclose(m_file);
+	m_file = nullptr;
+	m_input = nullptr;
+	m_inputBegin = m_inputEnd = 0;
+	std::vector<uint8_t>().swap(m_buffer);
+	m_inputLoaded = 0;
+	m_format = COMPRESSION_NONE;
+	m_failed = m_ended = false;
+	std::vector<uint8_t>().swap(m_history);
+	m_window = 0;
+	m_outputBegin = m_outputEnd = 0;
+	m_produced = m_bytesRead = 0;
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+	m_inflate.reset();
+	m_zstd.reset();
+}
+
+bool CompressedFile::Start(void)
+{
+	Refill(4);
+	m_format = DetectCompression(m_input + m_inputBegin, m_inputEnd - m_inputBegin);
+	if (m_format == COMPRESSION_GZIP)
+	{
+		m_inflate.reset(new InflateState());
+		m_inflate->stage = InflateState::INFLATE_MEMBER;
+		m_inflate->fixedBuilt = false;
+		m_window = kDeflateWindow;
+		m_history.resize(kDeflateWindow + kInflateStep + kDeflateMaxMatch);
+	}
+	else if (m_format == COMPRESSION_ZSTD)
+	{
+		// The history is sized once each frame has said how large its window is.
+		m_zstd.reset(new ZstdState());
+		m_zstd->stage = ZstdState::ZSTD_FRAME;
+		m_zstd->literals.resize(kZstdMaxBlock);
+	}
+	return !m_failed;
+}
+
+size_t CompressedFile::Read(void* buffer, size_t size)
+{
+	uint8_t* out = static_cast<uint8_t*>(buffer);
+	size_t done = 0;
+	while (done < size && !m_failed)
+	{
+		if (m_format == COMPRESSION_NONE)
+		{
+			if (m_inputBegin == m_inputEnd)
+			{
+				// Large reads of a plain file skip the buffer.
+				if (m_file && size - done >= m_buffer.size())
+				{
+					size_t read = fread(out + done, 1, size - done, m_file);
+					m_inputLoaded += read;
+					done += read;
+					if (!read)
+					{
+						m_failed = ferror(m_file) != 0;
+						break;
+					}
+					continue;
+				}
+				if (!Refill(1))
+					break;
+			}
+			size_t count = std::min(size - done, m_inputEnd - m_inputBegin);
+			memcpy(out + done, m_input + m_inputBegin, count);
+			m_inputBegin += count;
+			done += count;
+			continue;
+		}
+
+		if (m_outputBegin == m_outputEnd)
+		{
+			if (m_ended)
+				break;
+			if (!(m_format == COMPRESSION_GZIP ? Inflate() : DecodeZstd()))
+				m_failed = true;
+			continue;
+		}
+		size_t count = std::min(size - done, m_outputEnd - m_outputBegin);
+		memcpy(out + done, m_history.data() + m_outputBegin, count);
+		m_outputBegin += count;
+		done += count;
+	}
+	m_bytesRead += done;
+	return done;
+}
+
+bool CompressedFile::Skip(uint64_t size)
+{
+	uint8_t scratch[4096];
+	while (size)
+	{
+		size_t count = static_cast<size_t>(std::min<uint64_t>(size, sizeof(scratch)));
+		if (Read(scratch, count) != count)
+			return false;
+		size -= count;
+	}
+	return true;
+}
+
+// Makes at least size unread input bytes contiguous at m_input + m_inputBegin.
+bool CompressedFile::Refill(size_t size)
+{
+	size_t available = m_inputEnd - m_inputBegin;
+	if (available >= size)
+		return true;
+	if (!m_file || size > m_buffer.size())
+		return false;
+
+	memmove(m_buffer.data(), m_buffer.data() + m_inputBegin, available);
+	m_inputBegin = 0;
+	m_inputEnd = available;
+	while (m_inputEnd < size)
+	{
+		size_t read = fread(m_buffer.data() + m_inputEnd, 1, m_buffer.size() - m_inputEnd, m_file);
+		if (!read)
+		{
+			m_failed = m_failed || ferror(m_file) != 0;
+			return false;
+		}
+		m_inputEnd += read;
+		m_inputLoaded += read;
+	}
+	return true;
+}
+
+bool CompressedFile::ReadInput(uint8_t* out, size_t size)
+{
+	while (size)
+	{
+		if (m_inputBegin == m_inputEnd && !Refill(1))
+			return false;
+		size_t count = std::min(size, m_inputEnd - m_inputBegin);
+		memcpy(out, m_input + m_inputBegin, count);
+		m_inputBegin += count;
+		out += count;
+		size -= count;
+	}
+	return true;
+}
+
+bool CompressedFile::SkipInput(uint64_t size)
+{
+	while (size)
+	{
+		if (m_inputBegin == m_inputEnd && !Refill(1))
+			return false;
+		size_t count = static_cast<size_t>(std::min<uint64_t>(size, m_inputEnd - m_inputBegin));
+		m_inputBegin += count;
+		size -= count;
+	}
+	return true;
+}
+
+bool CompressedFile::IsInputAtEnd(void)
+{
+	return m_inputBegin == m_inputEnd && !Refill(1);
+}
+
+// Makes room for size more output bytes, sliding the history down once the buffer is full.
+// Decoding only runs once the reader has caught up, so nothing unread is moved.
+void CompressedFile::ReserveOutput(size_t size)
+{
+	if (m_outputEnd + size <= m_history.size())
+		return;
+	size_t keep = std::min(m_outputEnd, m_window);
+	memmove(m_history.data(), m_history.data() + m_outputEnd - keep, keep);
+	m_outputBegin = m_outputEnd = keep;
+}
+
+bool CompressedFile::NeedBits(uint32_t count)
+{
+	while (m_bitCount < count)
+	{
+		if (m_inputBegin == m_inputEnd && !Refill(1))
+			return false;
+		m_bitBuffer |= static_cast<uint64_t>(m_input[m_inputBegin++]) << m_bitCount;
+		m_bitCount += 8;
+	}
+	return true;
+}
+
+bool CompressedFile::ReadBits(uint32_t count, uint32_t& out)
+{
+	if (!NeedBits(count))
+		return false;
+	out = static_cast<uint32_t>(m_bitBuffer & ((1ull << count) - 1));
+	m_bitBuffer >>= count;
+	m_bitCount -= count;
+	return true;
+}
+
+bool CompressedFile::DecodeSymbol(bool distance, uint32_t& outSymbol)
+{
+	const InflateTable& table = distance ? *m_inflate->distanceCodes : *m_inflate->lengthCodes;
+
+	// The stream may end less than a longest code after the last symbol, so take what is there.
+	NeedBits(15);
+	uint32_t entry = table.fast[m_bitBuffer & ((1u << kInflateFastBits) - 1)];
+	if (entry && (entry & 15) <= m_bitCount)
+	{
+		m_bitBuffer >>= entry & 15;
+		m_bitCount -= entry & 15;
+		outSymbol = entry >> 4;
+		return true;
+	}
+
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for (uint32_t length = 1; length < 16 && length <= m_bitCount; ++length)
+	{
+		code |= (m_bitBuffer >> (length - 1)) & 1;
+		int count = table.count[length];
+		if (code - count < first)
+		{
+			m_bitBuffer >>= length;
+			m_bitCount -= length;
+			outSymbol = table.symbols[index + (code - first)];
+			return true;
+		}
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return false;
+}
+
+// Reads whole bytes once the bit reader is on a byte boundary, starting with the ones it holds.
+bool CompressedFile::ReadAlignedBytes(uint8_t* out, size_t size)
+{
+	for (; size && m_bitCount >= 8; --size)
+	{
+		*out++ = static_cast<uint8_t>(m_bitBuffer);
+		m_bitBuffer >>= 8;
+		m_bitCount -= 8;
+	}
+	return ReadInput(out, size);
+}
+
+bool CompressedFile::ReadGzipHeader(void)
+{
+	uint8_t header[10];
+	if (!ReadAlignedBytes(header, sizeof(header)) || header[0] != 0x1F || header[1] != 0x8B || header[2] != 8 || (header[3] & 0xE0))
+		return false;
+
+	uint8_t flags = header[3];
+	uint8_t field[2];
+	if (flags & 4)	// FEXTRA
+	{
+		if (!ReadAlignedBytes(field, 2))
+			return false;
+		for (uint32_t left = LoadLE16(field); left; --left)
+		{
+			if (!ReadAlignedBytes(field, 1))
+				return false;
+		}
+	}
+	for (uint8_t text = 8; text <= 16; text <<= 1)	// FNAME, FCOMMENT
+	{
+		if (!(flags & text))
+			continue;
+		do
+		{
+			if (!ReadAlignedBytes(field, 1))
+				return false;
+		}
+		while (field[0]);
+	}
+	return !(flags & 2) || ReadAlignedBytes(field, 2);	// FHCRC
+}
+
+bool CompressedFile::ReadDynamicTables(void)
+{
+	InflateState& state = *m_inflate;
+	uint32_t lengthCount, distanceCount, codeLengthCount;
+	if (!ReadBits(5, lengthCount) || !ReadBits(5, distanceCount) || !ReadBits(4, codeLengthCount))
+		return false;
+	lengthCount += 257;
+	distanceCount += 1;
+	codeLengthCount += 4;
+	if (lengthCount > 286 || distanceCount > 30)
+		return false;
+
+	uint8_t codeLengths[19] = { 0 };
+	for (uint32_t i = 0; i < codeLengthCount; ++i)
+	{
+		uint32_t length;
+		if (!ReadBits(3, length))
+			return false;
+		codeLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(length);
+	}
+	// The code length code is read through the literal table, which is rebuilt below.
+	if (!BuildInflateTable(codeLengths, 19, state.dynamicLengths))
+		return false;
+	state.lengthCodes = &state.dynamicLengths;
+
+	uint8_t lengths[286 + 30];
+	for (uint32_t i = 0; i < lengthCount + distanceCount;)
+	{
+		uint32_t symbol;
+		if (!DecodeSymbol(false, symbol))
+			return false;
+		if (symbol < 16)
+		{
+			lengths[i++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint32_t repeat;
+		uint8_t value = 0;
+		if (symbol == 16)
+		{
+			if (!i || !ReadBits(2, repeat))
+				return false;
+			value = lengths[i - 1];
+			repeat += 3;
+		}
+		else if (symbol == 17)
+		{
+			if (!ReadBits(3, repeat))
+				return false;
+			repeat += 3;
+		}
+		else
+		{
+			if (!ReadBits(7, repeat))
+				return false;
+			repeat += 11;
+		}
+		if (i + repeat > lengthCount + distanceCount)
+			return false;
+		memset(lengths + i, value, repeat);
+		i += repeat;
+	}
+
+	// A block without an end-of-block code could never finish.
+	return lengths[256] != 0 &&
+		BuildInflateTable(lengths, lengthCount, state.dynamicLengths) &&
+		BuildInflateTable(lengths + lengthCount, distanceCount, state.dynamicDistances);
+}
+
+bool CompressedFile::Inflate(void)
+{
+	InflateState& state = *m_inflate;
+	ReserveOutput(kInflateStep + kDeflateMaxMatch);
+	uint8_t* history = m_history.data();
+	const size_t limit = m_outputEnd + kInflateStep;
+	size_t checked = m_outputEnd;	// the CRC covers the output up to here
+
+	while (m_outputEnd < limit && !m_ended)
+	{
+		switch (state.stage)
+		{
+		case InflateState::INFLATE_MEMBER:
+			if (!ReadGzipHeader())
+				return false;
+			state.crc = 0;
+			state.lastBlock = false;
+			m_produced = 0;
+			state.stage = InflateState::INFLATE_BLOCK;
+			break;
+
+		case InflateState::INFLATE_BLOCK:
+		{
+			if (state.lastBlock)
+			{
+				state.stage = InflateState::INFLATE_TRAILER;
+				break;
+			}
+			uint32_t header;
+			if (!ReadBits(3, header))
+				return false;
+			state.lastBlock = (header & 1) != 0;
+			if ((header >> 1) == 0)
+			{
+				uint8_t sizes[4];
+				m_bitBuffer >>= m_bitCount & 7;
+				m_bitCount &= ~7u;
+				if (!ReadAlignedBytes(sizes, sizeof(sizes)) || LoadLE16(sizes) != (~LoadLE16(sizes + 2) & 0xFFFF))
+					return false;
+				state.storedLeft = LoadLE16(sizes);
+				state.stage = InflateState::INFLATE_STORED;
+			}
+			else if ((header >> 1) == 1)
+			{
+				if (!state.fixedBuilt)
+				{
+					uint8_t lengths[288 + 30];
+					memset(lengths, 8, 144);
+					memset(lengths + 144, 9, 112);
+					memset(lengths + 256, 7, 24);
+					memset(lengths + 280, 8, 8);
+					memset(lengths + 288, 5, 30);
+					BuildInflateTable(lengths, 288, state.fixedLengths);
+					BuildInflateTable(lengths + 288, 30, state.fixedDistances);
+					state.fixedBuilt = true;
+				}
+				state.lengthCodes = &state.fixedLengths;
+				state.distanceCodes = &state.fixedDistances;
+				state.stage = InflateState::INFLATE_CODES;
+			}
+			else if ((header >> 1) == 2)
+			{
+				if (!ReadDynamicTables())
+					return false;
+				state.lengthCodes = &state.dynamicLengths;
+				state.distanceCodes = &state.dynamicDistances;
+				state.stage = InflateState::INFLATE_CODES;
+			}
+			else
+			{
+				return false;
+			}
+			break;
+		}
+
+		case InflateState::INFLATE_STORED:
+		{
+			size_t count = std::min<size_t>(state.storedLeft, limit - m_outputEnd);
+			if (!ReadAlignedBytes(history + m_outputEnd, count))
+				return false;
+			m_outputEnd += count;
+			m_produced += count;
+			state.storedLeft -= static_cast<uint32_t>(count);
+			if (!state.storedLeft)
+				state.stage = InflateState::INFLATE_BLOCK;
+			break;
+		}
+
+		case InflateState::INFLATE_CODES:
+			while (m_outputEnd < limit)
+			{
+				uint32_t symbol;
+				if (!DecodeSymbol(false, symbol))
+					return false;
+				if (symbol < 256)
+				{
+					history[m_outputEnd++] = static_cast<uint8_t>(symbol);
+					++m_produced;
+					continue;
+				}
+				if (symbol == 256)
+				{
+					state.stage = InflateState::INFLATE_BLOCK;
+					break;
+				}
+
+				symbol -= 257;
+				uint32_t extra;
+				if (symbol >= 29 || !ReadBits(kLengthExtra[symbol], extra))
+					return false;
+				size_t length = kLengthBase[symbol] + extra;
+				if (!DecodeSymbol(true, symbol) || symbol >= 30 || !ReadBits(kDistanceExtra[symbol], extra))
+					return false;
+				size_t distance = kDistanceBase[symbol] + extra;
+				if (distance > m_produced)
+					return false;
+				CopyMatch(history + m_outputEnd, distance, length);
+				m_outputEnd += length;
+				m_produced += length;
+			}
+			break;
+
+		case InflateState::INFLATE_TRAILER:
+		{
+			state.crc = UpdateCrc32(state.crc, history + checked, m_outputEnd - checked);
+			checked = m_outputEnd;
+			uint8_t trailer[8];
+			m_bitBuffer >>= m_bitCount & 7;
+			m_bitCount &= ~7u;
+			if (!ReadAlignedBytes(trailer, sizeof(trailer)) || LoadLE32(trailer) != state.crc || LoadLE32(trailer + 4) != static_cast<uint32_t>(m_produced))
+				return false;
+			// Another member may follow; anything else after the last one is an error.
+			if (!m_bitCount && IsInputAtEnd())
+				m_ended = true;
+			else
+				state.stage = InflateState::INFLATE_MEMBER;
+			break;
+		}
+		}
+	}
+
+	state.crc = UpdateCrc32(state.crc, history + checked, m_outputEnd - checked);
+	return true;
+}
+
+bool CompressedFile::ReadZstdFrameHeader(void)
+{
+	ZstdState& state = *m_zstd;
+	if (!Refill(1))
+		return false;
+	uint8_t descriptor = m_input[m_inputBegin];
+	uint32_t contentSizeFlag = descriptor >> 6;
+	bool singleSegment = (descriptor & 0x20) != 0;
+	uint32_t dictionaryFlag = descriptor & 3;
+	if (descriptor & 0x08)	// reserved
+		return false;
+
+	static const uint32_t dictionaryBytes[4] = { 0, 1, 2, 4 };
+	static const uint32_t contentSizeBytes[4] = { 0, 2, 4, 8 };
+	uint32_t contentBytes = contentSizeFlag == 0 && singleSegment ? 1 : contentSizeBytes[contentSizeFlag];
+	size_t headerSize = 1 + (singleSegment ? 0 : 1) + dictionaryBytes[dictionaryFlag] + contentBytes;
+	if (!Refill(headerSize))
+		return false;
+	const uint8_t* p = m_input + m_inputBegin + 1;
+	m_inputBegin += headerSize;
+
+	uint64_t window = 0;
+	if (!singleSegment)
+	{
+		uint64_t base = 1ull << (10 + (*p >> 3));
+		window = base + (base / 8) * (*p & 7);
+		++p;
+	}
+	uint32_t dictionary = 0;
+	for (uint32_t i = 0; i < dictionaryBytes[dictionaryFlag]; ++i)
+		dictionary |= static_cast<uint32_t>(*p++) << (8 * i);
+	if (dictionary)
+		return false;
+
+	state.contentSize = UINT64_MAX;
+	switch (contentBytes)
+	{
+	case 1: state.contentSize = p[0]; break;
+	case 2: state.contentSize = LoadLE16(p) + 256; break;
+	case 4: state.contentSize = LoadLE32(p); break;
+	case 8: state.contentSize = LoadLE64(p); break;
+	}
+	if (singleSegment)
+		window = state.contentSize;
+	if (window > COMPRESSED_MAX_ZSTD_WINDOW)
+		return false;
+
+	m_window = static_cast<size_t>(window);
+	state.blockMax = std::min(m_window, kZstdMaxBlock);
+	// Room for a quarter window past the history keeps sliding it to a few copies per byte. A
+	// single-segment window already holds the whole frame, so it never slides.
+	size_t capacity = m_window + (singleSegment ? state.blockMax : std::max(state.blockMax, m_window / 4));
+	if (m_history.size() < capacity)
+		m_history.resize(capacity);
+	state.hasChecksum = (descriptor & 0x04) != 0;
+	state.hash.Reset();
+	state.hasHuffman = false;
+	state.hasTable[0] = state.hasTable[1] = state.hasTable[2] = false;
+	state.repeats[0] = 1;
+	state.repeats[1] = 4;
+	state.repeats[2] = 8;
+	m_produced = 0;
+	return true;
+}
+
+bool CompressedFile::DecodeZstdLiterals(const uint8_t* data, size_t size, size_t& outConsumed)
+{
+	ZstdState& state = *m_zstd;
+	if (size < 1)
+		return false;
+	uint32_t type = data[0] & 3;
+	uint32_t sizeFormat = (data[0] >> 2) & 3;
+
+	if (type < 2)
+	{
+		// Raw or a single byte repeated, with a 1 to 3 byte header.
+		size_t headerSize = sizeFormat == 1 ? 2 : sizeFormat == 3 ? 3 : 1;
+		if (size < headerSize)
+			return false;
+		size_t count = headerSize == 1 ? data[0] >> 3 : headerSize == 2 ? (data[0] >> 4) + (data[1] << 4) : (data[0] >> 4) + (data[1] << 4) + (data[2] << 12);
+		if (count > state.blockMax)
+			return false;
+		if (type == 0)
+		{
+			if (size - headerSize < count)
+				return false;
+			state.literalData = data + headerSize;
+			outConsumed = headerSize + count;
+		}
+		else
+		{
+			if (size - headerSize < 1)
+				return false;
+			memset(state.literals.data(), data[headerSize], count);
+			state.literalData = state.literals.data();
+			outConsumed = headerSize + 1;
+		}
+		state.literalCount = count;
+		return true;
+	}
+
+	// Huffman coded, with a new tree (type 2) or the previous block's (type 3), in 1 or 4 streams.
+	size_t headerSize = sizeFormat < 2 ? 3 : sizeFormat + 2;
+	uint32_t sizeBits = sizeFormat < 2 ? 10 : sizeFormat == 2 ? 14 : 18;
+	if (size < headerSize)
+		return false;
+	uint64_t header = 0;
+	for (size_t i = 0; i < headerSize; ++i)
+		header |= static_cast<uint64_t>(data[i]) << (8 * i);
+	size_t count = static_cast<size_t>((header >> 4) & ((1u << sizeBits) - 1));
+	size_t compressed = static_cast<size_t>((header >> (4 + sizeBits)) & ((1u << sizeBits) - 1));
+	if (count > state.blockMax || compressed > size - headerSize)
+		return false;
+	const uint8_t* p = data + headerSize;
+	outConsumed = headerSize + compressed;
+
+	if (type == 2)
+	{
+		size_t treeSize;
+		if (!ReadHuffmanTree(p, compressed, state.huffman, treeSize))
+			return false;
+		state.hasHuffman = true;
+		p += treeSize;
+		compressed -= treeSize;
+	}
+	else if (!state.hasHuffman)
+	{
+		return false;
+	}
+
+	uint8_t* out = state.literals.data();
+	if (sizeFormat == 0)
+	{
+		if (!DecodeHuffmanStream(state.huffman, p, compressed, out, count))
+			return false;
+	}
+	else
+	{
+		// A jump table gives the sizes of the first three streams; each decodes a quarter, rounded up.
+		if (compressed < 6)
+			return false;
+		size_t streamSizes[4] = { LoadLE16(p), LoadLE16(p + 2), LoadLE16(p + 4), 0 };
+		size_t used = 6 + streamSizes[0] + streamSizes[1] + streamSizes[2];
+		size_t segment = (count + 3) / 4;
+		if (used > compressed || segment * 3 > count)
+			return false;
+		streamSizes[3] = compressed - used;
+		const uint8_t* stream = p + 6;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			if (!DecodeHuffmanStream(state.huffman, stream, streamSizes[i], out + i * segment, i < 3 ? segment : count - 3 * segment))
+				return false;
+			stream += streamSizes[i];
+		}
+	}
+	state.literalData = out;
+	state.literalCount = count;
+	return true;
+}
+
+bool CompressedFile::DecodeZstdSequences(const uint8_t* data, size_t size)
+{
+	ZstdState& state = *m_zstd;
+	const uint8_t* p = data;
+	const uint8_t* end = data + size;
+	uint8_t* const out = m_history.data() + m_outputEnd;
+	uint8_t* const outEnd = out + state.blockMax;
+	uint8_t* o = out;
+	const uint8_t* literals = state.literalData;
+	const uint8_t* const literalsEnd = literals + state.literalCount;
+
+	if (p >= end)
+		return false;
+	uint32_t sequenceCount = *p++;
+	if (sequenceCount == 255)
+	{
+		if (end - p < 2)
+			return false;
+		sequenceCount = LoadLE16(p) + 0x7F00;
+		p += 2;
+	}
+	else if (sequenceCount >= 128)
+	{
+		if (p >= end)
+			return false;
+		sequenceCount = ((sequenceCount - 128) << 8) + *p++;
+	}
+
+	if (sequenceCount)
+	{
+		if (p >= end || (*p & 3))
+			return false;
+		uint32_t modes = *p++;
+		if (!ReadSequenceTable(modes >> 6, p, end, kDefaultLiteralLengths, 36, 6, 35, 9, state.tables[0], state.hasTable[0]) ||
+			!ReadSequenceTable((modes >> 4) & 3, p, end, kDefaultOffsets, 29, 5, 31, 8, state.tables[1], state.hasTable[1]) ||
+			!ReadSequenceTable((modes >> 2) & 3, p, end, kDefaultMatchLengths, 53, 6, 52, 9, state.tables[2], state.hasTable[2]))
+		{
+			return false;
+		}
+
+		BackwardBits bits;
+		if (!bits.Init(p, end - p))
+			return false;
+		const FseTable& literalTable = state.tables[0];
+		const FseTable& offsetTable = state.tables[1];
+		const FseTable& matchTable = state.tables[2];
+		uint32_t literalState = static_cast<uint32_t>(bits.Read(literalTable.accuracyLog));
+		uint32_t offsetState = static_cast<uint32_t>(bits.Read(offsetTable.accuracyLog));
+		uint32_t matchState = static_cast<uint32_t>(bits.Read(matchTable.accuracyLog));
+		uint64_t* repeats = state.repeats;
+
+		for (uint32_t i = 0; i < sequenceCount; ++i)
+		{
+			const FseEntry& literalEntry = literalTable.entries[literalState];
+			const FseEntry& offsetEntry = offsetTable.entries[offsetState];
+			const FseEntry& matchEntry = matchTable.entries[matchState];
+			uint32_t offsetCode = offsetEntry.symbol;
+			if (offsetCode > 31)
+				return false;
+			uint64_t offsetValue = (1ull << offsetCode) + bits.Read(offsetCode);
+			size_t matchLength = kMatchLengthBase[matchEntry.symbol] + static_cast<size_t>(bits.Read(kMatchLengthExtra[matchEntry.symbol]));
+			size_t literalLength = kLiteralLengthBase[literalEntry.symbol] + static_cast<size_t>(bits.Read(kLiteralLengthExtra[literalEntry.symbol]));
+
+			// Values 1 to 3 pick a recent offset, shifted by one when there are no literals.
+			uint64_t offset;
+			if (offsetValue > 3)
+			{
+				offset = offsetValue - 3;
+				repeats[2] = repeats[1];
+				repeats[1] = repeats[0];
+				repeats[0] = offset;
+			}
+			else
+			{
+				uint32_t index = static_cast<uint32_t>(offsetValue) - 1 + (literalLength == 0 ? 1 : 0);
+				if (index == 0)
+				{
+					offset = repeats[0];
+				}
+				else
+				{
+					offset = index == 3 ? repeats[0] - 1 : repeats[index];
+					if (index > 1)
+						repeats[2] = repeats[1];
+					repeats[1] = repeats[0];
+					repeats[0] = offset;
+				}
+			}
+
+			if (literalLength > static_cast<size_t>(literalsEnd - literals) || literalLength > static_cast<size_t>(outEnd - o))
+				return false;
+			memcpy(o, literals, literalLength);
+			o += literalLength;
+			literals += literalLength;
+
+			if (offset == 0 || offset > m_produced + (o - out) || offset > m_window || matchLength > static_cast<size_t>(outEnd - o))
+				return false;
+			CopyMatch(o, static_cast<size_t>(offset), matchLength);
+			o += matchLength;
+
+			if (i + 1 < sequenceCount)
+			{
+				literalState = literalEntry.base + static_cast<uint32_t>(bits.Read(literalEntry.bits));
+				matchState = matchEntry.base + static_cast<uint32_t>(bits.Read(matchEntry.bits));
+				offsetState = offsetEntry.base + static_cast<uint32_t>(bits.Read(offsetEntry.bits));
+			}
+		}
+		if (bits.position != 0)
+			return false;
+	}
+	else if (p != end)
+	{
+		return false;
+	}
+
+	size_t rest = literalsEnd - literals;
+	if (rest > static_cast<size_t>(outEnd - o))
+		return false;
+	memcpy(o, literals, rest);
+	o += rest;
+
+	m_outputEnd += o - out;
+	m_produced += o - out;
+	return true;
+}
+
+bool CompressedFile::DecodeZstdBlock(const uint8_t* data, size_t size)
+{
+	size_t consumed;
+	return DecodeZstdLiterals(data, size, consumed) && DecodeZstdSequences(data + consumed, size - consumed);
+}
+
+// Decodes until a block produces output or the stream ends.
+bool CompressedFile::DecodeZstd(void)
+{
+	ZstdState& state = *m_zstd;
+	for (;;)
+	{
+		switch (state.stage)
+		{
+		case ZstdState::ZSTD_FRAME:
+		{
+			if (!Refill(4))
+				return false;
+			uint32_t magic = LoadLE32(m_input + m_inputBegin);
+			m_inputBegin += 4;
+			if ((magic & ~15u) == kZstdSkippableMagic)
+			{
+				if (!Refill(4))
+					return false;
+				uint32_t skip = LoadLE32(m_input + m_inputBegin);
+				m_inputBegin += 4;
+				if (!SkipInput(skip))
+					return false;
+				if (IsInputAtEnd())
+				{
+					m_ended = true;
+					return true;
+				}
+				break;
+			}
+			if (magic != kZstdMagic || !ReadZstdFrameHeader())
+				return false;
+			state.stage = ZstdState::ZSTD_BLOCK;
+			break;
+		}
+
+		case ZstdState::ZSTD_BLOCK:
+		{
+			ReserveOutput(state.blockMax);
+			if (!Refill(3))
+				return false;
+			uint32_t header = LoadLE16(m_input + m_inputBegin) | (m_input[m_inputBegin + 2] << 16);
+			m_inputBegin += 3;
+			uint32_t type = (header >> 1) & 3;
+			size_t size = header >> 3;
+			if (size > state.blockMax && type != 2)
+				return false;
+
+			uint8_t* out = m_history.data() + m_outputEnd;
+			size_t before = m_outputEnd;
+			if (type == 0)
+			{
+				if (!ReadInput(out, size))
+					return false;
+				m_outputEnd += size;
+				m_produced += size;
+			}
+			else if (type == 1)
+			{
+				if (!Refill(1))
+					return false;
+				memset(out, m_input[m_inputBegin++], size);
+				m_outputEnd += size;
+				m_produced += size;
+			}
+			else if (type == 2)
+			{
+				// A compressed block is never larger than the largest block, so it fits the buffer whole.
+				if (size > kZstdMaxBlock || !Refill(size))
+					return false;
+				const uint8_t* block = m_input + m_inputBegin;
+				m_inputBegin += size;
+				if (!DecodeZstdBlock(block, size))
+					return false;
+			}
+			else
+			{
+				return false;
+			}
+
+			if (state.hasChecksum)
+				state.hash.Update(out, m_outputEnd - before);
+			if (header & 1)
+				state.stage = ZstdState::ZSTD_FRAME_END;
+			if (m_outputEnd > before)
+				return true;
+			break;
+		}
+
+		case ZstdState::ZSTD_FRAME_END:
+		{
+			if (state.contentSize != UINT64_MAX && m_produced != state.contentSize)
+				return false;
+			if (state.hasChecksum)
+			{
+				if (!Refill(4) || LoadLE32(m_input + m_inputBegin) != static_cast<uint32_t>(state.hash.Digest()))
+					return false;
+				m_inputBegin += 4;
+			}
+			if (IsInputAtEnd())
+			{
+				m_ended = true;
+				return true;
+			}
+			state.stage = ZstdState::ZSTD_FRAME;
+			break;
+		}
+		}
+	}
+}
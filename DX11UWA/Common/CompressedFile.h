@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace DX
+{
+	enum CompressionFormat
+	{
+		COMPRESSION_NONE,
+		COMPRESSION_GZIP,	// RFC 1952
+		COMPRESSION_ZSTD,	// RFC 8878, without dictionaries
+	};
+
+	// Largest zstd window CompressedFile accepts. zstd picks at most 8 MB below level 20 unless
+	// asked for a long window, and the reference decoder stops at the same size.
+	const uint64_t COMPRESSED_MAX_ZSTD_WINDOW = 128ull << 20;
+
+	// Tells gzip and zstd data from anything else by its first bytes. size may be short.
+	CompressionFormat DetectCompression(const void* data, size_t size);
+
+	// Reads a file front to back, decompressing it on the way when it is gzip or zstd, so a
+	// compressed asset can be consumed without ever being whole in memory. Anything else reads as
+	// is. Memory is the input buffer plus the history the format allows back-references into:
+	// 32 KB for gzip, and the window each frame declares for zstd. Concatenated gzip members and
+	// zstd frames read as one stream, and their checksums are checked as each one ends.
+	class CompressedFile
+	{
+	public:
+		CompressedFile(void);
+		~CompressedFile(void);
+
+		// bufferSize is how much compressed input is read at a time; at least a zstd block is kept.
+		bool Open(const char* path, size_t bufferSize = 256 << 10);
+#if defined(_WIN32)
+		bool Open(const wchar_t* path, size_t bufferSize = 256 << 10);
+#endif
+		// Reads from memory the caller keeps alive, such as a MappedFile.
+		bool Open(const void* data, size_t size);
+		void Close(void);
+
+		// Copies up to size decompressed bytes and returns how many were copied. Fewer than size
+		// means the stream ended or is corrupt; HasFailed tells which.
+		size_t Read(void* buffer, size_t size);
+		// Reads exactly size bytes, or returns false.
+		bool ReadAll(void* buffer, size_t size)	{ return Read(buffer, size) == size; }
+		// Reads and throws away size bytes, or returns false.
+		bool Skip(uint64_t size);
+
+		CompressionFormat GetFormat(void) const	{ return m_format; }
+		bool HasFailed(void) const				{ return m_failed; }
+		// Decompressed bytes returned so far.
+		uint64_t GetBytesRead(void) const		{ return m_bytesRead; }
+		// Compressed bytes consumed so far.
+		uint64_t GetInputBytes(void) const		{ return m_inputLoaded - (m_inputEnd - m_inputBegin); }
+		// Input buffer and history held while reading.
+		size_t GetBufferBytes(void) const		{ return m_buffer.size() + m_history.size(); }
+
+	private:
+		CompressedFile(const CompressedFile&);
+		CompressedFile& operator=(const CompressedFile&);
+
+		struct InflateState;
+		struct ZstdState;
+
+		bool Start(void);
+		bool Refill(size_t size);
+		bool ReadInput(uint8_t* out, size_t size);
+		bool SkipInput(uint64_t size);
+		bool IsInputAtEnd(void);
+		void ReserveOutput(size_t size);
+
+		bool NeedBits(uint32_t count);
+		bool ReadBits(uint32_t count, uint32_t& out);
+		bool DecodeSymbol(bool distance, uint32_t& outSymbol);
+		bool ReadAlignedBytes(uint8_t* out, size_t size);
+		bool ReadGzipHeader(void);
+		bool ReadDynamicTables(void);
+		bool Inflate(void);
+
+		bool ReadZstdFrameHeader(void);
+		bool DecodeZstdBlock(const uint8_t* data, size_t size);
+		bool DecodeZstdLiterals(const uint8_t* data, size_t size, size_t& outConsumed);
+		bool DecodeZstdSequences(const uint8_t* data, size_t size);
+		bool DecodeZstd(void);
+
+		FILE*							m_file;
+		const uint8_t*					m_input;		// m_buffer, or the caller's memory
+		size_t							m_inputBegin;	// unread bytes of m_input
+		size_t							m_inputEnd;
+		std::vector<uint8_t>			m_buffer;
+		uint64_t						m_inputLoaded;	// read from the file, or the whole buffer
+		CompressionFormat				m_format;
+		bool							m_failed;
+		bool							m_ended;
+
+		// Decompressed bytes; the ones before m_outputBegin are the history matches copy from.
+		std::vector<uint8_t>			m_history;
+		size_t							m_window;
+		size_t							m_outputBegin;	// unread decompressed bytes
+		size_t							m_outputEnd;
+		uint64_t						m_produced;		// in the current gzip member or zstd frame
+		uint64_t						m_bytesRead;
+
+		uint64_t						m_bitBuffer;	// deflate reads bits LSB first
+		uint32_t						m_bitCount;
+		std::unique_ptr<InflateState>	m_inflate;
+		std::unique_ptr<ZstdState>		m_zstd;
+	};
+}
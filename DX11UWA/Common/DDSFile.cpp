@@ -0,0 +1,684 @@
+﻿#include "DDSFile.h"
+
+#include "CompressedFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t kPixelFormatFourCC = 0x00000004;		// DDPF_FOURCC
+	const uint32_t kPixelFormatRGB = 0x00000040;		// DDPF_RGB
+	const uint32_t kPixelFormatLuminance = 0x00020000;	// DDPF_LUMINANCE
+	const uint32_t kPixelFormatAlpha = 0x00000002;		// DDPF_ALPHA
+
+	const uint32_t kHeaderFlagsTexture = 0x00001007;	// DDSD_CAPS, DDSD_HEIGHT, DDSD_WIDTH and DDSD_PIXELFORMAT
+	const uint32_t kHeaderFlagsHeight = 0x00000002;		// DDSD_HEIGHT
+	const uint32_t kHeaderFlagsPitch = 0x00000008;		// DDSD_PITCH
+	const uint32_t kHeaderFlagsMipMap = 0x00020000;		// DDSD_MIPMAPCOUNT
+	const uint32_t kHeaderFlagsLinearSize = 0x00080000;	// DDSD_LINEARSIZE
+	const uint32_t kHeaderFlagsVolume = 0x00800000;		// DDSD_DEPTH
+
+	const uint32_t kSurfaceFlagsTexture = 0x00001000;	// DDSCAPS_TEXTURE
+	const uint32_t kSurfaceFlagsMipMap = 0x00400008;	// DDSCAPS_COMPLEX and DDSCAPS_MIPMAP
+	const uint32_t kSurfaceFlagsComplex = 0x00000008;	// DDSCAPS_COMPLEX
+
+	const uint32_t kCubeMap = 0x00000200;				// DDSCAPS2_CUBEMAP
+	const uint32_t kCubeMapAllFaces = 0x0000fe00;		// DDSCAPS2_CUBEMAP and all six DDSCAPS2_CUBEMAP_POSITIVEX...
+	const uint32_t kVolume = 0x00200000;				// DDSCAPS2_VOLUME
+
+	const uint32_t kResourceMiscTextureCube = 0x4;		// D3D11_RESOURCE_MISC_TEXTURECUBE
+
+	// Direct3D 11 hardware requirements. Larger metadata is not trusted.
+	const uint32_t kMaxMipLevels = 15;
+	const uint32_t kMaxTexture1DSize = 16384;
+	const uint32_t kMaxTexture2DSize = 16384;
+	const uint32_t kMaxTextureCubeSize = 16384;
+	const uint32_t kMaxTexture3DSize = 2048;
+	const uint32_t kMaxArraySize = 2048;
+
+	inline uint32_t MakeFourCC(char ch0, char ch1, char ch2, char ch3)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(ch0)) | (static_cast<uint32_t>(static_cast<uint8_t>(ch1)) << 8) |
+			(static_cast<uint32_t>(static_cast<uint8_t>(ch2)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(ch3)) << 24);
+	}
+
+	inline bool IsBitMask(const DDS_PIXELFORMAT& pixelFormat, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return pixelFormat.RBitMask == r && pixelFormat.GBitMask == g && pixelFormat.BBitMask == b && pixelFormat.ABitMask == a;
+	}
+
+	inline uint32_t NextMipSize(uint32_t size)
+	{
+		return std::max<uint32_t>(size >> 1, 1);
+	}
+
+	// Dimensions and bytes of one mip. Rows are computed in 64 bits so the largest legal
+	// surfaces do not overflow a 32-bit size_t.
+	void GetMipInfo(uint32_t width, uint32_t height, DXGI_FORMAT format, uint32_t& rowBytes, uint32_t& numRows)
+	{
+		size_t row = 0;
+		size_t rows = 0;
+		GetSurfaceInfo(width, height, format, nullptr, &row, &rows);
+		rowBytes = static_cast<uint32_t>(row);
+		numRows = static_cast<uint32_t>(rows);
+	}
+
+	// The legacy pixel format GetDXGIFormat maps back to format, or false when there is none.
+	bool GetLegacyPixelFormat(DXGI_FORMAT format, DDS_PIXELFORMAT& pixelFormat)
+	{
+		memset(&pixelFormat, 0, sizeof(pixelFormat));
+		pixelFormat.size = sizeof(DDS_PIXELFORMAT);
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+			pixelFormat.flags = kPixelFormatFourCC;
+			pixelFormat.fourCC = MakeFourCC('D', 'X', 'T', '1');
+			return true;
+
+		case DXGI_FORMAT_BC2_UNORM:
+			pixelFormat.flags = kPixelFormatFourCC;
+			pixelFormat.fourCC = MakeFourCC('D', 'X', 'T', '3');
+			return true;
+
+		case DXGI_FORMAT_BC3_UNORM:
+			pixelFormat.flags = kPixelFormatFourCC;
+			pixelFormat.fourCC = MakeFourCC('D', 'X', 'T', '5');
+			return true;
+
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+			pixelFormat.flags = kPixelFormatRGB;
+			pixelFormat.RGBBitCount = 32;
+			pixelFormat.RBitMask = 0x000000ff;
+			pixelFormat.GBitMask = 0x0000ff00;
+			pixelFormat.BBitMask = 0x00ff0000;
+			pixelFormat.ABitMask = 0xff000000;
+			return true;
+
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+			pixelFormat.flags = kPixelFormatRGB;
+			pixelFormat.RGBBitCount = 32;
+			pixelFormat.RBitMask = 0x00ff0000;
+			pixelFormat.GBitMask = 0x0000ff00;
+			pixelFormat.BBitMask = 0x000000ff;
+			pixelFormat.ABitMask = format == DXGI_FORMAT_B8G8R8A8_UNORM ? 0xff000000 : 0;
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	DDSResult CheckLimits(const DDSTextureDesc& desc)
+	{
+		if (desc.mipCount > kMaxMipLevels || desc.width == 0 || desc.height == 0 || desc.depth == 0)
+			return DDS_NOT_SUPPORTED;
+
+		switch (desc.dimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			return (desc.arraySize > kMaxArraySize || desc.width > kMaxTexture1DSize) ? DDS_NOT_SUPPORTED : DDS_OK;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			// The right bound for cube maps too, as arraySize counts faces
+			if (desc.arraySize > kMaxArraySize)
+				return DDS_NOT_SUPPORTED;
+			if (desc.isCubeMap)
+				return (desc.width > kMaxTextureCubeSize || desc.height > kMaxTextureCubeSize) ? DDS_NOT_SUPPORTED : DDS_OK;
+			return (desc.width > kMaxTexture2DSize || desc.height > kMaxTexture2DSize) ? DDS_NOT_SUPPORTED : DDS_OK;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (desc.arraySize > 1 || desc.width > kMaxTexture3DSize || desc.height > kMaxTexture3DSize || desc.depth > kMaxTexture3DSize)
+				return DDS_NOT_SUPPORTED;
+			return DDS_OK;
+
+		default:
+			return DDS_NOT_SUPPORTED;
+		}
+	}
+}
+
+size_t DX::BitsPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+		return 64;
+
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_R32_SINT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return 32;
+
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+		return 8;
+
+	case DXGI_FORMAT_R1_UNORM:
+		return 1;
+
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	default:
+		return 0;
+	}
+}
+
+bool DX::IsBlockCompressed(DXGI_FORMAT format)
+{
+	return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+		(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+void DX::GetSurfaceInfo(size_t width, size_t height, DXGI_FORMAT format, size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows)
+{
+	size_t rowBytes = 0;
+	size_t numRows = 0;
+
+	if (IsBlockCompressed(format))
+	{
+		// 8 bytes a block for 4 bits a texel, 16 for 8
+		const size_t blockBytes = BitsPerPixel(format) * 2;
+		const size_t blocksWide = (width > 0) ? std::max<size_t>(1, (width + 3) / 4) : 0;
+		const size_t blocksHigh = (height > 0) ? std::max<size_t>(1, (height + 3) / 4) : 0;
+		rowBytes = blocksWide * blockBytes;
+		numRows = blocksHigh;
+	}
+	else if (format == DXGI_FORMAT_R8G8_B8G8_UNORM || format == DXGI_FORMAT_G8R8_G8B8_UNORM)
+	{
+		// Packed in pairs of texels
+		rowBytes = ((width + 1) >> 1) * 4;
+		numRows = height;
+	}
+	else
+	{
+		rowBytes = (width * BitsPerPixel(format) + 7) / 8;	// round up to nearest byte
+		numRows = height;
+	}
+
+	if (outNumBytes)
+		*outNumBytes = rowBytes * numRows;
+	if (outRowBytes)
+		*outRowBytes = rowBytes;
+	if (outNumRows)
+		*outNumRows = numRows;
+}
+
+DXGI_FORMAT DX::GetDXGIFormat(const DDS_PIXELFORMAT& pixelFormat)
+{
+	if (pixelFormat.flags & kPixelFormatRGB)
+	{
+		// Note that sRGB formats are written using the "DX10" extended header
+		switch (pixelFormat.RGBBitCount)
+		{
+		case 32:
+			if (IsBitMask(pixelFormat, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (IsBitMask(pixelFormat, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+				return DXGI_FORMAT_B8G8R8A8_UNORM;
+			if (IsBitMask(pixelFormat, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+				return DXGI_FORMAT_B8G8R8X8_UNORM;
+
+			// No DXGI format maps to D3DFMT_X8B8G8R8.
+
+			// Many DDS writers, D3DX included, swap the red and blue masks of 10:10:10:2
+			// formats, so the 'backwards' mask is taken to be what D3DX wrote. No DXGI format
+			// maps to the 'correct' one, D3DFMT_A2R10G10B10.
+			if (IsBitMask(pixelFormat, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
+				return DXGI_FORMAT_R10G10B10A2_UNORM;
+
+			if (IsBitMask(pixelFormat, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+				return DXGI_FORMAT_R16G16_UNORM;
+
+			// Only 32-bit color channel format in D3D9 was R32F; D3DX writes it as a FourCC of 114
+			if (IsBitMask(pixelFormat, 0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+				return DXGI_FORMAT_R32_FLOAT;
+			break;
+
+		case 16:
+			if (IsBitMask(pixelFormat, 0x7c00, 0x03e0, 0x001f, 0x8000))
+				return DXGI_FORMAT_B5G5R5A1_UNORM;
+			if (IsBitMask(pixelFormat, 0xf800, 0x07e0, 0x001f, 0x0000))
+				return DXGI_FORMAT_B5G6R5_UNORM;
+			if (IsBitMask(pixelFormat, 0x0f00, 0x00f0, 0x000f, 0xf000))
+				return DXGI_FORMAT_B4G4R4A4_UNORM;
+
+			// No DXGI format maps to D3DFMT_X1R5G5B5, D3DFMT_X4R4G4B4, 3:3:2 or paletted formats.
+			break;
+
+		// No 24bpp DXGI formats, aka D3DFMT_R8G8B8.
+		}
+	}
+	else if (pixelFormat.flags & kPixelFormatLuminance)
+	{
+		// D3DX10/11 writes these out as the DX10 extension
+		if (pixelFormat.RGBBitCount == 8 && IsBitMask(pixelFormat, 0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+			return DXGI_FORMAT_R8_UNORM;
+		if (pixelFormat.RGBBitCount == 16 && IsBitMask(pixelFormat, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000))
+			return DXGI_FORMAT_R16_UNORM;
+		if (pixelFormat.RGBBitCount == 16 && IsBitMask(pixelFormat, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+			return DXGI_FORMAT_R8G8_UNORM;
+	}
+	else if (pixelFormat.flags & kPixelFormatAlpha)
+	{
+		if (pixelFormat.RGBBitCount == 8)
+			return DXGI_FORMAT_A8_UNORM;
+	}
+	else if (pixelFormat.flags & kPixelFormatFourCC)
+	{
+		const uint32_t fourCC = pixelFormat.fourCC;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+			return DXGI_FORMAT_BC1_UNORM;
+		// Premultiplied alpha is not a DXGI format, but DXT2 and DXT4 are otherwise BC2 and BC3
+		if (fourCC == MakeFourCC('D', 'X', 'T', '3') || fourCC == MakeFourCC('D', 'X', 'T', '2'))
+			return DXGI_FORMAT_BC2_UNORM;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '5') || fourCC == MakeFourCC('D', 'X', 'T', '4'))
+			return DXGI_FORMAT_BC3_UNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U'))
+			return DXGI_FORMAT_BC4_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '4', 'S'))
+			return DXGI_FORMAT_BC4_SNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U'))
+			return DXGI_FORMAT_BC5_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '5', 'S'))
+			return DXGI_FORMAT_BC5_SNORM;
+
+		// BC6H and BC7 are written using the "DX10" extended header
+
+		if (fourCC == MakeFourCC('R', 'G', 'B', 'G'))
+			return DXGI_FORMAT_R8G8_B8G8_UNORM;
+		if (fourCC == MakeFourCC('G', 'R', 'G', 'B'))
+			return DXGI_FORMAT_G8R8_G8B8_UNORM;
+
+		// D3DFORMAT values written as a FourCC
+		switch (fourCC)
+		{
+		case 36:	return DXGI_FORMAT_R16G16B16A16_UNORM;	// D3DFMT_A16B16G16R16
+		case 110:	return DXGI_FORMAT_R16G16B16A16_SNORM;	// D3DFMT_Q16W16V16U16
+		case 111:	return DXGI_FORMAT_R16_FLOAT;			// D3DFMT_R16F
+		case 112:	return DXGI_FORMAT_R16G16_FLOAT;		// D3DFMT_G16R16F
+		case 113:	return DXGI_FORMAT_R16G16B16A16_FLOAT;	// D3DFMT_A16B16G16R16F
+		case 114:	return DXGI_FORMAT_R32_FLOAT;			// D3DFMT_R32F
+		case 115:	return DXGI_FORMAT_R32G32_FLOAT;		// D3DFMT_G32R32F
+		case 116:	return DXGI_FORMAT_R32G32B32A32_FLOAT;	// D3DFMT_A32B32G32R32F
+		}
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+DDSResult DX::ParseDDSHeader(const void* data, size_t size, DDSTextureDesc& desc)
+{
+	memset(&desc, 0, sizeof(desc));
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	if (size < sizeof(uint32_t) + sizeof(DDS_HEADER))
+		return (size >= sizeof(uint32_t) && memcmp(bytes, &DDS_MAGIC, sizeof(uint32_t)) != 0) ? DDS_INVALID_HEADER : DDS_TRUNCATED;
+
+	uint32_t magic;
+	DDS_HEADER header;
+	memcpy(&magic, bytes, sizeof(magic));
+	memcpy(&header, bytes + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC || header.size != sizeof(DDS_HEADER) || header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+		return DDS_INVALID_HEADER;
+
+	desc.width = header.width;
+	desc.height = header.height;
+	desc.depth = header.depth;
+	desc.mipCount = std::max<uint32_t>(header.mipMapCount, 1);
+	desc.arraySize = 1;
+	desc.headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+	if ((header.ddspf.flags & kPixelFormatFourCC) && header.ddspf.fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		if (size < DDS_MAX_HEADER_SIZE)
+			return DDS_TRUNCATED;
+
+		DDS_HEADER_DXT10 ext;
+		memcpy(&ext, bytes + desc.headerSize, sizeof(ext));
+		desc.headerSize += sizeof(DDS_HEADER_DXT10);
+
+		desc.arraySize = ext.arraySize;
+		if (desc.arraySize == 0)
+			return DDS_INVALID_DATA;
+		if (BitsPerPixel(ext.dxgiFormat) == 0)
+			return DDS_NOT_SUPPORTED;
+		desc.format = ext.dxgiFormat;
+
+		switch (ext.resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			// D3DX writes 1D textures with a fixed height of 1
+			if ((header.flags & kHeaderFlagsHeight) && desc.height != 1)
+				return DDS_INVALID_DATA;
+			desc.height = desc.depth = 1;
+			break;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			if (ext.miscFlag & kResourceMiscTextureCube)
+			{
+				if (desc.arraySize > kMaxArraySize / 6)
+					return DDS_NOT_SUPPORTED;
+				desc.arraySize *= 6;
+				desc.isCubeMap = true;
+			}
+			desc.depth = 1;
+			break;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header.flags & kHeaderFlagsVolume))
+				return DDS_INVALID_DATA;
+			break;
+
+		default:
+			return DDS_NOT_SUPPORTED;
+		}
+
+		desc.dimension = static_cast<DDSDimension>(ext.resourceDimension);
+	}
+	else
+	{
+		desc.format = GetDXGIFormat(header.ddspf);
+		if (desc.format == DXGI_FORMAT_UNKNOWN)
+			return DDS_NOT_SUPPORTED;
+
+		if (header.flags & kHeaderFlagsVolume)
+		{
+			desc.dimension = DDS_DIMENSION_TEXTURE3D;
+		}
+		else
+		{
+			// A legacy Direct3D 9 header cannot describe a 1D texture
+			if (header.caps2 & kCubeMap)
+			{
+				// All six faces have to be there
+				if ((header.caps2 & kCubeMapAllFaces) != kCubeMapAllFaces)
+					return DDS_NOT_SUPPORTED;
+				desc.arraySize = 6;
+				desc.isCubeMap = true;
+			}
+			desc.depth = 1;
+			desc.dimension = DDS_DIMENSION_TEXTURE2D;
+		}
+	}
+
+	DDSResult result = CheckLimits(desc);
+	if (result != DDS_OK)
+		return result;
+
+	desc.dataSize = ComputeDDSLayout(desc, nullptr);
+	return DDS_OK;
+}
+
+DDSResult DX::ReadDDSHeader(CompressedFile& stream, void* header, DDSTextureDesc& desc)
+{
+	uint8_t* bytes = static_cast<uint8_t*>(header);
+	const size_t headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER);
+	if (!stream.ReadAll(bytes, headerSize))
+	{
+		memset(&desc, 0, sizeof(desc));
+		return stream.HasFailed() ? DDS_INVALID_DATA : DDS_INVALID_HEADER;
+	}
+
+	// Truncated here means the DX10 extension header follows
+	DDSResult result = ParseDDSHeader(bytes, headerSize, desc);
+	if (result == DDS_TRUNCATED)
+	{
+		if (!stream.ReadAll(bytes + headerSize, sizeof(DDS_HEADER_DXT10)))
+			return stream.HasFailed() ? DDS_INVALID_DATA : DDS_TRUNCATED;
+		result = ParseDDSHeader(bytes, DDS_MAX_HEADER_SIZE, desc);
+	}
+	return result;
+}
+
+DDSResult DX::ValidateDDS(const void* data, uint64_t fileSize, DDSTextureDesc& desc)
+{
+	DDSResult result = ParseDDSHeader(data, static_cast<size_t>(std::min<uint64_t>(fileSize, DDS_MAX_HEADER_SIZE)), desc);
+	if (result != DDS_OK)
+		return result;
+	return (fileSize - desc.headerSize < desc.dataSize) ? DDS_TRUNCATED : DDS_OK;
+}
+
+uint32_t DX::WriteDDSHeader(const DDSTextureDesc& desc, void* header)
+{
+	DDS_HEADER ddsHeader;
+	memset(&ddsHeader, 0, sizeof(ddsHeader));
+	ddsHeader.size = sizeof(DDS_HEADER);
+	ddsHeader.flags = kHeaderFlagsTexture;
+	ddsHeader.width = desc.width;
+	ddsHeader.height = desc.height;
+	ddsHeader.caps = kSurfaceFlagsTexture;
+
+	size_t rowBytes = 0;
+	size_t numBytes = 0;
+	GetSurfaceInfo(desc.width, desc.height, desc.format, &numBytes, &rowBytes, nullptr);
+	ddsHeader.flags |= IsBlockCompressed(desc.format) ? kHeaderFlagsLinearSize : kHeaderFlagsPitch;
+	ddsHeader.pitchOrLinearSize = static_cast<uint32_t>(IsBlockCompressed(desc.format) ? numBytes : rowBytes);
+
+	if (desc.mipCount > 1)
+	{
+		ddsHeader.flags |= kHeaderFlagsMipMap;
+		ddsHeader.mipMapCount = desc.mipCount;
+		ddsHeader.caps |= kSurfaceFlagsMipMap;
+	}
+	if (desc.dimension == DDS_DIMENSION_TEXTURE3D)
+	{
+		ddsHeader.flags |= kHeaderFlagsVolume;
+		ddsHeader.depth = desc.depth;
+		ddsHeader.caps |= kSurfaceFlagsComplex;
+		ddsHeader.caps2 = kVolume;
+	}
+	if (desc.isCubeMap)
+	{
+		ddsHeader.caps |= kSurfaceFlagsComplex;
+		ddsHeader.caps2 = kCubeMapAllFaces;
+	}
+
+	// A legacy header holds one texture, or one cube, and no 1D textures
+	const bool single = desc.isCubeMap ? desc.arraySize == 6 : desc.arraySize == 1;
+	const bool legacy = single && desc.dimension != DDS_DIMENSION_TEXTURE1D && GetLegacyPixelFormat(desc.format, ddsHeader.ddspf);
+
+	uint8_t* bytes = static_cast<uint8_t*>(header);
+	uint32_t size = sizeof(uint32_t) + sizeof(DDS_HEADER);
+	if (!legacy)
+	{
+		memset(&ddsHeader.ddspf, 0, sizeof(ddsHeader.ddspf));
+		ddsHeader.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		ddsHeader.ddspf.flags = kPixelFormatFourCC;
+		ddsHeader.ddspf.fourCC = MakeFourCC('D', 'X', '1', '0');
+
+		DDS_HEADER_DXT10 ext;
+		memset(&ext, 0, sizeof(ext));
+		ext.dxgiFormat = desc.format;
+		ext.resourceDimension = desc.dimension;
+		ext.miscFlag = desc.isCubeMap ? kResourceMiscTextureCube : 0;
+		ext.arraySize = desc.isCubeMap ? desc.arraySize / 6 : desc.arraySize;
+		memcpy(bytes + size, &ext, sizeof(ext));
+		size += sizeof(DDS_HEADER_DXT10);
+	}
+
+	memcpy(bytes, &DDS_MAGIC, sizeof(uint32_t));
+	memcpy(bytes + sizeof(uint32_t), &ddsHeader, sizeof(ddsHeader));
+	return size;
+}
+
+uint64_t DX::ComputeDDSLayout(const DDSTextureDesc& desc, DDSSubresource* subresources)
+{
+	// Every array slice has the same mip sizes, so they are worked out once
+	DDSSubresource mips[kMaxMipLevels];
+	const uint32_t mipCount = std::min(desc.mipCount, kMaxMipLevels);
+	uint64_t sliceSize = 0;
+	uint32_t width = desc.width;
+	uint32_t height = desc.height;
+	uint32_t depth = desc.depth;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		DDSSubresource& info = mips[mip];
+		info.offset = sliceSize;
+		info.width = width;
+		info.height = height;
+		info.depth = depth;
+		GetMipInfo(width, height, desc.format, info.rowBytes, info.numRows);
+		info.sliceBytes = static_cast<uint64_t>(info.rowBytes) * info.numRows;
+		sliceSize += info.sliceBytes * depth;
+
+		width = NextMipSize(width);
+		height = NextMipSize(height);
+		depth = NextMipSize(depth);
+	}
+
+	if (subresources)
+	{
+		for (uint32_t slice = 0; slice < desc.arraySize; ++slice)
+		{
+			for (uint32_t mip = 0; mip < mipCount; ++mip)
+			{
+				*subresources = mips[mip];
+				subresources->offset += sliceSize * slice;
+				++subresources;
+			}
+		}
+	}
+
+	return sliceSize * desc.arraySize;
+}
+
+uint32_t DX::GetDDSSkipMips(const DDSTextureDesc& desc, size_t maxSize)
+{
+	uint32_t skipMip = 0;
+	uint32_t width = desc.width;
+	uint32_t height = desc.height;
+	uint32_t depth = desc.depth;
+	while (maxSize && skipMip + 1 < desc.mipCount && (width > maxSize || height > maxSize || depth > maxSize))
+	{
+		++skipMip;
+		width = NextMipSize(width);
+		height = NextMipSize(height);
+		depth = NextMipSize(depth);
+	}
+	return skipMip;
+}
+
+uint64_t DX::GetDDSLoadedSize(const DDSTextureDesc& desc, uint32_t skipMip)
+{
+	uint64_t skipped = 0;
+	uint32_t width = desc.width;
+	uint32_t height = desc.height;
+	uint32_t depth = desc.depth;
+	for (uint32_t mip = 0; mip < skipMip && mip < desc.mipCount; ++mip)
+	{
+		uint32_t rowBytes = 0;
+		uint32_t numRows = 0;
+		GetMipInfo(width, height, desc.format, rowBytes, numRows);
+		skipped += static_cast<uint64_t>(rowBytes) * numRows * depth;
+
+		width = NextMipSize(width);
+		height = NextMipSize(height);
+		depth = NextMipSize(depth);
+	}
+	return desc.dataSize - skipped * desc.arraySize;
+}
@@ -0,0 +1,242 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <dxgiformat.h>
+#else
+// The values of dxgiformat.h, so DDS files can be read where the Windows SDK is not installed.
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_TYPELESS = 1,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+	DXGI_FORMAT_R32G32B32A32_UINT = 3,
+	DXGI_FORMAT_R32G32B32A32_SINT = 4,
+	DXGI_FORMAT_R32G32B32_TYPELESS = 5,
+	DXGI_FORMAT_R32G32B32_FLOAT = 6,
+	DXGI_FORMAT_R32G32B32_UINT = 7,
+	DXGI_FORMAT_R32G32B32_SINT = 8,
+	DXGI_FORMAT_R16G16B16A16_TYPELESS = 9,
+	DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+	DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+	DXGI_FORMAT_R16G16B16A16_UINT = 12,
+	DXGI_FORMAT_R16G16B16A16_SNORM = 13,
+	DXGI_FORMAT_R16G16B16A16_SINT = 14,
+	DXGI_FORMAT_R32G32_TYPELESS = 15,
+	DXGI_FORMAT_R32G32_FLOAT = 16,
+	DXGI_FORMAT_R32G32_UINT = 17,
+	DXGI_FORMAT_R32G32_SINT = 18,
+	DXGI_FORMAT_R32G8X24_TYPELESS = 19,
+	DXGI_FORMAT_D32_FLOAT_S8X24_UINT = 20,
+	DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS = 21,
+	DXGI_FORMAT_X32_TYPELESS_G8X24_UINT = 22,
+	DXGI_FORMAT_R10G10B10A2_TYPELESS = 23,
+	DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+	DXGI_FORMAT_R10G10B10A2_UINT = 25,
+	DXGI_FORMAT_R11G11B10_FLOAT = 26,
+	DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DXGI_FORMAT_R8G8B8A8_UINT = 30,
+	DXGI_FORMAT_R8G8B8A8_SNORM = 31,
+	DXGI_FORMAT_R8G8B8A8_SINT = 32,
+	DXGI_FORMAT_R16G16_TYPELESS = 33,
+	DXGI_FORMAT_R16G16_FLOAT = 34,
+	DXGI_FORMAT_R16G16_UNORM = 35,
+	DXGI_FORMAT_R16G16_UINT = 36,
+	DXGI_FORMAT_R16G16_SNORM = 37,
+	DXGI_FORMAT_R16G16_SINT = 38,
+	DXGI_FORMAT_R32_TYPELESS = 39,
+	DXGI_FORMAT_D32_FLOAT = 40,
+	DXGI_FORMAT_R32_FLOAT = 41,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R32_SINT = 43,
+	DXGI_FORMAT_R24G8_TYPELESS = 44,
+	DXGI_FORMAT_D24_UNORM_S8_UINT = 45,
+	DXGI_FORMAT_R24_UNORM_X8_TYPELESS = 46,
+	DXGI_FORMAT_X24_TYPELESS_G8_UINT = 47,
+	DXGI_FORMAT_R8G8_TYPELESS = 48,
+	DXGI_FORMAT_R8G8_UNORM = 49,
+	DXGI_FORMAT_R8G8_UINT = 50,
+	DXGI_FORMAT_R8G8_SNORM = 51,
+	DXGI_FORMAT_R8G8_SINT = 52,
+	DXGI_FORMAT_R16_TYPELESS = 53,
+	DXGI_FORMAT_R16_FLOAT = 54,
+	DXGI_FORMAT_D16_UNORM = 55,
+	DXGI_FORMAT_R16_UNORM = 56,
+	DXGI_FORMAT_R16_UINT = 57,
+	DXGI_FORMAT_R16_SNORM = 58,
+	DXGI_FORMAT_R16_SINT = 59,
+	DXGI_FORMAT_R8_TYPELESS = 60,
+	DXGI_FORMAT_R8_UNORM = 61,
+	DXGI_FORMAT_R8_UINT = 62,
+	DXGI_FORMAT_R8_SNORM = 63,
+	DXGI_FORMAT_R8_SINT = 64,
+	DXGI_FORMAT_A8_UNORM = 65,
+	DXGI_FORMAT_R1_UNORM = 66,
+	DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
+	DXGI_FORMAT_R8G8_B8G8_UNORM = 68,
+	DXGI_FORMAT_G8R8_G8B8_UNORM = 69,
+	DXGI_FORMAT_BC1_TYPELESS = 70,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC2_TYPELESS = 73,
+	DXGI_FORMAT_BC2_UNORM = 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+	DXGI_FORMAT_BC3_TYPELESS = 76,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC4_TYPELESS = 79,
+	DXGI_FORMAT_BC4_UNORM = 80,
+	DXGI_FORMAT_BC4_SNORM = 81,
+	DXGI_FORMAT_BC5_TYPELESS = 82,
+	DXGI_FORMAT_BC5_UNORM = 83,
+	DXGI_FORMAT_BC5_SNORM = 84,
+	DXGI_FORMAT_B5G6R5_UNORM = 85,
+	DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+	DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+	DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+	DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM = 89,
+	DXGI_FORMAT_B8G8R8A8_TYPELESS = 90,
+	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DXGI_FORMAT_B8G8R8X8_TYPELESS = 92,
+	DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+	DXGI_FORMAT_BC6H_TYPELESS = 94,
+	DXGI_FORMAT_BC6H_UF16 = 95,
+	DXGI_FORMAT_BC6H_SF16 = 96,
+	DXGI_FORMAT_BC7_TYPELESS = 97,
+	DXGI_FORMAT_BC7_UNORM = 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+	DXGI_FORMAT_B4G4R4A4_UNORM = 115,
+	DXGI_FORMAT_FORCE_UINT = 0xffffffff
+};
+#endif
+
+namespace DX
+{
+	class CompressedFile;
+
+	// DDS file structures, see DDS.h in the DirectXTex library.
+#pragma pack(push, 1)
+	struct DDS_PIXELFORMAT
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	fourCC;
+		uint32_t	RGBBitCount;
+		uint32_t	RBitMask;
+		uint32_t	GBitMask;
+		uint32_t	BBitMask;
+		uint32_t	ABitMask;
+	};
+
+	struct DDS_HEADER
+	{
+		uint32_t		size;
+		uint32_t		flags;
+		uint32_t		height;
+		uint32_t		width;
+		uint32_t		pitchOrLinearSize;
+		uint32_t		depth;	// only if DDS_HEADER_FLAGS_VOLUME is set in flags
+		uint32_t		mipMapCount;
+		uint32_t		reserved1[11];
+		DDS_PIXELFORMAT	ddspf;
+		uint32_t		caps;
+		uint32_t		caps2;
+		uint32_t		caps3;
+		uint32_t		caps4;
+		uint32_t		reserved2;
+	};
+
+	struct DDS_HEADER_DXT10
+	{
+		DXGI_FORMAT	dxgiFormat;
+		uint32_t	resourceDimension;
+		uint32_t	miscFlag;	// see D3D11_RESOURCE_MISC_FLAG
+		uint32_t	arraySize;
+		uint32_t	reserved;
+	};
+#pragma pack(pop)
+
+	const uint32_t DDS_MAGIC = 0x20534444;	// "DDS "
+	const size_t DDS_MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+	// Same values as D3D11_RESOURCE_DIMENSION.
+	enum DDSDimension
+	{
+		DDS_DIMENSION_UNKNOWN = 0,
+		DDS_DIMENSION_TEXTURE1D = 2,
+		DDS_DIMENSION_TEXTURE2D = 3,
+		DDS_DIMENSION_TEXTURE3D = 4,
+	};
+
+	enum DDSResult
+	{
+		DDS_OK,
+		DDS_INVALID_HEADER,		// not a DDS file
+		DDS_INVALID_DATA,		// a DDS file that contradicts itself
+		DDS_NOT_SUPPORTED,		// a valid file in a format or size Direct3D 11 cannot create
+		DDS_TRUNCATED,			// shorter than its layout
+	};
+
+	// What a DDS header describes, once the DX10 extension and legacy pixel formats are resolved.
+	// Cube maps have six array slices per cube. Sizes are within the Direct3D 11 limits.
+	struct DDSTextureDesc
+	{
+		DDSDimension	dimension;
+		DXGI_FORMAT		format;
+		uint32_t		width;
+		uint32_t		height;
+		uint32_t		depth;
+		uint32_t		mipCount;
+		uint32_t		arraySize;
+		bool			isCubeMap;
+		uint32_t		headerSize;		// where the bits start in the file
+		uint64_t		dataSize;		// bytes of bits the layout needs
+	};
+
+	// One mip of one array slice, in D3D11CalcSubresource order: mips of slice 0, then slice 1...
+	// A volume mip is depth slices of sliceBytes each.
+	struct DDSSubresource
+	{
+		uint64_t	offset;		// from the start of the bits
+		uint32_t	width;
+		uint32_t	height;
+		uint32_t	depth;
+		uint32_t	rowBytes;
+		uint32_t	numRows;	// block rows for block compressed formats
+		uint64_t	sliceBytes;
+	};
+
+	// 0 for formats a DDS file cannot hold.
+	size_t BitsPerPixel(DXGI_FORMAT format);
+	bool IsBlockCompressed(DXGI_FORMAT format);
+	// Sizes of one width by height image, with rows of 4x4 blocks for block compressed formats.
+	void GetSurfaceInfo(size_t width, size_t height, DXGI_FORMAT format, size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows);
+	// DXGI_FORMAT_UNKNOWN for legacy pixel formats with no DXGI equivalent.
+	DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& pixelFormat);
+
+	// Parses and validates the magic number and headers at the start of a DDS file; size only
+	// has to cover them. dataSize is filled in but not checked against the file.
+	DDSResult ParseDDSHeader(const void* data, size_t size, DDSTextureDesc& desc);
+	// Reads the headers from the front of a stream into header, which must have room for
+	// DDS_MAX_HEADER_SIZE bytes, and parses them. Only desc.headerSize bytes are read.
+	DDSResult ReadDDSHeader(CompressedFile& stream, void* header, DDSTextureDesc& desc);
+	// Parses the header and checks that a file of fileSize bytes holds all of its bits.
+	DDSResult ValidateDDS(const void* data, uint64_t fileSize, DDSTextureDesc& desc);
+	// Fills header, which must have room for DDS_MAX_HEADER_SIZE bytes, with headers describing
+	// desc and returns their size. Formats a Direct3D 9 header can name get one, so older tools
+	// read the file too; the rest, sRGB formats, 1D textures and arrays get the DX10 extension.
+	uint32_t WriteDDSHeader(const DDSTextureDesc& desc, void* header);
+	// Fills mipCount * arraySize subresources, if not null, and returns the bytes of bits they
+	// cover, which is desc.dataSize.
+	uint64_t ComputeDDSLayout(const DDSTextureDesc& desc, DDSSubresource* subresources);
+
+	// How many of the largest mips to drop so that no dimension is over maxSize, always keeping
+	// the last mip. 0 for a maxSize of 0.
+	uint32_t GetDDSSkipMips(const DDSTextureDesc& desc, size_t maxSize);
+	// Bytes of the file a loader has to read for mips from skipMip on, over all array slices.
+	uint64_t GetDDSLoadedSize(const DDSTextureDesc& desc, uint32_t skipMip);
+}
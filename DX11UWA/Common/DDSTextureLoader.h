@@ -43,6 +43,8 @@ HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                     _In_ size_t maxsize = 0
                                   );
 
+// A gzip or zstd compressed file is decompressed while it is uploaded, through a small fixed
+// buffer and the immediate context, so call this from the rendering thread.
 HRESULT CreateDDSTextureFromFile( _In_ ID3D11Device* d3dDevice,
                                   _In_z_ const wchar_t* szFileName,
                                   _Out_opt_ ID3D11Resource** texture,
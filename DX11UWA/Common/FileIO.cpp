@@ -0,0 +1,109 @@
+﻿#include "FileIO.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <string>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace DX;
+
+#if defined(_WIN32)
+
+namespace
+{
+	std::wstring Widen(const char* text)
+	{
+		int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, nullptr, 0);
+		if (length <= 0)
+			return std::wstring();
+		std::wstring wide(length, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, text, -1, &wide[0], length);
+		wide.resize(length - 1);
+		return wide;
+	}
+}
+
+FILE* DX::OpenFile(const char* path, const char* mode)
+{
+	std::wstring widePath = Widen(path);
+	if (widePath.empty())
+		return nullptr;
+	return OpenFile(widePath.c_str(), Widen(mode).c_str());
+}
+
+FILE* DX::OpenFile(const wchar_t* path, const wchar_t* mode)
+{
+	FILE* file = nullptr;
+	if (_wfopen_s(&file, path, mode) != 0)
+		return nullptr;
+	return file;
+}
+
+bool DX::SeekFile(FILE* file, uint64_t offset)
+{
+	return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+}
+
+uint64_t DX::TellFile(FILE* file)
+{
+	return static_cast<uint64_t>(_ftelli64(file));
+}
+
+bool DX::GetFileSize(const char* path, uint64_t& outSize)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(Widen(path).c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+	outSize = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	return true;
+}
+
+bool DX::RenameFile(const char* from, const char* to)
+{
+	return MoveFileExW(Widen(from).c_str(), Widen(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+bool DX::RemoveFile(const char* path)
+{
+	return DeleteFileW(Widen(path).c_str()) != 0;
+}
+
+#else
+
+FILE* DX::OpenFile(const char* path, const char* mode)
+{
+	return fopen(path, mode);
+}
+
+bool DX::SeekFile(FILE* file, uint64_t offset)
+{
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+}
+
+uint64_t DX::TellFile(FILE* file)
+{
+	return static_cast<uint64_t>(ftello(file));
+}
+
+bool DX::GetFileSize(const char* path, uint64_t& outSize)
+{
+	struct stat status;
+	if (stat(path, &status) != 0)
+		return false;
+	outSize = static_cast<uint64_t>(status.st_size);
+	return true;
+}
+
+bool DX::RenameFile(const char* from, const char* to)
+{
+	return rename(from, to) == 0;
+}
+
+bool DX::RemoveFile(const char* path)
+{
+	return remove(path) == 0;
+}
+
+#endif
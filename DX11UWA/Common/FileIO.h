@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+namespace DX
+{
+	// stdio helpers that take UTF-8 paths and 64-bit offsets on every platform, for the asset
+	// code that streams files too large to map or writes files of its own.
+	FILE* OpenFile(const char* path, const char* mode);
+#if defined(_WIN32)
+	FILE* OpenFile(const wchar_t* path, const wchar_t* mode);
+#endif
+	bool SeekFile(FILE* file, uint64_t offset);
+	uint64_t TellFile(FILE* file);
+	// Returns false when the file cannot be opened.
+	bool GetFileSize(const char* path, uint64_t& outSize);
+	// Renames from to to, replacing any file already there.
+	bool RenameFile(const char* from, const char* to);
+	bool RemoveFile(const char* path);
+}
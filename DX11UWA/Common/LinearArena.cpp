@@ -0,0 +1,238 @@
+﻿#include "LinearArena.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace DX;
+
+namespace
+{
+	thread_local LinearArena* t_currentArena = nullptr;
+
+	const size_t kPageSize = 64 << 10;
+
+	inline size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+#if defined(_WIN32)
+	// Blocks are aligned to a page within their heap allocation, which keeps its own address
+	// just before them for ReleaseBlock.
+	const size_t kBlockAlignment = 4096;
+
+	// A heap of the arena's own, since VirtualAlloc is not available to Store apps. Blocks are
+	// far larger than the size from which a heap gives each allocation pages of its own, so
+	// freeing one still returns its pages to the OS at once.
+	HANDLE GetBlockHeap(void)
+	{
+		static HANDLE heap = HeapCreate(0, 0, 0);
+		return heap;
+	}
+#endif
+
+	// Blocks bypass the shared heap so that releasing one returns its pages to the OS at once.
+	uint8_t* ReserveBlock(size_t size)
+	{
+#if defined(_WIN32)
+		HANDLE heap = GetBlockHeap();
+		void* allocation = heap && size <= SIZE_MAX - kBlockAlignment ? HeapAlloc(heap, 0, size + kBlockAlignment) : nullptr;
+		if (!allocation)
+			return nullptr;
+		uint8_t* data = static_cast<uint8_t*>(allocation) + kBlockAlignment - (reinterpret_cast<uintptr_t>(allocation) & (kBlockAlignment - 1));
+		reinterpret_cast<void**>(data)[-1] = allocation;
+		return data;
+#else
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return data == MAP_FAILED ? nullptr : static_cast<uint8_t*>(data);
+#endif
+	}
+
+	void ReleaseBlock(uint8_t* data, size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		HeapFree(GetBlockHeap(), 0, reinterpret_cast<void**>(data)[-1]);
+#else
+		munmap(data, size);
+#endif
+	}
+}
+
+LinearArena::LinearArena(size_t blockSize) :
+	m_blockSize(AlignUp(blockSize, kPageSize)),
+	m_bytesInUse(0),
+	m_bytesReserved(0),
+	m_peakBytesInUse(0),
+	m_peakBytesReserved(0),
+	m_last(nullptr)
+{
+}
+
+LinearArena::~LinearArena(void)
+{
+	Reset();
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	if (alignment < alignof(std::max_align_t))
+		alignment = alignof(std::max_align_t);
+	if (size == 0)
+		size = 1;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (size > m_blockSize)
+	{
+		// Blocks are page aligned, which covers any alignment a type asks for.
+		if (size > SIZE_MAX - kPageSize)
+			throw std::bad_alloc();
+		Block large;
+		large.size = AlignUp(size, kPageSize);
+		large.data = ReserveBlock(large.size);
+		if (!large.data)
+			throw std::bad_alloc();
+		large.used = size;
+		m_largeBlocks.push_back(large);
+		m_bytesInUse += size;
+		m_bytesReserved += large.size;
+		m_peakBytesInUse = m_bytesInUse > m_peakBytesInUse ? m_bytesInUse : m_peakBytesInUse;
+		m_peakBytesReserved = m_bytesReserved > m_peakBytesReserved ? m_bytesReserved : m_peakBytesReserved;
+		return large.data;
+	}
+
+	Block* block = m_blocks.empty() ? nullptr : &m_blocks.back();
+	size_t offset = block ? AlignUp(block->used, alignment) : 0;
+	if (!block || offset > block->size || block->size - offset < size)
+	{
+		Block fresh;
+		fresh.size = m_blockSize;
+		fresh.data = ReserveBlock(fresh.size);
+		if (!fresh.data)
+			throw std::bad_alloc();
+		fresh.used = 0;
+		m_blocks.push_back(fresh);
+		m_bytesReserved += fresh.size;
+		m_peakBytesReserved = m_bytesReserved > m_peakBytesReserved ? m_bytesReserved : m_peakBytesReserved;
+		block = &m_blocks.back();
+		offset = 0;
+	}
+
+	void* pointer = block->data + offset;
+	m_bytesInUse += offset + size - block->used;
+	m_peakBytesInUse = m_bytesInUse > m_peakBytesInUse ? m_bytesInUse : m_peakBytesInUse;
+	block->used = offset + size;
+	m_last = pointer;
+	return pointer;
+}
+
+void LinearArena::Free(void* pointer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (size > m_blockSize)
+	{
+		// Recently allocated buffers are the likeliest to be freed, so search from the back.
+		for (size_t i = m_largeBlocks.size(); i-- > 0;)
+		{
+			Block& large = m_largeBlocks[i];
+			if (large.data != pointer)
+				continue;
+			ReleaseBlock(large.data, large.size);
+			m_bytesInUse -= large.used;
+			m_bytesReserved -= large.size;
+			large.data = nullptr;
+			break;
+		}
+		return;
+	}
+	if (pointer != m_last || m_blocks.empty())
+		return;
+
+	// Only the latest allocation can be taken back; the alignment padding before it stays.
+	Block& block = m_blocks.back();
+	size_t offset = static_cast<uint8_t*>(pointer) - block.data;
+	size = size == 0 ? 1 : size;
+	if (offset + size == block.used)
+	{
+		block.used = offset;
+		m_bytesInUse -= size;
+	}
+	m_last = nullptr;
+}
+
+LinearArena::Marker LinearArena::GetMarker(void)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Marker marker = { m_blocks.size(), m_blocks.empty() ? 0 : m_blocks.back().used, m_largeBlocks.size() };
+	return marker;
+}
+
+void LinearArena::Rewind(const Marker& marker)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	while (m_largeBlocks.size() > marker.largeCount)
+	{
+		Block& large = m_largeBlocks.back();
+		if (large.data)
+		{
+			ReleaseBlock(large.data, large.size);
+			m_bytesInUse -= large.used;
+			m_bytesReserved -= large.size;
+		}
+		m_largeBlocks.pop_back();
+	}
+	while (m_blocks.size() > marker.blockCount)
+	{
+		m_bytesInUse -= m_blocks.back().used;
+		m_bytesReserved -= m_blocks.back().size;
+		ReleaseBlock(m_blocks.back().data, m_blocks.back().size);
+		m_blocks.pop_back();
+	}
+	if (!m_blocks.empty() && m_blocks.back().used > marker.used)
+	{
+		m_bytesInUse -= m_blocks.back().used - marker.used;
+		m_blocks.back().used = marker.used;
+	}
+	m_last = nullptr;
+}
+
+void LinearArena::Reset(void)
+{
+	Marker start = { 0, 0, 0 };
+	Rewind(start);
+}
+
+LinearArena* LinearArena::GetCurrent(void)
+{
+	return t_currentArena;
+}
+
+LinearArena::Frame::Frame(void) :
+	m_arena(t_currentArena)
+{
+	if (m_arena)
+		m_marker = m_arena->GetMarker();
+}
+
+LinearArena::Frame::~Frame(void)
+{
+	if (m_arena)
+		m_arena->Rewind(m_marker);
+}
+
+LinearArena::Scope::Scope(LinearArena& arena) :
+	m_arena(arena),
+	m_previous(t_currentArena),
+	m_marker(arena.GetMarker())
+{
+	t_currentArena = &arena;
+}
+
+LinearArena::Scope::~Scope(void)
+{
+	t_currentArena = m_previous;
+	m_arena.Rewind(m_marker);
+}
@@ -0,0 +1,150 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace DX
+{
+	// Bump allocator for short-lived temporaries. Memory is handed out from large blocks taken
+	// straight from the OS and only given back in one go: when a Scope ends, everything allocated
+	// inside it is released. Freeing the most recent allocation rewinds over it, and allocations
+	// larger than a block get pages of their own that go back as soon as they are freed, so a
+	// growing vector does not leave every old buffer behind. Any other free is a no-op.
+	// Allocation is thread-safe.
+	class LinearArena
+	{
+	public:
+		explicit LinearArena(size_t blockSize = 4 << 20);
+		~LinearArena(void);
+
+		// A point in the arena's history that Rewind returns to.
+		struct Marker
+		{
+			size_t	blockCount;
+			size_t	used;		// of the last block
+			size_t	largeCount;
+		};
+
+		void* Allocate(size_t size, size_t alignment);
+		void Free(void* pointer, size_t size);
+		Marker GetMarker(void);
+		// Releases everything allocated since marker. None of it may be used afterwards.
+		void Rewind(const Marker& marker);
+		// Releases every block.
+		void Reset(void);
+
+		size_t GetBytesInUse(void) const		{ return m_bytesInUse; }
+		size_t GetPeakBytesInUse(void) const	{ return m_peakBytesInUse; }
+		size_t GetPeakBytesReserved(void) const	{ return m_peakBytesReserved; }
+
+		// The arena that ArenaAllocator picks up on this thread, or null for the heap.
+		static LinearArena* GetCurrent(void);
+
+		// Rewinds the arena that was current when it was created, if any, once it goes out of
+		// scope. Functions declare one ahead of their temporaries so that, run inside a Scope,
+		// they hand their memory back on return as they would with the heap.
+		class Frame
+		{
+		public:
+			Frame(void);
+			~Frame(void);
+
+		private:
+			Frame(const Frame&);
+			Frame& operator=(const Frame&);
+
+			LinearArena*	m_arena;
+			Marker			m_marker;
+		};
+
+		// Makes an arena current on this thread for its lifetime and then rewinds it to where it
+		// was, so nothing allocated inside may outlive the scope. Scopes nest.
+		class Scope
+		{
+		public:
+			explicit Scope(LinearArena& arena);
+			~Scope(void);
+
+		private:
+			Scope(const Scope&);
+			Scope& operator=(const Scope&);
+
+			LinearArena&	m_arena;
+			LinearArena*	m_previous;
+			Marker			m_marker;
+		};
+
+	private:
+		LinearArena(const LinearArena&);
+		LinearArena& operator=(const LinearArena&);
+
+		struct Block
+		{
+			uint8_t*	data;
+			size_t		size;
+			size_t		used;
+		};
+
+		std::mutex			m_lock;
+		std::vector<Block>	m_blocks;
+		std::vector<Block>	m_largeBlocks;	// one allocation each; data is null once freed
+		size_t				m_blockSize;
+		size_t				m_bytesInUse;
+		size_t				m_bytesReserved;
+		size_t				m_peakBytesInUse;
+		size_t				m_peakBytesReserved;
+		void*				m_last;		// most recent allocation, which Free can rewind
+	};
+
+	// Standard allocator over a LinearArena. A default-constructed one uses the arena current on
+	// the constructing thread and falls back to the heap when there is none, so containers built
+	// inside a LinearArena::Scope go away with the arena and the same code behaves as usual outside one.
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+		typedef std::true_type propagate_on_container_copy_assignment;
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+
+		ArenaAllocator(void) : m_arena(LinearArena::GetCurrent()) {}
+		explicit ArenaAllocator(LinearArena* arena) : m_arena(arena) {}
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.GetArena()) {}
+
+		T* allocate(size_t count)
+		{
+			if (count > SIZE_MAX / sizeof(T))
+				throw std::bad_alloc();
+			if (!m_arena)
+				return static_cast<T*>(::operator new(count * sizeof(T)));
+			return static_cast<T*>(m_arena->Allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* pointer, size_t count)
+		{
+			if (!m_arena)
+				::operator delete(pointer);
+			else
+				m_arena->Free(pointer, count * sizeof(T));
+		}
+
+		LinearArena* GetArena(void) const	{ return m_arena; }
+
+	private:
+		LinearArena* m_arena;
+	};
+
+	template <typename T, typename U>
+	inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)	{ return a.GetArena() == b.GetArena(); }
+	template <typename T, typename U>
+	inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)	{ return a.GetArena() != b.GetArena(); }
+
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
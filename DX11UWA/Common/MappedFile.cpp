@@ -0,0 +1,165 @@
+﻿#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace DX;
+
+MappedFile::MappedFile(void) :
+	m_data(nullptr),
+	m_size(0),
+	m_isEmpty(false),
+#if defined(_WIN32)
+	m_file(nullptr),
+	m_mapping(nullptr)
+#else
+	m_file(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const char* path)
+{
+	int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	if (length <= 0)
+		return false;
+
+	std::vector<wchar_t> widePath(length);
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath.data(), length);
+	return Open(widePath.data());
+}
+
+bool MappedFile::Open(const wchar_t* path)
+{
+	Close();
+
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+	HANDLE file = CreateFile2(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+#else
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#endif
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = file;
+
+	LARGE_INTEGER fileSize = { 0 };
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<uint64_t>(fileSize.QuadPart);
+	if (m_size == 0)
+	{
+		// Windows refuses to map empty files, but an empty view is still a valid result.
+		m_isEmpty = true;
+		return true;
+	}
+
+#if (_WIN32_WINNT >= 0x0A00 /*_WIN32_WINNT_WIN10*/)
+	m_mapping = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+#else
+	m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+#endif
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+#if (_WIN32_WINNT >= 0x0A00 /*_WIN32_WINNT_WIN10*/)
+	m_data = static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0));
+#else
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#endif
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+	m_isEmpty = false;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	m_file = open(path, O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<uint64_t>(info.st_size);
+	if (m_size == 0)
+	{
+		m_isEmpty = true;
+		return true;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (view == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	// Files are parsed front to back, so let the kernel read ahead aggressively.
+	madvise(view, static_cast<size_t>(m_size), MADV_SEQUENTIAL);
+	m_data = static_cast<const uint8_t*>(view);
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+	if (m_file >= 0)
+		close(m_file);
+
+	m_data = nullptr;
+	m_file = -1;
+	m_size = 0;
+	m_isEmpty = false;
+}
+
+#endif
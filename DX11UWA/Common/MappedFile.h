@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DX
+{
+	// Read-only view of a whole file mapped into the address space.
+	// Builds on Windows (including UWP) and on POSIX systems so asset tools can share it.
+	class MappedFile
+	{
+	public:
+		MappedFile(void);
+		~MappedFile(void);
+
+		bool Open(const char* path);
+#if defined(_WIN32)
+		bool Open(const wchar_t* path);
+#endif
+		void Close(void);
+
+		const uint8_t* GetData(void) const	{ return m_data; }
+		uint64_t GetSize(void) const		{ return m_size; }
+		bool IsOpen(void) const				{ return m_data != nullptr || m_isEmpty; }
+
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+		const uint8_t*	m_data;
+		uint64_t		m_size;
+		bool			m_isEmpty;
+#if defined(_WIN32)
+		void*			m_file;
+		void*			m_mapping;
+#else
+		int				m_file;
+#endif
+	};
+}
@@ -0,0 +1,259 @@
+﻿#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Texels are filtered as four floats, one SSE register, on any x86 or x64 build.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2
+#endif
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t kMaxMipLevels = 15;		// the Direct3D 11 limit DDSFile checks
+	const float kKaiserAlpha = 4.0f;
+	const float kKaiserRadius = 3.0f;		// in texels of the smaller mip
+	const float kPi = 3.14159265358979f;
+
+	struct Tap
+	{
+		uint32_t	source;
+		float		weight;
+	};
+
+	// Taps of the texels of a source row or column that each texel of the smaller one is filtered
+	// from, those of target texel i being taps[first[i]] up to taps[first[i + 1]].
+	struct Kernel
+	{
+		std::vector<uint32_t>	first;
+		std::vector<Tap>		taps;
+	};
+
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 32 && term > sum * 1e-7f; ++k)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float KaiserSinc(float x)
+	{
+		if (std::fabs(x) >= kKaiserRadius)
+			return 0.0f;
+		const float t = x / kKaiserRadius;
+		const float window = BesselI0(kKaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(kKaiserAlpha);
+		return x == 0.0f ? window : window * std::sin(kPi * x) / (kPi * x);
+	}
+
+	uint32_t AddressTexel(int texel, uint32_t size, bool wrap)
+	{
+		if (wrap)
+			return static_cast<uint32_t>(((texel % static_cast<int>(size)) + static_cast<int>(size)) % static_cast<int>(size));
+		return static_cast<uint32_t>(std::min(std::max(texel, 0), static_cast<int>(size) - 1));
+	}
+
+	// Works for any ratio of sizes, so odd sizes get the three texel footprints they need
+	// rather than dropping a row.
+	void BuildKernel(uint32_t sourceSize, uint32_t targetSize, MipFilter filter, bool wrap, Kernel& kernel)
+	{
+		kernel.first.clear();
+		kernel.taps.clear();
+		const float scale = static_cast<float>(sourceSize) / targetSize;
+		for (uint32_t target = 0; target < targetSize; ++target)
+		{
+			kernel.first.push_back(static_cast<uint32_t>(kernel.taps.size()));
+			const float low = target * scale;
+			const float high = low + scale;
+			const float center = low + scale * 0.5f;
+			const float radius = filter == MIP_FILTER_BOX ? scale * 0.5f : kKaiserRadius * scale;
+
+			float total = 0.0f;
+			const int start = static_cast<int>(std::floor(center - radius));
+			const int end = static_cast<int>(std::ceil(center + radius));
+			for (int source = start; source < end; ++source)
+			{
+				float weight;
+				if (filter == MIP_FILTER_BOX)
+					weight = std::max(0.0f, std::min(high, source + 1.0f) - std::max(low, static_cast<float>(source)));
+				else
+					weight = KaiserSinc((source + 0.5f - center) / scale);
+				if (weight == 0.0f)
+					continue;
+
+				Tap tap = { AddressTexel(source, sourceSize, wrap), weight };
+				kernel.taps.push_back(tap);
+				total += weight;
+			}
+			for (size_t i = kernel.first.back(); i < kernel.taps.size(); ++i)
+				kernel.taps[i].weight /= total;
+		}
+		kernel.first.push_back(static_cast<uint32_t>(kernel.taps.size()));
+	}
+
+	// out[i] += weight * in[i] over count texels of four floats.
+	void AddScaled(float* out, const float* in, float weight, size_t count)
+	{
+#if defined(MIP_GENERATOR_SSE2)
+		const __m128 scale = _mm_set1_ps(weight);
+		for (size_t i = 0; i < count; ++i)
+			_mm_storeu_ps(out + i * 4, _mm_add_ps(_mm_loadu_ps(out + i * 4), _mm_mul_ps(_mm_loadu_ps(in + i * 4), scale)));
+#else
+		for (size_t i = 0; i < count * 4; ++i)
+			out[i] += in[i] * weight;
+#endif
+	}
+
+	// Filters an image of premultiplied RGBA floats down to the next mip, rows first.
+	void FilterImage(const std::vector<float>& source, uint32_t width, uint32_t height, const Kernel& columns, const Kernel& rows,
+		uint32_t targetWidth, uint32_t targetHeight, std::vector<float>& scratch, std::vector<float>& target)
+	{
+		scratch.assign(static_cast<size_t>(targetWidth) * height * 4, 0.0f);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const float* in = &source[static_cast<size_t>(y) * width * 4];
+			float* out = &scratch[static_cast<size_t>(y) * targetWidth * 4];
+			for (uint32_t x = 0; x < targetWidth; ++x)
+			{
+				for (uint32_t t = columns.first[x]; t < columns.first[x + 1]; ++t)
+					AddScaled(out + x * 4, in + columns.taps[t].source * 4, columns.taps[t].weight, 1);
+			}
+		}
+
+		// Whole rows at a time, so the inner loop runs along memory
+		target.assign(static_cast<size_t>(targetWidth) * targetHeight * 4, 0.0f);
+		for (uint32_t y = 0; y < targetHeight; ++y)
+		{
+			float* out = &target[static_cast<size_t>(y) * targetWidth * 4];
+			for (uint32_t t = rows.first[y]; t < rows.first[y + 1]; ++t)
+				AddScaled(out, &scratch[static_cast<size_t>(rows.taps[t].source) * targetWidth * 4], rows.taps[t].weight, targetWidth);
+		}
+	}
+
+	float EncodeSRGB(float linear)
+	{
+		return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+	}
+
+	uint8_t ToUNorm8(float value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+bool DX::IsMipFormatSupported(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+DDSResult DX::GenerateMipChain(const DDSTextureDesc& desc, const uint8_t* bits, const MipOptions& options, DDSTextureDesc& outDesc,
+	std::vector<uint8_t>& outBits)
+{
+	if (!IsMipFormatSupported(desc.format) || desc.dimension != DDS_DIMENSION_TEXTURE2D || options.filter >= MIP_FILTER_COUNT)
+		return DDS_NOT_SUPPORTED;
+
+	uint32_t fullChain = 1;
+	while ((std::max(desc.width, desc.height) >> fullChain) > 0)
+		++fullChain;
+	outDesc = desc;
+	outDesc.mipCount = std::min(options.mipCount ? std::min(options.mipCount, fullChain) : fullChain, kMaxMipLevels);
+	outDesc.dataSize = ComputeDDSLayout(outDesc, nullptr);
+	outBits.resize(static_cast<size_t>(outDesc.dataSize));
+
+	std::vector<DDSSubresource> layout(static_cast<size_t>(desc.mipCount) * desc.arraySize);
+	std::vector<DDSSubresource> outLayout(static_cast<size_t>(outDesc.mipCount) * outDesc.arraySize);
+	ComputeDDSLayout(desc, layout.data());
+	ComputeDDSLayout(outDesc, outLayout.data());
+
+	const bool srgb = desc.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || desc.format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+		desc.format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+	const bool gammaCorrect = srgb || options.gammaCorrect;
+	const bool opaque = desc.format == DXGI_FORMAT_B8G8R8X8_UNORM || desc.format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+	const bool wrap = options.wrap && !desc.isCubeMap;
+
+	float decode[256];
+	for (int i = 0; i < 256; ++i)
+	{
+		const float value = i / 255.0f;
+		decode[i] = !gammaCorrect ? value : value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	Kernel columns;
+	Kernel rows;
+	std::vector<float> level;
+	std::vector<float> next;
+	std::vector<float> scratch;
+	for (uint32_t slice = 0; slice < desc.arraySize; ++slice)
+	{
+		// Mip 0 is kept as it is and read into premultiplied light
+		const DDSSubresource& top = layout[slice * desc.mipCount];
+		const DDSSubresource& outTop = outLayout[slice * outDesc.mipCount];
+		memcpy(&outBits[static_cast<size_t>(outTop.offset)], bits + top.offset, static_cast<size_t>(top.sliceBytes));
+
+		level.resize(static_cast<size_t>(top.width) * top.height * 4);
+		for (uint32_t y = 0; y < top.height; ++y)
+		{
+			const uint8_t* in = bits + top.offset + static_cast<size_t>(y) * top.rowBytes;
+			float* out = &level[static_cast<size_t>(y) * top.width * 4];
+			for (uint32_t x = 0; x < top.width; ++x, in += 4, out += 4)
+			{
+				const float alpha = opaque ? 1.0f : in[3] / 255.0f;
+				for (int c = 0; c < 3; ++c)
+					out[c] = decode[in[c]] * alpha;
+				out[3] = alpha;
+			}
+		}
+
+		// Each mip is filtered from the one before, kept in floats so rounding does not build up
+		uint32_t width = top.width;
+		uint32_t height = top.height;
+		for (uint32_t mip = 1; mip < outDesc.mipCount; ++mip)
+		{
+			const DDSSubresource& target = outLayout[slice * outDesc.mipCount + mip];
+			BuildKernel(width, target.width, options.filter, wrap, columns);
+			BuildKernel(height, target.height, options.filter, wrap, rows);
+			FilterImage(level, width, height, columns, rows, target.width, target.height, scratch, next);
+			level.swap(next);
+			width = target.width;
+			height = target.height;
+
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				const float* in = &level[static_cast<size_t>(y) * width * 4];
+				uint8_t* out = &outBits[static_cast<size_t>(target.offset) + static_cast<size_t>(y) * target.rowBytes];
+				for (uint32_t x = 0; x < width; ++x, in += 4, out += 4)
+				{
+					// The ringing of the Kaiser filter can take alpha out of range
+					const float alpha = std::min(std::max(in[3], 0.0f), 1.0f);
+					for (int c = 0; c < 3; ++c)
+					{
+						const float color = alpha > 0.0f ? std::min(std::max(in[c] / alpha, 0.0f), 1.0f) : 0.0f;
+						out[c] = ToUNorm8(gammaCorrect ? EncodeSRGB(color) : color);
+					}
+					out[3] = opaque ? 255 : ToUNorm8(alpha);
+				}
+			}
+		}
+	}
+	return DDS_OK;
+}
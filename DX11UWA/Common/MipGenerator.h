@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include "DDSFile.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+	enum MipFilter
+	{
+		MIP_FILTER_BOX,		// the average of the texels each one covers, exact for any size
+		MIP_FILTER_KAISER,	// Kaiser windowed sinc over three texels a side, sharper at a little ringing
+		MIP_FILTER_COUNT
+	};
+
+	struct MipOptions
+	{
+		MipFilter	filter;
+		uint32_t	mipCount;		// 0 for the full chain down to 1x1
+		bool		gammaCorrect;	// filter colour as light, decoding sRGB first; always so for sRGB formats
+		bool		wrap;			// filter across opposite edges, for tiling textures; never so for cube maps
+	};
+
+	// Whether GenerateMipChain can filter the format: 8 bit RGBA, BGRA and BGRX.
+	bool IsMipFormatSupported(DXGI_FORMAT format);
+
+	// Builds a 2D texture, array or cube map with options.mipCount mips from mip 0 of every slice of
+	// bits, which desc lays out; any mips it has are replaced. Colour is weighted by alpha while it
+	// is filtered, so transparent texels do not bleed their colour into the mips. outBits is laid
+	// out as ComputeDDSLayout(outDesc) gives. DDS_NOT_SUPPORTED for other formats and dimensions.
+	DDSResult GenerateMipChain(const DDSTextureDesc& desc, const uint8_t* bits, const MipOptions& options, DDSTextureDesc& outDesc,
+		std::vector<uint8_t>& outBits);
+}
@@ -0,0 +1,52 @@
+﻿#include "ProcessMemory.h"
+
+#if defined(_WIN32) && defined(__cplusplus_winrt)
+#include <windows.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <cstring>
+#endif
+
+using namespace DX;
+
+bool DX::QueryProcessMemory(ProcessMemory& outMemory)
+{
+	outMemory.currentBytes = 0;
+	outMemory.peakBytes = 0;
+
+#if defined(_WIN32) && defined(__cplusplus_winrt)
+	// Store apps cannot query their working set; what they are charged for against their memory
+	// limit is their private commit.
+	Windows::System::AppMemoryReport^ report = Windows::System::MemoryManager::GetAppMemoryReport();
+	outMemory.currentBytes = Windows::System::MemoryManager::AppMemoryUsage;
+	outMemory.peakBytes = report ? report->PeakPrivateCommitUsage : outMemory.currentBytes;
+	return outMemory.currentBytes != 0;
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return false;
+	outMemory.currentBytes = counters.WorkingSetSize;
+	outMemory.peakBytes = counters.PeakWorkingSetSize;
+	return true;
+#else
+	FILE* file = fopen("/proc/self/status", "r");
+	if (!file)
+		return false;
+
+	// Sizes are listed in kB.
+	char line[256];
+	unsigned long long kilobytes = 0;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (strncmp(line, "VmRSS:", 6) == 0 && sscanf(line + 6, "%llu", &kilobytes) == 1)
+			outMemory.currentBytes = kilobytes * 1024;
+		else if (strncmp(line, "VmHWM:", 6) == 0 && sscanf(line + 6, "%llu", &kilobytes) == 1)
+			outMemory.peakBytes = kilobytes * 1024;
+	}
+	fclose(file);
+	return outMemory.currentBytes != 0;
+#endif
+}
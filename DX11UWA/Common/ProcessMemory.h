@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <cstdint>
+
+namespace DX
+{
+	// Memory the process is using: the app's private commit in a Store app, the working set in
+	// a desktop build on Windows and the resident set elsewhere.
+	struct ProcessMemory
+	{
+		uint64_t	currentBytes;
+		uint64_t	peakBytes;		// since the process started
+	};
+
+	// Returns false, with both sizes 0, when the platform does not report them.
+	bool QueryProcessMemory(ProcessMemory& outMemory);
+}
@@ -0,0 +1,237 @@
+﻿#include "ResidencyManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DX;
+
+ResidencyManager::ResidencyManager(void)
+{
+	Reset(0, 0);
+}
+
+void ResidencyManager::Reset(uint64_t budgetBytes, uint32_t maxRestoresPerUpdate)
+{
+	m_assets.clear();
+	m_freeAssets.clear();
+	m_used.clear();
+	m_candidates.clear();
+	m_changed.clear();
+	m_maxRestores = maxRestoresPerUpdate;
+	m_frame = 1;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.budgetBytes = budgetBytes;
+}
+
+void ResidencyManager::SetBudget(uint64_t budgetBytes)
+{
+	m_stats.budgetBytes = budgetBytes;
+}
+
+uint32_t ResidencyManager::Register(ResidencyKind kind, const uint64_t* levelBytes, uint32_t levelCount, ResidencyPolicy policy)
+{
+	uint32_t handle;
+	if (m_freeAssets.empty())
+	{
+		handle = static_cast<uint32_t>(m_assets.size());
+		m_assets.push_back(Asset());
+	}
+	else
+	{
+		handle = m_freeAssets.back();
+		m_freeAssets.pop_back();
+	}
+
+	// Levels past the maximum are dropped and each is kept no larger than the one before it.
+	Asset& asset = m_assets[handle];
+	asset.levelCount = std::min(std::max(levelCount, 1u), RESIDENCY_MAX_LEVELS);
+	for (uint32_t i = 0; i < asset.levelCount; ++i)
+	{
+		uint64_t bytes = i < levelCount ? levelBytes[i] : 0;
+		asset.levelBytes[i] = i > 0 ? std::min(bytes, asset.levelBytes[i - 1]) : bytes;
+	}
+	asset.level = 0;
+	asset.wantedLevel = RESIDENCY_EVICTED;
+	asset.lastUsed = m_frame;
+	asset.changedUpdate = 0;
+	asset.kind = kind;
+	asset.policy = policy;
+	asset.registered = true;
+
+	m_stats.assetCount++;
+	m_stats.fullBytes += asset.levelBytes[0];
+	m_stats.residentBytes += asset.levelBytes[0];
+	m_stats.kindBytes[kind] += asset.levelBytes[0];
+	return handle;
+}
+
+void ResidencyManager::Unregister(uint32_t handle)
+{
+	Asset& asset = m_assets[handle];
+	if (!asset.registered)
+		return;
+
+	m_stats.assetCount--;
+	m_stats.fullBytes -= asset.levelBytes[0];
+	m_stats.residentBytes -= GetBytes(asset);
+	m_stats.kindBytes[asset.kind] -= GetBytes(asset);
+	m_stats.reducedCount -= asset.level != 0 && asset.level != RESIDENCY_EVICTED ? 1 : 0;
+	m_stats.evictedCount -= asset.level == RESIDENCY_EVICTED ? 1 : 0;
+	asset.registered = false;
+	asset.wantedLevel = RESIDENCY_EVICTED;
+	m_freeAssets.push_back(handle);
+}
+
+void ResidencyManager::MarkUsed(uint32_t handle, uint32_t level)
+{
+	Asset& asset = m_assets[handle];
+	level = std::min(level, asset.levelCount - 1);
+	if (asset.wantedLevel == RESIDENCY_EVICTED)
+	{
+		m_used.push_back(handle);
+		asset.wantedLevel = level;
+	}
+	else
+	{
+		asset.wantedLevel = std::min(asset.wantedLevel, level);
+	}
+	asset.lastUsed = m_frame;
+}
+
+void ResidencyManager::Update(std::vector<ResidencyChange>& outChanges)
+{
+	outChanges.clear();
+	m_changed.clear();
+	m_stats.updateCount++;
+
+	// Room is only ever taken from assets nobody drew this frame, the ones drawn longest ago first.
+	m_candidates.clear();
+	for (uint32_t a = 0; a < m_assets.size(); ++a)
+	{
+		const Asset& asset = m_assets[a];
+		if (asset.registered && asset.policy != RESIDENCY_PINNED && asset.level != RESIDENCY_EVICTED && asset.wantedLevel == RESIDENCY_EVICTED)
+			m_candidates.push_back(a);
+	}
+	std::stable_sort(m_candidates.begin(), m_candidates.end(), [this](uint32_t a, uint32_t b) { return m_assets[a].lastUsed < m_assets[b].lastUsed; });
+
+	// A lowered budget or new assets can leave too much resident before anything is restored;
+	// as much of it as can be is freed.
+	MakeRoom(0);
+
+	// Used assets below the level they need are raised to it, or to as large a level as fits.
+	uint32_t restoreCount = 0;
+	for (uint32_t a : m_used)
+	{
+		Asset& asset = m_assets[a];
+		if (!asset.registered || asset.wantedLevel == RESIDENCY_EVICTED || (asset.level != RESIDENCY_EVICTED && asset.level <= asset.wantedLevel))
+			continue;
+		if (restoreCount == m_maxRestores)
+		{
+			m_stats.missedRestores++;
+			continue;
+		}
+
+		const uint32_t limit = asset.level == RESIDENCY_EVICTED ? asset.levelCount : asset.level;
+		uint32_t level = asset.wantedLevel;
+		while (level < limit && !MakeRoom(asset.levelBytes[level] - GetBytes(asset)))
+			++level;
+		if (level != asset.wantedLevel)
+			m_stats.missedRestores++;
+		if (level == limit)
+			continue;
+
+		m_stats.restores++;
+		m_stats.restoredBytes += asset.levelBytes[level] - GetBytes(asset);
+		SetLevel(a, level);
+		restoreCount++;
+	}
+
+	if (m_stats.residentBytes > m_stats.budgetBytes)
+		m_stats.overBudgetUpdates++;
+	m_stats.peakBytes = std::max(m_stats.peakBytes, m_stats.residentBytes);
+
+	// Releases were all made to unused assets and restores to used ones, so they split cleanly.
+	std::stable_partition(m_changed.begin(), m_changed.end(), [this](uint32_t a) { return m_assets[a].wantedLevel == RESIDENCY_EVICTED; });
+	for (uint32_t a : m_changed)
+	{
+		ResidencyChange change = { a, m_assets[a].level };
+		outChanges.push_back(change);
+	}
+
+	for (uint32_t a : m_used)
+		m_assets[a].wantedLevel = RESIDENCY_EVICTED;
+	m_used.clear();
+	++m_frame;
+}
+
+void ResidencyManager::SetLevel(uint32_t handle, uint32_t level)
+{
+	Asset& asset = m_assets[handle];
+	if (asset.level == level)
+		return;
+
+	m_stats.residentBytes -= GetBytes(asset);
+	m_stats.kindBytes[asset.kind] -= GetBytes(asset);
+	m_stats.reducedCount -= asset.level != 0 && asset.level != RESIDENCY_EVICTED ? 1 : 0;
+	m_stats.evictedCount -= asset.level == RESIDENCY_EVICTED ? 1 : 0;
+	asset.level = level;
+	m_stats.residentBytes += GetBytes(asset);
+	m_stats.kindBytes[asset.kind] += GetBytes(asset);
+	m_stats.reducedCount += asset.level != 0 && asset.level != RESIDENCY_EVICTED ? 1 : 0;
+	m_stats.evictedCount += asset.level == RESIDENCY_EVICTED ? 1 : 0;
+
+	if (asset.changedUpdate != m_stats.updateCount)
+	{
+		asset.changedUpdate = m_stats.updateCount;
+		m_changed.push_back(handle);
+	}
+}
+
+// Frees enough of the candidates for bytes more to fit the budget, or nothing when even freeing
+// all of them would not be enough, unless bytes is 0. Every candidate is dropped to its smallest
+// level, one level at a time and oldest first, before any is evicted.
+bool ResidencyManager::MakeRoom(uint64_t bytes)
+{
+	const uint64_t budget = m_stats.budgetBytes;
+	if (m_stats.residentBytes + bytes <= budget)
+		return true;
+	if (bytes > 0 && m_stats.residentBytes + bytes > budget + GetFreeableBytes())
+		return false;
+
+	for (size_t i = 0; i < m_candidates.size() && m_stats.residentBytes + bytes > budget; ++i)
+	{
+		const Asset& asset = m_assets[m_candidates[i]];
+		if (asset.level == RESIDENCY_EVICTED)
+			continue;
+
+		uint32_t level = asset.level;
+		uint64_t resident = m_stats.residentBytes;
+		while (level + 1 < asset.levelCount && resident + bytes > budget)
+		{
+			resident -= asset.levelBytes[level] - asset.levelBytes[level + 1];
+			++level;
+		}
+		m_stats.reductions += level - asset.level;
+		SetLevel(m_candidates[i], level);
+	}
+	for (size_t i = 0; i < m_candidates.size() && m_stats.residentBytes + bytes > budget; ++i)
+	{
+		const Asset& asset = m_assets[m_candidates[i]];
+		if (asset.level == RESIDENCY_EVICTED || asset.policy != RESIDENCY_EVICTABLE)
+			continue;
+		m_stats.evictions++;
+		SetLevel(m_candidates[i], RESIDENCY_EVICTED);
+	}
+	return m_stats.residentBytes + bytes <= budget;
+}
+
+uint64_t ResidencyManager::GetFreeableBytes(void) const
+{
+	uint64_t freeable = 0;
+	for (uint32_t a : m_candidates)
+	{
+		const Asset& asset = m_assets[a];
+		freeable += GetBytes(asset) - (asset.policy == RESIDENCY_EVICTABLE || asset.level == RESIDENCY_EVICTED ? 0 : asset.levelBytes[asset.levelCount - 1]);
+	}
+	return freeable;
+}
@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+	enum ResidencyKind
+	{
+		RESIDENCY_VERTEX_BUFFER,
+		RESIDENCY_INDEX_BUFFER,
+		RESIDENCY_TEXTURE,
+		RESIDENCY_RENDER_TARGET,
+		RESIDENCY_KIND_COUNT
+	};
+
+	// What Update may do to an asset to make room.
+	enum ResidencyPolicy
+	{
+		RESIDENCY_EVICTABLE,		// reduced, then evicted
+		RESIDENCY_KEEP_SMALLEST,	// reduced, but its smallest level always stays, as streamed textures do
+		RESIDENCY_PINNED			// counted and never touched
+	};
+
+	// Level of an asset that has nothing resident.
+	const uint32_t RESIDENCY_EVICTED = UINT32_MAX;
+	const uint32_t RESIDENCY_MAX_LEVELS = 16;
+
+	// An asset whose level Update changed: the caller frees or recreates it to match.
+	struct ResidencyChange
+	{
+		uint32_t	asset;
+		uint32_t	level;		// RESIDENCY_EVICTED when it is to be released
+	};
+
+	struct ResidencyStats
+	{
+		uint64_t	budgetBytes;
+		uint64_t	residentBytes;
+		uint64_t	peakBytes;							// most resident after any Update
+		uint64_t	fullBytes;							// every asset at level 0
+		uint64_t	kindBytes[RESIDENCY_KIND_COUNT];	// resident, by kind
+		uint32_t	assetCount;
+		uint32_t	reducedCount;						// resident below level 0
+		uint32_t	evictedCount;
+		uint32_t	updateCount;
+		uint32_t	overBudgetUpdates;					// ended over budget, with nothing left to take room from
+		uint64_t	reductions;							// levels dropped from assets that were not used
+		uint64_t	evictions;
+		uint64_t	restores;							// levels raised for assets that were used
+		uint64_t	restoredBytes;
+		uint64_t	missedRestores;						// used below the level they asked for, for lack of room or restores
+	};
+
+	// Keeps the bytes of the assets a renderer holds on the GPU under a budget. Each asset has one
+	// or more levels, level 0 being all of it and each next level smaller: a texture without its
+	// largest mip, a mesh without its finest LOD. Assets drawn in a frame are marked used with the
+	// level they need; Update then raises them to it, making room by first dropping the assets drawn
+	// longest ago to their smallest level and only then evicting them, oldest first, as far as each
+	// asset's ResidencyPolicy allows. Nothing here knows about D3D, so a renderer applies the changes
+	// and a simulated trace can drive it anywhere.
+	class ResidencyManager
+	{
+	public:
+		ResidencyManager(void);
+
+		// Drops every asset.
+		void Reset(uint64_t budgetBytes, uint32_t maxRestoresPerUpdate);
+		void SetBudget(uint64_t budgetBytes);
+
+		// levelBytes holds the resident size at each level, largest first. The asset starts at
+		// level 0; handles of unregistered assets are reused.
+		uint32_t Register(ResidencyKind kind, const uint64_t* levelBytes, uint32_t levelCount, ResidencyPolicy policy = RESIDENCY_EVICTABLE);
+		uint32_t Register(ResidencyKind kind, uint64_t bytes, ResidencyPolicy policy = RESIDENCY_EVICTABLE)	{ return Register(kind, &bytes, 1, policy); }
+		void Unregister(uint32_t asset);
+
+		// The asset is drawn this frame and needs level or a larger one.
+		void MarkUsed(uint32_t asset, uint32_t level = 0);
+		// Ends the frame. Fills outChanges with the assets whose level changed, each once with its
+		// new level, releases first; they are applied here straight away.
+		void Update(std::vector<ResidencyChange>& outChanges);
+
+		uint32_t GetLevel(uint32_t asset) const		{ return m_assets[asset].level; }
+		bool IsResident(uint32_t asset) const		{ return m_assets[asset].level != RESIDENCY_EVICTED; }
+		uint64_t GetResidentBytes(void) const		{ return m_stats.residentBytes; }
+		const ResidencyStats& GetStats(void) const	{ return m_stats; }
+
+	private:
+		struct Asset
+		{
+			uint64_t		levelBytes[RESIDENCY_MAX_LEVELS];
+			uint32_t		levelCount;
+			uint32_t		level;
+			uint32_t		wantedLevel;	// smallest level asked for this frame
+			uint32_t		lastUsed;		// frame it was last marked used
+			uint32_t		changedUpdate;	// last Update that changed its level
+			ResidencyKind	kind;
+			ResidencyPolicy	policy;
+			bool			registered;
+		};
+
+		uint64_t GetBytes(const Asset& asset) const	{ return asset.level == RESIDENCY_EVICTED ? 0 : asset.levelBytes[asset.level]; }
+		void SetLevel(uint32_t asset, uint32_t level);
+		bool MakeRoom(uint64_t bytes);
+		uint64_t GetFreeableBytes(void) const;
+
+		std::vector<Asset>		m_assets;
+		std::vector<uint32_t>	m_freeAssets;
+		std::vector<uint32_t>	m_used;			// marked this frame, in the order they were first marked
+		std::vector<uint32_t>	m_candidates;	// unused resident assets, drawn longest ago first
+		std::vector<uint32_t>	m_changed;
+		uint32_t				m_maxRestores;
+		uint32_t				m_frame;
+		ResidencyStats			m_stats;
+	};
+}
@@ -0,0 +1,535 @@
+﻿#include "TexturePacker.h"
+#include "BCDecoder.h"
+#include "BCEncoder.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+
+using namespace DX;
+
+namespace
+{
+	// A source's place in an atlas page, at mip 0, guard included.
+	struct Slot
+	{
+		uint32_t	source;
+		uint32_t	x;
+		uint32_t	y;
+		uint32_t	width;
+		uint32_t	height;
+	};
+
+	// Atlases are laid out in units, texels or 4x4 blocks, which are copied whole.
+	uint32_t GetUnitSize(DXGI_FORMAT format)
+	{
+		return IsBlockCompressed(format) ? 4 : 1;
+	}
+
+	uint32_t GetUnitBytes(DXGI_FORMAT format)
+	{
+		return static_cast<uint32_t>(BitsPerPixel(format) * (IsBlockCompressed(format) ? 16 : 1) / 8);
+	}
+
+	bool IsPackable(const DDSTextureDesc& desc)
+	{
+		return desc.dimension == DDS_DIMENSION_TEXTURE2D && desc.arraySize == 1 && !desc.isCubeMap && IsTexturePackFormatSupported(desc.format);
+	}
+
+	// Mips for which every mip 0 texel of a region at a multiple of unit << (mips - 1) maps to a
+	// whole unit: the texture's width and height halve exactly that many times.
+	uint32_t GetAlignedMips(const DDSTextureDesc& desc, uint32_t unit)
+	{
+		uint32_t mips = 1;
+		while (mips < desc.mipCount && desc.width % (unit << mips) == 0 && desc.height % (unit << mips) == 0)
+			++mips;
+		return mips;
+	}
+
+	// Mips an atlas may have before its guard band is thinner than a unit.
+	uint32_t GetGuardMips(uint32_t guard, uint32_t unit)
+	{
+		uint32_t mips = 1;
+		while (mips < 16 && (unit << mips) <= guard)
+			++mips;
+		return mips;
+	}
+
+	uint32_t RoundUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Rewrites the indices of a 16 texel field, bits each from bitOffset, so texel t takes the
+	// index texel map[t] had; the endpoints stay, so the texels decode exactly as those they copy.
+	void RemapIndices(uint8_t* field, uint32_t bitOffset, uint32_t bits, const uint8_t map[BC_BLOCK_TEXELS])
+	{
+		uint64_t packed = 0;
+		for (uint32_t i = 0; i < 8; ++i)
+			packed |= static_cast<uint64_t>(field[i]) << (i * 8);
+
+		const uint64_t mask = (1ull << bits) - 1;
+		uint64_t remapped = packed;
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			const uint64_t index = (packed >> (bitOffset + map[t] * bits)) & mask;
+			remapped = (remapped & ~(mask << (bitOffset + t * bits))) | (index << (bitOffset + t * bits));
+		}
+		for (uint32_t i = 0; i < 8; ++i)
+			field[i] = static_cast<uint8_t>(remapped >> (i * 8));
+	}
+
+	// Turns a copy of an edge block into a guard block whose texels clamp to its edge column, row
+	// or corner: side -1 clamps to texel 0, 1 to texel 3 and 0 leaves the axis alone.
+	void ClampBlock(DXGI_FORMAT format, uint8_t* block, int sideX, int sideY)
+	{
+		uint8_t map[BC_BLOCK_TEXELS];
+		for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+		{
+			const uint32_t x = sideX < 0 ? 0 : sideX > 0 ? 3 : t % 4;
+			const uint32_t y = sideY < 0 ? 0 : sideY > 0 ? 3 : t / 4;
+			map[t] = static_cast<uint8_t>(y * 4 + x);
+		}
+
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			RemapIndices(block, 32, 2, map);
+			break;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			RemapIndices(block, 0, 4, map);
+			RemapIndices(block + 8, 32, 2, map);
+			break;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			RemapIndices(block, 16, 3, map);
+			RemapIndices(block + 8, 32, 2, map);
+			break;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			RemapIndices(block, 16, 3, map);
+			break;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+			RemapIndices(block, 16, 3, map);
+			RemapIndices(block + 8, 16, 3, map);
+			break;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+		{
+			// Partitions and anchor indices tie BC7 indices to their texels, so the block is
+			// decoded, clamped and encoded again.
+			uint8_t texels[BC_BLOCK_TEXELS * 4];
+			uint8_t clamped[BC_BLOCK_TEXELS * 4];
+			DecodeBCBlock(format, block, texels);
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				memcpy(clamped + t * 4, texels + map[t] * 4, 4);
+			EncodeBCBlock(BC_FORMAT_BC7, clamped, block);
+			break;
+		}
+		default:
+			// BC6H has no encoder here; its edge blocks are repeated as they are.
+			break;
+		}
+	}
+
+	// Copies one mip of a source into a region of the same mip of a page whose top left unit is
+	// at x, y, and fills guard units around it from the region's edge.
+	void CopyRegion(DXGI_FORMAT format, const uint8_t* source, const DDSSubresource& from, uint8_t* page, const DDSSubresource& to, uint32_t x, uint32_t y,
+		uint32_t guard)
+	{
+		const uint32_t unitBytes = GetUnitBytes(format);
+		const bool blocks = IsBlockCompressed(format);
+		const int width = static_cast<int>(from.rowBytes / unitBytes);
+		const int height = static_cast<int>(from.numRows);
+		const int band = static_cast<int>(guard);
+		for (int j = -band; j < height + band; ++j)
+		{
+			const int sourceY = std::min(std::max(j, 0), height - 1);
+			const int sideY = j < 0 ? -1 : j >= height ? 1 : 0;
+			const uint8_t* sourceRow = source + from.offset + static_cast<uint64_t>(sourceY) * from.rowBytes;
+			uint8_t* pageRow = page + to.offset + static_cast<uint64_t>(static_cast<int>(y) + j) * to.rowBytes;
+			if (!blocks)
+			{
+				for (int i = -band; i < 0; ++i)
+					memcpy(pageRow + (static_cast<int>(x) + i) * unitBytes, sourceRow, unitBytes);
+				memcpy(pageRow + x * unitBytes, sourceRow, from.rowBytes);
+				for (int i = width; i < width + band; ++i)
+					memcpy(pageRow + (static_cast<int>(x) + i) * unitBytes, sourceRow + (width - 1) * unitBytes, unitBytes);
+				continue;
+			}
+
+			for (int i = -band; i < width + band; ++i)
+			{
+				const int sourceX = std::min(std::max(i, 0), width - 1);
+				const int sideX = i < 0 ? -1 : i >= width ? 1 : 0;
+				uint8_t* unit = pageRow + (static_cast<int>(x) + i) * unitBytes;
+				memcpy(unit, sourceRow + sourceX * unitBytes, unitBytes);
+				if (sideX != 0 || sideY != 0)
+					ClampBlock(format, unit, sideX, sideY);
+			}
+		}
+	}
+
+	TexturePackPage CreatePage(TexturePackLayout layout, DXGI_FORMAT format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize)
+	{
+		TexturePackPage page;
+		page.layout = layout;
+		page.desc.dimension = DDS_DIMENSION_TEXTURE2D;
+		page.desc.format = format;
+		page.desc.width = width;
+		page.desc.height = height;
+		page.desc.depth = 1;
+		page.desc.mipCount = mipCount;
+		page.desc.arraySize = arraySize;
+		page.desc.isCubeMap = false;
+		uint8_t header[DDS_MAX_HEADER_SIZE];
+		page.desc.headerSize = WriteDDSHeader(page.desc, header);
+		page.desc.dataSize = ComputeDDSLayout(page.desc, nullptr);
+		page.bits.assign(static_cast<size_t>(page.desc.dataSize), 0);
+		page.sourceCount = 0;
+		page.sourceTexels = 0;
+		return page;
+	}
+
+	void PackArray(const TexturePackSource* sources, const std::vector<uint32_t>& group, uint32_t mipCount, std::vector<TexturePackPage>& outPages,
+		std::vector<TexturePackEntry>& outEntries)
+	{
+		const DDSTextureDesc& first = sources[group[0]].desc;
+		for (size_t begin = 0; begin < group.size(); begin += TEXTURE_PACK_MAX_SLICES)
+		{
+			const uint32_t slices = static_cast<uint32_t>(std::min<size_t>(group.size() - begin, TEXTURE_PACK_MAX_SLICES));
+			TexturePackPage page = CreatePage(TEXTURE_PACK_ARRAY, first.format, first.width, first.height, mipCount, slices);
+			std::vector<DDSSubresource> layout(static_cast<size_t>(mipCount) * slices);
+			ComputeDDSLayout(page.desc, layout.data());
+			for (uint32_t slice = 0; slice < slices; ++slice)
+			{
+				const TexturePackSource& source = sources[group[begin + slice]];
+				std::vector<DDSSubresource> sourceLayout(source.desc.mipCount);
+				ComputeDDSLayout(source.desc, sourceLayout.data());
+				for (uint32_t mip = 0; mip < mipCount; ++mip)
+				{
+					const DDSSubresource& to = layout[slice * mipCount + mip];
+					memcpy(page.bits.data() + to.offset, source.bits + sourceLayout[mip].offset, static_cast<size_t>(to.sliceBytes));
+				}
+
+				TexturePackEntry& entry = outEntries[group[begin + slice]];
+				entry.page = static_cast<uint32_t>(outPages.size());
+				entry.slice = slice;
+				entry.uvScaleOffset[0] = entry.uvScaleOffset[1] = 1.0f;
+				entry.uvScaleOffset[2] = entry.uvScaleOffset[3] = 0.0f;
+				entry.x = entry.y = 0;
+				page.sourceTexels += static_cast<uint64_t>(first.width) * first.height;
+			}
+			page.sourceCount = slices;
+			outPages.push_back(std::move(page));
+		}
+	}
+
+	void BuildAtlas(const TexturePackSource* sources, const std::vector<Slot>& slots, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t guard,
+		std::vector<TexturePackPage>& outPages, std::vector<TexturePackEntry>& outEntries)
+	{
+		// A page of one texture binds no less often than the texture would.
+		if (slots.size() < 2)
+			return;
+
+		const DXGI_FORMAT format = sources[slots[0].source].desc.format;
+		const uint32_t unit = GetUnitSize(format);
+		TexturePackPage page = CreatePage(TEXTURE_PACK_ATLAS, format, width, height, mipCount, 1);
+		std::vector<DDSSubresource> layout(mipCount);
+		ComputeDDSLayout(page.desc, layout.data());
+		for (const Slot& slot : slots)
+		{
+			const TexturePackSource& source = sources[slot.source];
+			std::vector<DDSSubresource> sourceLayout(source.desc.mipCount);
+			ComputeDDSLayout(source.desc, sourceLayout.data());
+			const uint32_t x = slot.x + guard;
+			const uint32_t y = slot.y + guard;
+			for (uint32_t mip = 0; mip < mipCount; ++mip)
+				CopyRegion(format, source.bits, sourceLayout[mip], page.bits.data(), layout[mip], (x >> mip) / unit, (y >> mip) / unit, (guard >> mip) / unit);
+
+			TexturePackEntry& entry = outEntries[slot.source];
+			entry.page = static_cast<uint32_t>(outPages.size());
+			entry.slice = 0;
+			entry.uvScaleOffset[0] = static_cast<float>(source.desc.width) / width;
+			entry.uvScaleOffset[1] = static_cast<float>(source.desc.height) / height;
+			entry.uvScaleOffset[2] = static_cast<float>(x) / width;
+			entry.uvScaleOffset[3] = static_cast<float>(y) / height;
+			entry.x = x;
+			entry.y = y;
+			page.sourceTexels += static_cast<uint64_t>(source.desc.width) * source.desc.height;
+		}
+		page.sourceCount = static_cast<uint32_t>(slots.size());
+		outPages.push_back(std::move(page));
+	}
+
+	// Shelf packs the group, tallest first, into pages about as wide as they are tall and no
+	// larger than maxSize. Every slot is a multiple of the alignment, so every region is too.
+	void PackAtlas(const TexturePackSource* sources, std::vector<uint32_t> group, uint32_t mipCount, uint32_t guard, uint32_t maxSize,
+		std::vector<TexturePackPage>& outPages, std::vector<TexturePackEntry>& outEntries)
+	{
+		std::stable_sort(group.begin(), group.end(), [sources](uint32_t a, uint32_t b)
+		{
+			return sources[a].desc.height != sources[b].desc.height ? sources[a].desc.height > sources[b].desc.height : sources[a].desc.width > sources[b].desc.width;
+		});
+
+		double area = 0.0;
+		uint32_t widest = 0;
+		for (uint32_t source : group)
+		{
+			area += static_cast<double>(sources[source].desc.width + guard * 2) * (sources[source].desc.height + guard * 2);
+			widest = std::max(widest, sources[source].desc.width + guard * 2);
+		}
+		uint32_t pageWidth = 1;
+		while (pageWidth < maxSize && static_cast<double>(pageWidth) * pageWidth < area)
+			pageWidth *= 2;
+		pageWidth = std::max(std::min(pageWidth, maxSize), widest);
+
+		std::vector<Slot> slots;
+		uint32_t shelfX = 0;
+		uint32_t shelfY = 0;
+		uint32_t shelfHeight = 0;
+		uint32_t usedWidth = 0;
+		for (uint32_t source : group)
+		{
+			Slot slot = { source, 0, 0, sources[source].desc.width + guard * 2, sources[source].desc.height + guard * 2 };
+			if (shelfX + slot.width > pageWidth)
+			{
+				shelfX = 0;
+				shelfY += shelfHeight;
+				shelfHeight = 0;
+			}
+			if (shelfY + slot.height > maxSize)
+			{
+				BuildAtlas(sources, slots, usedWidth, shelfY + shelfHeight, mipCount, guard, outPages, outEntries);
+				slots.clear();
+				shelfX = shelfY = shelfHeight = usedWidth = 0;
+			}
+			slot.x = shelfX;
+			slot.y = shelfY;
+			slots.push_back(slot);
+			shelfX += slot.width;
+			shelfHeight = std::max(shelfHeight, slot.height);
+			usedWidth = std::max(usedWidth, shelfX);
+		}
+		if (!slots.empty())
+			BuildAtlas(sources, slots, usedWidth, shelfY + shelfHeight, mipCount, guard, outPages, outEntries);
+	}
+
+	std::string NormalizePath(const char* path)
+	{
+		std::string out(path);
+		std::replace(out.begin(), out.end(), '\\', '/');
+		return out;
+	}
+}
+
+bool DX::IsTexturePackFormatSupported(DXGI_FORMAT format)
+{
+	const size_t bits = BitsPerPixel(format);
+	if (bits == 0 || format == DXGI_FORMAT_R8G8_B8G8_UNORM || format == DXGI_FORMAT_G8R8_G8B8_UNORM)
+		return false;
+	return IsBlockCompressed(format) || bits % 8 == 0;
+}
+
+DDSResult DX::PackTextures(const TexturePackSource* sources, uint32_t sourceCount, const TexturePackOptions& options, std::vector<TexturePackPage>& outPages,
+	std::vector<TexturePackEntry>& outEntries)
+{
+	if (options.layout >= TEXTURE_PACK_LAYOUT_COUNT || options.maxSize == 0 || options.maxSize > 16384)
+		return DDS_NOT_SUPPORTED;
+
+	outPages.clear();
+	TexturePackEntry unpacked = { TEXTURE_PACK_NONE, 0, { 1.0f, 1.0f, 0.0f, 0.0f }, 0, 0 };
+	outEntries.assign(sourceCount, unpacked);
+
+	// Arrays take the sources that share a format, size and mips with another; keys order the
+	// groups so the pages come out the same for the same sources.
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, std::vector<uint32_t>> arrays;
+	std::vector<uint32_t> rest;
+	for (uint32_t i = 0; i < sourceCount; ++i)
+	{
+		const DDSTextureDesc& desc = sources[i].desc;
+		if (!IsPackable(desc))
+			continue;
+		if (options.layout == TEXTURE_PACK_ATLAS)
+		{
+			rest.push_back(i);
+			continue;
+		}
+		const uint32_t mips = options.mipCount ? std::min(options.mipCount, desc.mipCount) : desc.mipCount;
+		arrays[std::make_tuple(static_cast<uint32_t>(desc.format), desc.width, desc.height, mips)].push_back(i);
+	}
+	for (const auto& group : arrays)
+	{
+		if (group.second.size() > 1)
+			PackArray(sources, group.second, std::get<3>(group.first), outPages, outEntries);
+		else if (options.layout == TEXTURE_PACK_AUTO)
+			rest.push_back(group.second[0]);
+	}
+
+	// Atlases take the rest, grouped by format and by the mips their regions can keep.
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> atlases;
+	for (uint32_t i : rest)
+	{
+		const DDSTextureDesc& desc = sources[i].desc;
+		const uint32_t unit = GetUnitSize(desc.format);
+		uint32_t mips = std::min(GetAlignedMips(desc, unit), GetGuardMips(options.guard, unit));
+		mips = options.mipCount ? std::min(options.mipCount, mips) : mips;
+		const uint32_t guard = RoundUp(options.guard, unit << (mips - 1));
+		if (desc.width + guard * 2 <= options.maxSize && desc.height + guard * 2 <= options.maxSize)
+			atlases[std::make_pair(static_cast<uint32_t>(desc.format), mips)].push_back(i);
+	}
+	for (const auto& group : atlases)
+	{
+		if (group.second.size() < 2)
+			continue;
+		const uint32_t mips = group.first.second;
+		const uint32_t guard = RoundUp(options.guard, GetUnitSize(static_cast<DXGI_FORMAT>(group.first.first)) << (mips - 1));
+		PackAtlas(sources, group.second, mips, guard, options.maxSize, outPages, outEntries);
+	}
+	return DDS_OK;
+}
+
+bool DX::WriteTexturePackTable(const char* path, const TexturePackPage* pages, const char* const* pagePaths, uint32_t pageCount,
+	const TexturePackEntry* entries, const char* const* sourcePaths, uint32_t sourceCount)
+{
+	std::string strings;
+	std::vector<TexturePackTablePage> tablePages(pageCount);
+	for (uint32_t i = 0; i < pageCount; ++i)
+	{
+		TexturePackTablePage& page = tablePages[i];
+		page.pathOffset = static_cast<uint32_t>(strings.size());
+		page.layout = pages[i].layout;
+		page.format = pages[i].desc.format;
+		page.width = pages[i].desc.width;
+		page.height = pages[i].desc.height;
+		page.mipCount = pages[i].desc.mipCount;
+		page.arraySize = pages[i].desc.arraySize;
+		strings += NormalizePath(pagePaths[i]);
+		strings += '\0';
+	}
+
+	std::vector<std::pair<std::string, uint32_t>> packed;
+	for (uint32_t i = 0; i < sourceCount; ++i)
+	{
+		if (entries[i].page != TEXTURE_PACK_NONE)
+			packed.push_back(std::make_pair(NormalizePath(sourcePaths[i]), i));
+	}
+	std::sort(packed.begin(), packed.end());
+	std::vector<TexturePackTableEntry> tableEntries;
+	for (size_t i = 0; i < packed.size(); ++i)
+	{
+		// The same path given twice keeps the first.
+		if (i > 0 && packed[i].first == packed[i - 1].first)
+			continue;
+		const TexturePackEntry& source = entries[packed[i].second];
+		TexturePackTableEntry entry;
+		entry.pathOffset = static_cast<uint32_t>(strings.size());
+		entry.page = source.page;
+		entry.slice = source.slice;
+		memcpy(entry.uvScaleOffset, source.uvScaleOffset, sizeof(entry.uvScaleOffset));
+		tableEntries.push_back(entry);
+		strings += packed[i].first;
+		strings += '\0';
+	}
+
+	TexturePackTableHeader header;
+	header.magic = TEXTURE_PACK_MAGIC;
+	header.version = TEXTURE_PACK_VERSION;
+	header.pageCount = pageCount;
+	header.entryCount = static_cast<uint32_t>(tableEntries.size());
+	header.stringBytes = static_cast<uint32_t>(strings.size());
+
+	FILE* file = OpenFile(path, "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(tablePages.data(), sizeof(TexturePackTablePage), tablePages.size(), file) == tablePages.size() &&
+		fwrite(tableEntries.data(), sizeof(TexturePackTableEntry), tableEntries.size(), file) == tableEntries.size() &&
+		fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+	return (fclose(file) == 0) && written;
+}
+
+TexturePackTable::TexturePackTable(void) :
+	m_header(nullptr),
+	m_pages(nullptr),
+	m_entries(nullptr),
+	m_strings(nullptr)
+{
+}
+
+bool TexturePackTable::Open(const char* path)
+{
+	Close();
+	if (!m_file.Open(path) || m_file.GetSize() < sizeof(TexturePackTableHeader))
+		return false;
+
+	const TexturePackTableHeader* header = reinterpret_cast<const TexturePackTableHeader*>(m_file.GetData());
+	const uint64_t size = sizeof(TexturePackTableHeader) + static_cast<uint64_t>(header->pageCount) * sizeof(TexturePackTablePage) +
+		static_cast<uint64_t>(header->entryCount) * sizeof(TexturePackTableEntry) + header->stringBytes;
+	if (header->magic != TEXTURE_PACK_MAGIC || header->version != TEXTURE_PACK_VERSION || size != m_file.GetSize() ||
+		(header->stringBytes > 0 && m_file.GetData()[size - 1] != '\0'))
+	{
+		m_file.Close();
+		return false;
+	}
+
+	const TexturePackTablePage* pages = reinterpret_cast<const TexturePackTablePage*>(header + 1);
+	const TexturePackTableEntry* entries = reinterpret_cast<const TexturePackTableEntry*>(pages + header->pageCount);
+	const char* strings = reinterpret_cast<const char*>(entries + header->entryCount);
+	bool valid = true;
+	for (uint32_t i = 0; i < header->pageCount; ++i)
+		valid = valid && pages[i].pathOffset < header->stringBytes && pages[i].layout < TEXTURE_PACK_AUTO;
+	for (uint32_t i = 0; i < header->entryCount; ++i)
+	{
+		valid = valid && entries[i].pathOffset < header->stringBytes && entries[i].page < header->pageCount &&
+			entries[i].slice < pages[entries[i].page].arraySize;
+		// Find searches the paths in halves.
+		valid = valid && (i == 0 || strcmp(strings + entries[i - 1].pathOffset, strings + entries[i].pathOffset) < 0);
+	}
+	if (!valid)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	m_header = header;
+	m_pages = pages;
+	m_entries = entries;
+	m_strings = strings;
+	return true;
+}
+
+void TexturePackTable::Close(void)
+{
+	m_file.Close();
+	m_header = nullptr;
+	m_pages = nullptr;
+	m_entries = nullptr;
+	m_strings = nullptr;
+}
+
+const TexturePackTableEntry* TexturePackTable::Find(const char* path) const
+{
+	if (!m_header)
+		return nullptr;
+
+	const std::string key = NormalizePath(path);
+	const TexturePackTableEntry* end = m_entries + m_header->entryCount;
+	const TexturePackTableEntry* found = std::lower_bound(m_entries, end, key, [this](const TexturePackTableEntry& entry, const std::string& value)
+	{
+		return strcmp(m_strings + entry.pathOffset, value.c_str()) < 0;
+	});
+	return found != end && key == m_strings + found->pathOffset ? found : nullptr;
+}
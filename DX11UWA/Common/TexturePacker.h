@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include "DDSFile.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+	enum TexturePackLayout
+	{
+		TEXTURE_PACK_ATLAS,		// regions of one 2D texture, reached by remapping uvs
+		TEXTURE_PACK_ARRAY,		// slices of a Texture2DArray, reached by slice index
+		TEXTURE_PACK_AUTO,		// arrays for textures that share a format and size, atlases for the rest
+		TEXTURE_PACK_LAYOUT_COUNT
+	};
+
+	const uint32_t TEXTURE_PACK_NONE = 0xffffffff;
+	const uint32_t TEXTURE_PACK_DEFAULT_MAX_SIZE = 4096;
+	const uint32_t TEXTURE_PACK_DEFAULT_GUARD = 16;
+	const uint32_t TEXTURE_PACK_MAX_SLICES = 2048;	// D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+
+	struct TexturePackOptions
+	{
+		TexturePackLayout	layout;
+		uint32_t			maxSize;	// largest atlas side
+		uint32_t			guard;		// texels of clamped edge around each atlas region at mip 0, rounded up to the alignment
+		uint32_t			mipCount;	// most mips a page keeps, 0 for as many as its sources allow
+	};
+
+	// A 2D DDS texture to pack, as ValidateDDS describes it, and its bits.
+	struct TexturePackSource
+	{
+		DDSTextureDesc	desc;
+		const uint8_t*	bits;
+	};
+
+	// Where a source went: page TEXTURE_PACK_NONE when it was left out, because it is not a single
+	// 2D texture in a format with whole bytes a texel or 4x4 blocks, or nothing shares its page.
+	struct TexturePackEntry
+	{
+		uint32_t	page;
+		uint32_t	slice;				// 0 in an atlas
+		float		uvScaleOffset[4];	// source uv to page uv: xy scale, zw offset
+		uint32_t	x;					// of the region at mip 0, in texels
+		uint32_t	y;
+	};
+
+	struct TexturePackPage
+	{
+		TexturePackLayout		layout;		// atlas or array
+		DDSTextureDesc			desc;		// headerSize is what WriteDDSHeader will give
+		std::vector<uint8_t>	bits;		// laid out as ComputeDDSLayout(desc) gives
+		uint32_t				sourceCount;
+		uint64_t				sourceTexels;	// at mip 0, for occupancy
+	};
+
+	// Whether PackTextures can place textures of the format: BC1 to BC7 and formats with a whole
+	// number of bytes a texel.
+	bool IsTexturePackFormatSupported(DXGI_FORMAT format);
+
+	// Packs sources that share a format into pages and fills one entry per source. Atlases are
+	// packed in shelves no wider or taller than maxSize. Each region is surrounded by a guard band
+	// of its own edge texels, clamped; block compressed regions get edge blocks whose indices are
+	// clamped the same way, re-encoded for BC7 and repeated as they are for BC6H. Every mip of a
+	// page is its sources' own mip rather than a filtered atlas, so no region bleeds into another
+	// as the mips shrink, and atlases stop at the mip where the guard is one texel or block.
+	// Regions are aligned so they halve exactly down to that mip, which also limits the mips to
+	// what every source of the page divides into. Arrays keep the mips their sources share.
+	// DDS_NOT_SUPPORTED for bad options.
+	DDSResult PackTextures(const TexturePackSource* sources, uint32_t sourceCount, const TexturePackOptions& options, std::vector<TexturePackPage>& outPages,
+		std::vector<TexturePackEntry>& outEntries);
+
+	// Lookup table, version 1: which page each packed texture went to and how to reach it. The
+	// header is followed by the pages, the entries sorted by path and then the strings, each
+	// NUL-terminated. Paths use forward slashes. Every field is little-endian.
+	const uint32_t TEXTURE_PACK_MAGIC = 0x4B415054;	// "TPAK"
+	const uint32_t TEXTURE_PACK_VERSION = 1;
+
+	struct TexturePackTableHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	pageCount;
+		uint32_t	entryCount;
+		uint32_t	stringBytes;
+	};
+
+	struct TexturePackTablePage
+	{
+		uint32_t	pathOffset;		// into the strings
+		uint32_t	layout;			// TexturePackLayout
+		uint32_t	format;			// DXGI_FORMAT
+		uint32_t	width;
+		uint32_t	height;
+		uint32_t	mipCount;
+		uint32_t	arraySize;
+	};
+
+	struct TexturePackTableEntry
+	{
+		uint32_t	pathOffset;
+		uint32_t	page;
+		uint32_t	slice;
+		float		uvScaleOffset[4];
+	};
+
+	// Writes the table for the packed entries; pagePaths and sourcePaths name the page files and
+	// the sources as the runtime will look them up.
+	bool WriteTexturePackTable(const char* path, const TexturePackPage* pages, const char* const* pagePaths, uint32_t pageCount,
+		const TexturePackEntry* entries, const char* const* sourcePaths, uint32_t sourceCount);
+
+	// A lookup table mapped read-only.
+	class TexturePackTable
+	{
+	public:
+		TexturePackTable(void);
+
+		// Fails when the file is missing or does not hold a valid table.
+		bool Open(const char* path);
+		void Close(void);
+		// The entry of a source path, with either kind of slash, or null when it was not packed.
+		const TexturePackTableEntry* Find(const char* path) const;
+
+		bool IsOpen(void) const										{ return m_header != nullptr; }
+		uint32_t GetPageCount(void) const							{ return m_header->pageCount; }
+		uint32_t GetEntryCount(void) const							{ return m_header->entryCount; }
+		const TexturePackTablePage& GetPage(uint32_t page) const	{ return m_pages[page]; }
+		const TexturePackTableEntry& GetEntry(uint32_t entry) const	{ return m_entries[entry]; }
+		const char* GetString(uint32_t offset) const				{ return m_strings + offset; }
+
+	private:
+		TexturePackTable(const TexturePackTable&);
+		TexturePackTable& operator=(const TexturePackTable&);
+
+		MappedFile						m_file;
+		const TexturePackTableHeader*	m_header;
+		const TexturePackTablePage*		m_pages;
+		const TexturePackTableEntry*	m_entries;
+		const char*						m_strings;
+	};
+}
@@ -0,0 +1,489 @@
+﻿#include "pch.h"
+#include "TextureStreamer.h"
+
+#include "CompressedFile.h"
+#include "DDSTextureLoader.h"
+#include "MappedFile.h"
+#include "UniversalTexture.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DX;
+
+namespace
+{
+	// Largest dimension of any mip from skip down.
+	size_t GetMipResolution(const DDSTextureDesc& desc, uint32_t skip)
+	{
+		return std::max<size_t>(std::max(desc.width, std::max(desc.height, desc.depth)) >> skip, 1);
+	}
+
+	// Reads just the headers of a DDS file, compressed or not, or describes the DDS texture a
+	// universal texture transcodes to.
+	bool ReadTextureDesc(const uint8_t* data, size_t size, DDSTextureDesc& desc)
+	{
+		if (IsUniversalTexture(data, size))
+			return ParseUniversalTexture(data, size, desc) == DDS_OK;
+		if (DetectCompression(data, size) == COMPRESSION_NONE)
+			return ParseDDSHeader(data, size, desc) == DDS_OK;
+
+		CompressedFile stream;
+		uint8_t header[DDS_MAX_HEADER_SIZE];
+		return stream.Open(data, size) && ReadDDSHeader(stream, header, desc) == DDS_OK;
+	}
+
+	// Transcodes a universal texture from skip down to the format it was encoded for, or to BC3
+	// instead of BC7 on devices below feature level 11_0, which cannot sample BC7.
+	bool TranscodeForDevice(ID3D11Device* device, const uint8_t* data, size_t size, uint32_t skip, std::vector<uint8_t>& outDDS)
+	{
+		UniversalTextureHeader header;
+		memcpy(&header, data, sizeof(header));
+		BCFormat target = BC_FORMAT_COUNT;
+		if (header.target == BC_FORMAT_BC7 && device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0)
+			target = BC_FORMAT_BC3;
+		return TranscodeUniversalTexture(data, size, target, skip, outDDS) != 0;
+	}
+
+	// Creates a texture at the initial resolution. Universal textures are transcoded from that
+	// resolution down only.
+	HRESULT CreateInitialTexture(ID3D11Device* device, const wchar_t* path, ID3D11ShaderResourceView** outView)
+	{
+		MappedFile file;
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX || !IsUniversalTexture(file.GetData(), static_cast<size_t>(file.GetSize())))
+			return CreateDDSTextureFromFile(device, path, nullptr, outView, TEXTURE_STREAMING_INITIAL_SIZE);
+
+		DDSTextureDesc desc;
+		std::vector<uint8_t> transcoded;
+		const size_t size = static_cast<size_t>(file.GetSize());
+		if (ParseUniversalTexture(file.GetData(), size, desc) != DDS_OK ||
+			!TranscodeForDevice(device, file.GetData(), size, GetDDSSkipMips(desc, TEXTURE_STREAMING_INITIAL_SIZE), transcoded))
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		return CreateDDSTextureFromMemory(device, transcoded.data(), transcoded.size(), nullptr, outView);
+	}
+
+	uint64_t Rotate(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t ReadWord(const uint8_t* p)
+	{
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		return word;
+	}
+
+	// Hash of every byte of a file, four lanes at a time so it keeps up with the disk.
+	uint64_t HashContents(const uint8_t* data, size_t size)
+	{
+		const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+		const uint8_t* p = data;
+		const uint8_t* end = data + size;
+		uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+		for (; end - p >= 32; p += 32)
+		{
+			for (int lane = 0; lane < 4; ++lane)
+				lanes[lane] = Rotate(lanes[lane] + ReadWord(p + lane * 8) * prime2, 31) * prime1;
+		}
+
+		uint64_t hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) + Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+		hash ^= static_cast<uint64_t>(size);
+		for (; p < end; ++p)
+			hash = Rotate(hash ^ (*p * prime1), 11) * prime2;
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		return hash;
+	}
+
+	std::wstring NormalizePath(const wchar_t* path)
+	{
+		std::wstring out(path);
+		std::replace(out.begin(), out.end(), L'\\', L'/');
+		return out;
+	}
+}
+
+TextureStreamer::TextureStreamer(void) :
+	m_device(nullptr),
+	m_stopping(false),
+	m_deviceReleased(false)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+TextureStreamer::~TextureStreamer(void)
+{
+	Stop();
+}
+
+void TextureStreamer::Start(ID3D11Device* device)
+{
+	if (m_deviceReleased)
+		StopWorker();
+	else
+		Stop();
+	m_device = device;
+	m_stopping = false;
+	if (m_deviceReleased)
+		RestoreTextures();
+	m_deviceReleased = false;
+	m_worker = std::thread([this]() { WorkerLoop(); });
+}
+
+void TextureStreamer::Stop(void)
+{
+	StopWorker();
+	m_textures.clear();
+	m_paths.clear();
+	m_contents.clear();
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_device = nullptr;
+	m_deviceReleased = false;
+}
+
+void TextureStreamer::ReleaseDevice(void)
+{
+	StopWorker();
+	for (Texture& texture : m_textures)
+	{
+		// A view nothing but this streamer holds is no longer drawn with.
+		texture.referenced = false;
+		if (texture.view.Get())
+		{
+			texture.view->AddRef();
+			texture.referenced = texture.view->Release() > 1;
+		}
+		texture.view.Reset();
+		texture.queued = false;
+	}
+	m_device = nullptr;
+	m_deviceReleased = true;
+}
+
+// Waits for the load in progress and drops the queued ones and their results.
+void TextureStreamer::StopWorker(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stopping = true;
+		m_jobs.clear();
+	}
+	m_wake.notify_all();
+	if (m_worker.joinable())
+		m_worker.join();
+	m_results.clear();
+}
+
+// Reloads the textures ReleaseDevice kept, at the initial resolution, and queues them back up to
+// their target; the rest are forgotten, paths and all, and the handles renumbered.
+void TextureStreamer::RestoreTextures(void)
+{
+	std::vector<uint32_t> remap(m_textures.size(), UINT32_MAX);
+	std::vector<Texture> kept;
+	for (uint32_t handle = 0; handle < m_textures.size(); ++handle)
+	{
+		Texture& texture = m_textures[handle];
+		if (!texture.referenced || FAILED(CreateInitialTexture(m_device, texture.path.c_str(), texture.view.ReleaseAndGetAddressOf())))
+		{
+			m_stats.droppedCount++;
+			continue;
+		}
+
+		texture.loadedSkip = GetDDSSkipMips(texture.desc, TEXTURE_STREAMING_INITIAL_SIZE);
+		texture.referenced = false;
+		remap[handle] = static_cast<uint32_t>(kept.size());
+		kept.push_back(texture);
+		m_stats.restoredCount++;
+	}
+	m_textures.swap(kept);
+
+	for (auto entry = m_paths.begin(); entry != m_paths.end();)
+	{
+		entry->second = remap[entry->second];
+		entry = entry->second == UINT32_MAX ? m_paths.erase(entry) : std::next(entry);
+	}
+	for (auto entry = m_contents.begin(); entry != m_contents.end();)
+	{
+		entry->second = remap[entry->second];
+		entry = entry->second == UINT32_MAX ? m_contents.erase(entry) : std::next(entry);
+	}
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_stats.textureCount = static_cast<uint32_t>(m_textures.size());
+	for (uint32_t handle = 0; handle < m_textures.size(); ++handle)
+		QueueLoad(handle);
+}
+
+HRESULT TextureStreamer::Load(const wchar_t* path, ID3D11ShaderResourceView** outView, uint32_t* outHandle)
+{
+	if (outHandle)
+		*outHandle = UINT32_MAX;
+	if (!m_device || !outView)
+		return E_INVALIDARG;
+
+	auto start = std::chrono::steady_clock::now();
+	const std::wstring key = NormalizePath(path);
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto found = m_paths.find(key);
+		if (found != m_paths.end())
+		{
+			m_stats.pathHits++;
+			return Share(found->second, outView, outHandle);
+		}
+	}
+
+	// Files are told apart by their size and a hash of all of their bytes, so a copy under
+	// another path shares the texture too.
+	Texture texture;
+	{
+		MappedFile file;
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX || !ReadTextureDesc(file.GetData(), static_cast<size_t>(file.GetSize()), texture.desc))
+			return CreateDDSTextureFromFile(m_device, path, nullptr, outView);	// for its error
+		texture.fileSize = file.GetSize();
+		texture.contentHash = HashContents(file.GetData(), static_cast<size_t>(file.GetSize()));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto found = m_contents.find(texture.contentHash);
+		if (found != m_contents.end() && m_textures[found->second].fileSize == texture.fileSize)
+		{
+			m_paths[key] = found->second;
+			m_stats.contentHits++;
+			return Share(found->second, outView, outHandle);
+		}
+	}
+
+	HRESULT hr = CreateInitialTexture(m_device, path, texture.view.GetAddressOf());
+	if (FAILED(hr))
+		return hr;
+
+	texture.path = path;
+	texture.loadedSkip = GetDDSSkipMips(texture.desc, TEXTURE_STREAMING_INITIAL_SIZE);
+	texture.targetSkip = 0;
+	texture.queued = false;
+	texture.referenced = false;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	// Another thread may have loaded the same file meanwhile; its texture wins.
+	auto found = m_paths.find(key);
+	if (found != m_paths.end())
+	{
+		m_stats.pathHits++;
+		return Share(found->second, outView, outHandle);
+	}
+
+	uint32_t handle = static_cast<uint32_t>(m_textures.size());
+	m_textures.push_back(texture);
+	m_paths[key] = handle;
+	m_contents.insert(std::make_pair(texture.contentHash, handle));
+	m_stats.textureCount++;
+	m_stats.missCount++;
+	m_stats.initialSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	*outView = texture.view.Get();
+	(*outView)->AddRef();
+	if (outHandle)
+		*outHandle = handle;
+	QueueLoad(handle);
+	return S_OK;
+}
+
+// Called with m_lock held. Hands out another reference to a texture already loaded, at whatever
+// resolution it has reached; swaps update it for every holder alike.
+HRESULT TextureStreamer::Share(uint32_t handle, ID3D11ShaderResourceView** outView, uint32_t* outHandle)
+{
+	const Texture& texture = m_textures[handle];
+	m_stats.bytesSaved += GetDDSLoadedSize(texture.desc, 0);
+	*outView = texture.view.Get();
+	(*outView)->AddRef();
+	if (outHandle)
+		*outHandle = handle;
+	return S_OK;
+}
+
+void TextureStreamer::SetTargetResolution(uint32_t handle, size_t maxSize)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (handle >= m_textures.size())
+		return;
+
+	Texture& texture = m_textures[handle];
+	texture.targetSkip = GetDDSSkipMips(texture.desc, maxSize);
+	QueueLoad(handle);
+}
+
+size_t TextureStreamer::GetResolution(uint32_t handle) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return handle < m_textures.size() ? GetMipResolution(m_textures[handle].desc, m_textures[handle].loadedSkip) : 0;
+}
+
+size_t TextureStreamer::GetTargetResolution(uint32_t handle) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return handle < m_textures.size() ? GetMipResolution(m_textures[handle].desc, m_textures[handle].targetSkip) : 0;
+}
+
+uint32_t TextureStreamer::GetTextureCount(void) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return static_cast<uint32_t>(m_textures.size());
+}
+
+DDSTextureDesc TextureStreamer::GetDesc(uint32_t handle) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_textures[handle].desc;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureStreamer::GetView(uint32_t handle) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_textures[handle].view;
+}
+
+// Called with m_lock held. A texture has at most one load queued or running; when it finishes,
+// Update queues the next one if the target moved in the meantime.
+void TextureStreamer::QueueLoad(uint32_t handle)
+{
+	Texture& texture = m_textures[handle];
+	if (texture.queued || texture.loadedSkip == texture.targetSkip || m_stopping)
+		return;
+
+	Job job;
+	job.handle = handle;
+	job.path = texture.path;
+	job.maxSize = GetMipResolution(texture.desc, texture.targetSkip);
+	m_jobs.push_back(job);
+	texture.queued = true;
+	texture.requested = std::chrono::steady_clock::now();
+	m_wake.notify_one();
+}
+
+void TextureStreamer::Update(std::vector<TextureSwap>& outSwaps)
+{
+	outSwaps.clear();
+	std::lock_guard<std::mutex> lock(m_lock);
+	auto now = std::chrono::steady_clock::now();
+	for (Result& result : m_results)
+	{
+		Texture& texture = m_textures[result.handle];
+		texture.queued = false;
+		if (FAILED(result.hr))
+		{
+			// Stay at the resolution that loaded rather than retrying every frame
+			m_stats.failedCount++;
+			texture.targetSkip = texture.loadedSkip;
+			char message[256];
+			sprintf_s(message, "TextureStreamer: %ls could not be streamed in (0x%08x), staying at %u px\n", texture.path.c_str(),
+				static_cast<unsigned int>(result.hr), static_cast<unsigned int>(GetMipResolution(texture.desc, texture.loadedSkip)));
+			OutputDebugStringA(message);
+			continue;
+		}
+
+		TextureSwap swap;
+		swap.handle = result.handle;
+		swap.oldView = texture.view;
+		swap.newView = result.view;
+		outSwaps.push_back(swap);
+		texture.view = result.view;
+		texture.loadedSkip = result.skip;
+
+		double latency = std::chrono::duration<double>(now - texture.requested).count();
+		m_stats.loadCount++;
+		m_stats.totalLatencySeconds += latency;
+		m_stats.maxLatencySeconds = std::max(m_stats.maxLatencySeconds, latency);
+		m_stats.streamedBytes += result.bytes;
+		QueueLoad(result.handle);
+	}
+	m_results.clear();
+}
+
+TextureStreamingStats TextureStreamer::GetStats(void) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	TextureStreamingStats stats = m_stats;
+	stats.pendingCount = 0;
+	for (const Texture& texture : m_textures)
+		stats.pendingCount += texture.loadedSkip != texture.targetSkip ? 1 : 0;
+	return stats;
+}
+
+void TextureStreamer::WorkerLoop(void)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	for (;;)
+	{
+		m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+		if (m_stopping)
+			return;
+
+		Job job = m_jobs.front();
+		m_jobs.pop_front();
+		lock.unlock();
+
+		Result result;
+		result.handle = job.handle;
+		result.skip = 0;
+		result.bytes = 0;
+		result.hr = LoadLevel(job, result);
+
+		lock.lock();
+		if (!m_stopping)
+			m_results.push_back(result);
+	}
+}
+
+// Creates the whole texture from maxSize down, through the device only. Uncompressed files are
+// mapped, so only the pages of the mips that are kept are read; compressed ones are decompressed
+// whole into memory first, because the streaming upload needs the immediate context. Universal
+// textures are transcoded from maxSize down, on as many threads as there are cores.
+HRESULT TextureStreamer::LoadLevel(const Job& job, Result& result)
+{
+	MappedFile file;
+	if (!file.Open(job.path.c_str()))
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	if (file.GetSize() > SIZE_MAX)
+		return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+
+	const uint8_t* data = file.GetData();
+	size_t size = static_cast<size_t>(file.GetSize());
+	std::vector<uint8_t> decompressed;
+	if (IsUniversalTexture(data, size))
+	{
+		DDSTextureDesc desc;
+		if (ParseUniversalTexture(data, size, desc) != DDS_OK)
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		result.skip = GetDDSSkipMips(desc, job.maxSize);
+		result.bytes = GetDDSLoadedSize(desc, result.skip);
+		if (!TranscodeForDevice(m_device, data, size, result.skip, decompressed))
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		return CreateDDSTextureFromMemory(m_device, decompressed.data(), decompressed.size(), nullptr, result.view.GetAddressOf());
+	}
+	if (DetectCompression(data, size) != COMPRESSION_NONE)
+	{
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(data, size) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK ||
+			desc.dataSize > SIZE_MAX - desc.headerSize)
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return HRESULT_FROM_WIN32(stream.HasFailed() ? ERROR_INVALID_DATA : ERROR_HANDLE_EOF);
+		data = decompressed.data();
+		size = decompressed.size();
+	}
+
+	DDSTextureDesc desc;
+	if (ValidateDDS(data, size, desc) != DDS_OK)
+		return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+	result.skip = GetDDSSkipMips(desc, job.maxSize);
+	result.bytes = GetDDSLoadedSize(desc, result.skip);
+
+	return CreateDDSTextureFromMemory(m_device, data, size, nullptr, result.view.GetAddressOf(), job.maxSize);
+}
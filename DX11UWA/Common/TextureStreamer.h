@@ -0,0 +1,143 @@
+﻿#pragma once
+
+#include "DDSFile.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace DX
+{
+	// Largest dimension a texture first loads at, so it can be drawn straight away.
+	const size_t TEXTURE_STREAMING_INITIAL_SIZE = 64;
+
+	// A view replaced by a load that finished: whoever holds oldView should now use newView.
+	struct TextureSwap
+	{
+		uint32_t											handle;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	oldView;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	newView;
+	};
+
+	struct TextureStreamingStats
+	{
+		uint32_t	textureCount;
+		uint32_t	pendingCount;			// textures not yet at their target resolution
+		uint32_t	loadCount;				// finished background loads
+		uint32_t	failedCount;
+		double		initialSeconds;			// spent in Load, on the caller's thread
+		double		totalLatencySeconds;	// from each request to its swap
+		double		maxLatencySeconds;
+		uint64_t	streamedBytes;			// of DDS bits the background loads read
+		uint32_t	missCount;				// Loads that created a texture
+		uint32_t	pathHits;				// Loads of a path already loaded
+		uint32_t	contentHits;			// Loads of a file byte for byte the same as one already loaded
+		uint64_t	bytesSaved;				// full resolution bytes the hits did not load again
+		uint32_t	restoredCount;			// textures Start reloaded after ReleaseDevice
+		uint32_t	droppedCount;			// and those it dropped because nothing held them
+		double		GetAverageLatencySeconds(void) const	{ return loadCount ? totalLatencySeconds / loadCount : 0.0; }
+	};
+
+	// Loads DDS textures at a low resolution first and then streams them up to the resolution asked
+	// for. Each level above the first is a whole new texture, with every mip from the target down,
+	// created on a worker thread through the device; nothing touches the immediate context, so the
+	// render thread never waits on a load. Finished textures are handed out from Update as swaps.
+	// Textures are cached: loading a path again, or a file with the same bytes under another path,
+	// shares the texture already loaded, its view and its handle. Universal textures are loaded the
+	// same way, transcoded to BC at each level.
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer(void);
+		~TextureStreamer(void);
+
+		// Starts on a device. After ReleaseDevice, the textures it kept are reloaded at the initial
+		// resolution and streamed back to their target resolution, with new handles.
+		void Start(ID3D11Device* device);
+		// Waits for the load in progress and drops every texture.
+		void Stop(void);
+		// For a lost device: waits for the load in progress and releases every view, keeping the
+		// textures whose views are still held elsewhere for Start to reload and forgetting the rest.
+		// Call it before the views drawn with are released.
+		void ReleaseDevice(void);
+
+		// Loads the texture with no mip over TEXTURE_STREAMING_INITIAL_SIZE and asks for it at full
+		// resolution. A texture with too few mips to start small loads whole. The handle is for
+		// SetTargetResolution. A texture already loaded from the path or from the same bytes is
+		// shared instead; the file is read whole once to tell.
+		HRESULT Load(const wchar_t* path, ID3D11ShaderResourceView** outView, uint32_t* outHandle = nullptr);
+		// Streams the texture up or down until no mip is larger than maxSize, or to full
+		// resolution for 0. The smallest mip always stays.
+		void SetTargetResolution(uint32_t handle, size_t maxSize);
+		// Largest dimension of the texture's views now and once streaming finishes.
+		size_t GetResolution(uint32_t handle) const;
+		size_t GetTargetResolution(uint32_t handle) const;
+		// Handles run from 0 to GetTextureCount() - 1, in the order the textures were loaded.
+		uint32_t GetTextureCount(void) const;
+		DDSTextureDesc GetDesc(uint32_t handle) const;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetView(uint32_t handle) const;
+
+		// Call once a frame. Fills outSwaps with the views that finished loading since the last call.
+		void Update(std::vector<TextureSwap>& outSwaps);
+		TextureStreamingStats GetStats(void) const;
+
+	private:
+		TextureStreamer(const TextureStreamer&);
+		TextureStreamer& operator=(const TextureStreamer&);
+
+		struct Texture
+		{
+			std::wstring										path;
+			DDSTextureDesc										desc;
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	view;
+			uint32_t											loadedSkip;		// mips left out of view
+			uint32_t											targetSkip;
+			bool												queued;			// waiting for or in a load
+			bool												referenced;		// held elsewhere when the device was released
+			uint64_t											fileSize;
+			uint64_t											contentHash;
+			std::chrono::steady_clock::time_point				requested;
+		};
+
+		struct Job
+		{
+			uint32_t		handle;
+			std::wstring	path;
+			size_t			maxSize;
+		};
+
+		struct Result
+		{
+			uint32_t											handle;
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	view;
+			uint32_t											skip;
+			uint64_t											bytes;
+			HRESULT												hr;
+		};
+
+		HRESULT Share(uint32_t handle, ID3D11ShaderResourceView** outView, uint32_t* outHandle);
+		void QueueLoad(uint32_t handle);
+		void StopWorker(void);
+		void RestoreTextures(void);
+		void WorkerLoop(void);
+		HRESULT LoadLevel(const Job& job, Result& result);
+
+		ID3D11Device*					m_device;
+		mutable std::mutex				m_lock;
+		std::condition_variable			m_wake;
+		std::thread						m_worker;
+		bool							m_stopping;
+		bool							m_deviceReleased;
+		std::vector<Texture>			m_textures;
+		std::unordered_map<std::wstring, uint32_t>	m_paths;		// every path loaded, its slashes made forward
+		std::unordered_map<uint64_t, uint32_t>		m_contents;		// by content hash
+		std::deque<Job>					m_jobs;
+		std::vector<Result>				m_results;
+		TextureStreamingStats			m_stats;
+	};
+}
@@ -0,0 +1,1346 @@
+﻿#include "UniversalTexture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+	typedef std::function<void(unsigned int)> Work;
+
+	const uint32_t kProbabilityBits = 11;
+	const uint16_t kProbabilityInit = 1 << (kProbabilityBits - 1);
+	const uint32_t kAdaptShift = 5;
+	const uint32_t kRangeTop = 1u << 24;
+	const uint32_t kLengthBits = 5;
+	const uint32_t kNumberBits = 16;		// numbers coded are below 1 << (kNumberBits - 1)
+	const uint32_t kStreamCount = 4;		// colour endpoints and selectors, alpha endpoints and selectors
+	const uint32_t kSplitPasses = 6;
+
+	// Selectors hold positions along the line from the first endpoint to the second; these are
+	// the BC1 and BC3 alpha indices of each.
+	const uint32_t kColorIndices[4] = { 0, 2, 3, 1 };
+	const uint32_t kAlphaIndices[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+	const uint64_t kBC7Mode5 = 1ull << 5;
+	const uint64_t kOpaqueBC3Alpha = 0xffff;	// both endpoints 255 and every index 0
+
+	struct ColorEndpointPair
+	{
+		uint16_t	colors[2];		// 565, the first at selector position 0
+	};
+
+	struct AlphaEndpointPair
+	{
+		uint8_t		alphas[2];
+	};
+
+	struct Selector
+	{
+		uint8_t		positions[BC_BLOCK_TEXELS];
+	};
+
+	struct Codebooks
+	{
+		std::vector<ColorEndpointPair>	endpoints;
+		std::vector<Selector>			selectors;
+		std::vector<AlphaEndpointPair>	alphaEndpoints;
+		std::vector<Selector>			alphaSelectors;
+	};
+
+	// Codebook entries as pieces of the blocks of each format, ORed together to transcode.
+	struct ColorEndpointTable
+	{
+		uint32_t	bc1Colors;		// color0 | color1 << 16, color0 the larger so BC1 has four colours
+		uint32_t	bc1Flip;		// xored into the indices when the colours were swapped for that
+		uint32_t	bc1Keep;		// 0 when both colours are the same, as every index must then be 0
+		uint64_t	bc7[2][2];		// mode 5 RGB endpoint fields, as they are and swapped
+	};
+
+	struct ColorSelectorTable
+	{
+		uint32_t	bc1;
+		uint32_t	bc7Swap;		// whether the endpoints are swapped to make the anchor index 0 or 1
+		uint64_t	bc7[2];
+	};
+
+	struct AlphaEndpointTable
+	{
+		uint32_t	bc3Alphas;
+		uint32_t	bc3Variant;		// 0 as they are, 1 swapped to keep eight alphas, 2 the same
+		uint64_t	bc7[2][2];
+	};
+
+	struct AlphaSelectorTable
+	{
+		uint64_t	bc3[3];			// for each variant
+		uint32_t	bc7Swap;
+		uint64_t	bc7[2];
+	};
+
+	struct TranscodeTables
+	{
+		std::vector<ColorEndpointTable>		endpoints;
+		std::vector<ColorSelectorTable>		selectors;
+		std::vector<AlphaEndpointTable>		alphaEndpoints;
+		std::vector<AlphaSelectorTable>		alphaSelectors;
+		uint64_t							opaqueBC7[2];
+	};
+
+	// Where an image's blocks start among those of every subresource.
+	struct BlockImage
+	{
+		uint32_t	first;
+		uint32_t	blocksWide;
+		uint32_t	blocksHigh;
+	};
+
+	// LZMA's binary range coder: each bit is coded with an adaptive probability of being 0.
+	class RangeEncoder
+	{
+	public:
+		explicit RangeEncoder(std::vector<uint8_t>& out) :
+			m_out(out),
+			m_low(0),
+			m_range(0xffffffff),
+			m_cache(0),
+			m_cacheSize(1)
+		{
+		}
+
+		void EncodeBit(uint16_t& probability, uint32_t bit)
+		{
+			const uint32_t bound = (m_range >> kProbabilityBits) * probability;
+			if (bit == 0)
+			{
+				m_range = bound;
+				probability += static_cast<uint16_t>(((1u << kProbabilityBits) - probability) >> kAdaptShift);
+			}
+			else
+			{
+				m_low += bound;
+				m_range -= bound;
+				probability -= static_cast<uint16_t>(probability >> kAdaptShift);
+			}
+			if (m_range < kRangeTop)
+			{
+				m_range <<= 8;
+				ShiftLow();
+			}
+		}
+
+		void Flush(void)
+		{
+			for (int i = 0; i < 5; ++i)
+				ShiftLow();
+		}
+
+	private:
+		void ShiftLow(void)
+		{
+			if (static_cast<uint32_t>(m_low) < 0xff000000u || (m_low >> 32) != 0)
+			{
+				const uint8_t carry = static_cast<uint8_t>(m_low >> 32);
+				uint8_t pending = m_cache;
+				do
+				{
+					m_out.push_back(static_cast<uint8_t>(pending + carry));
+					pending = 0xff;
+				} while (--m_cacheSize != 0);
+				m_cache = static_cast<uint8_t>(m_low >> 24);
+			}
+			m_cacheSize++;
+			m_low = (m_low & 0x00ffffff) << 8;
+		}
+
+		std::vector<uint8_t>&	m_out;
+		uint64_t				m_low;
+		uint32_t				m_range;
+		uint8_t					m_cache;
+		uint64_t				m_cacheSize;
+	};
+
+	class RangeDecoder
+	{
+	public:
+		RangeDecoder(const uint8_t* data, size_t size) :
+			m_data(data),
+			m_end(data + size),
+			m_range(0xffffffff),
+			m_code(0),
+			m_overrun(false)
+		{
+			for (int i = 0; i < 5; ++i)
+				m_code = (m_code << 8) | NextByte();
+		}
+
+		uint32_t DecodeBit(uint16_t& probability)
+		{
+			const uint32_t bound = (m_range >> kProbabilityBits) * probability;
+			uint32_t bit;
+			if (m_code < bound)
+			{
+				m_range = bound;
+				probability += static_cast<uint16_t>(((1u << kProbabilityBits) - probability) >> kAdaptShift);
+				bit = 0;
+			}
+			else
+			{
+				m_code -= bound;
+				m_range -= bound;
+				probability -= static_cast<uint16_t>(probability >> kAdaptShift);
+				bit = 1;
+			}
+			if (m_range < kRangeTop)
+			{
+				m_range <<= 8;
+				m_code = (m_code << 8) | NextByte();
+			}
+			return bit;
+		}
+
+		// A valid stream never reads past its end.
+		bool HasOverrun(void) const	{ return m_overrun; }
+
+	private:
+		uint32_t NextByte(void)
+		{
+			if (m_data < m_end)
+				return *m_data++;
+			m_overrun = true;
+			return 0;
+		}
+
+		const uint8_t*	m_data;
+		const uint8_t*	m_end;
+		uint32_t		m_range;
+		uint32_t		m_code;
+		bool			m_overrun;
+	};
+
+	void InitProbabilities(uint16_t* probabilities, size_t count)
+	{
+		std::fill(probabilities, probabilities + count, kProbabilityInit);
+	}
+
+	// Numbers below 1 << (kNumberBits - 1): the bit length of the number plus one, then the bits
+	// under its leading one, each with its own probability.
+	struct NumberModel
+	{
+		uint16_t	length[1 << kLengthBits];
+		uint16_t	bits[kNumberBits][kNumberBits];
+
+		NumberModel(void)
+		{
+			InitProbabilities(length, sizeof(length) / sizeof(length[0]));
+			InitProbabilities(&bits[0][0], sizeof(bits) / sizeof(bits[0][0]));
+		}
+	};
+
+	// One stream of codebook indices: whether a block repeats its left or upper neighbour's index
+	// and, when it does not, how far it is from the left one's, or the upper one's in the first column.
+	struct IndexModel
+	{
+		uint16_t	sameLeft[2];	// by whether the upper neighbour has the same index as the left
+		uint16_t	sameAbove[2];	// by whether there is a left neighbour
+		NumberModel	distance;
+
+		IndexModel(void)
+		{
+			InitProbabilities(sameLeft, 2);
+			InitProbabilities(sameAbove, 2);
+		}
+	};
+
+	// Codebook entries are coded against the entry before, which is alike as clusters are
+	// numbered in tree order.
+	struct CodebookModels
+	{
+		NumberModel	endpoints[6];
+		uint16_t	selectors[16][4];		// by the position in the entry before and the one to the left
+		NumberModel	alphaEndpoints[2];
+		uint16_t	alphaSelectors[8][8];	// by the position in the entry before
+
+		CodebookModels(void)
+		{
+			InitProbabilities(&selectors[0][0], sizeof(selectors) / sizeof(selectors[0][0]));
+			InitProbabilities(&alphaSelectors[0][0], sizeof(alphaSelectors) / sizeof(alphaSelectors[0][0]));
+		}
+	};
+
+	void EncodeTree(RangeEncoder& coder, uint16_t* probabilities, uint32_t bitCount, uint32_t value)
+	{
+		uint32_t node = 1;
+		for (uint32_t i = bitCount; i-- > 0;)
+		{
+			const uint32_t bit = (value >> i) & 1;
+			coder.EncodeBit(probabilities[node], bit);
+			node = node * 2 + bit;
+		}
+	}
+
+	uint32_t DecodeTree(RangeDecoder& coder, uint16_t* probabilities, uint32_t bitCount)
+	{
+		uint32_t node = 1;
+		for (uint32_t i = 0; i < bitCount; ++i)
+			node = node * 2 + coder.DecodeBit(probabilities[node]);
+		return node - (1u << bitCount);
+	}
+
+	void EncodeNumber(RangeEncoder& coder, NumberModel& model, uint32_t number)
+	{
+		const uint32_t value = number + 1;
+		uint32_t length = 0;
+		while ((value >> (length + 1)) != 0)
+			++length;
+		EncodeTree(coder, model.length, kLengthBits, length);
+		for (uint32_t i = length; i-- > 0;)
+			coder.EncodeBit(model.bits[length][i], (value >> i) & 1);
+	}
+
+	bool DecodeNumber(RangeDecoder& coder, NumberModel& model, uint32_t& outNumber)
+	{
+		const uint32_t length = DecodeTree(coder, model.length, kLengthBits);
+		if (length >= kNumberBits)
+			return false;
+		uint32_t value = 1;
+		for (uint32_t i = length; i-- > 0;)
+			value = value * 2 + coder.DecodeBit(model.bits[length][i]);
+		outNumber = value - 1;
+		return true;
+	}
+
+	uint32_t ZigZag(int32_t value)
+	{
+		return value < 0 ? static_cast<uint32_t>(-value) * 2 - 1 : static_cast<uint32_t>(value) * 2;
+	}
+
+	int32_t UnZigZag(uint32_t value)
+	{
+		return (value & 1) ? -static_cast<int32_t>((value + 1) / 2) : static_cast<int32_t>(value / 2);
+	}
+
+	// left and above are null for neighbours outside the slice.
+	void EncodeIndex(RangeEncoder& coder, IndexModel& model, uint32_t index, const uint32_t* left, const uint32_t* above)
+	{
+		if (left)
+		{
+			const uint32_t same = index == *left ? 1 : 0;
+			coder.EncodeBit(model.sameLeft[above && *above == *left ? 1 : 0], same);
+			if (same)
+				return;
+		}
+		if (above && (!left || *above != *left))
+		{
+			const uint32_t same = index == *above ? 1 : 0;
+			coder.EncodeBit(model.sameAbove[left ? 1 : 0], same);
+			if (same)
+				return;
+		}
+		const uint32_t prediction = left ? *left : above ? *above : 0;
+		EncodeNumber(coder, model.distance, ZigZag(static_cast<int32_t>(index) - static_cast<int32_t>(prediction)));
+	}
+
+	bool DecodeIndex(RangeDecoder& coder, IndexModel& model, uint32_t count, const uint32_t* left, const uint32_t* above, uint32_t& outIndex)
+	{
+		if (left && coder.DecodeBit(model.sameLeft[above && *above == *left ? 1 : 0]))
+		{
+			outIndex = *left;
+			return true;
+		}
+		if (above && (!left || *above != *left) && coder.DecodeBit(model.sameAbove[left ? 1 : 0]))
+		{
+			outIndex = *above;
+			return true;
+		}
+
+		uint32_t distance;
+		if (!DecodeNumber(coder, model.distance, distance))
+			return false;
+		const int64_t prediction = left ? *left : above ? *above : 0;
+		const int64_t index = prediction + UnZigZag(distance);
+		if (index < 0 || index >= count)
+			return false;
+		outIndex = static_cast<uint32_t>(index);
+		return true;
+	}
+
+	// Runs work(0) to work(count - 1) at once, work(0) on the calling thread.
+	void RunParallel(unsigned int count, const Work& work)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(count > 0 ? count - 1 : 0);
+		for (unsigned int i = 1; i < count; ++i)
+			threads.push_back(std::thread([&work, i]() { work(i); }));
+		if (count > 0)
+			work(0);
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+
+	unsigned int ResolveThreadCount(unsigned int threadCount)
+	{
+		return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Calls work for 0 to count - 1, handed out to the threads a chunk at a time.
+	void ParallelFor(uint32_t count, unsigned int threadCount, const std::function<void(uint32_t)>& work)
+	{
+		const uint32_t chunk = 256;
+		std::atomic<uint32_t> next(0);
+		RunParallel(std::min(threadCount, (count + chunk - 1) / chunk), [&](unsigned int)
+		{
+			for (uint32_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+			{
+				for (uint32_t i = begin; i < std::min(count, begin + chunk); ++i)
+					work(i);
+			}
+		});
+	}
+
+	uint32_t GetBlocks(uint32_t texels)
+	{
+		return (texels + 3) / 4;
+	}
+
+	// Returns the blocks of every subresource, in D3D11CalcSubresource order.
+	uint32_t GetBlockImages(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize, std::vector<BlockImage>& outImages)
+	{
+		uint32_t blockCount = 0;
+		outImages.clear();
+		for (uint32_t slice = 0; slice < arraySize; ++slice)
+		{
+			for (uint32_t mip = 0; mip < mipCount; ++mip)
+			{
+				BlockImage image;
+				image.first = blockCount;
+				image.blocksWide = GetBlocks(std::max(1u, width >> mip));
+				image.blocksHigh = GetBlocks(std::max(1u, height >> mip));
+				outImages.push_back(image);
+				blockCount += image.blocksWide * image.blocksHigh;
+			}
+		}
+		return blockCount;
+	}
+
+	uint32_t GetCodebookSize(uint32_t blockCount, uint32_t quality)
+	{
+		const uint32_t size = static_cast<uint32_t>(static_cast<uint64_t>(blockCount) * quality / 1024);
+		return std::min(UNIVERSAL_TEXTURE_MAX_CODEBOOK, std::max(size, std::min(blockCount, 64u)));
+	}
+
+	void Unpack565(uint16_t color, int* outRgb)
+	{
+		const int r = color >> 11;
+		const int g = (color >> 5) & 63;
+		const int b = color & 31;
+		outRgb[0] = (r << 3) | (r >> 2);
+		outRgb[1] = (g << 2) | (g >> 4);
+		outRgb[2] = (b << 3) | (b >> 2);
+	}
+
+	uint16_t Pack565(const float* rgb)
+	{
+		const int r = std::min(31, std::max(0, static_cast<int>(rgb[0] * 31.0f / 255.0f + 0.5f)));
+		const int g = std::min(63, std::max(0, static_cast<int>(rgb[1] * 63.0f / 255.0f + 0.5f)));
+		const int b = std::min(31, std::max(0, static_cast<int>(rgb[2] * 31.0f / 255.0f + 0.5f)));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	// The colour at each selector position, as BCDecoder interpolates it.
+	void GetColorPalette(const ColorEndpointPair& pair, int outPalette[4][3])
+	{
+		Unpack565(pair.colors[0], outPalette[0]);
+		Unpack565(pair.colors[1], outPalette[3]);
+		for (int c = 0; c < 3; ++c)
+		{
+			outPalette[1][c] = (2 * outPalette[0][c] + outPalette[3][c] + 1) / 3;
+			outPalette[2][c] = (outPalette[0][c] + 2 * outPalette[3][c] + 1) / 3;
+		}
+	}
+
+	void GetAlphaPalette(const AlphaEndpointPair& pair, int outPalette[8])
+	{
+		for (int q = 0; q < 8; ++q)
+			outPalette[q] = ((7 - q) * pair.alphas[0] + q * pair.alphas[1] + 3) / 7;
+	}
+
+	// The nearest 7 bit BC7 endpoint to an 8 bit value.
+	uint64_t To7Bits(int value)
+	{
+		const int low = value >> 1;
+		const int high = std::min(127, low + 1);
+		const int lowError = std::abs(((low << 1) | (low >> 6)) - value);
+		const int highError = std::abs(((high << 1) | (high >> 6)) - value);
+		return static_cast<uint64_t>(highError < lowError ? high : low);
+	}
+
+	void PutBits(uint64_t* bits, uint32_t position, uint32_t width, uint64_t value)
+	{
+		const uint32_t shift = position & 63;
+		bits[position >> 6] |= value << shift;
+		if (shift != 0 && shift + width > 64)
+			bits[1] |= value >> (64 - shift);
+	}
+
+	// Weighted centroid of order[begin, end) and its weighted squared error.
+	double GetCentroid(const std::vector<float>& vectors, const std::vector<float>& weights, uint32_t dimension, const std::vector<uint32_t>& order,
+		uint32_t begin, uint32_t end, float* outCentroid)
+	{
+		std::vector<double> sums(dimension, 0.0);
+		double weightSum = 0.0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const float* vector = &vectors[static_cast<size_t>(order[i]) * dimension];
+			for (uint32_t d = 0; d < dimension; ++d)
+				sums[d] += weights[order[i]] * vector[d];
+			weightSum += weights[order[i]];
+		}
+		for (uint32_t d = 0; d < dimension; ++d)
+			outCentroid[d] = static_cast<float>(sums[d] / weightSum);
+
+		double error = 0.0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const float* vector = &vectors[static_cast<size_t>(order[i]) * dimension];
+			double distance = 0.0;
+			for (uint32_t d = 0; d < dimension; ++d)
+				distance += (vector[d] - outCentroid[d]) * (vector[d] - outCentroid[d]);
+			error += weights[order[i]] * distance;
+		}
+		return error;
+	}
+
+	float GetDistance(const float* a, const float* b, uint32_t dimension)
+	{
+		float distance = 0.0f;
+		for (uint32_t d = 0; d < dimension; ++d)
+			distance += (a[d] - b[d]) * (a[d] - b[d]);
+		return distance;
+	}
+
+	// 2-means on order[begin, end), seeded with the vector furthest from the centroid and the one
+	// furthest from that; the first cluster is moved to the front. False when it cannot be split.
+	bool SplitCluster(const std::vector<float>& vectors, const std::vector<float>& weights, uint32_t dimension, std::vector<uint32_t>& order,
+		uint32_t begin, uint32_t end, std::vector<uint8_t>& side, uint32_t& outMiddle)
+	{
+		std::vector<float> seeds(dimension * 2);
+		GetCentroid(vectors, weights, dimension, order, begin, end, seeds.data());
+		const float* seed = nullptr;
+		for (uint32_t pass = 0; pass < 2; ++pass)
+		{
+			const float* reference = pass == 0 ? seeds.data() : seed;
+			float furthest = -1.0f;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const float* vector = &vectors[static_cast<size_t>(order[i]) * dimension];
+				const float distance = GetDistance(vector, reference, dimension);
+				if (distance > furthest)
+				{
+					furthest = distance;
+					seed = vector;
+				}
+			}
+			if (pass == 1 && furthest <= 0.0f)
+				return false;
+			if (pass == 0)
+				std::copy(seed, seed + dimension, seeds.begin());
+			else
+				std::copy(seed, seed + dimension, seeds.begin() + dimension);
+		}
+
+		std::vector<double> sums(dimension * 2);
+		for (uint32_t pass = 0; pass < kSplitPasses; ++pass)
+		{
+			std::fill(sums.begin(), sums.end(), 0.0);
+			double weightSums[2] = { 0.0, 0.0 };
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const float* vector = &vectors[static_cast<size_t>(order[i]) * dimension];
+				const uint8_t s = GetDistance(vector, &seeds[dimension], dimension) < GetDistance(vector, seeds.data(), dimension) ? 1 : 0;
+				side[order[i]] = s;
+				for (uint32_t d = 0; d < dimension; ++d)
+					sums[s * dimension + d] += weights[order[i]] * vector[d];
+				weightSums[s] += weights[order[i]];
+			}
+			if (weightSums[0] <= 0.0 || weightSums[1] <= 0.0)
+				return false;
+			for (uint32_t d = 0; d < dimension * 2; ++d)
+				seeds[d] = static_cast<float>(sums[d] / weightSums[d / dimension]);
+		}
+
+		outMiddle = static_cast<uint32_t>(std::partition(order.begin() + begin, order.begin() + end, [&side](uint32_t v) { return side[v] == 0; }) -
+			order.begin());
+		return outMiddle > begin && outMiddle < end;
+	}
+
+	// Tree structured vector quantization: the cluster with the most weighted squared error is
+	// split in two until there are count clusters or none can be split. Clusters are numbered in
+	// the order of the tree's leaves, so clusters with close numbers are alike, which the codebook
+	// and index coding rely on. Returns the cluster of each vector.
+	std::vector<uint32_t> Quantize(const std::vector<float>& vectors, const std::vector<float>& weights, uint32_t dimension, uint32_t count,
+		std::vector<float>& outCentroids)
+	{
+		struct Cluster
+		{
+			uint32_t	begin;
+			uint32_t	end;
+		};
+
+		const uint32_t vectorCount = static_cast<uint32_t>(weights.size());
+		std::vector<uint32_t> order(vectorCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::vector<uint8_t> side(vectorCount);
+		std::vector<float> centroid(dimension);
+		std::vector<Cluster> clusters(1, Cluster{ 0, vectorCount });
+		std::priority_queue<std::pair<double, uint32_t>> largest;
+		largest.push(std::make_pair(GetCentroid(vectors, weights, dimension, order, 0, vectorCount, centroid.data()), 0u));
+		while (clusters.size() < count && !largest.empty() && largest.top().first > 0.0)
+		{
+			const uint32_t c = largest.top().second;
+			largest.pop();
+			uint32_t middle;
+			if (!SplitCluster(vectors, weights, dimension, order, clusters[c].begin, clusters[c].end, side, middle))
+				continue;
+
+			const Cluster upper = { middle, clusters[c].end };
+			clusters[c].end = middle;
+			clusters.push_back(upper);
+			largest.push(std::make_pair(GetCentroid(vectors, weights, dimension, order, clusters[c].begin, middle, centroid.data()), c));
+			largest.push(std::make_pair(GetCentroid(vectors, weights, dimension, order, upper.begin, upper.end, centroid.data()),
+				static_cast<uint32_t>(clusters.size() - 1)));
+		}
+
+		std::sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.begin < b.begin; });
+		std::vector<uint32_t> assignment(vectorCount);
+		outCentroids.resize(clusters.size() * dimension);
+		for (uint32_t c = 0; c < clusters.size(); ++c)
+		{
+			GetCentroid(vectors, weights, dimension, order, clusters[c].begin, clusters[c].end, &outCentroids[c * dimension]);
+			for (uint32_t i = clusters[c].begin; i < clusters[c].end; ++i)
+				assignment[order[i]] = c;
+		}
+		return assignment;
+	}
+
+	// Least squares endpoints for each pair of a codebook, over the texels of its blocks at the
+	// positions of their selectors. Pairs whose blocks all sit at one position keep theirs.
+	void RefitEndpoints(const uint8_t* texels, uint32_t blockCount, uint32_t channel, uint32_t channelCount, uint32_t lastPosition,
+		const std::vector<uint32_t>& endpointOf, const std::vector<uint32_t>& selectorOf, const std::vector<Selector>& selectors,
+		std::vector<float>& inOutEndpoints)
+	{
+		const size_t pairCount = inOutEndpoints.size() / (channelCount * 2);
+		std::vector<double> sums(pairCount * (3 + channelCount * 2), 0.0);
+		const size_t stride = 3 + channelCount * 2;
+		for (uint32_t b = 0; b < blockCount; ++b)
+		{
+			double* sum = &sums[endpointOf[b] * stride];
+			const Selector& selector = selectors[selectorOf[b]];
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				const double w = static_cast<double>(selector.positions[t]) / lastPosition;
+				sum[0] += (1.0 - w) * (1.0 - w);
+				sum[1] += (1.0 - w) * w;
+				sum[2] += w * w;
+				for (uint32_t c = 0; c < channelCount; ++c)
+				{
+					const double value = texels[(static_cast<size_t>(b) * BC_BLOCK_TEXELS + t) * 4 + channel + c];
+					sum[3 + c] += (1.0 - w) * value;
+					sum[3 + channelCount + c] += w * value;
+				}
+			}
+		}
+
+		for (size_t p = 0; p < pairCount; ++p)
+		{
+			const double* sum = &sums[p * stride];
+			const double determinant = sum[0] * sum[2] - sum[1] * sum[1];
+			if (determinant < 1e-6)
+				continue;
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				const double first = (sum[2] * sum[3 + c] - sum[1] * sum[3 + channelCount + c]) / determinant;
+				const double second = (sum[0] * sum[3 + channelCount + c] - sum[1] * sum[3 + c]) / determinant;
+				inOutEndpoints[p * channelCount * 2 + c] = static_cast<float>(std::min(255.0, std::max(0.0, first)));
+				inOutEndpoints[p * channelCount * 2 + channelCount + c] = static_cast<float>(std::min(255.0, std::max(0.0, second)));
+			}
+		}
+	}
+
+	std::vector<Selector> MakeSelectors(const std::vector<float>& centroids, uint32_t lastPosition)
+	{
+		std::vector<Selector> selectors(centroids.size() / BC_BLOCK_TEXELS);
+		for (size_t s = 0; s < selectors.size(); ++s)
+		{
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				selectors[s].positions[t] = static_cast<uint8_t>(std::min(static_cast<float>(lastPosition),
+					std::max(0.0f, centroids[s * BC_BLOCK_TEXELS + t] + 0.5f)));
+		}
+		return selectors;
+	}
+
+	// Colour endpoints start as the BC3 encoder finds them for each block on its own, and are
+	// clustered. Each block's selectors against its clustered endpoints are clustered in turn,
+	// weighted by how far apart the endpoints are, and the endpoints refit to the result.
+	void QuantizeColors(const uint8_t* texels, uint32_t blockCount, uint32_t codebookSize, unsigned int threadCount, Codebooks& books,
+		std::vector<uint32_t>& outEndpointOf, std::vector<uint32_t>& outSelectorOf)
+	{
+		std::vector<float> vectors(static_cast<size_t>(blockCount) * 6);
+		std::vector<float> weights(blockCount, 1.0f);
+		ParallelFor(blockCount, threadCount, [&](uint32_t b)
+		{
+			uint8_t block[16];
+			EncodeBCBlock(BC_FORMAT_BC3, texels + static_cast<size_t>(b) * BC_BLOCK_TEXELS * 4, block);
+			uint16_t colors[2] = { static_cast<uint16_t>(block[8] | block[9] << 8), static_cast<uint16_t>(block[10] | block[11] << 8) };
+			if (colors[0] < colors[1])
+				std::swap(colors[0], colors[1]);
+			int rgb[3];
+			for (int e = 0; e < 2; ++e)
+			{
+				Unpack565(colors[e], rgb);
+				for (int c = 0; c < 3; ++c)
+					vectors[static_cast<size_t>(b) * 6 + e * 3 + c] = static_cast<float>(rgb[c]);
+			}
+		});
+		std::vector<float> endpoints;
+		outEndpointOf = Quantize(vectors, weights, 6, codebookSize, endpoints);
+		books.endpoints.resize(endpoints.size() / 6);
+		for (size_t e = 0; e < books.endpoints.size(); ++e)
+		{
+			books.endpoints[e].colors[0] = Pack565(&endpoints[e * 6]);
+			books.endpoints[e].colors[1] = Pack565(&endpoints[e * 6 + 3]);
+		}
+
+		vectors.resize(static_cast<size_t>(blockCount) * BC_BLOCK_TEXELS);
+		ParallelFor(blockCount, threadCount, [&](uint32_t b)
+		{
+			int palette[4][3];
+			GetColorPalette(books.endpoints[outEndpointOf[b]], palette);
+			const uint8_t* texel = texels + static_cast<size_t>(b) * BC_BLOCK_TEXELS * 4;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t, texel += 4)
+			{
+				int best = 0;
+				int bestError = INT32_MAX;
+				for (int p = 0; p < 4; ++p)
+				{
+					int error = 0;
+					for (int c = 0; c < 3; ++c)
+						error += (texel[c] - palette[p][c]) * (texel[c] - palette[p][c]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				vectors[static_cast<size_t>(b) * BC_BLOCK_TEXELS + t] = static_cast<float>(best);
+			}
+			int span = 0;
+			for (int c = 0; c < 3; ++c)
+				span += (palette[0][c] - palette[3][c]) * (palette[0][c] - palette[3][c]);
+			weights[b] = 1.0f + static_cast<float>(span);
+		});
+		std::vector<float> centroids;
+		outSelectorOf = Quantize(vectors, weights, BC_BLOCK_TEXELS, codebookSize, centroids);
+		books.selectors = MakeSelectors(centroids, 3);
+
+		RefitEndpoints(texels, blockCount, 0, 3, 3, outEndpointOf, outSelectorOf, books.selectors, endpoints);
+		for (size_t e = 0; e < books.endpoints.size(); ++e)
+		{
+			books.endpoints[e].colors[0] = Pack565(&endpoints[e * 6]);
+			books.endpoints[e].colors[1] = Pack565(&endpoints[e * 6 + 3]);
+		}
+	}
+
+	// Alpha the same way, from each block's highest and lowest alpha.
+	void QuantizeAlpha(const uint8_t* texels, uint32_t blockCount, uint32_t codebookSize, unsigned int threadCount, Codebooks& books,
+		std::vector<uint32_t>& outEndpointOf, std::vector<uint32_t>& outSelectorOf)
+	{
+		std::vector<float> vectors(static_cast<size_t>(blockCount) * 2);
+		std::vector<float> weights(blockCount, 1.0f);
+		for (uint32_t b = 0; b < blockCount; ++b)
+		{
+			uint8_t high = 0;
+			uint8_t low = 255;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				high = std::max(high, texels[(static_cast<size_t>(b) * BC_BLOCK_TEXELS + t) * 4 + 3]);
+				low = std::min(low, texels[(static_cast<size_t>(b) * BC_BLOCK_TEXELS + t) * 4 + 3]);
+			}
+			vectors[b * 2] = high;
+			vectors[b * 2 + 1] = low;
+		}
+		std::vector<float> endpoints;
+		outEndpointOf = Quantize(vectors, weights, 2, codebookSize, endpoints);
+		auto makeEndpoints = [&books, &endpoints]()
+		{
+			books.alphaEndpoints.resize(endpoints.size() / 2);
+			for (size_t e = 0; e < books.alphaEndpoints.size(); ++e)
+			{
+				for (int i = 0; i < 2; ++i)
+					books.alphaEndpoints[e].alphas[i] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, endpoints[e * 2 + i] + 0.5f)));
+			}
+		};
+		makeEndpoints();
+
+		vectors.resize(static_cast<size_t>(blockCount) * BC_BLOCK_TEXELS);
+		ParallelFor(blockCount, threadCount, [&](uint32_t b)
+		{
+			int palette[8];
+			GetAlphaPalette(books.alphaEndpoints[outEndpointOf[b]], palette);
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				const int alpha = texels[(static_cast<size_t>(b) * BC_BLOCK_TEXELS + t) * 4 + 3];
+				int best = 0;
+				for (int q = 1; q < 8; ++q)
+					best = std::abs(alpha - palette[q]) < std::abs(alpha - palette[best]) ? q : best;
+				vectors[static_cast<size_t>(b) * BC_BLOCK_TEXELS + t] = static_cast<float>(best);
+			}
+			weights[b] = 1.0f + static_cast<float>((palette[0] - palette[7]) * (palette[0] - palette[7]));
+		});
+		std::vector<float> centroids;
+		outSelectorOf = Quantize(vectors, weights, BC_BLOCK_TEXELS, codebookSize, centroids);
+		books.alphaSelectors = MakeSelectors(centroids, 7);
+
+		RefitEndpoints(texels, blockCount, 3, 1, 7, outEndpointOf, outSelectorOf, books.alphaSelectors, endpoints);
+		makeEndpoints();
+	}
+
+	void EncodeCodebooks(const Codebooks& books, std::vector<uint8_t>& out)
+	{
+		std::unique_ptr<CodebookModels> models(new CodebookModels());
+		RangeEncoder coder(out);
+		int previous[6] = {};
+		for (const ColorEndpointPair& pair : books.endpoints)
+		{
+			int fields[6];
+			for (int e = 0; e < 2; ++e)
+			{
+				fields[e * 3] = pair.colors[e] >> 11;
+				fields[e * 3 + 1] = (pair.colors[e] >> 5) & 63;
+				fields[e * 3 + 2] = pair.colors[e] & 31;
+			}
+			for (int f = 0; f < 6; ++f)
+			{
+				EncodeNumber(coder, models->endpoints[f], ZigZag(fields[f] - previous[f]));
+				previous[f] = fields[f];
+			}
+		}
+
+		Selector before = {};
+		for (const Selector& selector : books.selectors)
+		{
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				EncodeTree(coder, models->selectors[before.positions[t] * 4 + (t ? selector.positions[t - 1] : 0)], 2, selector.positions[t]);
+			before = selector;
+		}
+
+		int previousAlphas[2] = {};
+		for (const AlphaEndpointPair& pair : books.alphaEndpoints)
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				EncodeNumber(coder, models->alphaEndpoints[i], ZigZag(pair.alphas[i] - previousAlphas[i]));
+				previousAlphas[i] = pair.alphas[i];
+			}
+		}
+
+		before = Selector();
+		for (const Selector& selector : books.alphaSelectors)
+		{
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				EncodeTree(coder, models->alphaSelectors[before.positions[t]], 3, selector.positions[t]);
+			before = selector;
+		}
+		coder.Flush();
+	}
+
+	bool DecodeCodebooks(const UniversalTextureHeader& header, const uint8_t* data, size_t size, Codebooks& outBooks)
+	{
+		std::unique_ptr<CodebookModels> models(new CodebookModels());
+		RangeDecoder coder(data, size);
+		const int fieldMax[3] = { 31, 63, 31 };
+		int previous[6] = {};
+		outBooks.endpoints.resize(header.endpointCount);
+		for (ColorEndpointPair& pair : outBooks.endpoints)
+		{
+			for (int f = 0; f < 6; ++f)
+			{
+				uint32_t distance;
+				if (!DecodeNumber(coder, models->endpoints[f], distance))
+					return false;
+				previous[f] += UnZigZag(distance);
+				if (previous[f] < 0 || previous[f] > fieldMax[f % 3])
+					return false;
+			}
+			for (int e = 0; e < 2; ++e)
+				pair.colors[e] = static_cast<uint16_t>((previous[e * 3] << 11) | (previous[e * 3 + 1] << 5) | previous[e * 3 + 2]);
+		}
+
+		outBooks.selectors.resize(header.selectorCount);
+		Selector before = {};
+		for (Selector& selector : outBooks.selectors)
+		{
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				selector.positions[t] = static_cast<uint8_t>(DecodeTree(coder, models->selectors[before.positions[t] * 4 + (t ? selector.positions[t - 1] : 0)], 2));
+			before = selector;
+		}
+
+		int previousAlphas[2] = {};
+		outBooks.alphaEndpoints.resize(header.alphaEndpointCount);
+		for (AlphaEndpointPair& pair : outBooks.alphaEndpoints)
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				uint32_t distance;
+				if (!DecodeNumber(coder, models->alphaEndpoints[i], distance))
+					return false;
+				previousAlphas[i] += UnZigZag(distance);
+				if (previousAlphas[i] < 0 || previousAlphas[i] > 255)
+					return false;
+				pair.alphas[i] = static_cast<uint8_t>(previousAlphas[i]);
+			}
+		}
+
+		outBooks.alphaSelectors.resize(header.alphaSelectorCount);
+		before = Selector();
+		for (Selector& selector : outBooks.alphaSelectors)
+		{
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				selector.positions[t] = static_cast<uint8_t>(DecodeTree(coder, models->alphaSelectors[before.positions[t]], 3));
+			before = selector;
+		}
+		return !coder.HasOverrun();
+	}
+
+	void BuildTranscodeTables(const Codebooks& books, TranscodeTables& outTables)
+	{
+		outTables.endpoints.resize(books.endpoints.size());
+		for (size_t e = 0; e < books.endpoints.size(); ++e)
+		{
+			const ColorEndpointPair& pair = books.endpoints[e];
+			ColorEndpointTable& table = outTables.endpoints[e];
+			const bool flip = pair.colors[0] < pair.colors[1];
+			table.bc1Colors = flip ? pair.colors[1] | static_cast<uint32_t>(pair.colors[0]) << 16 : pair.colors[0] | static_cast<uint32_t>(pair.colors[1]) << 16;
+			table.bc1Flip = flip ? 0x55555555 : 0;
+			table.bc1Keep = pair.colors[0] != pair.colors[1] ? 0xffffffff : 0;
+
+			int rgb[2][3];
+			Unpack565(pair.colors[0], rgb[0]);
+			Unpack565(pair.colors[1], rgb[1]);
+			for (int swap = 0; swap < 2; ++swap)
+			{
+				table.bc7[swap][0] = table.bc7[swap][1] = 0;
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					PutBits(table.bc7[swap], 8 + c * 14, 7, To7Bits(rgb[swap][c]));
+					PutBits(table.bc7[swap], 15 + c * 14, 7, To7Bits(rgb[1 - swap][c]));
+				}
+			}
+		}
+
+		outTables.selectors.resize(books.selectors.size());
+		for (size_t s = 0; s < books.selectors.size(); ++s)
+		{
+			const Selector& selector = books.selectors[s];
+			ColorSelectorTable& table = outTables.selectors[s];
+			table.bc1 = 0;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				table.bc1 |= kColorIndices[selector.positions[t]] << (t * 2);
+
+			// BC7 weights 2 bit indices 0, 21, 43 and 64, the thirds BC1 interpolates at
+			table.bc7Swap = selector.positions[0] >= 2 ? 1 : 0;
+			table.bc7[0] = table.bc7[1] = 0;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				const uint32_t index = table.bc7Swap ? 3 - selector.positions[t] : selector.positions[t];
+				PutBits(table.bc7, t == 0 ? 66 : 65 + t * 2, t == 0 ? 1 : 2, index);
+			}
+		}
+
+		outTables.alphaEndpoints.resize(books.alphaEndpoints.size());
+		for (size_t e = 0; e < books.alphaEndpoints.size(); ++e)
+		{
+			const AlphaEndpointPair& pair = books.alphaEndpoints[e];
+			AlphaEndpointTable& table = outTables.alphaEndpoints[e];
+			table.bc3Variant = pair.alphas[0] > pair.alphas[1] ? 0 : pair.alphas[0] < pair.alphas[1] ? 1 : 2;
+			table.bc3Alphas = table.bc3Variant == 1 ? pair.alphas[1] | pair.alphas[0] << 8 : pair.alphas[0] | pair.alphas[1] << 8;
+			for (int swap = 0; swap < 2; ++swap)
+			{
+				table.bc7[swap][0] = table.bc7[swap][1] = 0;
+				PutBits(table.bc7[swap], 50, 8, pair.alphas[swap]);
+				PutBits(table.bc7[swap], 58, 8, pair.alphas[1 - swap]);
+			}
+		}
+
+		outTables.alphaSelectors.resize(books.alphaSelectors.size());
+		for (size_t s = 0; s < books.alphaSelectors.size(); ++s)
+		{
+			const Selector& selector = books.alphaSelectors[s];
+			AlphaSelectorTable& table = outTables.alphaSelectors[s];
+			table.bc3[0] = table.bc3[1] = table.bc3[2] = 0;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+			{
+				table.bc3[0] |= static_cast<uint64_t>(kAlphaIndices[selector.positions[t]]) << (t * 3);
+				table.bc3[1] |= static_cast<uint64_t>(kAlphaIndices[7 - selector.positions[t]]) << (t * 3);
+			}
+
+			// Mode 5 has 4 alphas a block, so the 8 positions are rounded to the nearest of them
+			uint32_t indices[BC_BLOCK_TEXELS];
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				indices[t] = (selector.positions[t] * 6 + 7) / 14;
+			table.bc7Swap = indices[0] >= 2 ? 1 : 0;
+			table.bc7[0] = table.bc7[1] = 0;
+			for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				PutBits(table.bc7, t == 0 ? 97 : 96 + t * 2, t == 0 ? 1 : 2, table.bc7Swap ? 3 - indices[t] : indices[t]);
+		}
+
+		outTables.opaqueBC7[0] = outTables.opaqueBC7[1] = 0;
+		PutBits(outTables.opaqueBC7, 50, 8, 255);
+		PutBits(outTables.opaqueBC7, 58, 8, 255);
+	}
+
+	void WriteBlock(const TranscodeTables& tables, BCFormat target, const uint32_t* indices, uint8_t* out)
+	{
+		const ColorEndpointTable& endpoints = tables.endpoints[indices[0]];
+		const ColorSelectorTable& selectors = tables.selectors[indices[1]];
+		const bool hasAlpha = !tables.alphaEndpoints.empty();
+		uint64_t words[2];
+		switch (target)
+		{
+		case BC_FORMAT_BC1:
+			words[0] = endpoints.bc1Colors | static_cast<uint64_t>((selectors.bc1 & endpoints.bc1Keep) ^ endpoints.bc1Flip) << 32;
+			memcpy(out, words, 8);
+			break;
+
+		case BC_FORMAT_BC3:
+			words[0] = kOpaqueBC3Alpha;
+			if (hasAlpha)
+			{
+				const AlphaEndpointTable& alphaEndpoints = tables.alphaEndpoints[indices[2]];
+				words[0] = alphaEndpoints.bc3Alphas | tables.alphaSelectors[indices[3]].bc3[alphaEndpoints.bc3Variant] << 16;
+			}
+			words[1] = endpoints.bc1Colors | static_cast<uint64_t>((selectors.bc1 & endpoints.bc1Keep) ^ endpoints.bc1Flip) << 32;
+			memcpy(out, words, 16);
+			break;
+
+		default:
+			words[0] = kBC7Mode5 | endpoints.bc7[selectors.bc7Swap][0] | selectors.bc7[0];
+			words[1] = endpoints.bc7[selectors.bc7Swap][1] | selectors.bc7[1];
+			if (hasAlpha)
+			{
+				const AlphaSelectorTable& alphaSelectors = tables.alphaSelectors[indices[3]];
+				words[0] |= tables.alphaEndpoints[indices[2]].bc7[alphaSelectors.bc7Swap][0] | alphaSelectors.bc7[0];
+				words[1] |= tables.alphaEndpoints[indices[2]].bc7[alphaSelectors.bc7Swap][1] | alphaSelectors.bc7[1];
+			}
+			else
+			{
+				words[0] |= tables.opaqueBC7[0];
+				words[1] |= tables.opaqueBC7[1];
+			}
+			memcpy(out, words, 16);
+			break;
+		}
+	}
+
+	// Range codes the indices of rows [firstRow, firstRow + rowCount) of an image, with models of
+	// their own so the slice decodes on its own.
+	void EncodeSlice(const BlockImage& image, uint32_t firstRow, uint32_t rowCount, const std::vector<uint32_t>* streams, uint32_t streamCount,
+		std::vector<uint8_t>& out)
+	{
+		IndexModel models[kStreamCount];
+		RangeEncoder coder(out);
+		for (uint32_t row = firstRow; row < firstRow + rowCount; ++row)
+		{
+			for (uint32_t column = 0; column < image.blocksWide; ++column)
+			{
+				const uint32_t block = image.first + row * image.blocksWide + column;
+				for (uint32_t s = 0; s < streamCount; ++s)
+				{
+					const uint32_t* indices = streams[s].data();
+					EncodeIndex(coder, models[s], indices[block], column > 0 ? &indices[block - 1] : nullptr,
+						row > firstRow ? &indices[block - image.blocksWide] : nullptr);
+				}
+			}
+		}
+		coder.Flush();
+	}
+
+	// Decodes a slice into rows of blocks rowPitch bytes apart.
+	bool TranscodeSlice(const TranscodeTables& tables, BCFormat target, const uint8_t* data, size_t size, uint32_t rowCount, uint32_t blocksWide,
+		uint8_t* out, size_t rowPitch)
+	{
+		const uint32_t streamCount = tables.alphaEndpoints.empty() ? 2 : kStreamCount;
+		const uint32_t counts[kStreamCount] = { static_cast<uint32_t>(tables.endpoints.size()), static_cast<uint32_t>(tables.selectors.size()),
+			static_cast<uint32_t>(tables.alphaEndpoints.size()), static_cast<uint32_t>(tables.alphaSelectors.size()) };
+		const size_t blockBytes = GetBCBlockBytes(target);
+		IndexModel models[kStreamCount];
+		RangeDecoder coder(data, size);
+		std::vector<uint32_t> rows(2 * kStreamCount * blocksWide);
+		for (uint32_t row = 0; row < rowCount; ++row)
+		{
+			uint32_t* current = &rows[(row & 1) * kStreamCount * blocksWide];
+			const uint32_t* previous = &rows[((row + 1) & 1) * kStreamCount * blocksWide];
+			uint8_t* block = out + row * rowPitch;
+			for (uint32_t column = 0; column < blocksWide; ++column, block += blockBytes)
+			{
+				uint32_t indices[kStreamCount] = {};
+				for (uint32_t s = 0; s < streamCount; ++s)
+				{
+					uint32_t* streamRow = current + s * blocksWide;
+					if (!DecodeIndex(coder, models[s], counts[s], column > 0 ? &streamRow[column - 1] : nullptr,
+						row > 0 ? &previous[s * blocksWide + column] : nullptr, streamRow[column]))
+						return false;
+					indices[s] = streamRow[column];
+				}
+				WriteBlock(tables, target, indices, block);
+			}
+		}
+		return !coder.HasOverrun();
+	}
+}
+
+bool DX::IsUniversalTexture(const void* data, size_t size)
+{
+	uint32_t magic;
+	if (size < sizeof(UniversalTextureHeader))
+		return false;
+	memcpy(&magic, data, sizeof(magic));
+	return magic == UNIVERSAL_TEXTURE_MAGIC;
+}
+
+DDSResult DX::EncodeUniversalTexture(const DDSTextureDesc& desc, const uint8_t* bits, const UniversalTextureOptions& options, std::vector<uint8_t>& outFile)
+{
+	if (desc.dimension != DDS_DIMENSION_TEXTURE2D || (desc.format != DXGI_FORMAT_R8G8B8A8_UNORM && desc.format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB) ||
+		options.quality < 1 || options.quality > 255 || options.target > BC_FORMAT_COUNT)
+		return DDS_NOT_SUPPORTED;
+
+	std::vector<DDSSubresource> layout(desc.mipCount * desc.arraySize);
+	ComputeDDSLayout(desc, layout.data());
+	std::vector<BlockImage> images;
+	const uint32_t blockCount = GetBlockImages(desc.width, desc.height, desc.mipCount, desc.arraySize, images);
+
+	// Every block's texels, the last column and row repeated past the edges as EncodeBCImage does
+	std::vector<uint8_t> texels(static_cast<size_t>(blockCount) * BC_BLOCK_TEXELS * 4);
+	for (size_t s = 0; s < layout.size(); ++s)
+	{
+		const DDSSubresource& subresource = layout[s];
+		const BlockImage& image = images[s];
+		for (uint32_t by = 0; by < image.blocksHigh; ++by)
+		{
+			for (uint32_t bx = 0; bx < image.blocksWide; ++bx)
+			{
+				uint8_t* texel = &texels[(static_cast<size_t>(image.first) + by * image.blocksWide + bx) * BC_BLOCK_TEXELS * 4];
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					const uint8_t* row = bits + subresource.offset + static_cast<size_t>(std::min(by * 4 + y, subresource.height - 1)) * subresource.rowBytes;
+					for (uint32_t x = 0; x < 4; ++x, texel += 4)
+						memcpy(texel, row + std::min(bx * 4 + x, subresource.width - 1) * 4, 4);
+				}
+			}
+		}
+	}
+	bool hasAlpha = false;
+	for (size_t t = 3; t < texels.size() && !hasAlpha; t += 4)
+		hasAlpha = texels[t] != 255;
+
+	const unsigned int threadCount = ResolveThreadCount(options.threadCount);
+	const uint32_t codebookSize = GetCodebookSize(blockCount, options.quality);
+	Codebooks books;
+	std::vector<uint32_t> streams[kStreamCount];
+	QuantizeColors(texels.data(), blockCount, codebookSize, threadCount, books, streams[0], streams[1]);
+	if (hasAlpha)
+		QuantizeAlpha(texels.data(), blockCount, codebookSize, threadCount, books, streams[2], streams[3]);
+
+	// Each image's rows are cut into slices, which are coded at once
+	std::vector<UniversalTextureSlice> slices;
+	for (uint32_t s = 0; s < images.size(); ++s)
+	{
+		for (uint32_t row = 0; row < images[s].blocksHigh; row += UNIVERSAL_TEXTURE_SLICE_ROWS)
+		{
+			UniversalTextureSlice slice = { s, row, std::min(UNIVERSAL_TEXTURE_SLICE_ROWS, images[s].blocksHigh - row), 0, 0 };
+			slices.push_back(slice);
+		}
+	}
+	std::vector<std::vector<uint8_t>> sliceData(slices.size());
+	ParallelFor(static_cast<uint32_t>(slices.size()), threadCount, [&](uint32_t s)
+	{
+		EncodeSlice(images[slices[s].subresource], slices[s].firstRow, slices[s].rowCount, streams, hasAlpha ? kStreamCount : 2, sliceData[s]);
+	});
+	std::vector<uint8_t> codebookData;
+	EncodeCodebooks(books, codebookData);
+
+	UniversalTextureHeader header;
+	header.magic = UNIVERSAL_TEXTURE_MAGIC;
+	header.version = UNIVERSAL_TEXTURE_VERSION;
+	header.target = options.target != BC_FORMAT_COUNT ? options.target : hasAlpha ? BC_FORMAT_BC3 : BC_FORMAT_BC1;
+	header.flags = (hasAlpha ? UNIVERSAL_TEXTURE_ALPHA : 0) | (desc.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB ? UNIVERSAL_TEXTURE_SRGB : 0) |
+		(desc.isCubeMap ? UNIVERSAL_TEXTURE_CUBEMAP : 0);
+	header.width = desc.width;
+	header.height = desc.height;
+	header.mipCount = desc.mipCount;
+	header.arraySize = desc.arraySize;
+	header.endpointCount = static_cast<uint32_t>(books.endpoints.size());
+	header.selectorCount = static_cast<uint32_t>(books.selectors.size());
+	header.alphaEndpointCount = static_cast<uint32_t>(books.alphaEndpoints.size());
+	header.alphaSelectorCount = static_cast<uint32_t>(books.alphaSelectors.size());
+	header.codebookBytes = static_cast<uint32_t>(codebookData.size());
+	header.sliceCount = static_cast<uint32_t>(slices.size());
+
+	uint64_t offset = sizeof(header) + slices.size() * sizeof(UniversalTextureSlice) + codebookData.size();
+	for (size_t s = 0; s < slices.size(); ++s)
+	{
+		slices[s].offset = static_cast<uint32_t>(offset);
+		slices[s].size = static_cast<uint32_t>(sliceData[s].size());
+		offset += sliceData[s].size();
+	}
+	if (offset > UINT32_MAX)
+		return DDS_NOT_SUPPORTED;
+
+	outFile.resize(static_cast<size_t>(offset));
+	uint8_t* out = outFile.data();
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	memcpy(out, slices.data(), slices.size() * sizeof(UniversalTextureSlice));
+	out += slices.size() * sizeof(UniversalTextureSlice);
+	memcpy(out, codebookData.data(), codebookData.size());
+	out += codebookData.size();
+	for (const std::vector<uint8_t>& data : sliceData)
+	{
+		memcpy(out, data.data(), data.size());
+		out += data.size();
+	}
+	return DDS_OK;
+}
+
+DDSResult DX::ParseUniversalTexture(const void* data, size_t size, DDSTextureDesc& outDesc)
+{
+	if (!IsUniversalTexture(data, size))
+		return DDS_INVALID_HEADER;
+	UniversalTextureHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.version != UNIVERSAL_TEXTURE_VERSION)
+		return DDS_NOT_SUPPORTED;
+
+	// Within the Direct3D 11 limits, as DDS files are
+	const bool hasAlpha = (header.flags & UNIVERSAL_TEXTURE_ALPHA) != 0;
+	const bool isCubeMap = (header.flags & UNIVERSAL_TEXTURE_CUBEMAP) != 0;
+	uint32_t fullMipCount = 1;
+	while ((std::max(header.width, header.height) >> fullMipCount) != 0)
+		++fullMipCount;
+	if (header.target >= BC_FORMAT_COUNT || (header.flags & ~7u) != 0 || header.width == 0 || header.height == 0 || header.width > 16384 ||
+		header.height > 16384 || header.mipCount == 0 || header.mipCount > fullMipCount || header.arraySize == 0 || header.arraySize > 2048 ||
+		(isCubeMap && (header.arraySize % 6 != 0 || header.width != header.height)))
+		return DDS_INVALID_DATA;
+	if (header.endpointCount == 0 || header.endpointCount > UNIVERSAL_TEXTURE_MAX_CODEBOOK || header.selectorCount == 0 ||
+		header.selectorCount > UNIVERSAL_TEXTURE_MAX_CODEBOOK || (hasAlpha && (header.alphaEndpointCount == 0 || header.alphaSelectorCount == 0)) ||
+		(!hasAlpha && (header.alphaEndpointCount != 0 || header.alphaSelectorCount != 0)) || header.alphaEndpointCount > UNIVERSAL_TEXTURE_MAX_CODEBOOK ||
+		header.alphaSelectorCount > UNIVERSAL_TEXTURE_MAX_CODEBOOK)
+		return DDS_INVALID_DATA;
+
+	const uint64_t dataStart = sizeof(header) + static_cast<uint64_t>(header.sliceCount) * sizeof(UniversalTextureSlice) + header.codebookBytes;
+	if (dataStart > size)
+		return DDS_TRUNCATED;
+
+	// Every row of every image is in exactly one slice, in order
+	std::vector<BlockImage> images;
+	GetBlockImages(header.width, header.height, header.mipCount, header.arraySize, images);
+	const uint8_t* table = static_cast<const uint8_t*>(data) + sizeof(header);
+	uint32_t image = 0;
+	uint32_t row = 0;
+	for (uint32_t s = 0; s < header.sliceCount; ++s)
+	{
+		UniversalTextureSlice slice;
+		memcpy(&slice, table + s * sizeof(slice), sizeof(slice));
+		if (image == images.size() || slice.subresource != image || slice.firstRow != row || slice.rowCount == 0 ||
+			slice.rowCount > images[image].blocksHigh - row || slice.offset < dataStart || slice.offset > size || slice.size > size - slice.offset)
+			return DDS_INVALID_DATA;
+		row += slice.rowCount;
+		if (row == images[image].blocksHigh)
+		{
+			++image;
+			row = 0;
+		}
+	}
+	if (image != images.size())
+		return DDS_INVALID_DATA;
+
+	outDesc.dimension = DDS_DIMENSION_TEXTURE2D;
+	outDesc.format = GetBCDXGIFormat(static_cast<BCFormat>(header.target), (header.flags & UNIVERSAL_TEXTURE_SRGB) != 0);
+	outDesc.width = header.width;
+	outDesc.height = header.height;
+	outDesc.depth = 1;
+	outDesc.mipCount = header.mipCount;
+	outDesc.arraySize = header.arraySize;
+	outDesc.isCubeMap = isCubeMap;
+	uint8_t ddsHeader[DDS_MAX_HEADER_SIZE];
+	outDesc.headerSize = WriteDDSHeader(outDesc, ddsHeader);
+	outDesc.dataSize = ComputeDDSLayout(outDesc, nullptr);
+	return DDS_OK;
+}
+
+unsigned int DX::TranscodeUniversalTexture(const void* data, size_t size, BCFormat target, uint32_t skipMip, std::vector<uint8_t>& outDDS,
+	unsigned int threadCount)
+{
+	DDSTextureDesc desc;
+	if (ParseUniversalTexture(data, size, desc) != DDS_OK || skipMip >= desc.mipCount || target > BC_FORMAT_COUNT)
+		return 0;
+
+	const uint8_t* file = static_cast<const uint8_t*>(data);
+	UniversalTextureHeader header;
+	memcpy(&header, file, sizeof(header));
+	std::vector<UniversalTextureSlice> slices(header.sliceCount);
+	memcpy(slices.data(), file + sizeof(header), slices.size() * sizeof(UniversalTextureSlice));
+	Codebooks books;
+	if (!DecodeCodebooks(header, file + sizeof(header) + slices.size() * sizeof(UniversalTextureSlice), header.codebookBytes, books))
+		return 0;
+	TranscodeTables tables;
+	BuildTranscodeTables(books, tables);
+
+	if (target == BC_FORMAT_COUNT)
+		target = static_cast<BCFormat>(header.target);
+	DDSTextureDesc outDesc = desc;
+	outDesc.format = GetBCDXGIFormat(target, (header.flags & UNIVERSAL_TEXTURE_SRGB) != 0);
+	outDesc.width = std::max(1u, desc.width >> skipMip);
+	outDesc.height = std::max(1u, desc.height >> skipMip);
+	outDesc.mipCount = desc.mipCount - skipMip;
+	std::vector<DDSSubresource> layout(outDesc.mipCount * outDesc.arraySize);
+	outDesc.dataSize = ComputeDDSLayout(outDesc, layout.data());
+	uint8_t ddsHeader[DDS_MAX_HEADER_SIZE];
+	outDesc.headerSize = WriteDDSHeader(outDesc, ddsHeader);
+	outDDS.resize(outDesc.headerSize + static_cast<size_t>(outDesc.dataSize));
+	memcpy(outDDS.data(), ddsHeader, outDesc.headerSize);
+
+	// Only the slices of the mips kept are decoded
+	std::vector<uint32_t> kept;
+	for (uint32_t s = 0; s < slices.size(); ++s)
+	{
+		if (slices[s].subresource % header.mipCount >= skipMip)
+			kept.push_back(s);
+	}
+
+	const unsigned int workerCount = std::min(ResolveThreadCount(threadCount), static_cast<unsigned int>(kept.size()));
+	std::atomic<uint32_t> next(0);
+	std::atomic<bool> failed(false);
+	uint8_t* bits = outDDS.data() + outDesc.headerSize;
+	RunParallel(workerCount, [&](unsigned int)
+	{
+		for (uint32_t i = next++; i < kept.size(); i = next++)
+		{
+			const UniversalTextureSlice& slice = slices[kept[i]];
+			const uint32_t mip = slice.subresource % header.mipCount;
+			const DDSSubresource& subresource = layout[slice.subresource / header.mipCount * outDesc.mipCount + mip - skipMip];
+			if (!TranscodeSlice(tables, target, file + slice.offset, slice.size, slice.rowCount, GetBlocks(subresource.width),
+				bits + subresource.offset + static_cast<size_t>(slice.firstRow) * subresource.rowBytes, subresource.rowBytes))
+				failed = true;
+		}
+	});
+	return failed ? 0 : workerCount;
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include "BCEncoder.h"
+#include "DDSFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+	// Supercompressed texture container, version 1. In the spirit of ETC1S, each 4x4 block is
+	// reduced to an index into a codebook of BC1 endpoint pairs and one into a codebook of texel
+	// selectors, with a second pair of codebooks for alpha, and the indices are range coded against
+	// their neighbours'. Transcoding to BC1, BC3 or BC7 is then a table lookup a block, done in
+	// slices of block rows that decode independently of each other. The header is followed by the
+	// slice table, the range coded codebooks and the slices. Every field is little-endian.
+	const uint32_t UNIVERSAL_TEXTURE_MAGIC = 0x58455455;	// "UTEX"
+	const uint32_t UNIVERSAL_TEXTURE_VERSION = 1;
+	const uint32_t UNIVERSAL_TEXTURE_SLICE_ROWS = 16;		// most rows of blocks in a slice
+	const uint32_t UNIVERSAL_TEXTURE_MAX_CODEBOOK = 16384;
+	const uint32_t UNIVERSAL_TEXTURE_DEFAULT_QUALITY = 128;
+
+	enum UniversalTextureFlags
+	{
+		UNIVERSAL_TEXTURE_ALPHA = 1,	// has the alpha codebooks and indices
+		UNIVERSAL_TEXTURE_SRGB = 2,
+		UNIVERSAL_TEXTURE_CUBEMAP = 4,
+	};
+
+	struct UniversalTextureHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	target;				// BCFormat transcoded to unless asked for another
+		uint32_t	flags;				// UniversalTextureFlags
+		uint32_t	width;
+		uint32_t	height;
+		uint32_t	mipCount;
+		uint32_t	arraySize;
+		uint32_t	endpointCount;
+		uint32_t	selectorCount;
+		uint32_t	alphaEndpointCount;	// 0 without UNIVERSAL_TEXTURE_ALPHA
+		uint32_t	alphaSelectorCount;
+		uint32_t	codebookBytes;
+		uint32_t	sliceCount;
+	};
+
+	// Rows of blocks of one subresource, in D3D11CalcSubresource order, and where their indices
+	// are in the file. Each subresource's slices follow each other down its rows.
+	struct UniversalTextureSlice
+	{
+		uint32_t	subresource;
+		uint32_t	firstRow;
+		uint32_t	rowCount;
+		uint32_t	offset;		// from the start of the file
+		uint32_t	size;
+	};
+
+	struct UniversalTextureOptions
+	{
+		BCFormat		target;			// BC_FORMAT_COUNT for BC3 with alpha and BC1 without
+		uint32_t		quality;		// 1 to 255: each codebook gets quality / 1024 of the blocks, up to the maximum
+		unsigned int	threadCount;	// 0 for one a core
+	};
+
+	bool IsUniversalTexture(const void* data, size_t size);
+
+	// Encodes a 2D texture in R8G8B8A8_UNORM or _SRGB, its bits laid out as ComputeDDSLayout gives,
+	// into a container. Alpha is left out when every texel is opaque. DDS_NOT_SUPPORTED for other
+	// formats and for bad options.
+	DDSResult EncodeUniversalTexture(const DDSTextureDesc& desc, const uint8_t* bits, const UniversalTextureOptions& options, std::vector<uint8_t>& outFile);
+
+	// Validates the header and slice table of a container and describes the DDS texture
+	// transcoding it to its own target gives.
+	DDSResult ParseUniversalTexture(const void* data, size_t size, DDSTextureDesc& outDesc);
+
+	// Transcodes the mips from skipMip on into a whole DDS file, headers and all, ready for
+	// CreateDDSTextureFromMemory; target BC_FORMAT_COUNT is the one the file was encoded for. BC1
+	// leaves alpha out, and BC7 blocks are all mode 5, which keeps the colour endpoints at 7 bits
+	// but gives alpha 4 shades a block instead of 8. Slices are shared between threadCount threads,
+	// or one a core for 0; returns the number of threads used, or 0 when the file is corrupt.
+	unsigned int TranscodeUniversalTexture(const void* data, size_t size, BCFormat target, uint32_t skipMip, std::vector<uint8_t>& outDDS,
+		unsigned int threadCount = 0);
+}
@@ -0,0 +1,1040 @@
+﻿#include "GlbLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const uint32_t kMaxJsonDepth = 64;
+
+	const uint32_t kByte = 5120;
+	const uint32_t kUnsignedByte = 5121;
+	const uint32_t kShort = 5122;
+	const uint32_t kUnsignedShort = 5123;
+	const uint32_t kUnsignedInt = 5125;
+	const uint32_t kFloat = 5126;
+	const uint32_t kTriangles = 4;
+
+	// DXGI_FORMAT values the attributes are fetched as.
+	const uint16_t kR32G32B32Float = 6;
+	const uint16_t kR16G16B16A16Unorm = 11;
+	const uint16_t kR16G16B16A16Snorm = 13;
+	const uint16_t kR32G32Float = 16;
+	const uint16_t kR8G8B8A8Unorm = 28;
+	const uint16_t kR8G8B8A8Snorm = 31;
+	const uint16_t kR16G16Unorm = 35;
+	const uint16_t kR16G16Snorm = 37;
+	const uint16_t kR8G8Unorm = 49;
+	const uint16_t kR8G8Snorm = 51;
+
+	// What a primitive without uvs or normals reads for every vertex.
+	const float kDefaultUv[2] = { 0.0f, 0.0f };
+	const float kDefaultNormal[3] = { 0.0f, 1.0f, 0.0f };
+
+	// Indexed by MeshSemantic.
+	const char* const kAttributeNames[MESH_VERTEX_ATTRIBUTE_COUNT] = { "POSITION", "TEXCOORD_0", "NORMAL" };
+
+	const char* const kSupportedExtensions[] = { "KHR_mesh_quantization", "MSFT_texture_dds" };
+
+	struct JsonValue
+	{
+		enum Type
+		{
+			JSON_NULL,
+			JSON_BOOL,
+			JSON_NUMBER,
+			JSON_STRING,
+			JSON_ARRAY,
+			JSON_OBJECT,
+		};
+
+		Type						type;
+		double						number;		// also 0 or 1 for a bool
+		std::string					string;
+		std::vector<JsonValue>		items;		// array elements, or object values
+		std::vector<std::string>	keys;		// object keys, one per item
+
+		JsonValue(void) : type(JSON_NULL), number(0.0) {}
+
+		const JsonValue* Find(const char* key) const
+		{
+			if (type != JSON_OBJECT)
+				return nullptr;
+			for (size_t i = 0; i < keys.size(); ++i)
+			{
+				if (keys[i] == key)
+					return &items[i];
+			}
+			return nullptr;
+		}
+
+		const JsonValue* At(uint32_t index) const
+		{
+			return type == JSON_ARRAY && index < items.size() ? &items[index] : nullptr;
+		}
+
+		uint32_t GetSize(void) const
+		{
+			return type == JSON_ARRAY ? static_cast<uint32_t>(items.size()) : 0;
+		}
+	};
+
+	// Strict RFC 8259 reader for the JSON chunk, which is not null terminated.
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t length) : m_p(text), m_end(text + length) {}
+
+		bool Parse(JsonValue& out)
+		{
+			if (!ParseValue(out, 0))
+				return false;
+			SkipSpace();
+			return m_p == m_end;
+		}
+
+	private:
+		void SkipSpace(void)
+		{
+			while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+				++m_p;
+		}
+
+		bool Literal(const char* word)
+		{
+			size_t length = strlen(word);
+			if (static_cast<size_t>(m_end - m_p) < length || memcmp(m_p, word, length) != 0)
+				return false;
+			m_p += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& out, uint32_t depth)
+		{
+			SkipSpace();
+			if (m_p == m_end || depth > kMaxJsonDepth)
+				return false;
+			switch (*m_p)
+			{
+			case '{':
+				return ParseObject(out, depth);
+			case '[':
+				return ParseArray(out, depth);
+			case '"':
+				out.type = JsonValue::JSON_STRING;
+				return ParseString(out.string);
+			case 't':
+				out.type = JsonValue::JSON_BOOL;
+				out.number = 1.0;
+				return Literal("true");
+			case 'f':
+				out.type = JsonValue::JSON_BOOL;
+				return Literal("false");
+			case 'n':
+				return Literal("null");
+			default:
+				out.type = JsonValue::JSON_NUMBER;
+				return ParseNumber(out.number);
+			}
+		}
+
+		bool ParseObject(JsonValue& out, uint32_t depth)
+		{
+			out.type = JsonValue::JSON_OBJECT;
+			++m_p;
+			SkipSpace();
+			if (m_p < m_end && *m_p == '}')
+			{
+				++m_p;
+				return true;
+			}
+			for (;;)
+			{
+				SkipSpace();
+				out.keys.push_back(std::string());
+				if (m_p == m_end || *m_p != '"' || !ParseString(out.keys.back()))
+					return false;
+				SkipSpace();
+				if (m_p == m_end || *m_p++ != ':')
+					return false;
+				out.items.push_back(JsonValue());
+				if (!ParseValue(out.items.back(), depth + 1))
+					return false;
+				SkipSpace();
+				if (m_p == m_end)
+					return false;
+				char c = *m_p++;
+				if (c == '}')
+					return true;
+				if (c != ',')
+					return false;
+			}
+		}
+
+		bool ParseArray(JsonValue& out, uint32_t depth)
+		{
+			out.type = JsonValue::JSON_ARRAY;
+			++m_p;
+			SkipSpace();
+			if (m_p < m_end && *m_p == ']')
+			{
+				++m_p;
+				return true;
+			}
+			for (;;)
+			{
+				out.items.push_back(JsonValue());
+				if (!ParseValue(out.items.back(), depth + 1))
+					return false;
+				SkipSpace();
+				if (m_p == m_end)
+					return false;
+				char c = *m_p++;
+				if (c == ']')
+					return true;
+				if (c != ',')
+					return false;
+			}
+		}
+
+		bool ParseHex4(uint32_t& out)
+		{
+			if (m_end - m_p < 4)
+				return false;
+			out = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				char c = *m_p++;
+				uint32_t digit;
+				if (c >= '0' && c <= '9')
+					digit = c - '0';
+				else if (c >= 'a' && c <= 'f')
+					digit = c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F')
+					digit = c - 'A' + 10;
+				else
+					return false;
+				out = out * 16 + digit;
+			}
+			return true;
+		}
+
+		static void AppendUtf8(std::string& out, uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				out += static_cast<char>(code);
+			}
+			else if (code < 0x800)
+			{
+				out += static_cast<char>(0xC0 | (code >> 6));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				out += static_cast<char>(0xE0 | (code >> 12));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				out += static_cast<char>(0xF0 | (code >> 18));
+				out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool ParseString(std::string& out)
+		{
+			++m_p;
+			while (m_p < m_end)
+			{
+				char c = *m_p++;
+				if (c == '"')
+					return true;
+				if (static_cast<unsigned char>(c) < 0x20)
+					return false;
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+				if (m_p == m_end)
+					return false;
+				switch (*m_p++)
+				{
+				case '"':	out += '"'; break;
+				case '\\':	out += '\\'; break;
+				case '/':	out += '/'; break;
+				case 'b':	out += '\b'; break;
+				case 'f':	out += '\f'; break;
+				case 'n':	out += '\n'; break;
+				case 'r':	out += '\r'; break;
+				case 't':	out += '\t'; break;
+				case 'u':
+				{
+					uint32_t code;
+					if (!ParseHex4(code) || (code >= 0xDC00 && code < 0xE000))
+						return false;
+					if (code >= 0xD800 && code < 0xDC00)
+					{
+						uint32_t low;
+						if (m_end - m_p < 2 || m_p[0] != '\\' || m_p[1] != 'u')
+							return false;
+						m_p += 2;
+						if (!ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+							return false;
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(out, code);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return false;
+		}
+
+		bool ParseNumber(double& out)
+		{
+			char buffer[64];
+			size_t length = 0;
+			while (m_p < m_end && length < sizeof(buffer) - 1 && ((*m_p >= '0' && *m_p <= '9') || *m_p == '-' || *m_p == '+' || *m_p == '.' || *m_p == 'e' || *m_p == 'E'))
+				buffer[length++] = *m_p++;
+			buffer[length] = '\0';
+			char* end;
+			out = strtod(buffer, &end);
+			return length > 0 && end == buffer + length && std::isfinite(out);
+		}
+
+		const char*	m_p;
+		const char*	m_end;
+	};
+
+	bool ToUint(const JsonValue& value, uint32_t& out)
+	{
+		if (value.type != JsonValue::JSON_NUMBER || value.number < 0.0 || value.number > 4294967295.0 || value.number != floor(value.number))
+			return false;
+		out = static_cast<uint32_t>(value.number);
+		return true;
+	}
+
+	// Reads a non-negative integer property. A missing one gives fallback, and fails when required.
+	bool GetUint(const JsonValue& object, const char* key, uint32_t& out, bool required, uint32_t fallback = 0)
+	{
+		const JsonValue* value = object.Find(key);
+		if (!value)
+		{
+			out = fallback;
+			return !required;
+		}
+		return ToUint(*value, out);
+	}
+
+	bool GetFloats(const JsonValue& object, const char* key, float* out, uint32_t count)
+	{
+		const JsonValue* value = object.Find(key);
+		if (!value)
+			return true;
+		if (value->GetSize() != count)
+			return false;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (value->items[i].type != JsonValue::JSON_NUMBER)
+				return false;
+			out[i] = static_cast<float>(value->items[i].number);
+		}
+		return true;
+	}
+
+	void CopyName(char* destination, size_t capacity, const std::string& source)
+	{
+		size_t length = source.size() < capacity - 1 ? source.size() : capacity - 1;
+		memcpy(destination, source.c_str(), length);
+		destination[length] = '\0';
+	}
+
+	// out = a * b for row-major matrices.
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		float result[16];
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				result[row * 4 + column] = a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+					a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+			}
+		}
+		memcpy(out, result, sizeof(result));
+	}
+
+	// A node's local transform for row vectors. glTF stores column-major matrices for column
+	// vectors, which read in order is already the row-major matrix for row vectors.
+	bool GetNodeTransform(const JsonValue& node, float out[16])
+	{
+		static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		memcpy(out, identity, sizeof(identity));
+		if (node.Find("matrix"))
+			return GetFloats(node, "matrix", out, 16);
+
+		float t[3] = { 0.0f, 0.0f, 0.0f };
+		float r[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		float s[3] = { 1.0f, 1.0f, 1.0f };
+		if (!GetFloats(node, "translation", t, 3) || !GetFloats(node, "rotation", r, 4) || !GetFloats(node, "scale", s, 3))
+			return false;
+
+		// Scale, then rotate, then translate.
+		float x = r[0], y = r[1], z = r[2], w = r[3];
+		float rotation[9] =
+		{
+			1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w),
+			2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w),
+			2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y),
+		};
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+				out[row * 4 + column] = rotation[row * 3 + column] * s[row];
+			out[12 + row] = t[row];
+		}
+		return true;
+	}
+
+	// The binary chunk and the JSON arrays that point into it.
+	struct GlbContext
+	{
+		const JsonValue*	accessors;
+		const JsonValue*	bufferViews;
+		const uint8_t*		bin;
+		uint64_t			binSize;
+	};
+
+	struct BufferView
+	{
+		const uint8_t*	data;
+		uint64_t		length;
+		uint32_t		stride;		// 0 when the view does not declare one
+	};
+
+	bool ResolveBufferView(const GlbContext& context, uint32_t index, BufferView& out)
+	{
+		const JsonValue* view = context.bufferViews ? context.bufferViews->At(index) : nullptr;
+		uint32_t buffer, offset, length;
+		if (!view || !GetUint(*view, "buffer", buffer, true) || !GetUint(*view, "byteOffset", offset, false) ||
+			!GetUint(*view, "byteLength", length, true) || !GetUint(*view, "byteStride", out.stride, false))
+			return false;
+		// Only the GLB's own binary chunk is read; external buffers are not supported.
+		if (buffer != 0 || !context.bin || static_cast<uint64_t>(offset) + length > context.binSize)
+			return false;
+		if (out.stride != 0 && (out.stride < 4 || out.stride > 252 || out.stride % 4 != 0))
+			return false;
+		out.data = context.bin + offset;
+		out.length = length;
+		return true;
+	}
+
+	struct Accessor
+	{
+		BufferView			view;
+		uint32_t			viewIndex;
+		uint32_t			offset;			// of the first element within the view
+		uint32_t			stride;
+		uint32_t			count;
+		uint32_t			componentType;
+		uint32_t			componentSize;
+		uint32_t			components;
+		bool				normalized;
+		const JsonValue*	min;
+		const JsonValue*	max;
+	};
+
+	bool ResolveAccessor(const GlbContext& context, uint32_t index, Accessor& out)
+	{
+		const JsonValue* accessor = context.accessors ? context.accessors->At(index) : nullptr;
+		if (!accessor || accessor->Find("sparse"))
+			return false;
+		if (!GetUint(*accessor, "bufferView", out.viewIndex, true) || !GetUint(*accessor, "byteOffset", out.offset, false) ||
+			!GetUint(*accessor, "count", out.count, true) || !GetUint(*accessor, "componentType", out.componentType, true) ||
+			out.count == 0 || !ResolveBufferView(context, out.viewIndex, out.view))
+			return false;
+
+		switch (out.componentType)
+		{
+		case kByte:
+		case kUnsignedByte:		out.componentSize = 1; break;
+		case kShort:
+		case kUnsignedShort:	out.componentSize = 2; break;
+		case kUnsignedInt:
+		case kFloat:			out.componentSize = 4; break;
+		default:				return false;
+		}
+
+		const JsonValue* type = accessor->Find("type");
+		if (!type || type->type != JsonValue::JSON_STRING)
+			return false;
+		if (type->string == "SCALAR")
+			out.components = 1;
+		else if (type->string == "VEC2")
+			out.components = 2;
+		else if (type->string == "VEC3")
+			out.components = 3;
+		else if (type->string == "VEC4")
+			out.components = 4;
+		else
+			return false;
+
+		const JsonValue* normalized = accessor->Find("normalized");
+		out.normalized = normalized && normalized->type == JsonValue::JSON_BOOL && normalized->number != 0.0;
+		out.min = accessor->Find("min");
+		out.max = accessor->Find("max");
+
+		uint32_t elementSize = out.components * out.componentSize;
+		out.stride = out.view.stride ? out.view.stride : elementSize;
+		uintptr_t address = reinterpret_cast<uintptr_t>(out.view.data) + out.offset;
+		return out.stride >= elementSize && address % out.componentSize == 0 &&
+			out.offset + static_cast<uint64_t>(out.count - 1) * out.stride + elementSize <= out.view.length;
+	}
+
+	// How the input assembler fetches an attribute accessor: the DXGI format, how many bytes it
+	// reads and what the fetched value is multiplied by to give the stored one. Integer positions
+	// and uvs that are not normalized are fetched as UNORM and scaled back. Fails for what
+	// LightingVertexShader cannot take.
+	bool GetFetchFormat(const Accessor& accessor, MeshSemantic semantic, uint16_t& outFormat, uint32_t& outBytes, float& outScale)
+	{
+		uint32_t wanted = semantic == MESH_SEMANTIC_UV ? 2 : 3;
+		if (accessor.components != wanted)
+			return false;
+
+		outScale = 1.0f;
+		bool wide = wanted > 2;
+		switch (accessor.componentType)
+		{
+		case kFloat:
+			outFormat = wide ? kR32G32B32Float : kR32G32Float;
+			outBytes = wanted * 4;
+			return true;
+		case kUnsignedShort:
+		case kUnsignedByte:
+			// Unsigned normals are not valid glTF.
+			if (semantic == MESH_SEMANTIC_NORMAL)
+				return false;
+			if (accessor.componentType == kUnsignedShort)
+				outFormat = wide ? kR16G16B16A16Unorm : kR16G16Unorm;
+			else
+				outFormat = wide ? kR8G8B8A8Unorm : kR8G8Unorm;
+			outBytes = (wide ? 4 : 2) * accessor.componentSize;
+			outScale = accessor.normalized ? 1.0f : (accessor.componentType == kUnsignedShort ? 65535.0f : 255.0f);
+			return true;
+		case kShort:
+		case kByte:
+			// SNORM fetches the most negative value as -1, so only normalized data reads back exactly.
+			if (!accessor.normalized)
+				return false;
+			if (accessor.componentType == kShort)
+				outFormat = wide ? kR16G16B16A16Snorm : kR16G16Snorm;
+			else
+				outFormat = wide ? kR8G8B8A8Snorm : kR8G8Snorm;
+			outBytes = (wide ? 4 : 2) * accessor.componentSize;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// POSITION must carry its bounds. Exporters disagree on whether normalized accessors give them
+	// stored or normalized, so values beyond 1 are taken as stored.
+	bool GetPositionBounds(const Accessor& accessor, MeshBounds& out)
+	{
+		if (!accessor.min || !accessor.max || accessor.min->GetSize() != 3 || accessor.max->GetSize() != 3)
+			return false;
+
+		float values[6];
+		bool stored = false;
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			const JsonValue& value = (i < 3 ? accessor.min : accessor.max)->items[i % 3];
+			if (value.type != JsonValue::JSON_NUMBER)
+				return false;
+			values[i] = static_cast<float>(value.number);
+			stored = stored || fabsf(values[i]) > 1.0f;
+		}
+		if (accessor.normalized && stored)
+		{
+			float range = accessor.componentType == kUnsignedShort ? 65535.0f : accessor.componentType == kShort ? 32767.0f :
+				accessor.componentType == kUnsignedByte ? 255.0f : 127.0f;
+			for (uint32_t i = 0; i < 6; ++i)
+				values[i] /= range;
+		}
+		out.min.x = values[0];
+		out.min.y = values[1];
+		out.min.z = values[2];
+		out.max.x = values[3];
+		out.max.y = values[4];
+		out.max.z = values[5];
+		return true;
+	}
+
+	// The image a material's base color texture samples, preferring its MSFT_texture_dds source.
+	uint32_t GetBaseColorImage(const JsonValue& root, uint32_t material, uint32_t imageCount)
+	{
+		const JsonValue* materials = root.Find("materials");
+		const JsonValue* textures = root.Find("textures");
+		const JsonValue* entry = materials ? materials->At(material) : nullptr;
+		const JsonValue* pbr = entry ? entry->Find("pbrMetallicRoughness") : nullptr;
+		const JsonValue* baseColor = pbr ? pbr->Find("baseColorTexture") : nullptr;
+		uint32_t textureIndex, image;
+		if (!baseColor || !textures || !GetUint(*baseColor, "index", textureIndex, true) || !textures->At(textureIndex))
+			return GLB_NONE;
+
+		const JsonValue& texture = *textures->At(textureIndex);
+		const JsonValue* extensions = texture.Find("extensions");
+		const JsonValue* dds = extensions ? extensions->Find("MSFT_texture_dds") : nullptr;
+		if (!(dds && GetUint(*dds, "source", image, true)) && !GetUint(texture, "source", image, true))
+			return GLB_NONE;
+		return image < imageCount ? image : GLB_NONE;
+	}
+
+	// One stream per buffer view; attributes interleaved in a strided view share its stream.
+	struct StreamBuilder
+	{
+		uint32_t		viewIndex;
+		BufferView		view;
+		uint32_t		begin;		// of the first byte any of its attributes fetches, within the view
+		uint32_t		end;
+	};
+
+	// Fills a primitive from its JSON. Fails when the primitive cannot be drawn from the file as it
+	// is; primitives that are not triangle lists are skipped instead.
+	bool BuildPrimitive(const GlbContext& context, const JsonValue& root, const JsonValue& primitive, uint32_t imageCount, GlbPrimitive& out,
+		std::vector<std::vector<uint8_t>>& ownedIndices, bool& outSkipped, uint64_t& copiedBytes)
+	{
+		uint32_t mode;
+		const JsonValue* attributes = primitive.Find("attributes");
+		if (!GetUint(primitive, "mode", mode, false, kTriangles) || !attributes)
+			return false;
+		outSkipped = mode != kTriangles;
+		if (outSkipped)
+			return true;
+
+		Accessor accessors[MESH_VERTEX_ATTRIBUTE_COUNT];
+		bool present[MESH_VERTEX_ATTRIBUTE_COUNT];
+		float scales[MESH_VERTEX_ATTRIBUTE_COUNT];
+		uint32_t fetchBytes[MESH_VERTEX_ATTRIBUTE_COUNT];
+		StreamBuilder streams[MESH_VERTEX_ATTRIBUTE_COUNT];
+		out.streamCount = 0;
+		for (uint32_t s = 0; s < MESH_VERTEX_ATTRIBUTE_COUNT; ++s)
+		{
+			MeshSemantic semantic = static_cast<MeshSemantic>(s);
+			uint32_t index;
+			present[s] = attributes->Find(kAttributeNames[s]) != nullptr;
+			scales[s] = 1.0f;
+			if (!present[s])
+			{
+				if (semantic == MESH_SEMANTIC_POSITION)
+					return false;
+				continue;
+			}
+
+			Accessor& accessor = accessors[s];
+			if (!GetUint(*attributes, kAttributeNames[s], index, true) || !ResolveAccessor(context, index, accessor) ||
+				!GetFetchFormat(accessor, semantic, out.attributes[s].format, fetchBytes[s], scales[s]))
+				return false;
+			if (semantic == MESH_SEMANTIC_POSITION)
+				out.vertexCount = accessor.count;
+			else if (accessor.count != out.vertexCount)
+				return false;
+
+			// Join the stream of an attribute interleaved in the same view, if there is one.
+			uint32_t begin = accessor.offset;
+			uint32_t end = accessor.offset + fetchBytes[s];
+			uint32_t stream = 0;
+			for (; stream < out.streamCount; ++stream)
+			{
+				StreamBuilder& candidate = streams[stream];
+				uint32_t joinedBegin = begin < candidate.begin ? begin : candidate.begin;
+				uint32_t joinedEnd = end > candidate.end ? end : candidate.end;
+				if (candidate.viewIndex == accessor.viewIndex && accessor.view.stride != 0 && joinedEnd - joinedBegin <= accessor.view.stride)
+				{
+					candidate.begin = joinedBegin;
+					candidate.end = joinedEnd;
+					break;
+				}
+			}
+			if (stream == out.streamCount)
+			{
+				StreamBuilder fresh = { accessor.viewIndex, accessor.view, begin, end };
+				streams[out.streamCount++] = fresh;
+			}
+			out.attributes[s].semantic = static_cast<uint16_t>(s);
+			out.attributes[s].stream = stream;
+		}
+
+		// The streams cover every byte the input assembler will fetch, so that they can be uploaded as they are.
+		for (uint32_t stream = 0; stream < out.streamCount; ++stream)
+		{
+			const StreamBuilder& builder = streams[stream];
+			uint32_t stride = 0;
+			for (uint32_t s = 0; s < MESH_VERTEX_ATTRIBUTE_COUNT; ++s)
+			{
+				if (present[s] && out.attributes[s].stream == stream)
+					stride = accessors[s].stride;
+			}
+			uint64_t size = static_cast<uint64_t>(out.vertexCount - 1) * stride + (builder.end - builder.begin);
+			if (builder.begin + size > builder.view.length || size > 0xFFFFFFFFull)
+				return false;
+			out.streams[stream].data = builder.view.data + builder.begin;
+			out.streams[stream].size = static_cast<uint32_t>(size);
+			out.streams[stream].stride = stride;
+		}
+		for (uint32_t s = 0; s < MESH_VERTEX_ATTRIBUTE_COUNT; ++s)
+		{
+			if (present[s])
+			{
+				out.attributes[s].offset = accessors[s].offset - streams[out.attributes[s].stream].begin;
+				if (out.attributes[s].offset % 4 != 0)
+					return false;
+				continue;
+			}
+
+			// A constant stream with a stride of 0 gives every vertex the default.
+			bool uv = s == MESH_SEMANTIC_UV;
+			GlbVertexStream constant = { reinterpret_cast<const uint8_t*>(uv ? kDefaultUv : kDefaultNormal), uv ? 8u : 12u, 0 };
+			GlbVertexAttribute attribute = { static_cast<uint16_t>(s), uv ? kR32G32Float : kR32G32B32Float, 0, out.streamCount };
+			out.streams[out.streamCount++] = constant;
+			out.attributes[s] = attribute;
+		}
+
+		if (!GetPositionBounds(accessors[MESH_SEMANTIC_POSITION], out.bounds))
+			return false;
+		memset(&out.decode, 0, sizeof(out.decode));
+		out.decode.positionScale[0] = out.decode.positionScale[1] = out.decode.positionScale[2] = scales[MESH_SEMANTIC_POSITION];
+		out.decode.uvScaleOffset[0] = out.decode.uvScaleOffset[1] = scales[MESH_SEMANTIC_UV];
+
+		uint32_t indicesIndex;
+		if (primitive.Find("indices"))
+		{
+			Accessor indices;
+			if (!GetUint(primitive, "indices", indicesIndex, true) || !ResolveAccessor(context, indicesIndex, indices) ||
+				indices.components != 1 || indices.normalized || indices.stride != indices.componentSize || indices.count % 3 != 0)
+				return false;
+			out.indexCount = indices.count;
+			const uint8_t* data = indices.view.data + indices.offset;
+			if (indices.componentType == kUnsignedShort || indices.componentType == kUnsignedInt)
+			{
+				out.indexData = data;
+				out.indexSize = indices.componentSize;
+			}
+			else if (indices.componentType == kUnsignedByte)
+			{
+				ownedIndices.push_back(std::vector<uint8_t>(indices.count * sizeof(uint16_t)));
+				uint16_t* widened = reinterpret_cast<uint16_t*>(ownedIndices.back().data());
+				for (uint32_t i = 0; i < indices.count; ++i)
+					widened[i] = data[i];
+				out.indexData = widened;
+				out.indexSize = sizeof(uint16_t);
+				copiedBytes += ownedIndices.back().size();
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else
+		{
+			out.indexCount = out.vertexCount - out.vertexCount % 3;
+			out.indexSize = out.vertexCount <= 65536 ? 2 : 4;
+			ownedIndices.push_back(std::vector<uint8_t>(static_cast<size_t>(out.indexCount) * out.indexSize));
+			uint8_t* generated = ownedIndices.back().data();
+			for (uint32_t i = 0; i < out.indexCount; ++i)
+			{
+				if (out.indexSize == 2)
+					reinterpret_cast<uint16_t*>(generated)[i] = static_cast<uint16_t>(i);
+				else
+					reinterpret_cast<uint32_t*>(generated)[i] = i;
+			}
+			out.indexData = generated;
+			copiedBytes += ownedIndices.back().size();
+		}
+
+		uint32_t material;
+		if (!GetUint(primitive, "material", material, false, GLB_NONE))
+			return false;
+		out.image = material == GLB_NONE ? GLB_NONE : GetBaseColorImage(root, material, imageCount);
+		return true;
+	}
+}
+
+GlbFile::GlbFile(void)
+{
+}
+
+void GlbFile::Close(void)
+{
+	m_primitives.clear();
+	m_images.clear();
+	m_ownedIndices.clear();
+	m_file.Close();
+}
+
+bool GlbFile::Open(const char* path, GlbLoadStats* stats)
+{
+	auto start = std::chrono::steady_clock::now();
+	Close();
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+	if (!m_file.Open(path))
+		return false;
+
+	// 12-byte header, then the JSON chunk and an optional binary chunk, each with an 8-byte header.
+	const uint8_t* data = m_file.GetData();
+	uint64_t fileSize = m_file.GetSize();
+	uint32_t header[5];
+	if (fileSize < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	memcpy(header, data, sizeof(header));
+	uint64_t length = header[2];
+	uint64_t jsonEnd = 20ull + header[3];
+	if (header[0] != GLB_MAGIC || header[1] != GLB_VERSION || length > fileSize || header[4] != GLB_CHUNK_JSON || jsonEnd > length)
+	{
+		Close();
+		return false;
+	}
+
+	GlbContext context = { nullptr, nullptr, nullptr, 0 };
+	if (jsonEnd + 8 <= length)
+	{
+		uint32_t binHeader[2];
+		memcpy(binHeader, data + jsonEnd, sizeof(binHeader));
+		if (binHeader[1] != GLB_CHUNK_BIN || jsonEnd + 8 + binHeader[0] > length)
+		{
+			Close();
+			return false;
+		}
+		context.bin = data + jsonEnd + 8;
+		context.binSize = binHeader[0];
+	}
+
+	JsonValue root;
+	JsonParser parser(reinterpret_cast<const char*>(data + 20), header[3]);
+	const JsonValue* asset = nullptr;
+	const JsonValue* version = nullptr;
+	if (!parser.Parse(root) || !(asset = root.Find("asset")) || !(version = asset->Find("version")) || version->type != JsonValue::JSON_STRING ||
+		version->string.compare(0, 2, "2.") != 0)
+	{
+		Close();
+		return false;
+	}
+
+	// A file that needs an extension this loader does not know cannot be drawn correctly.
+	const JsonValue* required = root.Find("extensionsRequired");
+	for (uint32_t i = 0; required && i < required->GetSize(); ++i)
+	{
+		bool supported = false;
+		for (const char* extension : kSupportedExtensions)
+			supported = supported || required->items[i].string == extension;
+		if (!supported)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	// Buffer 0 is the binary chunk, which may be padded past its declared length.
+	const JsonValue* buffers = root.Find("buffers");
+	const JsonValue* buffer = buffers ? buffers->At(0) : nullptr;
+	uint32_t bufferLength;
+	if (buffer)
+	{
+		if (buffer->Find("uri") || !GetUint(*buffer, "byteLength", bufferLength, true) || bufferLength > context.binSize)
+		{
+			Close();
+			return false;
+		}
+		context.binSize = bufferLength;
+	}
+	else
+	{
+		context.bin = nullptr;
+		context.binSize = 0;
+	}
+	context.accessors = root.Find("accessors");
+	context.bufferViews = root.Find("bufferViews");
+
+	const JsonValue* images = root.Find("images");
+	for (uint32_t i = 0; images && i < images->GetSize(); ++i)
+	{
+		const JsonValue& entry = images->items[i];
+		const JsonValue* uri = entry.Find("uri");
+		const JsonValue* mimeType = entry.Find("mimeType");
+		GlbImage image;
+		image.data = nullptr;
+		image.size = 0;
+		image.uri = uri && uri->type == JsonValue::JSON_STRING ? uri->string : std::string();
+		image.mimeType = mimeType && mimeType->type == JsonValue::JSON_STRING ? mimeType->string : std::string();
+		uint32_t viewIndex;
+		BufferView view;
+		if (entry.Find("bufferView") && (!GetUint(entry, "bufferView", viewIndex, true) || !ResolveBufferView(context, viewIndex, view)))
+		{
+			Close();
+			return false;
+		}
+		if (entry.Find("bufferView"))
+		{
+			image.data = view.data;
+			image.size = static_cast<uint32_t>(view.length);
+		}
+		m_images.push_back(image);
+	}
+
+	// Walk the default scene, or every root node when there is none, placing each mesh by its node.
+	const JsonValue* nodes = root.Find("nodes");
+	const JsonValue* meshes = root.Find("meshes");
+	std::vector<uint32_t> pending;
+	std::vector<float> parents;
+	const JsonValue* scenes = root.Find("scenes");
+	uint32_t sceneIndex;
+	if (!GetUint(root, "scene", sceneIndex, false))
+	{
+		Close();
+		return false;
+	}
+	const JsonValue* scene = scenes ? scenes->At(sceneIndex) : nullptr;
+	const JsonValue* sceneNodes = scene ? scene->Find("nodes") : nullptr;
+	if (sceneNodes)
+	{
+		for (uint32_t i = 0; i < sceneNodes->GetSize(); ++i)
+		{
+			uint32_t nodeIndex;
+			if (!ToUint(sceneNodes->items[i], nodeIndex))
+			{
+				Close();
+				return false;
+			}
+			pending.push_back(nodeIndex);
+		}
+	}
+	else if (!scenes && nodes)
+	{
+		std::vector<bool> isChild(nodes->GetSize(), false);
+		for (uint32_t n = 0; n < nodes->GetSize(); ++n)
+		{
+			const JsonValue* children = nodes->items[n].Find("children");
+			for (uint32_t c = 0; children && c < children->GetSize(); ++c)
+			{
+				uint32_t child;
+				if (ToUint(children->items[c], child) && child < isChild.size())
+					isChild[child] = true;
+			}
+		}
+		for (uint32_t n = 0; n < nodes->GetSize(); ++n)
+		{
+			if (!isChild[n])
+				pending.push_back(n);
+		}
+	}
+
+	// Roots hang off a z mirror that turns glTF's right-handed space into the renderer's left-handed one.
+	static const float mirror[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 0, 1 };
+	std::reverse(pending.begin(), pending.end());
+	for (size_t i = 0; i < pending.size(); ++i)
+		parents.insert(parents.end(), mirror, mirror + 16);
+	std::vector<bool> visited(nodes ? nodes->GetSize() : 0, false);
+
+	uint64_t copiedBytes = 0;
+	uint32_t skipped = 0;
+	while (!pending.empty())
+	{
+		uint32_t nodeIndex = pending.back();
+		float transform[16], local[16];
+		memcpy(transform, &parents[parents.size() - 16], sizeof(transform));
+		pending.pop_back();
+		parents.resize(parents.size() - 16);
+
+		// Nodes form a forest, so one seen twice means the file is malformed.
+		const JsonValue* node = nodes ? nodes->At(nodeIndex) : nullptr;
+		if (!node || visited[nodeIndex] || !GetNodeTransform(*node, local))
+		{
+			Close();
+			return false;
+		}
+		visited[nodeIndex] = true;
+		Multiply(local, transform, transform);
+
+		const JsonValue* children = node->Find("children");
+		// Children go on the stack last first so that primitives come out in file order.
+		for (uint32_t c = children ? children->GetSize() : 0; c-- > 0;)
+		{
+			uint32_t child;
+			if (!ToUint(children->items[c], child))
+			{
+				Close();
+				return false;
+			}
+			pending.push_back(child);
+			parents.insert(parents.end(), transform, transform + 16);
+		}
+
+		uint32_t meshIndex;
+		if (!GetUint(*node, "mesh", meshIndex, false, GLB_NONE))
+		{
+			Close();
+			return false;
+		}
+		if (meshIndex == GLB_NONE)
+			continue;
+		const JsonValue* mesh = meshes ? meshes->At(meshIndex) : nullptr;
+		const JsonValue* primitives = mesh ? mesh->Find("primitives") : nullptr;
+		if (!primitives)
+		{
+			Close();
+			return false;
+		}
+		const JsonValue* meshName = mesh->Find("name");
+		for (uint32_t p = 0; p < primitives->GetSize(); ++p)
+		{
+			GlbPrimitive primitive;
+			memset(&primitive, 0, sizeof(primitive));
+			bool primitiveSkipped = false;
+			if (!BuildPrimitive(context, root, primitives->items[p], static_cast<uint32_t>(m_images.size()), primitive, m_ownedIndices, primitiveSkipped, copiedBytes))
+			{
+				Close();
+				return false;
+			}
+			if (primitiveSkipped)
+			{
+				++skipped;
+				continue;
+			}
+			memcpy(primitive.transform, transform, sizeof(transform));
+			std::string name = meshName && meshName->type == JsonValue::JSON_STRING ? meshName->string : "mesh " + std::to_string(meshIndex);
+			CopyName(primitive.name, MESH_NAME_LENGTH, primitives->GetSize() > 1 ? name + " " + std::to_string(p) : name);
+			m_primitives.push_back(primitive);
+		}
+	}
+
+	if (stats)
+	{
+		stats->fileBytes = fileSize;
+		stats->primitiveCount = static_cast<uint32_t>(m_primitives.size());
+		stats->skippedPrimitives = skipped;
+		for (const GlbPrimitive& primitive : m_primitives)
+		{
+			stats->vertexCount += primitive.vertexCount;
+			stats->triangleCount += primitive.indexCount / 3;
+		}
+		stats->copiedBytes = copiedBytes;
+		stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return true;
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include "MeshPacking.h"
+#include "../Common/MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DX11UWA
+{
+	const uint32_t GLB_MAGIC = 0x46546C67;			// "glTF"
+	const uint32_t GLB_VERSION = 2;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;		// "JSON"
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;		// "BIN\0"
+	const uint32_t GLB_NONE = ~0u;
+
+	// Vertex data for one input slot. data points into the mapped file, or at a constant default
+	// with a stride of 0 for an attribute the primitive does not have.
+	struct GlbVertexStream
+	{
+		const uint8_t*	data;
+		uint32_t		size;
+		uint32_t		stride;
+	};
+
+	// Where one LightingVertexShader input is fetched from.
+	struct GlbVertexAttribute
+	{
+		uint16_t	semantic;	// MeshSemantic
+		uint16_t	format;		// DXGI_FORMAT value
+		uint32_t	offset;		// within a vertex of its stream
+		uint32_t	stream;
+	};
+
+	// One triangle list of a mesh, as placed by one node of the scene.
+	struct GlbPrimitive
+	{
+		GlbVertexStream		streams[MESH_VERTEX_ATTRIBUTE_COUNT];
+		uint32_t			streamCount;
+		GlbVertexAttribute	attributes[MESH_VERTEX_ATTRIBUTE_COUNT];	// indexed by MeshSemantic
+		uint32_t			vertexCount;
+		const void*			indexData;
+		uint32_t			indexCount;
+		uint32_t			indexSize;
+		MeshDecodeConstants	decode;			// turns fetched integer positions and uvs back into their stored values
+		MeshBounds			bounds;			// after decode, before transform
+		float				transform[16];	// mesh to scene, row-major for row vectors, left-handed
+		uint32_t			image;			// of the base color texture, or GLB_NONE
+		char				name[MESH_NAME_LENGTH];
+	};
+
+	struct GlbImage
+	{
+		const uint8_t*	data;		// in the binary chunk; null for an external image
+		uint32_t		size;
+		std::string		uri;		// relative to the .glb; empty for an embedded image
+		std::string		mimeType;
+	};
+
+	struct GlbLoadStats
+	{
+		uint64_t	fileBytes;
+		uint32_t	primitiveCount;
+		uint32_t	skippedPrimitives;	// points and lines, which are not drawn
+		uint32_t	vertexCount;
+		uint32_t	triangleCount;
+		uint64_t	copiedBytes;		// indices that had to be widened or generated
+		double		seconds;
+	};
+
+	// Binary glTF 2.0. The file is mapped and every accessor a primitive draws from is checked
+	// against its buffer view and against the formats the input assembler can fetch; after that
+	// the vertex and index data are used where they lie in the file, with no per-element work.
+	// Positions and uvs may be float or 8/16-bit integers, normalized or not, as with
+	// KHR_mesh_quantization; normals float or normalized signed integers. Only 8-bit indices,
+	// which Direct3D cannot draw, and non-indexed primitives get index arrays of their own.
+	// Index values are not checked: the input assembler reads zeros past the end of a buffer.
+	// glTF is right-handed, so each transform also mirrors z.
+	class GlbFile
+	{
+	public:
+		GlbFile(void);
+
+		bool Open(const char* path, GlbLoadStats* stats = nullptr);
+		void Close(void);
+
+		uint32_t GetPrimitiveCount(void) const						{ return static_cast<uint32_t>(m_primitives.size()); }
+		const GlbPrimitive& GetPrimitive(uint32_t primitive) const	{ return m_primitives[primitive]; }
+		uint32_t GetImageCount(void) const							{ return static_cast<uint32_t>(m_images.size()); }
+		const GlbImage& GetImage(uint32_t image) const				{ return m_images[image]; }
+
+	private:
+		GlbFile(const GlbFile&);
+		GlbFile& operator=(const GlbFile&);
+
+		DX::MappedFile						m_file;
+		std::vector<GlbPrimitive>			m_primitives;
+		std::vector<GlbImage>				m_images;
+		std::vector<std::vector<uint8_t>>	m_ownedIndices;
+	};
+}
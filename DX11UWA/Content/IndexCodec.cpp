@@ -0,0 +1,284 @@
+﻿#include "IndexCodec.h"
+
+#include <cstring>
+
+using namespace DX11UWA;
+
+namespace
+{
+	// Stream layout: one header byte, then per triangle either
+	//   edge hit:  [edge << 4 | code]                 edge < 15
+	//   edge miss: [0xF0 | codeA] [codeB << 4 | codeC]
+	// followed by a varint for each vertex whose code is kExplicitCode.
+	// Vertex codes: 0 = next unseen vertex, 1..14 = vertex FIFO slot, 15 = explicit.
+	const uint8_t kHeader = 0xE1;
+	const uint32_t kFifoSize = 16;
+	const uint32_t kEdgeHitLimit = 15;
+	const uint32_t kVertexHitLimit = 14;
+	const uint32_t kNextCode = 0;
+	const uint32_t kExplicitCode = 15;
+	const uint8_t kMissCode = 0xF0;
+
+	inline uint32_t ReadIndex(const void* indices, uint32_t indexSize, size_t i)
+	{
+		return indexSize == 2 ? static_cast<const uint16_t*>(indices)[i] : static_cast<const uint32_t*>(indices)[i];
+	}
+
+	inline void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	inline bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (p == end)
+				return false;
+			uint8_t byte = *p++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (byte < 0x80)
+				return true;
+		}
+		return false;
+	}
+
+	inline uint32_t ZigZag(uint32_t vertex, uint32_t last)
+	{
+		int32_t delta = static_cast<int32_t>(vertex - last);
+		return (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+	}
+
+	inline uint32_t UnZigZag(uint32_t value, uint32_t last)
+	{
+		return last + ((value >> 1) ^ (0u - (value & 1)));
+	}
+
+	// State shared by the encoder and decoder; both sides must update it identically.
+	struct CodecState
+	{
+		uint32_t	edges[kFifoSize][2];
+		uint32_t	vertices[kFifoSize];
+		uint32_t	edgeOffset;
+		uint32_t	vertexOffset;
+		uint32_t	next;
+		uint32_t	last;
+
+		CodecState(void)
+		{
+			memset(edges, 0xFF, sizeof(edges));
+			memset(vertices, 0xFF, sizeof(vertices));
+			edgeOffset = vertexOffset = next = last = 0;
+		}
+
+		void PushEdge(uint32_t a, uint32_t b)
+		{
+			edges[edgeOffset][0] = a;
+			edges[edgeOffset][1] = b;
+			edgeOffset = (edgeOffset + 1) & (kFifoSize - 1);
+		}
+
+		void PushVertex(uint32_t v)
+		{
+			vertices[vertexOffset] = v;
+			vertexOffset = (vertexOffset + 1) & (kFifoSize - 1);
+		}
+
+		const uint32_t* GetEdge(uint32_t age) const
+		{
+			return edges[(edgeOffset - 1 - age) & (kFifoSize - 1)];
+		}
+
+		uint32_t GetVertex(uint32_t age) const
+		{
+			return vertices[(vertexOffset - 1 - age) & (kFifoSize - 1)];
+		}
+
+		// Encoder side: returns the code for v and updates the state as the decoder will.
+		uint32_t EncodeVertex(uint32_t v)
+		{
+			if (v == next)
+			{
+				++next;
+				PushVertex(v);
+				return kNextCode;
+			}
+			for (uint32_t age = 0; age < kVertexHitLimit; ++age)
+			{
+				if (GetVertex(age) == v)
+					return 1 + age;
+			}
+			PushVertex(v);
+			return kExplicitCode;
+		}
+
+		bool DecodeVertex(uint32_t code, const uint8_t*& p, const uint8_t* end, uint32_t& v)
+		{
+			if (code == kNextCode)
+			{
+				v = next++;
+				PushVertex(v);
+				return true;
+			}
+			if (code != kExplicitCode)
+			{
+				v = GetVertex(code - 1);
+				return true;
+			}
+
+			uint32_t value;
+			if (!ReadVarint(p, end, value))
+				return false;
+			v = last = UnZigZag(value, last);
+			PushVertex(v);
+			return true;
+		}
+	};
+
+	template <typename IndexType>
+	bool DecodeTriangles(const uint8_t* p, const uint8_t* end, IndexType* out, size_t triangleCount, size_t vertexCount)
+	{
+		CodecState state;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (p == end)
+				return false;
+			uint8_t code = *p++;
+
+			uint32_t a, b, c;
+			if (code < kMissCode)
+			{
+				const uint32_t* edge = state.GetEdge(code >> 4);
+				a = edge[0];
+				b = edge[1];
+				if (!state.DecodeVertex(code & 15, p, end, c))
+					return false;
+				state.PushEdge(c, b);
+				state.PushEdge(a, c);
+			}
+			else
+			{
+				if (p == end)
+					return false;
+				uint8_t codes = *p++;
+				if (!state.DecodeVertex(code & 15, p, end, a) ||
+					!state.DecodeVertex(codes >> 4, p, end, b) ||
+					!state.DecodeVertex(codes & 15, p, end, c))
+					return false;
+				state.PushEdge(b, a);
+				state.PushEdge(c, b);
+				state.PushEdge(a, c);
+			}
+
+			// Unused FIFO slots hold ~0, so this also rejects references to them.
+			if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+				return false;
+			out[t * 3 + 0] = static_cast<IndexType>(a);
+			out[t * 3 + 1] = static_cast<IndexType>(b);
+			out[t * 3 + 2] = static_cast<IndexType>(c);
+		}
+		return p == end;
+	}
+}
+
+void DX11UWA::ConvertIndices(const void* source, uint32_t sourceSize, void* destination, uint32_t destinationSize, size_t indexCount)
+{
+	if (sourceSize == destinationSize)
+	{
+		memcpy(destination, source, indexCount * sourceSize);
+		return;
+	}
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t index = ReadIndex(source, sourceSize, i);
+		if (destinationSize == 2)
+			static_cast<uint16_t*>(destination)[i] = static_cast<uint16_t>(index);
+		else
+			static_cast<uint32_t*>(destination)[i] = index;
+	}
+}
+
+void DX11UWA::EncodeIndexBuffer(const void* indices, size_t indexCount, uint32_t indexSize, std::vector<uint8_t>& outData)
+{
+	outData.clear();
+	outData.reserve(1 + indexCount / 2);
+	outData.push_back(kHeader);
+
+	CodecState state;
+	uint32_t explicitVertices[3];
+	for (size_t t = 0; t + 3 <= indexCount; t += 3)
+	{
+		uint32_t corners[3] = { ReadIndex(indices, indexSize, t), ReadIndex(indices, indexSize, t + 1), ReadIndex(indices, indexSize, t + 2) };
+
+		// Look for a recent edge this triangle shares, in any rotation.
+		int hitAge = -1;
+		int rotation = 0;
+		for (uint32_t age = 0; age < kEdgeHitLimit && hitAge < 0; ++age)
+		{
+			const uint32_t* edge = state.GetEdge(age);
+			for (int r = 0; r < 3; ++r)
+			{
+				if (edge[0] == corners[r] && edge[1] == corners[(r + 1) % 3])
+				{
+					hitAge = static_cast<int>(age);
+					rotation = r;
+					break;
+				}
+			}
+		}
+
+		unsigned int explicitCount = 0;
+		if (hitAge >= 0)
+		{
+			uint32_t a = corners[rotation];
+			uint32_t b = corners[(rotation + 1) % 3];
+			uint32_t c = corners[(rotation + 2) % 3];
+			uint32_t code = state.EncodeVertex(c);
+			outData.push_back(static_cast<uint8_t>((hitAge << 4) | code));
+			if (code == kExplicitCode)
+				explicitVertices[explicitCount++] = c;
+			state.PushEdge(c, b);
+			state.PushEdge(a, c);
+		}
+		else
+		{
+			uint32_t codes[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				codes[k] = state.EncodeVertex(corners[k]);
+				if (codes[k] == kExplicitCode)
+					explicitVertices[explicitCount++] = corners[k];
+			}
+			outData.push_back(static_cast<uint8_t>(kMissCode | codes[0]));
+			outData.push_back(static_cast<uint8_t>((codes[1] << 4) | codes[2]));
+			state.PushEdge(corners[1], corners[0]);
+			state.PushEdge(corners[2], corners[1]);
+			state.PushEdge(corners[0], corners[2]);
+		}
+
+		for (unsigned int i = 0; i < explicitCount; ++i)
+		{
+			WriteVarint(outData, ZigZag(explicitVertices[i], state.last));
+			state.last = explicitVertices[i];
+		}
+	}
+}
+
+bool DX11UWA::DecodeIndexBuffer(const uint8_t* data, size_t size, void* outIndices, size_t indexCount, uint32_t indexSize, size_t vertexCount)
+{
+	if (size == 0 || data[0] != kHeader || indexCount % 3 != 0)
+		return false;
+
+	if (indexSize == 2)
+		return DecodeTriangles(data + 1, data + size, static_cast<uint16_t*>(outIndices), indexCount / 3, vertexCount);
+	if (indexSize == 4)
+		return DecodeTriangles(data + 1, data + size, static_cast<uint32_t*>(outIndices), indexCount / 3, vertexCount);
+	return false;
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DX11UWA
+{
+	// 16-bit indices whenever every vertex can be addressed with them, 32-bit otherwise.
+	inline uint32_t ChooseIndexSize(size_t vertexCount)
+	{
+		return vertexCount <= 0x10000 ? 2 : 4;
+	}
+
+	// Converts indices between 16 and 32 bits. The caller guarantees they fit the destination.
+	void ConvertIndices(const void* source, uint32_t sourceSize, void* destination, uint32_t destinationSize, size_t indexCount);
+
+	// Compresses a triangle list. Each triangle becomes one code byte when it shares an edge
+	// with a recent triangle and its remaining vertex is either the next unseen vertex or a
+	// recent one, which is the common case after OptimizeVertexCache and OptimizeVertexFetch.
+	// Other vertices are stored as zigzag varint deltas. Triangles may come back rotated,
+	// which keeps their winding. indexSize is 2 or 4.
+	void EncodeIndexBuffer(const void* indices, size_t indexCount, uint32_t indexSize, std::vector<uint8_t>& outData);
+
+	// Decodes indexCount indices into outIndices as indexSize-byte values. Fails on corrupt
+	// input, including any index that is not below vertexCount.
+	bool DecodeIndexBuffer(const uint8_t* data, size_t size, void* outIndices, size_t indexCount, uint32_t indexSize, size_t vertexCount);
+}
@@ -0,0 +1,550 @@
+﻿#include "MeshCache.h"
+
+#include "../Common/FileIO.h"
+#include "../Common/LinearArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace DX11UWA;
+using DX::ArenaVector;
+
+static_assert(sizeof(MeshCacheHeader) == 352, "MeshCacheHeader is part of the file format");
+
+namespace
+{
+	const uint64_t kDataAlignment = 64;
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline uint64_t Rotate(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline uint64_t ReadWord(const uint8_t* p)
+	{
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		return word;
+	}
+
+	// The directory part of a path, including its last separator.
+	std::string DirectoryOf(const char* path)
+	{
+		std::string directory(path);
+		size_t slash = directory.find_last_of("/\\");
+		directory.resize(slash == std::string::npos ? 0 : slash + 1);
+		return directory;
+	}
+
+	void CopyName(char* destination, size_t capacity, const std::string& source)
+	{
+		size_t length = source.size() < capacity - 1 ? source.size() : capacity - 1;
+		memcpy(destination, source.c_str(), length);
+		destination[length] = '\0';
+	}
+
+	// Gives every distinct group name and material pair one submesh, in order of first use, and
+	// moves each submesh's triangles together without otherwise changing their order.
+	void BuildSubmeshes(const ObjLayout& layout, std::vector<uint32_t>& indices, std::vector<MeshSubmesh>& submeshes, std::vector<uint32_t>& partOffsets)
+	{
+		DX::LinearArena::Frame arenaFrame;
+		ArenaVector<uint32_t> groupSubmesh(layout.groups.size());
+		ArenaVector<const ObjGroup*> firstGroup;
+		ArenaVector<uint32_t> submeshIndexCount;
+		for (size_t g = 0; g < layout.groups.size(); ++g)
+		{
+			const ObjGroup& group = layout.groups[g];
+			size_t s = 0;
+			while (s < firstGroup.size() && !(firstGroup[s]->name == group.name && firstGroup[s]->material == group.material))
+				++s;
+			if (s == submeshes.size())
+			{
+				MeshSubmesh submesh;
+				memset(&submesh, 0, sizeof(submesh));
+				CopyName(submesh.name, MESH_NAME_LENGTH, group.name);
+				CopyName(submesh.material, MESH_NAME_LENGTH, group.material);
+				submesh.materialIndex = MESH_NO_MATERIAL;
+				submeshes.push_back(submesh);
+				firstGroup.push_back(&group);
+				submeshIndexCount.push_back(0);
+			}
+			groupSubmesh[g] = static_cast<uint32_t>(s);
+			submeshIndexCount[s] += group.indexCount;
+		}
+
+		uint32_t offset = 0;
+		for (size_t s = 0; s < submeshes.size(); ++s)
+		{
+			partOffsets.push_back(offset);
+			offset += submeshIndexCount[s];
+		}
+		if (submeshes.size() < 2)
+			return;
+
+		std::vector<uint32_t> reordered(indices.size());
+		ArenaVector<uint32_t> fill(partOffsets.begin(), partOffsets.end());
+		for (size_t g = 0; g < layout.groups.size(); ++g)
+		{
+			const ObjGroup& group = layout.groups[g];
+			std::copy(indices.begin() + group.indexOffset, indices.begin() + group.indexOffset + group.indexCount, reordered.begin() + fill[groupSubmesh[g]]);
+			fill[groupSubmesh[g]] += group.indexCount;
+		}
+		indices.swap(reordered);
+	}
+
+	bool WritePadding(FILE* file, uint64_t from, uint64_t to)
+	{
+		static const uint8_t zeros[kDataAlignment] = { 0 };
+		return to == from || fwrite(zeros, 1, static_cast<size_t>(to - from), file) == to - from;
+	}
+}
+
+uint64_t DX11UWA::HashMeshSource(const void* data, size_t size)
+{
+	const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+
+	// Four independent lanes keep the multiplier pipelines busy on large files.
+	uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+	for (; end - p >= 32; p += 32)
+	{
+		for (int lane = 0; lane < 4; ++lane)
+			lanes[lane] = Rotate(lanes[lane] + ReadWord(p + lane * 8) * prime2, 31) * prime1;
+	}
+
+	uint64_t hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) + Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+	hash ^= static_cast<uint64_t>(size);
+	for (; end - p >= 8; p += 8)
+		hash = Rotate(hash ^ (Rotate(ReadWord(p) * prime2, 31) * prime1), 27) * prime1;
+	for (; p < end; ++p)
+		hash = Rotate(hash ^ (*p * prime1), 11) * prime2;
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+bool DX11UWA::WriteMeshCache(const char* path, const CachedMesh& mesh, uint64_t sourceHash, uint64_t sourceSize, MeshVertexFormat requestedFormat, uint32_t indexEncoding)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.vertexCount = mesh.GetVertexCount();
+	header.vertexStride = mesh.GetVertexStride();
+	header.indexCount = mesh.GetIndexCount();
+	header.indexSize = mesh.GetIndexSize();
+	header.attributeCount = MESH_VERTEX_ATTRIBUTE_COUNT;
+	header.vertexFormat = mesh.GetVertexFormat();
+	header.requestedFormat = requestedFormat;
+	header.indexEncoding = indexEncoding;
+	GetMeshVertexAttributes(mesh.GetVertexFormat(), header.attributes);
+	header.bounds = mesh.GetBounds();
+	header.decode = mesh.GetDecode();
+	header.lodCount = mesh.GetLodCount();
+	for (uint32_t i = 0; i < header.lodCount; ++i)
+		header.lods[i] = mesh.GetLod(i);
+	header.clusterCount = mesh.GetClusterCount();
+	header.submeshCount = mesh.GetSubmeshCount();
+
+	// The part block is small, so it is assembled in memory and written in one go.
+	std::vector<uint8_t> parts(header.submeshCount * sizeof(MeshSubmesh) + header.lodCount * header.submeshCount * sizeof(MeshLod));
+	uint8_t* part = parts.data();
+	for (uint32_t s = 0; s < header.submeshCount; ++s, part += sizeof(MeshSubmesh))
+		memcpy(part, &mesh.GetSubmesh(s), sizeof(MeshSubmesh));
+	for (uint32_t lod = 0; lod < header.lodCount; ++lod)
+	{
+		for (uint32_t s = 0; s < header.submeshCount; ++s, part += sizeof(MeshLod))
+			memcpy(part, &mesh.GetSubmeshLod(lod, s), sizeof(MeshLod));
+	}
+	size_t rangeBytes = parts.size();
+	for (const std::string& library : mesh.GetMaterialLibraries())
+		parts.insert(parts.end(), library.c_str(), library.c_str() + library.size() + 1);
+	header.libraryBytes = static_cast<uint32_t>(parts.size() - rangeBytes);
+
+	uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+	uint64_t clusterBytes = static_cast<uint64_t>(header.clusterCount) * sizeof(MeshCluster);
+	uint64_t partBytes = parts.size();
+	uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+	const void* indexData = mesh.GetIndexData();
+	std::vector<uint8_t> encodedIndices;
+	if (indexEncoding == MESH_INDEX_ENCODED)
+	{
+		EncodeIndexBuffer(mesh.GetIndexData(), header.indexCount, header.indexSize, encodedIndices);
+		indexData = encodedIndices.data();
+		indexBytes = encodedIndices.size();
+	}
+
+	header.vertexOffset = AlignUp(sizeof(MeshCacheHeader), kDataAlignment);
+	header.clusterOffset = AlignUp(header.vertexOffset + vertexBytes, kDataAlignment);
+	header.partOffset = AlignUp(header.clusterOffset + clusterBytes, kDataAlignment);
+	header.indexOffset = AlignUp(header.partOffset + partBytes, kDataAlignment);
+	header.fileSize = header.indexOffset + indexBytes;
+
+	std::string tempPath = std::string(path) + ".tmp";
+	FILE* file = DX::OpenFile(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		WritePadding(file, sizeof(header), header.vertexOffset) &&
+		(vertexBytes == 0 || fwrite(mesh.GetVertexData(), static_cast<size_t>(vertexBytes), 1, file) == 1) &&
+		WritePadding(file, header.vertexOffset + vertexBytes, header.clusterOffset) &&
+		(clusterBytes == 0 || fwrite(mesh.GetClusters(), static_cast<size_t>(clusterBytes), 1, file) == 1) &&
+		WritePadding(file, header.clusterOffset + clusterBytes, header.partOffset) &&
+		(partBytes == 0 || fwrite(parts.data(), static_cast<size_t>(partBytes), 1, file) == 1) &&
+		WritePadding(file, header.partOffset + partBytes, header.indexOffset) &&
+		(indexBytes == 0 || fwrite(indexData, static_cast<size_t>(indexBytes), 1, file) == 1);
+
+	written = (fclose(file) == 0) && written;
+	if (!written || !DX::RenameFile(tempPath.c_str(), path))
+	{
+		DX::RemoveFile(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+CachedMesh::CachedMesh(void)
+{
+	Reset();
+}
+
+bool CachedMesh::OpenCache(const char* path, uint64_t sourceHash, uint64_t sourceSize, MeshVertexFormat requestedFormat)
+{
+	Reset();
+	if (!m_file.Open(path))
+		return false;
+
+	const uint8_t* data = m_file.GetData();
+	uint64_t size = m_file.GetSize();
+	if (size < sizeof(MeshCacheHeader))
+	{
+		Reset();
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+	uint64_t clusterBytes = static_cast<uint64_t>(header.clusterCount) * sizeof(MeshCluster);
+	uint64_t submeshLodCount = static_cast<uint64_t>(header.lodCount) * header.submeshCount;
+	uint64_t partBytes = header.submeshCount * sizeof(MeshSubmesh) + submeshLodCount * sizeof(MeshLod) + header.libraryBytes;
+	uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+	bool valid = header.magic == MESH_CACHE_MAGIC &&
+		header.version == MESH_CACHE_VERSION &&
+		header.sourceHash == sourceHash &&
+		header.sourceSize == sourceSize &&
+		header.fileSize == size &&
+		header.requestedFormat == requestedFormat &&
+		header.vertexFormat < MESH_VERTEX_FORMAT_COUNT &&
+		header.vertexStride == GetMeshVertexStride(static_cast<MeshVertexFormat>(header.vertexFormat)) &&
+		(header.indexSize == 2 || header.indexSize == 4) &&
+		(header.indexSize == 4 || header.vertexCount <= 0x10000) &&
+		(header.indexEncoding == MESH_INDEX_RAW || header.indexEncoding == MESH_INDEX_ENCODED) &&
+		header.vertexOffset % kDataAlignment == 0 &&
+		header.clusterOffset % kDataAlignment == 0 &&
+		header.partOffset % kDataAlignment == 0 &&
+		header.indexOffset % kDataAlignment == 0 &&
+		header.vertexOffset >= sizeof(MeshCacheHeader) && header.vertexOffset + vertexBytes <= size &&
+		header.clusterOffset >= header.vertexOffset + vertexBytes && header.clusterOffset + clusterBytes <= size &&
+		header.partOffset >= header.clusterOffset + clusterBytes && header.partOffset + partBytes <= size &&
+		header.indexOffset >= header.partOffset + partBytes &&
+		(header.indexEncoding == MESH_INDEX_ENCODED ? header.indexOffset <= size : header.indexOffset + indexBytes <= size);
+
+	valid = valid && header.lodCount >= 1 && header.lodCount <= MESH_MAX_LODS && header.submeshCount >= 1;
+	for (uint32_t i = 0; valid && i < header.lodCount; ++i)
+	{
+		const MeshLod& lod = header.lods[i];
+		valid = lod.indexCount > 0 && lod.indexOffset % 3 == 0 && lod.indexCount % 3 == 0 &&
+			static_cast<uint64_t>(lod.indexOffset) + lod.indexCount <= header.indexCount &&
+			static_cast<uint64_t>(lod.clusterOffset) + lod.clusterCount <= header.clusterCount;
+	}
+
+	// Submesh ranges are copied out, since the renderer indexes them by level and submesh.
+	if (valid)
+	{
+		const uint8_t* part = data + header.partOffset;
+		m_submeshes.resize(header.submeshCount);
+		memcpy(m_submeshes.data(), part, header.submeshCount * sizeof(MeshSubmesh));
+		part += header.submeshCount * sizeof(MeshSubmesh);
+		m_submeshLods.resize(static_cast<size_t>(submeshLodCount));
+		memcpy(m_submeshLods.data(), part, static_cast<size_t>(submeshLodCount) * sizeof(MeshLod));
+		part += submeshLodCount * sizeof(MeshLod);
+
+		const char* library = reinterpret_cast<const char*>(part);
+		const char* librariesEnd = library + header.libraryBytes;
+		valid = header.libraryBytes == 0 || librariesEnd[-1] == '\0';
+		for (; valid && library < librariesEnd; library += strlen(library) + 1)
+			m_materialLibraries.push_back(library);
+	}
+	for (size_t i = 0; valid && i < m_submeshLods.size(); ++i)
+	{
+		// Each submesh range has to lie inside its own level.
+		const MeshLod& range = m_submeshLods[i];
+		const MeshLod& lod = header.lods[i / header.submeshCount];
+		valid = range.indexOffset % 3 == 0 && range.indexCount % 3 == 0 &&
+			range.indexOffset >= lod.indexOffset && static_cast<uint64_t>(range.indexOffset) + range.indexCount <= static_cast<uint64_t>(lod.indexOffset) + lod.indexCount &&
+			range.clusterOffset >= lod.clusterOffset && static_cast<uint64_t>(range.clusterOffset) + range.clusterCount <= static_cast<uint64_t>(lod.clusterOffset) + lod.clusterCount;
+	}
+	for (size_t i = 0; valid && i < m_submeshes.size(); ++i)
+	{
+		m_submeshes[i].name[MESH_NAME_LENGTH - 1] = '\0';
+		m_submeshes[i].material[MESH_NAME_LENGTH - 1] = '\0';
+		m_submeshes[i].materialIndex = MESH_NO_MATERIAL;
+	}
+
+	const MeshCluster* clusters = reinterpret_cast<const MeshCluster*>(data + header.clusterOffset);
+	for (uint32_t i = 0; valid && i < header.clusterCount; ++i)
+	{
+		valid = clusters[i].indexOffset % 3 == 0 &&
+			static_cast<uint64_t>(clusters[i].indexOffset) + clusters[i].triangleCount * 3ull <= header.indexCount;
+	}
+
+	if (valid && header.indexEncoding == MESH_INDEX_ENCODED)
+	{
+		m_ownedIndices.resize((indexBytes + 3) / 4);
+		valid = DecodeIndexBuffer(data + header.indexOffset, static_cast<size_t>(size - header.indexOffset),
+			m_ownedIndices.data(), header.indexCount, header.indexSize, header.vertexCount);
+	}
+
+	if (!valid)
+	{
+		Reset();
+		return false;
+	}
+
+	m_vertexData = data + header.vertexOffset;
+	m_indexData = header.indexEncoding == MESH_INDEX_ENCODED ? static_cast<const void*>(m_ownedIndices.data()) : data + header.indexOffset;
+	m_clusterData = header.clusterCount > 0 ? clusters : nullptr;
+	m_vertexCount = header.vertexCount;
+	m_vertexStride = header.vertexStride;
+	m_vertexFormat = static_cast<MeshVertexFormat>(header.vertexFormat);
+	m_decode = header.decode;
+	m_indexCount = header.indexCount;
+	m_indexSize = header.indexSize;
+	m_indexFileBytes = size - header.indexOffset;
+	m_lodCount = header.lodCount;
+	memcpy(m_lods, header.lods, sizeof(m_lods));
+	m_clusterCount = header.clusterCount;
+	m_bounds = header.bounds;
+	return true;
+}
+
+void CachedMesh::Adopt(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, MeshVertexFormat format,
+	const MeshParts* parts)
+{
+	Reset();
+	m_vertexFormat = format;
+	m_vertexStride = GetMeshVertexStride(format);
+	m_decode = ComputeMeshDecodeConstants(format, vertices.data(), vertices.size());
+	m_ownedVertices.resize(vertices.size() * m_vertexStride);
+	PackMeshVertices(format, m_decode, vertices.data(), vertices.size(), m_ownedVertices.data());
+	m_indexSize = ChooseIndexSize(vertices.size());
+	m_ownedIndices.resize((indices.size() * m_indexSize + 3) / 4);
+	ConvertIndices(indices.data(), sizeof(uint32_t), m_ownedIndices.data(), m_indexSize, indices.size());
+
+	m_vertexData = m_ownedVertices.data();
+	m_indexData = m_ownedIndices.data();
+	m_vertexCount = static_cast<uint32_t>(vertices.size());
+	m_indexCount = static_cast<uint32_t>(indices.size());
+	if (parts && parts->lods && parts->lodCount > 0)
+	{
+		m_lodCount = parts->lodCount;
+		memcpy(m_lods, parts->lods, parts->lodCount * sizeof(MeshLod));
+	}
+	else
+	{
+		m_lodCount = 1;
+		m_lods[0].indexOffset = 0;
+		m_lods[0].indexCount = m_indexCount;
+	}
+	if (parts && parts->clusters && !parts->clusters->empty())
+	{
+		m_ownedClusters = *parts->clusters;
+		m_clusterData = m_ownedClusters.data();
+		m_clusterCount = static_cast<uint32_t>(m_ownedClusters.size());
+	}
+	m_bounds = ComputeMeshBounds(vertices.data(), vertices.size());
+
+	if (parts && parts->submeshes && !parts->submeshes->empty() && parts->submeshLods &&
+		parts->submeshLods->size() == m_lodCount * parts->submeshes->size())
+	{
+		m_submeshes = *parts->submeshes;
+		m_submeshLods = *parts->submeshLods;
+	}
+	else
+	{
+		MeshSubmesh submesh;
+		memset(&submesh, 0, sizeof(submesh));
+		submesh.materialIndex = MESH_NO_MATERIAL;
+		submesh.bounds = ComputeMeshBounds(vertices.data(), indices.data() + m_lods[0].indexOffset, m_lods[0].indexCount);
+		m_submeshes.assign(1, submesh);
+		m_submeshLods.assign(m_lods, m_lods + m_lodCount);
+	}
+	if (parts && parts->materialLibraries)
+		m_materialLibraries = *parts->materialLibraries;
+}
+
+bool CachedMesh::LoadMaterials(const char* objPath)
+{
+	m_materials.clear();
+	bool loaded = true;
+	std::string directory = DirectoryOf(objPath);
+	for (const std::string& library : m_materialLibraries)
+		loaded = LoadMtlFile((directory + library).c_str(), m_materials) && loaded;
+
+	// A later definition of the same name wins, as it would if the libraries were one file.
+	for (MeshSubmesh& submesh : m_submeshes)
+	{
+		submesh.materialIndex = MESH_NO_MATERIAL;
+		for (size_t m = 0; m < m_materials.size(); ++m)
+		{
+			if (strcmp(m_materials[m].name, submesh.material) == 0)
+				submesh.materialIndex = static_cast<uint32_t>(m);
+		}
+	}
+	return loaded;
+}
+
+void CachedMesh::Reset(void)
+{
+	m_file.Close();
+	std::vector<uint8_t>().swap(m_ownedVertices);
+	std::vector<uint32_t>().swap(m_ownedIndices);
+	std::vector<MeshCluster>().swap(m_ownedClusters);
+	m_submeshes.clear();
+	m_submeshLods.clear();
+	m_materialLibraries.clear();
+	m_materials.clear();
+	m_vertexData = nullptr;
+	m_indexData = nullptr;
+	m_clusterData = nullptr;
+	m_vertexCount = 0;
+	m_vertexStride = 0;
+	m_vertexFormat = MESH_VERTEX_FLOAT;
+	memset(&m_decode, 0, sizeof(m_decode));
+	m_indexCount = 0;
+	m_indexSize = 0;
+	m_indexFileBytes = 0;
+	m_lodCount = 0;
+	memset(m_lods, 0, sizeof(m_lods));
+	m_clusterCount = 0;
+	memset(&m_bounds, 0, sizeof(m_bounds));
+}
+
+bool DX11UWA::LoadObjWithCache(const char* objPath, const char* cachePath, MeshVertexFormat format, CachedMesh& outMesh, MeshCacheStats* stats)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	MeshCacheStats localStats;
+	memset(&localStats, 0, sizeof(localStats));
+
+	DX::MappedFile source;
+	if (!source.Open(objPath) || source.GetSize() > SIZE_MAX)
+		return false;
+
+	size_t sourceSize = static_cast<size_t>(source.GetSize());
+	uint64_t sourceHash = HashMeshSource(source.GetData(), sourceSize);
+	localStats.hashSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	localStats.cacheHit = cachePath && outMesh.OpenCache(cachePath, sourceHash, sourceSize, format);
+	if (!localStats.cacheHit)
+	{
+		// Every stage's temporaries come from this arena and go back when the stage returns; the
+		// blocks themselves are returned to the OS together when the import is done.
+		DX::LinearArena arena;
+		DX::LinearArena::Scope arenaScope(arena);
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+		ObjLayout layout;
+		if (!ParseObjSource(source.GetData(), sourceSize, vertices, indices, &localStats.parse, 0, &layout))
+			return false;
+		std::vector<MeshSubmesh> submeshes;
+		std::vector<uint32_t> partOffsets;
+		BuildSubmeshes(layout, indices, submeshes, partOffsets);
+		OptimizeMesh(vertices, indices, &localStats.optimize, &partOffsets);
+
+		std::vector<MeshLod> submeshLods(submeshes.size());
+		for (size_t s = 0; s < submeshes.size(); ++s)
+		{
+			submeshLods[s].indexOffset = partOffsets[s];
+			submeshLods[s].indexCount = (s + 1 < partOffsets.size() ? partOffsets[s + 1] : static_cast<uint32_t>(indices.size())) - partOffsets[s];
+		}
+		MeshLod lods[MESH_MAX_LODS];
+		uint32_t lodCount = BuildMeshLods(indices, vertices, lods, MESH_MAX_LODS, &localStats.lods, &submeshLods);
+		std::vector<MeshCluster> clusters;
+		BuildMeshClusters(indices, vertices, lods, lodCount, clusters, &localStats.clusters, submeshLods.data(), static_cast<uint32_t>(submeshes.size()));
+		// Clustering reordered LOD 0, so renumber the vertices to follow it again.
+		vertices.resize(OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.size()));
+		// Coarser levels can collapse onto a vertex from across a submesh border, so bounds cover every level.
+		for (size_t s = 0; s < submeshes.size(); ++s)
+		{
+			submeshes[s].bounds = ComputeMeshBounds(vertices.data(), indices.data() + submeshLods[s].indexOffset, submeshLods[s].indexCount);
+			for (uint32_t lod = 1; lod < lodCount; ++lod)
+			{
+				const MeshLod& range = submeshLods[lod * submeshes.size() + s];
+				if (range.indexCount == 0)
+					continue;
+				MeshBounds bounds = ComputeMeshBounds(vertices.data(), indices.data() + range.indexOffset, range.indexCount);
+				submeshes[s].bounds.min.x = std::min(submeshes[s].bounds.min.x, bounds.min.x);
+				submeshes[s].bounds.min.y = std::min(submeshes[s].bounds.min.y, bounds.min.y);
+				submeshes[s].bounds.min.z = std::min(submeshes[s].bounds.min.z, bounds.min.z);
+				submeshes[s].bounds.max.x = std::max(submeshes[s].bounds.max.x, bounds.max.x);
+				submeshes[s].bounds.max.y = std::max(submeshes[s].bounds.max.y, bounds.max.y);
+				submeshes[s].bounds.max.z = std::max(submeshes[s].bounds.max.z, bounds.max.z);
+			}
+		}
+
+		MeshParts parts = { lods, lodCount, &clusters, &submeshes, &submeshLods, &layout.materialLibraries };
+		outMesh.Adopt(vertices, indices, format, &parts);
+		if (format != MESH_VERTEX_FLOAT)
+		{
+			ArenaVector<MeshVertex> decoded(vertices.size());
+			UnpackMeshVertices(format, outMesh.GetDecode(), outMesh.GetVertexData(), vertices.size(), decoded.data());
+			localStats.packingError = MeasurePackingError(vertices.data(), decoded.data(), vertices.size());
+			if (!IsWithinPackingTolerance(localStats.packingError))
+				outMesh.Adopt(vertices, indices, MESH_VERTEX_FLOAT, &parts);
+		}
+
+		// Prefer serving the mesh from the freshly written cache so both paths behave the same.
+		localStats.cacheWritten = cachePath && WriteMeshCache(cachePath, outMesh, sourceHash, sourceSize, format);
+		if (localStats.cacheWritten)
+		{
+			MeshVertexFormat packedFormat = outMesh.GetVertexFormat();
+			if (!outMesh.OpenCache(cachePath, sourceHash, sourceSize, format))
+				outMesh.Adopt(vertices, indices, packedFormat, &parts);
+		}
+		localStats.arenaPeakBytes = arena.GetPeakBytesInUse();
+		localStats.arenaReservedBytes = arena.GetPeakBytesReserved();
+	}
+	localStats.materialsLoaded = outMesh.LoadMaterials(objPath);
+
+	localStats.loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	if (stats)
+		*stats = localStats;
+	return true;
+}
+
+bool DX11UWA::OpenObjCache(const char* objPath, const char* cachePath, MeshVertexFormat format, CachedMesh& outMesh)
+{
+	DX::MappedFile source;
+	if (!cachePath || !source.Open(objPath) || source.GetSize() > SIZE_MAX)
+		return false;
+	size_t sourceSize = static_cast<size_t>(source.GetSize());
+	return outMesh.OpenCache(cachePath, HashMeshSource(source.GetData(), sourceSize), sourceSize, format);
+}
@@ -0,0 +1,170 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshPacking.h"
+#include "IndexCodec.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+#include "../Common/MappedFile.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace DX11UWA
+{
+	// Binary mesh cache, version 7. Every field is little-endian and the vertex and cluster
+	// arrays are 64-byte aligned, so both are used straight from the mapping. Indices are
+	// stored raw the same way or, by default, compressed with EncodeIndexBuffer. The part block
+	// holds the submeshes, their range in every LOD and the material library names.
+	const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+	const uint32_t MESH_CACHE_VERSION = 7;	// 2: optimized order, 3: packed vertex formats, 4: 16-bit and encoded indices, 5: LODs, 6: clusters, 7: submeshes
+	const uint32_t MESH_INDEX_RAW = 0;
+	const uint32_t MESH_INDEX_ENCODED = 1;
+	const uint32_t MESH_CACHE_MAX_ATTRIBUTES = 8;
+
+	struct MeshCacheHeader
+	{
+		uint32_t			magic;
+		uint32_t			version;
+		uint64_t			sourceHash;
+		uint64_t			sourceSize;
+		uint32_t			vertexCount;
+		uint32_t			vertexStride;
+		uint32_t			indexCount;
+		uint32_t			indexSize;
+		uint32_t			attributeCount;
+		uint32_t			vertexFormat;		// MeshVertexFormat the vertices are stored in
+		uint32_t			requestedFormat;	// format asked for; differs when packing fell back to float
+		uint32_t			indexEncoding;		// MESH_INDEX_RAW or MESH_INDEX_ENCODED
+		MeshAttribute		attributes[MESH_CACHE_MAX_ATTRIBUTES];
+		MeshBounds			bounds;
+		MeshDecodeConstants	decode;
+		uint32_t			lodCount;
+		MeshLod				lods[MESH_MAX_LODS];	// ranges of the index array, finest first
+		uint32_t			clusterCount;
+		uint32_t			submeshCount;
+		uint32_t			libraryBytes;		// null-terminated mtllib names at the end of the part block
+		uint32_t			reserved;
+		uint64_t			vertexOffset;
+		uint64_t			clusterOffset;
+		uint64_t			partOffset;			// MeshSubmesh[submeshCount], MeshLod[lodCount * submeshCount], library names
+		uint64_t			indexOffset;
+		uint64_t			fileSize;
+	};
+
+	// Everything about a mesh besides its vertices and indices. Null members are left out.
+	struct MeshParts
+	{
+		const MeshLod*						lods;
+		uint32_t							lodCount;
+		const std::vector<MeshCluster>*		clusters;
+		const std::vector<MeshSubmesh>*		submeshes;
+		const std::vector<MeshLod>*			submeshLods;		// lodCount per submesh, level-major as BuildMeshLods leaves them
+		const std::vector<std::string>*		materialLibraries;
+	};
+
+	// Hash used to tie a cache file to the exact bytes of its source asset.
+	uint64_t HashMeshSource(const void* data, size_t size);
+
+	// Mesh data that is either mapped from a cache file or owned in memory.
+	// Either way the pointers stay valid until Reset.
+	class CachedMesh
+	{
+	public:
+		CachedMesh(void);
+
+		// Maps a cache file and validates it against the source and format request it was built from.
+		bool OpenCache(const char* path, uint64_t sourceHash, uint64_t sourceSize, MeshVertexFormat requestedFormat);
+		// Packs vertices into format and keeps a copy of them and the indices, narrowed to 16 bits when they fit.
+		// Without lods the whole index array is the only level, and without submeshes the whole
+		// of every level is one submesh with no material. Clusters are optional either way.
+		void Adopt(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, MeshVertexFormat format,
+			const MeshParts* parts = nullptr);
+		// Parses the material libraries, looked up next to objPath, and points each submesh at its
+		// material by name. Materials are not cached so that editing a .mtl needs no rebuild.
+		// Returns false when a library is missing or malformed; the rest are still used.
+		bool LoadMaterials(const char* objPath);
+		void Reset(void);
+
+		const void* GetVertexData(void) const				{ return m_vertexData; }
+		const void* GetIndexData(void) const				{ return m_indexData; }
+		uint32_t GetVertexCount(void) const					{ return m_vertexCount; }
+		uint32_t GetVertexStride(void) const				{ return m_vertexStride; }
+		MeshVertexFormat GetVertexFormat(void) const		{ return m_vertexFormat; }
+		const MeshDecodeConstants& GetDecode(void) const	{ return m_decode; }
+		uint32_t GetIndexCount(void) const					{ return m_indexCount; }
+		uint32_t GetIndexSize(void) const					{ return m_indexSize; }
+		uint64_t GetIndexFileBytes(void) const				{ return m_indexFileBytes; }	// 0 unless read from a cache
+		uint32_t GetLodCount(void) const					{ return m_lodCount; }
+		const MeshLod& GetLod(uint32_t lod) const			{ return m_lods[lod]; }
+		const MeshCluster* GetClusters(void) const			{ return m_clusterData; }
+		uint32_t GetClusterCount(void) const				{ return m_clusterCount; }
+		uint32_t GetSubmeshCount(void) const				{ return static_cast<uint32_t>(m_submeshes.size()); }
+		const MeshSubmesh& GetSubmesh(uint32_t submesh) const	{ return m_submeshes[submesh]; }
+		const MeshLod& GetSubmeshLod(uint32_t lod, uint32_t submesh) const	{ return m_submeshLods[lod * m_submeshes.size() + submesh]; }
+		const std::vector<std::string>& GetMaterialLibraries(void) const	{ return m_materialLibraries; }
+		const std::vector<MeshMaterial>& GetMaterials(void) const	{ return m_materials; }
+		const MeshBounds& GetBounds(void) const				{ return m_bounds; }
+		bool IsMapped(void) const							{ return m_file.IsOpen(); }
+
+	private:
+		DX::MappedFile				m_file;
+		std::vector<uint8_t>		m_ownedVertices;
+		std::vector<uint32_t>		m_ownedIndices;		// 16-bit indices are packed two per element
+		std::vector<MeshCluster>	m_ownedClusters;
+		std::vector<MeshSubmesh>	m_submeshes;
+		std::vector<MeshLod>		m_submeshLods;
+		std::vector<std::string>	m_materialLibraries;
+		std::vector<MeshMaterial>	m_materials;
+		const void*					m_vertexData;
+		const void*					m_indexData;
+		const MeshCluster*			m_clusterData;
+		uint32_t					m_vertexCount;
+		uint32_t					m_vertexStride;
+		MeshVertexFormat			m_vertexFormat;
+		MeshDecodeConstants			m_decode;
+		uint32_t					m_indexCount;
+		uint32_t					m_indexSize;
+		uint64_t					m_indexFileBytes;
+		uint32_t					m_lodCount;
+		MeshLod						m_lods[MESH_MAX_LODS];
+		uint32_t					m_clusterCount;
+		MeshBounds					m_bounds;
+	};
+
+	// Writes a mesh in its current vertex format. The file is written next to its
+	// final name first and renamed, so readers never see a partial cache.
+	bool WriteMeshCache(const char* path, const CachedMesh& mesh, uint64_t sourceHash, uint64_t sourceSize, MeshVertexFormat requestedFormat, uint32_t indexEncoding = MESH_INDEX_ENCODED);
+
+	struct MeshCacheStats
+	{
+		bool				cacheHit;
+		bool				cacheWritten;
+		double				hashSeconds;
+		double				loadSeconds;	// total, including hashing and any OBJ parse
+		ObjLoadStats		parse;			// parse, optimize, lods, clusters and packingError are only filled on a cache miss
+		bool				materialsLoaded;	// every material library was found and parsed
+		MeshOptimizeStats	optimize;
+		MeshLodStats		lods;
+		MeshClusterStats	clusters;
+		MeshPackingError	packingError;
+		size_t				arenaPeakBytes;		// most import temporaries alive at once
+		size_t				arenaReservedBytes;	// most memory the import arena held from the OS
+	};
+
+	// Loads an OBJ through its binary cache: the cache is used when it matches the OBJ's
+	// bytes, otherwise the OBJ is parsed, split into one submesh per group and material, optimized,
+	// given LODs and clusters and a fresh cache is written for the next run. Materials are then
+	// read from the OBJ's libraries either way. The OBJ may be gzip or zstd compressed; the cache
+	// is keyed on the compressed bytes.
+	// A packed format that cannot hold the mesh within the packing tolerances falls back to
+	// MESH_VERTEX_FLOAT; check outMesh.GetVertexFormat() for the format actually used.
+	bool LoadObjWithCache(const char* objPath, const char* cachePath, MeshVertexFormat format, CachedMesh& outMesh, MeshCacheStats* stats = nullptr);
+	// Maps the cache LoadObjWithCache wrote for an OBJ when it still matches the OBJ's bytes, and
+	// returns false on a miss without ever parsing the OBJ, so a mesh can be read back while
+	// drawing without risking a full import. Materials are not loaded.
+	bool OpenObjCache(const char* objPath, const char* cachePath, MeshVertexFormat format, CachedMesh& outMesh);
+}
@@ -0,0 +1,438 @@
+﻿#include "MeshClusters.h"
+#include "../Common/LinearArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace DX11UWA;
+using DX::ArenaVector;
+
+namespace
+{
+	// How much a candidate triangle's facing counts against it next to the number of new
+	// vertices it brings in; higher gives tighter normal cones and fuller vertex budgets less often.
+	const float kConeWeight = 1.0f;
+	// Below this spread of normals a cluster can never be entirely back-facing.
+	const float kMinConeDot = 0.1f;
+
+	const uint32_t kNoCluster = ~0u;
+
+	inline MeshFloat3 Subtract(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		MeshFloat3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return r;
+	}
+
+	inline float Dot(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline float Length(const MeshFloat3& v)
+	{
+		return sqrtf(Dot(v, v));
+	}
+
+	MeshFloat3 TriangleNormal(const MeshVertex* vertices, const uint32_t* corners)
+	{
+		MeshFloat3 e1 = Subtract(vertices[corners[1]].pos, vertices[corners[0]].pos);
+		MeshFloat3 e2 = Subtract(vertices[corners[2]].pos, vertices[corners[0]].pos);
+		MeshFloat3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+		float length = Length(n);
+		if (length > 0.0f)
+		{
+			n.x /= length;
+			n.y /= length;
+			n.z /= length;
+		}
+		return n;
+	}
+
+	// Ritter's sphere: start from the widest pair of axis extremes and grow to take in stragglers.
+	void ComputeBoundingSphere(const MeshVertex* vertices, const uint32_t* clusterVertices, size_t count, MeshFloat3& center, float& radius)
+	{
+		uint32_t extremes[6] = { clusterVertices[0], clusterVertices[0], clusterVertices[0], clusterVertices[0], clusterVertices[0], clusterVertices[0] };
+		for (size_t i = 1; i < count; ++i)
+		{
+			const MeshFloat3& p = vertices[clusterVertices[i]].pos;
+			if (p.x < vertices[extremes[0]].pos.x) extremes[0] = clusterVertices[i];
+			if (p.x > vertices[extremes[1]].pos.x) extremes[1] = clusterVertices[i];
+			if (p.y < vertices[extremes[2]].pos.y) extremes[2] = clusterVertices[i];
+			if (p.y > vertices[extremes[3]].pos.y) extremes[3] = clusterVertices[i];
+			if (p.z < vertices[extremes[4]].pos.z) extremes[4] = clusterVertices[i];
+			if (p.z > vertices[extremes[5]].pos.z) extremes[5] = clusterVertices[i];
+		}
+
+		int widest = 0;
+		float widestLength = -1.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float length = Length(Subtract(vertices[extremes[axis * 2 + 1]].pos, vertices[extremes[axis * 2]].pos));
+			if (length > widestLength)
+			{
+				widest = axis;
+				widestLength = length;
+			}
+		}
+
+		const MeshFloat3& a = vertices[extremes[widest * 2]].pos;
+		const MeshFloat3& b = vertices[extremes[widest * 2 + 1]].pos;
+		center.x = (a.x + b.x) * 0.5f;
+		center.y = (a.y + b.y) * 0.5f;
+		center.z = (a.z + b.z) * 0.5f;
+		radius = widestLength * 0.5f;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			MeshFloat3 offset = Subtract(vertices[clusterVertices[i]].pos, center);
+			float distance = Length(offset);
+			if (distance <= radius)
+				continue;
+			float grow = (distance - radius) * 0.5f;
+			float k = grow / distance;
+			center.x += offset.x * k;
+			center.y += offset.y * k;
+			center.z += offset.z * k;
+			radius += grow;
+		}
+	}
+
+	// Cone of triangle normals in the form the culling test uses: all of the cluster faces
+	// away from an eye for which dot(center - eye, axis) >= cutoff * |center - eye| + radius.
+	void ComputeNormalCone(const ArenaVector<MeshFloat3>& normals, MeshFloat3& axis, float& cutoff)
+	{
+		MeshFloat3 sum = { 0.0f, 0.0f, 0.0f };
+		for (const MeshFloat3& n : normals)
+		{
+			sum.x += n.x;
+			sum.y += n.y;
+			sum.z += n.z;
+		}
+
+		float length = Length(sum);
+		axis.x = axis.y = axis.z = 0.0f;
+		cutoff = 1.0f;
+		if (length <= 0.0f)
+			return;
+		axis.x = sum.x / length;
+		axis.y = sum.y / length;
+		axis.z = sum.z / length;
+
+		float minDot = 1.0f;
+		for (const MeshFloat3& n : normals)
+		{
+			if (Dot(n, n) > 0.0f)
+				minDot = std::min(minDot, Dot(n, axis));
+		}
+		if (minDot > kMinConeDot)
+			cutoff = sqrtf(1.0f - minDot * minDot);
+	}
+
+	// remap[v] is the lowest-numbered vertex at v's position, so triangles on either side of a
+	// uv or normal seam still count as neighbours.
+	void BuildPositionRemap(const MeshVertex* vertices, size_t vertexCount, ArenaVector<uint32_t>& remap)
+	{
+		ArenaVector<uint32_t> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			order[v] = static_cast<uint32_t>(v);
+		std::sort(order.begin(), order.end(), [vertices](uint32_t a, uint32_t b)
+		{
+			int c = memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(MeshFloat3));
+			return c < 0 || (c == 0 && a < b);
+		});
+
+		remap.resize(vertexCount);
+		for (size_t begin = 0; begin < vertexCount;)
+		{
+			size_t end = begin + 1;
+			while (end < vertexCount && memcmp(&vertices[order[begin]].pos, &vertices[order[end]].pos, sizeof(MeshFloat3)) == 0)
+				++end;
+			for (size_t i = begin; i < end; ++i)
+				remap[order[i]] = order[begin];
+			begin = end;
+		}
+	}
+
+	// Clusters one LOD's triangles, appending them to clusters and their indices to output.
+	void ClusterRange(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, const ArenaVector<uint32_t>& remap,
+		ArenaVector<uint32_t>& output, std::vector<MeshCluster>& clusters)
+	{
+		size_t triangleCount = indexCount / 3;
+
+		// Position to triangle lists.
+		ArenaVector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			++offsets[remap[indices[i]] + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			offsets[v + 1] += offsets[v];
+		ArenaVector<uint32_t> adjacency(indexCount);
+		{
+			ArenaVector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indexCount; ++i)
+				adjacency[fill[remap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		ArenaVector<MeshFloat3> triangleNormals(triangleCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+			triangleNormals[t] = TriangleNormal(vertices, &indices[t * 3]);
+
+		ArenaVector<uint8_t> emitted(triangleCount, 0);
+		ArenaVector<uint32_t> vertexCluster(vertexCount, kNoCluster);
+		ArenaVector<uint32_t> positionCluster(vertexCount, kNoCluster);
+		ArenaVector<uint32_t> clusterVertices;
+		ArenaVector<uint32_t> clusterPositions;
+		ArenaVector<MeshFloat3> clusterNormals;
+		size_t seed = 0;
+		size_t emittedCount = 0;
+
+		while (emittedCount < triangleCount)
+		{
+			uint32_t clusterId = static_cast<uint32_t>(clusters.size());
+			MeshCluster cluster;
+			memset(&cluster, 0, sizeof(cluster));
+			cluster.indexOffset = static_cast<uint32_t>(output.size());
+			clusterVertices.clear();
+			clusterPositions.clear();
+			clusterNormals.clear();
+			MeshFloat3 normalSum = { 0.0f, 0.0f, 0.0f };
+
+			// Seeds follow the incoming order, which is already cache-optimized.
+			while (emitted[seed])
+				++seed;
+			uint32_t next = static_cast<uint32_t>(seed);
+
+			while (next != kNoCluster)
+			{
+				const uint32_t* corners = &indices[next * 3];
+				for (int k = 0; k < 3; ++k)
+				{
+					if (vertexCluster[corners[k]] != clusterId)
+					{
+						vertexCluster[corners[k]] = clusterId;
+						clusterVertices.push_back(corners[k]);
+					}
+					if (positionCluster[remap[corners[k]]] != clusterId)
+					{
+						positionCluster[remap[corners[k]]] = clusterId;
+						clusterPositions.push_back(remap[corners[k]]);
+					}
+					output.push_back(corners[k]);
+				}
+				emitted[next] = 1;
+				++emittedCount;
+				++cluster.triangleCount;
+				const MeshFloat3& n = triangleNormals[next];
+				clusterNormals.push_back(n);
+				normalSum.x += n.x;
+				normalSum.y += n.y;
+				normalSum.z += n.z;
+
+				if (cluster.triangleCount == MESH_CLUSTER_MAX_TRIANGLES)
+					break;
+
+				// Grow through the cheapest triangle that shares a position with the cluster.
+				float sumLength = Length(normalSum);
+				MeshFloat3 facing = { 0.0f, 0.0f, 0.0f };
+				if (sumLength > 0.0f)
+				{
+					facing.x = normalSum.x / sumLength;
+					facing.y = normalSum.y / sumLength;
+					facing.z = normalSum.z / sumLength;
+				}
+
+				next = kNoCluster;
+				float bestScore = 0.0f;
+				for (uint32_t position : clusterPositions)
+				{
+					for (uint32_t i = offsets[position]; i < offsets[position + 1]; ++i)
+					{
+						uint32_t t = adjacency[i];
+						if (emitted[t])
+							continue;
+						const uint32_t* c = &indices[t * 3];
+						uint32_t newVertices = (vertexCluster[c[0]] != clusterId) + (vertexCluster[c[1]] != clusterId) + (vertexCluster[c[2]] != clusterId);
+						if (clusterVertices.size() + newVertices > MESH_CLUSTER_MAX_VERTICES)
+							continue;
+						float score = float(newVertices) + kConeWeight * (1.0f - Dot(triangleNormals[t], facing));
+						if (next == kNoCluster || score < bestScore || (score == bestScore && t < next))
+						{
+							next = t;
+							bestScore = score;
+						}
+					}
+				}
+			}
+
+			cluster.vertexCount = static_cast<uint32_t>(clusterVertices.size());
+			ComputeBoundingSphere(vertices, clusterVertices.data(), clusterVertices.size(), cluster.center, cluster.radius);
+			ComputeNormalCone(clusterNormals, cluster.coneAxis, cluster.coneCutoff);
+			clusters.push_back(cluster);
+		}
+	}
+}
+
+void DX11UWA::BuildMeshClusters(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, MeshLod* lods, uint32_t lodCount,
+	std::vector<MeshCluster>& clusters, MeshClusterStats* stats, MeshLod* submeshLods, uint32_t submeshCount)
+{
+	DX::LinearArena::Frame arenaFrame;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	clusters.clear();
+
+	ArenaVector<uint32_t> remap;
+	BuildPositionRemap(vertices.data(), vertices.size(), remap);
+
+	ArenaVector<uint32_t> output;
+	uint64_t triangles = 0;
+	uint64_t clusterVertices = 0;
+	auto clusterLod = [&](MeshLod& range)
+	{
+		range.clusterOffset = static_cast<uint32_t>(clusters.size());
+		range.clusterCount = 0;
+		if (range.indexCount == 0)
+			return;
+
+		output.clear();
+		output.reserve(range.indexCount);
+		size_t firstCluster = clusters.size();
+		ClusterRange(&indices[range.indexOffset], range.indexCount, vertices.data(), vertices.size(), remap, output, clusters);
+
+		// Cluster offsets were relative to the range while it was being built.
+		std::copy(output.begin(), output.end(), indices.begin() + range.indexOffset);
+		for (size_t c = firstCluster; c < clusters.size(); ++c)
+		{
+			clusters[c].indexOffset += range.indexOffset;
+			triangles += clusters[c].triangleCount;
+			clusterVertices += clusters[c].vertexCount;
+		}
+		range.clusterOffset = static_cast<uint32_t>(firstCluster);
+		range.clusterCount = static_cast<uint32_t>(clusters.size() - firstCluster);
+	};
+
+	for (uint32_t i = 0; i < lodCount; ++i)
+	{
+		MeshLod& lod = lods[i];
+		if (!submeshLods || submeshCount == 0)
+		{
+			clusterLod(lod);
+			continue;
+		}
+
+		// Submeshes tile the LOD in order, so their clusters together are the LOD's clusters.
+		lod.clusterOffset = static_cast<uint32_t>(clusters.size());
+		for (uint32_t s = 0; s < submeshCount; ++s)
+			clusterLod(submeshLods[i * submeshCount + s]);
+		lod.clusterCount = static_cast<uint32_t>(clusters.size()) - lod.clusterOffset;
+	}
+
+	if (stats)
+	{
+		stats->clusterCount = static_cast<uint32_t>(clusters.size());
+		stats->averageTriangles = clusters.empty() ? 0.0f : float(double(triangles) / clusters.size());
+		stats->averageVertices = clusters.empty() ? 0.0f : float(double(clusterVertices) / clusters.size());
+		stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+}
+
+bool DX11UWA::MeshBoundsVisible(const MeshClusterView& view, const MeshBounds& bounds)
+{
+	// The box corner furthest along each plane's normal decides whether it is all outside.
+	for (int p = 0; p < 6; ++p)
+	{
+		const float* plane = view.planes[p];
+		float x = plane[0] >= 0.0f ? bounds.max.x : bounds.min.x;
+		float y = plane[1] >= 0.0f ? bounds.max.y : bounds.min.y;
+		float z = plane[2] >= 0.0f ? bounds.max.z : bounds.min.z;
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+MeshClusterView DX11UWA::ComputeMeshClusterView(const float m[16], const MeshFloat3& eye)
+{
+	// Gribb-Hartmann: with row vectors, clip = p * m, so each plane is a sum or difference of
+	// the matrix columns. Depth runs from 0 to 1, so the near plane is column 2 alone.
+	const int columns[6][2] = { { 3, 0 }, { 3, 0 }, { 3, 1 }, { 3, 1 }, { 2, -1 }, { 3, 2 } };
+	const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, -1.0f };
+
+	MeshClusterView view;
+	for (int p = 0; p < 6; ++p)
+	{
+		float* plane = view.planes[p];
+		for (int r = 0; r < 4; ++r)
+		{
+			plane[r] = m[r * 4 + columns[p][0]];
+			if (columns[p][1] >= 0)
+				plane[r] += signs[p] * m[r * 4 + columns[p][1]];
+		}
+
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (int r = 0; r < 4; ++r)
+				plane[r] /= length;
+		}
+	}
+	view.eye = eye;
+	return view;
+}
+
+size_t DX11UWA::CullMeshClusters(const MeshCluster* clusters, size_t clusterCount, const MeshClusterView& view, MeshDrawRange* outRanges,
+	MeshClusterCullStats* stats)
+{
+	size_t rangeCount = 0;
+	uint32_t frustumCulled = 0;
+	uint32_t backfaceCulled = 0;
+	uint32_t triangleCount = 0;
+	uint32_t trianglesDrawn = 0;
+
+	for (size_t i = 0; i < clusterCount; ++i)
+	{
+		const MeshCluster& cluster = clusters[i];
+		triangleCount += cluster.triangleCount;
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p)
+		{
+			const float* plane = view.planes[p];
+			inside = plane[0] * cluster.center.x + plane[1] * cluster.center.y + plane[2] * cluster.center.z + plane[3] >= -cluster.radius;
+		}
+		if (!inside)
+		{
+			++frustumCulled;
+			continue;
+		}
+
+		MeshFloat3 toCluster = Subtract(cluster.center, view.eye);
+		if (Dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * Length(toCluster) + cluster.radius)
+		{
+			++backfaceCulled;
+			continue;
+		}
+
+		uint32_t indexCount = cluster.triangleCount * 3;
+		trianglesDrawn += cluster.triangleCount;
+		if (rangeCount > 0 && outRanges[rangeCount - 1].indexOffset + outRanges[rangeCount - 1].indexCount == cluster.indexOffset)
+		{
+			outRanges[rangeCount - 1].indexCount += indexCount;
+		}
+		else
+		{
+			outRanges[rangeCount].indexOffset = cluster.indexOffset;
+			outRanges[rangeCount].indexCount = indexCount;
+			++rangeCount;
+		}
+	}
+
+	if (stats)
+	{
+		stats->clusterCount += static_cast<uint32_t>(clusterCount);
+		stats->frustumCulled += frustumCulled;
+		stats->backfaceCulled += backfaceCulled;
+		stats->triangleCount += triangleCount;
+		stats->trianglesDrawn += trianglesDrawn;
+	}
+	return rangeCount;
+}
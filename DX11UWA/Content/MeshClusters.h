@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+#include "MeshSimplifier.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace DX11UWA
+{
+	const uint32_t MESH_CLUSTER_MAX_VERTICES = 64;
+	const uint32_t MESH_CLUSTER_MAX_TRIANGLES = 124;
+
+	// A run of up to MESH_CLUSTER_MAX_TRIANGLES contiguous triangles touching at most
+	// MESH_CLUSTER_MAX_VERTICES vertices, with bounds for culling it as a whole.
+	struct MeshCluster
+	{
+		uint32_t	indexOffset;	// into the mesh's index array
+		uint32_t	triangleCount;
+		uint32_t	vertexCount;
+		MeshFloat3	center;			// bounding sphere
+		float		radius;
+		MeshFloat3	coneAxis;		// average facing of the triangles
+		float		coneCutoff;		// 1 when the normals spread too far to ever cull by facing
+	};
+
+	struct MeshClusterStats
+	{
+		uint32_t	clusterCount;
+		float		averageTriangles;	// per cluster
+		float		averageVertices;
+		double		seconds;
+	};
+
+	// Splits every LOD of a mesh into clusters, growing each from a seed through triangles that
+	// share its vertices and face its way. Rewrites each LOD's index range in cluster order,
+	// replaces clusters and sets every LOD's cluster range. With submeshLods, laid out as
+	// BuildMeshLods leaves them, no cluster crosses a submesh and each submesh range gets its own
+	// cluster range too.
+	void BuildMeshClusters(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, MeshLod* lods, uint32_t lodCount,
+		std::vector<MeshCluster>& clusters, MeshClusterStats* stats = nullptr, MeshLod* submeshLods = nullptr, uint32_t submeshCount = 0);
+
+	// One viewpoint expressed in a mesh's own space.
+	struct MeshClusterView
+	{
+		float		planes[6][4];	// normalized; a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+		MeshFloat3	eye;
+	};
+
+	// Builds a view from a row-major world * view * projection matrix in the Direct3D
+	// convention (row vectors, clip depth 0 to 1) and the eye position in mesh space.
+	MeshClusterView ComputeMeshClusterView(const float worldViewProjection[16], const MeshFloat3& eye);
+
+	// Whether any part of a box in mesh space can be inside the view's frustum.
+	bool MeshBoundsVisible(const MeshClusterView& view, const MeshBounds& bounds);
+
+	struct MeshDrawRange
+	{
+		uint32_t	indexOffset;
+		uint32_t	indexCount;
+	};
+
+	struct MeshClusterCullStats
+	{
+		uint32_t	clusterCount;
+		uint32_t	frustumCulled;
+		uint32_t	backfaceCulled;
+		uint32_t	triangleCount;
+		uint32_t	trianglesDrawn;
+	};
+
+	// Drops clusters outside the frustum or facing entirely away from the eye and merges the
+	// survivors into as few index ranges as possible. outRanges needs room for (clusterCount + 1) / 2
+	// ranges, which is the worst case. Returns the number of ranges. stats accumulates.
+	size_t CullMeshClusters(const MeshCluster* clusters, size_t clusterCount, const MeshClusterView& view, MeshDrawRange* outRanges,
+		MeshClusterCullStats* stats = nullptr);
+}
@@ -0,0 +1,563 @@
+﻿#include "MeshOptimizer.h"
+#include "../Common/LinearArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+using namespace DX11UWA;
+using DX::ArenaVector;
+
+namespace
+{
+	// Forsyth scoring parameters. The cache modelled while ordering is deliberately larger
+	// than the one used for analysis so the ordering does not overfit one FIFO size.
+	const unsigned int kScoreCacheSize = 32;
+	const unsigned int kMaxValence = 32;
+	const float kCacheDecayPower = 1.5f;
+	const float kLastTriangleScore = 0.75f;
+	const float kValenceBoostScale = 2.0f;
+	const float kValenceBoostPower = 0.5f;
+
+	const size_t kFetchLineSize = 64;
+	const unsigned int kFetchCacheLines = 64;
+
+	struct ScoreTables
+	{
+		float cache[kScoreCacheSize];
+		float valence[kMaxValence + 1];
+
+		ScoreTables(void)
+		{
+			for (unsigned int i = 0; i < kScoreCacheSize; ++i)
+			{
+				if (i < 3)
+					cache[i] = kLastTriangleScore;
+				else
+					cache[i] = powf(1.0f - float(i - 3) / float(kScoreCacheSize - 3), kCacheDecayPower);
+			}
+			valence[0] = 0.0f;
+			for (unsigned int i = 1; i <= kMaxValence; ++i)
+				valence[i] = kValenceBoostScale * powf(float(i), -kValenceBoostPower);
+		}
+	};
+
+	inline float ScoreVertex(const ScoreTables& tables, int cachePosition, uint32_t liveTriangles)
+	{
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		return score + tables.valence[liveTriangles < kMaxValence ? liveTriangles : kMaxValence];
+	}
+
+	// FIFO post-transform cache. A vertex is resident while fewer than cacheSize misses
+	// have happened since it was last loaded; Reset invalidates everything in O(1).
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, unsigned int cacheSize) : m_loadTime(vertexCount, 0), m_time(cacheSize + 1), m_size(cacheSize) {}
+
+		bool Touch(uint32_t vertex)
+		{
+			if (m_time - m_loadTime[vertex] < m_size)
+				return true;
+			m_loadTime[vertex] = m_time++;
+			return false;
+		}
+
+		unsigned int TouchTriangle(const uint32_t* corners)
+		{
+			return !Touch(corners[0]) + !Touch(corners[1]) + !Touch(corners[2]);
+		}
+
+		void Reset(void) { m_time += m_size + 1; }
+
+	private:
+		ArenaVector<uint32_t>	m_loadTime;
+		uint32_t				m_time;
+		uint32_t				m_size;
+	};
+
+	struct ClusterKey
+	{
+		uint32_t	start;
+		uint32_t	end;
+		float		sortKey;
+	};
+
+	struct Accumulator
+	{
+		double centroid[3];
+		double normal[3];
+		double area;
+
+		void Add(const MeshFloat3& a, const MeshFloat3& b, const MeshFloat3& c)
+		{
+			double e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+			double e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+			double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			double triangleArea = 0.5 * sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			centroid[0] += (a.x + b.x + c.x) / 3.0 * triangleArea;
+			centroid[1] += (a.y + b.y + c.y) / 3.0 * triangleArea;
+			centroid[2] += (a.z + b.z + c.z) / 3.0 * triangleArea;
+			normal[0] += n[0];
+			normal[1] += n[1];
+			normal[2] += n[2];
+			area += triangleArea;
+		}
+	};
+	// Splits each hard run further once its own ACMR, simulated from a cold cache,
+	// drops to acmrLimit.
+	void BuildClusters(const uint32_t* indices, const ArenaVector<uint32_t>& hardStarts, float acmrLimit, FifoCache& cache, ArenaVector<ClusterKey>& clusters)
+	{
+		clusters.clear();
+		for (size_t h = 0; h + 1 < hardStarts.size(); ++h)
+		{
+			uint32_t start = hardStarts[h];
+			uint32_t end = hardStarts[h + 1];
+			cache.Reset();
+			size_t clusterMisses = 0;
+			for (uint32_t t = start; t < end; ++t)
+			{
+				clusterMisses += cache.TouchTriangle(indices + t * 3);
+				if (t + 1 < end && float(clusterMisses) <= acmrLimit * float(t + 1 - start))
+				{
+					ClusterKey cluster = { start, t + 1, 0.0f };
+					clusters.push_back(cluster);
+					start = t + 1;
+					clusterMisses = 0;
+					cache.Reset();
+				}
+			}
+			ClusterKey cluster = { start, end, 0.0f };
+			clusters.push_back(cluster);
+		}
+	}
+
+	// Orders clusters by how far they face away from the mesh centre; those tend to occlude the rest.
+	void SortClusters(const uint32_t* indices, const MeshVertex* vertices, const MeshFloat3& meshCentroid, ArenaVector<ClusterKey>& clusters)
+	{
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			Accumulator a = {};
+			for (uint32_t t = clusters[c].start; t < clusters[c].end; ++t)
+			{
+				const uint32_t* corners = indices + t * 3;
+				a.Add(vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos);
+			}
+
+			double length = sqrt(a.normal[0] * a.normal[0] + a.normal[1] * a.normal[1] + a.normal[2] * a.normal[2]);
+			if (a.area <= 0.0 || length <= 0.0)
+			{
+				clusters[c].sortKey = 0.0f;
+				continue;
+			}
+
+			double key = (a.centroid[0] / a.area - meshCentroid.x) * a.normal[0] +
+				(a.centroid[1] / a.area - meshCentroid.y) * a.normal[1] +
+				(a.centroid[2] / a.area - meshCentroid.z) * a.normal[2];
+			clusters[c].sortKey = float(key / length);
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterKey& a, const ClusterKey& b)
+		{
+			return a.sortKey > b.sortKey;
+		});
+	}
+}
+
+VertexCacheStats DX11UWA::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride, unsigned int cacheSize)
+{
+	VertexCacheStats stats = { 0.0f, 0.0f, 0.0f };
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	ArenaVector<bool> referenced(vertexCount, false);
+	size_t lineCount = (vertexCount * vertexStride + kFetchLineSize - 1) / kFetchLineSize;
+	FifoCache lines(lineCount, kFetchCacheLines);
+
+	size_t misses = 0;
+	size_t uniqueVertices = 0;
+	size_t fetchedLines = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t vertex = indices[i];
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			++uniqueVertices;
+		}
+		if (cache.Touch(vertex))
+			continue;
+
+		// Only vertices that miss the post-transform cache are fetched from memory.
+		++misses;
+		size_t firstLine = vertex * vertexStride / kFetchLineSize;
+		size_t lastLine = ((vertex + 1) * vertexStride - 1) / kFetchLineSize;
+		for (size_t line = firstLine; line <= lastLine; ++line)
+			fetchedLines += !lines.Touch(static_cast<uint32_t>(line));
+	}
+
+	stats.acmr = float(misses) / float(indexCount / 3);
+	stats.atvr = float(misses) / float(uniqueVertices);
+	stats.overfetch = float(fetchedLines * kFetchLineSize) / float(uniqueVertices * vertexStride);
+	return stats;
+}
+
+OverdrawStats DX11UWA::AnalyzeOverdraw(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, unsigned int resolution)
+{
+	OverdrawStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if (indexCount < 3 || vertexCount == 0 || resolution == 0)
+		return stats;
+
+	MeshBounds bounds = ComputeMeshBounds(vertices, vertexCount);
+	const float boundsMin[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+	const float boundsMax[3] = { bounds.max.x, bounds.max.y, bounds.max.z };
+	ArenaVector<float> depth(size_t(resolution) * resolution);
+
+	uint32_t coveredViews = 0;
+	for (unsigned int view = 0; view < MESH_ANALYZE_OVERDRAW_VIEWS; ++view)
+	{
+		// Looking along an axis, the other two span the image with square pixels.
+		const unsigned int axis = view / 2;
+		const float direction = (view & 1) ? -1.0f : 1.0f;
+		const unsigned int uAxis = (axis + 1) % 3;
+		const unsigned int vAxis = (axis + 2) % 3;
+		float extent = std::max(boundsMax[uAxis] - boundsMin[uAxis], boundsMax[vAxis] - boundsMin[vAxis]);
+		float scale = extent > 0.0f ? float(resolution) / extent : 0.0f;
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+		uint64_t shaded = 0;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			float x[3], y[3], z[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float* position = &vertices[indices[i + c]].pos.x;
+				x[c] = (position[uAxis] - boundsMin[uAxis]) * scale;
+				y[c] = (position[vAxis] - boundsMin[vAxis]) * scale;
+				z[c] = position[axis] * direction;
+			}
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area == 0.0f)
+				continue;
+			float sign = area > 0.0f ? 1.0f : -1.0f;
+			float inverseArea = 1.0f / fabsf(area);
+
+			int minX = std::max(0, int(floorf(std::min(std::min(x[0], x[1]), x[2]))));
+			int maxX = std::min(int(resolution) - 1, int(ceilf(std::max(std::max(x[0], x[1]), x[2]))));
+			int minY = std::max(0, int(floorf(std::min(std::min(y[0], y[1]), y[2]))));
+			int maxY = std::min(int(resolution) - 1, int(ceilf(std::max(std::max(y[0], y[1]), y[2]))));
+			for (int py = minY; py <= maxY; ++py)
+			{
+				float sy = py + 0.5f;
+				for (int px = minX; px <= maxX; ++px)
+				{
+					// Edge functions, each the weight of the opposite corner, at the pixel centre.
+					float sx = px + 0.5f;
+					float w0 = sign * ((x[2] - x[1]) * (sy - y[1]) - (y[2] - y[1]) * (sx - x[1]));
+					float w1 = sign * ((x[0] - x[2]) * (sy - y[2]) - (y[0] - y[2]) * (sx - x[2]));
+					float w2 = sign * ((x[1] - x[0]) * (sy - y[0]) - (y[1] - y[0]) * (sx - x[0]));
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					float fragmentDepth = (w0 * z[0] + w1 * z[1] + w2 * z[2]) * inverseArea;
+					float& stored = depth[size_t(py) * resolution + px];
+					if (fragmentDepth < stored)
+					{
+						stored = fragmentDepth;
+						++shaded;
+					}
+				}
+			}
+		}
+
+		size_t covered = 0;
+		for (float value : depth)
+			covered += value != FLT_MAX;
+		if (covered)
+		{
+			stats.views[view] = float(double(shaded) / double(covered));
+			stats.average += stats.views[view];
+			++coveredViews;
+		}
+	}
+	if (coveredViews)
+		stats.average /= float(coveredViews);
+	return stats;
+}
+
+DegenerateStats DX11UWA::CountDegenerateTriangles(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices)
+{
+	DegenerateStats stats = { 0, 0 };
+	if (indexCount < 3)
+		return stats;
+
+	// Areas are compared against the bounds so that the test does not depend on the mesh's units.
+	uint32_t highest = *std::max_element(indices, indices + indexCount);
+	MeshBounds bounds = ComputeMeshBounds(vertices, size_t(highest) + 1);
+	double dx = bounds.max.x - bounds.min.x, dy = bounds.max.y - bounds.min.y, dz = bounds.max.z - bounds.min.z;
+	double areaLimit = (dx * dx + dy * dy + dz * dz) * 1e-12;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (a == b || b == c || c == a)
+		{
+			++stats.repeatedIndex;
+			continue;
+		}
+
+		const MeshFloat3& p0 = vertices[a].pos;
+		const MeshFloat3& p1 = vertices[b].pos;
+		const MeshFloat3& p2 = vertices[c].pos;
+		double e1[3] = { double(p1.x) - p0.x, double(p1.y) - p0.y, double(p1.z) - p0.z };
+		double e2[3] = { double(p2.x) - p0.x, double(p2.y) - p0.y, double(p2.z) - p0.z };
+		double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		if (0.5 * sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) <= areaLimit)
+			++stats.zeroArea;
+	}
+	return stats;
+}
+
+void DX11UWA::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	DX::LinearArena::Frame arenaFrame;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	static const ScoreTables tables;
+
+	// Vertex -> live triangle adjacency. Each vertex's live triangles are kept at the front
+	// of its range so emitting a triangle is a swap-remove.
+	ArenaVector<uint32_t> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		++liveCount[indices[i]];
+
+	ArenaVector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+
+	ArenaVector<uint32_t> adjacency(triangleCount * 3);
+	ArenaVector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+	}
+
+	ArenaVector<int> cachePosition(vertexCount, -1);
+	ArenaVector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = ScoreVertex(tables, -1, liveCount[v]);
+
+	ArenaVector<float> triangleScore(triangleCount);
+	ArenaVector<bool> emitted(triangleCount, false);
+	size_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* corners = indices + t * 3;
+		triangleScore[t] = vertexScore[corners[0]] + vertexScore[corners[1]] + vertexScore[corners[2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
+
+	ArenaVector<uint32_t> output(triangleCount * 3);
+	uint32_t cache[kScoreCacheSize + 3];
+	uint32_t newCache[kScoreCacheSize + 3];
+	unsigned int cacheCount = 0;
+	size_t scanCursor = 0;
+
+	for (size_t outTriangle = 0; outTriangle < triangleCount; ++outTriangle)
+	{
+		if (bestTriangle == SIZE_MAX)
+		{
+			// Nothing in the cache has live triangles left; continue with the next unemitted one.
+			while (emitted[scanCursor])
+				++scanCursor;
+			bestTriangle = scanCursor;
+		}
+
+		const uint32_t* corners = indices + bestTriangle * 3;
+		emitted[bestTriangle] = true;
+		unsigned int newCount = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32_t vertex = corners[k];
+			output[outTriangle * 3 + k] = vertex;
+
+			uint32_t* live = &adjacency[adjacencyOffset[vertex]];
+			uint32_t* liveEnd = live + liveCount[vertex];
+			uint32_t* found = std::find(live, liveEnd, static_cast<uint32_t>(bestTriangle));
+			std::swap(*found, *(liveEnd - 1));
+			--liveCount[vertex];
+
+			if (std::find(newCache, newCache + newCount, vertex) == newCache + newCount)
+				newCache[newCount++] = vertex;
+		}
+
+		uint32_t* triangleEnd = newCache + newCount;
+		for (unsigned int i = 0; i < cacheCount; ++i)
+		{
+			if (std::find(newCache, triangleEnd, cache[i]) == triangleEnd)
+				newCache[newCount++] = cache[i];
+		}
+
+		// Rescore everything whose cache position changed, including vertices pushed out.
+		for (unsigned int i = 0; i < newCount; ++i)
+		{
+			uint32_t vertex = newCache[i];
+			cachePosition[vertex] = i < kScoreCacheSize ? int(i) : -1;
+			float score = ScoreVertex(tables, cachePosition[vertex], liveCount[vertex]);
+			float delta = score - vertexScore[vertex];
+			vertexScore[vertex] = score;
+
+			const uint32_t* live = &adjacency[adjacencyOffset[vertex]];
+			for (uint32_t j = 0; j < liveCount[vertex]; ++j)
+				triangleScore[live[j]] += delta;
+		}
+
+		cacheCount = newCount < kScoreCacheSize ? newCount : kScoreCacheSize;
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		bestTriangle = SIZE_MAX;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cacheCount; ++i)
+		{
+			uint32_t vertex = cache[i];
+			const uint32_t* live = &adjacency[adjacencyOffset[vertex]];
+			for (uint32_t j = 0; j < liveCount[vertex]; ++j)
+			{
+				if (triangleScore[live[j]] > bestScore)
+				{
+					bestScore = triangleScore[live[j]];
+					bestTriangle = live[j];
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t DX11UWA::OptimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold)
+{
+	DX::LinearArena::Frame arenaFrame;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return 0;
+
+	// Hard boundaries: triangles that miss on all three corners start from a cold cache anyway,
+	// so moving the run that starts there costs next to nothing.
+	FifoCache cache(vertexCount, MESH_ANALYZE_CACHE_SIZE);
+	ArenaVector<uint32_t> hardStarts;
+	size_t totalMisses = 0;
+	Accumulator mesh = {};
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* corners = indices + t * 3;
+		unsigned int misses = cache.TouchTriangle(corners);
+		totalMisses += misses;
+		if (t == 0 || misses == 3)
+			hardStarts.push_back(static_cast<uint32_t>(t));
+		mesh.Add(vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos);
+	}
+	hardStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+	MeshFloat3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	if (mesh.area > 0.0)
+	{
+		meshCentroid.x = float(mesh.centroid[0] / mesh.area);
+		meshCentroid.y = float(mesh.centroid[1] / mesh.area);
+		meshCentroid.z = float(mesh.centroid[2] / mesh.area);
+	}
+
+	// Every soft split restarts a cold cache, so back the split limit off until the sorted
+	// order stays within threshold of the input ACMR. A limit of 0 leaves only hard boundaries.
+	float targetMisses = threshold * float(totalMisses);
+	float acmrLimit = targetMisses / float(triangleCount);
+	ArenaVector<ClusterKey> clusters;
+	ArenaVector<uint32_t> output(triangleCount * 3);
+	for (;;)
+	{
+		BuildClusters(indices, hardStarts, acmrLimit, cache, clusters);
+		SortClusters(indices, vertices, meshCentroid, clusters);
+
+		uint32_t* write = output.data();
+		for (size_t c = 0; c < clusters.size(); ++c)
+			write = std::copy(indices + clusters[c].start * 3, indices + clusters[c].end * 3, write);
+
+		cache.Reset();
+		size_t misses = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+			misses += cache.TouchTriangle(&output[t * 3]);
+
+		if (acmrLimit == 0.0f || float(misses) <= targetMisses)
+			break;
+		acmrLimit = acmrLimit > 0.5f ? acmrLimit * 0.95f : 0.0f;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+	return clusters.size();
+}
+
+size_t DX11UWA::OptimizeVertexFetch(MeshVertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	DX::LinearArena::Frame arenaFrame;
+	const uint32_t unused = ~0u;
+	ArenaVector<uint32_t> remap(vertexCount, unused);
+	uint32_t nextVertex = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t& slot = remap[indices[i]];
+		if (slot == unused)
+			slot = nextVertex++;
+		indices[i] = slot;
+	}
+
+	ArenaVector<MeshVertex> source(vertices, vertices + vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] != unused)
+			vertices[remap[v]] = source[v];
+	}
+	return nextVertex;
+}
+
+void DX11UWA::OptimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, MeshOptimizeStats* stats,
+	const std::vector<uint32_t>* partOffsets)
+{
+	DX::LinearArena::Frame arenaFrame;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	MeshOptimizeStats localStats = {};
+
+	std::vector<uint32_t> wholeMesh(1, 0);
+	const std::vector<uint32_t>& parts = partOffsets && !partOffsets->empty() ? *partOffsets : wholeMesh;
+	auto partEnd = [&](size_t part) { return part + 1 < parts.size() ? parts[part + 1] : indices.size(); };
+
+	localStats.input = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), sizeof(MeshVertex));
+
+	for (size_t part = 0; part < parts.size(); ++part)
+		OptimizeVertexCache(indices.data() + parts[part], partEnd(part) - parts[part], vertices.size());
+	localStats.afterCache = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), sizeof(MeshVertex));
+
+	for (size_t part = 0; part < parts.size(); ++part)
+		localStats.clusterCount += static_cast<uint32_t>(OptimizeOverdraw(indices.data() + parts[part], partEnd(part) - parts[part], vertices.data(), vertices.size()));
+	localStats.afterOverdraw = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), sizeof(MeshVertex));
+
+	vertices.resize(OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.size()));
+	localStats.afterFetch = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), sizeof(MeshVertex));
+
+	localStats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	if (stats)
+		*stats = localStats;
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace DX11UWA
+{
+	// FIFO size used when measuring post-transform cache efficiency. It is a conservative
+	// stand-in for the real hardware cache, which varies by GPU and vertex output size.
+	const unsigned int MESH_ANALYZE_CACHE_SIZE = 16;
+
+	struct VertexCacheStats
+	{
+		float	acmr;		// transformed vertices per triangle (3 is worst, ~0.5 is ideal)
+		float	atvr;		// transformed vertices per unique vertex (1 is ideal)
+		float	overfetch;	// bytes pulled through 64-byte lines per byte of vertex data (1 is ideal)
+	};
+
+	struct MeshOptimizeStats
+	{
+		VertexCacheStats	input;
+		VertexCacheStats	afterCache;
+		VertexCacheStats	afterOverdraw;
+		VertexCacheStats	afterFetch;
+		uint32_t			clusterCount;	// clusters the overdraw pass sorted
+		double				seconds;
+	};
+
+	// Simulates a FIFO post-transform cache and 64-byte vertex fetch lines over a triangle list.
+	VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride, unsigned int cacheSize = MESH_ANALYZE_CACHE_SIZE);
+
+	// Image size and number of viewpoints AnalyzeOverdraw uses.
+	const unsigned int MESH_ANALYZE_OVERDRAW_RESOLUTION = 256;
+	const unsigned int MESH_ANALYZE_OVERDRAW_VIEWS = 6;
+
+	struct OverdrawStats
+	{
+		float	views[MESH_ANALYZE_OVERDRAW_VIEWS];	// pixels shaded per pixel covered, looking along +X, -X, +Y, -Y, +Z, -Z
+		float	average;							// over the views that cover any pixel (1 is ideal)
+	};
+
+	// Estimates overdraw by rasterizing a triangle list in order, orthographically from each side
+	// of its bounds, with a depth test that keeps the nearest fragment. Both faces are drawn, since
+	// the winding a mesh is culled with depends on the renderer.
+	OverdrawStats AnalyzeOverdraw(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+		unsigned int resolution = MESH_ANALYZE_OVERDRAW_RESOLUTION);
+
+	struct DegenerateStats
+	{
+		uint32_t	repeatedIndex;	// two corners reference the same vertex
+		uint32_t	zeroArea;		// distinct vertices whose positions enclose no area
+	};
+
+	// Counts triangles that can never cover a pixel.
+	DegenerateStats CountDegenerateTriangles(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices);
+
+	// Reorders triangles for post-transform cache reuse (Forsyth's linear-speed algorithm).
+	void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Splits a cache-optimized triangle list into clusters and sorts them so outward-facing
+	// clusters draw first. threshold bounds the ACMR a cluster may lose to get split (1.05 = 5%).
+	// Returns the number of clusters.
+	size_t OptimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+	// Renumbers vertices in the order the index buffer first references them and drops
+	// unreferenced ones. Returns the new vertex count.
+	size_t OptimizeVertexFetch(MeshVertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Runs the three passes above in order on an indexed triangle mesh. partOffsets, when given,
+	// lists the index offsets at which parts of the mesh start, in order; the cache and overdraw
+	// passes run on each part alone so no triangle moves from one part to another.
+	void OptimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, MeshOptimizeStats* stats = nullptr,
+		const std::vector<uint32_t>* partOffsets = nullptr);
+}
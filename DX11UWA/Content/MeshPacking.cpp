@@ -0,0 +1,311 @@
+﻿#include "MeshPacking.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace DX11UWA;
+
+namespace
+{
+	inline uint16_t QuantizeUnorm16(float value, float offset, float scale)
+	{
+		float normalized = (value - offset) / scale;
+		normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+		return static_cast<uint16_t>(normalized * 65535.0f + 0.5f);
+	}
+
+	inline int16_t QuantizeSnorm16(float value)
+	{
+		value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		return static_cast<int16_t>(floorf(value * 32767.0f + 0.5f));
+	}
+
+	// D3D converts SNORM -32768 and -32767 both to -1.
+	inline float DecodeSnorm16(int16_t value)
+	{
+		float decoded = value / 32767.0f;
+		return decoded < -1.0f ? -1.0f : decoded;
+	}
+
+	inline float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	void EncodeOctahedral(const MeshFloat3& normal, int16_t out[2])
+	{
+		float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		if (l1 <= 0.0f)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+
+		float u = normal.x / l1;
+		float v = normal.y / l1;
+		if (normal.z < 0.0f)
+		{
+			float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+			float foldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+			u = foldedU;
+			v = foldedV;
+		}
+		out[0] = QuantizeSnorm16(u);
+		out[1] = QuantizeSnorm16(v);
+	}
+
+	MeshFloat3 DecodeOctahedral(const int16_t in[2])
+	{
+		MeshFloat3 n = { DecodeSnorm16(in[0]), DecodeSnorm16(in[1]), 0.0f };
+		n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+		float t = n.z < 0.0f ? -n.z : 0.0f;
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		n.x /= length;
+		n.y /= length;
+		n.z /= length;
+		return n;
+	}
+
+	inline float Distance(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+
+	inline float Length(const MeshFloat3& v)
+	{
+		return sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+}
+
+uint32_t DX11UWA::GetMeshVertexStride(MeshVertexFormat format)
+{
+	return format == MESH_VERTEX_FLOAT ? sizeof(MeshVertex) : sizeof(MeshPackedVertex);
+}
+
+void DX11UWA::GetMeshVertexAttributes(MeshVertexFormat format, MeshAttribute outAttributes[MESH_VERTEX_ATTRIBUTE_COUNT])
+{
+	if (format == MESH_VERTEX_FLOAT)
+	{
+		const MeshAttribute layout[MESH_VERTEX_ATTRIBUTE_COUNT] =
+		{
+			{ MESH_SEMANTIC_POSITION, MESH_FORMAT_FLOAT3, offsetof(MeshVertex, pos) },
+			{ MESH_SEMANTIC_UV, MESH_FORMAT_FLOAT3, offsetof(MeshVertex, uv) },
+			{ MESH_SEMANTIC_NORMAL, MESH_FORMAT_FLOAT3, offsetof(MeshVertex, normal) },
+		};
+		memcpy(outAttributes, layout, sizeof(layout));
+		return;
+	}
+
+	const MeshAttribute layout[MESH_VERTEX_ATTRIBUTE_COUNT] =
+	{
+		{ MESH_SEMANTIC_POSITION, uint16_t(format == MESH_VERTEX_HALF ? MESH_FORMAT_HALF4 : MESH_FORMAT_UNORM16X4), offsetof(MeshPackedVertex, position) },
+		{ MESH_SEMANTIC_UV, MESH_FORMAT_UNORM16X2, offsetof(MeshPackedVertex, uv) },
+		{ MESH_SEMANTIC_NORMAL, MESH_FORMAT_SNORM16X2, offsetof(MeshPackedVertex, normal) },
+	};
+	memcpy(outAttributes, layout, sizeof(layout));
+}
+
+MeshDecodeConstants DX11UWA::ComputeMeshDecodeConstants(MeshVertexFormat format, const MeshVertex* vertices, size_t count)
+{
+	MeshDecodeConstants decode = { { 1.0f, 1.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 0.0f } };
+	if (format == MESH_VERTEX_FLOAT)
+		return decode;
+
+	decode.positionScale[3] = 1.0f;
+	if (count == 0)
+		return decode;
+
+	if (format == MESH_VERTEX_QUANTIZED)
+	{
+		MeshBounds bounds = ComputeMeshBounds(vertices, count);
+		float extent[3] = { bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+		float minimum[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+		for (int k = 0; k < 3; ++k)
+		{
+			decode.positionScale[k] = extent[k] > 0.0f ? extent[k] : 1.0f;
+			decode.positionOffset[k] = minimum[k];
+		}
+	}
+
+	float uvMin[2] = { vertices[0].uv.x, vertices[0].uv.y };
+	float uvMax[2] = { uvMin[0], uvMin[1] };
+	for (size_t i = 1; i < count; ++i)
+	{
+		const MeshFloat3& uv = vertices[i].uv;
+		uvMin[0] = uv.x < uvMin[0] ? uv.x : uvMin[0];
+		uvMin[1] = uv.y < uvMin[1] ? uv.y : uvMin[1];
+		uvMax[0] = uv.x > uvMax[0] ? uv.x : uvMax[0];
+		uvMax[1] = uv.y > uvMax[1] ? uv.y : uvMax[1];
+	}
+	for (int k = 0; k < 2; ++k)
+	{
+		float range = uvMax[k] - uvMin[k];
+		decode.uvScaleOffset[k] = range > 0.0f ? range : 1.0f;
+		decode.uvScaleOffset[k + 2] = uvMin[k];
+	}
+	return decode;
+}
+
+void DX11UWA::PackMeshVertices(MeshVertexFormat format, const MeshDecodeConstants& decode, const MeshVertex* vertices, size_t count, void* outData)
+{
+	if (format == MESH_VERTEX_FLOAT)
+	{
+		memcpy(outData, vertices, count * sizeof(MeshVertex));
+		return;
+	}
+
+	MeshPackedVertex* out = static_cast<MeshPackedVertex*>(outData);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const MeshVertex& v = vertices[i];
+		float position[3] = { v.pos.x, v.pos.y, v.pos.z };
+		for (int k = 0; k < 3; ++k)
+		{
+			if (format == MESH_VERTEX_HALF)
+				out[i].position[k] = FloatToHalf(position[k]);
+			else
+				out[i].position[k] = QuantizeUnorm16(position[k], decode.positionOffset[k], decode.positionScale[k]);
+		}
+		out[i].position[3] = 0;
+
+		out[i].uv[0] = QuantizeUnorm16(v.uv.x, decode.uvScaleOffset[2], decode.uvScaleOffset[0]);
+		out[i].uv[1] = QuantizeUnorm16(v.uv.y, decode.uvScaleOffset[3], decode.uvScaleOffset[1]);
+		EncodeOctahedral(v.normal, out[i].normal);
+	}
+}
+
+void DX11UWA::UnpackMeshVertices(MeshVertexFormat format, const MeshDecodeConstants& decode, const void* data, size_t count, MeshVertex* outVertices)
+{
+	if (format == MESH_VERTEX_FLOAT)
+	{
+		memcpy(outVertices, data, count * sizeof(MeshVertex));
+		return;
+	}
+
+	const MeshPackedVertex* in = static_cast<const MeshPackedVertex*>(data);
+	for (size_t i = 0; i < count; ++i)
+	{
+		float position[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			float stored = format == MESH_VERTEX_HALF ? HalfToFloat(in[i].position[k]) : in[i].position[k] / 65535.0f;
+			position[k] = stored * decode.positionScale[k] + decode.positionOffset[k];
+		}
+
+		MeshVertex& v = outVertices[i];
+		v.pos.x = position[0];
+		v.pos.y = position[1];
+		v.pos.z = position[2];
+		v.uv.x = in[i].uv[0] / 65535.0f * decode.uvScaleOffset[0] + decode.uvScaleOffset[2];
+		v.uv.y = in[i].uv[1] / 65535.0f * decode.uvScaleOffset[1] + decode.uvScaleOffset[3];
+		v.uv.z = 0.0f;
+		v.normal = DecodeOctahedral(in[i].normal);
+	}
+}
+
+MeshPackingError DX11UWA::MeasurePackingError(const MeshVertex* original, const MeshVertex* decoded, size_t count)
+{
+	MeshPackingError error = { 0.0f, 0.0f, 0.0f };
+	if (count == 0)
+		return error;
+
+	MeshBounds bounds = ComputeMeshBounds(original, count);
+	float diagonal = Distance(bounds.min, bounds.max);
+
+	float worstPosition = 0.0f;
+	float worstCosine = 1.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const MeshVertex& a = original[i];
+		const MeshVertex& b = decoded[i];
+
+		float position = Distance(a.pos, b.pos);
+		worstPosition = position > worstPosition ? position : worstPosition;
+
+		float du = fabsf(a.uv.x - b.uv.x);
+		float dv = fabsf(a.uv.y - b.uv.y);
+		error.uv = du > error.uv ? du : error.uv;
+		error.uv = dv > error.uv ? dv : error.uv;
+
+		// Zero-length source normals have no direction to preserve.
+		float lengths = Length(a.normal) * Length(b.normal);
+		if (lengths > 0.0f)
+		{
+			float cosine = (a.normal.x * b.normal.x + a.normal.y * b.normal.y + a.normal.z * b.normal.z) / lengths;
+			worstCosine = cosine < worstCosine ? cosine : worstCosine;
+		}
+	}
+
+	error.position = diagonal > 0.0f ? worstPosition / diagonal : worstPosition;
+	worstCosine = worstCosine < -1.0f ? -1.0f : (worstCosine > 1.0f ? 1.0f : worstCosine);
+	error.normalDegrees = acosf(worstCosine) * (180.0f / 3.14159265f);
+	return error;
+}
+
+bool DX11UWA::IsWithinPackingTolerance(const MeshPackingError& error)
+{
+	return error.position <= MESH_PACKING_POSITION_TOLERANCE &&
+		error.uv <= MESH_PACKING_UV_TOLERANCE &&
+		error.normalDegrees <= MESH_PACKING_NORMAL_TOLERANCE;
+}
+
+uint16_t DX11UWA::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000)
+		return static_cast<uint16_t>(sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00));
+	if (magnitude >= 0x477FF000)
+		return static_cast<uint16_t>(sign | 0x7C00);
+
+	uint32_t half;
+	uint32_t remainder;
+	uint32_t halfway;
+	if (magnitude < 0x38800000)
+	{
+		// Result is a half subnormal (or zero); shift the full mantissa into place.
+		uint32_t shift = 126 - (magnitude >> 23);
+		if (shift > 24)
+			return static_cast<uint16_t>(sign);
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		half = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		half = (magnitude - 0x38000000) >> 13;
+		remainder = magnitude & 0x1FFF;
+		halfway = 0x1000;
+	}
+
+	// Round to nearest, ties to even. A carry out of the mantissa correctly bumps the exponent.
+	if (remainder > halfway || (remainder == halfway && (half & 1)))
+		++half;
+	return static_cast<uint16_t>(sign | half);
+}
+
+float DX11UWA::HalfToFloat(uint16_t value)
+{
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float magnitude = mantissa * (1.0f / 16777216.0f);
+		return sign ? -magnitude : magnitude;
+	}
+
+	uint32_t bits = exponent == 31 ? (sign | 0x7F800000 | (mantissa << 13)) : (sign | ((exponent + 112) << 23) | (mantissa << 13));
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+
+#include <cstddef>
+
+namespace DX11UWA
+{
+	// Vertex formats a mesh can be uploaded in. The packed formats are 16 bytes per vertex
+	// against 36 for MeshVertex and are decoded in LightingVertexShader.hlsl.
+	enum MeshVertexFormat : uint32_t
+	{
+		MESH_VERTEX_FLOAT = 0,		// MeshVertex as is
+		MESH_VERTEX_QUANTIZED = 1,	// 16-bit positions relative to the mesh bounds
+		MESH_VERTEX_HALF = 2,		// half-float positions, for meshes too large to quantize well
+		MESH_VERTEX_FORMAT_COUNT = 3,
+	};
+
+	enum MeshSemantic : uint16_t
+	{
+		MESH_SEMANTIC_POSITION = 0,
+		MESH_SEMANTIC_UV = 1,
+		MESH_SEMANTIC_NORMAL = 2,
+	};
+
+	// Attribute formats use the numeric DXGI_FORMAT values so they can go straight into an input layout.
+	enum MeshAttributeFormat : uint16_t
+	{
+		MESH_FORMAT_FLOAT3 = 6,			// DXGI_FORMAT_R32G32B32_FLOAT
+		MESH_FORMAT_HALF4 = 10,			// DXGI_FORMAT_R16G16B16A16_FLOAT
+		MESH_FORMAT_UNORM16X4 = 11,		// DXGI_FORMAT_R16G16B16A16_UNORM
+		MESH_FORMAT_UNORM16X2 = 35,		// DXGI_FORMAT_R16G16_UNORM
+		MESH_FORMAT_SNORM16X2 = 37,		// DXGI_FORMAT_R16G16_SNORM
+	};
+
+	struct MeshAttribute
+	{
+		uint16_t	semantic;
+		uint16_t	format;
+		uint32_t	offset;
+	};
+
+	const uint32_t MESH_VERTEX_ATTRIBUTE_COUNT = 3;
+
+	// Position, uv and octahedral normal. Position w is padding.
+	struct MeshPackedVertex
+	{
+		uint16_t	position[4];
+		uint16_t	uv[2];
+		int16_t		normal[2];
+	};
+
+	// Matches MeshDecodeConstantBuffer (b1) in LightingVertexShader.hlsl.
+	struct MeshDecodeConstants
+	{
+		float	positionScale[4];	// w is 1 when normals are octahedral-encoded
+		float	positionOffset[4];	// w is the slice of a texture array page, 0 otherwise
+		float	uvScaleOffset[4];	// xy scale, zw offset
+	};
+
+	// Worst-case difference between a mesh and its packed round trip.
+	struct MeshPackingError
+	{
+		float	position;		// as a fraction of the bounds diagonal
+		float	uv;
+		float	normalDegrees;
+	};
+
+	// Largest MeshPackingError a packed mesh may have before it falls back to MESH_VERTEX_FLOAT.
+	const float MESH_PACKING_POSITION_TOLERANCE = 1.0f / 2048.0f;
+	const float MESH_PACKING_UV_TOLERANCE = 1.0f / 4096.0f;
+	const float MESH_PACKING_NORMAL_TOLERANCE = 0.5f;
+
+	uint32_t GetMeshVertexStride(MeshVertexFormat format);
+	void GetMeshVertexAttributes(MeshVertexFormat format, MeshAttribute outAttributes[MESH_VERTEX_ATTRIBUTE_COUNT]);
+
+	// Constants that map the packed attributes back to mesh space. The identity for MESH_VERTEX_FLOAT.
+	MeshDecodeConstants ComputeMeshDecodeConstants(MeshVertexFormat format, const MeshVertex* vertices, size_t count);
+
+	// Encodes count vertices into outData, which must hold count * GetMeshVertexStride(format) bytes.
+	void PackMeshVertices(MeshVertexFormat format, const MeshDecodeConstants& decode, const MeshVertex* vertices, size_t count, void* outData);
+
+	// Exact CPU mirror of the shader decode.
+	void UnpackMeshVertices(MeshVertexFormat format, const MeshDecodeConstants& decode, const void* data, size_t count, MeshVertex* outVertices);
+
+	MeshPackingError MeasurePackingError(const MeshVertex* original, const MeshVertex* decoded, size_t count);
+	bool IsWithinPackingTolerance(const MeshPackingError& error);
+
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+}
@@ -0,0 +1,633 @@
+﻿#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "../Common/LinearArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace DX11UWA;
+using DX::ArenaVector;
+
+namespace
+{
+	// Border and seam edges add a plane perpendicular to their triangle, weighted by this,
+	// so collapses that pull them off their line are expensive.
+	const float kBoundaryWeight = 2.0f;
+	// Each LOD aims for this fraction of the previous one's triangles; a level that keeps
+	// more than kLodStallRatio of them is dropped because simplification has stalled.
+	const float kLodReduction = 0.5f;
+	const float kLodStallRatio = 0.85f;
+	const size_t kMinLodTriangles = 64;
+	const float kMaxLodError = 0.05f;
+	const size_t kMinPassFraction = 16;
+
+	// Squared attribute distance counts as this much squared distance per unit of edge length,
+	// so remapping a wedge across a seam costs more the longer the collapsed edge is.
+	const float kAttributeWeight = 1.0f;
+
+	const uint32_t kNone = ~0u;
+
+	enum VertexKind : uint8_t
+	{
+		KIND_MANIFOLD,	// interior position, collapses anywhere
+		KIND_BORDER,	// on one open border, collapses along it into another border position
+		KIND_LOCKED,
+	};
+
+	struct Vector3
+	{
+		float x, y, z;
+	};
+
+	inline Vector3 Subtract(const Vector3& a, const Vector3& b)
+	{
+		Vector3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return r;
+	}
+
+	inline Vector3 Cross(const Vector3& a, const Vector3& b)
+	{
+		Vector3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return r;
+	}
+
+	inline float Dot(const Vector3& a, const Vector3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline float Normalize(Vector3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		if (length > 0.0f)
+		{
+			v.x /= length;
+			v.y /= length;
+			v.z /= length;
+		}
+		return length;
+	}
+
+	// Symmetric 4x4 quadric for the sum of weighted squared distances to a set of planes.
+	struct Quadric
+	{
+		float a00, a11, a22;
+		float a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float w;
+	};
+
+	void QuadricFromPlane(Quadric& q, const Vector3& n, float d, float w)
+	{
+		q.a00 = w * n.x * n.x;
+		q.a11 = w * n.y * n.y;
+		q.a22 = w * n.z * n.z;
+		q.a10 = w * n.y * n.x;
+		q.a20 = w * n.z * n.x;
+		q.a21 = w * n.z * n.y;
+		q.b0 = w * n.x * d;
+		q.b1 = w * n.y * d;
+		q.b2 = w * n.z * d;
+		q.c = w * d * d;
+		q.w = w;
+	}
+
+	void QuadricAdd(Quadric& q, const Quadric& r)
+	{
+		q.a00 += r.a00;
+		q.a11 += r.a11;
+		q.a22 += r.a22;
+		q.a10 += r.a10;
+		q.a20 += r.a20;
+		q.a21 += r.a21;
+		q.b0 += r.b0;
+		q.b1 += r.b1;
+		q.b2 += r.b2;
+		q.c += r.c;
+		q.w += r.w;
+	}
+
+	// Weighted mean squared distance from v to the quadric's planes.
+	float QuadricError(const Quadric& q, const Vector3& v)
+	{
+		float rx = (2.0f * (q.b0 + q.a10 * v.y) + q.a00 * v.x) * v.x;
+		float ry = (2.0f * (q.b1 + q.a21 * v.z) + q.a11 * v.y) * v.y;
+		float rz = (2.0f * (q.b2 + q.a20 * v.x) + q.a22 * v.z) * v.z;
+		float r = fabsf(q.c + rx + ry + rz);
+		return q.w > 0.0f ? r / q.w : 0.0f;
+	}
+
+	void QuadricFromTriangle(Quadric& q, const Vector3& p0, const Vector3& p1, const Vector3& p2)
+	{
+		Vector3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+		float area = Normalize(normal);
+		QuadricFromPlane(q, normal, -Dot(normal, p0), area);
+	}
+
+	// Plane through edge p0-p1 perpendicular to the triangle p0 p1 p2.
+	void QuadricFromTriangleEdge(Quadric& q, const Vector3& p0, const Vector3& p1, const Vector3& p2, float weight)
+	{
+		Vector3 edge = Subtract(p1, p0);
+		float length = Normalize(edge);
+		Vector3 side = Subtract(p2, p0);
+		float along = Dot(side, edge);
+		Vector3 normal = { side.x - edge.x * along, side.y - edge.y * along, side.z - edge.z * along };
+		Normalize(normal);
+		QuadricFromPlane(q, normal, -Dot(normal, p0), length * length * weight);
+	}
+
+	// Outgoing half-edges per vertex in compressed rows.
+	struct EdgeAdjacency
+	{
+		ArenaVector<uint32_t>	offsets;
+		ArenaVector<uint32_t>	targets;
+
+		void Build(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+			for (size_t i = 0; i < indexCount; ++i)
+				++offsets[indices[i] + 1];
+			for (size_t v = 0; v < vertexCount; ++v)
+				offsets[v + 1] += offsets[v];
+
+			targets.resize(indexCount);
+			ArenaVector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t t = 0; t + 3 <= indexCount; t += 3)
+			{
+				for (int k = 0; k < 3; ++k)
+					targets[fill[indices[t + k]]++] = indices[t + (k + 1) % 3];
+			}
+		}
+
+		bool HasEdge(uint32_t a, uint32_t b) const
+		{
+			for (uint32_t i = offsets[a]; i < offsets[a + 1]; ++i)
+			{
+				if (targets[i] == b)
+					return true;
+			}
+			return false;
+		}
+	};
+
+	// remap[v] is the lowest-numbered vertex at v's position; wedge links the vertices that
+	// share a position in a cycle.
+	void BuildPositionRemap(const Vector3* positions, size_t vertexCount, ArenaVector<uint32_t>& remap, ArenaVector<uint32_t>& wedge)
+	{
+		ArenaVector<uint32_t> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			order[v] = static_cast<uint32_t>(v);
+		std::sort(order.begin(), order.end(), [positions](uint32_t a, uint32_t b)
+		{
+			int c = memcmp(&positions[a], &positions[b], sizeof(Vector3));
+			return c != 0 ? c < 0 : a < b;
+		});
+
+		remap.resize(vertexCount);
+		wedge.resize(vertexCount);
+		for (size_t begin = 0; begin < vertexCount;)
+		{
+			size_t end = begin + 1;
+			while (end < vertexCount && memcmp(&positions[order[begin]], &positions[order[end]], sizeof(Vector3)) == 0)
+				++end;
+			for (size_t i = begin; i < end; ++i)
+			{
+				remap[order[i]] = order[begin];
+				wedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+			}
+			begin = end;
+		}
+	}
+
+	void ClassifyVertices(ArenaVector<uint8_t>& kinds, const uint32_t* rootIndices, size_t indexCount, const EdgeAdjacency& rootAdjacency)
+	{
+		// Count open edges in and out of each position; a border vertex has exactly one of each.
+		ArenaVector<uint8_t> openIn(kinds.size(), 0), openOut(kinds.size(), 0);
+		for (size_t t = 0; t < indexCount; t += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32_t a = rootIndices[t + k];
+				uint32_t b = rootIndices[t + (k + 1) % 3];
+				if (rootAdjacency.HasEdge(b, a))
+					continue;
+				openOut[a] = openOut[a] < 2 ? openOut[a] + 1 : 2;
+				openIn[b] = openIn[b] < 2 ? openIn[b] + 1 : 2;
+			}
+		}
+		for (size_t v = 0; v < kinds.size(); ++v)
+		{
+			if (openIn[v] == 0 && openOut[v] == 0)
+				kinds[v] = KIND_MANIFOLD;
+			else if (openIn[v] == 1 && openOut[v] == 1)
+				kinds[v] = KIND_BORDER;
+			else
+				kinds[v] = KIND_LOCKED;
+		}
+	}
+
+	inline float AttributeDistance(const MeshVertex& a, const MeshVertex& b)
+	{
+		float nx = a.normal.x - b.normal.x, ny = a.normal.y - b.normal.y, nz = a.normal.z - b.normal.z;
+		float u = a.uv.x - b.uv.x, v = a.uv.y - b.uv.y;
+		return std::min(0.25f * (nx * nx + ny * ny + nz * nz) + u * u + v * v, 1.0f);
+	}
+
+	// Decides which vertex each wedge of position r0 becomes when r0 collapses onto r1. A wedge
+	// that shares an edge with a wedge of r1 takes that one, which keeps uv and normal seams
+	// intact. Any other wedge takes the closest attributes r1 has; the largest attribute
+	// distance that costs is returned and writes into collapseRemap when apply is set.
+	float MapWedges(uint32_t r0, uint32_t r1, const ArenaVector<uint32_t>& wedge, const EdgeAdjacency& adjacency,
+		const MeshVertex* vertices, ArenaVector<uint32_t>& collapseRemap, bool apply)
+	{
+		float worst = 0.0f;
+		uint32_t w = r0;
+		do
+		{
+			uint32_t target = kNone;
+			float targetDistance = 0.0f;
+			uint32_t x = r1;
+			do
+			{
+				if (adjacency.HasEdge(w, x) || adjacency.HasEdge(x, w))
+				{
+					target = x;
+					targetDistance = 0.0f;
+					break;
+				}
+				float distance = AttributeDistance(vertices[w], vertices[x]);
+				if (target == kNone || distance < targetDistance)
+				{
+					target = x;
+					targetDistance = distance;
+				}
+				x = wedge[x];
+			} while (x != r1);
+
+			worst = std::max(worst, targetDistance);
+			if (apply)
+				collapseRemap[w] = target;
+			w = wedge[w];
+		} while (w != r0);
+		return worst;
+	}
+
+	struct Collapse
+	{
+		uint32_t	from;	// position roots
+		uint32_t	to;
+		float		error;
+	};
+
+	// Would moving position root r0 onto p1 turn any of its triangles over?
+	bool HasTriangleFlips(uint32_t r0, uint32_t r1, const Vector3& p1, const ArenaVector<uint32_t>& triangleOffsets, const ArenaVector<uint32_t>& triangles,
+		const uint32_t* indices, const ArenaVector<uint32_t>& remap, const ArenaVector<uint32_t>& collapseRemap, const Vector3* positions)
+	{
+		for (uint32_t i = triangleOffsets[r0]; i < triangleOffsets[r0 + 1]; ++i)
+		{
+			const uint32_t* corners = &indices[triangles[i] * 3];
+			uint32_t c[3] = { collapseRemap[corners[0]], collapseRemap[corners[1]], collapseRemap[corners[2]] };
+			int k = remap[c[0]] == r0 ? 0 : remap[c[1]] == r0 ? 1 : remap[c[2]] == r0 ? 2 : -1;
+			if (k < 0)
+				continue;
+
+			uint32_t b = c[(k + 1) % 3];
+			uint32_t d = c[(k + 2) % 3];
+			if (remap[b] == r1 || remap[d] == r1 || remap[b] == remap[d])
+				continue;	// this triangle disappears
+
+			const Vector3& p0 = positions[c[k]];
+			Vector3 before = Cross(Subtract(positions[b], p0), Subtract(positions[d], p0));
+			Vector3 after = Cross(Subtract(positions[b], p1), Subtract(positions[d], p1));
+			if (Dot(before, after) <= 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	// Holds the quadrics and topology of one mesh so it can be simplified in steps; each Run
+	// continues from the previous result and the error keeps counting from the original.
+	class Simplifier
+	{
+	public:
+		// triangleParts, when given, tags each triangle; tags follow their triangles through every Run.
+		Simplifier(const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, const uint32_t* triangleParts = nullptr) :
+			m_indices(indices, indices + indexCount - indexCount % 3), m_indexCount(m_indices.size()), m_vertices(vertices), m_vertexCount(vertexCount), m_error(0.0f)
+		{
+			if (triangleParts)
+				m_parts.assign(triangleParts, triangleParts + m_indexCount / 3);
+
+			// Work in a unit cube so errors and quadric weights do not depend on the mesh's scale.
+			MeshBounds bounds = ComputeMeshBounds(vertices, vertexCount);
+			m_extent = std::max(bounds.max.x - bounds.min.x, std::max(bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z));
+			float scale = m_extent > 0.0f ? 1.0f / m_extent : 0.0f;
+			m_positions.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; ++v)
+			{
+				m_positions[v].x = (vertices[v].pos.x - bounds.min.x) * scale;
+				m_positions[v].y = (vertices[v].pos.y - bounds.min.y) * scale;
+				m_positions[v].z = (vertices[v].pos.z - bounds.min.z) * scale;
+			}
+
+			// Topology is judged on positions; the wedges of a position are only told apart when
+			// deciding where each one goes in a collapse.
+			BuildPositionRemap(m_positions.data(), vertexCount, m_remap, m_wedge);
+
+			m_rootIndices.resize(m_indexCount);
+			for (size_t i = 0; i < m_indexCount; ++i)
+				m_rootIndices[i] = m_remap[m_indices[i]];
+			m_rootAdjacency.Build(m_rootIndices.data(), m_indexCount, vertexCount);
+
+			m_kinds.resize(vertexCount);
+			ClassifyVertices(m_kinds, m_rootIndices.data(), m_indexCount, m_rootAdjacency);
+
+			m_quadrics.resize(vertexCount);
+			memset(m_quadrics.data(), 0, m_quadrics.size() * sizeof(Quadric));
+			for (size_t t = 0; t < m_indexCount; t += 3)
+			{
+				const uint32_t* c = &m_rootIndices[t];
+				Quadric q;
+				QuadricFromTriangle(q, m_positions[c[0]], m_positions[c[1]], m_positions[c[2]]);
+				for (int k = 0; k < 3; ++k)
+					QuadricAdd(m_quadrics[c[k]], q);
+
+				for (int k = 0; k < 3; ++k)
+				{
+					uint32_t a = c[k];
+					uint32_t b = c[(k + 1) % 3];
+					if (m_rootAdjacency.HasEdge(b, a))
+						continue;
+					QuadricFromTriangleEdge(q, m_positions[a], m_positions[b], m_positions[c[(k + 2) % 3]], kBoundaryWeight);
+					QuadricAdd(m_quadrics[a], q);
+					QuadricAdd(m_quadrics[b], q);
+				}
+			}
+
+			m_collapseRemap.resize(vertexCount);
+			m_locked.resize(vertexCount);
+		}
+
+		void Run(size_t targetIndexCount, float targetError)
+		{
+			float errorLimit = targetError * targetError;
+			while (m_indexCount > targetIndexCount)
+			{
+				for (size_t i = 0; i < m_indexCount; ++i)
+					m_rootIndices[i] = m_remap[m_indices[i]];
+				m_adjacency.Build(m_indices.data(), m_indexCount, m_vertexCount);
+				m_rootAdjacency.Build(m_rootIndices.data(), m_indexCount, m_vertexCount);
+
+				// Every edge in each direction the endpoints' kinds allow. Border vertices only slide
+				// along the border, onto another border vertex.
+				m_collapses.clear();
+				for (size_t t = 0; t < m_indexCount; t += 3)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						uint32_t a = m_rootIndices[t + k];
+						uint32_t b = m_rootIndices[t + (k + 1) % 3];
+						bool open = !m_rootAdjacency.HasEdge(b, a);
+						if (a > b && !open)
+							continue;	// interior edges are seen from both sides; keep one
+
+						for (int direction = 0; direction < 2; ++direction)
+						{
+							uint32_t from = direction ? b : a;
+							uint32_t to = direction ? a : b;
+							bool allowed = m_kinds[from] == KIND_MANIFOLD || (m_kinds[from] == KIND_BORDER && m_kinds[to] == KIND_BORDER && open);
+							if (!allowed)
+								continue;
+
+							Quadric q = m_quadrics[from];
+							QuadricAdd(q, m_quadrics[to]);
+							Vector3 edge = Subtract(m_positions[to], m_positions[from]);
+							float attributeError = MapWedges(from, to, m_wedge, m_adjacency, m_vertices, m_collapseRemap, false) * Dot(edge, edge);
+							Collapse collapse = { from, to, QuadricError(q, m_positions[to]) + kAttributeWeight * attributeError };
+							m_collapses.push_back(collapse);
+						}
+					}
+				}
+				if (m_collapses.empty())
+					break;
+
+				std::sort(m_collapses.begin(), m_collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+				// Triangles around each position for the flip test.
+				m_triangleOffsets.assign(m_vertexCount + 1, 0);
+				for (size_t i = 0; i < m_indexCount; ++i)
+					++m_triangleOffsets[m_rootIndices[i] + 1];
+				for (size_t v = 0; v < m_vertexCount; ++v)
+					m_triangleOffsets[v + 1] += m_triangleOffsets[v];
+				m_triangles.resize(m_indexCount);
+				{
+					ArenaVector<uint32_t> fill(m_triangleOffsets.begin(), m_triangleOffsets.end() - 1);
+					for (size_t i = 0; i < m_indexCount; ++i)
+						m_triangles[fill[m_rootIndices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+
+				// Collapse the cheapest edges that do not touch each other. Past the error of the
+				// edge this pass would need on average, stop early so the next pass re-ranks; near the
+				// target that edge is cheap, so never rank below a small fraction of all candidates.
+				size_t triangleGoal = (m_indexCount - targetIndexCount) / 3;
+				size_t edgeGoal = triangleGoal / 2 + 1;
+				size_t goalRank = std::max(edgeGoal + edgeGoal / 2, m_collapses.size() / kMinPassFraction);
+				float errorGoal = m_collapses[std::min(m_collapses.size() - 1, goalRank)].error;
+
+				for (size_t v = 0; v < m_vertexCount; ++v)
+					m_collapseRemap[v] = static_cast<uint32_t>(v);
+				std::fill(m_locked.begin(), m_locked.end(), 0);
+
+				size_t trianglesRemoved = 0;
+				for (const Collapse& collapse : m_collapses)
+				{
+					if (collapse.error > errorLimit || trianglesRemoved >= triangleGoal)
+						break;
+					if (collapse.error > errorGoal && trianglesRemoved > triangleGoal / 10)
+						break;
+
+					uint32_t r0 = collapse.from;
+					uint32_t r1 = collapse.to;
+					if (m_locked[r0] || m_locked[r1])
+						continue;
+					if (HasTriangleFlips(r0, r1, m_positions[r1], m_triangleOffsets, m_triangles, m_indices.data(), m_remap, m_collapseRemap, m_positions.data()))
+						continue;
+
+					MapWedges(r0, r1, m_wedge, m_adjacency, m_vertices, m_collapseRemap, true);
+					QuadricAdd(m_quadrics[r1], m_quadrics[r0]);
+					m_locked[r0] = m_locked[r1] = 1;
+					trianglesRemoved += m_kinds[r0] == KIND_BORDER ? 1 : 2;
+					m_error = std::max(m_error, collapse.error);
+				}
+				if (trianglesRemoved == 0)
+					break;
+
+				size_t writeIndex = 0;
+				for (size_t t = 0; t < m_indexCount; t += 3)
+				{
+					uint32_t a = m_collapseRemap[m_indices[t]];
+					uint32_t b = m_collapseRemap[m_indices[t + 1]];
+					uint32_t c = m_collapseRemap[m_indices[t + 2]];
+					if (m_remap[a] == m_remap[b] || m_remap[b] == m_remap[c] || m_remap[c] == m_remap[a])
+						continue;
+					if (!m_parts.empty())
+						m_parts[writeIndex / 3] = m_parts[t / 3];
+					m_indices[writeIndex++] = a;
+					m_indices[writeIndex++] = b;
+					m_indices[writeIndex++] = c;
+				}
+				m_indexCount = writeIndex;
+			}
+		}
+
+		const uint32_t* GetIndices(void) const	{ return m_indices.data(); }
+		const uint32_t* GetParts(void) const	{ return m_parts.data(); }
+		size_t GetIndexCount(void) const		{ return m_indexCount; }
+		float GetError(void) const				{ return sqrtf(m_error) * m_extent; }
+
+	private:
+		ArenaVector<uint32_t>	m_indices;
+		ArenaVector<uint32_t>	m_parts;
+		size_t					m_indexCount;
+		const MeshVertex*		m_vertices;
+		size_t					m_vertexCount;
+		ArenaVector<Vector3>	m_positions;
+		float					m_extent;
+		float					m_error;	// squared, in the unit cube
+		ArenaVector<uint32_t>	m_remap;
+		ArenaVector<uint32_t>	m_wedge;
+		ArenaVector<uint8_t>	m_kinds;
+		ArenaVector<Quadric>	m_quadrics;
+		ArenaVector<uint32_t>	m_rootIndices;
+		EdgeAdjacency			m_adjacency;
+		EdgeAdjacency			m_rootAdjacency;
+		ArenaVector<Collapse>	m_collapses;
+		ArenaVector<uint32_t>	m_collapseRemap;
+		ArenaVector<uint8_t>	m_locked;
+		ArenaVector<uint32_t>	m_triangleOffsets;
+		ArenaVector<uint32_t>	m_triangles;
+	};
+}
+
+size_t DX11UWA::SimplifyMesh(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* outError)
+{
+	DX::LinearArena::Frame arenaFrame;
+	Simplifier simplifier(indices, indexCount, vertices, vertexCount);
+	simplifier.Run(targetIndexCount, targetError);
+	std::copy(simplifier.GetIndices(), simplifier.GetIndices() + simplifier.GetIndexCount(), outIndices);
+	if (outError)
+		*outError = simplifier.GetError();
+	return simplifier.GetIndexCount();
+}
+
+uint32_t DX11UWA::BuildMeshLods(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, MeshLod outLods[MESH_MAX_LODS], uint32_t maxLods, MeshLodStats* stats,
+	std::vector<MeshLod>* partLods)
+{
+	DX::LinearArena::Frame arenaFrame;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	size_t baseCount = indices.size();
+	outLods[0].indexOffset = 0;
+	outLods[0].indexCount = static_cast<uint32_t>(baseCount);
+	outLods[0].error = 0.0f;
+	outLods[0].clusterOffset = outLods[0].clusterCount = 0;
+
+	// Tag every triangle with its part so each level can be regrouped by part.
+	size_t partCount = partLods && !partLods->empty() ? partLods->size() : 1;
+	ArenaVector<uint32_t> triangleParts(baseCount / 3, 0);
+	if (partLods)
+	{
+		for (size_t part = 0; part < partLods->size(); ++part)
+		{
+			const MeshLod& range = (*partLods)[part];
+			std::fill(triangleParts.begin() + range.indexOffset / 3, triangleParts.begin() + (range.indexOffset + range.indexCount) / 3, static_cast<uint32_t>(part));
+			(*partLods)[part].error = 0.0f;
+			(*partLods)[part].clusterOffset = (*partLods)[part].clusterCount = 0;
+		}
+	}
+
+	// One simplifier walks down through every level, so each level's error is measured
+	// against LOD 0 and the work shrinks with the mesh.
+	Simplifier simplifier(indices.data(), baseCount, vertices.data(), vertices.size(), triangleParts.data());
+	uint32_t lodCount = 1;
+	ArenaVector<uint32_t> lod;
+	ArenaVector<uint32_t> partStarts(partCount + 1);
+	size_t previousCount = baseCount;
+	float targetRatio = 1.0f;
+	while (lodCount < std::min(maxLods, MESH_MAX_LODS))
+	{
+		targetRatio *= kLodReduction;
+		size_t target = static_cast<size_t>(baseCount / 3 * targetRatio) * 3;
+		if (target < kMinLodTriangles * 3)
+			break;
+
+		simplifier.Run(target, kMaxLodError);
+		size_t count = simplifier.GetIndexCount();
+		if (count == 0 || count > previousCount * kLodStallRatio)
+			break;
+
+		// Stable counting sort by part, then each part is ordered for the vertex cache on its own.
+		const uint32_t* parts = simplifier.GetParts();
+		std::fill(partStarts.begin(), partStarts.end(), 0);
+		for (size_t t = 0; t < count / 3; ++t)
+			++partStarts[parts[t] + 1];
+		for (size_t part = 0; part < partCount; ++part)
+			partStarts[part + 1] += partStarts[part];
+		lod.resize(count);
+		{
+			ArenaVector<uint32_t> fill(partStarts.begin(), partStarts.end() - 1);
+			for (size_t t = 0; t < count / 3; ++t)
+			{
+				uint32_t* out = &lod[fill[parts[t]]++ * 3];
+				const uint32_t* in = simplifier.GetIndices() + t * 3;
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+			}
+		}
+		for (size_t part = 0; part < partCount; ++part)
+		{
+			OptimizeVertexCache(lod.data() + partStarts[part] * 3, (partStarts[part + 1] - partStarts[part]) * 3, vertices.size());
+			if (partLods)
+			{
+				MeshLod range;
+				range.indexOffset = static_cast<uint32_t>(indices.size() + partStarts[part] * 3);
+				range.indexCount = (partStarts[part + 1] - partStarts[part]) * 3;
+				range.error = simplifier.GetError();
+				range.clusterOffset = range.clusterCount = 0;
+				partLods->push_back(range);
+			}
+		}
+
+		outLods[lodCount].indexOffset = static_cast<uint32_t>(indices.size());
+		outLods[lodCount].indexCount = static_cast<uint32_t>(count);
+		outLods[lodCount].error = simplifier.GetError();
+		outLods[lodCount].clusterOffset = outLods[lodCount].clusterCount = 0;
+		indices.insert(indices.end(), lod.begin(), lod.end());
+		previousCount = count;
+		++lodCount;
+	}
+
+	if (stats)
+	{
+		stats->lodCount = lodCount;
+		stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+	return lodCount;
+}
+
+uint32_t DX11UWA::SelectMeshLod(const MeshLod* lods, uint32_t lodCount, float distance, float projectionScale, float pixelThreshold)
+{
+	if (distance <= 0.0f)
+		return 0;
+
+	// Errors only grow with the level, so the first acceptable one from the coarse end wins.
+	for (uint32_t i = lodCount; i-- > 1;)
+	{
+		if (lods[i].error * projectionScale / distance <= pixelThreshold)
+			return i;
+	}
+	return 0;
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace DX11UWA
+{
+	const uint32_t MESH_MAX_LODS = 5;
+
+	// One level of detail: a range of the mesh's shared index buffer and how far, in mesh
+	// units, its surface may be from LOD 0. LOD 0 always has an error of 0. The cluster range
+	// is filled in by BuildMeshClusters and is empty until then.
+	struct MeshLod
+	{
+		uint32_t	indexOffset;
+		uint32_t	indexCount;
+		float		error;
+		uint32_t	clusterOffset;
+		uint32_t	clusterCount;
+	};
+
+	struct MeshLodStats
+	{
+		uint32_t	lodCount;
+		double		seconds;
+	};
+
+	// Quadric error metric simplifier. Edges collapse into one of their endpoints, so no
+	// vertex is moved or created and the result indexes the same vertex buffer. Topology is
+	// taken from positions: open borders only collapse along themselves and non-manifold
+	// positions are locked. Each uv/normal wedge of a collapsed position moves to the matching
+	// wedge of the target, and a collapse that has to pick a different wedge pays for the
+	// attribute difference. Stops at targetIndexCount or before any collapse costs more than
+	// targetError, given as a fraction of the mesh extent. outIndices must hold indexCount
+	// indices. Returns the number of indices written; outError receives the error in mesh units.
+	size_t SimplifyMesh(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float* outError = nullptr);
+
+	// Fills outLods[0] with the whole of indices, then appends up to maxLods - 1 coarser levels,
+	// each about half the triangles of the one before and cache-optimized. All levels share the
+	// vertex buffer. Returns the number of levels, which is smaller when simplification stalls.
+	// partLods, when given, holds the ranges that split LOD 0 into parts, in order. Every level
+	// then keeps each part's triangles together, and partLods grows to hold the ranges of every
+	// level: part p of level l is partLods[l * partCount + p].
+	uint32_t BuildMeshLods(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, MeshLod outLods[MESH_MAX_LODS],
+		uint32_t maxLods = MESH_MAX_LODS, MeshLodStats* stats = nullptr, std::vector<MeshLod>* partLods = nullptr);
+
+	// Picks the coarsest level whose error projects to at most pixelThreshold pixels. distance is
+	// from the eye to the nearest point of the object's bounds, and projectionScale is
+	// viewportHeight / (2 * tan(fovY / 2)).
+	uint32_t SelectMeshLod(const MeshLod* lods, uint32_t lodCount, float distance, float projectionScale, float pixelThreshold = 1.0f);
+}
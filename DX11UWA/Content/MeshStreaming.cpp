@@ -0,0 +1,821 @@
+﻿#include "MeshStreaming.h"
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "../Common/FileIO.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace DX11UWA;
+
+static_assert(sizeof(MeshChunk) == 104, "MeshChunk is part of the file format");
+static_assert(sizeof(MeshChunkFileHeader) == 80, "MeshChunkFileHeader is part of the file format");
+
+namespace
+{
+	const size_t kReadBufferBytes = 1 << 20;
+	const size_t kSpillBufferBytes = 1 << 20;
+	const uint32_t kPageRecords = 4096;		// attributes per cache page
+	const uint32_t kMaxCells = 1 << 16;
+	const uint32_t kKeySamples = 64;
+	const size_t kKeySampleBytes = 4096;
+	const uint32_t kNoSlot = ~0u;
+	const uint64_t kNoPage = ~0ull;
+	const uint64_t kNoRun = ~0ull;
+
+	// A triangle waiting in a bin, with its vertices resolved.
+	struct BinnedTriangle
+	{
+		MeshVertex	corners[3];
+	};
+
+	// Heads each run of one bin's triangles in the spill file. A bin's runs are chained from
+	// its last one back to its first.
+	struct SpillRun
+	{
+		uint64_t	previous;
+		uint32_t	bin;
+		uint32_t	count;
+	};
+
+	struct Bin
+	{
+		uint64_t	lastRun;
+		uint64_t	triangleCount;
+	};
+
+	// A scratch file that is deleted when it goes out of scope.
+	class TempFile
+	{
+	public:
+		TempFile(void) : m_file(nullptr) {}
+		~TempFile(void)	{ Close(); }
+
+		bool Create(const std::string& path)
+		{
+			Close();
+			m_path = path;
+			m_file = DX::OpenFile(path.c_str(), "w+b");
+			return m_file != nullptr;
+		}
+
+		void Close(void)
+		{
+			if (!m_file)
+				return;
+			fclose(m_file);
+			DX::RemoveFile(m_path.c_str());
+			m_file = nullptr;
+		}
+
+		FILE* Get(void) const	{ return m_file; }
+
+	private:
+		TempFile(const TempFile&);
+		TempFile& operator=(const TempFile&);
+
+		FILE*		m_file;
+		std::string	m_path;
+	};
+
+	// Read-only cache over an attribute array spilled to disk. Pages are replaced with the
+	// clock algorithm; OBJ faces mostly reference recent vertices, so few pages are hot at a time.
+	class AttributePages
+	{
+	public:
+		AttributePages(void) : m_file(nullptr), m_count(0), m_hand(0) {}
+
+		void Init(FILE* file, uint64_t count, size_t budgetBytes)
+		{
+			m_file = file;
+			m_count = count;
+			uint64_t pageCount = (count + kPageRecords - 1) / kPageRecords;
+			size_t slotCount = std::max<size_t>(1, budgetBytes / (kPageRecords * sizeof(MeshFloat3)));
+			slotCount = static_cast<size_t>(std::min<uint64_t>(slotCount, std::max<uint64_t>(pageCount, 1)));
+			m_records.resize(slotCount * kPageRecords);
+			m_slotPage.assign(slotCount, kNoPage);
+			m_referenced.assign(slotCount, 0);
+			m_pageSlot.assign(static_cast<size_t>(pageCount), kNoSlot);
+			m_hand = 0;
+		}
+
+		size_t GetBytes(void) const
+		{
+			return m_records.capacity() * sizeof(MeshFloat3) + m_slotPage.capacity() * sizeof(uint64_t) + m_referenced.capacity() +
+				m_pageSlot.capacity() * sizeof(uint32_t);
+		}
+
+		bool Get(uint64_t index, MeshFloat3& out)
+		{
+			uint64_t page = index / kPageRecords;
+			uint32_t slot = m_pageSlot[static_cast<size_t>(page)];
+			if (slot == kNoSlot && (slot = Load(page)) == kNoSlot)
+				return false;
+			m_referenced[slot] = 1;
+			out = m_records[static_cast<size_t>(slot) * kPageRecords + index % kPageRecords];
+			return true;
+		}
+
+	private:
+		uint32_t Load(uint64_t page)
+		{
+			while (m_referenced[m_hand])
+			{
+				m_referenced[m_hand] = 0;
+				m_hand = (m_hand + 1) % m_slotPage.size();
+			}
+			uint32_t slot = static_cast<uint32_t>(m_hand);
+			m_hand = (m_hand + 1) % m_slotPage.size();
+			if (m_slotPage[slot] != kNoPage)
+				m_pageSlot[static_cast<size_t>(m_slotPage[slot])] = kNoSlot;
+			m_slotPage[slot] = kNoPage;
+
+			uint64_t first = page * kPageRecords;
+			size_t records = static_cast<size_t>(std::min<uint64_t>(kPageRecords, m_count - first));
+			if (!DX::SeekFile(m_file, first * sizeof(MeshFloat3)) ||
+				fread(&m_records[static_cast<size_t>(slot) * kPageRecords], sizeof(MeshFloat3), records, m_file) != records)
+			{
+				return kNoSlot;
+			}
+			m_slotPage[slot] = page;
+			m_pageSlot[static_cast<size_t>(page)] = slot;
+			return slot;
+		}
+
+		FILE*					m_file;
+		uint64_t				m_count;
+		std::vector<MeshFloat3>	m_records;
+		std::vector<uint64_t>	m_slotPage;
+		std::vector<uint8_t>	m_referenced;
+		std::vector<uint32_t>	m_pageSlot;
+		size_t					m_hand;
+	};
+
+	void GrowBounds(MeshBounds& bounds, const MeshFloat3& p)
+	{
+		bounds.min.x = std::min(bounds.min.x, p.x);
+		bounds.min.y = std::min(bounds.min.y, p.y);
+		bounds.min.z = std::min(bounds.min.z, p.z);
+		bounds.max.x = std::max(bounds.max.x, p.x);
+		bounds.max.y = std::max(bounds.max.y, p.y);
+		bounds.max.z = std::max(bounds.max.z, p.z);
+	}
+
+	// Square cells, as many as fit in cellTarget, over the extent of bounds. Flat axes get one cell.
+	float ChooseGrid(const MeshBounds& bounds, uint32_t cellTarget, uint32_t outSize[3])
+	{
+		float extent[3] = { bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+		float longest = std::max(extent[0], std::max(extent[1], extent[2]));
+		outSize[0] = outSize[1] = outSize[2] = 1;
+		if (cellTarget <= 1 || !(longest > 0.0f))
+			return longest > 0.0f ? longest : 1.0f;
+
+		auto countCells = [&](float size, uint32_t* dims)
+		{
+			uint64_t cells = 1;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				double cellsOnAxis = std::max(1.0, std::ceil(double(extent[axis]) / size));
+				dims[axis] = static_cast<uint32_t>(std::min<double>(cellsOnAxis, kMaxCells));
+				cells *= dims[axis];
+			}
+			return cells;
+		};
+
+		// The smallest cell size that still fits the target.
+		float low = longest / cellTarget;
+		float high = longest;
+		uint32_t dims[3];
+		for (int i = 0; i < 48; ++i)
+		{
+			float middle = 0.5f * (low + high);
+			if (countCells(middle, dims) <= cellTarget)
+				high = middle;
+			else
+				low = middle;
+		}
+		countCells(high, outSize);
+		return high;
+	}
+
+	inline uint32_t HashVertex(const MeshVertex& vertex)
+	{
+		uint32_t words[9];
+		memcpy(words, &vertex, sizeof(words));
+		uint32_t hash = 2166136261u;
+		for (uint32_t word : words)
+			hash = (hash ^ word) * 16777619u;
+		return hash ^ (hash >> 15);
+	}
+
+	// Turns the triangles of one chunk into a welded, optimized and packed mesh and appends it
+	// to the chunk file. The buffers are sized once for MESH_CHUNK_MAX_TRIANGLES and reused.
+	class ChunkWriter
+	{
+	public:
+		ChunkWriter(FILE* file, uint64_t offset, MeshVertexFormat format) :
+			m_file(file),
+			m_offset(offset),
+			m_format(format)
+		{
+			size_t maxVertices = MESH_CHUNK_MAX_TRIANGLES * 3;
+			m_vertices.reserve(maxVertices);
+			m_indices.reserve(maxVertices);
+			m_table.resize(maxVertices * 2 > 1 ? NextPowerOfTwo(maxVertices * 2) : 2);
+			m_packed.reserve(maxVertices * sizeof(MeshVertex));
+			m_decoded.reserve(maxVertices);
+		}
+
+		size_t GetBytes(void) const
+		{
+			return m_vertices.capacity() * sizeof(MeshVertex) + m_indices.capacity() * sizeof(uint32_t) + m_table.capacity() * sizeof(uint32_t) +
+				m_packed.capacity() + m_decoded.capacity() * sizeof(MeshVertex) + m_chunks.capacity() * sizeof(MeshChunk);
+		}
+
+		bool Write(const BinnedTriangle* triangles, size_t triangleCount)
+		{
+			// Weld identical vertices. The table is at most half full, so probes stay short.
+			const uint32_t emptySlot = UINT32_MAX;
+			std::fill(m_table.begin(), m_table.end(), emptySlot);
+			size_t mask = m_table.size() - 1;
+			m_vertices.clear();
+			m_indices.clear();
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				for (const MeshVertex& vertex : triangles[t].corners)
+				{
+					size_t slot = HashVertex(vertex) & mask;
+					while (m_table[slot] != emptySlot && memcmp(&m_vertices[m_table[slot]], &vertex, sizeof(vertex)) != 0)
+						slot = (slot + 1) & mask;
+					if (m_table[slot] == emptySlot)
+					{
+						m_table[slot] = static_cast<uint32_t>(m_vertices.size());
+						m_vertices.push_back(vertex);
+					}
+					m_indices.push_back(m_table[slot]);
+				}
+			}
+
+			OptimizeVertexCache(m_indices.data(), m_indices.size(), m_vertices.size());
+			m_vertices.resize(OptimizeVertexFetch(m_vertices.data(), m_indices.data(), m_indices.size(), m_vertices.size()));
+
+			MeshChunk chunk;
+			memset(&chunk, 0, sizeof(chunk));
+			chunk.bounds = ComputeMeshBounds(m_vertices.data(), m_vertices.size());
+			chunk.vertexCount = static_cast<uint32_t>(m_vertices.size());
+			chunk.indexCount = static_cast<uint32_t>(m_indices.size());
+			chunk.indexSize = m_vertices.size() <= 0x10000 ? 2 : 4;
+			if (!Pack(m_format, chunk) && m_format != MESH_VERTEX_FLOAT)
+				Pack(MESH_VERTEX_FLOAT, chunk);
+
+			// 16-bit indices are narrowed in place; the buffer is not needed as 32-bit afterwards.
+			if (chunk.indexSize == 2)
+			{
+				uint16_t* narrow = reinterpret_cast<uint16_t*>(m_indices.data());
+				for (size_t i = 0; i < m_indices.size(); ++i)
+					narrow[i] = static_cast<uint16_t>(m_indices[i]);
+			}
+
+			size_t vertexBytes = m_vertices.size() * GetMeshVertexStride(static_cast<MeshVertexFormat>(chunk.vertexFormat));
+			size_t indexBytes = m_indices.size() * chunk.indexSize;
+			chunk.vertexOffset = m_offset;
+			chunk.indexOffset = m_offset + vertexBytes;
+			if (fwrite(m_packed.data(), 1, vertexBytes, m_file) != vertexBytes || fwrite(m_indices.data(), 1, indexBytes, m_file) != indexBytes)
+				return false;
+			m_offset += vertexBytes + indexBytes;
+			m_chunks.push_back(chunk);
+			return true;
+		}
+
+		const std::vector<MeshChunk>& GetChunks(void) const	{ return m_chunks; }
+		uint64_t GetOffset(void) const							{ return m_offset; }
+
+	private:
+		static size_t NextPowerOfTwo(size_t value)
+		{
+			size_t power = 1;
+			while (power < value)
+				power *= 2;
+			return power;
+		}
+
+		// Packs m_vertices into m_packed against the chunk's own bounds. Returns false when the
+		// round trip is outside the packing tolerances.
+		bool Pack(MeshVertexFormat format, MeshChunk& chunk)
+		{
+			chunk.vertexFormat = format;
+			chunk.decode = ComputeMeshDecodeConstants(format, m_vertices.data(), m_vertices.size());
+			m_packed.resize(m_vertices.size() * GetMeshVertexStride(format));
+			PackMeshVertices(format, chunk.decode, m_vertices.data(), m_vertices.size(), m_packed.data());
+			if (format == MESH_VERTEX_FLOAT)
+				return true;
+			m_decoded.resize(m_vertices.size());
+			UnpackMeshVertices(format, chunk.decode, m_packed.data(), m_vertices.size(), m_decoded.data());
+			return IsWithinPackingTolerance(MeasurePackingError(m_vertices.data(), m_decoded.data(), m_vertices.size()));
+		}
+
+		FILE*					m_file;
+		uint64_t				m_offset;
+		MeshVertexFormat		m_format;
+		std::vector<MeshVertex>	m_vertices;
+		std::vector<uint32_t>	m_indices;
+		std::vector<uint32_t>	m_table;
+		std::vector<uint8_t>	m_packed;
+		std::vector<MeshVertex>	m_decoded;
+		std::vector<MeshChunk>	m_chunks;
+	};
+
+	inline double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+bool DX11UWA::ComputeStreamedSourceKey(const char* objPath, uint64_t& outKey, uint64_t& outSize)
+{
+	if (!DX::GetFileSize(objPath, outSize))
+		return false;
+	FILE* file = DX::OpenFile(objPath, "rb");
+	if (!file)
+		return false;
+
+	// Small files are hashed whole; larger ones by samples that always include both ends.
+	std::vector<uint8_t> samples(static_cast<size_t>(std::min<uint64_t>(outSize, kKeySamples * kKeySampleBytes)));
+	bool read = true;
+	if (samples.size() == outSize)
+	{
+		read = samples.empty() || fread(samples.data(), 1, samples.size(), file) == samples.size();
+	}
+	else
+	{
+		for (uint32_t i = 0; i < kKeySamples && read; ++i)
+		{
+			uint64_t offset = (outSize - kKeySampleBytes) * i / (kKeySamples - 1);
+			read = DX::SeekFile(file, offset) && fread(&samples[i * kKeySampleBytes], 1, kKeySampleBytes, file) == kKeySampleBytes;
+		}
+	}
+	fclose(file);
+	outKey = HashMeshSource(samples.data(), samples.size()) ^ (outSize * 0x9E3779B185EBCA87ull);
+	return read;
+}
+
+bool DX11UWA::ImportObjChunked(const char* objPath, const char* chunkPath, MeshVertexFormat format, uint64_t memoryBudget, MeshStreamingStats* stats)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	MeshStreamingStats localStats;
+	memset(&localStats, 0, sizeof(localStats));
+	if (memoryBudget < MESH_STREAMING_MIN_BUDGET)
+		return false;
+
+	uint64_t sourceKey, sourceSize;
+	if (!ComputeStreamedSourceKey(objPath, sourceKey, sourceSize))
+		return false;
+	localStats.sourceBytes = sourceSize;
+
+	// First pass: bounds and counts, with every attribute spilled to disk for the second.
+	std::string basePath(chunkPath);
+	TempFile attributeFiles[3];
+	if (!attributeFiles[0].Create(basePath + ".positions.tmp") || !attributeFiles[1].Create(basePath + ".uvs.tmp") ||
+		!attributeFiles[2].Create(basePath + ".normals.tmp"))
+	{
+		return false;
+	}
+	uint64_t attributeCounts[3] = { 0, 0, 0 };
+	MeshBounds bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	uint64_t triangleCount = 0;
+	{
+		ObjStreamReader reader;
+		if (!reader.Open(objPath, kReadBufferBytes))
+			return false;
+		MeshFloat3 value;
+		ObjCorner corners[3];
+		for (ObjRecord record; (record = reader.Next(value, corners)) != OBJ_RECORD_END;)
+		{
+			if (record == OBJ_RECORD_ERROR)
+				return false;
+			if (record == OBJ_RECORD_TRIANGLE)
+			{
+				++triangleCount;
+				continue;
+			}
+			int kind = record == OBJ_RECORD_POSITION ? 0 : record == OBJ_RECORD_UV ? 1 : 2;
+			if (fwrite(&value, sizeof(value), 1, attributeFiles[kind].Get()) != 1)
+				return false;
+			++attributeCounts[kind];
+			if (kind == 0)
+				GrowBounds(bounds, value);
+		}
+	}
+	if (triangleCount == 0 || attributeCounts[0] == 0)
+		return false;
+	localStats.positionCount = attributeCounts[0];
+	localStats.triangleCount = triangleCount;
+	localStats.boundsSeconds = SecondsSince(startTime);
+
+	// Aim for bins of about half a chunk, so uneven density rarely needs more than a chunk a bin.
+	uint64_t cellTarget = std::min<uint64_t>(kMaxCells, std::max<uint64_t>(1, triangleCount * 2 / MESH_CHUNK_MAX_TRIANGLES));
+	float cellSize = ChooseGrid(bounds, static_cast<uint32_t>(cellTarget), localStats.gridSize);
+	uint32_t cellCount = localStats.gridSize[0] * localStats.gridSize[1] * localStats.gridSize[2];
+
+	// Second pass: resolve each triangle through the attribute caches and bin it. Whatever the
+	// fixed buffers leave of the budget goes two thirds to the triangle pool, one third to the caches.
+	auto binStart = std::chrono::high_resolution_clock::now();
+	TempFile spill;
+	if (!spill.Create(basePath + ".spill.tmp"))
+		return false;
+	std::vector<char> spillBuffer(kSpillBufferBytes);
+	setvbuf(spill.Get(), spillBuffer.data(), _IOFBF, spillBuffer.size());
+	std::vector<Bin> bins(cellCount);
+	for (Bin& bin : bins)
+	{
+		bin.lastRun = kNoRun;
+		bin.triangleCount = 0;
+	}
+	std::vector<uint32_t> binCounts(cellCount + 1);
+
+	uint64_t pageTableBytes = 0;
+	for (uint64_t count : attributeCounts)
+		pageTableBytes += (count + kPageRecords - 1) / kPageRecords * sizeof(uint32_t);
+	uint64_t fixedBytes = kReadBufferBytes + kSpillBufferBytes + bins.capacity() * sizeof(Bin) + binCounts.capacity() * sizeof(uint32_t) + pageTableBytes;
+	if (fixedBytes + (4 << 20) > memoryBudget)
+		return false;
+	uint64_t flexibleBytes = memoryBudget - fixedBytes;
+	const size_t triangleBytes = sizeof(BinnedTriangle) + 2 * sizeof(uint32_t);
+	size_t poolCapacity = static_cast<size_t>(std::min<uint64_t>(flexibleBytes * 2 / 3 / triangleBytes, triangleCount));
+	uint64_t cacheBytes = flexibleBytes - poolCapacity * triangleBytes;
+
+	AttributePages pages[3];
+	uint64_t attributeTotal = attributeCounts[0] + attributeCounts[1] + attributeCounts[2];
+	for (int kind = 0; kind < 3; ++kind)
+	{
+		size_t share = static_cast<size_t>(cacheBytes * attributeCounts[kind] / attributeTotal);
+		share = share > kPageRecords * sizeof(MeshFloat3) * 2 ? share - kPageRecords * sizeof(MeshFloat3) : kPageRecords * sizeof(MeshFloat3);
+		pages[kind].Init(attributeFiles[kind].Get(), attributeCounts[kind], share);
+	}
+
+	std::vector<BinnedTriangle> pool(poolCapacity);
+	std::vector<uint32_t> poolBins(poolCapacity);
+	std::vector<uint32_t> order(poolCapacity);
+	size_t pooled = 0;
+	uint64_t bufferBytes = fixedBytes + pool.capacity() * sizeof(BinnedTriangle) + (poolBins.capacity() + order.capacity()) * sizeof(uint32_t);
+	for (const AttributePages& cache : pages)
+		bufferBytes += cache.GetBytes();
+	localStats.bufferBytes = bufferBytes;
+
+	// Writes the pool out as one run per bin that has triangles in it.
+	auto flushPool = [&]()
+	{
+		std::fill(binCounts.begin(), binCounts.end(), 0);
+		for (size_t i = 0; i < pooled; ++i)
+			++binCounts[poolBins[i] + 1];
+		for (uint32_t b = 0; b < cellCount; ++b)
+			binCounts[b + 1] += binCounts[b];
+		for (size_t i = 0; i < pooled; ++i)
+			order[binCounts[poolBins[i]]++] = static_cast<uint32_t>(i);
+
+		// binCounts[b] now ends bin b, so bin b starts where bin b - 1 ends.
+		uint32_t start = 0;
+		for (uint32_t b = 0; b < cellCount; ++b)
+		{
+			uint32_t end = binCounts[b];
+			if (end == start)
+				continue;
+			SpillRun run = { bins[b].lastRun, b, end - start };
+			uint64_t offset = DX::TellFile(spill.Get());
+			if (fwrite(&run, sizeof(run), 1, spill.Get()) != 1)
+				return false;
+			for (uint32_t i = start; i < end; ++i)
+			{
+				if (fwrite(&pool[order[i]], sizeof(BinnedTriangle), 1, spill.Get()) != 1)
+					return false;
+			}
+			bins[b].lastRun = offset;
+			bins[b].triangleCount += run.count;
+			start = end;
+		}
+		pooled = 0;
+		++localStats.spillFlushes;
+		return true;
+	};
+
+	{
+		ObjStreamReader reader;
+		if (!reader.Open(objPath, kReadBufferBytes))
+			return false;
+		const MeshFloat3 zero = { 0.0f, 0.0f, 0.0f };
+		float inverseCellSize = 1.0f / cellSize;
+		MeshFloat3 value;
+		ObjCorner corners[3];
+		for (ObjRecord record; (record = reader.Next(value, corners)) != OBJ_RECORD_END;)
+		{
+			if (record == OBJ_RECORD_ERROR)
+				return false;
+			if (record != OBJ_RECORD_TRIANGLE)
+				continue;
+
+			BinnedTriangle& triangle = pool[pooled];
+			for (int c = 0; c < 3; ++c)
+			{
+				const ObjCorner& corner = corners[c];
+				MeshVertex& vertex = triangle.corners[c];
+				if (corner.position < 0 || static_cast<uint64_t>(corner.position) >= attributeCounts[0] ||
+					corner.uv < -1 || (corner.uv >= 0 && static_cast<uint64_t>(corner.uv) >= attributeCounts[1]) ||
+					corner.normal < -1 || (corner.normal >= 0 && static_cast<uint64_t>(corner.normal) >= attributeCounts[2]))
+				{
+					return false;
+				}
+				vertex.uv = vertex.normal = zero;
+				if (!pages[0].Get(corner.position, vertex.pos) ||
+					(corner.uv >= 0 && !pages[1].Get(corner.uv, vertex.uv)) ||
+					(corner.normal >= 0 && !pages[2].Get(corner.normal, vertex.normal)))
+				{
+					return false;
+				}
+			}
+
+			const MeshVertex* v = triangle.corners;
+			float centroid[3] =
+			{
+				(v[0].pos.x + v[1].pos.x + v[2].pos.x) / 3.0f - bounds.min.x,
+				(v[0].pos.y + v[1].pos.y + v[2].pos.y) / 3.0f - bounds.min.y,
+				(v[0].pos.z + v[1].pos.z + v[2].pos.z) / 3.0f - bounds.min.z,
+			};
+			uint32_t cell[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float position = std::max(0.0f, centroid[axis] * inverseCellSize);
+				cell[axis] = std::min(static_cast<uint32_t>(position), localStats.gridSize[axis] - 1);
+			}
+			poolBins[pooled] = (cell[2] * localStats.gridSize[1] + cell[1]) * localStats.gridSize[0] + cell[0];
+			if (++pooled == poolCapacity && !flushPool())
+				return false;
+		}
+	}
+	if (pooled > 0 && !flushPool())
+		return false;
+	localStats.spillBytes = DX::TellFile(spill.Get()) + (attributeCounts[0] + attributeCounts[1] + attributeCounts[2]) * sizeof(MeshFloat3);
+	for (TempFile& file : attributeFiles)
+		file.Close();
+	std::vector<BinnedTriangle>().swap(pool);
+	std::vector<uint32_t>().swap(poolBins);
+	std::vector<uint32_t>().swap(order);
+	for (AttributePages& cache : pages)
+		cache = AttributePages();
+	localStats.binSeconds = SecondsSince(binStart);
+
+	// Last: each bin becomes chunks of up to MESH_CHUNK_MAX_TRIANGLES, read back run by run.
+	auto writeStart = std::chrono::high_resolution_clock::now();
+	std::string tempPath = basePath + ".tmp";
+	FILE* file = DX::OpenFile(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+	MeshChunkFileHeader header;
+	memset(&header, 0, sizeof(header));
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	{
+		std::vector<BinnedTriangle> triangles(MESH_CHUNK_MAX_TRIANGLES);
+		ChunkWriter writer(file, sizeof(header), format);
+		size_t filled = 0;
+		for (uint32_t b = 0; b < cellCount && written; ++b)
+		{
+			for (uint64_t runOffset = bins[b].lastRun; runOffset != kNoRun && written;)
+			{
+				SpillRun run;
+				written = DX::SeekFile(spill.Get(), runOffset) && fread(&run, sizeof(run), 1, spill.Get()) == 1 && run.bin == b;
+				uint64_t at = runOffset + sizeof(run);
+				for (uint32_t remaining = run.count; remaining > 0 && written;)
+				{
+					size_t take = std::min<size_t>(remaining, triangles.size() - filled);
+					written = DX::SeekFile(spill.Get(), at) && fread(&triangles[filled], sizeof(BinnedTriangle), take, spill.Get()) == take;
+					filled += take;
+					at += take * sizeof(BinnedTriangle);
+					remaining -= static_cast<uint32_t>(take);
+					if (filled == triangles.size() && written)
+					{
+						written = writer.Write(triangles.data(), filled);
+						filled = 0;
+					}
+				}
+				runOffset = run.previous;
+			}
+			if (filled > 0 && written)
+			{
+				written = writer.Write(triangles.data(), filled);
+				filled = 0;
+			}
+		}
+		localStats.bufferBytes = std::max<uint64_t>(localStats.bufferBytes,
+			triangles.capacity() * sizeof(BinnedTriangle) + writer.GetBytes() + bins.capacity() * sizeof(Bin));
+
+		const std::vector<MeshChunk>& chunks = writer.GetChunks();
+		header.magic = MESH_CHUNK_MAGIC;
+		header.version = MESH_CHUNK_VERSION;
+		header.sourceKey = sourceKey;
+		header.sourceSize = sourceSize;
+		header.requestedFormat = format;
+		header.chunkCount = static_cast<uint32_t>(chunks.size());
+		header.triangleCount = triangleCount;
+		header.bounds = chunks.empty() ? bounds : chunks[0].bounds;
+		for (const MeshChunk& chunk : chunks)
+		{
+			GrowBounds(header.bounds, chunk.bounds.min);
+			GrowBounds(header.bounds, chunk.bounds.max);
+		}
+		header.tableOffset = writer.GetOffset();
+		header.fileSize = header.tableOffset + chunks.size() * sizeof(MeshChunk);
+		written = written && (chunks.empty() || fwrite(chunks.data(), sizeof(MeshChunk), chunks.size(), file) == chunks.size()) &&
+			DX::SeekFile(file, 0) && fwrite(&header, sizeof(header), 1, file) == 1;
+		localStats.chunkCount = header.chunkCount;
+		localStats.fileBytes = header.fileSize;
+	}
+	written = (fclose(file) == 0) && written;
+	if (!written || !DX::RenameFile(tempPath.c_str(), chunkPath))
+	{
+		DX::RemoveFile(tempPath.c_str());
+		return false;
+	}
+	localStats.writeSeconds = SecondsSince(writeStart);
+
+	if (stats)
+		*stats = localStats;
+	return true;
+}
+
+MeshChunkFile::MeshChunkFile(void) :
+	m_file(nullptr)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+MeshChunkFile::~MeshChunkFile(void)
+{
+	Close();
+}
+
+bool MeshChunkFile::Open(const char* path, uint64_t sourceKey, uint64_t sourceSize, MeshVertexFormat requestedFormat)
+{
+	Close();
+	uint64_t size;
+	if (!DX::GetFileSize(path, size) || size < sizeof(MeshChunkFileHeader))
+		return false;
+	m_file = DX::OpenFile(path, "rb");
+	if (!m_file)
+		return false;
+
+	bool valid = fread(&m_header, sizeof(m_header), 1, m_file) == 1 &&
+		m_header.magic == MESH_CHUNK_MAGIC &&
+		m_header.version == MESH_CHUNK_VERSION &&
+		m_header.sourceKey == sourceKey &&
+		m_header.sourceSize == sourceSize &&
+		m_header.requestedFormat == requestedFormat &&
+		m_header.fileSize == size &&
+		m_header.tableOffset >= sizeof(MeshChunkFileHeader) &&
+		m_header.tableOffset + static_cast<uint64_t>(m_header.chunkCount) * sizeof(MeshChunk) == size;
+	if (valid)
+	{
+		m_chunks.resize(m_header.chunkCount);
+		valid = DX::SeekFile(m_file, m_header.tableOffset) && (m_chunks.empty() || fread(m_chunks.data(), sizeof(MeshChunk), m_chunks.size(), m_file) == m_chunks.size());
+	}
+	for (size_t i = 0; i < m_chunks.size() && valid; ++i)
+	{
+		const MeshChunk& chunk = m_chunks[i];
+		uint64_t vertexBytes = static_cast<uint64_t>(chunk.vertexCount) * (chunk.vertexFormat < MESH_VERTEX_FORMAT_COUNT ?
+			GetMeshVertexStride(static_cast<MeshVertexFormat>(chunk.vertexFormat)) : 0);
+		valid = chunk.vertexFormat < MESH_VERTEX_FORMAT_COUNT &&
+			(chunk.indexSize == 2 || chunk.indexSize == 4) &&
+			(chunk.indexSize == 4 || chunk.vertexCount <= 0x10000) &&
+			chunk.vertexOffset >= sizeof(MeshChunkFileHeader) && chunk.vertexOffset + vertexBytes <= chunk.indexOffset &&
+			chunk.indexOffset + static_cast<uint64_t>(chunk.indexCount) * chunk.indexSize <= m_header.tableOffset;
+	}
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MeshChunkFile::Close(void)
+{
+	if (m_file)
+		fclose(m_file);
+	m_file = nullptr;
+	memset(&m_header, 0, sizeof(m_header));
+	m_chunks.clear();
+}
+
+bool MeshChunkFile::ReadChunk(uint32_t chunk, void* outVertices, void* outIndices)
+{
+	const MeshChunk& entry = m_chunks[chunk];
+	size_t vertexBytes = static_cast<size_t>(entry.vertexCount) * GetMeshVertexStride(static_cast<MeshVertexFormat>(entry.vertexFormat));
+	size_t indexBytes = static_cast<size_t>(entry.indexCount) * entry.indexSize;
+	return m_file &&
+		DX::SeekFile(m_file, entry.vertexOffset) && fread(outVertices, 1, vertexBytes, m_file) == vertexBytes &&
+		DX::SeekFile(m_file, entry.indexOffset) && fread(outIndices, 1, indexBytes, m_file) == indexBytes;
+}
+
+bool DX11UWA::OpenObjChunked(const char* objPath, const char* chunkPath, MeshVertexFormat format, MeshChunkFile& outFile, uint64_t memoryBudget,
+	MeshStreamingStats* stats)
+{
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+	uint64_t sourceKey, sourceSize;
+	if (!ComputeStreamedSourceKey(objPath, sourceKey, sourceSize))
+		return false;
+	if (outFile.Open(chunkPath, sourceKey, sourceSize, format))
+		return true;
+	return ImportObjChunked(objPath, chunkPath, format, memoryBudget, stats) && outFile.Open(chunkPath, sourceKey, sourceSize, format);
+}
+
+MeshChunkPager::MeshChunkPager(void)
+{
+	Reset(nullptr, 0, 0, 0);
+}
+
+void MeshChunkPager::Reset(const MeshChunk* chunks, uint32_t chunkCount, uint64_t budgetBytes, uint32_t maxLoadsPerUpdate)
+{
+	m_chunks = chunks;
+	m_chunkCount = chunkCount;
+	m_budgetBytes = budgetBytes;
+	m_maxLoads = maxLoadsPerUpdate;
+	m_residentBytes = 0;
+	m_frame = 0;
+	m_resident.assign(chunkCount, 0);
+	m_lastSeen.assign(chunkCount, 0);
+	m_wantedFrame.assign(chunkCount, 0);
+	m_distance.assign(chunkCount, 0.0f);
+	m_visible.clear();
+}
+
+void MeshChunkPager::Update(const MeshClusterView& view, std::vector<uint32_t>& outLoads, std::vector<uint32_t>& outEvictions)
+{
+	outLoads.clear();
+	outEvictions.clear();
+	++m_frame;
+
+	// Visible chunks, nearest first by the distance from the eye to their bounds.
+	m_visible.clear();
+	for (uint32_t c = 0; c < m_chunkCount; ++c)
+	{
+		const MeshBounds& bounds = m_chunks[c].bounds;
+		if (!MeshBoundsVisible(view, bounds))
+			continue;
+		float dx = std::max(std::max(bounds.min.x - view.eye.x, view.eye.x - bounds.max.x), 0.0f);
+		float dy = std::max(std::max(bounds.min.y - view.eye.y, view.eye.y - bounds.max.y), 0.0f);
+		float dz = std::max(std::max(bounds.min.z - view.eye.z, view.eye.z - bounds.max.z), 0.0f);
+		m_distance[c] = dx * dx + dy * dy + dz * dz;
+		m_lastSeen[c] = m_frame;
+		m_visible.push_back(c);
+	}
+	std::sort(m_visible.begin(), m_visible.end(), [this](uint32_t a, uint32_t b) { return m_distance[a] < m_distance[b]; });
+
+	// As many of them as fit are wanted; the ones missing are loaded, a few a frame.
+	uint64_t wantedBytes = 0;
+	uint64_t loadBytes = 0;
+	for (uint32_t c : m_visible)
+	{
+		uint64_t bytes = GetMeshChunkBytes(m_chunks[c]);
+		if (wantedBytes + bytes > m_budgetBytes)
+			break;
+		wantedBytes += bytes;
+		m_wantedFrame[c] = m_frame;
+		if (!m_resident[c] && outLoads.size() < m_maxLoads)
+		{
+			outLoads.push_back(c);
+			loadBytes += bytes;
+		}
+	}
+
+	// Make room from the resident chunks nobody wants, seen longest ago first.
+	if (m_residentBytes + loadBytes > m_budgetBytes)
+	{
+		for (uint32_t c = 0; c < m_chunkCount; ++c)
+		{
+			if (m_resident[c] && m_wantedFrame[c] != m_frame)
+				outEvictions.push_back(c);
+		}
+		std::sort(outEvictions.begin(), outEvictions.end(), [this](uint32_t a, uint32_t b) { return m_lastSeen[a] < m_lastSeen[b]; });
+		size_t evictionCount = 0;
+		uint64_t freedBytes = 0;
+		while (evictionCount < outEvictions.size() && m_residentBytes - freedBytes + loadBytes > m_budgetBytes)
+			freedBytes += GetMeshChunkBytes(m_chunks[outEvictions[evictionCount++]]);
+		outEvictions.resize(evictionCount);
+	}
+
+	for (uint32_t c : outEvictions)
+	{
+		m_resident[c] = 0;
+		m_residentBytes -= GetMeshChunkBytes(m_chunks[c]);
+	}
+	for (uint32_t c : outLoads)
+	{
+		m_resident[c] = 1;
+		m_residentBytes += GetMeshChunkBytes(m_chunks[c]);
+	}
+}
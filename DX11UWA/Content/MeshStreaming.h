@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+#include "MeshPacking.h"
+#include "MeshClusters.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace DX11UWA
+{
+	// Chunk file, version 1: a mesh too large to load whole, split into spatial chunks that are
+	// read one at a time. Each chunk holds its own vertices, packed against its own bounds, and
+	// its own indices; the chunk table follows the chunk data. Every field is little-endian.
+	const uint32_t MESH_CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+	const uint32_t MESH_CHUNK_VERSION = 1;
+	const uint32_t MESH_CHUNK_MAX_TRIANGLES = 32768;
+	const uint64_t MESH_STREAMING_DEFAULT_BUDGET = 256ull << 20;
+	const uint64_t MESH_STREAMING_MIN_BUDGET = 32ull << 20;
+
+	struct MeshChunk
+	{
+		MeshBounds			bounds;
+		MeshDecodeConstants	decode;
+		uint64_t			vertexOffset;	// into the chunk file
+		uint64_t			indexOffset;
+		uint32_t			vertexCount;
+		uint32_t			vertexFormat;	// MeshVertexFormat; a chunk that does not pack within tolerance is MESH_VERTEX_FLOAT
+		uint32_t			indexCount;
+		uint32_t			indexSize;
+	};
+
+	struct MeshChunkFileHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	sourceKey;			// ComputeStreamedSourceKey of the OBJ
+		uint64_t	sourceSize;
+		uint32_t	requestedFormat;
+		uint32_t	chunkCount;
+		uint64_t	triangleCount;
+		MeshBounds	bounds;
+		uint64_t	tableOffset;		// MeshChunk[chunkCount]
+		uint64_t	fileSize;
+	};
+
+	struct MeshStreamingStats
+	{
+		uint64_t	sourceBytes;
+		uint64_t	positionCount;
+		uint64_t	triangleCount;
+		uint32_t	gridSize[3];		// cells the triangles were binned into
+		uint32_t	chunkCount;
+		uint32_t	spillFlushes;		// times the triangle pool filled and went to disk
+		uint64_t	spillBytes;			// temporary disk space used
+		uint64_t	fileBytes;			// of the chunk file
+		uint64_t	bufferBytes;		// most memory the import held in its buffers at once
+		double		boundsSeconds;		// first pass over the OBJ
+		double		binSeconds;			// second pass
+		double		writeSeconds;		// building the chunks from the bins
+	};
+
+	// Identifies an OBJ too large to hash whole: its size and a hash of evenly spaced samples
+	// of its bytes. Returns false when the file cannot be read.
+	bool ComputeStreamedSourceKey(const char* objPath, uint64_t& outKey, uint64_t& outSize);
+
+	// Converts an OBJ of any size to a chunk file while holding at most memoryBudget bytes,
+	// which cannot be below MESH_STREAMING_MIN_BUDGET. The first pass reads the bounds and
+	// spills the attributes to disk; the second bins every triangle by its centroid into a grid
+	// sized for about MESH_CHUNK_MAX_TRIANGLES / 2 triangles a cell, spilling full bins to disk
+	// too. Each bin then becomes one or more welded, cache-optimized chunks. Temporary files go
+	// next to chunkPath and the chunk file is written under a temporary name and renamed.
+	bool ImportObjChunked(const char* objPath, const char* chunkPath, MeshVertexFormat format, uint64_t memoryBudget = MESH_STREAMING_DEFAULT_BUDGET,
+		MeshStreamingStats* stats = nullptr);
+
+	inline uint64_t GetMeshChunkBytes(const MeshChunk& chunk)
+	{
+		return static_cast<uint64_t>(chunk.vertexCount) * GetMeshVertexStride(static_cast<MeshVertexFormat>(chunk.vertexFormat)) +
+			static_cast<uint64_t>(chunk.indexCount) * chunk.indexSize;
+	}
+
+	// An open chunk file. Only the header and chunk table are kept in memory; chunks are read on demand.
+	class MeshChunkFile
+	{
+	public:
+		MeshChunkFile(void);
+		~MeshChunkFile(void);
+
+		// Validates the file against the source and format request it was built from.
+		bool Open(const char* path, uint64_t sourceKey, uint64_t sourceSize, MeshVertexFormat requestedFormat);
+		void Close(void);
+		// Reads a chunk's vertices and indices, in the format and size its MeshChunk gives.
+		bool ReadChunk(uint32_t chunk, void* outVertices, void* outIndices);
+
+		bool IsOpen(void) const							{ return m_file != nullptr; }
+		uint32_t GetChunkCount(void) const				{ return static_cast<uint32_t>(m_chunks.size()); }
+		const MeshChunk& GetChunk(uint32_t chunk) const	{ return m_chunks[chunk]; }
+		const MeshChunk* GetChunks(void) const			{ return m_chunks.data(); }
+		const MeshBounds& GetBounds(void) const			{ return m_header.bounds; }
+		uint64_t GetTriangleCount(void) const			{ return m_header.triangleCount; }
+
+	private:
+		MeshChunkFile(const MeshChunkFile&);
+		MeshChunkFile& operator=(const MeshChunkFile&);
+
+		FILE*					m_file;
+		MeshChunkFileHeader		m_header;
+		std::vector<MeshChunk>	m_chunks;
+	};
+
+	// Opens the chunk file of an OBJ, importing it first when the file is missing or was built
+	// from different bytes or for another format.
+	bool OpenObjChunked(const char* objPath, const char* chunkPath, MeshVertexFormat format, MeshChunkFile& outFile, uint64_t memoryBudget = MESH_STREAMING_DEFAULT_BUDGET,
+		MeshStreamingStats* stats = nullptr);
+
+	// Decides which chunks of a streamed mesh are resident. Visible chunks are wanted nearest
+	// first, as many as fit the budget. Chunks that leave the view stay resident until their
+	// room is needed, and then the ones seen longest ago go first.
+	class MeshChunkPager
+	{
+	public:
+		MeshChunkPager(void);
+
+		void Reset(const MeshChunk* chunks, uint32_t chunkCount, uint64_t budgetBytes, uint32_t maxLoadsPerUpdate);
+		// Fills outLoads with the chunks to read this frame, nearest first, and outEvictions with
+		// the chunks to release before them. Both are applied to the resident set straight away.
+		void Update(const MeshClusterView& view, std::vector<uint32_t>& outLoads, std::vector<uint32_t>& outEvictions);
+
+		bool IsResident(uint32_t chunk) const	{ return m_resident[chunk] != 0; }
+		uint64_t GetResidentBytes(void) const	{ return m_residentBytes; }
+		uint32_t GetVisibleCount(void) const	{ return static_cast<uint32_t>(m_visible.size()); }
+
+	private:
+		const MeshChunk*		m_chunks;
+		uint32_t				m_chunkCount;
+		uint64_t				m_budgetBytes;
+		uint32_t				m_maxLoads;
+		uint64_t				m_residentBytes;
+		uint32_t				m_frame;
+		std::vector<uint8_t>	m_resident;
+		std::vector<uint32_t>	m_lastSeen;		// frame each chunk was last visible
+		std::vector<uint32_t>	m_wantedFrame;	// frame each chunk was last wanted
+		std::vector<uint32_t>	m_visible;
+		std::vector<float>		m_distance;
+	};
+}
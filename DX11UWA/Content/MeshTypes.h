@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DX11UWA
+{
+	// Plain float triple with the same layout as DirectX::XMFLOAT3. The mesh
+	// import code uses it so that it builds without DirectXMath.
+	struct MeshFloat3
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	// Layout-compatible with VertexPositionUVNormal in ShaderStructures.h.
+	struct MeshVertex
+	{
+		MeshFloat3 pos;
+		MeshFloat3 uv;
+		MeshFloat3 normal;
+	};
+
+	// Axis-aligned bounding box.
+	struct MeshBounds
+	{
+		MeshFloat3 min;
+		MeshFloat3 max;
+	};
+
+	const uint32_t MESH_NAME_LENGTH = 64;
+	const uint32_t MESH_PATH_LENGTH = 128;
+	const uint32_t MESH_NO_MATERIAL = ~0u;
+
+	// Surface description read from a .mtl file. Statements a material leaves out keep the
+	// values of a plain white diffuse surface.
+	struct MeshMaterial
+	{
+		char		name[MESH_NAME_LENGTH];
+		MeshFloat3	ambient;						// Ka
+		MeshFloat3	diffuse;						// Kd
+		MeshFloat3	specular;						// Ks
+		float		specularPower;					// Ns
+		float		opacity;						// d, or 1 - Tr
+		char		diffuseMap[MESH_PATH_LENGTH];	// map_Kd, relative to the .mtl file; empty when absent
+	};
+
+	// A part of a mesh that is drawn with one material. Its triangles in every LOD are listed
+	// separately, since each LOD is a different range of the index array.
+	struct MeshSubmesh
+	{
+		char		name[MESH_NAME_LENGTH];		// OBJ group or object name, truncated
+		char		material[MESH_NAME_LENGTH];	// usemtl name, truncated
+		uint32_t	materialIndex;				// into the mesh's materials, or MESH_NO_MATERIAL
+		MeshBounds	bounds;						// of its triangles in every LOD
+	};
+
+	inline MeshBounds ComputeMeshBounds(const MeshVertex* vertices, size_t count)
+	{
+		MeshBounds bounds = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		if (count == 0)
+			return bounds;
+
+		bounds.min = bounds.max = vertices[0].pos;
+		for (size_t i = 1; i < count; ++i)
+		{
+			const MeshFloat3& p = vertices[i].pos;
+			bounds.min.x = p.x < bounds.min.x ? p.x : bounds.min.x;
+			bounds.min.y = p.y < bounds.min.y ? p.y : bounds.min.y;
+			bounds.min.z = p.z < bounds.min.z ? p.z : bounds.min.z;
+			bounds.max.x = p.x > bounds.max.x ? p.x : bounds.max.x;
+			bounds.max.y = p.y > bounds.max.y ? p.y : bounds.max.y;
+			bounds.max.z = p.z > bounds.max.z ? p.z : bounds.max.z;
+		}
+		return bounds;
+	}
+
+	// Bounds of the vertices a range of indices references.
+	inline MeshBounds ComputeMeshBounds(const MeshVertex* vertices, const uint32_t* indices, size_t indexCount)
+	{
+		MeshBounds bounds = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		if (indexCount == 0)
+			return bounds;
+
+		bounds.min = bounds.max = vertices[indices[0]].pos;
+		for (size_t i = 1; i < indexCount; ++i)
+		{
+			const MeshFloat3& p = vertices[indices[i]].pos;
+			bounds.min.x = p.x < bounds.min.x ? p.x : bounds.min.x;
+			bounds.min.y = p.y < bounds.min.y ? p.y : bounds.min.y;
+			bounds.min.z = p.z < bounds.min.z ? p.z : bounds.min.z;
+			bounds.max.x = p.x > bounds.max.x ? p.x : bounds.max.x;
+			bounds.max.y = p.y > bounds.max.y ? p.y : bounds.max.y;
+			bounds.max.z = p.z > bounds.max.z ? p.z : bounds.max.z;
+		}
+		return bounds;
+	}
+}
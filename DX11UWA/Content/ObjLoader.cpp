@@ -0,0 +1,1010 @@
+﻿#include "ObjLoader.h"
+
+#include "../Common/CompressedFile.h"
+#include "../Common/FileIO.h"
+#include "../Common/LinearArena.h"
+#include "../Common/MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace DX11UWA;
+using DX::ArenaVector;
+
+namespace
+{
+	const double kPowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return static_cast<unsigned char>(c - '0') < 10;
+	}
+
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && IsBlank(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* FindLineEnd(const char* p, const char* end)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newline ? newline : end;
+	}
+
+	// Slow path for anything the fast parser does not understand (nan, inf, very long mantissas).
+	const char* ParseFloatFallback(const char* p, const char* end, float& out)
+	{
+		char buffer[64];
+		size_t length = 0;
+		while (p + length < end && length < sizeof(buffer) - 1 && !IsBlank(p[length]) && p[length] != '\n')
+		{
+			buffer[length] = p[length];
+			++length;
+		}
+		buffer[length] = '\0';
+
+		char* parsedEnd = nullptr;
+		out = strtof(buffer, &parsedEnd);
+		if (parsedEnd == buffer)
+			return nullptr;
+		return p + (parsedEnd - buffer);
+	}
+
+	// Parses a decimal float without locale lookups or null termination.
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		const char* digitsStart = p;
+
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa)
+					++significantDigits;
+			}
+			else
+			{
+				++exponent;
+			}
+		}
+
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p)
+			{
+				if (significantDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa)
+						++significantDigits;
+					--exponent;
+				}
+			}
+		}
+
+		if (p == digitsStart || (p == digitsStart + 1 && *digitsStart == '.'))
+			return ParseFloatFallback(start, end, out);
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* exponentStart = p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = *p == '-';
+				++p;
+			}
+			if (p < end && IsDigit(*p))
+			{
+				int value = 0;
+				for (; p < end && IsDigit(*p); ++p)
+				{
+					if (value < 10000)
+						value = value * 10 + (*p - '0');
+				}
+				exponent += negativeExponent ? -value : value;
+			}
+			else
+			{
+				p = exponentStart;
+			}
+		}
+
+		double value = static_cast<double>(mantissa);
+		if (exponent < 0)
+		{
+			if (exponent >= -22)
+				value /= kPowersOfTen[-exponent];
+			else
+				return ParseFloatFallback(start, end, out);
+		}
+		else if (exponent > 0)
+		{
+			if (exponent <= 22)
+				value *= kPowersOfTen[exponent];
+			else
+				return ParseFloatFallback(start, end, out);
+		}
+
+		out = static_cast<float>(negative ? -value : value);
+		return p;
+	}
+
+	inline const char* ParseInt(const char* p, const char* end, int32_t& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+		if (p >= end || !IsDigit(*p))
+			return nullptr;
+
+		int64_t value = 0;
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			value = value * 10 + (*p - '0');
+			if (value > INT32_MAX)
+				return nullptr;
+		}
+		out = static_cast<int32_t>(negative ? -value : value);
+		return p;
+	}
+
+	inline uint32_t HashCorner(const ObjCorner& corner)
+	{
+		uint32_t hash = static_cast<uint32_t>(corner.position) * 0x9E3779B1u;
+		hash ^= static_cast<uint32_t>(corner.uv) * 0x85EBCA77u;
+		hash ^= static_cast<uint32_t>(corner.normal) * 0xC2B2AE3Du;
+		return hash ^ (hash >> 16);
+	}
+
+	inline bool SameCorner(const ObjCorner& a, const ObjCorner& b)
+	{
+		return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+	}
+
+	// OBJ indices are 1-based, and negative values count back from the most recent element.
+	// Negative references are resolved against the chunk-local count; the caller records them
+	// so the chunk's global base can be added once every chunk has been counted, and rejects any
+	// that still come out negative. Index 0 refers to nothing and is rejected by ParseCorner.
+	inline int32_t ResolveIndex(int32_t index, size_t localCount, bool& relative)
+	{
+		relative = index < 0;
+		if (index > 0)
+			return index - 1;
+		return static_cast<int32_t>(localCount) + index;
+	}
+
+	// Returns a mask of the attributes (bit 0 position, 1 uv, 2 normal) that were relative references.
+	const char* ParseCorner(const char* p, const char* end, size_t positions, size_t uvs, size_t normals, ObjCorner& corner, uint32_t& relativeMask)
+	{
+		bool relative = false;
+		int32_t index = 0;
+		relativeMask = 0;
+
+		p = ParseInt(p, end, index);
+		if (!p || index == 0)
+			return nullptr;
+		corner.position = ResolveIndex(index, positions, relative);
+		relativeMask |= relative ? 1 : 0;
+		corner.uv = -1;
+		corner.normal = -1;
+
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (p < end && *p != '/')
+			{
+				p = ParseInt(p, end, index);
+				if (!p || index == 0)
+					return nullptr;
+				corner.uv = ResolveIndex(index, uvs, relative);
+				relativeMask |= relative ? 2 : 0;
+			}
+			if (p < end && *p == '/')
+			{
+				++p;
+				p = ParseInt(p, end, index);
+				if (!p || index == 0)
+					return nullptr;
+				corner.normal = ResolveIndex(index, normals, relative);
+				relativeMask |= relative ? 4 : 0;
+			}
+		}
+		return p;
+	}
+
+	// Whether every relative reference in relativeMask resolved to an element, now that the
+	// corner's indices are global. A negative one reached back past the first element, and would
+	// otherwise read as no attribute at all.
+	inline bool HasValidReferences(const ObjCorner& corner, uint32_t relativeMask)
+	{
+		return !((relativeMask & 1) && corner.position < 0) && !((relativeMask & 2) && corner.uv < 0) && !((relativeMask & 4) && corner.normal < 0);
+	}
+
+	// A one or two letter keyword followed by a blank or the end of the line. What follows it
+	// starts at p + 1 or p + 2, which is never past end.
+	inline bool IsKeyword(const char* p, const char* end, char a, char b)
+	{
+		if (b == 0)
+			return p < end && p[0] == a && (p + 1 == end || IsBlank(p[1]));
+		return p + 1 < end && p[0] == a && p[1] == b && (p + 2 == end || IsBlank(p[2]));
+	}
+
+	// Matches a whole-word statement keyword and returns what follows it, or nullptr.
+	inline const char* MatchStatement(const char* p, const char* end, const char* keyword)
+	{
+		size_t length = strlen(keyword);
+		if (static_cast<size_t>(end - p) < length || memcmp(p, keyword, length) != 0)
+			return nullptr;
+		if (p + length < end && !IsBlank(p[length]))
+			return nullptr;
+		return p + length;
+	}
+
+	// The rest of a line without its surrounding blanks.
+	std::string ReadText(const char* p, const char* end)
+	{
+		p = SkipBlanks(p, end);
+		while (end > p && IsBlank(end[-1]))
+			--end;
+		return std::string(p, end);
+	}
+
+	// Copies text into a fixed-size name field, truncating it.
+	template <size_t Size>
+	void CopyName(char (&out)[Size], const std::string& text)
+	{
+		size_t length = std::min(text.size(), Size - 1);
+		memcpy(out, text.data(), length);
+		out[length] = '\0';
+	}
+
+	// First pass: count records so every array can be allocated exactly once.
+	void CountRecords(const char* p, const char* end, size_t& positions, size_t& uvs, size_t& normals, size_t& faces)
+	{
+		positions = uvs = normals = faces = 0;
+		while (p < end)
+		{
+			const char* lineEnd = FindLineEnd(p, end);
+			p = SkipBlanks(p, lineEnd);
+			if (IsKeyword(p, lineEnd, 'v', 0))
+				++positions;
+			else if (IsKeyword(p, lineEnd, 'v', 't'))
+				++uvs;
+			else if (IsKeyword(p, lineEnd, 'v', 'n'))
+				++normals;
+			else if (IsKeyword(p, lineEnd, 'f', 0))
+				++faces;
+			p = lineEnd + 1;
+		}
+	}
+
+	const char* ParseFloats(const char* p, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			p = SkipBlanks(p, end);
+			p = ParseFloat(p, end, out[i]);
+			if (!p)
+				return nullptr;
+		}
+		return p;
+	}
+
+	// A g, o, usemtl or mtllib statement and the number of corners read before it.
+	struct ObjStatement
+	{
+		size_t		corner;
+		char		kind;	// 'g' for g and o, 'u' for usemtl, 'l' for mtllib
+		std::string	text;
+	};
+
+	// Everything parsed from one line-aligned slice of the file.
+	struct ObjChunk
+	{
+		ArenaVector<MeshFloat3>		positions;
+		ArenaVector<MeshFloat3>		uvs;
+		ArenaVector<MeshFloat3>		normals;
+		ArenaVector<ObjCorner>		corners;
+		ArenaVector<uint32_t>		relativeRefs;	// corner * 3 + attribute for each negative reference
+		ArenaVector<ObjStatement>	statements;
+		bool						succeeded;
+	};
+
+	inline void PushStatement(ObjChunk& chunk, char kind, const char* p, const char* end)
+	{
+		ObjStatement statement = { chunk.corners.size(), kind, ReadText(p, end) };
+		chunk.statements.push_back(statement);
+	}
+
+	// Turns the statements that split the faces into runs of indices. A run only ends when the
+	// name or material actually changes, and empty runs are dropped.
+	void BuildLayout(const ArenaVector<ObjStatement>& statements, size_t cornerCount, size_t baseIndex, ObjLayout& layout)
+	{
+		std::string name;
+		std::string material;
+		size_t start = 0;
+		auto flush = [&](size_t end)
+		{
+			if (end > start)
+			{
+				ObjGroup group = { static_cast<uint32_t>(baseIndex + start), static_cast<uint32_t>(end - start), name, material };
+				layout.groups.push_back(group);
+			}
+			start = end;
+		};
+
+		for (const ObjStatement& statement : statements)
+		{
+			if (statement.kind == 'l')
+			{
+				// mtllib may list several files.
+				const char* p = statement.text.c_str();
+				const char* end = p + statement.text.size();
+				while ((p = SkipBlanks(p, end)) < end)
+				{
+					const char* word = p;
+					while (p < end && !IsBlank(*p))
+						++p;
+					layout.materialLibraries.push_back(std::string(word, p));
+				}
+				continue;
+			}
+
+			std::string& field = statement.kind == 'g' ? name : material;
+			if (field == statement.text)
+				continue;
+			flush(statement.corner);
+			field = statement.text;
+		}
+		flush(cornerCount);
+	}
+
+	inline void PushCorner(ObjChunk& chunk, const ObjCorner& corner, uint32_t relativeMask)
+	{
+		uint32_t slot = static_cast<uint32_t>(chunk.corners.size()) * 3;
+		for (uint32_t attribute = 0; attribute < 3; ++attribute)
+		{
+			if (relativeMask & (1 << attribute))
+				chunk.relativeRefs.push_back(slot + attribute);
+		}
+		chunk.corners.push_back(corner);
+	}
+
+	bool ParseChunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		size_t positionCount, uvCount, normalCount, faceCount;
+		CountRecords(p, end, positionCount, uvCount, normalCount, faceCount);
+
+		chunk.positions.reserve(positionCount);
+		chunk.uvs.reserve(uvCount);
+		chunk.normals.reserve(normalCount);
+		chunk.corners.reserve(faceCount * 3);
+
+		while (p < end)
+		{
+			const char* lineEnd = FindLineEnd(p, end);
+			p = SkipBlanks(p, lineEnd);
+
+			if (IsKeyword(p, lineEnd, 'v', 0))
+			{
+				MeshFloat3 position;
+				if (!ParseFloats(p + 1, lineEnd, &position.x, 3))
+					return false;
+				chunk.positions.push_back(position);
+			}
+			else if (IsKeyword(p, lineEnd, 'v', 't'))
+			{
+				MeshFloat3 uv = { 0.0f, 0.0f, 0.0f };
+				if (!ParseFloats(p + 2, lineEnd, &uv.x, 2))
+					return false;
+				uv.y = 1 - uv.y;
+				chunk.uvs.push_back(uv);
+			}
+			else if (IsKeyword(p, lineEnd, 'v', 'n'))
+			{
+				MeshFloat3 normal;
+				if (!ParseFloats(p + 2, lineEnd, &normal.x, 3))
+					return false;
+				chunk.normals.push_back(normal);
+			}
+			else if (IsKeyword(p, lineEnd, 'g', 0) || IsKeyword(p, lineEnd, 'o', 0))
+			{
+				PushStatement(chunk, 'g', p + 1, lineEnd);
+			}
+			else if (const char* text = MatchStatement(p, lineEnd, "usemtl"))
+			{
+				PushStatement(chunk, 'u', text, lineEnd);
+			}
+			else if (const char* text = MatchStatement(p, lineEnd, "mtllib"))
+			{
+				PushStatement(chunk, 'l', text, lineEnd);
+			}
+			else if (IsKeyword(p, lineEnd, 'f', 0))
+			{
+				// Polygons are split into a triangle fan around their first corner.
+				ObjCorner first, previous, current;
+				uint32_t firstMask = 0, previousMask = 0, currentMask = 0;
+				int cornerCount = 0;
+				const char* q = SkipBlanks(p + 1, lineEnd);
+				while (q < lineEnd)
+				{
+					q = ParseCorner(q, lineEnd, chunk.positions.size(), chunk.uvs.size(), chunk.normals.size(), current, currentMask);
+					if (!q)
+						return false;
+
+					if (cornerCount == 0)
+					{
+						first = current;
+						firstMask = currentMask;
+					}
+					else if (cornerCount >= 2)
+					{
+						PushCorner(chunk, first, firstMask);
+						PushCorner(chunk, previous, previousMask);
+						PushCorner(chunk, current, currentMask);
+					}
+					previous = current;
+					previousMask = currentMask;
+					++cornerCount;
+					q = SkipBlanks(q, lineEnd);
+				}
+				if (cornerCount < 3)
+					return false;
+			}
+
+			p = lineEnd + 1;
+		}
+
+		return true;
+	}
+
+	// Runs work(0..count-1), one call per thread, with call 0 on the calling thread.
+	template <typename Work>
+	void RunParallel(unsigned int count, const Work& work)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(count > 0 ? count - 1 : 0);
+		for (unsigned int i = 1; i < count; ++i)
+			threads.push_back(std::thread([&work, i]() { work(i); }));
+		if (count > 0)
+			work(0);
+		for (size_t i = 0; i < threads.size(); ++i)
+			threads[i].join();
+	}
+
+	unsigned int ResolveThreadCount(unsigned int threadCount)
+	{
+		return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	unsigned int ChooseChunkCount(size_t length, unsigned int threadCount)
+	{
+		// Below this size thread start-up costs more than it saves.
+		const size_t minimumChunkBytes = 256 * 1024;
+
+		size_t byBytes = std::max<size_t>(1, length / minimumChunkBytes);
+		return static_cast<unsigned int>(std::min<size_t>(ResolveThreadCount(threadCount), byBytes));
+	}
+
+	// Parses text into chunkCount more chunks in parallel, split at line boundaries so that every
+	// record lands in exactly one chunk.
+	bool ParseChunks(const char* text, size_t length, unsigned int chunkCount, ArenaVector<ObjChunk>& chunks)
+	{
+		const char* end = text + length;
+		ArenaVector<const char*> bounds(chunkCount + 1);
+		bounds[0] = text;
+		bounds[chunkCount] = end;
+		for (unsigned int i = 1; i < chunkCount; ++i)
+		{
+			const char* split = std::max(text + (length / chunkCount) * i, bounds[i - 1]);
+			split = FindLineEnd(split, end);
+			bounds[i] = split < end ? split + 1 : end;
+		}
+
+		size_t first = chunks.size();
+		chunks.resize(first + chunkCount);
+		RunParallel(chunkCount, [&](unsigned int i)
+		{
+			ObjChunk& chunk = chunks[first + i];
+			chunk.succeeded = ParseChunk(bounds[i], bounds[i + 1], chunk);
+		});
+
+		for (size_t i = first; i < chunks.size(); ++i)
+		{
+			if (!chunks[i].succeeded)
+				return false;
+		}
+		return true;
+	}
+
+	// Joins the chunks in file order and welds their corners into the output mesh. Chunks are
+	// copied on up to threadCount threads, each taking every threadCount-th chunk.
+	bool BuildMesh(ArenaVector<ObjChunk>& chunks, unsigned int threadCount, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices,
+		ObjLoadStats* stats, ObjLayout* outLayout)
+	{
+		const size_t chunkCount = chunks.size();
+		const unsigned int workerCount = static_cast<unsigned int>(std::min<size_t>(std::max<size_t>(chunkCount, 1), ResolveThreadCount(threadCount)));
+
+		ArenaVector<MeshFloat3> positions;
+		ArenaVector<MeshFloat3> uvs;
+		ArenaVector<MeshFloat3> normals;
+		ArenaVector<ObjCorner> corners;
+		ArenaVector<ObjStatement> statements;
+
+		if (chunkCount == 1)
+		{
+			positions.swap(chunks[0].positions);
+			uvs.swap(chunks[0].uvs);
+			normals.swap(chunks[0].normals);
+			corners.swap(chunks[0].corners);
+			statements.swap(chunks[0].statements);
+			for (uint32_t slot : chunks[0].relativeRefs)
+			{
+				const ObjCorner& corner = corners[slot / 3];
+				if ((slot % 3 == 0 ? corner.position : slot % 3 == 1 ? corner.uv : corner.normal) < 0)
+					return false;
+			}
+		}
+		else
+		{
+			// Prefix sums give each chunk its offset in the merged arrays, which is also
+			// the base that its relative (negative) references were missing.
+			ArenaVector<size_t> positionBase(chunkCount), uvBase(chunkCount), normalBase(chunkCount), cornerBase(chunkCount);
+			size_t positionTotal = 0, uvTotal = 0, normalTotal = 0, cornerTotal = 0;
+			for (size_t i = 0; i < chunkCount; ++i)
+			{
+				positionBase[i] = positionTotal;
+				uvBase[i] = uvTotal;
+				normalBase[i] = normalTotal;
+				cornerBase[i] = cornerTotal;
+				positionTotal += chunks[i].positions.size();
+				uvTotal += chunks[i].uvs.size();
+				normalTotal += chunks[i].normals.size();
+				cornerTotal += chunks[i].corners.size();
+				for (ObjStatement& statement : chunks[i].statements)
+				{
+					statement.corner += cornerBase[i];
+					statements.push_back(std::move(statement));
+				}
+			}
+
+			positions.resize(positionTotal);
+			uvs.resize(uvTotal);
+			normals.resize(normalTotal);
+			corners.resize(cornerTotal);
+
+			// Set for chunks with a relative reference that reaches back past the first element.
+			ArenaVector<uint8_t> invalid(chunkCount, 0);
+
+			RunParallel(workerCount, [&](unsigned int worker)
+			{
+				for (size_t i = worker; i < chunkCount; i += workerCount)
+				{
+					ObjChunk& chunk = chunks[i];
+					std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i]);
+					std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBase[i]);
+					std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i]);
+
+					ObjCorner* chunkCorners = corners.data() + cornerBase[i];
+					std::copy(chunk.corners.begin(), chunk.corners.end(), chunkCorners);
+					for (size_t r = 0; r < chunk.relativeRefs.size(); ++r)
+					{
+						ObjCorner& corner = chunkCorners[chunk.relativeRefs[r] / 3];
+						const uint32_t attribute = chunk.relativeRefs[r] % 3;
+						int32_t& index = attribute == 0 ? corner.position : attribute == 1 ? corner.uv : corner.normal;
+						index += static_cast<int32_t>(attribute == 0 ? positionBase[i] : attribute == 1 ? uvBase[i] : normalBase[i]);
+						invalid[i] |= index < 0 ? 1 : 0;
+					}
+
+					chunk = ObjChunk();
+				}
+			});
+			if (std::find(invalid.begin(), invalid.end(), 1) != invalid.end())
+				return false;
+		}
+
+		for (size_t i = 0; i < corners.size(); ++i)
+		{
+			const ObjCorner& corner = corners[i];
+			if (corner.position < 0 || static_cast<size_t>(corner.position) >= positions.size() ||
+				corner.uv < -1 || corner.uv >= static_cast<int32_t>(uvs.size()) ||
+				corner.normal < -1 || corner.normal >= static_cast<int32_t>(normals.size()))
+			{
+				return false;
+			}
+		}
+
+		// Weld corners that reference the same position/uv/normal triple into one vertex.
+		// The table is open-addressed and at most half full, so probes stay short.
+		size_t tableSize = 16;
+		while (tableSize < corners.size() * 2)
+			tableSize *= 2;
+		const uint32_t emptySlot = UINT32_MAX;
+		ArenaVector<uint32_t> table(tableSize, emptySlot);
+		ArenaVector<ObjCorner> uniqueCorners;
+		uniqueCorners.reserve(corners.size() / 2);
+
+		size_t baseVertex = outVertices.size();
+		size_t baseIndex = outIndices.size();
+		outIndices.reserve(outIndices.size() + corners.size());
+
+		for (size_t i = 0; i < corners.size(); ++i)
+		{
+			const ObjCorner& corner = corners[i];
+			size_t slot = HashCorner(corner) & (tableSize - 1);
+			while (table[slot] != emptySlot && !SameCorner(uniqueCorners[table[slot]], corner))
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == emptySlot)
+			{
+				table[slot] = static_cast<uint32_t>(uniqueCorners.size());
+				uniqueCorners.push_back(corner);
+			}
+			outIndices.push_back(static_cast<uint32_t>(baseVertex + table[slot]));
+		}
+
+		const MeshFloat3 zero = { 0.0f, 0.0f, 0.0f };
+		outVertices.resize(baseVertex + uniqueCorners.size());
+		for (size_t i = 0; i < uniqueCorners.size(); ++i)
+		{
+			const ObjCorner& corner = uniqueCorners[i];
+			MeshVertex& vertex = outVertices[baseVertex + i];
+			vertex.pos = positions[corner.position];
+			vertex.uv = corner.uv >= 0 ? uvs[corner.uv] : zero;
+			vertex.normal = corner.normal >= 0 ? normals[corner.normal] : zero;
+		}
+
+		if (outLayout)
+			BuildLayout(statements, corners.size(), baseIndex, *outLayout);
+
+		if (stats)
+		{
+			stats->positionCount = static_cast<uint32_t>(positions.size());
+			stats->uvCount = static_cast<uint32_t>(uvs.size());
+			stats->normalCount = static_cast<uint32_t>(normals.size());
+			stats->triangleCount = static_cast<uint32_t>(corners.size() / 3);
+			stats->cornerCount = static_cast<uint32_t>(corners.size());
+			stats->vertexCount = static_cast<uint32_t>(uniqueCorners.size());
+			stats->threadCount = workerCount;
+		}
+		return true;
+	}
+
+	// Parses OBJ text as it is decompressed, a window at a time. The complete lines of each window
+	// become chunks of their own; the partial line at its end is carried into the next.
+	bool ParseObjStream(DX::CompressedFile& source, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats,
+		unsigned int threadCount, ObjLayout* outLayout)
+	{
+		// Bounds the longest line, like ObjStreamReader's buffer.
+		const size_t windowBytes = 4 << 20;
+
+		DX::LinearArena::Frame arenaFrame;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		ArenaVector<char> window(windowBytes);
+		ArenaVector<ObjChunk> chunks;
+		size_t used = 0;
+		for (;;)
+		{
+			used += source.Read(window.data() + used, windowBytes - used);
+			if (source.HasFailed())
+				return false;
+
+			bool atEnd = used < windowBytes;
+			size_t complete = used;
+			if (!atEnd)
+			{
+				while (complete > 0 && window[complete - 1] != '\n')
+					--complete;
+				if (complete == 0)
+					return false;
+			}
+			if (!ParseChunks(window.data(), complete, ChooseChunkCount(complete, threadCount), chunks))
+				return false;
+			if (atEnd)
+				break;
+
+			memmove(window.data(), window.data() + complete, used - complete);
+			used -= complete;
+		}
+
+		if (!BuildMesh(chunks, threadCount, outVertices, outIndices, stats, outLayout))
+			return false;
+
+		if (stats)
+		{
+			stats->fileBytes = source.GetBytesRead();
+			stats->compressedBytes = source.GetInputBytes();
+			stats->parseSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+		return true;
+	}
+}
+
+bool DX11UWA::ParseObj(const char* text, size_t length, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats, unsigned int threadCount,
+	ObjLayout* outLayout)
+{
+	DX::LinearArena::Frame arenaFrame;
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	ArenaVector<ObjChunk> chunks;
+	unsigned int chunkCount = ChooseChunkCount(length, threadCount);
+	if (!ParseChunks(text, length, chunkCount, chunks) || !BuildMesh(chunks, chunkCount, outVertices, outIndices, stats, outLayout))
+		return false;
+
+	if (stats)
+	{
+		stats->fileBytes = length;
+		stats->compressedBytes = 0;
+		stats->parseSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	return true;
+}
+
+bool DX11UWA::ParseObjSource(const void* data, size_t size, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats,
+	unsigned int threadCount, ObjLayout* outLayout)
+{
+	if (DX::DetectCompression(data, size) == DX::COMPRESSION_NONE)
+		return ParseObj(static_cast<const char*>(data), size, outVertices, outIndices, stats, threadCount, outLayout);
+
+	DX::CompressedFile source;
+	return source.Open(data, size) && ParseObjStream(source, outVertices, outIndices, stats, threadCount, outLayout);
+}
+
+bool DX11UWA::LoadObjFile(const char* path, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats, unsigned int threadCount,
+	ObjLayout* outLayout)
+{
+	DX::MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	if (file.GetSize() > SIZE_MAX)
+		return false;
+
+	return ParseObjSource(file.GetData(), static_cast<size_t>(file.GetSize()), outVertices, outIndices, stats, threadCount, outLayout);
+}
+
+bool DX11UWA::ParseMtl(const char* text, size_t length, std::vector<MeshMaterial>& outMaterials)
+{
+	const char* p = text;
+	const char* end = text + length;
+	MeshMaterial* material = nullptr;
+
+	while (p < end)
+	{
+		const char* lineEnd = FindLineEnd(p, end);
+		p = SkipBlanks(p, lineEnd);
+
+		if (const char* name = MatchStatement(p, lineEnd, "newmtl"))
+		{
+			MeshMaterial defaults;
+			memset(&defaults, 0, sizeof(defaults));
+			defaults.diffuse.x = defaults.diffuse.y = defaults.diffuse.z = 1.0f;
+			defaults.opacity = 1.0f;
+			CopyName(defaults.name, ReadText(name, lineEnd));
+			outMaterials.push_back(defaults);
+			material = &outMaterials.back();
+		}
+		else if (material && (IsKeyword(p, lineEnd, 'K', 'a') || IsKeyword(p, lineEnd, 'K', 'd') || IsKeyword(p, lineEnd, 'K', 's')))
+		{
+			MeshFloat3& color = p[1] == 'a' ? material->ambient : p[1] == 'd' ? material->diffuse : material->specular;
+			// A lone value is grey; green and blue default to red.
+			const char* q = ParseFloats(p + 2, lineEnd, &color.x, 1);
+			if (!q)
+				return false;
+			color.y = color.z = color.x;
+			if (SkipBlanks(q, lineEnd) < lineEnd && !ParseFloats(q, lineEnd, &color.y, 2))
+				return false;
+		}
+		else if (material && IsKeyword(p, lineEnd, 'N', 's'))
+		{
+			if (!ParseFloats(p + 2, lineEnd, &material->specularPower, 1))
+				return false;
+		}
+		else if (material && IsKeyword(p, lineEnd, 'd', 0))
+		{
+			const char* q = SkipBlanks(p + 1, lineEnd);
+			if (const char* halo = MatchStatement(q, lineEnd, "-halo"))
+				q = halo;
+			if (!ParseFloats(q, lineEnd, &material->opacity, 1))
+				return false;
+		}
+		else if (material && IsKeyword(p, lineEnd, 'T', 'r'))
+		{
+			float transparency = 0.0f;
+			if (!ParseFloats(p + 2, lineEnd, &transparency, 1))
+				return false;
+			material->opacity = 1.0f - transparency;
+		}
+		else if (const char* map = material ? MatchStatement(p, lineEnd, "map_Kd") : nullptr)
+		{
+			// Options such as -s or -o come first; the file name is the last word.
+			std::string arguments = ReadText(map, lineEnd);
+			size_t split = arguments.find_last_of(" \t");
+			CopyName(material->diffuseMap, split == std::string::npos ? arguments : arguments.substr(split + 1));
+		}
+
+		p = lineEnd + 1;
+	}
+
+	return true;
+}
+
+bool DX11UWA::LoadMtlFile(const char* path, std::vector<MeshMaterial>& outMaterials)
+{
+	DX::MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	if (file.GetSize() > SIZE_MAX)
+		return false;
+
+	return ParseMtl(reinterpret_cast<const char*>(file.GetData()), static_cast<size_t>(file.GetSize()), outMaterials);
+}
+
+ObjStreamReader::ObjStreamReader(void) :
+	m_begin(0),
+	m_end(0),
+	m_atEnd(false),
+	m_fileSize(0),
+	m_bytesRead(0),
+	m_positionCount(0),
+	m_uvCount(0),
+	m_normalCount(0),
+	m_faceNext(0)
+{
+}
+
+ObjStreamReader::~ObjStreamReader(void)
+{
+	Close();
+}
+
+bool ObjStreamReader::Open(const char* path, size_t bufferSize)
+{
+	Close();
+	if (!DX::GetFileSize(path, m_fileSize) || !m_source.Open(path))
+		return false;
+	m_buffer.resize(bufferSize);
+	return true;
+}
+
+void ObjStreamReader::Close(void)
+{
+	m_source.Close();
+	std::vector<char>().swap(m_buffer);
+	m_begin = m_end = 0;
+	m_atEnd = false;
+	m_fileSize = m_bytesRead = 0;
+	m_positionCount = m_uvCount = m_normalCount = 0;
+	m_face.clear();
+	m_faceNext = 0;
+}
+
+bool ObjStreamReader::ReadLine(const char*& outLine, const char*& outLineEnd)
+{
+	for (;;)
+	{
+		const char* begin = m_buffer.data() + m_begin;
+		const char* end = m_buffer.data() + m_end;
+		const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+		if (newline || (m_atEnd && begin < end))
+		{
+			outLine = begin;
+			outLineEnd = newline ? newline : end;
+			size_t consumed = (newline ? newline + 1 : end) - begin;
+			m_begin += consumed;
+			m_bytesRead += consumed;
+			return true;
+		}
+		if (m_atEnd || m_buffer.empty())
+			return false;
+
+		// Keep the partial line and refill behind it. A line that fills the buffer is too long.
+		if (m_begin == 0 && m_end == m_buffer.size())
+			return false;
+		memmove(m_buffer.data(), begin, end - begin);
+		m_end -= m_begin;
+		m_begin = 0;
+		size_t read = m_source.Read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+		m_end += read;
+		m_atEnd = read == 0;
+	}
+}
+
+ObjRecord ObjStreamReader::Next(MeshFloat3& value, ObjCorner corners[3])
+{
+	for (;;)
+	{
+		// Polygons are split into a triangle fan around their first corner, as ParseObj does.
+		if (m_faceNext < m_face.size())
+		{
+			corners[0] = m_face[0];
+			corners[1] = m_face[m_faceNext - 1];
+			corners[2] = m_face[m_faceNext];
+			++m_faceNext;
+			return OBJ_RECORD_TRIANGLE;
+		}
+
+		const char* p;
+		const char* lineEnd;
+		if (!ReadLine(p, lineEnd))
+			return m_atEnd && m_begin == m_end && !m_source.HasFailed() ? OBJ_RECORD_END : OBJ_RECORD_ERROR;
+		p = SkipBlanks(p, lineEnd);
+
+		if (IsKeyword(p, lineEnd, 'v', 0))
+		{
+			if (!ParseFloats(p + 1, lineEnd, &value.x, 3))
+				return OBJ_RECORD_ERROR;
+			++m_positionCount;
+			return OBJ_RECORD_POSITION;
+		}
+		if (IsKeyword(p, lineEnd, 'v', 't'))
+		{
+			value.z = 0.0f;
+			if (!ParseFloats(p + 2, lineEnd, &value.x, 2))
+				return OBJ_RECORD_ERROR;
+			value.y = 1 - value.y;
+			++m_uvCount;
+			return OBJ_RECORD_UV;
+		}
+		if (IsKeyword(p, lineEnd, 'v', 'n'))
+		{
+			if (!ParseFloats(p + 2, lineEnd, &value.x, 3))
+				return OBJ_RECORD_ERROR;
+			++m_normalCount;
+			return OBJ_RECORD_NORMAL;
+		}
+		if (IsKeyword(p, lineEnd, 'f', 0))
+		{
+			m_face.clear();
+			const char* q = SkipBlanks(p + 1, lineEnd);
+			while (q < lineEnd)
+			{
+				ObjCorner corner;
+				uint32_t relativeMask;
+				q = ParseCorner(q, lineEnd, static_cast<size_t>(m_positionCount), static_cast<size_t>(m_uvCount), static_cast<size_t>(m_normalCount),
+					corner, relativeMask);
+				if (!q || !HasValidReferences(corner, relativeMask))
+					return OBJ_RECORD_ERROR;
+				m_face.push_back(corner);
+				q = SkipBlanks(q, lineEnd);
+			}
+			if (m_face.size() < 3)
+				return OBJ_RECORD_ERROR;
+			m_faceNext = 2;
+		}
+	}
+}
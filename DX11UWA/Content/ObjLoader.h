@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include "MeshTypes.h"
+
+#include "../Common/CompressedFile.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace DX11UWA
+{
+	// Counters and timing gathered while parsing an OBJ file.
+	struct ObjLoadStats
+	{
+		uint64_t	fileBytes;		// of OBJ text, after any decompression
+		uint64_t	compressedBytes;	// read from a gzip or zstd file, or 0 when the text was plain
+		uint32_t	positionCount;
+		uint32_t	uvCount;
+		uint32_t	normalCount;
+		uint32_t	triangleCount;
+		uint32_t	cornerCount;	// vertices a non-indexed mesh would need (3 per triangle)
+		uint32_t	vertexCount;	// unique vertices after welding
+		uint32_t	threadCount;	// worker threads the text was split across
+		double		parseSeconds;
+
+		double GetMegabytesPerSecond(void) const
+		{
+			return parseSeconds > 0.0 ? (fileBytes / (1024.0 * 1024.0)) / parseSeconds : 0.0;
+		}
+	};
+
+	// A run of faces read under the same g or o name and usemtl material.
+	struct ObjGroup
+	{
+		uint32_t	indexOffset;
+		uint32_t	indexCount;
+		std::string	name;		// from the last g or o line; empty before the first
+		std::string	material;	// from the last usemtl line; empty before the first
+	};
+
+	// How an OBJ's faces are organised, as opposed to their geometry.
+	struct ObjLayout
+	{
+		std::vector<ObjGroup>		groups;				// cover the indices ParseObj wrote, in file order
+		std::vector<std::string>	materialLibraries;	// mtllib names as written, relative to the OBJ
+	};
+
+	// Parses OBJ text that is already in memory. The buffer does not need to be null terminated.
+	// Corners that share the same position/uv/normal indices are welded into one vertex,
+	// so the output is a compact vertex array plus a triangle list indexing into it.
+	// Large inputs are split at line boundaries and parsed on up to threadCount threads
+	// (0 means one per core, 1 forces the serial path). The result is identical for any thread count.
+	// outLayout, when given, receives the groups and material libraries of the new faces.
+	bool ParseObj(const char* text, size_t length, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats = nullptr, unsigned int threadCount = 0,
+		ObjLayout* outLayout = nullptr);
+
+	// Parses an OBJ that may be gzip or zstd compressed, as told by its first bytes. Plain text goes
+	// to ParseObj; compressed text is parsed a few megabytes at a time as it is decompressed, so it
+	// is never whole in memory. The result is the same as ParseObj on the decompressed text.
+	bool ParseObjSource(const void* data, size_t size, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats = nullptr,
+		unsigned int threadCount = 0, ObjLayout* outLayout = nullptr);
+
+	// Memory-maps an OBJ file, which may be compressed, and parses it with ParseObjSource.
+	bool LoadObjFile(const char* path, std::vector<MeshVertex>& outVertices, std::vector<uint32_t>& outIndices, ObjLoadStats* stats = nullptr, unsigned int threadCount = 0,
+		ObjLayout* outLayout = nullptr);
+
+	// Parses MTL text and appends its materials. Statements other than newmtl, Ka, Kd, Ks, Ns,
+	// d, Tr and map_Kd are skipped; a malformed one fails the whole parse.
+	bool ParseMtl(const char* text, size_t length, std::vector<MeshMaterial>& outMaterials);
+
+	// Memory-maps an MTL file and parses it in place.
+	bool LoadMtlFile(const char* path, std::vector<MeshMaterial>& outMaterials);
+
+	// One "v/vt/vn" reference from a face, already converted to 0-based indices (-1 when absent).
+	struct ObjCorner
+	{
+		int32_t position;
+		int32_t uv;
+		int32_t normal;
+	};
+
+	enum ObjRecord
+	{
+		OBJ_RECORD_END,
+		OBJ_RECORD_POSITION,
+		OBJ_RECORD_UV,
+		OBJ_RECORD_NORMAL,
+		OBJ_RECORD_TRIANGLE,
+		OBJ_RECORD_ERROR,
+	};
+
+	// Reads an OBJ front to back through a fixed-size buffer, so a file of any size is read in
+	// bounded memory. Only geometry comes out: v, vt and vn records, read the same way ParseObj
+	// reads them, and faces split into triangles with negative references resolved. Every
+	// other statement is skipped. gzip and zstd files are decompressed as they are read.
+	class ObjStreamReader
+	{
+	public:
+		ObjStreamReader(void);
+		~ObjStreamReader(void);
+
+		// bufferSize bounds the longest line that can be read.
+		bool Open(const char* path, size_t bufferSize = 1 << 20);
+		void Close(void);
+
+		// Reads the next record: its attribute into value, or its corners for OBJ_RECORD_TRIANGLE.
+		ObjRecord Next(MeshFloat3& value, ObjCorner corners[3]);
+
+		// On disk, which for a compressed file is less than the text read.
+		uint64_t GetFileSize(void) const	{ return m_fileSize; }
+		uint64_t GetBytesRead(void) const	{ return m_bytesRead; }
+
+	private:
+		ObjStreamReader(const ObjStreamReader&);
+		ObjStreamReader& operator=(const ObjStreamReader&);
+
+		bool ReadLine(const char*& outLine, const char*& outLineEnd);
+
+		DX::CompressedFile		m_source;
+		std::vector<char>		m_buffer;
+		size_t					m_begin;		// unread bytes of m_buffer
+		size_t					m_end;
+		bool					m_atEnd;
+		uint64_t				m_fileSize;
+		uint64_t				m_bytesRead;	// consumed lines
+		uint64_t				m_positionCount;
+		uint64_t				m_uvCount;
+		uint64_t				m_normalCount;
+		std::vector<ObjCorner>	m_face;			// corners of the face being split into triangles
+		size_t					m_faceNext;		// its next fan corner
+	};
+}
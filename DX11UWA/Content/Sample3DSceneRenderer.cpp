@@ -2,13 +2,51 @@
 #include "Sample3DSceneRenderer.h"
 
 #include "..\Common\DirectXHelper.h"
+#include "MeshCache.h"
+#include "GlbLoader.h"
+#include "..\Common\ProcessMemory.h"
+#include "..\Common\FileIO.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <functional>
 
 using namespace DX11UWA;
 
 using namespace DirectX;
 using namespace Windows::Foundation;
 
-bool loadObject(const char * path, std::vector <VertexPositionUVNormal> & outVertices, std::vector <unsigned int> & outIndicies);
+std::string localFilePath(const char * name);
+bool loadObject(const char * path, const char * cacheName, MeshVertexFormat format, CachedMesh & outMesh);
+void createMeshInputLayout(ID3D11Device * device, const MeshAttribute * attributes, const uint32 * slots, const std::vector<byte> & shader, ID3D11InputLayout ** outLayout);
+XMMATRIX placeObject(float x, float y, float z);
+uint64 getResourceBytes(ID3D11Resource * resource);
+
+// Where the castle and wolf stand; drawing and the draw benchmark both place them from here.
+static const XMFLOAT3 floorPosition(5.0f, -2.0f, 2.0f);
+static const XMFLOAT3 wolfPosition(1.0f, 5.0f, -2.0f);
+
+// A scan shipped as Assets/scan.obj is imported into a chunk file on first run and streamed from then on.
+// Importing holds scanImportBudget at most; drawing keeps scanResidentBudget of chunks on the GPU.
+static const char scanObjPath[] = "Assets/scan.obj";
+static const XMFLOAT3 scanPosition(0.0f, -2.0f, 0.0f);
+static const uint64 scanImportBudget = 64ull << 20;
+static const uint64 scanResidentBudget = 128ull << 20;
+static const uint32 scanLoadsPerFrame = 4;
+
+// Buffers, textures and render targets are kept under residencyBudget on the GPU; a frame reads at
+// most residencyRestoresPerFrame assets back.
+static const uint64 residencyBudget = 512ull << 20;
+static const uint32 residencyRestoresPerFrame = 2;
+
+// A glTF model shipped as Assets/model.glb is drawn here.
+static const char modelGlbPath[] = "Assets/model.glb";
+static const XMFLOAT3 modelPosition(-3.0f, -2.0f, 4.0f);
+
+// A texture pack cooked by TexturePack into Assets/textures.tpk and its pages; the meshes whose
+// textures it lists are drawn from the pages.
+static const char texturePackPath[] = "Assets/textures.tpk";
 
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
 Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
@@ -16,7 +54,13 @@ Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceRes
 	m_degreesPerSecond(45),
 	m_indexCount(0),
 	m_tracking(false),
-	m_deviceResources(deviceResources)
+	m_deviceResources(deviceResources),
+	m_scanImport(concurrency::task_from_result(std::shared_ptr<MeshChunkFile>())),
+	m_scanImporting(false),
+	m_scanReady(false),
+	m_textureStreamingReported(false),
+	m_streamedTextureCount(0),
+	m_residencyReady(false)
 {
 	memset(m_kbuttons, 0, sizeof(m_kbuttons));
 	m_currMousePos = nullptr;
@@ -27,6 +71,12 @@ Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceRes
 	CreateWindowSizeDependentResources();
 }
 
+// Waits for a scan import still running, which would otherwise go on writing the chunk file.
+Sample3DSceneRenderer::~Sample3DSceneRenderer(void)
+{
+	m_scanImport.wait();
+}
+
 // Initializes view parameters when the window size changes.
 void Sample3DSceneRenderer::CreateWindowSizeDependentResources(void)
 {
@@ -319,6 +369,215 @@ void Sample3DSceneRenderer::StopTracking(void)
 	m_tracking = false;
 }
 
+// Picks the LOD of a mesh with the given object-space bounds, placed by world, for one viewport.
+uint32 Sample3DSceneRenderer::SelectLod(const MeshLod* lods, uint32 lodCount, const MeshBounds& bounds, FXMMATRIX world, FXMVECTOR eye, float viewportHeight) const
+{
+	XMVECTOR boundsMin = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&bounds.min));
+	XMVECTOR boundsMax = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&bounds.max));
+	XMVECTOR center = XMVector3Transform(XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f), world);
+	float radius = 0.5f * XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, boundsMin)));
+
+	// Distance to the bounding sphere; inside it the full mesh is always drawn.
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eye))) - radius;
+	float projectionScale = viewportHeight / (2.0f * tanf(fov * 0.5f));
+	return SelectMeshLod(lods, lodCount, distance, projectionScale);
+}
+
+// Culls a mesh placed by world for one viewport and appends what is left of each of its submeshes
+// to m_submeshDraws: submeshes outside the frustum are dropped by their bounds, the rest by cluster.
+// A mesh whose buffers residency evicted is culled all the same but nothing is drawn, and one whose
+// finer LODs were dropped draws the finest it still has. Returns the LOD the mesh wants, or
+// MESH_MAX_LODS when none of it is visible.
+uint32 Sample3DSceneRenderer::CullSubmeshes(const DrawableMesh& mesh, FXMMATRIX world, CXMMATRIX viewProjection, FXMVECTOR eye, float viewportHeight,
+	SubmeshDrawStats* stats)
+{
+	uint32 wantedLod = SelectLod(mesh.lods, mesh.lodCount, mesh.bounds, world, eye, viewportHeight);
+	uint32 lod = std::max(wantedLod, mesh.firstLod);
+	bool resident = mesh.vertexBuffers[0] && mesh.indexBuffer;
+	bool visible = false;
+
+	// Submeshes and clusters are tested in mesh space: the frustum takes world in and the eye is taken out of it.
+	XMFLOAT4X4 worldViewProjection;
+	XMStoreFloat4x4(&worldViewProjection, XMMatrixMultiply(world, viewProjection));
+	MeshFloat3 meshEye;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&meshEye), XMVector3Transform(eye, XMMatrixInverse(nullptr, world)));
+	MeshClusterView view = ComputeMeshClusterView(&worldViewProjection.m[0][0], meshEye);
+
+	uint32 submeshCount = static_cast<uint32>(mesh.submeshes.size());
+	for (uint32 s = 0; s < submeshCount; ++s)
+	{
+		const MeshLod& range = mesh.submeshLods[lod * submeshCount + s];
+		if (range.indexCount == 0)
+			continue;
+		if (stats)
+			++stats->submeshCount;
+		if (!MeshBoundsVisible(view, mesh.submeshes[s].bounds))
+		{
+			if (stats)
+				++stats->submeshesCulled;
+			continue;
+		}
+
+		SubmeshDraw draw = { &mesh, mesh.textures[s].Get(), static_cast<uint32>(m_drawRanges.size()), 0 };
+		if (range.clusterCount == 0)
+		{
+			MeshDrawRange whole = { range.indexOffset, range.indexCount };
+			m_drawRanges.push_back(whole);
+			draw.rangeCount = 1;
+		}
+		else
+		{
+			m_drawRanges.resize(draw.rangeOffset + (range.clusterCount + 1) / 2);
+			draw.rangeCount = static_cast<uint32>(CullMeshClusters(&mesh.clusters[range.clusterOffset], range.clusterCount, view, &m_drawRanges[draw.rangeOffset],
+				stats ? &stats->clusters : nullptr));
+			m_drawRanges.resize(draw.rangeOffset + draw.rangeCount);
+		}
+		visible = visible || draw.rangeCount > 0;
+		if (draw.rangeCount > 0 && resident)
+			m_submeshDraws.push_back(draw);
+		else
+			m_drawRanges.resize(draw.rangeOffset);
+	}
+	return visible ? wantedLod : MESH_MAX_LODS;
+}
+
+// Orders m_submeshDraws by texture and then by mesh, so each texture and each mesh's buffers and
+// shaders are bound as few times as possible.
+void Sample3DSceneRenderer::SortSubmeshDraws(SubmeshDrawStats* stats)
+{
+	auto countTextureBinds = [this]()
+	{
+		uint32 binds = 0;
+		for (size_t i = 0; i < m_submeshDraws.size(); ++i)
+			binds += (i == 0 || m_submeshDraws[i].texture != m_submeshDraws[i - 1].texture) ? 1 : 0;
+		return binds;
+	};
+
+	if (stats)
+		stats->unsortedTextureBinds += countTextureBinds();
+	std::stable_sort(m_submeshDraws.begin(), m_submeshDraws.end(), [](const SubmeshDraw& a, const SubmeshDraw& b)
+	{
+		return a.texture != b.texture ? std::less<ID3D11ShaderResourceView*>()(a.texture, b.texture) : std::less<const DrawableMesh*>()(a.mesh, b.mesh);
+	});
+	if (stats)
+		stats->textureBinds += countTextureBinds();
+}
+
+// Issues m_submeshDraws in order. Each mesh's constant buffer must already hold its matrices.
+void Sample3DSceneRenderer::DrawSubmeshes(ID3D11DeviceContext3* context) const
+{
+	const DrawableMesh* boundMesh = nullptr;
+	ID3D11ShaderResourceView* boundTexture = nullptr;
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	for (const SubmeshDraw& draw : m_submeshDraws)
+	{
+		const DrawableMesh& mesh = *draw.mesh;
+		if (&mesh != boundMesh)
+		{
+			ID3D11Buffer* vertexBuffers[MESH_VERTEX_ATTRIBUTE_COUNT];
+			UINT offsets[MESH_VERTEX_ATTRIBUTE_COUNT] = { 0 };
+			for (uint32 i = 0; i < mesh.vertexBufferCount; ++i)
+				vertexBuffers[i] = mesh.vertexBuffers[i].Get();
+			context->IASetVertexBuffers(0, mesh.vertexBufferCount, vertexBuffers, mesh.vertexStrides, offsets);
+			context->IASetIndexBuffer(mesh.indexBuffer.Get(), mesh.indexFormat, 0);
+			context->IASetInputLayout(mesh.inputLayout ? mesh.inputLayout.Get() : m_meshInputLayouts[mesh.vertexFormat].Get());
+			context->VSSetShader(mesh.vertexShader.Get(), nullptr, 0);
+			context->VSSetConstantBuffers1(0, 1, mesh.constantBuffer.GetAddressOf(), nullptr, nullptr);
+			context->VSSetConstantBuffers1(1, 1, mesh.decodeBuffer.GetAddressOf(), nullptr, nullptr);
+			context->PSSetShader(mesh.textureArray ? m_textureArrayPixelShader.Get() : mesh.pixelShader.Get(), nullptr, 0);
+			context->PSSetSamplers(0, 1, mesh.sampleState.GetAddressOf());
+			boundMesh = &mesh;
+		}
+		if (draw.texture != boundTexture)
+		{
+			context->PSSetShaderResources(0, 1, &draw.texture);
+			boundTexture = draw.texture;
+		}
+		for (uint32 i = draw.rangeOffset; i < draw.rangeOffset + draw.rangeCount; ++i)
+			context->DrawIndexed(m_drawRanges[i].indexCount, m_drawRanges[i].indexOffset - mesh.indexBase, 0);
+	}
+}
+
+#if SCENE_DRAW_BENCHMARK
+// Flies a fixed camera path out from the scene and back, looking at the castle, and reports the
+// castle and wolf triangles submitted per frame at full detail, with LOD selection and with
+// submesh and cluster culling on top of that, and the texture binds material sorting saves.
+void Sample3DSceneRenderer::ReportDrawBenchmark(void)
+{
+	const uint32 frameCount = 600;
+	// postRender draws each mesh twice: into the inner scene and into the back buffer.
+	const uint32 drawsPerFrame = 2;
+	Size outputSize = m_deviceResources->GetOutputSize();
+	float viewportHeight = outputSize.Height;
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(fov, outputSize.Width / outputSize.Height, nearPlane, farPlane);
+	XMMATRIX floorWorld = placeObject(floorPosition.x, floorPosition.y, floorPosition.z);
+	XMMATRIX wolfWorld = placeObject(wolfPosition.x, wolfPosition.y, wolfPosition.z);
+	XMVECTOR at = XMLoadFloat3(&floorPosition);
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	uint64 fullTriangles = 0;
+	uint64 lodTriangles = 0;
+	uint32 minLodTriangles = UINT_MAX;
+	uint32 maxLodTriangles = 0;
+	uint32 lodFrames[MESH_MAX_LODS] = { 0 };
+	uint64 drawRanges = 0;
+	SubmeshDrawStats drawStats = { 0 };
+	for (uint32 frame = 0; frame < frameCount; ++frame)
+	{
+		// Two orbits around the castle while pulling out from 4 to 80 units and back in.
+		float t = float(frame) / float(frameCount);
+		float angle = t * XM_2PI * 2.0f;
+		float radius = 4.0f + 76.0f * sinf(t * XM_PI);
+		XMVECTOR eye = XMVectorSet(floorPosition.x + radius * cosf(angle), 1.0f + radius * 0.25f, floorPosition.z + radius * sinf(angle), 1.0f);
+		XMMATRIX viewProjection = XMMatrixMultiply(XMMatrixLookAtLH(eye, at, up), projection);
+
+		uint32 floorLod = SelectLod(m_floorMesh.lods, m_floorMesh.lodCount, m_floorMesh.bounds, floorWorld, eye, viewportHeight);
+		uint32 wolfLod = SelectLod(m_wolfMesh.lods, m_wolfMesh.lodCount, m_wolfMesh.bounds, wolfWorld, eye, viewportHeight);
+		uint32 frameFull = drawsPerFrame * (m_floorMesh.lods[0].indexCount + m_wolfMesh.lods[0].indexCount) / 3;
+		uint32 frameLod = drawsPerFrame * (m_floorMesh.lods[floorLod].indexCount + m_wolfMesh.lods[wolfLod].indexCount) / 3;
+		m_submeshDraws.clear();
+		m_drawRanges.clear();
+		CullSubmeshes(m_floorMesh, floorWorld, viewProjection, eye, viewportHeight, &drawStats);
+		CullSubmeshes(m_wolfMesh, wolfWorld, viewProjection, eye, viewportHeight, &drawStats);
+		SortSubmeshDraws(&drawStats);
+		drawRanges += drawsPerFrame * m_drawRanges.size();
+
+		fullTriangles += frameFull;
+		lodTriangles += frameLod;
+		minLodTriangles = frameLod < minLodTriangles ? frameLod : minLodTriangles;
+		maxLodTriangles = frameLod > maxLodTriangles ? frameLod : maxLodTriangles;
+		++lodFrames[floorLod];
+		++lodFrames[wolfLod];
+	}
+
+	char message[256];
+	sprintf_s(message, "Draw benchmark: %u frames, %.0f px viewport, triangles per frame: %.0f without LOD, %.0f with LOD (min %u, max %u, %.1f%%)\n",
+		frameCount, viewportHeight, double(fullTriangles) / frameCount, double(lodTriangles) / frameCount, minLodTriangles, maxLodTriangles,
+		fullTriangles ? 100.0 * double(lodTriangles) / double(fullTriangles) : 100.0);
+	OutputDebugStringA(message);
+	for (uint32 i = 0; i < MESH_MAX_LODS; ++i)
+	{
+		if (!lodFrames[i])
+			continue;
+		sprintf_s(message, "Draw benchmark: LOD %u chosen for %u object-frames\n", i, lodFrames[i]);
+		OutputDebugStringA(message);
+	}
+
+	const MeshClusterCullStats& cullStats = drawStats.clusters;
+	uint32 clustersCulled = cullStats.frustumCulled + cullStats.backfaceCulled;
+	sprintf_s(message, "Draw benchmark: %.0f with LOD and cluster culling (%.1f%% of LOD), %.1f draws per frame\n",
+		drawsPerFrame * double(cullStats.trianglesDrawn) / frameCount, cullStats.triangleCount ? 100.0 * cullStats.trianglesDrawn / cullStats.triangleCount : 100.0,
+		double(drawRanges) / frameCount);
+	OutputDebugStringA(message);
+	sprintf_s(message, "Draw benchmark: %u of %u submeshes culled by bounds, %u of %u clusters culled (%u frustum, %u backface)\n",
+		drawStats.submeshesCulled, drawStats.submeshCount, clustersCulled, cullStats.clusterCount, cullStats.frustumCulled, cullStats.backfaceCulled);
+	OutputDebugStringA(message);
+	sprintf_s(message, "Draw benchmark: %.1f texture binds per frame sorted by material, %.1f in load order\n",
+		drawsPerFrame * double(drawStats.textureBinds) / frameCount, drawsPerFrame * double(drawStats.unsortedTextureBinds) / frameCount);
+	OutputDebugStringA(message);
+}
+#endif
+
 // Renders one frame using the vertex and pixel shaders.
 void Sample3DSceneRenderer::Render(void)
 {
@@ -329,6 +588,10 @@ void Sample3DSceneRenderer::Render(void)
 	}
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
+	UpdateScanResidency();
+	UpdateTextureStreaming();
+	UpdateResidency();
+
 	if (multipleViewports)
 	{
 		context->RSSetViewports(1, m_vp1);
@@ -348,6 +611,36 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 {
 	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
 
+	// Castle and wolf draw the coarsest LOD whose error stays under a pixel in this viewport.
+	D3D11_VIEWPORT viewport;
+	UINT viewportCount = 1;
+	context->RSGetViewports(&viewportCount, &viewport);
+	XMVECTOR eye = XMVectorSet(m_camera._41, m_camera._42, m_camera._43, 1.0f);
+	XMMATRIX floorWorld = placeObject(floorPosition.x, floorPosition.y, floorPosition.z);
+	XMMATRIX wolfWorld = placeObject(wolfPosition.x, wolfPosition.y, wolfPosition.z);
+
+	// Of those LODs, only the submeshes and clusters inside the frustum and facing the camera are
+	// drawn, grouped by texture.
+	XMMATRIX viewProjection = XMMatrixMultiply(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera)), XMMatrixTranspose(XMLoadFloat4x4(&m_floorConstantBufferData.projection)));
+	m_submeshDraws.clear();
+	m_drawRanges.clear();
+	uint32 floorLod = CullSubmeshes(m_floorMesh, floorWorld, viewProjection, eye, viewport.Height);
+	uint32 wolfLod = CullSubmeshes(m_wolfMesh, wolfWorld, viewProjection, eye, viewport.Height);
+	XMMATRIX scanWorld = placeObject(scanPosition.x, scanPosition.y, scanPosition.z);
+	if (m_scanReady)
+	{
+		for (const DrawableMesh& chunk : m_scanChunks)
+		{
+			if (chunk.vertexBufferCount > 0)
+				CullSubmeshes(chunk, scanWorld, viewProjection, eye, viewport.Height);
+		}
+	}
+	XMMATRIX modelWorld = placeObject(modelPosition.x, modelPosition.y, modelPosition.z);
+	for (size_t i = 0; i < m_modelMeshes.size(); ++i)
+		CullSubmeshes(m_modelMeshes[i], XMMatrixMultiply(XMLoadFloat4x4(&m_modelTransforms[i]), modelWorld), viewProjection, eye, viewport.Height);
+	SortSubmeshDraws();
+	MarkResidencyUsed(floorLod, wolfLod);
+
 	ID3D11RenderTargetView *const target[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
 
 	//Change this.
@@ -391,45 +684,33 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 		context->IASetInputLayout(m_inputLayout.Get());
 		context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
 		context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
+		context->VSSetConstantBuffers1(1, 1, m_identityDecodeBuffer.GetAddressOf(), nullptr, nullptr);
 		context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
 		context->PSSetShaderResources(0, 1, m_cubeResourceView.GetAddressOf());
 		context->DrawIndexed(m_indexCount, 0, 0);
 
-		//Floor / ice castle
-		XMStoreFloat4x4(&m_floorConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMMatrixRotationY(3.14f), XMMatrixTranslation(5.0f, -2.0f, 2.0f))));
+		//Floor / ice castle and wolf
+		XMStoreFloat4x4(&m_floorConstantBufferData.model, XMMatrixTranspose(floorWorld));
 
 		XMStoreFloat4x4(&m_floorConstantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
 
-		context->UpdateSubresource1(m_floorConstantBuffer.Get(), 0, NULL, &m_floorConstantBufferData, 0, 0, 0);
-		stride = sizeof(VertexPositionUVNormal);
-		offset = 0;
-		context->IASetVertexBuffers(0, 1, m_floorVertBuffer.GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(m_floorIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		context->IASetInputLayout(m_floorInputLayout.Get());
-		context->VSSetShader(m_floorVertexShader.Get(), nullptr, 0);
-		context->VSSetConstantBuffers1(0, 1, m_floorConstantBuffer.GetAddressOf(), nullptr, nullptr);
-		context->PSSetShader(m_floorPixelShader.Get(), nullptr, 0);
-		context->PSSetShaderResources(0, 1, m_floorResourceView.GetAddressOf());
-		context->PSSetSamplers(0, 1, m_floorSampleState.GetAddressOf());
-		context->DrawIndexed(m_floorIndicies.size(), 0, 0);
-
-		//Wolf
-		XMStoreFloat4x4(&m_wolfConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMMatrixRotationY(3.14f), XMMatrixTranslation(1.0f, 5.0f, -2.0f))));
+		context->UpdateSubresource1(m_floorMesh.constantBuffer.Get(), 0, NULL, &m_floorConstantBufferData, 0, 0, 0);
+		XMStoreFloat4x4(&m_wolfConstantBufferData.model, XMMatrixTranspose(wolfWorld));
 		XMStoreFloat4x4(&m_wolfConstantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
-		context->UpdateSubresource1(m_wolfConstantBuffer.Get(), 0, NULL, &m_wolfConstantBufferData, 0, 0, 0);
-		stride = sizeof(VertexPositionUVNormal);
-		offset = 0;
-		context->IASetVertexBuffers(0, 1, m_wolfVertBuffer.GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(m_wolfIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		context->IASetInputLayout(m_wolfInputLayout.Get());
-		context->VSSetShader(m_wolfVertexShader.Get(), nullptr, 0);
-		context->VSSetConstantBuffers1(0, 1, m_wolfConstantBuffer.GetAddressOf(), nullptr, nullptr);
-		context->PSSetShader(m_wolfPixelShader.Get(), nullptr, 0);
-		context->PSSetShaderResources(0, 1, m_wolfResourceView.GetAddressOf());
-		context->PSSetSamplers(0, 1, m_wolfSampleState.GetAddressOf());
-		context->DrawIndexed(m_wolfIndicies.size(), 0, 0);
+		context->UpdateSubresource1(m_wolfMesh.constantBuffer.Get(), 0, NULL, &m_wolfConstantBufferData, 0, 0, 0);
+		if (m_scanReady)
+		{
+			ModelViewProjectionConstantBuffer scanConstantBufferData = m_floorConstantBufferData;
+			XMStoreFloat4x4(&scanConstantBufferData.model, XMMatrixTranspose(scanWorld));
+			context->UpdateSubresource1(m_scanConstantBuffer.Get(), 0, NULL, &scanConstantBufferData, 0, 0, 0);
+		}
+		for (size_t i = 0; i < m_modelMeshes.size(); ++i)
+		{
+			ModelViewProjectionConstantBuffer modelConstantBufferData = m_floorConstantBufferData;
+			XMStoreFloat4x4(&modelConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMLoadFloat4x4(&m_modelTransforms[i]), modelWorld)));
+			context->UpdateSubresource1(m_modelMeshes[i].constantBuffer.Get(), 0, NULL, &modelConstantBufferData, 0, 0, 0);
+		}
+		DrawSubmeshes(context);
 
 		//Stone floor
 		XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixScaling(1.0f, 0.2f, 1.0f));
@@ -442,6 +723,7 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 		context->IASetInputLayout(m_stoneInput.Get());
 		context->VSSetShader(m_stoneVS.Get(), nullptr, 0);
 		context->VSSetConstantBuffers1(0, 1, m_stoneConstantBuffer.GetAddressOf(), nullptr, nullptr);
+		context->VSSetConstantBuffers1(1, 1, m_identityDecodeBuffer.GetAddressOf(), nullptr, nullptr);
 		context->PSSetShader(m_stonePS.Get(), nullptr, 0);
 		context->PSSetShaderResources(0, 1, m_stoneResourceView.GetAddressOf());
 		context->DrawIndexed(m_stoneICount, 0, 0);
@@ -480,45 +762,33 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 	context->IASetInputLayout(m_inputLayout.Get());
 	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
 	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
+	context->VSSetConstantBuffers1(1, 1, m_identityDecodeBuffer.GetAddressOf(), nullptr, nullptr);
 	context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
 	context->PSSetShaderResources(0, 1, m_cubeResourceView.GetAddressOf());
 	context->DrawIndexed(m_indexCount, 0, 0);
 
-	//Floor / ice castle
-	XMStoreFloat4x4(&m_floorConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMMatrixRotationY(3.14f), XMMatrixTranslation(5.0f, -2.0f, 2.0f))));
+	//Floor / ice castle and wolf
+	XMStoreFloat4x4(&m_floorConstantBufferData.model, XMMatrixTranspose(floorWorld));
 
 	XMStoreFloat4x4(&m_floorConstantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
 
-	context->UpdateSubresource1(m_floorConstantBuffer.Get(), 0, NULL, &m_floorConstantBufferData, 0, 0, 0);
-	stride = sizeof(VertexPositionUVNormal);
-	offset = 0;
-	context->IASetVertexBuffers(0, 1, m_floorVertBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_floorIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	context->IASetInputLayout(m_floorInputLayout.Get());
-	context->VSSetShader(m_floorVertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_floorConstantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->PSSetShader(m_floorPixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_floorResourceView.GetAddressOf());
-	context->PSSetSamplers(0, 1, m_floorSampleState.GetAddressOf());
-	context->DrawIndexed(m_floorIndicies.size(), 0, 0);
-
-	//Wolf
-	XMStoreFloat4x4(&m_wolfConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMMatrixRotationY(3.14f), XMMatrixTranslation(1.0f, 5.0f, -2.0f))));
+	context->UpdateSubresource1(m_floorMesh.constantBuffer.Get(), 0, NULL, &m_floorConstantBufferData, 0, 0, 0);
+	XMStoreFloat4x4(&m_wolfConstantBufferData.model, XMMatrixTranspose(wolfWorld));
 	XMStoreFloat4x4(&m_wolfConstantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
-	context->UpdateSubresource1(m_wolfConstantBuffer.Get(), 0, NULL, &m_wolfConstantBufferData, 0, 0, 0);
-	stride = sizeof(VertexPositionUVNormal);
-	offset = 0;
-	context->IASetVertexBuffers(0, 1, m_wolfVertBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_wolfIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	context->IASetInputLayout(m_wolfInputLayout.Get());
-	context->VSSetShader(m_wolfVertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_wolfConstantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->PSSetShader(m_wolfPixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_wolfResourceView.GetAddressOf());
-	context->PSSetSamplers(0, 1, m_wolfSampleState.GetAddressOf());
-	context->DrawIndexed(m_wolfIndicies.size(), 0, 0);
+	context->UpdateSubresource1(m_wolfMesh.constantBuffer.Get(), 0, NULL, &m_wolfConstantBufferData, 0, 0, 0);
+	if (m_scanReady)
+	{
+		ModelViewProjectionConstantBuffer scanConstantBufferData = m_floorConstantBufferData;
+		XMStoreFloat4x4(&scanConstantBufferData.model, XMMatrixTranspose(scanWorld));
+		context->UpdateSubresource1(m_scanConstantBuffer.Get(), 0, NULL, &scanConstantBufferData, 0, 0, 0);
+	}
+	for (size_t i = 0; i < m_modelMeshes.size(); ++i)
+	{
+		ModelViewProjectionConstantBuffer modelConstantBufferData = m_floorConstantBufferData;
+		XMStoreFloat4x4(&modelConstantBufferData.model, XMMatrixTranspose(XMMatrixMultiply(XMLoadFloat4x4(&m_modelTransforms[i]), modelWorld)));
+		context->UpdateSubresource1(m_modelMeshes[i].constantBuffer.Get(), 0, NULL, &modelConstantBufferData, 0, 0, 0);
+	}
+	DrawSubmeshes(context);
 
 	//Stone floor
 	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixScaling(1.0f, 0.2f, 1.0f));
@@ -531,6 +801,7 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 	context->IASetInputLayout(m_stoneInput.Get());
 	context->VSSetShader(m_stoneVS.Get(), nullptr, 0);
 	context->VSSetConstantBuffers1(0, 1, m_stoneConstantBuffer.GetAddressOf(), nullptr, nullptr);
+	context->VSSetConstantBuffers1(1, 1, m_identityDecodeBuffer.GetAddressOf(), nullptr, nullptr);
 	context->PSSetShader(m_stonePS.Get(), nullptr, 0);
 	context->PSSetShaderResources(0, 1, m_stoneResourceView.GetAddressOf());
 	context->DrawIndexed(m_stoneICount, 0, 0);
@@ -559,6 +830,12 @@ void Sample3DSceneRenderer::postRender(ID3D11DeviceContext3 * context)
 
 void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 {
+	// Textures load small first and stream up to full resolution once the scene is drawing.
+	m_textureStreamer.Start(m_deviceResources->GetD3DDevice());
+	m_textureStreamingReported = false;
+	m_texturePack.Open(texturePackPath);
+	m_texturePackViews.assign(m_texturePack.IsOpen() ? m_texturePack.GetPageCount() : 0, nullptr);
+
 	// Load shaders asynchronously.
 	//Cube
 	auto loadVSTask = DX::ReadDataAsync(L"LightingVertexShader.cso");
@@ -592,30 +869,20 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 	auto createFloorVSTask = loadFloorVSTask.then([this](const std::vector<byte>& fileData)
 	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_floorVertexShader));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_floorMesh.vertexShader));
 
-		static const D3D11_INPUT_ELEMENT_DESC floorVertexDesc[] =
+		// Castle and wolf share these; each draws with the layout matching the format its mesh loaded in.
+		for (uint32 format = 0; format < MESH_VERTEX_FORMAT_COUNT; ++format)
 		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "UV", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		};
-
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateInputLayout(floorVertexDesc, ARRAYSIZE(floorVertexDesc), &fileData[0], fileData.size(), &m_floorInputLayout));
+			MeshAttribute attributes[MESH_VERTEX_ATTRIBUTE_COUNT];
+			GetMeshVertexAttributes(static_cast<MeshVertexFormat>(format), attributes);
+			createMeshInputLayout(m_deviceResources->GetD3DDevice(), attributes, nullptr, fileData, &m_meshInputLayouts[format]);
+		}
 	});
 
 	auto createWolfVSTask = loadFloorVSTask.then([this](const std::vector<byte>& fileData)
 	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_wolfVertexShader));
-
-		static const D3D11_INPUT_ELEMENT_DESC wolfVertexDesc[] =
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "UV", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		};
-
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateInputLayout(wolfVertexDesc, ARRAYSIZE(wolfVertexDesc), &fileData[0], fileData.size(), &m_wolfInputLayout));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_wolfMesh.vertexShader));
 	});
 
 	// After the pixel shader file is loaded, create the shader and constant buffer.
@@ -625,27 +892,52 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 
 		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
 		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &m_constantBuffer));
+
+		// Meshes in MESH_VERTEX_FLOAT bind this identity decode for LightingVertexShader.
+		MeshDecodeConstants identityDecode = ComputeMeshDecodeConstants(MESH_VERTEX_FLOAT, nullptr, 0);
+		D3D11_SUBRESOURCE_DATA identityDecodeData = { 0 };
+		identityDecodeData.pSysMem = &identityDecode;
+		CD3D11_BUFFER_DESC decodeBufferDesc(sizeof(MeshDecodeConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeBufferDesc, &identityDecodeData, &m_identityDecodeBuffer));
 	});
 
 	auto createFloorPSTask = loadFloorPSTask.then([this](const std::vector<byte>& fileData)
 	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_floorPixelShader));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_floorMesh.pixelShader));
 
 		CD3D11_BUFFER_DESC floorConstantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&floorConstantBufferDesc, nullptr, &m_floorConstantBuffer));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&floorConstantBufferDesc, nullptr, &m_floorMesh.constantBuffer));
+
 
+	});
 
+	//glTF model with lighting, loaded once both of its shaders are read
+	auto loadModelVSTask = DX::ReadDataAsync(L"LightingVertexShader.cso");
+	auto loadModelPSTask = DX::ReadDataAsync(L"LightingPixelShader.cso");
+	auto createModelTask = loadModelVSTask.then([this, loadModelPSTask](const std::vector<byte>& vertexShader)
+	{
+		return loadModelPSTask.then([this, vertexShader](const std::vector<byte>& pixelShader)
+		{
+			LoadGlbModel(vertexShader, pixelShader);
+		});
 	});
 
 	auto createWolfPSTask = loadFloorPSTask.then([this](const std::vector<byte>& fileData)
 	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_wolfPixelShader));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_wolfMesh.pixelShader));
 
 		CD3D11_BUFFER_DESC wolfConstantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&wolfConstantBufferDesc, nullptr, &m_wolfConstantBuffer));
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&wolfConstantBufferDesc, nullptr, &m_wolfMesh.constantBuffer));
 
 	});
 
+	//Meshes drawn from a texture pack's array page sample their slice with this one
+	auto loadArrayPSTask = DX::ReadDataAsync(L"LightingArrayPixelShader.cso");
+	auto createArrayPSTask = loadArrayPSTask.then([this](const std::vector<byte>& fileData)
+	{
+		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_textureArrayPixelShader));
+	});
+
 
 	//----------------CREATING SKYBOX-------------------//
 
@@ -722,7 +1014,7 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 		sampleDesc.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
 		sampleDesc.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
 
-		DX::ThrowIfFailed(CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/SkyboxOcean.dds", NULL, m_skyBoxResourceView.GetAddressOf()));
+		DX::ThrowIfFailed(m_textureStreamer.Load(L"Assets/SkyboxOcean.dds", m_skyBoxResourceView.GetAddressOf()));
 
 		m_skyICount = ARRAYSIZE(Indices);
 
@@ -982,7 +1274,7 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 		sampleDesc.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
 		sampleDesc.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
 
-		DX::ThrowIfFailed(CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/GroundTexture.dds", NULL, m_stoneResourceView.GetAddressOf()));
+		DX::ThrowIfFailed(m_textureStreamer.Load(L"Assets/GroundTexture.dds", m_stoneResourceView.GetAddressOf()));
 
 		m_stoneICount = ARRAYSIZE(groundIndices);
 
@@ -1073,7 +1365,7 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 		sampleDesc.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
 		sampleDesc.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
 
-		DX::ThrowIfFailed(CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/lava.dds", NULL, m_cubeResourceView.GetAddressOf()));
+		DX::ThrowIfFailed(m_textureStreamer.Load(L"Assets/lava.dds", m_cubeResourceView.GetAddressOf()));
 
 		m_indexCount = ARRAYSIZE(cubeIndices);
 
@@ -1086,75 +1378,828 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 	});
 
 
+	// Each CachedMesh is released as soon as it is uploaded, so only one mesh is on the CPU at a time.
 	//start castle
-	bool loadFloor = loadObject("Assets/icyCastle.obj", m_floorVerticies, m_floorIndicies);
-
-	D3D11_SUBRESOURCE_DATA floorVertBuffData = { 0 };
-	floorVertBuffData.pSysMem = m_floorVerticies.data();
-	floorVertBuffData.SysMemPitch = 0;
-	floorVertBuffData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC floorVertBuffDesc(sizeof(VertexPositionUVNormal) * m_floorVerticies.size(), D3D11_BIND_VERTEX_BUFFER);
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&floorVertBuffDesc, &floorVertBuffData, &m_floorVertBuffer));
-
-	D3D11_SUBRESOURCE_DATA floorIndexBuffData = { 0 };
-
-	floorIndexBuffData.pSysMem = m_floorIndicies.data();
-	floorIndexBuffData.SysMemPitch = 0;
-	floorIndexBuffData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC floorIndexBuffDesc(sizeof(unsigned int) * m_floorIndicies.size(), D3D11_BIND_INDEX_BUFFER);
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&floorIndexBuffDesc, &floorIndexBuffData, &m_floorIndexBuffer));
-
-	D3D11_SAMPLER_DESC floorTextureSampler;
-	ZeroMemory(&floorTextureSampler, sizeof(floorTextureSampler));
-	floorTextureSampler.Filter = D3D11_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
-	floorTextureSampler.AddressU = D3D11_TEXTURE_ADDRESS_MIRROR;
-	floorTextureSampler.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
-	floorTextureSampler.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
-
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateSamplerState(&floorTextureSampler, &m_floorSampleState));
-	DX::ThrowIfFailed(CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/iceCastleTexture.dds", NULL, &m_floorResourceView));
+	{
+		CachedMesh floorMesh;
+		loadObject("Assets/icyCastle.obj", "icyCastle.mesh", MESH_VERTEX_QUANTIZED, floorMesh);
+		CreateDrawableMesh(floorMesh, "Assets/icyCastle.obj", L"Assets/iceCastleTexture.dds", m_floorMesh);
+	}
 	//END Castle
 
 	//Start Wolf
-	bool loadWolf = loadObject("Assets/Howling_Wolf.obj", m_wolfVerticies, m_wolfIndicies);
+	{
+		CachedMesh wolfMesh;
+		loadObject("Assets/Howling_Wolf.obj", "Howling_Wolf.mesh", MESH_VERTEX_QUANTIZED, wolfMesh);
+		CreateDrawableMesh(wolfMesh, "Assets/Howling_Wolf.obj", L"Assets/wolfBlack.dds", m_wolfMesh);
+	}
+	//End Wolf
+
+	DX::ProcessMemory memory;
+	if (DX::QueryProcessMemory(memory))
+	{
+		char message[256];
+		sprintf_s(message, "CreateDeviceDependentResources: meshes loaded, memory %.1f MB (peak %.1f MB)\n",
+			memory.currentBytes / (1024.0 * 1024.0), memory.peakBytes / (1024.0 * 1024.0));
+		OutputDebugStringA(message);
+	}
+
+#if SCENE_DRAW_BENCHMARK
+	ReportDrawBenchmark();
+#endif
+	StartScanStreaming();
 
-	D3D11_SUBRESOURCE_DATA wolfVertBuffData = { 0 };
+	// Once the cube, the model and every other object are loaded, the scene is ready to be rendered
+	// and what it holds on the GPU can be counted.
+	(createCubeTask && createModelTask && createSkyBox && createStoneFloor && createInnerSceneTask && createArrayPSTask).then([this]()
+	{
+		RegisterResidency();
+		m_loadingComplete = true;
+	});
+}
 
-	wolfVertBuffData.pSysMem = m_wolfVerticies.data();
-	wolfVertBuffData.SysMemPitch = 0;
-	wolfVertBuffData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC wolfVertBuffDesc(sizeof(VertexPositionUVNormal) * m_wolfVerticies.size(), D3D11_BIND_VERTEX_BUFFER);
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&wolfVertBuffDesc, &wolfVertBuffData, &m_wolfVertBuffer));
+// Uploads a loaded mesh and creates what drawing it needs. Each submesh samples the diffuse map of
+// its material, looked up next to objPath, or defaultTexture when it has none or the map fails to load,
+// unless UsePackedTexture draws the whole mesh from a texture pack page.
+// Only the ranges, bounds and clusters stay on the CPU; code that needs the vertices or indices
+// afterwards, such as picking, has to keep its own CachedMesh.
+void Sample3DSceneRenderer::CreateDrawableMesh(const CachedMesh& mesh, const char* objPath, const wchar_t* defaultTexture, DrawableMesh& outMesh)
+{
+	outMesh.lodCount = mesh.GetLodCount();
+	for (uint32 i = 0; i < outMesh.lodCount; ++i)
+		outMesh.lods[i] = mesh.GetLod(i);
+	outMesh.clusters.assign(mesh.GetClusters(), mesh.GetClusters() + mesh.GetClusterCount());
+	outMesh.bounds = mesh.GetBounds();
+	outMesh.indexFormat = mesh.GetIndexSize() == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	outMesh.firstLod = 0;
+	outMesh.indexBase = 0;
+	outMesh.vertexStrides[0] = mesh.GetVertexStride();
+	outMesh.vertexBufferCount = 1;
+	outMesh.vertexFormat = mesh.GetVertexFormat();
+	outMesh.submeshes.clear();
+	outMesh.submeshLods.clear();
+	for (uint32 s = 0; s < mesh.GetSubmeshCount(); ++s)
+		outMesh.submeshes.push_back(mesh.GetSubmesh(s));
+	for (uint32 lod = 0; lod < outMesh.lodCount; ++lod)
+	{
+		for (uint32 s = 0; s < mesh.GetSubmeshCount(); ++s)
+			outMesh.submeshLods.push_back(mesh.GetSubmeshLod(lod, s));
+	}
 
-	D3D11_SUBRESOURCE_DATA wolfIndexBuffData = { 0 };
+	D3D11_SUBRESOURCE_DATA vertBuffData = { 0 };
+	vertBuffData.pSysMem = mesh.GetVertexData();
+	vertBuffData.SysMemPitch = 0;
+	vertBuffData.SysMemSlicePitch = 0;
+	CD3D11_BUFFER_DESC vertBuffDesc(mesh.GetVertexStride() * mesh.GetVertexCount(), D3D11_BIND_VERTEX_BUFFER);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertBuffDesc, &vertBuffData, &outMesh.vertexBuffers[0]));
+
+	D3D11_SUBRESOURCE_DATA indexBuffData = { 0 };
+
+	indexBuffData.pSysMem = mesh.GetIndexData();
+	indexBuffData.SysMemPitch = 0;
+	indexBuffData.SysMemSlicePitch = 0;
+	CD3D11_BUFFER_DESC indexBuffDesc(mesh.GetIndexSize() * mesh.GetIndexCount(), D3D11_BIND_INDEX_BUFFER);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBuffDesc, &indexBuffData, &outMesh.indexBuffer));
+
+	D3D11_SAMPLER_DESC textureSampler;
+	ZeroMemory(&textureSampler, sizeof(textureSampler));
+	textureSampler.Filter = D3D11_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
+	textureSampler.AddressU = D3D11_TEXTURE_ADDRESS_MIRROR;
+	textureSampler.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
+	textureSampler.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
+
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateSamplerState(&textureSampler, &outMesh.sampleState));
+	DX::ThrowIfFailed(m_textureStreamer.Load(defaultTexture, outMesh.resourceView.ReleaseAndGetAddressOf()));
+
+	// Submeshes that name the same map share one view, which is what lets sorting group them.
+	std::string directory(objPath);
+	size_t slash = directory.find_last_of("/\\");
+	directory.resize(slash == std::string::npos ? 0 : slash + 1);
+	std::vector<std::string> paths(outMesh.submeshes.size());	// empty for the default texture
+	for (size_t s = 0; s < outMesh.submeshes.size(); ++s)
+	{
+		uint32 material = outMesh.submeshes[s].materialIndex;
+		if (material != MESH_NO_MATERIAL && mesh.GetMaterials()[material].diffuseMap[0])
+			paths[s] = directory + mesh.GetMaterials()[material].diffuseMap;
+	}
 
-	wolfIndexBuffData.pSysMem = m_wolfIndicies.data();
-	wolfIndexBuffData.SysMemPitch = 0;
-	wolfIndexBuffData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC wolfIndexBuffDesc(sizeof(unsigned int) * m_wolfIndicies.size(), D3D11_BIND_INDEX_BUFFER);
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&wolfIndexBuffDesc, &wolfIndexBuffData, &m_wolfIndexBuffer));
+	MeshDecodeConstants decode = mesh.GetDecode();
+	char defaultPath[MAX_PATH];
+	outMesh.textureArray = false;
+	if (WideCharToMultiByte(CP_UTF8, 0, defaultTexture, -1, defaultPath, MAX_PATH, nullptr, nullptr) == 0)
+		defaultPath[0] = '\0';
+	outMesh.textures.assign(outMesh.submeshes.size(), outMesh.resourceView);
+	if (UsePackedTexture(mesh, paths, defaultPath, decode, outMesh))
+		paths.clear();
+
+	std::vector<std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>> loaded;
+	for (size_t s = 0; s < paths.size(); ++s)
+	{
+		if (paths[s].empty())
+			continue;
 
-	D3D11_SAMPLER_DESC wolfTextureSampler;
-	ZeroMemory(&wolfTextureSampler, sizeof(wolfTextureSampler));
-	wolfTextureSampler.Filter = D3D11_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
-	wolfTextureSampler.AddressU = D3D11_TEXTURE_ADDRESS_MIRROR;
-	wolfTextureSampler.AddressV = D3D11_TEXTURE_ADDRESS_MIRROR;
-	wolfTextureSampler.AddressW = D3D11_TEXTURE_ADDRESS_MIRROR;
+		const std::string& path = paths[s];
+		auto found = std::find_if(loaded.begin(), loaded.end(), [&path](const std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& entry) { return entry.first == path; });
+		if (found == loaded.end())
+		{
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view = outMesh.resourceView;
+			wchar_t widePath[MAX_PATH];
+			if (MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath, MAX_PATH) == 0 ||
+				FAILED(m_textureStreamer.Load(widePath, view.ReleaseAndGetAddressOf())))
+			{
+				char message[512];
+				sprintf_s(message, "CreateDrawableMesh: %s, could not load %s, using the default texture\n", objPath, path.c_str());
+				OutputDebugStringA(message);
+				view = outMesh.resourceView;
+			}
+			found = loaded.insert(loaded.end(), std::make_pair(path, view));
+		}
+		outMesh.textures[s] = found->second;
+	}
 
-	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateSamplerState(&wolfTextureSampler, &m_wolfSampleState));
-	DX::ThrowIfFailed(CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/wolfBlack.dds", NULL, &m_wolfResourceView));
-	//End Wolf
+	D3D11_SUBRESOURCE_DATA decodeData = { 0 };
+	decodeData.pSysMem = &decode;
+	CD3D11_BUFFER_DESC decodeDesc(sizeof(MeshDecodeConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeDesc, &decodeData, &outMesh.decodeBuffer));
+}
 
-	// Once the cube is loaded, the object is ready to be rendered.
-	createCubeTask.then([this]()
+// Points every submesh of a mesh at the page its texture was packed into, when they all sample the
+// same texture and the texture pack lists it, and folds the texture's place in the page into the
+// uv decode: an atlas region's scale and offset, or an array slice. Meshes drawn from one page then
+// share its view, so sorting draws them without rebinding. An atlas region has no texels around it
+// to mirror or wrap into, so meshes with uvs outside 0..1 keep their own texture.
+bool Sample3DSceneRenderer::UsePackedTexture(const CachedMesh& mesh, const std::vector<std::string>& paths, const char* defaultPath, MeshDecodeConstants& decode,
+	DrawableMesh& outMesh)
+{
+	if (!m_texturePack.IsOpen() || paths.empty())
+		return false;
+	const std::string path = paths[0].empty() ? defaultPath : paths[0];
+	for (const std::string& other : paths)
 	{
-		m_loadingComplete = true;
+		if ((other.empty() ? defaultPath : other) != path)
+			return false;
+	}
+	const DX::TexturePackTableEntry* entry = m_texturePack.Find(path.c_str());
+	if (!entry)
+		return false;
+
+	const DX::TexturePackTablePage& page = m_texturePack.GetPage(entry->page);
+	if (page.layout == DX::TEXTURE_PACK_ATLAS)
+	{
+		float uvMin[2] = { decode.uvScaleOffset[2], decode.uvScaleOffset[3] };
+		float uvMax[2] = { uvMin[0] + decode.uvScaleOffset[0], uvMin[1] + decode.uvScaleOffset[1] };
+		if (mesh.GetVertexFormat() == MESH_VERTEX_FLOAT)
+		{
+			const MeshVertex* vertices = static_cast<const MeshVertex*>(mesh.GetVertexData());
+			uvMin[0] = uvMin[1] = FLT_MAX;
+			uvMax[0] = uvMax[1] = -FLT_MAX;
+			for (uint32 i = 0; i < mesh.GetVertexCount(); ++i)
+			{
+				uvMin[0] = std::min(uvMin[0], vertices[i].uv.x);
+				uvMin[1] = std::min(uvMin[1], vertices[i].uv.y);
+				uvMax[0] = std::max(uvMax[0], vertices[i].uv.x);
+				uvMax[1] = std::max(uvMax[1], vertices[i].uv.y);
+			}
+		}
+		const float tolerance = MESH_PACKING_UV_TOLERANCE;
+		if (uvMin[0] < -tolerance || uvMin[1] < -tolerance || uvMax[0] > 1.0f + tolerance || uvMax[1] > 1.0f + tolerance)
+		{
+			char message[512];
+			sprintf_s(message, "UsePackedTexture: %s is packed in an atlas but sampled outside it, using its own file\n", path.c_str());
+			OutputDebugStringA(message);
+			return false;
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& view = m_texturePackViews[entry->page];
+	if (!view)
+	{
+		wchar_t widePath[MAX_PATH];
+		if (MultiByteToWideChar(CP_UTF8, 0, m_texturePack.GetString(page.pathOffset), -1, widePath, MAX_PATH) == 0 ||
+			FAILED(m_textureStreamer.Load(widePath, view.ReleaseAndGetAddressOf())))
+		{
+			char message[512];
+			sprintf_s(message, "UsePackedTexture: could not load %s, using the textures' own files\n", m_texturePack.GetString(page.pathOffset));
+			OutputDebugStringA(message);
+			view.Reset();
+			return false;
+		}
+	}
+
+	// uv * scale + offset, then into the region: uv * (scale * regionScale) + (offset * regionScale + regionOffset).
+	for (int k = 0; k < 2; ++k)
+	{
+		decode.uvScaleOffset[k + 2] = decode.uvScaleOffset[k + 2] * entry->uvScaleOffset[k] + entry->uvScaleOffset[k + 2];
+		decode.uvScaleOffset[k] *= entry->uvScaleOffset[k];
+	}
+	decode.positionOffset[3] = static_cast<float>(entry->slice);
+	outMesh.textureArray = page.layout == DX::TEXTURE_PACK_ARRAY;
+	outMesh.textures.assign(outMesh.submeshes.size(), view);
+	return true;
+}
+
+// Opens the scan's chunk file, importing the OBJ into it first if it is missing or out of date.
+// A large scan takes a while to import, so this runs off the calling thread, into a file only the
+// task holds; UpdateScanResidency takes it over once the task is done and the scan is drawn from then on.
+void Sample3DSceneRenderer::StartScanStreaming(void)
+{
+	// Two imports at once would both write the chunk file
+	m_scanImport.wait();
+	m_scanImporting = false;
+	m_scanReady = false;
+	uint64 sourceSize;
+	if (!DX::GetFileSize(scanObjPath, sourceSize))
+		return;
+
+	CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &m_scanConstantBuffer));
+
+	std::string chunkPath = localFilePath("scan.chunks");
+	m_scanImporting = true;
+	m_scanImport = concurrency::create_task([chunkPath]()
+	{
+		char message[512];
+		MeshStreamingStats stats;
+		std::shared_ptr<MeshChunkFile> file = std::make_shared<MeshChunkFile>();
+		if (chunkPath.empty() || !OpenObjChunked(scanObjPath, chunkPath.c_str(), MESH_VERTEX_QUANTIZED, *file, scanImportBudget, &stats))
+		{
+			sprintf_s(message, "StartScanStreaming: %s could not be imported\n", scanObjPath);
+			OutputDebugStringA(message);
+			return std::shared_ptr<MeshChunkFile>();
+		}
+
+		if (stats.triangleCount > 0)
+		{
+			sprintf_s(message, "StartScanStreaming: %s, %.1f MB, %llu triangles binned on a %ux%ux%u grid into %u chunks, %u spills (%.1f MB on disk), %.1f MB buffers, %.2f + %.2f + %.2f s\n",
+				scanObjPath, stats.sourceBytes / (1024.0 * 1024.0), stats.triangleCount, stats.gridSize[0], stats.gridSize[1], stats.gridSize[2], stats.chunkCount,
+				stats.spillFlushes, stats.spillBytes / (1024.0 * 1024.0), stats.bufferBytes / (1024.0 * 1024.0), stats.boundsSeconds, stats.binSeconds, stats.writeSeconds);
+			OutputDebugStringA(message);
+		}
+		sprintf_s(message, "StartScanStreaming: %s, streaming %llu triangles in %u chunks, %.1f MB resident at most\n", scanObjPath,
+			file->GetTriangleCount(), file->GetChunkCount(), scanResidentBudget / (1024.0 * 1024.0));
+		OutputDebugStringA(message);
+		return file;
+	});
+}
+
+// Takes over the scan's chunk file once its import is done. Then asks the pager which scan chunks
+// this frame's camera needs, frees the buffers of the chunks it evicts and uploads the ones it loads.
+void Sample3DSceneRenderer::UpdateScanResidency(void)
+{
+	if (m_scanImporting && m_scanImport.is_done())
+	{
+		m_scanImporting = false;
+		m_scanFile = m_scanImport.get();
+		if (m_scanFile)
+		{
+			m_scanChunks.assign(m_scanFile->GetChunkCount(), DrawableMesh());
+			m_scanChunkAssets.assign(m_scanFile->GetChunkCount() * 2, 0);
+			m_scanPager.Reset(m_scanFile->GetChunks(), m_scanFile->GetChunkCount(), scanResidentBudget, scanLoadsPerFrame);
+			m_scanReady = true;
+		}
+	}
+	if (!m_scanReady)
+		return;
+
+	XMMATRIX scanWorld = placeObject(scanPosition.x, scanPosition.y, scanPosition.z);
+	XMMATRIX viewProjection = XMMatrixMultiply(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera)), XMMatrixTranspose(XMLoadFloat4x4(&m_floorConstantBufferData.projection)));
+	XMFLOAT4X4 worldViewProjection;
+	XMStoreFloat4x4(&worldViewProjection, XMMatrixMultiply(scanWorld, viewProjection));
+	XMVECTOR eye = XMVectorSet(m_camera._41, m_camera._42, m_camera._43, 1.0f);
+	MeshFloat3 meshEye;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&meshEye), XMVector3Transform(eye, XMMatrixInverse(nullptr, scanWorld)));
+
+	m_scanPager.Update(ComputeMeshClusterView(&worldViewProjection.m[0][0], meshEye), m_scanLoads, m_scanEvictions);
+	for (uint32 chunk : m_scanEvictions)
+	{
+		if (m_scanChunks[chunk].vertexBufferCount > 0)
+		{
+			m_residency.Unregister(m_scanChunkAssets[chunk * 2]);
+			m_residency.Unregister(m_scanChunkAssets[chunk * 2 + 1]);
+		}
+		m_scanChunks[chunk] = DrawableMesh();
+	}
+	for (uint32 chunk : m_scanLoads)
+		LoadScanChunk(chunk);
+}
+
+// Reads one scan chunk and uploads it as a single submesh with one LOD, drawn with the castle's
+// shaders and texture. A chunk that cannot be read is left without buffers and so is not drawn.
+void Sample3DSceneRenderer::LoadScanChunk(uint32 chunk)
+{
+	const MeshChunk& source = m_scanFile->GetChunk(chunk);
+	MeshVertexFormat format = static_cast<MeshVertexFormat>(source.vertexFormat);
+	size_t vertexBytes = static_cast<size_t>(source.vertexCount) * GetMeshVertexStride(format);
+	size_t indexBytes = static_cast<size_t>(source.indexCount) * source.indexSize;
+	m_scanStaging.resize(vertexBytes + indexBytes);
+	if (!m_scanFile->ReadChunk(chunk, m_scanStaging.data(), m_scanStaging.data() + vertexBytes))
+	{
+		char message[256];
+		sprintf_s(message, "LoadScanChunk: chunk %u could not be read\n", chunk);
+		OutputDebugStringA(message);
+		return;
+	}
+
+	DrawableMesh& mesh = m_scanChunks[chunk];
+	mesh.indexFormat = source.indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	mesh.vertexStrides[0] = GetMeshVertexStride(format);
+	mesh.vertexBufferCount = 1;
+	mesh.vertexFormat = format;
+	mesh.vertexShader = m_floorMesh.vertexShader;
+	mesh.pixelShader = m_floorMesh.pixelShader;
+	mesh.textureArray = false;
+	mesh.constantBuffer = m_scanConstantBuffer;
+	mesh.sampleState = m_floorMesh.sampleState;
+	mesh.resourceView = m_floorMesh.resourceView;
+
+	MeshLod whole = { 0, source.indexCount, 0.0f, 0, 0 };
+	mesh.lods[0] = whole;
+	mesh.lodCount = 1;
+	mesh.bounds = source.bounds;
+	MeshSubmesh submesh;
+	memset(&submesh, 0, sizeof(submesh));
+	submesh.materialIndex = MESH_NO_MATERIAL;
+	submesh.bounds = source.bounds;
+	mesh.submeshes.assign(1, submesh);
+	mesh.submeshLods.assign(1, whole);
+	mesh.textures.assign(1, mesh.resourceView);
+
+	D3D11_SUBRESOURCE_DATA decodeData = { 0 };
+	decodeData.pSysMem = &source.decode;
+	CD3D11_BUFFER_DESC decodeDesc(sizeof(MeshDecodeConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&decodeDesc, &decodeData, &mesh.decodeBuffer));
+
+	D3D11_SUBRESOURCE_DATA vertBuffData = { 0 };
+	vertBuffData.pSysMem = m_scanStaging.data();
+	CD3D11_BUFFER_DESC vertBuffDesc(static_cast<UINT>(vertexBytes), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertBuffDesc, &vertBuffData, &mesh.vertexBuffers[0]));
+
+	D3D11_SUBRESOURCE_DATA indexBuffData = { 0 };
+	indexBuffData.pSysMem = m_scanStaging.data() + vertexBytes;
+	CD3D11_BUFFER_DESC indexBuffDesc(static_cast<UINT>(indexBytes), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBuffDesc, &indexBuffData, &mesh.indexBuffer));
+
+	// Counted against the residency budget, but paged by m_scanPager alone.
+	m_scanChunkAssets[chunk * 2] = m_residency.Register(DX::RESIDENCY_VERTEX_BUFFER, vertexBytes, DX::RESIDENCY_PINNED);
+	m_scanChunkAssets[chunk * 2 + 1] = m_residency.Register(DX::RESIDENCY_INDEX_BUFFER, indexBytes, DX::RESIDENCY_PINNED);
+}
+
+// Puts the textures that finished streaming in place of the views they replace. Views are shared
+// by pointer between submeshes, scan chunks and meshes, so every holder of the old view is updated.
+// Once nothing is left to stream, reports how long it took.
+void Sample3DSceneRenderer::UpdateTextureStreaming(void)
+{
+	m_textureStreamer.Update(m_textureSwaps);
+	for (const DX::TextureSwap& swap : m_textureSwaps)
+	{
+		if (m_residencyReady)
+		{
+			m_textureAssets.erase(swap.oldView.Get());
+			m_textureAssets[swap.newView.Get()] = swap.handle;
+		}
+
+		auto replace = [&swap](Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& view)
+		{
+			if (view == swap.oldView)
+				view = swap.newView;
+		};
+		auto replaceMesh = [&replace](DrawableMesh& mesh)
+		{
+			replace(mesh.resourceView);
+			for (auto& texture : mesh.textures)
+				replace(texture);
+		};
+
+		replace(m_skyBoxResourceView);
+		replace(m_stoneResourceView);
+		replace(m_cubeResourceView);
+		for (auto& view : m_texturePackViews)
+			replace(view);
+		replaceMesh(m_floorMesh);
+		replaceMesh(m_wolfMesh);
+		for (DrawableMesh& mesh : m_modelMeshes)
+			replaceMesh(mesh);
+		for (DrawableMesh& mesh : m_scanChunks)
+			replaceMesh(mesh);
+	}
+
+	DX::TextureStreamingStats stats = m_textureStreamer.GetStats();
+	if (m_textureStreamingReported || stats.pendingCount > 0)
+		return;
+
+	char message[512];
+	sprintf_s(message, "Texture streaming: %u textures drawable after %.2f ms of initial loads at %u px, then %u loads (%u failed) streamed %.1f MB in the background, "
+		"latency %.2f ms average, %.2f ms worst\n", stats.textureCount, stats.initialSeconds * 1000.0, static_cast<uint32>(DX::TEXTURE_STREAMING_INITIAL_SIZE),
+		stats.loadCount, stats.failedCount, stats.streamedBytes / (1024.0 * 1024.0), stats.GetAverageLatencySeconds() * 1000.0, stats.maxLatencySeconds * 1000.0);
+	OutputDebugStringA(message);
+	sprintf_s(message, "Texture cache: %u misses, %u path hits, %u content hits, %.1f MB not loaded again; %u textures restored and %u dropped after a device loss\n",
+		stats.missCount, stats.pathHits, stats.contentHits, stats.bytesSaved / (1024.0 * 1024.0), stats.restoredCount, stats.droppedCount);
+	OutputDebugStringA(message);
+	m_textureStreamingReported = true;
+}
+
+// Counts everything the scene has put on the GPU against residencyBudget. Streamed textures can be
+// dropped to their smaller mips, down to what TextureStreamer first loads, and the castle and wolf
+// to their coarser LODs or out altogether. The rest stays: the glTF model is uploaded from a file
+// that is not kept open and the scan's chunks are paged by m_scanPager.
+void Sample3DSceneRenderer::RegisterResidency(void)
+{
+	m_residency.Reset(residencyBudget, residencyRestoresPerFrame);
+	m_textureAssets.clear();
+	m_streamedTextureCount = m_textureStreamer.GetTextureCount();
+	for (uint32 handle = 0; handle < m_streamedTextureCount; ++handle)
+	{
+		DX::DDSTextureDesc desc = m_textureStreamer.GetDesc(handle);
+		uint64 levelBytes[DX::RESIDENCY_MAX_LEVELS];
+		uint32 levelCount = std::min(DX::GetDDSSkipMips(desc, DX::TEXTURE_STREAMING_INITIAL_SIZE) + 1, DX::RESIDENCY_MAX_LEVELS);
+		for (uint32 level = 0; level < levelCount; ++level)
+			levelBytes[level] = DX::GetDDSLoadedSize(desc, level);
+		m_residency.Register(DX::RESIDENCY_TEXTURE, levelBytes, levelCount, DX::RESIDENCY_KEEP_SMALLEST);
+		m_textureAssets[m_textureStreamer.GetView(handle).Get()] = handle;
+	}
+
+	// A level of the index buffer holds the LODs from it on, which works because they are laid out
+	// finest first; the levels stop at the first LOD that does not follow the one before it.
+	m_residentMeshes.clear();
+	ResidentMesh floor = { &m_floorMesh, "Assets/icyCastle.obj", "icyCastle.mesh", MESH_VERTEX_QUANTIZED, 0, 0, false, false };
+	ResidentMesh wolf = { &m_wolfMesh, "Assets/Howling_Wolf.obj", "Howling_Wolf.mesh", MESH_VERTEX_QUANTIZED, 0, 0, false, false };
+	m_residentMeshes.push_back(floor);
+	m_residentMeshes.push_back(wolf);
+	for (ResidentMesh& resident : m_residentMeshes)
+	{
+		const DrawableMesh& mesh = *resident.mesh;
+		uint64 indexSize = mesh.indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+		uint64 indexBytes = getResourceBytes(mesh.indexBuffer.Get());
+		uint64 levelBytes[DX::RESIDENCY_MAX_LEVELS];
+		uint32 levelCount = 1;
+		levelBytes[0] = indexBytes;
+		for (uint32 lod = 1; lod < mesh.lodCount && levelCount < DX::RESIDENCY_MAX_LEVELS; ++lod)
+		{
+			if (mesh.lods[lod].indexOffset != mesh.lods[lod - 1].indexOffset + mesh.lods[lod - 1].indexCount || mesh.lods[lod].indexOffset * indexSize > indexBytes)
+				break;
+			levelBytes[levelCount++] = indexBytes - mesh.lods[lod].indexOffset * indexSize;
+		}
+		resident.vertexAsset = m_residency.Register(DX::RESIDENCY_VERTEX_BUFFER, getResourceBytes(mesh.vertexBuffers[0].Get()));
+		resident.indexAsset = m_residency.Register(DX::RESIDENCY_INDEX_BUFFER, levelBytes, levelCount);
+	}
+
+	ID3D11Buffer* vertexBuffers[] = { m_vertexBuffer.Get(), m_skyBoxVertexBuffer.Get(), m_stoneVertexBuffer.Get(), m_innerSceneVertexBuffer.Get() };
+	ID3D11Buffer* indexBuffers[] = { m_indexBuffer.Get(), m_skyBoxIndexBuffer.Get(), m_stoneIndexBuffer.Get(), m_innerSceneIndexBuffer.Get() };
+	for (ID3D11Buffer* buffer : vertexBuffers)
+		m_residency.Register(DX::RESIDENCY_VERTEX_BUFFER, getResourceBytes(buffer), DX::RESIDENCY_PINNED);
+	for (ID3D11Buffer* buffer : indexBuffers)
+		m_residency.Register(DX::RESIDENCY_INDEX_BUFFER, getResourceBytes(buffer), DX::RESIDENCY_PINNED);
+	m_residency.Register(DX::RESIDENCY_RENDER_TARGET, getResourceBytes(m_innerTargetTexture.Get()), DX::RESIDENCY_PINNED);
+
+	// Embedded glTF images were not streamed, so they are the model's views the streamer does not know.
+	std::vector<ID3D11ShaderResourceView*> modelTextures;
+	for (const DrawableMesh& mesh : m_modelMeshes)
+	{
+		for (uint32 i = 0; i < mesh.vertexBufferCount; ++i)
+			m_residency.Register(DX::RESIDENCY_VERTEX_BUFFER, getResourceBytes(mesh.vertexBuffers[i].Get()), DX::RESIDENCY_PINNED);
+		m_residency.Register(DX::RESIDENCY_INDEX_BUFFER, getResourceBytes(mesh.indexBuffer.Get()), DX::RESIDENCY_PINNED);
+		for (const auto& texture : mesh.textures)
+		{
+			if (m_textureAssets.count(texture.Get()) == 0 && std::find(modelTextures.begin(), modelTextures.end(), texture.Get()) == modelTextures.end())
+				modelTextures.push_back(texture.Get());
+		}
+	}
+	for (ID3D11ShaderResourceView* view : modelTextures)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		view->GetResource(&resource);
+		m_residency.Register(DX::RESIDENCY_TEXTURE, getResourceBytes(resource.Get()), DX::RESIDENCY_PINNED);
+	}
+	m_residencyReady = true;
+
+	const DX::ResidencyStats& stats = m_residency.GetStats();
+	char message[512];
+	sprintf_s(message, "RegisterResidency: %u assets, %.1f MB against a %.1f MB budget: vertex buffers %.1f MB, index buffers %.1f MB, textures %.1f MB, render targets %.1f MB\n",
+		stats.assetCount, stats.residentBytes / (1024.0 * 1024.0), stats.budgetBytes / (1024.0 * 1024.0),
+		stats.kindBytes[DX::RESIDENCY_VERTEX_BUFFER] / (1024.0 * 1024.0), stats.kindBytes[DX::RESIDENCY_INDEX_BUFFER] / (1024.0 * 1024.0),
+		stats.kindBytes[DX::RESIDENCY_TEXTURE] / (1024.0 * 1024.0), stats.kindBytes[DX::RESIDENCY_RENDER_TARGET] / (1024.0 * 1024.0));
+	OutputDebugStringA(message);
+}
+
+// Tells the residency manager what this viewport draws: the castle and wolf at the LOD culling
+// picked, when any of them is visible, and the texture of every submesh drawn and of the sky,
+// ground and cube.
+void Sample3DSceneRenderer::MarkResidencyUsed(uint32 floorLod, uint32 wolfLod)
+{
+	if (!m_residencyReady)
+		return;
+
+	const uint32 lods[] = { floorLod, wolfLod };
+	for (size_t i = 0; i < m_residentMeshes.size(); ++i)
+	{
+		if (lods[i] == MESH_MAX_LODS)
+			continue;
+		m_residency.MarkUsed(m_residentMeshes[i].vertexAsset);
+		m_residency.MarkUsed(m_residentMeshes[i].indexAsset, lods[i]);
+	}
+
+	auto markTexture = [this](ID3D11ShaderResourceView* view)
+	{
+		auto found = m_textureAssets.find(view);
+		if (found != m_textureAssets.end())
+			m_residency.MarkUsed(found->second);
+	};
+	for (const SubmeshDraw& draw : m_submeshDraws)
+		markTexture(draw.texture);
+	markTexture(m_skyBoxResourceView.Get());
+	markTexture(m_stoneResourceView.Get());
+	markTexture(m_cubeResourceView.Get());
+}
+
+// Applies what the residency manager decided from the last frame's draws: streamed textures get a
+// new target resolution and the castle and wolf buffers are dropped, cut down or read back. Buffers
+// read back in the background since the last frame are uploaded first.
+void Sample3DSceneRenderer::UpdateResidency(void)
+{
+	if (!m_residencyReady)
+		return;
+
+	for (ResidentMesh& resident : m_residentMeshes)
+	{
+		if (resident.restoring && resident.restore.is_done())
+			FinishMeshRestore(resident);
+	}
+
+	m_residency.Update(m_residencyChanges);
+	if (m_residencyChanges.empty())
+		return;
+
+	for (const DX::ResidencyChange& change : m_residencyChanges)
+	{
+		if (change.asset < m_streamedTextureCount)
+		{
+			DX::DDSTextureDesc desc = m_textureStreamer.GetDesc(change.asset);
+			size_t size = std::max<size_t>(std::max(desc.width, std::max(desc.height, desc.depth)) >> change.level, 1);
+			m_textureStreamer.SetTargetResolution(change.asset, change.level == 0 ? 0 : size);
+			continue;
+		}
+		for (ResidentMesh& resident : m_residentMeshes)
+			resident.changed = resident.changed || change.asset == resident.vertexAsset || change.asset == resident.indexAsset;
+	}
+	for (ResidentMesh& resident : m_residentMeshes)
+	{
+		if (resident.changed)
+			ApplyMeshResidency(resident);
+		resident.changed = false;
+	}
+
+	const DX::ResidencyStats& stats = m_residency.GetStats();
+	char message[256];
+	sprintf_s(message, "UpdateResidency: %u changes, %.1f of %.1f MB resident, %u assets reduced and %u evicted\n", static_cast<uint32>(m_residencyChanges.size()),
+		stats.residentBytes / (1024.0 * 1024.0), stats.budgetBytes / (1024.0 * 1024.0), stats.reducedCount, stats.evictedCount);
+	OutputDebugStringA(message);
+}
+
+// Makes a resident mesh's buffers match the levels the manager gave them. Dropping LODs copies the
+// part of the index buffer that stays on the GPU. Anything more than is there is read back from
+// the mesh cache by a task, so the frame never waits on the disk; the mesh keeps drawing the
+// buffers it has until FinishMeshRestore uploads the rest. Only a cache hit can restore a mesh:
+// importing the OBJ again would stall the frame far longer than the residency change saves.
+void Sample3DSceneRenderer::ApplyMeshResidency(ResidentMesh& resident)
+{
+	DrawableMesh& mesh = *resident.mesh;
+	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	uint32 vertexLevel = m_residency.GetLevel(resident.vertexAsset);
+	uint32 indexLevel = m_residency.GetLevel(resident.indexAsset);
+	uint32 indexSize = mesh.indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	if (vertexLevel == DX::RESIDENCY_EVICTED)
+		mesh.vertexBuffers[0].Reset();
+	if (indexLevel == DX::RESIDENCY_EVICTED)
+		mesh.indexBuffer.Reset();
+
+	if (indexLevel != DX::RESIDENCY_EVICTED && mesh.indexBuffer && indexLevel > mesh.firstLod)
+	{
+		D3D11_BUFFER_DESC desc;
+		mesh.indexBuffer->GetDesc(&desc);
+		UINT begin = (mesh.lods[indexLevel].indexOffset - mesh.indexBase) * indexSize;
+		CD3D11_BUFFER_DESC keptDesc(desc.ByteWidth - begin, D3D11_BIND_INDEX_BUFFER);
+		Microsoft::WRL::ComPtr<ID3D11Buffer> kept;
+		DX::ThrowIfFailed(device->CreateBuffer(&keptDesc, nullptr, &kept));
+		D3D11_BOX box = { begin, 0, 0, desc.ByteWidth, 1, 1 };
+		m_deviceResources->GetD3DDeviceContext()->CopySubresourceRegion(kept.Get(), 0, 0, 0, 0, mesh.indexBuffer.Get(), 0, &box);
+		mesh.indexBuffer = kept;
+		mesh.firstLod = indexLevel;
+		mesh.indexBase = mesh.lods[indexLevel].indexOffset;
+	}
+
+	// A restore already running is checked against the levels the mesh has when it finishes
+	bool needVertices = vertexLevel != DX::RESIDENCY_EVICTED && !mesh.vertexBuffers[0];
+	bool needIndices = indexLevel != DX::RESIDENCY_EVICTED && (!mesh.indexBuffer || indexLevel < mesh.firstLod);
+	if ((!needVertices && !needIndices) || resident.restoring)
+		return;
+
+	// The task holds copies of what it reads, so one dropped by a reset just finishes unseen
+	const char* objPath = resident.objPath;
+	std::string cachePath = localFilePath(resident.cacheName);
+	MeshVertexFormat format = resident.format;
+	resident.restoring = true;
+	resident.restore = concurrency::create_task([objPath, cachePath, format]()
+	{
+		std::shared_ptr<CachedMesh> cached = std::make_shared<CachedMesh>();
+		if (cachePath.empty() || !OpenObjCache(objPath, cachePath.c_str(), format, *cached))
+			return std::shared_ptr<CachedMesh>();
+		return cached;
 	});
 }
 
+// Uploads the buffers a finished restore read back that the mesh is still missing; its levels may
+// have changed while the restore ran. This is the only part of a restore on the render thread.
+void Sample3DSceneRenderer::FinishMeshRestore(ResidentMesh& resident)
+{
+	resident.restoring = false;
+	std::shared_ptr<CachedMesh> cached = resident.restore.get();
+	DrawableMesh& mesh = *resident.mesh;
+	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	uint32 vertexLevel = m_residency.GetLevel(resident.vertexAsset);
+	uint32 indexLevel = m_residency.GetLevel(resident.indexAsset);
+	uint32 indexSize = mesh.indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	bool needVertices = vertexLevel != DX::RESIDENCY_EVICTED && !mesh.vertexBuffers[0];
+	bool needIndices = indexLevel != DX::RESIDENCY_EVICTED && (!mesh.indexBuffer || indexLevel < mesh.firstLod);
+	if (!needVertices && !needIndices)
+		return;
+
+	if (!cached || cached->GetVertexFormat() != mesh.vertexFormat || cached->GetIndexSize() != indexSize)
+	{
+		char message[256];
+		sprintf_s(message, "FinishMeshRestore: %s is not in its mesh cache, it is not drawn until it can be read back\n", resident.objPath);
+		OutputDebugStringA(message);
+		return;
+	}
+
+	if (needVertices)
+	{
+		D3D11_SUBRESOURCE_DATA vertBuffData = { 0 };
+		vertBuffData.pSysMem = cached->GetVertexData();
+		CD3D11_BUFFER_DESC vertBuffDesc(cached->GetVertexStride() * cached->GetVertexCount(), D3D11_BIND_VERTEX_BUFFER);
+		DX::ThrowIfFailed(device->CreateBuffer(&vertBuffDesc, &vertBuffData, &mesh.vertexBuffers[0]));
+	}
+	if (needIndices)
+	{
+		uint32 begin = mesh.lods[indexLevel].indexOffset;
+		D3D11_SUBRESOURCE_DATA indexBuffData = { 0 };
+		indexBuffData.pSysMem = static_cast<const uint8*>(cached->GetIndexData()) + begin * indexSize;
+		CD3D11_BUFFER_DESC indexBuffDesc((cached->GetIndexCount() - begin) * indexSize, D3D11_BIND_INDEX_BUFFER);
+		DX::ThrowIfFailed(device->CreateBuffer(&indexBuffDesc, &indexBuffData, &mesh.indexBuffer));
+		mesh.firstLod = indexLevel;
+		mesh.indexBase = begin;
+	}
+}
+
+// Uploads every triangle primitive of Assets/model.glb straight from the mapped file: each buffer
+// view a primitive reads becomes a vertex buffer as it lies, fetched in its stored formats through
+// an input layout of the primitive's own. Base color textures are used when they are DDS, embedded
+// through MSFT_texture_dds or next to the file. Does nothing when the app ships no model.
+void Sample3DSceneRenderer::LoadGlbModel(const std::vector<byte>& vertexShader, const std::vector<byte>& pixelShader)
+{
+	m_modelMeshes.clear();
+	m_modelTransforms.clear();
+	uint64 fileSize;
+	if (!DX::GetFileSize(modelGlbPath, fileSize))
+		return;
+
+	char message[512];
+	GlbFile file;
+	GlbLoadStats stats;
+	if (!file.Open(modelGlbPath, &stats))
+	{
+		sprintf_s(message, "LoadGlbModel: %s is not a glTF 2.0 binary that can be drawn as it is\n", modelGlbPath);
+		OutputDebugStringA(message);
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> modelVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> modelPixelShader;
+	DX::ThrowIfFailed(device->CreateVertexShader(&vertexShader[0], vertexShader.size(), nullptr, &modelVertexShader));
+	DX::ThrowIfFailed(device->CreatePixelShader(&pixelShader[0], pixelShader.size(), nullptr, &modelPixelShader));
+
+	D3D11_SAMPLER_DESC textureSampler;
+	ZeroMemory(&textureSampler, sizeof(textureSampler));
+	textureSampler.Filter = D3D11_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
+	textureSampler.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	textureSampler.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	textureSampler.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampleState;
+	DX::ThrowIfFailed(device->CreateSamplerState(&textureSampler, &sampleState));
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> defaultTexture;
+	DX::ThrowIfFailed(m_textureStreamer.Load(L"Assets/iceCastleTexture.dds", defaultTexture.ReleaseAndGetAddressOf()));
+
+	// Images are created on first use, so primitives that sample the same one share its view.
+	std::string directory(modelGlbPath);
+	size_t slash = directory.find_last_of("/\\");
+	directory.resize(slash == std::string::npos ? 0 : slash + 1);
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> images(file.GetImageCount());
+
+	m_modelMeshes.resize(file.GetPrimitiveCount());
+	m_modelTransforms.resize(file.GetPrimitiveCount());
+	uint64 uploadedBytes = 0;
+	for (uint32 p = 0; p < file.GetPrimitiveCount(); ++p)
+	{
+		const GlbPrimitive& primitive = file.GetPrimitive(p);
+		DrawableMesh& mesh = m_modelMeshes[p];
+
+		MeshAttribute attributes[MESH_VERTEX_ATTRIBUTE_COUNT];
+		uint32 slots[MESH_VERTEX_ATTRIBUTE_COUNT];
+		for (uint32 i = 0; i < MESH_VERTEX_ATTRIBUTE_COUNT; ++i)
+		{
+			attributes[i].semantic = primitive.attributes[i].semantic;
+			attributes[i].format = primitive.attributes[i].format;
+			attributes[i].offset = primitive.attributes[i].offset;
+			slots[i] = primitive.attributes[i].stream;
+		}
+		createMeshInputLayout(device, attributes, slots, vertexShader, &mesh.inputLayout);
+
+		mesh.vertexBufferCount = primitive.streamCount;
+		for (uint32 i = 0; i < primitive.streamCount; ++i)
+		{
+			D3D11_SUBRESOURCE_DATA vertBuffData = { 0 };
+			vertBuffData.pSysMem = primitive.streams[i].data;
+			CD3D11_BUFFER_DESC vertBuffDesc(primitive.streams[i].size, D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+			DX::ThrowIfFailed(device->CreateBuffer(&vertBuffDesc, &vertBuffData, &mesh.vertexBuffers[i]));
+			mesh.vertexStrides[i] = primitive.streams[i].stride;
+			uploadedBytes += primitive.streams[i].size;
+		}
+
+		D3D11_SUBRESOURCE_DATA indexBuffData = { 0 };
+		indexBuffData.pSysMem = primitive.indexData;
+		CD3D11_BUFFER_DESC indexBuffDesc(primitive.indexCount * primitive.indexSize, D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(device->CreateBuffer(&indexBuffDesc, &indexBuffData, &mesh.indexBuffer));
+		mesh.indexFormat = primitive.indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		mesh.vertexFormat = MESH_VERTEX_FLOAT;
+		uploadedBytes += primitive.indexCount * primitive.indexSize;
+
+		D3D11_SUBRESOURCE_DATA decodeData = { 0 };
+		decodeData.pSysMem = &primitive.decode;
+		CD3D11_BUFFER_DESC decodeDesc(sizeof(MeshDecodeConstants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+		DX::ThrowIfFailed(device->CreateBuffer(&decodeDesc, &decodeData, &mesh.decodeBuffer));
+
+		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+		DX::ThrowIfFailed(device->CreateBuffer(&constantBufferDesc, nullptr, &mesh.constantBuffer));
+		mesh.vertexShader = modelVertexShader;
+		mesh.pixelShader = modelPixelShader;
+		mesh.textureArray = false;
+		mesh.sampleState = sampleState;
+		mesh.resourceView = defaultTexture;
+
+		uint32 image = primitive.image;
+		if (image != GLB_NONE && !images[image])
+		{
+			const GlbImage& source = file.GetImage(image);
+			HRESULT result = E_FAIL;
+			if (source.data)
+			{
+				result = CreateDDSTextureFromMemory(device, source.data, source.size, NULL, &images[image]);
+			}
+			else if (source.uri.size() > 4 && _stricmp(source.uri.c_str() + source.uri.size() - 4, ".dds") == 0)
+			{
+				wchar_t widePath[MAX_PATH];
+				if (MultiByteToWideChar(CP_UTF8, 0, (directory + source.uri).c_str(), -1, widePath, MAX_PATH) != 0)
+					result = m_textureStreamer.Load(widePath, images[image].ReleaseAndGetAddressOf());
+			}
+			if (FAILED(result))
+			{
+				sprintf_s(message, "LoadGlbModel: %s, image %u is not a DDS texture that could be loaded, using the default texture\n", modelGlbPath, image);
+				OutputDebugStringA(message);
+				images[image] = defaultTexture;
+			}
+		}
+
+		MeshLod whole = { 0, primitive.indexCount, 0.0f, 0, 0 };
+		mesh.lods[0] = whole;
+		mesh.lodCount = 1;
+		mesh.bounds = primitive.bounds;
+		MeshSubmesh submesh;
+		memset(&submesh, 0, sizeof(submesh));
+		memcpy(submesh.name, primitive.name, sizeof(submesh.name));
+		submesh.materialIndex = MESH_NO_MATERIAL;
+		submesh.bounds = primitive.bounds;
+		mesh.submeshes.assign(1, submesh);
+		mesh.submeshLods.assign(1, whole);
+		mesh.textures.assign(1, image != GLB_NONE ? images[image] : defaultTexture);
+
+		static_assert(sizeof(XMFLOAT4X4) == sizeof(primitive.transform), "GlbPrimitive::transform must match XMFLOAT4X4");
+		memcpy(&m_modelTransforms[p], primitive.transform, sizeof(primitive.transform));
+	}
+
+	double uploadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	sprintf_s(message, "LoadGlbModel: %s, %u primitives (%u skipped), %u vertices, %u triangles, %.1f MB uploaded straight from the file, %.1f KB of indices widened or generated; opened in %.2f ms, uploaded in %.2f ms\n",
+		modelGlbPath, stats.primitiveCount, stats.skippedPrimitives, stats.vertexCount, stats.triangleCount, uploadedBytes / (1024.0 * 1024.0),
+		stats.copiedBytes / 1024.0, stats.seconds * 1000.0, uploadSeconds * 1000.0);
+	OutputDebugStringA(message);
+}
+
 void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 {
 	m_loadingComplete = false;
+	// First, while the meshes still hold their views, so the textures they draw with are the ones
+	// the streamer reloads when the device comes back.
+	m_textureStreamer.ReleaseDevice();
 	m_vertexShader.Reset();
 	m_inputLayout.Reset();
 	m_pixelShader.Reset();
@@ -1163,12 +2208,41 @@ void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 	m_indexBuffer.Reset();
 
 	//floor
-	m_floorVertBuffer.Reset();
-	m_floorConstantBuffer.Reset();
+	m_floorMesh.vertexBuffers[0].Reset();
+	m_floorMesh.indexBuffer.Reset();
+	m_floorMesh.constantBuffer.Reset();
 
 	//wolf
-	m_wolfVertBuffer.Reset();
-	m_wolfConstantBuffer.Reset();
+	m_wolfMesh.vertexBuffers[0].Reset();
+	m_wolfMesh.indexBuffer.Reset();
+	m_wolfMesh.constantBuffer.Reset();
+
+	//model
+	m_modelMeshes.clear();
+	m_modelTransforms.clear();
+
+	//scan and residency, together: the pager's resident chunks and the manager's levels describe
+	//buffers released here, and would still read as resident after a restore. The import is joined
+	//first, so it cannot hand over a file after the restore starts another. Mesh restores still
+	//running hold nothing of ours and are dropped with m_residentMeshes.
+	m_scanImport.wait();
+	m_scanImporting = false;
+	m_scanReady = false;
+	m_scanChunks.clear();
+	m_scanChunkAssets.clear();
+	m_scanPager.Reset(nullptr, 0, 0, 0);
+	m_scanFile.reset();
+	m_scanConstantBuffer.Reset();
+	m_residencyReady = false;
+	m_residency.Reset(residencyBudget, residencyRestoresPerFrame);
+	m_residentMeshes.clear();
+	m_textureAssets.clear();
+
+	//streamed textures
+	m_textureSwaps.clear();
+	m_texturePackViews.clear();
+	m_texturePack.Close();
+	m_textureArrayPixelShader.Reset();
 
 	//memory cleanup
 	delete m_vp1;
@@ -1176,77 +2250,150 @@ void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 	delete m_vp3;
 }
 
-#pragma warning(disable:4996)
-bool loadObject(const char * path, std::vector <VertexPositionUVNormal> & outVertices, std::vector <unsigned int> & outIndicies)
+// UTF-8 path of a file in the app's local folder, where caches live since the install folder is
+// read-only. Empty if it cannot be converted.
+std::string localFilePath(const char * name)
 {
-	std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
-	std::vector<XMFLOAT3> tempVerts;
-	std::vector<XMFLOAT3> tempUVs;
-	std::vector<XMFLOAT3> tempNormals;
+	Platform::String^ localFolder = Windows::Storage::ApplicationData::Current->LocalFolder->Path;
+	std::wstring widePath = std::wstring(localFolder->Data()) + L"\\";
+	for (const char* c = name; *c; ++c)
+		widePath += static_cast<wchar_t>(*c);
+	char path[MAX_PATH * 3];
+	if (!WideCharToMultiByte(CP_UTF8, 0, widePath.c_str(), -1, path, sizeof(path), nullptr, nullptr))
+		return std::string();
+	return path;
+}
 
-	FILE * file = fopen(path, "r");
-	if (!file)
+bool loadObject(const char * path, const char * cacheName, MeshVertexFormat format, CachedMesh & outMesh)
+{
+	static_assert(sizeof(VertexPositionUVNormal) == sizeof(MeshVertex), "MeshVertex must match the VertexPositionUVNormal layout");
+
+	std::string cachePath = localFilePath(cacheName);
+
+	MeshCacheStats stats;
+	if (!LoadObjWithCache(path, cachePath.empty() ? nullptr : cachePath.c_str(), format, outMesh, &stats))
 		return false;
 
-	while (true)
+	char message[512];
+	for (uint32 i = 0; i < outMesh.GetSubmeshCount(); ++i)
 	{
-		char line[128];
-		int endCheck = fscanf(file, "%s", line);
-		if (endCheck == EOF)
-			break;
-		if (strcmp(line, "v") == 0)
-		{
-			XMFLOAT3 vertex;
-			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-			tempVerts.push_back(vertex);
-		}
-		else if (strcmp(line, "vt") == 0)
-		{
-			XMFLOAT3 uv;
-			fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
-			uv.y = 1 - uv.y;
-			tempUVs.push_back(uv);
-		}
-		else if (strcmp(line, "vn") == 0)
-		{
-			XMFLOAT3 norm;
-			fscanf_s(file, "%f %f %f\n", &norm.x, &norm.y, &norm.z);
-			tempNormals.push_back(norm);
-		}
-		else if (strcmp(line, "f") == 0)
-		{
-			std::string v1, v2, v3;
-			UINT vIndex[3], uvIndex[3], normIndex[3];
-			int check = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vIndex[0], &uvIndex[0], &normIndex[0], &vIndex[1], &uvIndex[1], &normIndex[1], &vIndex[2], &uvIndex[2], &normIndex[2]);
-			if (check != 9)
-				return false;
-			vertexIndices.push_back(vIndex[0]);
-			vertexIndices.push_back(vIndex[1]);
-			vertexIndices.push_back(vIndex[2]);
-			uvIndices.push_back(uvIndex[0]);
-			uvIndices.push_back(uvIndex[1]);
-			uvIndices.push_back(uvIndex[2]);
-			normalIndices.push_back(normIndex[0]);
-			normalIndices.push_back(normIndex[1]);
-			normalIndices.push_back(normIndex[2]);
-		}
+		const MeshSubmesh& submesh = outMesh.GetSubmesh(i);
+		sprintf_s(message, "loadObject: %s, submesh %u '%s': %u triangles, material '%s'%s\n", path, i, submesh.name, outMesh.GetSubmeshLod(0, i).indexCount / 3,
+			submesh.material, submesh.materialIndex != MESH_NO_MATERIAL ? "" : submesh.material[0] ? " (not found)" : "");
+		OutputDebugStringA(message);
+	}
+	if (!stats.materialsLoaded)
+	{
+		sprintf_s(message, "loadObject: %s, not every material library could be read; %u materials loaded\n", path, static_cast<uint32>(outMesh.GetMaterials().size()));
+		OutputDebugStringA(message);
 	}
 
-	for (UINT i = 0; i < vertexIndices.size(); i++)
+	if (stats.cacheHit)
 	{
-		VertexPositionUVNormal temp;
-		UINT vertInd = vertexIndices[i];
-		temp.pos = tempVerts[vertInd - 1];
+		sprintf_s(message, "loadObject: %s, cache hit, %u vertices (format %u, %u bytes each) mapped / %u %u-bit indices in %u LODs and %u clusters decoded from %.1f KB in %.2f ms (hash %.2f ms)\n", path,
+			outMesh.GetVertexCount(), outMesh.GetVertexFormat(), outMesh.GetVertexStride(), outMesh.GetIndexCount(), outMesh.GetIndexSize() * 8, outMesh.GetLodCount(), outMesh.GetClusterCount(),
+			outMesh.GetIndexFileBytes() / 1024.0, stats.loadSeconds * 1000.0, stats.hashSeconds * 1000.0);
+		OutputDebugStringA(message);
+		return true;
+	}
 
-		UINT UVInd = uvIndices[i];
-		temp.uv = tempUVs[UVInd - 1];
+	sprintf_s(message, "loadObject: %s, %u triangles, %.1f KB in %.2f ms on %u threads (%.1f MB/s)\n", path, stats.parse.triangleCount,
+		stats.parse.fileBytes / 1024.0, stats.parse.parseSeconds * 1000.0, stats.parse.threadCount, stats.parse.GetMegabytesPerSecond());
+	OutputDebugStringA(message);
+	sprintf_s(message, "loadObject: %s, welded %u -> %u vertices (%.1f KB -> %.1f KB)\n", path, stats.parse.cornerCount, stats.parse.vertexCount,
+		stats.parse.cornerCount * sizeof(VertexPositionUVNormal) / 1024.0, stats.parse.vertexCount * sizeof(VertexPositionUVNormal) / 1024.0);
+	OutputDebugStringA(message);
+	const VertexCacheStats* passes[] = { &stats.optimize.input, &stats.optimize.afterCache, &stats.optimize.afterOverdraw, &stats.optimize.afterFetch };
+	const char* passNames[] = { "input", "vertex cache", "overdraw", "vertex fetch" };
+	for (int i = 0; i < 4; ++i)
+	{
+		sprintf_s(message, "loadObject: %s, %-12s ACMR %.3f ATVR %.3f overfetch %.3f\n", path, passNames[i], passes[i]->acmr, passes[i]->atvr, passes[i]->overfetch);
+		OutputDebugStringA(message);
+	}
+	sprintf_s(message, "loadObject: %s, optimized in %.2f ms (%u overdraw clusters)\n", path, stats.optimize.seconds * 1000.0, stats.optimize.clusterCount);
+	OutputDebugStringA(message);
+	sprintf_s(message, "loadObject: %s, %u LODs built in %.2f ms\n", path, stats.lods.lodCount, stats.lods.seconds * 1000.0);
+	OutputDebugStringA(message);
+	for (uint32 i = 0; i < outMesh.GetLodCount(); ++i)
+	{
+		sprintf_s(message, "loadObject: %s, LOD %u: %u triangles, error %.4f, %u clusters\n", path, i, outMesh.GetLod(i).indexCount / 3, outMesh.GetLod(i).error,
+			outMesh.GetLod(i).clusterCount);
+		OutputDebugStringA(message);
+	}
+	sprintf_s(message, "loadObject: %s, %u clusters built in %.2f ms, %.1f triangles and %.1f vertices each on average\n", path, stats.clusters.clusterCount,
+		stats.clusters.seconds * 1000.0, stats.clusters.averageTriangles, stats.clusters.averageVertices);
+	OutputDebugStringA(message);
+	sprintf_s(message, "loadObject: %s, vertex format %u (asked for %u), %u -> %u bytes per vertex, error: position %.2e, uv %.2e, normal %.3f deg\n", path,
+		outMesh.GetVertexFormat(), format, (unsigned int)sizeof(VertexPositionUVNormal), outMesh.GetVertexStride(),
+		stats.packingError.position, stats.packingError.uv, stats.packingError.normalDegrees);
+	OutputDebugStringA(message);
+	sprintf_s(message, "loadObject: %s, cache %s\n", path, stats.cacheWritten ? "written" : "could not be written, using in-memory mesh");
+	OutputDebugStringA(message);
+	sprintf_s(message, "loadObject: %s, import temporaries peaked at %.1f MB (%.1f MB reserved), all released\n", path,
+		stats.arenaPeakBytes / (1024.0 * 1024.0), stats.arenaReservedBytes / (1024.0 * 1024.0));
+	OutputDebugStringA(message);
+	if (stats.cacheWritten)
+	{
+		sprintf_s(message, "loadObject: %s, %u %u-bit indices, %.1f KB -> %.1f KB compressed\n", path, outMesh.GetIndexCount(), outMesh.GetIndexSize() * 8,
+			outMesh.GetIndexCount() * outMesh.GetIndexSize() / 1024.0, outMesh.GetIndexFileBytes() / 1024.0);
+		OutputDebugStringA(message);
+	}
 
-		UINT normInd = normalIndices[i];
-		temp.normal = tempNormals[normInd - 1];
+	return true;
+}
 
-		outVertices.push_back(temp);
-		outIndicies.push_back(i);
+// Input layout for LightingVertexShader. slots gives each attribute's input slot; null puts them all in slot 0.
+void createMeshInputLayout(ID3D11Device * device, const MeshAttribute * attributes, const uint32 * slots, const std::vector<byte> & shader, ID3D11InputLayout ** outLayout)
+{
+	// Indexed by MeshSemantic.
+	static const char* semanticNames[] = { "POSITION", "UV", "NORMAL" };
+
+	D3D11_INPUT_ELEMENT_DESC vertexDesc[MESH_VERTEX_ATTRIBUTE_COUNT];
+	for (uint32 i = 0; i < MESH_VERTEX_ATTRIBUTE_COUNT; ++i)
+	{
+		vertexDesc[i].SemanticName = semanticNames[attributes[i].semantic];
+		vertexDesc[i].SemanticIndex = 0;
+		vertexDesc[i].Format = static_cast<DXGI_FORMAT>(attributes[i].format);
+		vertexDesc[i].InputSlot = slots ? slots[i] : 0;
+		vertexDesc[i].AlignedByteOffset = attributes[i].offset;
+		vertexDesc[i].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		vertexDesc[i].InstanceDataStepRate = 0;
 	}
 
-	return true;
-}
\ No newline at end of file
+	DX::ThrowIfFailed(device->CreateInputLayout(vertexDesc, ARRAYSIZE(vertexDesc), &shader[0], shader.size(), outLayout));
+}
+
+XMMATRIX placeObject(float x, float y, float z)
+{
+	return XMMatrixMultiply(XMMatrixRotationY(3.14f), XMMatrixTranslation(x, y, z));
+}
+
+// Bytes a buffer or a 2D texture with all of its mips and slices takes, as its desc gives them.
+// 0 for anything else.
+uint64 getResourceBytes(ID3D11Resource * resource)
+{
+	if (!resource)
+		return 0;
+
+	D3D11_RESOURCE_DIMENSION dimension;
+	resource->GetType(&dimension);
+	if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+	{
+		D3D11_BUFFER_DESC desc;
+		static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+		return desc.ByteWidth;
+	}
+	if (dimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+		return 0;
+
+	D3D11_TEXTURE2D_DESC desc;
+	static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+	uint64 bytes = 0;
+	for (UINT mip = 0; mip < desc.MipLevels; ++mip)
+	{
+		size_t mipBytes = 0;
+		DX::GetSurfaceInfo(std::max<UINT>(desc.Width >> mip, 1), std::max<UINT>(desc.Height >> mip, 1), desc.Format, &mipBytes, nullptr, nullptr);
+		bytes += mipBytes;
+	}
+	return bytes * desc.ArraySize;
+}
@@ -2,19 +2,40 @@
 
 #include "..\Common\DeviceResources.h"
 #include "ShaderStructures.h"
+#include "MeshPacking.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+#include "MeshStreaming.h"
 #include "..\Common\StepTimer.h"
+#include "..\Common\TextureStreamer.h"
+#include "..\Common\ResidencyManager.h"
+#include "..\Common\TexturePacker.h"
 
+#include <memory>
+#include <ppltasks.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "..\Common\DDSTextureLoader.h"
 
+// Define SCENE_DRAW_BENCHMARK to 1 in a debug build's preprocessor definitions to fly the draw
+// benchmark's camera path once the meshes load. It is off by default so that startup and every
+// device restore do not pay for 600 simulated frames.
+#if !defined(SCENE_DRAW_BENCHMARK)
+#define SCENE_DRAW_BENCHMARK 0
+#endif
+
 
 namespace DX11UWA
 {
+	class CachedMesh;
+
 	// This sample renderer instantiates a basic rendering pipeline.
 	class Sample3DSceneRenderer
 	{
 	public:
 		Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+		~Sample3DSceneRenderer(void);
 		void CreateDeviceDependentResources(void);
 		void CreateWindowSizeDependentResources(void);
 		void ReleaseDeviceDependentResources(void);
@@ -33,8 +54,93 @@ namespace DX11UWA
 
 
 	private:
+		// A mesh drawn with LightingVertexShader: its GPU state, the LOD, submesh and cluster
+		// ranges it is culled with and the texture each submesh samples. Cached meshes have one
+		// vertex buffer in a MeshVertexFormat; glTF primitives keep the buffer views they were
+		// read from, one per input slot, and an input layout of their own.
+		struct DrawableMesh
+		{
+			Microsoft::WRL::ComPtr<ID3D11Buffer>						vertexBuffers[MESH_VERTEX_ATTRIBUTE_COUNT];
+			UINT														vertexStrides[MESH_VERTEX_ATTRIBUTE_COUNT];
+			uint32														vertexBufferCount;
+			Microsoft::WRL::ComPtr<ID3D11Buffer>						indexBuffer;
+			DXGI_FORMAT													indexFormat;
+			uint32														firstLod;		// finest LOD indexBuffer holds; residency can drop the ones before it
+			uint32														indexBase;		// where indexBuffer starts in the mesh's index array
+			MeshVertexFormat											vertexFormat;
+			Microsoft::WRL::ComPtr<ID3D11InputLayout>					inputLayout;	// overrides the shared layout for vertexFormat
+			Microsoft::WRL::ComPtr<ID3D11Buffer>						decodeBuffer;
+			Microsoft::WRL::ComPtr<ID3D11VertexShader>					vertexShader;
+			Microsoft::WRL::ComPtr<ID3D11PixelShader>					pixelShader;
+			bool														textureArray;	// samples a texture pack's array page, with m_textureArrayPixelShader
+			Microsoft::WRL::ComPtr<ID3D11Buffer>						constantBuffer;
+			Microsoft::WRL::ComPtr<ID3D11SamplerState>					sampleState;
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>			resourceView;	// for submeshes without a diffuse map
+			MeshLod														lods[MESH_MAX_LODS];
+			uint32														lodCount;
+			MeshBounds													bounds;
+			std::vector<MeshCluster>									clusters;
+			std::vector<MeshSubmesh>									submeshes;
+			std::vector<MeshLod>										submeshLods;	// lodCount per submesh, level-major
+			std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	textures;		// one per submesh
+		};
+
+		// What is left of one submesh after culling: a run of m_drawRanges.
+		struct SubmeshDraw
+		{
+			const DrawableMesh*			mesh;
+			ID3D11ShaderResourceView*	texture;
+			uint32						rangeOffset;
+			uint32						rangeCount;
+		};
+
+		// A mesh the residency manager may drop to coarser LODs or evict, read back from its mesh
+		// cache when it is drawn again.
+		struct ResidentMesh
+		{
+			DrawableMesh*		mesh;
+			const char*			objPath;
+			const char*			cacheName;
+			MeshVertexFormat	format;			// asked of the cache
+			uint32				vertexAsset;
+			uint32				indexAsset;
+			bool				changed;
+			bool				restoring;		// restore has not been taken over yet
+			concurrency::task<std::shared_ptr<CachedMesh>>	restore;	// reads buffers back from the cache
+		};
+
+		struct SubmeshDrawStats
+		{
+			uint32					submeshCount;
+			uint32					submeshesCulled;	// by their bounds, before any cluster is tested
+			uint32					textureBinds;
+			uint32					unsortedTextureBinds;	// what drawing in load order would have cost
+			MeshClusterCullStats	clusters;
+		};
+
 		void Rotate(float radians);
 		void UpdateCamera(DX::StepTimer const& timer, float const moveSpd, float const rotSpd);
+		void CreateDrawableMesh(const CachedMesh& mesh, const char* objPath, const wchar_t* defaultTexture, DrawableMesh& outMesh);
+		bool UsePackedTexture(const CachedMesh& mesh, const std::vector<std::string>& paths, const char* defaultPath, MeshDecodeConstants& decode,
+			DrawableMesh& outMesh);
+		uint32 SelectLod(const MeshLod* lods, uint32 lodCount, const MeshBounds& bounds, DirectX::FXMMATRIX world, DirectX::FXMVECTOR eye, float viewportHeight) const;
+		uint32 CullSubmeshes(const DrawableMesh& mesh, DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProjection, DirectX::FXMVECTOR eye, float viewportHeight,
+			SubmeshDrawStats* stats = nullptr);
+		void SortSubmeshDraws(SubmeshDrawStats* stats = nullptr);
+		void DrawSubmeshes(ID3D11DeviceContext3* context) const;
+#if SCENE_DRAW_BENCHMARK
+		void ReportDrawBenchmark(void);
+#endif
+		void StartScanStreaming(void);
+		void UpdateScanResidency(void);
+		void LoadScanChunk(uint32 chunk);
+		void UpdateTextureStreaming(void);
+		void RegisterResidency(void);
+		void MarkResidencyUsed(uint32 floorLod, uint32 wolfLod);
+		void UpdateResidency(void);
+		void ApplyMeshResidency(ResidentMesh& resident);
+		void FinishMeshRestore(ResidentMesh& resident);
+		void LoadGlbModel(const std::vector<byte>& vertexShader, const std::vector<byte>& pixelShader);
 
 	private:
 		// Cached pointer to device resources.
@@ -67,33 +173,61 @@ namespace DX11UWA
 		DirectX::XMFLOAT4X4 m_camera;
 
 		//Loading Floor object (now castle)
-		std::vector<VertexPositionUVNormal>					m_floorVerticies;
-		std::vector<unsigned int>							m_floorIndicies;
-		std::vector<VertexPositionUVNormal>					m_floorVertexPositionUVNormal;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_floorVertBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_floorIndexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11VertexShader>			m_floorVertexShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>			m_floorPixelShader;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_floorConstantBuffer;
-		Microsoft::WRL::ComPtr<ID3D11InputLayout>			m_floorInputLayout;
-		Microsoft::WRL::ComPtr<ID3D11SamplerState>			m_floorSampleState;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	m_floorResourceView;
+		DrawableMesh										m_floorMesh;
 		ModelViewProjectionConstantBuffer					m_floorConstantBufferData;
 
+		// Input layouts for each MeshVertexFormat, shared by the meshes drawn with LightingVertexShader.
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>			m_meshInputLayouts[MESH_VERTEX_FORMAT_COUNT];
+		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_identityDecodeBuffer;
+
+		// Castle and wolf submeshes that survived culling this pass, in draw order.
+		std::vector<SubmeshDraw>							m_submeshDraws;
+		std::vector<MeshDrawRange>							m_drawRanges;
+
 		//Wolves
-		std::vector<VertexPositionUVNormal>					m_wolfVerticies;
-		std::vector<unsigned int>							m_wolfIndicies;
-		std::vector<VertexPositionUVNormal>					m_wolfVertexPositionUVNormal;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_wolfVertBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_wolfIndexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11VertexShader>			m_wolfVertexShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>			m_wolfPixelShader;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_wolfConstantBuffer;
-		Microsoft::WRL::ComPtr<ID3D11InputLayout>			m_wolfInputLayout;
-		Microsoft::WRL::ComPtr<ID3D11SamplerState>			m_wolfSampleState;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	m_wolfResourceView;
+		DrawableMesh										m_wolfMesh;
 		ModelViewProjectionConstantBuffer					m_wolfConstantBufferData;
 
+		//Scan: too large to keep on the GPU whole, so it is streamed from a chunk file and only the
+		//chunks the pager keeps resident have buffers, each as a one-submesh DrawableMesh. The file
+		//is opened by m_scanImport off the render thread, which touches nothing else; the render
+		//thread takes it over once the task is done.
+		concurrency::task<std::shared_ptr<MeshChunkFile>>	m_scanImport;
+		bool												m_scanImporting;	// m_scanImport has a file to hand over
+		std::shared_ptr<MeshChunkFile>						m_scanFile;
+		MeshChunkPager										m_scanPager;
+		std::vector<DrawableMesh>							m_scanChunks;
+		std::vector<uint8>									m_scanStaging;
+		std::vector<uint32>									m_scanLoads;
+		std::vector<uint32>									m_scanEvictions;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_scanConstantBuffer;
+		bool												m_scanReady;	// set once the chunk file is taken over
+
+		//Textures: every DDS the scene draws is loaded through the streamer, small at first
+		DX::TextureStreamer									m_textureStreamer;
+		std::vector<DX::TextureSwap>						m_textureSwaps;
+		bool												m_textureStreamingReported;
+
+		//Texture pack: textures cooked into shared atlas and array pages by TexturePack, each page
+		//loaded through the streamer once, when the first mesh drawn from it is created
+		DX::TexturePackTable								m_texturePack;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	m_texturePackViews;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>			m_textureArrayPixelShader;
+
+		//Residency: every buffer, texture and render target the scene creates, counted against
+		//residencyBudget. Streamed textures are registered first, so their asset is their streamer handle.
+		DX::ResidencyManager								m_residency;
+		std::vector<DX::ResidencyChange>					m_residencyChanges;
+		std::vector<ResidentMesh>							m_residentMeshes;
+		std::unordered_map<ID3D11ShaderResourceView*, uint32>	m_textureAssets;
+		uint32												m_streamedTextureCount;
+		std::vector<uint32>									m_scanChunkAssets;	// vertex and index buffer of each resident chunk
+		bool												m_residencyReady;
+
+		//glTF model: one DrawableMesh per primitive, each placed by its node's transform
+		std::vector<DrawableMesh>							m_modelMeshes;
+		std::vector<DirectX::XMFLOAT4X4>					m_modelTransforms;
+
 		//Skybox
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_skyBoxResourceView;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>		 m_skyBoxInput;
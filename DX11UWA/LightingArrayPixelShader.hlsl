@@ -0,0 +1,3 @@
+// LightingPixelShader for meshes drawn from a texture pack's array page.
+#define LIGHTING_TEXTURE_ARRAY
+#include "LightingPixelShader.hlsl"
@@ -1,7 +1,13 @@
 float4 main() : SV_TARGET
 {
 	return float4(1.0f, 1.0f, 1.0f, 1.0f);
-}texture2D base : register(t0);
+}
+// LightingArrayPixelShader defines LIGHTING_TEXTURE_ARRAY to sample slice uv.z of a texture array.
+#if defined(LIGHTING_TEXTURE_ARRAY)
+Texture2DArray base : register(t0);
+#else
+texture2D base : register(t0);
+#endif
 SamplerState samp : register(s0);
 
 
@@ -5,11 +5,22 @@ cbuffer ModelViewProjectionConstantBuffer : register(b0)
 	matrix projection;
 };
 
+// Maps packed vertex attributes back to mesh space (see MeshDecodeConstants in MeshPacking.h).
+// Float meshes bind the identity: scale 1, offset 0 and positionScale.w 0.
+cbuffer MeshDecodeConstantBuffer : register(b1)
+{
+	float4 positionScale;	// w is 1 when normals are octahedral-encoded
+	float4 positionOffset;	// w is the slice of a texture array page, passed on in uv.z
+	float4 uvScaleOffset;	// xy scale, zw offset
+};
+
+// Float meshes fill xyz (w defaults to 1). Packed meshes store UNORM/half positions,
+// UNORM uvs and SNORM octahedral normals in xy.
 struct VertexShaderInput
 {
-	float3 pos : POSITION;
+	float4 pos : POSITION;
 	float3 uv : UV;
-	float3 normal : NORMAL;
+	float4 normal : NORMAL;
 
 	//this will break visual studios
 	//float3 worldPos : W_POS;
@@ -24,10 +35,19 @@ struct PixelShaderInput
 	float3 lightVal : COLOR;
 };
 
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
 PixelShaderInput main(VertexShaderInput input)
 {
 	PixelShaderInput output;
-	float4 pos = float4(input.pos, 1.0f);
+	float4 pos = float4(input.pos.xyz * positionScale.xyz + positionOffset.xyz, 1.0f);
+	float3 normal = positionScale.w > 0.0f ? DecodeOctahedral(input.normal.xy) : input.normal.xyz;
 
 	pos = mul(pos, model);
 	output.worldPos = pos;
@@ -35,9 +55,9 @@ PixelShaderInput main(VertexShaderInput input)
 	pos = mul(pos, projection);
 	output.pos = pos;
 
-	output.uv = input.uv;
+	output.uv = float3(input.uv.xy * uvScaleOffset.xy + uvScaleOffset.zw, positionOffset.w);
 
-	output.normal = mul(input.normal, (float3x3)model);
+	output.normal = mul(normal, (float3x3)model);
 
 	//output.normal = normalize(output.normal);
 
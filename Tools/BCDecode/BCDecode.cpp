@@ -0,0 +1,427 @@
+﻿// Decodes a block compressed DDS texture on the CPU, as the GPU samples it, and prints JSON with
+// the decode rate, the range of every channel and, given the texture it was cooked from, the PSNR,
+// so cooked textures can be checked without a GPU. It builds anywhere the decoder does, e.g.
+//
+//   g++ -std=c++14 -O2 -mavx2 -mf16c -IDX11UWA -o BCDecode Tools/BCDecode/BCDecode.cpp
+//       DX11UWA/Common/{BCDecoder,DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line; without -mavx2 -mf16c the SSE2 paths are used
+// on x64.
+//
+// Usage: BCDecode [--output decoded.dds] [--reference source.dds] texture.dds
+//        BCDecode --benchmark [megapixels]
+// Every mip and array slice of any BC1 to BC7 format is decoded; the texture may be gzip or zstd
+// compressed. --output writes the texels as RGBA8, sRGB when the format is, or as 32 bit floats
+// for BC6H. --reference takes the 8 bit RGBA or BGRA texture a UNORM one was encoded from, of the
+// same size, and compares the channels the format stores. --benchmark decodes the given megapixels,
+// 16 by default, of random blocks of each format, and so of every mode, to RGBA8 and to float. The
+// exit code is 1 when a texture cannot be read or decoded or the output written, and 2 for bad
+// arguments.
+
+#include "Common/BCDecoder.h"
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	struct FormatName
+	{
+		DXGI_FORMAT	format;
+		const char*	name;
+	};
+
+	// The formats the benchmark decodes, one of each block layout and sign.
+	const FormatName kBenchmarkFormats[] =
+	{
+		{ DXGI_FORMAT_BC1_UNORM, "BC1_UNORM" },
+		{ DXGI_FORMAT_BC2_UNORM, "BC2_UNORM" },
+		{ DXGI_FORMAT_BC3_UNORM, "BC3_UNORM" },
+		{ DXGI_FORMAT_BC4_UNORM, "BC4_UNORM" },
+		{ DXGI_FORMAT_BC4_SNORM, "BC4_SNORM" },
+		{ DXGI_FORMAT_BC5_UNORM, "BC5_UNORM" },
+		{ DXGI_FORMAT_BC5_SNORM, "BC5_SNORM" },
+		{ DXGI_FORMAT_BC6H_UF16, "BC6H_UF16" },
+		{ DXGI_FORMAT_BC6H_SF16, "BC6H_SF16" },
+		{ DXGI_FORMAT_BC7_UNORM, "BC7_UNORM" }
+	};
+
+	const uint32_t kBenchmarkWidth = 1024;
+	const uint32_t kBenchmarkHeight = 1024;
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	bool IsBC6H(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC6H_TYPELESS || format == DXGI_FORMAT_BC6H_UF16 || format == DXGI_FORMAT_BC6H_SF16;
+	}
+
+	// How many colour channels a format stores, and whether it stores alpha.
+	uint32_t GetStoredChannels(DXGI_FORMAT format, bool& outAlpha)
+	{
+		outAlpha = false;
+		switch (format)
+		{
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 1;
+
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+			return 2;
+
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+			return 3;
+
+		default:
+			outAlpha = true;
+			return 3;
+		}
+	}
+
+	bool IsSigned(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM || format == DXGI_FORMAT_BC6H_SF16;
+	}
+
+	bool IsSRGB(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC1_UNORM_SRGB || format == DXGI_FORMAT_BC2_UNORM_SRGB || format == DXGI_FORMAT_BC3_UNORM_SRGB ||
+			format == DXGI_FORMAT_BC7_UNORM_SRGB;
+	}
+
+	// How a reference format's texels map to RGBA8: whether red and blue are swapped and whether
+	// alpha is ignored.
+	bool GetSourceLayout(DXGI_FORMAT format, bool& outSwapRB, bool& outOpaque)
+	{
+		outSwapRB = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		outOpaque = format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		return outSwapRB || format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	}
+
+	// The whole file, decompressed when it is gzip or zstd.
+	bool ReadTexture(const char* path, MappedFile& file, std::vector<uint8_t>& decompressed, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+
+		outData = file.GetData();
+		outSize = static_cast<size_t>(file.GetSize());
+		if (DetectCompression(outData, outSize) == COMPRESSION_NONE)
+			return true;
+
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(outData, outSize) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK || desc.dataSize > SIZE_MAX - desc.headerSize)
+			return false;
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return false;
+		outData = decompressed.data();
+		outSize = decompressed.size();
+		return true;
+	}
+
+	bool WriteTexture(const char* path, const uint8_t* header, uint32_t headerSize, const std::vector<uint8_t>& bits)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(bits.data(), 1, bits.size(), file) == bits.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	double GetPsnr(double squaredError, uint64_t samples)
+	{
+		return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+	}
+
+	double GetSeconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// xorshift64, so every run benchmarks the same blocks.
+	uint64_t NextRandom(uint64_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	int Benchmark(double megapixels)
+	{
+		const uint32_t blocksWide = kBenchmarkWidth / 4;
+		const uint32_t blocksHigh = kBenchmarkHeight / 4;
+		const uint32_t passes = std::max(1u, static_cast<uint32_t>(megapixels * 1e6 / (kBenchmarkWidth * kBenchmarkHeight) + 0.5));
+		const double texels = static_cast<double>(kBenchmarkWidth) * kBenchmarkHeight * passes;
+
+		std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * 16);
+		std::vector<uint8_t> rgba(static_cast<size_t>(kBenchmarkWidth) * kBenchmarkHeight * 4);
+		std::vector<float> floats(rgba.size());
+		uint64_t state = 0x9e3779b97f4a7c15ull;
+		for (size_t i = 0; i < blocks.size(); i += 8)
+		{
+			const uint64_t value = NextRandom(state);
+			memcpy(&blocks[i], &value, sizeof(value));
+		}
+
+		printf("{\n\t\"instructionSet\": \"%s\", \"width\": %u, \"height\": %u, \"passes\": %u,\n\t\"formats\": [\n", GetBCDecoderInstructionSet(),
+			kBenchmarkWidth, kBenchmarkHeight, passes);
+		const size_t formatCount = sizeof(kBenchmarkFormats) / sizeof(kBenchmarkFormats[0]);
+		for (size_t f = 0; f < formatCount; ++f)
+		{
+			const DXGI_FORMAT format = kBenchmarkFormats[f].format;
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t pass = 0; pass < passes; ++pass)
+				DecodeBCImage(format, blocks.data(), kBenchmarkWidth, kBenchmarkHeight, rgba.data(), static_cast<size_t>(kBenchmarkWidth) * 4);
+			const double rgbaSeconds = GetSeconds(start);
+
+			start = std::chrono::steady_clock::now();
+			for (uint32_t pass = 0; pass < passes; ++pass)
+				DecodeBCImage(format, blocks.data(), kBenchmarkWidth, kBenchmarkHeight, floats.data(), static_cast<size_t>(kBenchmarkWidth) * 16);
+			const double floatSeconds = GetSeconds(start);
+
+			printf("\t\t{ \"format\": \"%s\", \"dxgiFormat\": %u, \"rgba8MegapixelsPerSecond\": %.2f, \"floatMegapixelsPerSecond\": %.2f }%s\n",
+				kBenchmarkFormats[f].name, static_cast<unsigned int>(format), rgbaSeconds > 0.0 ? texels / rgbaSeconds / 1e6 : 0.0,
+				floatSeconds > 0.0 ? texels / floatSeconds / 1e6 : 0.0, f + 1 < formatCount ? "," : "");
+		}
+		printf("\t]\n}\n");
+		return 0;
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: BCDecode [--output decoded.dds] [--reference source.dds] texture.dds\n");
+		fprintf(stderr, "       BCDecode --benchmark [megapixels]\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* outputPath = nullptr;
+	const char* referencePath = nullptr;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0 && i == 1 && argc <= 3)
+		{
+			const double megapixels = argc == 3 ? strtod(argv[2], nullptr) : 16.0;
+			return megapixels > 0.0 ? Benchmark(megapixels) : Usage();
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+		{
+			referencePath = argv[++i];
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 1)
+		return Usage();
+
+	MappedFile file;
+	std::vector<uint8_t> decompressed;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	DDSTextureDesc desc;
+	if (!ReadTexture(paths[0], file, decompressed, data, size) || ValidateDDS(data, size, desc) != DDS_OK)
+		return Fail(paths[0], "not a valid texture");
+	if (!IsBlockCompressed(desc.format))
+		return Fail(paths[0], "not a block compressed texture");
+
+	bool hasAlpha = false;
+	const uint32_t channels = GetStoredChannels(desc.format, hasAlpha);
+
+	MappedFile referenceFile;
+	std::vector<uint8_t> referenceDecompressed;
+	const uint8_t* referenceData = nullptr;
+	size_t referenceSize = 0;
+	DDSTextureDesc referenceDesc;
+	bool swapRB = false;
+	bool opaque = false;
+	if (referencePath)
+	{
+		if (!ReadTexture(referencePath, referenceFile, referenceDecompressed, referenceData, referenceSize) ||
+			ValidateDDS(referenceData, referenceSize, referenceDesc) != DDS_OK)
+			return Fail(referencePath, "not a valid texture");
+		if (!GetSourceLayout(referenceDesc.format, swapRB, opaque) || IsSigned(desc.format) || IsBC6H(desc.format))
+			return Fail(referencePath, "not an 8 bit RGBA reference for a UNORM texture");
+		if (referenceDesc.width != desc.width || referenceDesc.height != desc.height || referenceDesc.depth != desc.depth ||
+			referenceDesc.mipCount != desc.mipCount || referenceDesc.arraySize != desc.arraySize)
+			return Fail(referencePath, "not the size of the texture");
+	}
+
+	// BC6H is written as it decodes, floats, and everything else as RGBA8
+	DDSTextureDesc outDesc = desc;
+	const bool writeFloats = IsBC6H(desc.format);
+	outDesc.format = writeFloats ? DXGI_FORMAT_R32G32B32A32_FLOAT : IsSRGB(desc.format) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	outDesc.dataSize = ComputeDDSLayout(outDesc, nullptr);
+	std::vector<DDSSubresource> layout(static_cast<size_t>(desc.mipCount) * desc.arraySize);
+	std::vector<DDSSubresource> outLayout(layout.size());
+	std::vector<DDSSubresource> referenceLayout(referencePath ? layout.size() : 0);
+	ComputeDDSLayout(desc, layout.data());
+	ComputeDDSLayout(outDesc, outLayout.data());
+	if (referencePath)
+		ComputeDDSLayout(referenceDesc, referenceLayout.data());
+
+	std::vector<uint8_t> bits(outputPath ? static_cast<size_t>(outDesc.dataSize) : 0);
+	std::vector<uint8_t> rgba;
+	std::vector<float> floats;
+	float low[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	uint64_t nonFinite = 0;
+	double rgbaSeconds = 0.0;
+	double floatSeconds = 0.0;
+	double colorError = 0.0;
+	double alphaError = 0.0;
+	uint64_t texelCount = 0;
+	for (size_t s = 0; s < layout.size(); ++s)
+	{
+		const DDSSubresource& in = layout[s];
+		const size_t texels = static_cast<size_t>(in.width) * in.height;
+		rgba.resize(texels * 4);
+		floats.resize(texels * 4);
+		for (uint32_t z = 0; z < in.depth; ++z)
+		{
+			const uint8_t* blocks = data + desc.headerSize + in.offset + static_cast<uint64_t>(z) * in.sliceBytes;
+			auto start = std::chrono::steady_clock::now();
+			DecodeBCImage(desc.format, blocks, in.width, in.height, rgba.data(), static_cast<size_t>(in.width) * 4);
+			rgbaSeconds += GetSeconds(start);
+
+			start = std::chrono::steady_clock::now();
+			DecodeBCImage(desc.format, blocks, in.width, in.height, floats.data(), static_cast<size_t>(in.width) * 16);
+			floatSeconds += GetSeconds(start);
+
+			for (size_t i = 0; i < floats.size(); ++i)
+			{
+				if (!std::isfinite(floats[i]))
+				{
+					++nonFinite;
+					continue;
+				}
+				low[i % 4] = std::min(low[i % 4], floats[i]);
+				high[i % 4] = std::max(high[i % 4], floats[i]);
+			}
+
+			if (outputPath)
+			{
+				const DDSSubresource& out = outLayout[s];
+				const uint8_t* texelBytes = writeFloats ? reinterpret_cast<const uint8_t*>(floats.data()) : rgba.data();
+				memcpy(&bits[static_cast<size_t>(out.offset + static_cast<uint64_t>(z) * out.sliceBytes)], texelBytes, static_cast<size_t>(out.sliceBytes));
+			}
+
+			if (referencePath)
+			{
+				const DDSSubresource& reference = referenceLayout[s];
+				for (uint32_t y = 0; y < in.height; ++y)
+				{
+					const uint8_t* row = referenceData + referenceDesc.headerSize + reference.offset + static_cast<uint64_t>(z) * reference.sliceBytes +
+						static_cast<size_t>(y) * reference.rowBytes;
+					const uint8_t* decoded = &rgba[static_cast<size_t>(y) * in.width * 4];
+					for (uint32_t x = 0; x < in.width; ++x, row += 4, decoded += 4)
+					{
+						const uint8_t original[4] = { row[swapRB ? 2 : 0], row[1], row[swapRB ? 0 : 2], opaque ? static_cast<uint8_t>(255) : row[3] };
+						for (uint32_t c = 0; c < channels; ++c)
+							colorError += (decoded[c] - original[c]) * (decoded[c] - original[c]);
+						if (hasAlpha)
+							alphaError += (decoded[3] - original[3]) * (decoded[3] - original[3]);
+					}
+				}
+			}
+		}
+		texelCount += static_cast<uint64_t>(texels) * in.depth;
+	}
+
+	if (outputPath)
+	{
+		uint8_t header[DDS_MAX_HEADER_SIZE];
+		const uint32_t headerSize = WriteDDSHeader(outDesc, header);
+		if (!WriteTexture(outputPath, header, headerSize, bits))
+			return Fail(outputPath, "could not write");
+	}
+
+	printf("{\n\t\"input\": %s,\n", JsonString(paths[0]).c_str());
+	printf("\t\"dxgiFormat\": %u, \"width\": %u, \"height\": %u, \"depth\": %u, \"mips\": %u, \"arraySize\": %u,\n",
+		static_cast<unsigned int>(desc.format), desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize);
+	printf("\t\"instructionSet\": \"%s\", \"texels\": %llu, \"rgba8MegapixelsPerSecond\": %.2f, \"floatMegapixelsPerSecond\": %.2f,\n",
+		GetBCDecoderInstructionSet(), static_cast<unsigned long long>(texelCount), rgbaSeconds > 0.0 ? texelCount / rgbaSeconds / 1e6 : 0.0,
+		floatSeconds > 0.0 ? texelCount / floatSeconds / 1e6 : 0.0);
+	printf("\t\"min\": [%g, %g, %g, %g], \"max\": [%g, %g, %g, %g], \"nonFinite\": %llu",
+		low[0], low[1], low[2], low[3], high[0], high[1], high[2], high[3], static_cast<unsigned long long>(nonFinite));
+	if (outputPath)
+		printf(",\n\t\"output\": %s, \"outputDxgiFormat\": %u", JsonString(outputPath).c_str(), static_cast<unsigned int>(outDesc.format));
+	if (referencePath)
+	{
+		// Lossless channels have no finite PSNR and are printed as null
+		char colorPsnr[32] = "null";
+		char alphaPsnr[32] = "null";
+		if (colorError > 0.0)
+			snprintf(colorPsnr, sizeof(colorPsnr), "%.3f", GetPsnr(colorError, texelCount * channels));
+		if (alphaError > 0.0)
+			snprintf(alphaPsnr, sizeof(alphaPsnr), "%.3f", GetPsnr(alphaError, texelCount));
+		printf(",\n\t\"reference\": %s, \"psnr\": { \"color\": %s, \"alpha\": %s }", JsonString(referencePath).c_str(), colorPsnr,
+			hasAlpha ? alphaPsnr : "null");
+	}
+	printf("\n}\n");
+	return 0;
+}
@@ -0,0 +1,270 @@
+﻿// Block compresses an RGBA8 DDS texture into a DDS file DDSTextureLoader reads, and prints JSON
+// with the encode rate and the PSNR of the result, so the cost and quality of each format can be
+// weighed per texture. It builds anywhere the encoder does, e.g.
+//
+//   g++ -std=c++14 -O2 -mavx2 -pthread -IDX11UWA -o BCEncode Tools/BCEncode/BCEncode.cpp
+//       DX11UWA/Common/{BCEncoder,BCDecoder,DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line; without -mavx2 the SSE2 search is used on x64.
+//
+// Usage: BCEncode [--format bc1|bc3|bc7] [--threads count] input.dds output.dds
+// The default format is bc7, and threads one a core. Every mip and array slice is encoded; the
+// input may be gzip or zstd compressed and in any 8 bit RGBA or BGRA format, and sRGB stays sRGB.
+// Megapixels a second count the texels of every subresource over the time spent encoding them,
+// and PSNR compares the decoded blocks with the input over RGB and over alpha. Blocks whose input
+// is fully opaque have to decode to alpha 255 exactly, and opaqueBlocksFailed counts those that do
+// not. The exit code is 1 when the input cannot be read or encoded or the output written or an
+// opaque block is not, and 2 for bad arguments.
+
+#include "Common/BCDecoder.h"
+#include "Common/BCEncoder.h"
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kFormatNames[BC_FORMAT_COUNT] = { "bc1", "bc3", "bc7" };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	// How an input format's texels map to RGBA8: whether red and blue are swapped and whether
+	// alpha is ignored.
+	bool GetSourceLayout(DXGI_FORMAT format, bool& outSwapRB, bool& outOpaque, bool& outSRGB)
+	{
+		outSwapRB = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		outOpaque = format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		outSRGB = format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		return outSwapRB || format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	}
+
+	// The whole file, decompressed when it is gzip or zstd.
+	bool ReadTexture(const char* path, MappedFile& file, std::vector<uint8_t>& decompressed, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+
+		outData = file.GetData();
+		outSize = static_cast<size_t>(file.GetSize());
+		if (DetectCompression(outData, outSize) == COMPRESSION_NONE)
+			return true;
+
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(outData, outSize) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK || desc.dataSize > SIZE_MAX - desc.headerSize)
+			return false;
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return false;
+		outData = decompressed.data();
+		outSize = decompressed.size();
+		return true;
+	}
+
+	bool WriteTexture(const char* path, const uint8_t* header, uint32_t headerSize, const std::vector<uint8_t>& bits)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(bits.data(), 1, bits.size(), file) == bits.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	double GetPsnr(double squaredError, uint64_t samples)
+	{
+		return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: BCEncode [--format bc1|bc3|bc7] [--threads count] input.dds output.dds\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BCFormat format = BC_FORMAT_BC7;
+	unsigned int threadCount = 0;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			format = BC_FORMAT_COUNT;
+			for (int f = 0; f < BC_FORMAT_COUNT; ++f)
+				format = strcmp(name, kFormatNames[f]) == 0 ? static_cast<BCFormat>(f) : format;
+			if (format == BC_FORMAT_COUNT)
+				return Usage();
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			threadCount = static_cast<unsigned int>(value);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2)
+		return Usage();
+
+	MappedFile file;
+	std::vector<uint8_t> decompressed;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	DDSTextureDesc desc;
+	if (!ReadTexture(paths[0], file, decompressed, data, size) || ValidateDDS(data, size, desc) != DDS_OK)
+		return Fail(paths[0], "not a valid texture");
+
+	bool swapRB = false;
+	bool opaque = false;
+	bool srgb = false;
+	if (!GetSourceLayout(desc.format, swapRB, opaque, srgb) || desc.dimension != DDS_DIMENSION_TEXTURE2D)
+		return Fail(paths[0], "not an 8 bit RGBA 2D texture");
+
+	DDSTextureDesc outDesc = desc;
+	outDesc.format = GetBCDXGIFormat(format, srgb);
+	outDesc.dataSize = ComputeDDSLayout(outDesc, nullptr);
+	std::vector<DDSSubresource> layout(desc.mipCount * desc.arraySize);
+	std::vector<DDSSubresource> outLayout(layout.size());
+	ComputeDDSLayout(desc, layout.data());
+	ComputeDDSLayout(outDesc, outLayout.data());
+
+	std::vector<uint8_t> bits(static_cast<size_t>(outDesc.dataSize));
+	std::vector<uint8_t> texels;
+	double seconds = 0.0;
+	double colorError = 0.0;
+	double alphaError = 0.0;
+	uint64_t texelCount = 0;
+	uint64_t opaqueBlocksFailed = 0;
+	unsigned int threadsUsed = 0;
+	const size_t blockBytes = GetBCBlockBytes(format);
+	for (size_t s = 0; s < layout.size(); ++s)
+	{
+		const DDSSubresource& in = layout[s];
+		const DDSSubresource& out = outLayout[s];
+		const uint8_t* source = data + desc.headerSize + in.offset;
+		texels.resize(static_cast<size_t>(in.width) * in.height * 4);
+		for (uint32_t y = 0; y < in.height; ++y)
+		{
+			const uint8_t* row = source + static_cast<size_t>(y) * in.rowBytes;
+			uint8_t* texel = &texels[static_cast<size_t>(y) * in.width * 4];
+			for (uint32_t x = 0; x < in.width; ++x, row += 4, texel += 4)
+			{
+				texel[0] = row[swapRB ? 2 : 0];
+				texel[1] = row[1];
+				texel[2] = row[swapRB ? 0 : 2];
+				texel[3] = opaque ? 255 : row[3];
+			}
+		}
+
+		uint8_t* blocks = &bits[static_cast<size_t>(out.offset)];
+		const auto start = std::chrono::steady_clock::now();
+		threadsUsed = std::max(threadsUsed, EncodeBCImage(format, texels.data(), in.width, in.height, static_cast<size_t>(in.width) * 4, blocks, threadCount));
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Only the texels inside the image count, not the edge copies padding its last blocks
+		for (uint32_t by = 0; by < out.numRows; ++by)
+		{
+			for (uint32_t bx = 0; bx * blockBytes < out.rowBytes; ++bx)
+			{
+				uint8_t decoded[BC_BLOCK_TEXELS * 4];
+				DecodeBCBlock(outDesc.format, blocks + by * out.rowBytes + bx * blockBytes, decoded);
+				bool opaqueInput = true;
+				bool opaqueOutput = true;
+				for (uint32_t t = 0; t < BC_BLOCK_TEXELS; ++t)
+				{
+					const uint32_t x = bx * 4 + t % 4;
+					const uint32_t y = by * 4 + t / 4;
+					if (x >= in.width || y >= in.height)
+						continue;
+					const uint8_t* original = &texels[(static_cast<size_t>(y) * in.width + x) * 4];
+					for (int c = 0; c < 3; ++c)
+						colorError += (decoded[t * 4 + c] - original[c]) * (decoded[t * 4 + c] - original[c]);
+					alphaError += (decoded[t * 4 + 3] - original[3]) * (decoded[t * 4 + 3] - original[3]);
+					opaqueInput = opaqueInput && original[3] == 255;
+					opaqueOutput = opaqueOutput && decoded[t * 4 + 3] == 255;
+				}
+				if (opaqueInput && !opaqueOutput)
+					++opaqueBlocksFailed;
+			}
+		}
+		texelCount += static_cast<uint64_t>(in.width) * in.height;
+	}
+
+	uint8_t header[DDS_MAX_HEADER_SIZE];
+	const uint32_t headerSize = WriteDDSHeader(outDesc, header);
+	if (!WriteTexture(paths[1], header, headerSize, bits))
+		return Fail(paths[1], "could not write");
+
+	// Lossless channels have no finite PSNR and are printed as null
+	char colorPsnr[32] = "null";
+	char alphaPsnr[32] = "null";
+	if (colorError > 0.0)
+		snprintf(colorPsnr, sizeof(colorPsnr), "%.3f", GetPsnr(colorError, texelCount * 3));
+	if (alphaError > 0.0)
+		snprintf(alphaPsnr, sizeof(alphaPsnr), "%.3f", GetPsnr(alphaError, texelCount));
+
+	printf("{\n\t\"input\": %s, \"output\": %s,\n", JsonString(paths[0]).c_str(), JsonString(paths[1]).c_str());
+	printf("\t\"format\": \"%s\", \"dxgiFormat\": %u, \"width\": %u, \"height\": %u, \"mips\": %u, \"arraySize\": %u,\n",
+		kFormatNames[format], static_cast<unsigned int>(outDesc.format), desc.width, desc.height, desc.mipCount, desc.arraySize);
+	printf("\t\"inputBytes\": %llu, \"outputBytes\": %llu, \"ratio\": %.2f,\n", static_cast<unsigned long long>(desc.dataSize),
+		static_cast<unsigned long long>(outDesc.dataSize), static_cast<double>(desc.dataSize) / outDesc.dataSize);
+	printf("\t\"instructionSet\": \"%s\", \"threads\": %u, \"texels\": %llu, \"seconds\": %.6f, \"megapixelsPerSecond\": %.2f,\n",
+		GetBCEncoderInstructionSet(), threadsUsed, static_cast<unsigned long long>(texelCount), seconds, seconds > 0.0 ? texelCount / seconds / 1e6 : 0.0);
+	printf("\t\"psnr\": { \"rgb\": %s, \"alpha\": %s }, \"opaqueBlocksFailed\": %llu\n}\n", colorPsnr, alphaPsnr,
+		static_cast<unsigned long long>(opaqueBlocksFailed));
+	return opaqueBlocksFailed > 0 ? 1 : 0;
+}
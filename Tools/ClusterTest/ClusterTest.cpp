@@ -0,0 +1,681 @@
+﻿// Regression check and benchmark for mesh clusters: builds LODs and clusters for generated
+// spheres, tori, terrain, a triangle soup and a mesh in two parts the way the importer does, and
+// checks that every cluster keeps to the vertex and triangle limits, tiles its level and submesh,
+// sits inside its bounding sphere and survives a round trip through the .mesh cache. It then culls
+// the clusters from random views and checks that none with a triangle facing the eye inside the
+// frustum was dropped, and reports how much each mesh's views cull and how long culling takes.
+// It needs no GPU and builds anywhere the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o ClusterTest Tools/ClusterTest/ClusterTest.cpp
+//       DX11UWA/Content/{MeshCache,MeshPacking,MeshOptimizer,ObjLoader,IndexCodec,MeshSimplifier,MeshClusters}.cpp
+//       DX11UWA/Common/{MappedFile,LinearArena,FileIO,CompressedFile}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: ClusterTest [--views count] [--runs count] [--cache path]
+// Each mesh is culled from --views views, 256 by default, and the benchmark keeps the best of
+// --runs passes over them, 10 by default. The round trip writes and removes --cache,
+// ClusterTest.mesh in the working directory by default. Prints JSON with every check and each
+// mesh's cull rates. The exit code is 1 when any check fails, and 2 for bad arguments.
+
+#include "Content/MeshCache.h"
+#include "Content/MeshClusters.h"
+#include "Content/MeshOptimizer.h"
+#include "Content/MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const float kPi = 3.14159265f;
+
+	struct TestMesh
+	{
+		std::string				name;
+		std::vector<MeshVertex>	vertices;
+		std::vector<uint32_t>	indices;
+		std::vector<uint32_t>	parts;		// index offsets of the submeshes, in order
+	};
+
+	// A mesh after import: its levels, their submesh ranges and the clusters of both.
+	struct ClusteredMesh
+	{
+		std::vector<MeshVertex>		vertices;
+		std::vector<uint32_t>		indices;
+		MeshLod						lods[MESH_MAX_LODS];
+		uint32_t					lodCount;
+		std::vector<MeshSubmesh>	submeshes;
+		std::vector<MeshLod>		submeshLods;
+		std::vector<MeshCluster>	clusters;
+		MeshClusterStats			stats;
+		bool						trianglesKept;	// clustering only reordered each level's triangles
+	};
+
+	typedef std::array<uint32_t, 3> TriangleKey;
+
+	bool g_firstCheck = true;
+	unsigned int g_failures = 0;
+
+	void Check(const std::string& mesh, const char* name, bool passed, const std::string& detail)
+	{
+		printf("%s\t\t{ \"mesh\": \"%s\", \"check\": \"%s\", \"passed\": %s%s%s }", g_firstCheck ? "" : ",\n", mesh.c_str(), name, passed ? "true" : "false",
+			detail.empty() ? "" : ", ", detail.c_str());
+		g_firstCheck = false;
+		g_failures += passed ? 0 : 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: ClusterTest [--views count] [--runs count] [--cache path]\n");
+		return 2;
+	}
+
+	MeshFloat3 Subtract(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		MeshFloat3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return r;
+	}
+
+	MeshFloat3 Cross(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		MeshFloat3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return r;
+	}
+
+	float Dot(const MeshFloat3& a, const MeshFloat3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	MeshFloat3 Normalize(const MeshFloat3& v)
+	{
+		const float length = sqrtf(Dot(v, v));
+		MeshFloat3 r = { v.x / length, v.y / length, v.z / length };
+		return r;
+	}
+
+	MeshVertex MakeVertex(float x, float y, float z, float nx, float ny, float nz)
+	{
+		MeshVertex vertex = { { x, y, z }, { 0.0f, 0.0f, 0.0f }, { nx, ny, nz } };
+		return vertex;
+	}
+
+	// A closed UV sphere, whose seam and poles repeat positions under other uvs.
+	TestMesh MakeSphere(const char* name, uint32_t rings, uint32_t segments, float radius)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = kPi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * kPi * segment / segments;
+				const float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+				mesh.vertices.push_back(MakeVertex(radius * x, radius * y, radius * z, x, y, z));
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				uint32_t a = ring * (segments + 1) + segment;
+				uint32_t b = a + 1;
+				uint32_t c = a + segments + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, b, c, b, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// A torus, which faces every direction from every side.
+	TestMesh MakeTorus(const char* name, uint32_t rings, uint32_t segments)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = 2.0f * kPi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * kPi * segment / segments;
+				const float nx = cosf(phi) * cosf(theta), ny = sinf(phi), nz = cosf(phi) * sinf(theta);
+				mesh.vertices.push_back(MakeVertex(cosf(theta) + 0.4f * nx, 0.4f * ny, sinf(theta) + 0.4f * nz, nx, ny, nz));
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				uint32_t a = ring * (segments + 1) + segment;
+				uint32_t b = a + 1;
+				uint32_t c = a + segments + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, b, c, b, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// An open height field of rolling hills, which faces up and can be seen from below.
+	TestMesh MakeTerrain(const char* name, uint32_t size, std::mt19937& random)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		float phases[4];
+		for (float& phase : phases)
+			phase = (random() % 1000) / 1000.0f * 2.0f * kPi;
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+			{
+				const float u = float(x) / size, v = float(y) / size;
+				const float height = 0.08f * sinf(6.0f * u + phases[0]) * cosf(5.0f * v + phases[1]) + 0.02f * sinf(23.0f * u + phases[2]) * sinf(19.0f * v + phases[3]);
+				mesh.vertices.push_back(MakeVertex(u - 0.5f, height, v - 0.5f, 0.0f, 1.0f, 0.0f));
+			}
+		}
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint32_t a = y * (size + 1) + x;
+				uint32_t b = a + 1;
+				uint32_t c = a + size + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, c, b, b, c, d };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// Triangles between random vertices in a cube, which share no surface to grow clusters along.
+	TestMesh MakeSoup(const char* name, uint32_t vertexCount, uint32_t triangleCount, std::mt19937& random)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const float x = (random() % 10000) / 10000.0f, y = (random() % 10000) / 10000.0f, z = (random() % 10000) / 10000.0f;
+			mesh.vertices.push_back(MakeVertex(x, y, z, 0.0f, 0.0f, 1.0f));
+		}
+		while (mesh.indices.size() < triangleCount * 3)
+		{
+			const uint32_t a = random() % vertexCount, b = random() % vertexCount, c = random() % vertexCount;
+			if (a != b && b != c && a != c)
+			{
+				const uint32_t triangle[] = { a, b, c };
+				mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+			}
+		}
+		return mesh;
+	}
+
+	// Every triangle by its vertex indices, rotated to start at the smallest so that
+	// winding still counts, and sorted so that order does not.
+	std::vector<TriangleKey> GetTriangles(const uint32_t* indices, size_t indexCount)
+	{
+		std::vector<TriangleKey> triangles;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			TriangleKey key = { { indices[i], indices[i + 1], indices[i + 2] } };
+			std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+			triangles.push_back(key);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Runs the importer's stages on a generated mesh: optimize, LODs per submesh, clusters and
+	// the vertex renumbering that follows them.
+	ClusteredMesh Import(const TestMesh& mesh)
+	{
+		ClusteredMesh out;
+		out.vertices = mesh.vertices;
+		out.indices = mesh.indices;
+		std::vector<uint32_t> partOffsets = mesh.parts.empty() ? std::vector<uint32_t>(1, 0) : mesh.parts;
+		OptimizeMesh(out.vertices, out.indices, nullptr, &partOffsets);
+
+		out.submeshes.resize(partOffsets.size());
+		out.submeshLods.resize(partOffsets.size());
+		for (size_t s = 0; s < partOffsets.size(); ++s)
+		{
+			memset(&out.submeshes[s], 0, sizeof(MeshSubmesh));
+			snprintf(out.submeshes[s].name, MESH_NAME_LENGTH, "part%zu", s);
+			out.submeshes[s].materialIndex = MESH_NO_MATERIAL;
+			out.submeshLods[s].indexOffset = partOffsets[s];
+			out.submeshLods[s].indexCount = (s + 1 < partOffsets.size() ? partOffsets[s + 1] : static_cast<uint32_t>(out.indices.size())) - partOffsets[s];
+		}
+		out.lodCount = BuildMeshLods(out.indices, out.vertices, out.lods, MESH_MAX_LODS, nullptr, &out.submeshLods);
+		const std::vector<uint32_t> unclustered = out.indices;
+		BuildMeshClusters(out.indices, out.vertices, out.lods, out.lodCount, out.clusters, &out.stats, out.submeshLods.data(),
+			static_cast<uint32_t>(out.submeshes.size()));
+		out.trianglesKept = out.indices.size() == unclustered.size();
+		for (uint32_t lod = 0; out.trianglesKept && lod < out.lodCount; ++lod)
+		{
+			const MeshLod& range = out.lods[lod];
+			out.trianglesKept = GetTriangles(out.indices.data() + range.indexOffset, range.indexCount) == GetTriangles(unclustered.data() + range.indexOffset, range.indexCount);
+		}
+		out.vertices.resize(OptimizeVertexFetch(out.vertices.data(), out.indices.data(), out.indices.size(), out.vertices.size()));
+		for (size_t s = 0; s < out.submeshes.size(); ++s)
+			out.submeshes[s].bounds = ComputeMeshBounds(out.vertices.data(), out.indices.data() + out.submeshLods[s].indexOffset, out.submeshLods[s].indexCount);
+		return out;
+	}
+
+	// Whether the range's clusters cover its indices one after another and no further.
+	bool ClustersTile(const ClusteredMesh& mesh, const MeshLod& range)
+	{
+		uint32_t next = range.indexOffset;
+		for (uint32_t c = range.clusterOffset; c < range.clusterOffset + range.clusterCount; ++c)
+		{
+			if (c >= mesh.clusters.size() || mesh.clusters[c].indexOffset != next)
+				return false;
+			next += mesh.clusters[c].triangleCount * 3;
+		}
+		return next == range.indexOffset + range.indexCount;
+	}
+
+	void CheckClusters(const TestMesh& source, const ClusteredMesh& mesh)
+	{
+		uint32_t maxTriangles = 0;
+		uint32_t maxVertices = 0;
+		bool limits = !mesh.clusters.empty();
+		float worstOutside = 0.0f;
+		std::vector<uint32_t> seen(mesh.vertices.size(), ~0u);
+		for (uint32_t c = 0; c < mesh.clusters.size(); ++c)
+		{
+			const MeshCluster& cluster = mesh.clusters[c];
+			uint32_t distinct = 0;
+			for (uint32_t i = cluster.indexOffset; i < cluster.indexOffset + cluster.triangleCount * 3; ++i)
+			{
+				const uint32_t index = mesh.indices[i];
+				if (seen[index] != c)
+				{
+					seen[index] = c;
+					++distinct;
+				}
+				// How far outside the sphere, relative to its size, so large and small meshes compare.
+				const MeshFloat3 offset = Subtract(mesh.vertices[index].pos, cluster.center);
+				const float outside = (sqrtf(Dot(offset, offset)) - cluster.radius) / std::max(cluster.radius, 1e-6f);
+				worstOutside = std::max(worstOutside, outside);
+			}
+			limits = limits && cluster.triangleCount >= 1 && cluster.triangleCount <= MESH_CLUSTER_MAX_TRIANGLES &&
+				cluster.vertexCount <= MESH_CLUSTER_MAX_VERTICES && cluster.vertexCount == distinct;
+			maxTriangles = std::max(maxTriangles, cluster.triangleCount);
+			maxVertices = std::max(maxVertices, cluster.vertexCount);
+		}
+		char detail[256];
+		snprintf(detail, sizeof(detail), "\"clusters\": %zu, \"lods\": %u, \"maxTriangles\": %u, \"maxVertices\": %u, \"averageTriangles\": %.1f, \"averageVertices\": %.1f",
+			mesh.clusters.size(), mesh.lodCount, maxTriangles, maxVertices, mesh.stats.averageTriangles, mesh.stats.averageVertices);
+		Check(source.name, "clusters keep to the vertex and triangle limits", limits, detail);
+
+		snprintf(detail, sizeof(detail), "\"worstOutside\": %g", worstOutside);
+		Check(source.name, "every cluster is inside its bounding sphere", worstOutside <= 1e-5f, detail);
+
+		// Clusters tile every level and every submesh range of it, and only reorder triangles.
+		bool tiled = true;
+		for (uint32_t lod = 0; lod < mesh.lodCount; ++lod)
+		{
+			const MeshLod& range = mesh.lods[lod];
+			tiled = tiled && ClustersTile(mesh, range);
+			for (size_t s = 0; s < mesh.submeshes.size(); ++s)
+				tiled = tiled && ClustersTile(mesh, mesh.submeshLods[lod * mesh.submeshes.size() + s]);
+		}
+		Check(source.name, "clusters tile every level and submesh", tiled, "");
+		Check(source.name, "clustering keeps every triangle of every level", mesh.trianglesKept, "");
+	}
+
+	uint32_t GetIndex(const void* indices, uint32_t indexSize, size_t i)
+	{
+		return indexSize == 2 ? static_cast<const uint16_t*>(indices)[i] : static_cast<const uint32_t*>(indices)[i];
+	}
+
+	// Whether every triangle is the same in both index arrays and in the same place, though
+	// encoded indices may come back rotated.
+	bool SameTriangles(const void* a, const void* b, uint32_t indexSize, size_t indexCount)
+	{
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			TriangleKey ka = { { GetIndex(a, indexSize, i), GetIndex(a, indexSize, i + 1), GetIndex(a, indexSize, i + 2) } };
+			TriangleKey kb = { { GetIndex(b, indexSize, i), GetIndex(b, indexSize, i + 1), GetIndex(b, indexSize, i + 2) } };
+			std::rotate(ka.begin(), std::min_element(ka.begin(), ka.end()), ka.end());
+			std::rotate(kb.begin(), std::min_element(kb.begin(), kb.end()), kb.end());
+			if (ka != kb)
+				return false;
+		}
+		return true;
+	}
+
+	// Writes the mesh to a cache, raw or with encoded indices, opens it again and compares
+	// everything the renderer culls and draws with.
+	void CheckCacheRoundTrip(const TestMesh& source, const ClusteredMesh& mesh, const char* cachePath, uint32_t indexEncoding)
+	{
+		const uint64_t sourceHash = HashMeshSource(source.indices.data(), source.indices.size() * sizeof(uint32_t));
+		const uint64_t sourceSize = source.indices.size() * sizeof(uint32_t);
+		MeshParts parts = { mesh.lods, mesh.lodCount, &mesh.clusters, &mesh.submeshes, &mesh.submeshLods, nullptr };
+		CachedMesh adopted;
+		adopted.Adopt(mesh.vertices, mesh.indices, MESH_VERTEX_FLOAT, &parts);
+		CachedMesh opened;
+		const bool written = WriteMeshCache(cachePath, adopted, sourceHash, sourceSize, MESH_VERTEX_FLOAT, indexEncoding);
+		const bool reopened = written && opened.OpenCache(cachePath, sourceHash, sourceSize, MESH_VERTEX_FLOAT);
+
+		bool same = reopened && opened.GetClusterCount() == mesh.clusters.size() && opened.GetLodCount() == mesh.lodCount &&
+			opened.GetSubmeshCount() == mesh.submeshes.size() && opened.GetIndexCount() == mesh.indices.size() &&
+			opened.GetVertexCount() == mesh.vertices.size() && opened.GetIndexSize() == adopted.GetIndexSize();
+		same = same && memcmp(opened.GetClusters(), mesh.clusters.data(), mesh.clusters.size() * sizeof(MeshCluster)) == 0;
+		for (uint32_t lod = 0; same && lod < mesh.lodCount; ++lod)
+		{
+			same = memcmp(&opened.GetLod(lod), &mesh.lods[lod], sizeof(MeshLod)) == 0;
+			for (uint32_t s = 0; same && s < mesh.submeshes.size(); ++s)
+				same = memcmp(&opened.GetSubmeshLod(lod, s), &mesh.submeshLods[lod * mesh.submeshes.size() + s], sizeof(MeshLod)) == 0;
+		}
+		same = same && memcmp(opened.GetVertexData(), adopted.GetVertexData(), mesh.vertices.size() * adopted.GetVertexStride()) == 0;
+		same = same && SameTriangles(opened.GetIndexData(), adopted.GetIndexData(), adopted.GetIndexSize(), mesh.indices.size());
+		opened.Reset();
+		remove(cachePath);
+
+		char detail[128];
+		snprintf(detail, sizeof(detail), "\"encoding\": \"%s\", \"written\": %s, \"opened\": %s", indexEncoding == MESH_INDEX_ENCODED ? "encoded" : "raw",
+			written ? "true" : "false", reopened ? "true" : "false");
+		Check(source.name, "clusters and levels round-trip through the cache", same, detail);
+	}
+
+	// Row-major world * view * projection for row vectors, as DirectXMath's LookAtLH and
+	// PerspectiveFovLH build them, with the world the identity.
+	void BuildViewProjection(const MeshFloat3& eye, const MeshFloat3& at, float fovY, float aspect, float nearZ, float farZ, float m[16])
+	{
+		const MeshFloat3 zAxis = Normalize(Subtract(at, eye));
+		const MeshFloat3 up = std::fabs(zAxis.y) > 0.99f ? MeshFloat3{ 1.0f, 0.0f, 0.0f } : MeshFloat3{ 0.0f, 1.0f, 0.0f };
+		const MeshFloat3 xAxis = Normalize(Cross(up, zAxis));
+		const MeshFloat3 yAxis = Cross(zAxis, xAxis);
+		const float view[16] =
+		{
+			xAxis.x, yAxis.x, zAxis.x, 0.0f,
+			xAxis.y, yAxis.y, zAxis.y, 0.0f,
+			xAxis.z, yAxis.z, zAxis.z, 0.0f,
+			-Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1.0f
+		};
+		const float h = 1.0f / tanf(fovY * 0.5f);
+		const float q = farZ / (farZ - nearZ);
+		const float projection[16] =
+		{
+			h / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, h, 0.0f, 0.0f,
+			0.0f, 0.0f, q, 1.0f,
+			0.0f, 0.0f, -q * nearZ, 0.0f
+		};
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				m[r * 4 + c] = 0.0f;
+				for (int k = 0; k < 4; ++k)
+					m[r * 4 + c] += view[r * 4 + k] * projection[k * 4 + c];
+			}
+		}
+	}
+
+	// Whether a point lands on screen in front of the near plane, clipping it as the GPU does
+	// rather than through the planes the culling extracts, and a little inside so that rounding
+	// on the border does not count.
+	bool PointOnScreen(const float m[16], const MeshFloat3& p)
+	{
+		float clip[4];
+		for (int c = 0; c < 4; ++c)
+			clip[c] = p.x * m[c] + p.y * m[4 + c] + p.z * m[8 + c] + m[12 + c];
+		const float w = clip[3] * 0.999f;
+		return clip[3] > 0.0f && std::fabs(clip[0]) <= w && std::fabs(clip[1]) <= w && clip[2] >= clip[3] * 0.001f && clip[2] <= w;
+	}
+
+	// A triangle the eye sees: facing it, with a corner, edge midpoint or centroid on screen.
+	bool TriangleVisible(const ClusteredMesh& mesh, const uint32_t* corners, const float m[16], const MeshFloat3& eye)
+	{
+		const MeshFloat3& a = mesh.vertices[corners[0]].pos;
+		const MeshFloat3& b = mesh.vertices[corners[1]].pos;
+		const MeshFloat3& c = mesh.vertices[corners[2]].pos;
+		const MeshFloat3 normal = Cross(Subtract(b, a), Subtract(c, a));
+		const MeshFloat3 toEye = Subtract(eye, a);
+		const float facing = Dot(normal, toEye);
+		if (facing <= 1e-4f * sqrtf(Dot(normal, normal) * Dot(toEye, toEye)))
+			return false;
+
+		const MeshFloat3 samples[] =
+		{
+			a, b, c,
+			{ (a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f },
+			{ (b.x + c.x) * 0.5f, (b.y + c.y) * 0.5f, (b.z + c.z) * 0.5f },
+			{ (c.x + a.x) * 0.5f, (c.y + a.y) * 0.5f, (c.z + a.z) * 0.5f },
+			{ (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f }
+		};
+		for (const MeshFloat3& sample : samples)
+		{
+			if (PointOnScreen(m, sample))
+				return true;
+		}
+		return false;
+	}
+
+	struct View
+	{
+		float		matrix[16];
+		MeshFloat3	eye;
+	};
+
+	// Eyes from just outside the mesh to a few times its size away, looking near its centre so
+	// that some clusters fall off screen, plus a few from inside its bounds.
+	std::vector<View> MakeViews(const ClusteredMesh& mesh, uint32_t count, std::mt19937& random)
+	{
+		const MeshBounds bounds = ComputeMeshBounds(mesh.vertices.data(), mesh.vertices.size());
+		const MeshFloat3 center = { (bounds.min.x + bounds.max.x) * 0.5f, (bounds.min.y + bounds.max.y) * 0.5f, (bounds.min.z + bounds.max.z) * 0.5f };
+		const MeshFloat3 extent = Subtract(bounds.max, bounds.min);
+		const float size = sqrtf(Dot(extent, extent));
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> distance(0.6f, 4.0f);
+
+		std::vector<View> views(count);
+		for (uint32_t v = 0; v < count; ++v)
+		{
+			MeshFloat3 direction;
+			do
+			{
+				direction.x = unit(random);
+				direction.y = unit(random);
+				direction.z = unit(random);
+			} while (Dot(direction, direction) < 0.01f || Dot(direction, direction) > 1.0f);
+			direction = Normalize(direction);
+
+			const float away = v % 8 == 0 ? 0.1f : distance(random);
+			View& view = views[v];
+			view.eye.x = center.x + direction.x * away * size;
+			view.eye.y = center.y + direction.y * away * size;
+			view.eye.z = center.z + direction.z * away * size;
+			const MeshFloat3 at = { center.x + unit(random) * 0.5f * size, center.y + unit(random) * 0.5f * size, center.z + unit(random) * 0.5f * size };
+			BuildViewProjection(view.eye, at, kPi / 3.0f, 16.0f / 9.0f, 0.01f * size, 10.0f * size, view.matrix);
+		}
+		return views;
+	}
+
+	// Culls every level from every view and checks the culling against each triangle's visibility.
+	void CheckCulling(const TestMesh& source, const ClusteredMesh& mesh, const std::vector<View>& views)
+	{
+		std::vector<MeshDrawRange> ranges(mesh.clusters.size() + 1);
+		std::vector<uint8_t> drawn;
+		uint64_t culled = 0;
+		uint64_t wronglyCulled = 0;
+		bool rangesMatch = true;
+		for (const View& view : views)
+		{
+			const MeshClusterView clusterView = ComputeMeshClusterView(view.matrix, view.eye);
+			for (uint32_t lod = 0; lod < mesh.lodCount; ++lod)
+			{
+				const MeshLod& level = mesh.lods[lod];
+				const MeshCluster* clusters = mesh.clusters.data() + level.clusterOffset;
+				MeshClusterCullStats stats = {};
+				const size_t rangeCount = CullMeshClusters(clusters, level.clusterCount, clusterView, ranges.data(), &stats);
+
+				// Ranges come out in cluster order, so one walk marks the clusters they draw.
+				drawn.assign(level.clusterCount, 0);
+				size_t range = 0;
+				uint32_t indicesDrawn = 0;
+				for (uint32_t c = 0; c < level.clusterCount; ++c)
+				{
+					while (range < rangeCount && ranges[range].indexOffset + ranges[range].indexCount <= clusters[c].indexOffset)
+						++range;
+					drawn[c] = range < rangeCount && ranges[range].indexOffset <= clusters[c].indexOffset;
+				}
+				for (size_t r = 0; r < rangeCount; ++r)
+					indicesDrawn += ranges[r].indexCount;
+
+				uint32_t trianglesMarked = 0;
+				for (uint32_t c = 0; c < level.clusterCount; ++c)
+				{
+					if (drawn[c])
+					{
+						trianglesMarked += clusters[c].triangleCount;
+						continue;
+					}
+					++culled;
+					for (uint32_t t = 0; t < clusters[c].triangleCount; ++t)
+					{
+						if (TriangleVisible(mesh, &mesh.indices[clusters[c].indexOffset + t * 3], view.matrix, view.eye))
+						{
+							++wronglyCulled;
+							break;
+						}
+					}
+				}
+				rangesMatch = rangesMatch && rangeCount <= (level.clusterCount + 1) / 2 && indicesDrawn == trianglesMarked * 3 &&
+					stats.trianglesDrawn == trianglesMarked && stats.clusterCount == level.clusterCount &&
+					stats.frustumCulled + stats.backfaceCulled == level.clusterCount - std::count(drawn.begin(), drawn.end(), 1);
+			}
+		}
+
+		char detail[128];
+		snprintf(detail, sizeof(detail), "\"views\": %zu, \"culled\": %llu, \"wronglyCulled\": %llu", views.size(),
+			static_cast<unsigned long long>(culled), static_cast<unsigned long long>(wronglyCulled));
+		Check(source.name, "no cluster with a visible triangle is culled", wronglyCulled == 0, detail);
+		Check(source.name, "draw ranges cover exactly the clusters kept", rangesMatch, "");
+	}
+
+	// Cull rates of the finest level, which is what a close view draws, and the best time of
+	// runs passes over every view.
+	void Benchmark(const TestMesh& source, const ClusteredMesh& mesh, const std::vector<View>& views, uint32_t runCount, bool first)
+	{
+		std::vector<MeshClusterView> clusterViews;
+		for (const View& view : views)
+			clusterViews.push_back(ComputeMeshClusterView(view.matrix, view.eye));
+		const MeshLod& level = mesh.lods[0];
+		const MeshCluster* clusters = mesh.clusters.data() + level.clusterOffset;
+		std::vector<MeshDrawRange> ranges((level.clusterCount + 1) / 2 + 1);
+
+		MeshClusterCullStats stats = {};
+		uint64_t rangeCount = 0;
+		double bestSeconds = -1.0;
+		for (uint32_t run = 0; run < runCount; ++run)
+		{
+			MeshClusterCullStats runStats = {};
+			uint64_t runRanges = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (const MeshClusterView& view : clusterViews)
+				runRanges += CullMeshClusters(clusters, level.clusterCount, view, ranges.data(), &runStats);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			bestSeconds = bestSeconds < 0.0 ? seconds : std::min(bestSeconds, seconds);
+			stats = runStats;
+			rangeCount = runRanges;
+		}
+
+		const double clusterCount = std::max(1.0, double(stats.clusterCount));
+		printf("%s\t\t{ \"mesh\": \"%s\", \"clusters\": %u, \"triangles\": %u, \"frustumCulled\": %.3f, \"backfaceCulled\": %.3f, \"trianglesDrawn\": %.3f, "
+			"\"rangesPerView\": %.1f, \"nanosecondsPerCluster\": %.2f }", first ? "" : ",\n", source.name.c_str(), level.clusterCount, level.indexCount / 3,
+			stats.frustumCulled / clusterCount, stats.backfaceCulled / clusterCount, stats.triangleCount ? double(stats.trianglesDrawn) / stats.triangleCount : 0.0,
+			double(rangeCount) / views.size(), bestSeconds * 1e9 / clusterCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t viewCount = 256;
+	uint32_t runCount = 10;
+	const char* cachePath = "ClusterTest.mesh";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			viewCount = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			runCount = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+		{
+			cachePath = argv[++i];
+		}
+		else
+		{
+			return Usage();
+		}
+	}
+
+	std::mt19937 random(12345);
+	std::vector<TestMesh> meshes;
+	meshes.push_back(MakeSphere("sphere 64x128", 64, 128, 1.0f));
+	meshes.push_back(MakeTorus("torus 96x48", 96, 48));
+	meshes.push_back(MakeTerrain("terrain 192x192", 192, random));
+	meshes.push_back(MakeSoup("random soup", 2000, 4000, random));
+
+	// A sphere and a torus beside it as two submeshes, whose clusters must not mix.
+	TestMesh parts = MakeSphere("two parts", 32, 64, 0.8f);
+	TestMesh second = MakeTorus("", 64, 32);
+	const uint32_t base = static_cast<uint32_t>(parts.vertices.size());
+	for (MeshVertex& vertex : second.vertices)
+	{
+		vertex.pos.x += 2.5f;
+		parts.vertices.push_back(vertex);
+	}
+	parts.parts.push_back(0);
+	parts.parts.push_back(static_cast<uint32_t>(parts.indices.size()));
+	for (uint32_t index : second.indices)
+		parts.indices.push_back(index + base);
+	meshes.push_back(parts);
+
+	std::vector<ClusteredMesh> imported;
+	std::vector<std::vector<View>> views;
+	printf("{\n\t\"checks\": [\n");
+	for (const TestMesh& mesh : meshes)
+	{
+		imported.push_back(Import(mesh));
+		const ClusteredMesh& clustered = imported.back();
+
+		CheckClusters(mesh, clustered);
+		CheckCacheRoundTrip(mesh, clustered, cachePath, MESH_INDEX_RAW);
+		CheckCacheRoundTrip(mesh, clustered, cachePath, MESH_INDEX_ENCODED);
+		views.push_back(MakeViews(clustered, viewCount, random));
+		CheckCulling(mesh, clustered, views.back());
+	}
+	printf("\n\t],\n\t\"benchmark\": [\n");
+	for (size_t m = 0; m < meshes.size(); ++m)
+		Benchmark(meshes[m], imported[m], views[m], runCount, m == 0);
+	printf("\n\t],\n\t\"failures\": %u\n}\n", g_failures);
+	return g_failures ? 1 : 0;
+}
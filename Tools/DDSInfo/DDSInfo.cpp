@@ -0,0 +1,327 @@
+﻿// Validates DDS textures through the same header parsing and layout as DDSTextureLoader and
+// prints JSON describing each one, so texture check-ins can be gated without a D3D device.
+// It builds anywhere the loader's portable half does, e.g.
+//
+//   g++ -std=c++14 -O2 -IDX11UWA -o DDSInfo Tools/DDSInfo/DDSInfo.cpp
+//       DX11UWA/Common/{DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: DDSInfo [--layout] file.dds...
+//        DDSInfo --benchmark count
+// --layout adds every subresource's offset and pitches. gzip and zstd compressed files are
+// decompressed to check that all of their bits are there. --benchmark generates count headers of
+// mixed kinds and sizes in memory and times parsing them and computing their layouts. The exit
+// code is 1 when any file is not a valid texture, and 2 for bad arguments.
+
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kResultNames[] = { "ok", "not a DDS file", "invalid data", "not supported", "truncated" };
+	const char* const kCompressionNames[] = { "none", "gzip", "zstd" };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	const char* DimensionName(DDSDimension dimension)
+	{
+		switch (dimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:	return "1d";
+		case DDS_DIMENSION_TEXTURE2D:	return "2d";
+		case DDS_DIMENSION_TEXTURE3D:	return "3d";
+		default:						return "unknown";
+		}
+	}
+
+	// Reads the headers of a compressed file and then skips over its bits, which checks that
+	// they are all there and, for formats that have one, the checksum.
+	DDSResult ValidateCompressed(CompressedFile& stream, DDSTextureDesc& desc)
+	{
+		uint8_t header[DDS_MAX_HEADER_SIZE];
+		DDSResult result = ReadDDSHeader(stream, header, desc);
+		if (result != DDS_OK)
+			return result;
+		return stream.Skip(desc.dataSize) ? DDS_OK : DDS_TRUNCATED;
+	}
+
+	// Prints one element of the "textures" array. Returns false when the file is not a valid texture.
+	bool DescribeFile(const char* path, bool printLayout)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			printf("\t\t{ \"path\": %s, \"error\": \"could not open\" }", JsonString(path).c_str());
+			return false;
+		}
+
+		DDSTextureDesc desc;
+		DDSResult result;
+		const size_t size = static_cast<size_t>(file.GetSize());
+		const CompressionFormat compression = DetectCompression(file.GetData(), size);
+		if (compression != COMPRESSION_NONE)
+		{
+			CompressedFile stream;
+			stream.Open(file.GetData(), size);
+			result = ValidateCompressed(stream, desc);
+			if (result != DDS_OK && stream.HasFailed())
+			{
+				printf("\t\t{ \"path\": %s, \"compression\": \"%s\", \"error\": \"corrupt\" }", JsonString(path).c_str(), kCompressionNames[compression]);
+				return false;
+			}
+		}
+		else
+		{
+			result = ValidateDDS(file.GetData(), file.GetSize(), desc);
+		}
+
+		printf("\t\t{ \"path\": %s, \"compression\": \"%s\", \"fileSize\": %llu", JsonString(path).c_str(), kCompressionNames[compression],
+			static_cast<unsigned long long>(file.GetSize()));
+		if (result != DDS_OK && desc.dimension == DDS_DIMENSION_UNKNOWN)
+		{
+			printf(", \"error\": \"%s\" }", kResultNames[result]);
+			return false;
+		}
+
+		printf(",\n\t\t  \"dimension\": \"%s\", \"format\": %u, \"width\": %u, \"height\": %u, \"depth\": %u, \"mips\": %u, \"arraySize\": %u, \"cube\": %s,\n",
+			DimensionName(desc.dimension), static_cast<unsigned int>(desc.format), desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize,
+			desc.isCubeMap ? "true" : "false");
+		printf("\t\t  \"headerSize\": %u, \"dataSize\": %llu", desc.headerSize, static_cast<unsigned long long>(desc.dataSize));
+		if (result != DDS_OK)
+		{
+			printf(", \"error\": \"%s\" }", kResultNames[result]);
+			return false;
+		}
+
+		if (printLayout)
+		{
+			std::vector<DDSSubresource> layout(desc.mipCount * desc.arraySize);
+			ComputeDDSLayout(desc, layout.data());
+			printf(",\n\t\t  \"subresources\": [\n");
+			for (size_t i = 0; i < layout.size(); ++i)
+			{
+				const DDSSubresource& sub = layout[i];
+				printf("\t\t\t{ \"mip\": %u, \"slice\": %u, \"offset\": %llu, \"width\": %u, \"height\": %u, \"depth\": %u, \"rowBytes\": %u, \"rows\": %u, \"sliceBytes\": %llu }%s\n",
+					static_cast<unsigned int>(i % desc.mipCount), static_cast<unsigned int>(i / desc.mipCount), static_cast<unsigned long long>(sub.offset),
+					sub.width, sub.height, sub.depth, sub.rowBytes, sub.numRows, static_cast<unsigned long long>(sub.sliceBytes),
+					i + 1 < layout.size() ? "," : "");
+			}
+			printf("\t\t  ]");
+		}
+		printf(" }");
+		return true;
+	}
+
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// Appends one header of a kind picked by the generator: legacy and DX10, block compressed and
+	// not, 1D, 2D and cube arrays and volumes, with and without full mip chains.
+	void AppendSyntheticHeader(uint32_t& random, std::vector<uint8_t>& corpus)
+	{
+		static const DXGI_FORMAT kFormats[] =
+		{
+			DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_SNORM,
+			DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R8G8_B8G8_UNORM,
+		};
+
+		uint32_t magic = DDS_MAGIC;
+		DDS_HEADER header;
+		memset(&header, 0, sizeof(header));
+		header.size = sizeof(DDS_HEADER);
+		header.flags = 0x00001007;	// DDS_HEADER_FLAGS_TEXTURE
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+
+		const uint32_t kind = NextRandom(random) % 6;
+		const uint32_t sizeLog2 = kind == 4 ? 2 + NextRandom(random) % 9 : 2 + NextRandom(random) % 13;
+		header.width = (1u << sizeLog2) + NextRandom(random) % 3;
+		header.height = kind == 3 ? 1 : (1u << (2 + NextRandom(random) % 12)) + NextRandom(random) % 3;
+		header.depth = kind == 4 ? 1u << (NextRandom(random) % 8) : 0;
+		uint32_t fullChain = 1;
+		while ((std::max(header.width, std::max(header.height, header.depth)) >> fullChain) > 0)
+			++fullChain;
+		header.mipMapCount = (NextRandom(random) & 1) ? std::min<uint32_t>(fullChain, 15) : 1 + NextRandom(random) % 4;
+
+		const size_t start = corpus.size();
+		if (kind == 0)
+		{
+			// Legacy header: DXT1 or 32-bit BGRA, optionally a cube map
+			if (NextRandom(random) & 1)
+			{
+				header.ddspf.flags = 0x00000004;	// DDPF_FOURCC
+				header.ddspf.fourCC = 0x31545844;	// "DXT1"
+			}
+			else
+			{
+				header.ddspf.flags = 0x00000041;	// DDPF_RGB | DDPF_ALPHAPIXELS
+				header.ddspf.RGBBitCount = 32;
+				header.ddspf.RBitMask = 0x00ff0000;
+				header.ddspf.GBitMask = 0x0000ff00;
+				header.ddspf.BBitMask = 0x000000ff;
+				header.ddspf.ABitMask = 0xff000000;
+			}
+			if (NextRandom(random) & 1)
+			{
+				header.height = header.width;
+				header.caps2 = 0x0000fe00;	// DDSCAPS2_CUBEMAP and all faces
+			}
+			corpus.resize(start + sizeof(magic) + sizeof(header));
+		}
+		else
+		{
+			header.ddspf.flags = 0x00000004;	// DDPF_FOURCC
+			header.ddspf.fourCC = 0x30315844;	// "DX10"
+			DDS_HEADER_DXT10 ext;
+			memset(&ext, 0, sizeof(ext));
+			ext.dxgiFormat = kFormats[NextRandom(random) % (sizeof(kFormats) / sizeof(kFormats[0]))];
+			ext.arraySize = 1 + NextRandom(random) % 8;
+			ext.resourceDimension = kind == 3 ? DDS_DIMENSION_TEXTURE1D : kind == 4 ? DDS_DIMENSION_TEXTURE3D : DDS_DIMENSION_TEXTURE2D;
+			if (kind == 4)
+			{
+				header.flags |= 0x00800000;	// DDSD_DEPTH
+				ext.arraySize = 1;
+			}
+			if (kind == 5)
+			{
+				header.height = header.width;
+				ext.miscFlag = 0x4;	// D3D11_RESOURCE_MISC_TEXTURECUBE
+			}
+			corpus.resize(start + DDS_MAX_HEADER_SIZE);
+			memcpy(&corpus[start + sizeof(magic) + sizeof(header)], &ext, sizeof(ext));
+		}
+		memcpy(&corpus[start], &magic, sizeof(magic));
+		memcpy(&corpus[start + sizeof(magic)], &header, sizeof(header));
+	}
+
+	// Only the headers are generated: the bits of large textures are never read by parsing or
+	// layout, so each file is taken to be as long as its layout asks for.
+	int RunBenchmark(uint32_t count)
+	{
+		std::vector<uint8_t> corpus;
+		std::vector<size_t> offsets;
+		corpus.reserve(static_cast<size_t>(count) * DDS_MAX_HEADER_SIZE);
+		offsets.reserve(count + 1);
+		uint32_t random = 0x9E3779B9;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			offsets.push_back(corpus.size());
+			AppendSyntheticHeader(random, corpus);
+		}
+		offsets.push_back(corpus.size());
+
+		std::vector<DDSSubresource> layout;
+		uint64_t validFiles = 0;
+		uint64_t subresourceCount = 0;
+		uint64_t describedBytes = 0;
+		uint64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			DDSTextureDesc desc;
+			if (ParseDDSHeader(&corpus[offsets[i]], offsets[i + 1] - offsets[i], desc) != DDS_OK)
+				continue;
+
+			const size_t subresources = static_cast<size_t>(desc.mipCount) * desc.arraySize;
+			if (layout.size() < subresources)
+				layout.resize(subresources);
+			describedBytes += ComputeDDSLayout(desc, layout.data());
+			checksum += layout[subresources - 1].offset;
+			subresourceCount += subresources;
+			++validFiles;
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printf("{\n\t\"benchmark\": { \"files\": %u, \"valid\": %llu, \"subresources\": %llu, \"describedBytes\": %llu, \"checksum\": %llu,\n",
+			count, static_cast<unsigned long long>(validFiles), static_cast<unsigned long long>(subresourceCount),
+			static_cast<unsigned long long>(describedBytes), static_cast<unsigned long long>(checksum));
+		printf("\t\t\"seconds\": %.6f, \"filesPerSecond\": %.0f, \"subresourcesPerSecond\": %.0f }\n}\n",
+			seconds, seconds > 0.0 ? count / seconds : 0.0, seconds > 0.0 ? subresourceCount / seconds : 0.0);
+		return 0;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: DDSInfo [--layout] file.dds...\n       DDSInfo --benchmark count\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool printLayout = false;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc && paths.empty() && argc == 3)
+		{
+			const long count = strtol(argv[i + 1], nullptr, 10);
+			if (count <= 0)
+				return Usage();
+			return RunBenchmark(static_cast<uint32_t>(count));
+		}
+		else if (strcmp(argv[i], "--layout") == 0)
+		{
+			printLayout = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty())
+		return Usage();
+
+	bool succeeded = true;
+	printf("{\n\t\"textures\": [\n");
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		succeeded = DescribeFile(paths[i], printLayout) && succeeded;
+		printf("%s\n", i + 1 < paths.size() ? "," : "");
+	}
+	printf("\t]\n}\n");
+	return succeeded ? 0 : 1;
+}
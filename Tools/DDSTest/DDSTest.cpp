@@ -0,0 +1,398 @@
+﻿// Checks ParseDDSHeader, ValidateDDS and ComputeDDSLayout against headers built by hand here:
+// legacy and DX10 headers for plain, block compressed, cube map, array, cube array, 1D and volume
+// textures, whose every subresource offset and pitch is compared with values worked out by hand
+// in the tables below, and files the loader has to turn away, cut short, contradicting themselves
+// or over the Direct3D 11 limits. It needs no GPU and builds anywhere the loader's portable half
+// does, e.g.
+//
+//   g++ -std=c++14 -O2 -IDX11UWA -o DDSTest Tools/DDSTest/DDSTest.cpp
+//       DX11UWA/Common/{DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: DDSTest
+// Prints JSON with every check. The exit code is 1 when any check fails, and 2 for bad arguments.
+
+#include "Common/DDSFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kResultNames[] = { "ok", "not a DDS file", "invalid data", "not supported", "truncated" };
+
+	const uint32_t kPixelFormatFourCC = 0x00000004;		// DDPF_FOURCC
+	const uint32_t kPixelFormatRGB = 0x00000040;		// DDPF_RGB
+	const uint32_t kHeaderFlagsTexture = 0x00001007;	// DDSD_CAPS, DDSD_HEIGHT, DDSD_WIDTH and DDSD_PIXELFORMAT
+	const uint32_t kHeaderFlagsMipMap = 0x00020000;		// DDSD_MIPMAPCOUNT
+	const uint32_t kHeaderFlagsVolume = 0x00800000;		// DDSD_DEPTH
+	const uint32_t kCubeMapAllFaces = 0x0000fe00;		// DDSCAPS2_CUBEMAP and all six faces
+	const uint32_t kCubeMapNegativeZ = 0x00008000;		// DDSCAPS2_CUBEMAP_NEGATIVEZ
+	const uint32_t kResourceMiscTextureCube = 0x4;		// D3D11_RESOURCE_MISC_TEXTURECUBE
+
+	const uint32_t kLegacyHeaderSize = 128;
+	const uint32_t kDX10HeaderSize = 148;
+
+	// One mip of the first array slice, as ComputeDDSLayout should report it.
+	struct ExpectedMip
+	{
+		uint64_t	offset;
+		uint32_t	width;
+		uint32_t	height;
+		uint32_t	depth;
+		uint32_t	rowBytes;
+		uint32_t	numRows;
+		uint64_t	sliceBytes;
+	};
+
+	struct LayoutCase
+	{
+		std::string					name;
+		std::vector<uint8_t>		header;
+		DDSDimension				dimension;
+		DXGI_FORMAT					format;
+		uint32_t					width;
+		uint32_t					height;
+		uint32_t					depth;
+		uint32_t					arraySize;
+		bool						isCubeMap;
+		uint32_t					headerSize;
+		std::vector<ExpectedMip>	mips;
+		uint64_t					sliceStride;	// bytes from one array slice to the next
+		uint64_t					dataSize;
+	};
+
+	struct RejectCase
+	{
+		std::string				name;
+		std::vector<uint8_t>	header;
+		size_t					size;	// bytes of header the parser is given
+		DDSResult				expected;
+	};
+
+	bool g_firstCheck = true;
+	unsigned int g_failures = 0;
+
+	void Check(const std::string& texture, const char* name, bool passed, const std::string& detail)
+	{
+		printf("%s\t\t{ \"texture\": \"%s\", \"check\": \"%s\", \"passed\": %s%s%s }", g_firstCheck ? "" : ",\n", texture.c_str(), name,
+			passed ? "true" : "false", detail.empty() ? "" : ", ", detail.c_str());
+		g_firstCheck = false;
+		g_failures += passed ? 0 : 1;
+	}
+
+	std::string ResultDetail(DDSResult result, DDSResult expected)
+	{
+		return std::string("\"result\": \"") + kResultNames[result] + "\", \"expected\": \"" + kResultNames[expected] + "\"";
+	}
+
+	uint32_t MakeFourCC(char ch0, char ch1, char ch2, char ch3)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(ch0)) | (static_cast<uint32_t>(static_cast<uint8_t>(ch1)) << 8) |
+			(static_cast<uint32_t>(static_cast<uint8_t>(ch2)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(ch3)) << 24);
+	}
+
+	DDS_PIXELFORMAT FourCCFormat(uint32_t fourCC)
+	{
+		DDS_PIXELFORMAT pixelFormat = {};
+		pixelFormat.size = sizeof(DDS_PIXELFORMAT);
+		pixelFormat.flags = kPixelFormatFourCC;
+		pixelFormat.fourCC = fourCC;
+		return pixelFormat;
+	}
+
+	DDS_PIXELFORMAT RGBFormat(uint32_t bitCount, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		DDS_PIXELFORMAT pixelFormat = {};
+		pixelFormat.size = sizeof(DDS_PIXELFORMAT);
+		pixelFormat.flags = kPixelFormatRGB;
+		pixelFormat.RGBBitCount = bitCount;
+		pixelFormat.RBitMask = r;
+		pixelFormat.GBitMask = g;
+		pixelFormat.BBitMask = b;
+		pixelFormat.ABitMask = a;
+		return pixelFormat;
+	}
+
+	// The magic number and a Direct3D 9 header; depth is only written for volumes.
+	std::vector<uint8_t> LegacyHeader(uint32_t width, uint32_t height, uint32_t depth, uint32_t mipCount, const DDS_PIXELFORMAT& pixelFormat,
+		uint32_t caps2 = 0)
+	{
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = kHeaderFlagsTexture | (mipCount > 1 ? kHeaderFlagsMipMap : 0) | (depth > 0 ? kHeaderFlagsVolume : 0);
+		header.width = width;
+		header.height = height;
+		header.depth = depth;
+		header.mipMapCount = mipCount;
+		header.ddspf = pixelFormat;
+		header.caps2 = caps2;
+
+		std::vector<uint8_t> bytes(sizeof(uint32_t) + sizeof(DDS_HEADER));
+		memcpy(bytes.data(), &DDS_MAGIC, sizeof(uint32_t));
+		memcpy(bytes.data() + sizeof(uint32_t), &header, sizeof(header));
+		return bytes;
+	}
+
+	// A legacy header naming the DX10 extension, followed by the extension.
+	std::vector<uint8_t> DX10Header(uint32_t width, uint32_t height, uint32_t depth, uint32_t mipCount, DXGI_FORMAT format, uint32_t dimension,
+		uint32_t miscFlag, uint32_t arraySize)
+	{
+		std::vector<uint8_t> bytes = LegacyHeader(width, height, depth, mipCount, FourCCFormat(MakeFourCC('D', 'X', '1', '0')));
+		DDS_HEADER_DXT10 ext = {};
+		ext.dxgiFormat = format;
+		ext.resourceDimension = dimension;
+		ext.miscFlag = miscFlag;
+		ext.arraySize = arraySize;
+		const uint8_t* extBytes = reinterpret_cast<const uint8_t*>(&ext);
+		bytes.insert(bytes.end(), extBytes, extBytes + sizeof(ext));
+		return bytes;
+	}
+
+	// A header with room after it for ValidateDDS to read DDS_MAX_HEADER_SIZE bytes of however
+	// large a file it is told about. Only the headers are read, so the bits are never allocated.
+	std::vector<uint8_t> Padded(const std::vector<uint8_t>& header)
+	{
+		std::vector<uint8_t> bytes = header;
+		bytes.resize(DDS_MAX_HEADER_SIZE, 0);
+		return bytes;
+	}
+
+	std::string U64(uint64_t value)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+		return text;
+	}
+
+	void TestLayout(const LayoutCase& test)
+	{
+		DDSTextureDesc desc;
+		DDSResult result = ParseDDSHeader(test.header.data(), test.header.size(), desc);
+		Check(test.name, "parses", result == DDS_OK, ResultDetail(result, DDS_OK));
+		if (result != DDS_OK)
+			return;
+
+		const uint32_t mipCount = static_cast<uint32_t>(test.mips.size());
+		const bool descMatches = desc.dimension == test.dimension && desc.format == test.format && desc.width == test.width && desc.height == test.height &&
+			desc.depth == test.depth && desc.mipCount == mipCount && desc.arraySize == test.arraySize && desc.isCubeMap == test.isCubeMap &&
+			desc.headerSize == test.headerSize;
+		char detail[256];
+		snprintf(detail, sizeof(detail), "\"dimension\": %d, \"format\": %d, \"size\": [%u, %u, %u], \"mips\": %u, \"arraySize\": %u, \"cubeMap\": %s, \"headerSize\": %u",
+			desc.dimension, desc.format, desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize, desc.isCubeMap ? "true" : "false", desc.headerSize);
+		Check(test.name, "description", descMatches, detail);
+		if (!descMatches)
+			return;
+
+		Check(test.name, "data size", desc.dataSize == test.dataSize, "\"dataSize\": " + U64(desc.dataSize) + ", \"expected\": " + U64(test.dataSize));
+
+		std::vector<DDSSubresource> subresources(mipCount * desc.arraySize + 1);
+		const uint32_t sentinel = 0xCDCDCDCD;
+		memset(&subresources.back(), 0xCD, sizeof(DDSSubresource));
+		const uint64_t layoutSize = ComputeDDSLayout(desc, subresources.data());
+		Check(test.name, "layout size", layoutSize == test.dataSize, "\"layoutSize\": " + U64(layoutSize));
+
+		// Every slice repeats the first one's mips sliceStride further on
+		std::string mismatch;
+		for (uint32_t slice = 0; slice < desc.arraySize && mismatch.empty(); ++slice)
+		{
+			for (uint32_t mip = 0; mip < mipCount && mismatch.empty(); ++mip)
+			{
+				const DDSSubresource& actual = subresources[slice * mipCount + mip];
+				const ExpectedMip& expected = test.mips[mip];
+				const uint64_t offset = expected.offset + test.sliceStride * slice;
+				if (actual.offset != offset || actual.width != expected.width || actual.height != expected.height || actual.depth != expected.depth ||
+					actual.rowBytes != expected.rowBytes || actual.numRows != expected.numRows || actual.sliceBytes != expected.sliceBytes)
+				{
+					snprintf(detail, sizeof(detail), "\"slice\": %u, \"mip\": %u, \"offset\": %llu, \"expectedOffset\": %llu, \"size\": [%u, %u, %u], \"rowBytes\": %u, \"numRows\": %u, \"sliceBytes\": %llu",
+						slice, mip, static_cast<unsigned long long>(actual.offset), static_cast<unsigned long long>(offset), actual.width, actual.height, actual.depth,
+						actual.rowBytes, actual.numRows, static_cast<unsigned long long>(actual.sliceBytes));
+					mismatch = detail;
+				}
+			}
+		}
+		uint32_t past;
+		memcpy(&past, &subresources.back(), sizeof(past));
+		Check(test.name, "subresources", mismatch.empty() && past == sentinel, mismatch.empty() && past != sentinel ? "\"wrotePastEnd\": true" : mismatch);
+
+		// The file has to hold every byte of the layout, and may hold more
+		const std::vector<uint8_t> file = Padded(test.header);
+		const uint64_t exactSize = test.headerSize + test.dataSize;
+		result = ValidateDDS(file.data(), exactSize, desc);
+		Check(test.name, "exact file", result == DDS_OK, ResultDetail(result, DDS_OK));
+		result = ValidateDDS(file.data(), exactSize - 1, desc);
+		Check(test.name, "file one byte short", result == DDS_TRUNCATED, ResultDetail(result, DDS_TRUNCATED));
+		result = ValidateDDS(file.data(), exactSize + 4096, desc);
+		Check(test.name, "file with trailing bytes", result == DDS_OK && desc.dataSize == test.dataSize, ResultDetail(result, DDS_OK));
+		result = ParseDDSHeader(test.header.data(), test.headerSize - 1, desc);
+		Check(test.name, "header one byte short", result == DDS_TRUNCATED, ResultDetail(result, DDS_TRUNCATED));
+	}
+
+	void TestReject(const RejectCase& test)
+	{
+		DDSTextureDesc desc;
+		DDSResult result = ParseDDSHeader(test.header.data(), test.size, desc);
+		Check(test.name, "parse rejects", result == test.expected, ResultDetail(result, test.expected));
+
+		// ValidateDDS is given the same bytes as a file of that size
+		const std::vector<uint8_t> file = Padded(test.header);
+		result = ValidateDDS(file.data(), test.size, desc);
+		Check(test.name, "validate rejects", result == test.expected, ResultDetail(result, test.expected));
+	}
+
+	std::vector<LayoutCase> MakeLayoutCases(void)
+	{
+		const DDS_PIXELFORMAT rgba = RGBFormat(32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+		const DDS_PIXELFORMAT bgra = RGBFormat(32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+		std::vector<LayoutCase> cases;
+
+		// 8x4 is 2x1 blocks of 8 bytes; every smaller mip still takes a whole block
+		cases.push_back({ "legacy BC1 8x4, 4 mips", LegacyHeader(8, 4, 0, 4, FourCCFormat(MakeFourCC('D', 'X', 'T', '1'))),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_BC1_UNORM, 8, 4, 1, 1, false, kLegacyHeaderSize,
+			{ { 0, 8, 4, 1, 16, 1, 16 }, { 16, 4, 2, 1, 8, 1, 8 }, { 24, 2, 1, 1, 8, 1, 8 }, { 32, 1, 1, 1, 8, 1, 8 } }, 40, 40 });
+
+		// A header without DDSD_MIPMAPCOUNT and a count of 0 holds one mip
+		cases.push_back({ "legacy BGRA 3x5, no mip count", LegacyHeader(3, 5, 0, 0, bgra),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_B8G8R8A8_UNORM, 3, 5, 1, 1, false, kLegacyHeaderSize,
+			{ { 0, 3, 5, 1, 12, 5, 60 } }, 60, 60 });
+
+		// Six faces of 64 + 16 + 4 bytes, in face order
+		cases.push_back({ "legacy RGBA cube map 4x4, 3 mips", LegacyHeader(4, 4, 0, 3, rgba, kCubeMapAllFaces),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, 6, true, kLegacyHeaderSize,
+			{ { 0, 4, 4, 1, 16, 4, 64 }, { 64, 2, 2, 1, 8, 2, 16 }, { 80, 1, 1, 1, 4, 1, 4 } }, 84, 504 });
+
+		// Each depth slice of a volume mip is sliceBytes, and the mip is depth of them
+		cases.push_back({ "legacy BGRA volume 4x4x4, 3 mips", LegacyHeader(4, 4, 4, 3, bgra),
+			DDS_DIMENSION_TEXTURE3D, DXGI_FORMAT_B8G8R8A8_UNORM, 4, 4, 4, 1, false, kLegacyHeaderSize,
+			{ { 0, 4, 4, 4, 16, 4, 64 }, { 256, 2, 2, 2, 8, 2, 16 }, { 288, 1, 1, 1, 4, 1, 4 } }, 292, 292 });
+
+		// 12x12 is 3x3 blocks of 16 bytes and 6x6 rounds up to 2x2
+		cases.push_back({ "DX10 BC7 array 12x12, 3 slices, 2 mips", DX10Header(12, 12, 0, 2, DXGI_FORMAT_BC7_UNORM_SRGB, DDS_DIMENSION_TEXTURE2D, 0, 3),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_BC7_UNORM_SRGB, 12, 12, 1, 3, false, kDX10HeaderSize,
+			{ { 0, 12, 12, 1, 48, 3, 144 }, { 144, 6, 6, 1, 32, 2, 64 } }, 208, 624 });
+
+		// Two cubes are twelve faces of 8 bytes a texel
+		cases.push_back({ "DX10 half float cube array 2x2, 2 cubes, 2 mips",
+			DX10Header(2, 2, 0, 2, DXGI_FORMAT_R16G16B16A16_FLOAT, DDS_DIMENSION_TEXTURE2D, kResourceMiscTextureCube, 2),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_R16G16B16A16_FLOAT, 2, 2, 1, 12, true, kDX10HeaderSize,
+			{ { 0, 2, 2, 1, 16, 2, 32 }, { 32, 1, 1, 1, 8, 1, 8 } }, 40, 480 });
+
+		// Odd sizes halve rounding down: 5x3x2, then 2x1x1
+		cases.push_back({ "DX10 R8 volume 5x3x2, 2 mips", DX10Header(5, 3, 2, 2, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE3D, 0, 1),
+			DDS_DIMENSION_TEXTURE3D, DXGI_FORMAT_R8_UNORM, 5, 3, 2, 1, false, kDX10HeaderSize,
+			{ { 0, 5, 3, 2, 5, 3, 15 }, { 30, 2, 1, 1, 2, 1, 2 } }, 32, 32 });
+
+		// 1D textures have a height and depth of 1 whatever the header holds
+		cases.push_back({ "DX10 float 1D array 8, 4 slices, 4 mips", DX10Header(8, 1, 0, 4, DXGI_FORMAT_R32G32B32A32_FLOAT, DDS_DIMENSION_TEXTURE1D, 0, 4),
+			DDS_DIMENSION_TEXTURE1D, DXGI_FORMAT_R32G32B32A32_FLOAT, 8, 1, 1, 4, false, kDX10HeaderSize,
+			{ { 0, 8, 1, 1, 128, 1, 128 }, { 128, 4, 1, 1, 64, 1, 64 }, { 192, 2, 1, 1, 32, 1, 32 }, { 224, 1, 1, 1, 16, 1, 16 } }, 240, 960 });
+
+		// The largest 2D texture is over 4 GB: 16 bytes times (4^15 - 1) / 3 texels over 15 mips
+		LayoutCase largest = { "DX10 float 16384x16384, 15 mips", DX10Header(16384, 16384, 0, 15, DXGI_FORMAT_R32G32B32A32_FLOAT, DDS_DIMENSION_TEXTURE2D, 0, 1),
+			DDS_DIMENSION_TEXTURE2D, DXGI_FORMAT_R32G32B32A32_FLOAT, 16384, 16384, 1, 1, false, kDX10HeaderSize, {}, 5726623056ull, 5726623056ull };
+		uint64_t offset = 0;
+		for (uint32_t mip = 0; mip < 15; ++mip)
+		{
+			const uint32_t size = 16384u >> mip;
+			largest.mips.push_back({ offset, size, size, 1, size * 16, size, static_cast<uint64_t>(size) * size * 16 });
+			offset += static_cast<uint64_t>(size) * size * 16;
+		}
+		cases.push_back(largest);
+		return cases;
+	}
+
+	std::vector<RejectCase> MakeRejectCases(void)
+	{
+		const DDS_PIXELFORMAT rgba = RGBFormat(32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+		const std::vector<uint8_t> valid = LegacyHeader(4, 4, 0, 1, rgba);
+		const std::vector<uint8_t> validDX10 = DX10Header(4, 4, 0, 1, DXGI_FORMAT_BC7_UNORM, DDS_DIMENSION_TEXTURE2D, 0, 1);
+		std::vector<RejectCase> cases;
+
+		// Cut short
+		cases.push_back({ "empty file", valid, 0, DDS_TRUNCATED });
+		cases.push_back({ "magic number only", valid, 4, DDS_TRUNCATED });
+		cases.push_back({ "legacy header cut short", valid, kLegacyHeaderSize - 1, DDS_TRUNCATED });
+		cases.push_back({ "DX10 extension missing", validDX10, kLegacyHeaderSize, DDS_TRUNCATED });
+		cases.push_back({ "DX10 extension cut short", validDX10, kDX10HeaderSize - 1, DDS_TRUNCATED });
+
+		// Not a DDS file
+		std::vector<uint8_t> header = valid;
+		header[0] = 'X';
+		cases.push_back({ "wrong magic number", header, header.size(), DDS_INVALID_HEADER });
+		cases.push_back({ "wrong magic number, cut short", header, 16, DDS_INVALID_HEADER });
+		header = valid;
+		header[4] = 100;
+		cases.push_back({ "wrong header size", header, header.size(), DDS_INVALID_HEADER });
+		header = valid;
+		header[4 + 72] = 16;
+		cases.push_back({ "wrong pixel format size", header, header.size(), DDS_INVALID_HEADER });
+
+		// Contradicting itself or in a format Direct3D 11 cannot create
+		header = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE2D, 0, 0);
+		cases.push_back({ "DX10 array size 0", header, header.size(), DDS_INVALID_DATA });
+		header = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE3D, 0, 1);
+		cases.push_back({ "DX10 volume without a depth", header, header.size(), DDS_INVALID_DATA });
+		header = DX10Header(8, 4, 0, 1, DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE1D, 0, 1);
+		cases.push_back({ "DX10 1D texture 4 high", header, header.size(), DDS_INVALID_DATA });
+		header = DX10Header(4, 4, 0, 1, static_cast<DXGI_FORMAT>(200), DDS_DIMENSION_TEXTURE2D, 0, 1);
+		cases.push_back({ "DX10 unknown format", header, header.size(), DDS_NOT_SUPPORTED });
+		header = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8G8B8A8_UNORM, 1, 0, 1);
+		cases.push_back({ "DX10 buffer dimension", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(4, 4, 0, 1, RGBFormat(24, 0xff0000, 0x00ff00, 0x0000ff, 0));
+		cases.push_back({ "legacy 24-bit RGB", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(4, 4, 0, 1, rgba, kCubeMapAllFaces & ~kCubeMapNegativeZ);
+		cases.push_back({ "legacy cube map missing a face", header, header.size(), DDS_NOT_SUPPORTED });
+
+		// Over the Direct3D 11 limits, which keeps layouts of untrusted files bounded
+		header = LegacyHeader(0, 4, 0, 1, rgba);
+		cases.push_back({ "width 0", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(16385, 4, 0, 1, rgba);
+		cases.push_back({ "2D width 16385", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(4, 16385, 0, 1, rgba);
+		cases.push_back({ "2D height 16385", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(16384, 16384, 0, 16, rgba);
+		cases.push_back({ "16 mips", header, header.size(), DDS_NOT_SUPPORTED });
+		header = DX10Header(16385, 1, 0, 1, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE1D, 0, 1);
+		cases.push_back({ "1D width 16385", header, header.size(), DDS_NOT_SUPPORTED });
+		header = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE2D, 0, 2049);
+		cases.push_back({ "array of 2049", header, header.size(), DDS_NOT_SUPPORTED });
+		header = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE2D, kResourceMiscTextureCube, 342);
+		cases.push_back({ "cube array of 342 cubes", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(4, 4, 2049, 1, rgba);
+		cases.push_back({ "volume depth 2049", header, header.size(), DDS_NOT_SUPPORTED });
+		header = LegacyHeader(2049, 4, 4, 1, rgba);
+		cases.push_back({ "volume width 2049", header, header.size(), DDS_NOT_SUPPORTED });
+		header = DX10Header(4, 4, 4, 1, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE3D, 0, 2);
+		cases.push_back({ "volume array", header, header.size(), DDS_NOT_SUPPORTED });
+		return cases;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	(void)argv;
+	if (argc != 1)
+	{
+		fprintf(stderr, "usage: DDSTest\n");
+		return 2;
+	}
+
+	printf("{\n\t\"checks\": [\n");
+	for (const LayoutCase& test : MakeLayoutCases())
+		TestLayout(test);
+	for (const RejectCase& test : MakeRejectCases())
+		TestReject(test);
+
+	// The limits are inclusive: the largest cube array still parses
+	const std::vector<uint8_t> cubes = DX10Header(4, 4, 0, 1, DXGI_FORMAT_R8_UNORM, DDS_DIMENSION_TEXTURE2D, kResourceMiscTextureCube, 341);
+	DDSTextureDesc desc;
+	DDSResult result = ParseDDSHeader(cubes.data(), cubes.size(), desc);
+	Check("cube array of 341 cubes", "parses", result == DDS_OK && desc.arraySize == 2046, ResultDetail(result, DDS_OK));
+	printf("\n\t],\n\t\"failures\": %u\n}\n", g_failures);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+﻿// Times loading OBJ and DDS assets as shipped and from their gzip and zstd copies, which are
+// decompressed through a small window rather than read whole, and textures from their universal
+// texture copies, transcoded to BC as TextureStreamer does, and prints JSON with each copy's time
+// against the plain file's. Textures go through the CPU side of CreateDDSTextureFromFile: a plain
+// file is mapped, validated and its bits copied out as the upload does, a compressed one is
+// streamed into the same buffer. Meshes are parsed with LoadObjFile. Each gzip and zstd copy has
+// to load to the same bits or mesh as the plain file; transcoding is lossy, so a universal texture
+// only has to give the same dimensions, mips and array size. It needs no GPU and builds anywhere
+// the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o LoadBenchmark Tools/LoadBenchmark/LoadBenchmark.cpp
+//       DX11UWA/Content/ObjLoader.cpp DX11UWA/Common/{DDSFile,MappedFile,CompressedFile,FileIO,LinearArena,UniversalTexture,BCEncoder}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: LoadBenchmark [--runs count] asset.obj|asset.dds...
+// For each asset, asset.gz and asset.zst, and asset.utx for a texture, are timed too when they exist. The best of --runs runs,
+// 5 by default, is kept so that the first run's cold file cache does not count. The exit code is
+// 1 when any file fails to load or a compressed copy loads differently from the plain file, and 2
+// for bad arguments.
+
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+#include "Common/UniversalTexture.h"
+#include "Content/ObjLoader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const char* const kSuffixes[] = { "", ".gz", ".zst", ".utx" };
+	const char* const kUniversalSuffix = ".utx";
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: LoadBenchmark [--runs count] asset.obj|asset.dds...\n");
+		return 2;
+	}
+
+	uint64_t Hash(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	// Loads a texture's bits as CreateDDSTextureFromFile, or TextureStreamer for a universal
+	// texture, does before handing them to Direct3D and hashes them, and its dimensions, mips and
+	// array size. Returns false when the file is not a valid texture.
+	bool LoadTexture(const char* path, uint64_t& outHash, uint64_t& outShape)
+	{
+		DX::MappedFile file;
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+		const size_t fileSize = static_cast<size_t>(file.GetSize());
+		DX::DDSTextureDesc desc;
+		std::vector<uint8_t> bits;
+		if (DX::IsUniversalTexture(file.GetData(), fileSize))
+		{
+			std::vector<uint8_t> transcoded;
+			if (DX::TranscodeUniversalTexture(file.GetData(), fileSize, DX::BC_FORMAT_COUNT, 0, transcoded) == 0 ||
+				DX::ValidateDDS(transcoded.data(), transcoded.size(), desc) != DX::DDS_OK)
+				return false;
+			bits.assign(transcoded.begin() + desc.headerSize, transcoded.begin() + desc.headerSize + static_cast<size_t>(desc.dataSize));
+		}
+		else if (DX::DetectCompression(file.GetData(), fileSize) != DX::COMPRESSION_NONE)
+		{
+			DX::CompressedFile stream;
+			uint8_t header[DX::DDS_MAX_HEADER_SIZE];
+			if (!stream.Open(file.GetData(), fileSize) || DX::ReadDDSHeader(stream, header, desc) != DX::DDS_OK || desc.dataSize > SIZE_MAX)
+				return false;
+			bits.resize(static_cast<size_t>(desc.dataSize));
+			if (!stream.ReadAll(bits.data(), bits.size()))
+				return false;
+		}
+		else
+		{
+			if (DX::ValidateDDS(file.GetData(), fileSize, desc) != DX::DDS_OK)
+				return false;
+			bits.assign(file.GetData() + desc.headerSize, file.GetData() + desc.headerSize + static_cast<size_t>(desc.dataSize));
+		}
+		outHash = Hash(0xCBF29CE484222325ull, bits.data(), bits.size());
+		const uint32_t shape[] = { desc.dimension, desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize };
+		outShape = Hash(0xCBF29CE484222325ull, shape, sizeof(shape));
+		return true;
+	}
+
+	bool LoadMesh(const char* path, uint64_t& outHash, uint64_t& outShape)
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+		if (!LoadObjFile(path, vertices, indices))
+			return false;
+		outHash = Hash(Hash(0xCBF29CE484222325ull, vertices.data(), vertices.size() * sizeof(MeshVertex)), indices.data(), indices.size() * sizeof(uint32_t));
+		outShape = outHash;
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t runCount = 5;
+	std::vector<const char*> assets;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			runCount = static_cast<uint32_t>(value);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			assets.push_back(argv[i]);
+		}
+	}
+	if (assets.empty())
+		return Usage();
+
+	bool failed = false;
+	printf("{\n\t\"runs\": %u,\n\t\"assets\": [\n", runCount);
+	for (size_t a = 0; a < assets.size(); ++a)
+	{
+		const char* asset = assets[a];
+		const char* extension = strrchr(asset, '.');
+		const bool isTexture = extension && strcmp(extension, ".dds") == 0;
+		printf("\t\t{ \"path\": %s, \"copies\": [\n", JsonString(asset).c_str());
+
+		double plainMs = 0.0;
+		uint64_t plainHash = 0;
+		uint64_t plainShape = 0;
+		bool firstCopy = true;
+		for (const char* suffix : kSuffixes)
+		{
+			const bool isUniversal = strcmp(suffix, kUniversalSuffix) == 0;
+			if (isUniversal && !isTexture)
+				continue;
+			const std::string path = std::string(asset) + suffix;
+			uint64_t fileSize;
+			if (!DX::GetFileSize(path.c_str(), fileSize))
+			{
+				// The plain file has to be there; the compressed copies are optional.
+				if (!*suffix)
+				{
+					printf("\t\t\t{ \"suffix\": \"\", \"error\": \"not found\" }");
+					failed = true;
+					firstCopy = false;
+					break;
+				}
+				continue;
+			}
+
+			double bestMs = -1.0;
+			uint64_t hash = 0;
+			uint64_t shape = 0;
+			for (uint32_t run = 0; run < runCount; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				const bool loaded = isTexture ? LoadTexture(path.c_str(), hash, shape) : LoadMesh(path.c_str(), hash, shape);
+				const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				if (!loaded)
+				{
+					bestMs = -1.0;
+					break;
+				}
+				bestMs = bestMs < 0.0 || ms < bestMs ? ms : bestMs;
+			}
+
+			printf("%s\t\t\t{ \"suffix\": \"%s\", \"fileBytes\": %llu", firstCopy ? "" : ",\n", suffix, static_cast<unsigned long long>(fileSize));
+			firstCopy = false;
+			if (bestMs < 0.0)
+			{
+				printf(", \"error\": \"failed to load\" }");
+				failed = true;
+				if (!*suffix)
+					break;
+				continue;
+			}
+			if (!*suffix)
+			{
+				plainMs = bestMs;
+				plainHash = hash;
+				plainShape = shape;
+			}
+			const bool matches = isUniversal ? shape == plainShape : hash == plainHash;
+			failed = failed || !matches;
+			printf(", \"milliseconds\": %.2f, \"percentOfPlain\": %.0f, \"matchesPlain\": %s }", bestMs, plainMs > 0.0 ? 100.0 * bestMs / plainMs : 100.0,
+				matches ? "true" : "false");
+		}
+		printf("\n\t\t] }%s\n", a + 1 < assets.size() ? "," : "");
+	}
+	printf("\t]\n}\n");
+	return failed ? 1 : 0;
+}
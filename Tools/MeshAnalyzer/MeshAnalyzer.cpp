@@ -0,0 +1,328 @@
+﻿// Imports OBJ files through the same path as the renderer's loadObject, without a cache, and
+// prints JSON describing how efficiently each one will draw, so that asset check-ins can be
+// gated on regressions. It needs no GPU and builds anywhere the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o MeshAnalyzer Tools/MeshAnalyzer/MeshAnalyzer.cpp
+//       DX11UWA/Content/{MeshCache,MeshPacking,MeshOptimizer,ObjLoader,IndexCodec,MeshSimplifier,MeshClusters}.cpp
+//       DX11UWA/Common/{MappedFile,LinearArena,FileIO,CompressedFile}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: MeshAnalyzer [--format float|quantized|half] file.obj...
+//        MeshAnalyzer --benchmark [--size megabytes] [--threads count] [--runs count]
+// The default format is the one the renderer asks for. --benchmark generates an OBJ grid of
+// about --size megabytes in memory, 256 by default, half its faces with relative indices, and
+// parses it with 1, 2, 4 and so on up to --threads threads, one a core by default, keeping the
+// best of --runs runs, 3 by default. It prints the rate and speed-up at each thread count and
+// checks that every count builds the same mesh. The exit code is 1 when any file could not be
+// imported or the benchmark's meshes differ, and 2 for bad arguments.
+
+#include "Content/MeshCache.h"
+#include "Content/ObjLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const char* const kFormatNames[MESH_VERTEX_FORMAT_COUNT] = { "float", "quantized", "half" };
+	const unsigned int kCacheSizes[] = { 8, 16, 32, 64 };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	void PrintFloat3(const char* name, const MeshFloat3& value)
+	{
+		printf("\"%s\": [%.9g, %.9g, %.9g]", name, value.x, value.y, value.z);
+	}
+
+	void PrintCacheStats(const VertexCacheStats& stats)
+	{
+		printf("\"acmr\": %.4f, \"atvr\": %.4f, \"overfetch\": %.4f", stats.acmr, stats.atvr, stats.overfetch);
+	}
+
+	// Prints one element of the "meshes" array. Returns false when the mesh could not be imported.
+	bool AnalyzeFile(const char* path, MeshVertexFormat format)
+	{
+		CachedMesh mesh;
+		MeshCacheStats stats;
+		if (!LoadObjWithCache(path, nullptr, format, mesh, &stats))
+		{
+			printf("\t\t{ \"path\": %s, \"error\": \"import failed\" }", JsonString(path).c_str());
+			return false;
+		}
+
+		// Everything below looks at what would be uploaded: the finest LOD, decoded back to floats.
+		const uint32_t vertexCount = mesh.GetVertexCount();
+		const uint32_t indexCount = mesh.GetLod(0).indexCount;
+		const uint32_t triangleCount = indexCount / 3;
+		std::vector<MeshVertex> vertices(vertexCount);
+		UnpackMeshVertices(mesh.GetVertexFormat(), mesh.GetDecode(), mesh.GetVertexData(), vertexCount, vertices.data());
+		std::vector<uint32_t> indices(mesh.GetIndexCount());
+		ConvertIndices(mesh.GetIndexData(), mesh.GetIndexSize(), indices.data(), 4, indices.size());
+		const uint32_t* lodIndices = indices.data() + mesh.GetLod(0).indexOffset;
+
+		printf("\t\t{\n\t\t\t\"path\": %s,\n", JsonString(path).c_str());
+		printf("\t\t\t\"format\": \"%s\", \"vertexStride\": %u, \"indexSize\": %u,\n", kFormatNames[mesh.GetVertexFormat()], mesh.GetVertexStride(), mesh.GetIndexSize());
+		printf("\t\t\t\"triangles\": %u, \"submeshes\": %u,\n", triangleCount, mesh.GetSubmeshCount());
+
+		// Emitted is what a non-indexed draw would transform; unique is what is uploaded.
+		const ObjLoadStats& parse = stats.parse;
+		printf("\t\t\t\"vertices\": { \"emitted\": %u, \"welded\": %u, \"unique\": %u, \"positions\": %u, \"duplicateRatio\": %.4f },\n",
+			parse.cornerCount, parse.vertexCount, vertexCount, parse.positionCount, parse.cornerCount ? 1.0 - double(vertexCount) / parse.cornerCount : 0.0);
+
+		printf("\t\t\t\"vertexCache\": {\n\t\t\t\t\"imported\": { \"size\": %u, ", MESH_ANALYZE_CACHE_SIZE);
+		PrintCacheStats(stats.optimize.input);
+		printf(" },\n\t\t\t\t\"optimized\": [\n");
+		for (size_t i = 0; i < sizeof(kCacheSizes) / sizeof(kCacheSizes[0]); ++i)
+		{
+			printf("\t\t\t\t\t{ \"size\": %u, ", kCacheSizes[i]);
+			PrintCacheStats(AnalyzeVertexCache(lodIndices, indexCount, vertexCount, mesh.GetVertexStride(), kCacheSizes[i]));
+			printf(" }%s\n", i + 1 < sizeof(kCacheSizes) / sizeof(kCacheSizes[0]) ? "," : "");
+		}
+		printf("\t\t\t\t]\n\t\t\t},\n");
+
+		OverdrawStats overdraw = AnalyzeOverdraw(lodIndices, indexCount, vertices.data(), vertexCount);
+		printf("\t\t\t\"overdraw\": { \"resolution\": %u, \"views\": [", MESH_ANALYZE_OVERDRAW_RESOLUTION);
+		for (unsigned int i = 0; i < MESH_ANALYZE_OVERDRAW_VIEWS; ++i)
+			printf("%s%.4f", i ? ", " : "", overdraw.views[i]);
+		printf("], \"average\": %.4f },\n", overdraw.average);
+
+		DegenerateStats degenerate = CountDegenerateTriangles(lodIndices, indexCount, vertices.data());
+		printf("\t\t\t\"degenerateTriangles\": { \"repeatedIndex\": %u, \"zeroArea\": %u },\n", degenerate.repeatedIndex, degenerate.zeroArea);
+
+		printf("\t\t\t\"bounds\": { ");
+		PrintFloat3("min", mesh.GetBounds().min);
+		printf(", ");
+		PrintFloat3("max", mesh.GetBounds().max);
+		printf(" },\n");
+
+		// The encoded size is what the mesh cache stores the whole index array as, every LOD included.
+		std::vector<uint8_t> encoded;
+		EncodeIndexBuffer(mesh.GetIndexData(), mesh.GetIndexCount(), mesh.GetIndexSize(), encoded);
+		uint64_t vertexBytes = uint64_t(vertexCount) * mesh.GetVertexStride();
+		uint64_t indexBytes = uint64_t(indexCount) * mesh.GetIndexSize();
+		printf("\t\t\t\"size\": { \"vertexBytes\": %llu, \"indexBytes\": %llu, \"bytesPerTriangle\": %.2f, \"allLodIndexBytes\": %llu, \"encodedIndexBytes\": %llu },\n",
+			static_cast<unsigned long long>(vertexBytes), static_cast<unsigned long long>(indexBytes), triangleCount ? double(vertexBytes + indexBytes) / triangleCount : 0.0,
+			static_cast<unsigned long long>(uint64_t(mesh.GetIndexCount()) * mesh.GetIndexSize()), static_cast<unsigned long long>(encoded.size()));
+
+		printf("\t\t\t\"lods\": [");
+		for (uint32_t i = 0; i < mesh.GetLodCount(); ++i)
+			printf("%s{ \"triangles\": %u, \"error\": %.6f }", i ? ", " : "", mesh.GetLod(i).indexCount / 3, mesh.GetLod(i).error);
+		printf("]\n\t\t}");
+		return true;
+	}
+
+	// A grid of vertices kGridWidth wide, row after row, each row followed by the quads joining
+	// it to the row before. Odd rows' quads use relative indices, so that chunks which split
+	// between a row's vertices and its faces have to be joined up.
+	const uint32_t kGridWidth = 1024;
+
+	void GenerateObj(size_t targetBytes, std::string& out)
+	{
+		char line[192];
+		out.reserve(targetBytes + 256 * 1024);
+		out = "# MeshAnalyzer --benchmark grid\ng grid\n";
+		for (uint32_t row = 0; out.size() < targetBytes; ++row)
+		{
+			for (uint32_t column = 0; column < kGridWidth; ++column)
+			{
+				const float x = column * 0.01f;
+				const float z = row * 0.01f;
+				const float y = 0.25f * static_cast<float>(((column * 7 + row * 13) % 101)) / 101.0f;
+				int length = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+					x, y, z, column / float(kGridWidth), (row % 1024) / 1024.0f, 0.0f, 1.0f, 0.0f);
+				out.append(line, length);
+			}
+			if (row == 0)
+				continue;
+
+			for (uint32_t column = 0; column + 1 < kGridWidth; ++column)
+			{
+				int64_t a, b, c, d;
+				if (row & 1)
+				{
+					a = -static_cast<int64_t>(2 * kGridWidth - column);
+					b = a + 1;
+					c = -static_cast<int64_t>(kGridWidth - column - 1);
+					d = c - 1;
+				}
+				else
+				{
+					a = static_cast<int64_t>(row - 1) * kGridWidth + column + 1;
+					b = a + 1;
+					c = b + kGridWidth;
+					d = a + kGridWidth;
+				}
+				int length = snprintf(line, sizeof(line), "f %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld\n",
+					static_cast<long long>(a), static_cast<long long>(a), static_cast<long long>(a), static_cast<long long>(b), static_cast<long long>(b), static_cast<long long>(b),
+					static_cast<long long>(c), static_cast<long long>(c), static_cast<long long>(c), static_cast<long long>(d), static_cast<long long>(d), static_cast<long long>(d));
+				out.append(line, length);
+			}
+		}
+	}
+
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	// Parses a generated OBJ at each thread count and prints the "benchmark" object. Returns false
+	// when a thread count fails to parse it or builds a different mesh from one thread.
+	bool RunBenchmark(size_t megabytes, unsigned int maxThreads, uint32_t runCount)
+	{
+		std::string text;
+		GenerateObj(megabytes << 20, text);
+
+		std::vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+
+		bool succeeded = true;
+		double baseSeconds = 0.0;
+		uint64_t baseHash = 0;
+		printf("{\n\t\"benchmark\": {\n\t\t\"bytes\": %llu, \"runs\": %u, \"cores\": %u,\n\t\t\"parses\": [\n",
+			static_cast<unsigned long long>(text.size()), runCount, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < threadCounts.size(); ++i)
+		{
+			ObjLoadStats best = {};
+			uint64_t hash = 0;
+			bool parsed = true;
+			for (uint32_t run = 0; run < runCount && parsed; ++run)
+			{
+				std::vector<MeshVertex> vertices;
+				std::vector<uint32_t> indices;
+				ObjLoadStats stats;
+				parsed = ParseObj(text.data(), text.size(), vertices, indices, &stats, threadCounts[i]);
+				if (parsed && (run == 0 || stats.parseSeconds < best.parseSeconds))
+					best = stats;
+				if (parsed && run == 0)
+					hash = HashBytes(indices.data(), indices.size() * sizeof(uint32_t), HashBytes(vertices.data(), vertices.size() * sizeof(MeshVertex), 0xCBF29CE484222325ull));
+			}
+			if (i == 0)
+			{
+				baseSeconds = best.parseSeconds;
+				baseHash = hash;
+			}
+
+			const bool matches = parsed && hash == baseHash;
+			succeeded = succeeded && matches;
+			printf("\t\t\t{ \"threads\": %u, \"chunks\": %u, \"parsed\": %s, \"matchesOneThread\": %s, \"triangles\": %u, \"vertices\": %u, ",
+				threadCounts[i], best.threadCount, parsed ? "true" : "false", matches ? "true" : "false", best.triangleCount, best.vertexCount);
+			printf("\"seconds\": %.4f, \"megabytesPerSecond\": %.1f, \"speedup\": %.2f }%s\n", best.parseSeconds, best.GetMegabytesPerSecond(),
+				best.parseSeconds > 0.0 ? baseSeconds / best.parseSeconds : 0.0, i + 1 < threadCounts.size() ? "," : "");
+		}
+		printf("\t\t]\n\t}\n}\n");
+		return succeeded;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: MeshAnalyzer [--format float|quantized|half] file.obj...\n"
+			"       MeshAnalyzer --benchmark [--size megabytes] [--threads count] [--runs count]\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	MeshVertexFormat format = MESH_VERTEX_QUANTIZED;
+	bool benchmark = false;
+	size_t benchmarkMegabytes = 256;
+	unsigned int benchmarkThreads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t benchmarkRuns = 3;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmark = true;
+			continue;
+		}
+		if ((strcmp(argv[i], "--size") == 0 || strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "--runs") == 0) && i + 1 < argc)
+		{
+			const long value = strtol(argv[i + 1], nullptr, 10);
+			if (value <= 0 || value > 65536)
+				return Usage();
+			if (argv[i][2] == 's')
+				benchmarkMegabytes = static_cast<size_t>(value);
+			else if (argv[i][2] == 't')
+				benchmarkThreads = static_cast<unsigned int>(value);
+			else
+				benchmarkRuns = static_cast<uint32_t>(value);
+			++i;
+			continue;
+		}
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			++i;
+			uint32_t found = MESH_VERTEX_FORMAT_COUNT;
+			for (uint32_t f = 0; f < MESH_VERTEX_FORMAT_COUNT; ++f)
+			{
+				if (strcmp(argv[i], kFormatNames[f]) == 0)
+					found = f;
+			}
+			if (found == MESH_VERTEX_FORMAT_COUNT)
+			{
+				fprintf(stderr, "MeshAnalyzer: unknown format '%s'\n", argv[i]);
+				return 2;
+			}
+			format = static_cast<MeshVertexFormat>(found);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (benchmark)
+		return paths.empty() ? (RunBenchmark(benchmarkMegabytes, benchmarkThreads, benchmarkRuns) ? 0 : 1) : Usage();
+	if (paths.empty())
+		return Usage();
+
+	bool succeeded = true;
+	printf("{\n\t\"meshes\": [\n");
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		succeeded = AnalyzeFile(paths[i], format) && succeeded;
+		printf("%s\n", i + 1 < paths.size() ? "," : "");
+	}
+	printf("\t]\n}\n");
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+﻿// Regression check for the mesh optimizer: runs the vertex cache, overdraw and vertex fetch
+// passes over generated grids, spheres, tori and random triangle soups and checks that each pass
+// improves what it is for without losing, adding or turning over a triangle. It needs no GPU and
+// builds anywhere the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o MeshOptimizerTest Tools/MeshOptimizerTest/MeshOptimizerTest.cpp
+//       DX11UWA/Content/MeshOptimizer.cpp DX11UWA/Common/LinearArena.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: MeshOptimizerTest
+// Prints JSON with every check and the cache statistics it compared. The exit code is 1 when any
+// check fails, and 2 for bad arguments.
+
+#include "Content/MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	struct TestMesh
+	{
+		std::string				name;
+		std::vector<MeshVertex>	vertices;
+		std::vector<uint32_t>	indices;
+		std::vector<uint32_t>	parts;		// index offsets of the parts OptimizeMesh keeps apart
+		bool					closed;		// a surface with a front and a back, which the overdraw pass can order
+	};
+
+	typedef std::array<uint32_t, 3> TriangleKey;
+
+	bool g_firstCheck = true;
+	unsigned int g_failures = 0;
+
+	void Check(const std::string& mesh, const char* name, bool passed, const std::string& detail)
+	{
+		printf("%s\t\t{ \"mesh\": \"%s\", \"check\": \"%s\", \"passed\": %s%s%s }", g_firstCheck ? "" : ",\n", mesh.c_str(), name, passed ? "true" : "false",
+			detail.empty() ? "" : ", ", detail.c_str());
+		g_firstCheck = false;
+		g_failures += passed ? 0 : 1;
+	}
+
+	std::string Describe(const char* beforeName, const VertexCacheStats& before, const char* afterName, const VertexCacheStats& after)
+	{
+		char text[256];
+		snprintf(text, sizeof(text), "\"%s\": { \"acmr\": %.4f, \"atvr\": %.4f, \"overfetch\": %.4f }, \"%s\": { \"acmr\": %.4f, \"atvr\": %.4f, \"overfetch\": %.4f }",
+			beforeName, before.acmr, before.atvr, before.overfetch, afterName, after.acmr, after.atvr, after.overfetch);
+		return text;
+	}
+
+	MeshVertex MakeVertex(float x, float y, float z, float nx, float ny, float nz, uint32_t tag)
+	{
+		// uv.z is unused by every vertex format, so it carries the vertex's identity through the
+		// fetch pass's renumbering.
+		MeshVertex vertex = { { x, y, z }, { 0.0f, 0.0f, static_cast<float>(tag) }, { nx, ny, nz } };
+		return vertex;
+	}
+
+	// A width x height grid of quads, rows in order, as OBJ exporters write them.
+	TestMesh MakeGrid(const char* name, uint32_t width, uint32_t height)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.closed = false;
+		for (uint32_t y = 0; y <= height; ++y)
+		{
+			for (uint32_t x = 0; x <= width; ++x)
+				mesh.vertices.push_back(MakeVertex(float(x), 0.0f, float(y), 0.0f, 1.0f, 0.0f, static_cast<uint32_t>(mesh.vertices.size())));
+		}
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				uint32_t a = y * (width + 1) + x;
+				uint32_t b = a + 1;
+				uint32_t c = a + width + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, c, b, b, c, d };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// A closed UV sphere, which has a back to hide behind its front.
+	TestMesh MakeSphere(const char* name, uint32_t rings, uint32_t segments)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.closed = true;
+		const float pi = 3.14159265f;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = pi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * pi * segment / segments;
+				const float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+				mesh.vertices.push_back(MakeVertex(x, y, z, x, y, z, static_cast<uint32_t>(mesh.vertices.size())));
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				uint32_t a = ring * (segments + 1) + segment;
+				uint32_t b = a + 1;
+				uint32_t c = a + segments + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, b, c, b, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// A torus, whose inner side hides behind its outer side from every direction.
+	TestMesh MakeTorus(const char* name, uint32_t rings, uint32_t segments)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.closed = true;
+		const float pi = 3.14159265f;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = 2.0f * pi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * pi * segment / segments;
+				const float nx = cosf(phi) * cosf(theta), ny = sinf(phi), nz = cosf(phi) * sinf(theta);
+				mesh.vertices.push_back(MakeVertex(cosf(theta) + 0.4f * nx, 0.4f * ny, sinf(theta) + 0.4f * nz, nx, ny, nz, static_cast<uint32_t>(mesh.vertices.size())));
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				uint32_t a = ring * (segments + 1) + segment;
+				uint32_t b = a + 1;
+				uint32_t c = a + segments + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, b, c, b, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// Triangles between random vertices in a cube, each vertex used about six times over.
+	TestMesh MakeSoup(const char* name, uint32_t vertexCount, uint32_t triangleCount, std::mt19937& random)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.closed = false;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const float x = (random() % 10000) / 10000.0f, y = (random() % 10000) / 10000.0f, z = (random() % 10000) / 10000.0f;
+			mesh.vertices.push_back(MakeVertex(x, y, z, 0.0f, 0.0f, 1.0f, v));
+		}
+		while (mesh.indices.size() < triangleCount * 3)
+		{
+			const uint32_t a = random() % vertexCount, b = random() % vertexCount, c = random() % vertexCount;
+			if (a != b && b != c && a != c)
+			{
+				const uint32_t triangle[] = { a, b, c };
+				mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+			}
+		}
+		return mesh;
+	}
+
+	// Shuffles the triangle order and the vertex numbering, as a poorly exported mesh has them.
+	void Shuffle(TestMesh& mesh, std::mt19937& random)
+	{
+		const size_t triangleCount = mesh.indices.size() / 3;
+		for (size_t t = triangleCount; t > 1; --t)
+		{
+			const size_t other = random() % t;
+			std::swap_ranges(mesh.indices.begin() + (t - 1) * 3, mesh.indices.begin() + t * 3, mesh.indices.begin() + other * 3);
+		}
+
+		std::vector<uint32_t> order(mesh.vertices.size());
+		for (uint32_t v = 0; v < order.size(); ++v)
+			order[v] = v;
+		for (size_t v = order.size(); v > 1; --v)
+			std::swap(order[v - 1], order[random() % v]);
+		std::vector<MeshVertex> vertices(mesh.vertices.size());
+		for (size_t v = 0; v < order.size(); ++v)
+			vertices[order[v]] = mesh.vertices[v];
+		mesh.vertices.swap(vertices);
+		for (uint32_t& index : mesh.indices)
+			index = order[index];
+	}
+
+	// Every triangle by its vertices' tags, rotated to start at the smallest so that winding
+	// still counts, and sorted so that order does not.
+	std::vector<TriangleKey> GetTriangles(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t indexCount)
+	{
+		std::vector<TriangleKey> triangles;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			TriangleKey key = { { static_cast<uint32_t>(vertices[indices[i]].uv.z), static_cast<uint32_t>(vertices[indices[i + 1]].uv.z),
+				static_cast<uint32_t>(vertices[indices[i + 2]].uv.z) } };
+			std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+			triangles.push_back(key);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	VertexCacheStats Analyze(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		return AnalyzeVertexCache(indices.data(), indices.size(), vertexCount, sizeof(MeshVertex));
+	}
+
+	// Runs the passes one by one, checking each, then OptimizeMesh as the importer calls it.
+	void TestMeshPasses(const TestMesh& mesh)
+	{
+		const std::vector<TriangleKey> original = GetTriangles(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+		std::vector<MeshVertex> vertices = mesh.vertices;
+		std::vector<uint32_t> indices = mesh.indices;
+
+		const VertexCacheStats input = Analyze(indices, vertices.size());
+		OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		const VertexCacheStats afterCache = Analyze(indices, vertices.size());
+		Check(mesh.name, "cache pass keeps every triangle", GetTriangles(vertices, indices.data(), indices.size()) == original, "");
+		Check(mesh.name, "cache pass lowers ACMR and ATVR", afterCache.acmr < input.acmr && afterCache.atvr < input.atvr,
+			Describe("input", input, "afterCache", afterCache));
+
+		const OverdrawStats overdrawBefore = AnalyzeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		const size_t clusterCount = OptimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		const VertexCacheStats afterOverdraw = Analyze(indices, vertices.size());
+		const OverdrawStats overdrawAfter = AnalyzeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		char detail[128];
+		snprintf(detail, sizeof(detail), "\"clusters\": %zu, \"overdrawBefore\": %.4f, \"overdrawAfter\": %.4f", clusterCount, overdrawBefore.average, overdrawAfter.average);
+		Check(mesh.name, "overdraw pass keeps every triangle", GetTriangles(vertices, indices.data(), indices.size()) == original, "");
+		Check(mesh.name, "overdraw pass keeps ACMR within 5%", afterOverdraw.acmr <= afterCache.acmr * 1.05f + 1e-4f,
+			detail + std::string(", ") + Describe("afterCache", afterCache, "afterOverdraw", afterOverdraw));
+		if (mesh.closed)
+			Check(mesh.name, "overdraw pass does not add overdraw", overdrawAfter.average <= overdrawBefore.average + 1e-3f, detail);
+
+		const size_t vertexCount = OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.size());
+		vertices.resize(vertexCount);
+		const VertexCacheStats afterFetch = Analyze(indices, vertices.size());
+		uint32_t nextVertex = 0;
+		bool firstUseOrder = true;
+		for (uint32_t index : indices)
+		{
+			firstUseOrder = firstUseOrder && index <= nextVertex;
+			nextVertex = std::max(nextVertex, index + 1);
+		}
+		Check(mesh.name, "fetch pass keeps every triangle", GetTriangles(vertices, indices.data(), indices.size()) == original, "");
+		Check(mesh.name, "fetch pass numbers vertices in first-use order", firstUseOrder && nextVertex == vertexCount, "");
+		// First-use order is not always better than an order the input already had, so overfetch
+		// is only held to be lower than the input's.
+		Check(mesh.name, "fetch pass keeps ACMR and overfetch ends below the input's",
+			afterFetch.overfetch < input.overfetch && std::fabs(afterFetch.acmr - afterOverdraw.acmr) < 1e-4f,
+			Describe("input", input, "afterFetch", afterFetch));
+
+		// As the importer runs it, with parts whose triangles must stay within them.
+		vertices = mesh.vertices;
+		indices = mesh.indices;
+		MeshOptimizeStats stats;
+		OptimizeMesh(vertices, indices, &stats, mesh.parts.empty() ? nullptr : &mesh.parts);
+		bool partsKept = true;
+		for (size_t part = 0; part < std::max<size_t>(mesh.parts.size(), 1); ++part)
+		{
+			const size_t start = mesh.parts.empty() ? 0 : mesh.parts[part];
+			const size_t end = part + 1 < mesh.parts.size() ? mesh.parts[part + 1] : mesh.indices.size();
+			partsKept = partsKept && GetTriangles(vertices, indices.data() + start, end - start) == GetTriangles(mesh.vertices, mesh.indices.data() + start, end - start);
+		}
+		Check(mesh.name, "OptimizeMesh keeps every triangle in its part", partsKept && indices.size() == mesh.indices.size(), "");
+		Check(mesh.name, "OptimizeMesh lowers ACMR", stats.afterFetch.acmr < stats.input.acmr, Describe("input", stats.input, "afterFetch", stats.afterFetch));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	(void)argv;
+	if (argc != 1)
+	{
+		fprintf(stderr, "usage: MeshOptimizerTest\n");
+		return 2;
+	}
+
+	std::mt19937 random(12345);
+	std::vector<TestMesh> meshes;
+	meshes.push_back(MakeGrid("grid 100x100", 100, 100));
+	meshes.push_back(MakeGrid("shuffled grid 128x64", 128, 64));
+	Shuffle(meshes.back(), random);
+	meshes.push_back(MakeSphere("shuffled sphere 48x96", 48, 96));
+	Shuffle(meshes.back(), random);
+	meshes.push_back(MakeTorus("shuffled torus 64x32", 64, 32));
+	Shuffle(meshes.back(), random);
+	meshes.push_back(MakeSoup("random soup", 3000, 6000, random));
+
+	// Two spheres as two parts, each shuffled within itself.
+	TestMesh parts = MakeSphere("two parts", 24, 48);
+	TestMesh second = MakeSphere("", 16, 32);
+	const uint32_t base = static_cast<uint32_t>(parts.vertices.size());
+	for (MeshVertex& vertex : second.vertices)
+	{
+		vertex.pos.x += 3.0f;
+		vertex.uv.z += base;
+		parts.vertices.push_back(vertex);
+	}
+	parts.parts.push_back(0);
+	parts.parts.push_back(static_cast<uint32_t>(parts.indices.size()));
+	for (uint32_t index : second.indices)
+		parts.indices.push_back(index + base);
+	for (size_t part = 0; part < 2; ++part)
+	{
+		const size_t start = parts.parts[part];
+		const size_t end = part ? parts.indices.size() : parts.parts[1];
+		for (size_t t = (end - start) / 3; t > 1; --t)
+			std::swap_ranges(parts.indices.begin() + start + (t - 1) * 3, parts.indices.begin() + start + t * 3, parts.indices.begin() + start + (random() % t) * 3);
+	}
+	meshes.push_back(parts);
+
+	printf("{\n\t\"checks\": [\n");
+	for (const TestMesh& mesh : meshes)
+		TestMeshPasses(mesh);
+	printf("\n\t],\n\t\"failures\": %u\n}\n", g_failures);
+	return g_failures ? 1 : 0;
+}
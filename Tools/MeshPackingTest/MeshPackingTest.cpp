@@ -0,0 +1,270 @@
+﻿// Error-bound check for the packed vertex formats: packs generated meshes in each packed format,
+// unpacks them through the CPU mirror of the shader decode and checks position, UV and normal
+// error against the tolerances the importer falls back to MESH_VERTEX_FLOAT beyond, and against
+// half a 16-bit step where the format rounds to one, measured here independently of
+// MeasurePackingError. It also checks that a packed mesh pulls half or less of
+// the vertex bytes through the fetch cache that the float one does. It needs no GPU and builds
+// anywhere the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o MeshPackingTest Tools/MeshPackingTest/MeshPackingTest.cpp
+//       DX11UWA/Content/{MeshPacking,MeshOptimizer}.cpp DX11UWA/Common/LinearArena.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: MeshPackingTest
+// Prints JSON with every check and the errors it measured. The exit code is 1 when any check
+// fails, and 2 for bad arguments.
+
+#include "Content/MeshOptimizer.h"
+#include "Content/MeshPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const MeshVertexFormat kPackedFormats[] = { MESH_VERTEX_QUANTIZED, MESH_VERTEX_HALF };
+	const char* const kFormatNames[MESH_VERTEX_FORMAT_COUNT] = { "float", "quantized", "half" };
+
+	struct TestMesh
+	{
+		std::string				name;
+		std::vector<MeshVertex>	vertices;
+		std::vector<uint32_t>	indices;	// empty for a point cloud
+		bool					halfFits;	// small and near enough the origin for half floats
+	};
+
+	bool g_firstCheck = true;
+	unsigned int g_failures = 0;
+
+	void Check(const std::string& mesh, const char* format, const char* name, bool passed, const std::string& detail)
+	{
+		printf("%s\t\t{ \"mesh\": \"%s\", \"format\": \"%s\", \"check\": \"%s\", \"passed\": %s%s%s }", g_firstCheck ? "" : ",\n", mesh.c_str(), format, name,
+			passed ? "true" : "false", detail.empty() ? "" : ", ", detail.c_str());
+		g_firstCheck = false;
+		g_failures += passed ? 0 : 1;
+	}
+
+	MeshFloat3 Normalize(float x, float y, float z)
+	{
+		const float length = sqrtf(x * x + y * y + z * z);
+		MeshFloat3 result = { x / length, y / length, z / length };
+		return result;
+	}
+
+	MeshVertex MakeVertex(float x, float y, float z, float u, float v, const MeshFloat3& normal)
+	{
+		MeshVertex vertex = { { x, y, z }, { u, v, 0.0f }, normal };
+		return vertex;
+	}
+
+	// Indices of a (columns + 1) x (rows + 1) lattice of vertices, row by row.
+	void AddLatticeIndices(uint32_t columns, uint32_t rows, std::vector<uint32_t>& indices)
+	{
+		for (uint32_t row = 0; row < rows; ++row)
+		{
+			for (uint32_t column = 0; column < columns; ++column)
+			{
+				uint32_t a = row * (columns + 1) + column;
+				uint32_t b = a + 1;
+				uint32_t c = a + columns + 1;
+				uint32_t d = c + 1;
+				const uint32_t quad[] = { a, c, b, b, c, d };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	TestMesh MakeSphere(const char* name, float radius, float cx, float cy, float cz, bool halfFits)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.halfFits = halfFits;
+		const uint32_t rings = 64, segments = 128;
+		const float pi = 3.14159265f;
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = pi * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * pi * segment / segments;
+				const MeshFloat3 normal = Normalize(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+				mesh.vertices.push_back(MakeVertex(cx + radius * normal.x, cy + radius * normal.y, cz + radius * normal.z,
+					float(segment) / segments, float(ring) / rings, normal));
+			}
+		}
+		AddLatticeIndices(segments, rings, mesh.indices);
+		return mesh;
+	}
+
+	// Rolling terrain 1000 units across with its texture tiled 16 times, the kind of mesh whose
+	// positions and UVs use the most of their range.
+	TestMesh MakeTerrain(const char* name)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.halfFits = true;
+		const uint32_t size = 256;
+		const float extent = 1000.0f;
+		auto height = [](float x, float z) { return 40.0f * sinf(x * 0.013f) * cosf(z * 0.021f) + 7.0f * sinf(x * 0.11f + z * 0.07f); };
+		for (uint32_t row = 0; row <= size; ++row)
+		{
+			for (uint32_t column = 0; column <= size; ++column)
+			{
+				const float x = extent * column / size - extent * 0.5f, z = extent * row / size - extent * 0.5f;
+				const float step = 0.5f;
+				const MeshFloat3 normal = Normalize(height(x - step, z) - height(x + step, z), 2.0f * step, height(x, z - step) - height(x, z + step));
+				mesh.vertices.push_back(MakeVertex(x, height(x, z), z, 16.0f * column / size, 16.0f * row / size, normal));
+			}
+		}
+		AddLatticeIndices(size, size, mesh.indices);
+		return mesh;
+	}
+
+	// Normals in every direction, the axes and the octahedron's folds included, which the
+	// octahedral encoding handles least gracefully; UVs run outside 0 to 1.
+	TestMesh MakeNormalCloud(const char* name, std::mt19937& random)
+	{
+		TestMesh mesh;
+		mesh.name = name;
+		mesh.halfFits = true;
+		const float special[][3] =
+		{
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+			{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 }, { 1, 0, -1 }, { 0, 1, -1 },
+			{ 1, 1, -1 }, { -1, -1, -1 }, { 1e-4f, 0, -1 }, { 0, -1e-4f, -1 },
+		};
+		std::normal_distribution<float> gaussian(0.0f, 1.0f);
+		std::uniform_real_distribution<float> uniform(-3.0f, 5.0f);
+		for (uint32_t i = 0; i < 20000; ++i)
+		{
+			MeshFloat3 normal = i < sizeof(special) / sizeof(special[0]) ? Normalize(special[i][0], special[i][1], special[i][2]) :
+				Normalize(gaussian(random), gaussian(random), gaussian(random));
+			mesh.vertices.push_back(MakeVertex(uniform(random), uniform(random), uniform(random), uniform(random), uniform(random), normal));
+		}
+		return mesh;
+	}
+
+	// Worst errors worked out here, so that MeasurePackingError is checked too.
+	MeshPackingError MeasureError(const std::vector<MeshVertex>& original, const std::vector<MeshVertex>& decoded)
+	{
+		MeshFloat3 minimum = original[0].pos, maximum = original[0].pos;
+		for (const MeshVertex& vertex : original)
+		{
+			minimum.x = std::min(minimum.x, vertex.pos.x);
+			minimum.y = std::min(minimum.y, vertex.pos.y);
+			minimum.z = std::min(minimum.z, vertex.pos.z);
+			maximum.x = std::max(maximum.x, vertex.pos.x);
+			maximum.y = std::max(maximum.y, vertex.pos.y);
+			maximum.z = std::max(maximum.z, vertex.pos.z);
+		}
+		const double diagonal = sqrt(double(maximum.x - minimum.x) * (maximum.x - minimum.x) + double(maximum.y - minimum.y) * (maximum.y - minimum.y) +
+			double(maximum.z - minimum.z) * (maximum.z - minimum.z));
+
+		double position = 0.0, uv = 0.0, degrees = 0.0;
+		for (size_t i = 0; i < original.size(); ++i)
+		{
+			const MeshVertex& a = original[i];
+			const MeshVertex& b = decoded[i];
+			const double dx = double(a.pos.x) - b.pos.x, dy = double(a.pos.y) - b.pos.y, dz = double(a.pos.z) - b.pos.z;
+			position = std::max(position, sqrt(dx * dx + dy * dy + dz * dz));
+			uv = std::max(uv, std::max(fabs(double(a.uv.x) - b.uv.x), fabs(double(a.uv.y) - b.uv.y)));
+			const double dot = double(a.normal.x) * b.normal.x + double(a.normal.y) * b.normal.y + double(a.normal.z) * b.normal.z;
+			const double lengths = sqrt(double(a.normal.x) * a.normal.x + double(a.normal.y) * a.normal.y + double(a.normal.z) * a.normal.z) *
+				sqrt(double(b.normal.x) * b.normal.x + double(b.normal.y) * b.normal.y + double(b.normal.z) * b.normal.z);
+			degrees = std::max(degrees, acos(std::min(1.0, std::max(-1.0, dot / lengths))) * 180.0 / 3.14159265358979);
+		}
+
+		MeshPackingError error = { float(position / diagonal), float(uv), float(degrees) };
+		return error;
+	}
+
+	// Bytes pulled through the 64-byte fetch lines AnalyzeVertexCache models, drawing the mesh once.
+	double GetFetchedBytes(const TestMesh& mesh, uint32_t stride)
+	{
+		const VertexCacheStats stats = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), stride);
+		return double(stats.overfetch) * mesh.vertices.size() * stride;
+	}
+
+	void TestPacking(const TestMesh& mesh)
+	{
+		for (MeshVertexFormat format : kPackedFormats)
+		{
+			const char* formatName = kFormatNames[format];
+			const MeshDecodeConstants decode = ComputeMeshDecodeConstants(format, mesh.vertices.data(), mesh.vertices.size());
+			std::vector<uint8_t> packed(mesh.vertices.size() * GetMeshVertexStride(format));
+			PackMeshVertices(format, decode, mesh.vertices.data(), mesh.vertices.size(), packed.data());
+			std::vector<MeshVertex> decoded(mesh.vertices.size());
+			UnpackMeshVertices(format, decode, packed.data(), mesh.vertices.size(), decoded.data());
+
+			const MeshPackingError error = MeasureError(mesh.vertices, decoded);
+			const MeshPackingError reported = MeasurePackingError(mesh.vertices.data(), decoded.data(), decoded.size());
+			char detail[256];
+			snprintf(detail, sizeof(detail), "\"position\": %.3g, \"uv\": %.3g, \"normalDegrees\": %.4f, \"reported\": { \"position\": %.3g, \"uv\": %.3g, \"normalDegrees\": %.4f }",
+				error.position, error.uv, error.normalDegrees, reported.position, reported.uv, reported.normalDegrees);
+
+			const bool within = error.position <= MESH_PACKING_POSITION_TOLERANCE && error.uv <= MESH_PACKING_UV_TOLERANCE &&
+				error.normalDegrees <= MESH_PACKING_NORMAL_TOLERANCE;
+			if (format == MESH_VERTEX_QUANTIZED || mesh.halfFits)
+				Check(mesh.name, formatName, "round trip within tolerance", within && IsWithinPackingTolerance(reported), detail);
+			else
+				Check(mesh.name, formatName, "out of tolerance, so the importer falls back to float", !within && !IsWithinPackingTolerance(reported), detail);
+
+			// 16-bit UVs, and quantized positions, are rounded to the nearest of 65536 steps across
+			// their range, so they should be off by half a step at most, well inside the tolerance.
+			// A little is allowed for float rounding in the decode.
+			const float uvRange = std::max(decode.uvScaleOffset[0], decode.uvScaleOffset[1]);
+			const bool halfStep = error.uv <= 0.5f / 65535.0f * uvRange * 1.02f &&
+				(format != MESH_VERTEX_QUANTIZED || error.position <= 0.5f / 65535.0f * 1.02f);
+			Check(mesh.name, formatName, "rounds to the nearest 16-bit step", halfStep, detail);
+
+			// Float math in a different order; the two may differ by rounding, not by more. acosf of a
+			// float cosine cannot resolve angles much under 0.03 degrees, so the reported normal error
+			// only has to be no smaller and within that.
+			const bool agrees = fabsf(reported.position - error.position) <= 1e-3f * MESH_PACKING_POSITION_TOLERANCE + 1e-6f * error.position &&
+				fabsf(reported.uv - error.uv) <= 1e-3f * MESH_PACKING_UV_TOLERANCE &&
+				reported.normalDegrees >= error.normalDegrees - 1e-3f && reported.normalDegrees <= error.normalDegrees + 0.05f;
+			Check(mesh.name, formatName, "MeasurePackingError agrees", agrees, detail);
+
+			if (!mesh.indices.empty())
+			{
+				const double floatBytes = GetFetchedBytes(mesh, GetMeshVertexStride(MESH_VERTEX_FLOAT));
+				const double packedBytes = GetFetchedBytes(mesh, GetMeshVertexStride(format));
+				snprintf(detail, sizeof(detail), "\"stride\": %u, \"floatStride\": %u, \"fetchedBytes\": %.0f, \"floatFetchedBytes\": %.0f, \"ratio\": %.3f",
+					GetMeshVertexStride(format), GetMeshVertexStride(MESH_VERTEX_FLOAT), packedBytes, floatBytes, packedBytes / floatBytes);
+				Check(mesh.name, formatName, "fetches half the vertex bytes or less", packedBytes <= 0.5 * floatBytes, detail);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	(void)argv;
+	if (argc != 1)
+	{
+		fprintf(stderr, "usage: MeshPackingTest\n");
+		return 2;
+	}
+
+	std::mt19937 random(2024);
+	std::vector<TestMesh> meshes;
+	meshes.push_back(MakeSphere("unit sphere", 1.0f, 0.0f, 0.0f, 0.0f, true));
+	meshes.push_back(MakeTerrain("terrain 1000 units"));
+	meshes.push_back(MakeNormalCloud("normal cloud", random));
+	// Half floats are spaced 4 units apart at 5000, far beyond a 2 unit sphere's tolerance;
+	// quantizing to its bounds does not care where it is.
+	meshes.push_back(MakeSphere("sphere far from the origin", 2.0f, 5000.0f, -5000.0f, 5000.0f, false));
+
+	printf("{\n\t\"checks\": [\n");
+	for (const TestMesh& mesh : meshes)
+		TestPacking(mesh);
+	printf("\n\t],\n\t\"failures\": %u\n}\n", g_failures);
+	return g_failures ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+﻿// Builds the full mip chain of an 8 bit RGBA DDS texture, 2D, array or cube map, and writes it as
+// a new DDS file, then prints JSON with the time taken and how a small texture cache fares when
+// the texture is drawn minified with and without the mips. It builds anywhere the generator does, e.g.
+//
+//   g++ -std=c++14 -O2 -IDX11UWA -o MipGen Tools/MipGen/MipGen.cpp
+//       DX11UWA/Common/{MipGenerator,DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: MipGen [--filter box|kaiser] [--mips count] [--linear] [--wrap] input.dds output.dds
+// The default filter is kaiser and the default count the full chain. Colour is filtered as light,
+// since this project's UNORM textures hold sRGB authored colour; --linear filters the stored
+// values instead, for normal maps and other data. --wrap filters across opposite edges of tiling
+// textures. The input may be gzip or zstd compressed. The exit code is 1 when the input cannot be
+// read or filtered or the output written, and 2 for bad arguments.
+
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+#include "Common/MipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kFilterNames[MIP_FILTER_COUNT] = { "box", "kaiser" };
+	const uint32_t kCacheLineBytes = 64;
+	const uint32_t kCacheSets = 64;
+	const uint32_t kCacheWays = 4;	// 16 KB, about a texture unit's L1
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	// Set associative, least recently used within each set.
+	class CacheSim
+	{
+	public:
+		CacheSim(void) :
+			m_tags(kCacheSets * kCacheWays, UINT64_MAX),
+			m_used(kCacheSets * kCacheWays, 0),
+			m_clock(0),
+			m_hits(0),
+			m_misses(0)
+		{
+		}
+
+		void Access(uint64_t address)
+		{
+			const uint64_t line = address / kCacheLineBytes;
+			const size_t set = static_cast<size_t>(line % kCacheSets) * kCacheWays;
+			size_t victim = set;
+			++m_clock;
+			for (size_t way = set; way < set + kCacheWays; ++way)
+			{
+				if (m_tags[way] == line)
+				{
+					m_used[way] = m_clock;
+					++m_hits;
+					return;
+				}
+				victim = m_used[way] < m_used[victim] ? way : victim;
+			}
+			m_tags[victim] = line;
+			m_used[victim] = m_clock;
+			++m_misses;
+		}
+
+		uint64_t GetMisses(void) const	{ return m_misses; }
+		double GetHitRate(void) const	{ return m_hits + m_misses ? static_cast<double>(m_hits) / (m_hits + m_misses) : 0.0; }
+
+	private:
+		std::vector<uint64_t>	m_tags;
+		std::vector<uint64_t>	m_used;
+		uint64_t				m_clock;
+		uint64_t				m_hits;
+		uint64_t				m_misses;
+	};
+
+	// Draws slice 0 on a quad scale times smaller than mip 0, a bilinear sample a pixel in
+	// scanline order, from the mip a GPU would pick, or from mip 0 when mipCount is 1.
+	void SimulateMinified(const std::vector<DDSSubresource>& layout, uint32_t mipCount, uint32_t scale, CacheSim& cache)
+	{
+		uint32_t level = 0;
+		while (level + 1 < mipCount && (1u << (level + 1)) <= scale)
+			++level;
+
+		const DDSSubresource& mip = layout[level];
+		const uint32_t width = std::max<uint32_t>(layout[0].width / scale, 1);
+		const uint32_t height = std::max<uint32_t>(layout[0].height / scale, 1);
+		for (uint32_t py = 0; py < height; ++py)
+		{
+			const float v = (py + 0.5f) / height * mip.height - 0.5f;
+			const uint32_t y0 = static_cast<uint32_t>(std::max(v, 0.0f));
+			const uint32_t y1 = std::min(y0 + 1, mip.height - 1);
+			for (uint32_t px = 0; px < width; ++px)
+			{
+				const float u = (px + 0.5f) / width * mip.width - 0.5f;
+				const uint32_t x0 = static_cast<uint32_t>(std::max(u, 0.0f));
+				const uint32_t x1 = std::min(x0 + 1, mip.width - 1);
+				cache.Access(mip.offset + static_cast<uint64_t>(y0) * mip.rowBytes + x0 * 4);
+				cache.Access(mip.offset + static_cast<uint64_t>(y0) * mip.rowBytes + x1 * 4);
+				cache.Access(mip.offset + static_cast<uint64_t>(y1) * mip.rowBytes + x0 * 4);
+				cache.Access(mip.offset + static_cast<uint64_t>(y1) * mip.rowBytes + x1 * 4);
+			}
+		}
+	}
+
+	// The whole file, decompressed when it is gzip or zstd.
+	bool ReadTexture(const char* path, MappedFile& file, std::vector<uint8_t>& decompressed, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+
+		outData = file.GetData();
+		outSize = static_cast<size_t>(file.GetSize());
+		if (DetectCompression(outData, outSize) == COMPRESSION_NONE)
+			return true;
+
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(outData, outSize) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK || desc.dataSize > SIZE_MAX - desc.headerSize)
+			return false;
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return false;
+		outData = decompressed.data();
+		outSize = decompressed.size();
+		return true;
+	}
+
+	bool WriteTexture(const char* path, const uint8_t* header, uint32_t headerSize, const std::vector<uint8_t>& bits)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(bits.data(), 1, bits.size(), file) == bits.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: MipGen [--filter box|kaiser] [--mips count] [--linear] [--wrap] input.dds output.dds\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	MipOptions options;
+	options.filter = MIP_FILTER_KAISER;
+	options.mipCount = 0;
+	options.gammaCorrect = true;
+	options.wrap = false;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			options.filter = MIP_FILTER_COUNT;
+			for (int f = 0; f < MIP_FILTER_COUNT; ++f)
+				options.filter = strcmp(name, kFilterNames[f]) == 0 ? static_cast<MipFilter>(f) : options.filter;
+			if (options.filter == MIP_FILTER_COUNT)
+				return Usage();
+		}
+		else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			options.mipCount = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--linear") == 0)
+		{
+			options.gammaCorrect = false;
+		}
+		else if (strcmp(argv[i], "--wrap") == 0)
+		{
+			options.wrap = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2)
+		return Usage();
+
+	MappedFile file;
+	std::vector<uint8_t> decompressed;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	DDSTextureDesc desc;
+	if (!ReadTexture(paths[0], file, decompressed, data, size) || ValidateDDS(data, size, desc) != DDS_OK)
+		return Fail(paths[0], "not a valid texture");
+
+	DDSTextureDesc outDesc;
+	std::vector<uint8_t> bits;
+	const auto start = std::chrono::steady_clock::now();
+	if (GenerateMipChain(desc, data + desc.headerSize, options, outDesc, bits) != DDS_OK)
+		return Fail(paths[0], "not an 8 bit RGBA 2D texture");
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint8_t header[DDS_MAX_HEADER_SIZE];
+	const uint32_t headerSize = WriteDDSHeader(outDesc, header);
+	if (!WriteTexture(paths[1], header, headerSize, bits))
+		return Fail(paths[1], "could not write");
+
+	printf("{\n\t\"input\": %s, \"output\": %s,\n", JsonString(paths[0]).c_str(), JsonString(paths[1]).c_str());
+	printf("\t\"filter\": \"%s\", \"gammaCorrect\": %s, \"wrap\": %s, \"width\": %u, \"height\": %u, \"arraySize\": %u, \"cube\": %s,\n",
+		kFilterNames[options.filter], options.gammaCorrect ? "true" : "false", options.wrap && !desc.isCubeMap ? "true" : "false", desc.width, desc.height,
+		desc.arraySize, desc.isCubeMap ? "true" : "false");
+	printf("\t\"mips\": %u, \"inputBytes\": %llu, \"outputBytes\": %llu, \"seconds\": %.6f, \"megapixelsPerSecond\": %.2f,\n",
+		outDesc.mipCount, static_cast<unsigned long long>(desc.dataSize), static_cast<unsigned long long>(outDesc.dataSize), seconds,
+		seconds > 0.0 ? static_cast<double>(desc.width) * desc.height * desc.arraySize / seconds / 1e6 : 0.0);
+
+	std::vector<DDSSubresource> layout(static_cast<size_t>(outDesc.mipCount) * outDesc.arraySize);
+	ComputeDDSLayout(outDesc, layout.data());
+	printf("\t\"minified\": [\n");
+	for (uint32_t scale = 2; scale <= 16; scale *= 2)
+	{
+		CacheSim base;
+		CacheSim mipped;
+		SimulateMinified(layout, 1, scale, base);
+		SimulateMinified(layout, outDesc.mipCount, scale, mipped);
+		printf("\t\t{ \"scale\": %u, \"hitRateWithoutMips\": %.4f, \"hitRateWithMips\": %.4f, \"missesWithoutMips\": %llu, \"missesWithMips\": %llu }%s\n",
+			scale, base.GetHitRate(), mipped.GetHitRate(), static_cast<unsigned long long>(base.GetMisses()),
+			static_cast<unsigned long long>(mipped.GetMisses()), scale < 16 ? "," : "");
+	}
+	printf("\t]\n}\n");
+	return 0;
+}
@@ -0,0 +1,334 @@
+﻿// Replays a simulated access trace against the renderer's residency policy and prints JSON, so
+// budget and policy changes can be checked without a D3D device. It builds anywhere the policy's
+// portable half does, e.g.
+//
+//   g++ -std=c++14 -O2 -IDX11UWA -o ResidencySim Tools/ResidencySim/ResidencySim.cpp
+//       DX11UWA/Common/{ResidencyManager,DDSFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: ResidencySim [--frames count] [--budget percent] [--restores count] [--seed value]
+// The scene is a grid of regions, each with its own textures and meshes plus a few shared by all,
+// and a camera that wanders from region to region: the region it is in is drawn at full detail
+// and its neighbours at coarser mips and LODs. The trace is replayed twice under a budget of the
+// given percent of the scene, default 40: once with every level the assets have and once with
+// eviction alone, as a plain LRU would. Along the way the policy's accounting and changes are
+// checked against a copy kept here; the exit code is 1 when they ever disagree and 2 for bad arguments.
+
+#include "Common/DDSFile.h"
+#include "Common/ResidencyManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t kGridSize = 8;
+	const uint32_t kTexturesPerRegion = 6;
+	const uint32_t kMeshesPerRegion = 4;
+	const uint32_t kSharedTextures = 8;
+	const uint32_t kFramesPerStep = 90;
+	const size_t kSmallestMip = 64;		// as TextureStreamer keeps loaded
+
+	struct SimAsset
+	{
+		std::vector<uint64_t>	levelBytes;
+		ResidencyKind			kind;
+		ResidencyPolicy			policy;
+		uint32_t				handle;
+		uint32_t				level;		// as the changes applied so far leave it
+	};
+
+	// The drawn assets of one region: each mesh is its vertex and index buffer, textures stand alone.
+	struct Region
+	{
+		std::vector<uint32_t>	textures;
+		std::vector<uint32_t>	vertexBuffers;
+		std::vector<uint32_t>	indexBuffers;
+	};
+
+	struct Scene
+	{
+		std::vector<SimAsset>	assets;
+		std::vector<Region>		regions;
+		std::vector<uint32_t>	shared;		// textures every region draws
+		std::vector<uint32_t>	pinned;		// render targets, drawn every frame
+		uint64_t				fullBytes;
+	};
+
+	struct SimResult
+	{
+		ResidencyStats	stats;
+		uint64_t		uses;
+		uint64_t		hits;			// uses already at the level they asked for
+		uint64_t		evictedUses;	// uses of assets with nothing resident
+		uint64_t		mismatches;
+		double			seconds;
+	};
+
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// Levels of a block compressed texture, from all of its mips down to the ones TextureStreamer
+	// keeps when it drops the rest.
+	void AddTexture(Scene& scene, uint32_t& random)
+	{
+		DDSTextureDesc desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.dimension = DDS_DIMENSION_TEXTURE2D;
+		desc.format = (NextRandom(random) & 1) ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC7_UNORM;
+		desc.width = 256u << (NextRandom(random) % 4);
+		desc.height = desc.width >> (NextRandom(random) % 2);
+		desc.depth = 1;
+		desc.arraySize = 1;
+		desc.mipCount = 1;
+		while ((std::max(desc.width, desc.height) >> desc.mipCount) > 0)
+			desc.mipCount++;
+		desc.dataSize = ComputeDDSLayout(desc, nullptr);
+
+		SimAsset asset = {};
+		asset.kind = RESIDENCY_TEXTURE;
+		asset.policy = RESIDENCY_KEEP_SMALLEST;
+		const uint32_t smallest = GetDDSSkipMips(desc, kSmallestMip);
+		for (uint32_t skip = 0; skip <= smallest; ++skip)
+			asset.levelBytes.push_back(GetDDSLoadedSize(desc, skip));
+		scene.assets.push_back(asset);
+	}
+
+	// A mesh's vertex buffer and its index buffer, whose LODs each have about half the triangles
+	// of the one before and are laid out finest first, so a level keeps the LODs from it on.
+	void AddMesh(Scene& scene, Region& region, uint32_t& random)
+	{
+		const uint64_t vertexCount = 4096 + NextRandom(random) % 60000;
+		SimAsset vertices = {};
+		vertices.kind = RESIDENCY_VERTEX_BUFFER;
+		vertices.policy = RESIDENCY_EVICTABLE;
+		vertices.levelBytes.push_back(vertexCount * 16);
+		region.vertexBuffers.push_back(static_cast<uint32_t>(scene.assets.size()));
+		scene.assets.push_back(vertices);
+
+		std::vector<uint64_t> lodBytes;
+		for (uint64_t indices = vertexCount * 6; lodBytes.size() < 4 && indices >= 384; indices /= 2)
+			lodBytes.push_back(indices * 2);
+		SimAsset indices = {};
+		indices.kind = RESIDENCY_INDEX_BUFFER;
+		indices.policy = RESIDENCY_EVICTABLE;
+		for (size_t level = 0; level < lodBytes.size(); ++level)
+		{
+			uint64_t bytes = 0;
+			for (size_t lod = level; lod < lodBytes.size(); ++lod)
+				bytes += lodBytes[lod];
+			indices.levelBytes.push_back(bytes);
+		}
+		region.indexBuffers.push_back(static_cast<uint32_t>(scene.assets.size()));
+		scene.assets.push_back(indices);
+	}
+
+	void BuildScene(Scene& scene, uint32_t seed)
+	{
+		uint32_t random = seed;
+		scene.regions.resize(kGridSize * kGridSize);
+		for (Region& region : scene.regions)
+		{
+			for (uint32_t i = 0; i < kTexturesPerRegion; ++i)
+			{
+				region.textures.push_back(static_cast<uint32_t>(scene.assets.size()));
+				AddTexture(scene, random);
+			}
+			for (uint32_t i = 0; i < kMeshesPerRegion; ++i)
+				AddMesh(scene, region, random);
+		}
+		for (uint32_t i = 0; i < kSharedTextures; ++i)
+		{
+			scene.shared.push_back(static_cast<uint32_t>(scene.assets.size()));
+			AddTexture(scene, random);
+		}
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			SimAsset target = {};
+			target.kind = RESIDENCY_RENDER_TARGET;
+			target.policy = RESIDENCY_PINNED;
+			target.levelBytes.push_back(1920ull * 1080 * 4);
+			scene.pinned.push_back(static_cast<uint32_t>(scene.assets.size()));
+			scene.assets.push_back(target);
+		}
+
+		scene.fullBytes = 0;
+		for (const SimAsset& asset : scene.assets)
+			scene.fullBytes += asset.levelBytes[0];
+	}
+
+	void Use(ResidencyManager& manager, Scene& scene, SimResult& result, uint32_t asset, uint32_t level)
+	{
+		SimAsset& sim = scene.assets[asset];
+		level = std::min(level, static_cast<uint32_t>(sim.levelBytes.size() - 1));
+		manager.MarkUsed(sim.handle, level);
+		result.uses++;
+		result.hits += sim.level <= level ? 1 : 0;
+		result.evictedUses += sim.level == RESIDENCY_EVICTED ? 1 : 0;
+	}
+
+	void DrawRegion(ResidencyManager& manager, Scene& scene, SimResult& result, const Region& region, uint32_t level)
+	{
+		for (uint32_t texture : region.textures)
+			Use(manager, scene, result, texture, level);
+		for (size_t mesh = 0; mesh < region.vertexBuffers.size(); ++mesh)
+		{
+			Use(manager, scene, result, region.vertexBuffers[mesh], 0);
+			Use(manager, scene, result, region.indexBuffers[mesh], level);
+		}
+	}
+
+	// Applies the changes to the copy of each asset's level and checks them and the policy's
+	// accounting against it. Returns the number of disagreements.
+	uint64_t CheckUpdate(const ResidencyManager& manager, Scene& scene, const std::vector<ResidencyChange>& changes, const std::vector<uint32_t>& handleAssets)
+	{
+		uint64_t mismatches = 0;
+		for (const ResidencyChange& change : changes)
+		{
+			SimAsset& sim = scene.assets[handleAssets[change.asset]];
+			if (sim.policy == RESIDENCY_PINNED || (sim.policy == RESIDENCY_KEEP_SMALLEST && change.level == RESIDENCY_EVICTED) || change.level == sim.level || (change.level != RESIDENCY_EVICTED && change.level >= sim.levelBytes.size()))
+				mismatches++;
+			sim.level = change.level;
+		}
+
+		uint64_t resident = 0;
+		for (const SimAsset& sim : scene.assets)
+		{
+			mismatches += manager.GetLevel(sim.handle) != sim.level ? 1 : 0;
+			resident += sim.level == RESIDENCY_EVICTED ? 0 : sim.levelBytes[sim.level];
+		}
+		mismatches += resident != manager.GetResidentBytes() ? 1 : 0;
+		return mismatches;
+	}
+
+	// Walks the camera over the grid for frameCount frames, a step to a random neighbouring region
+	// every kFramesPerStep, and replays what each frame draws.
+	SimResult Replay(Scene& scene, uint64_t budget, uint32_t maxRestores, uint32_t frameCount, uint32_t seed, bool useLevels)
+	{
+		SimResult result;
+		memset(&result, 0, sizeof(result));
+		ResidencyManager manager;
+		manager.Reset(budget, maxRestores);
+		std::vector<uint32_t> handleAssets(scene.assets.size());
+		for (uint32_t a = 0; a < scene.assets.size(); ++a)
+		{
+			SimAsset& sim = scene.assets[a];
+			if (!useLevels)
+			{
+				sim.levelBytes.resize(1);
+				sim.policy = sim.policy == RESIDENCY_PINNED ? RESIDENCY_PINNED : RESIDENCY_EVICTABLE;
+			}
+			sim.handle = manager.Register(sim.kind, sim.levelBytes.data(), static_cast<uint32_t>(sim.levelBytes.size()), sim.policy);
+			sim.level = 0;
+			handleAssets[sim.handle] = a;
+		}
+
+		uint32_t random = seed;
+		uint32_t x = kGridSize / 2;
+		uint32_t y = kGridSize / 2;
+		std::vector<ResidencyChange> changes;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			if (frame > 0 && frame % kFramesPerStep == 0)
+			{
+				const uint32_t direction = NextRandom(random) % 4;
+				x = direction == 0 ? std::min(x + 1, kGridSize - 1) : direction == 1 && x > 0 ? x - 1 : x;
+				y = direction == 2 ? std::min(y + 1, kGridSize - 1) : direction == 3 && y > 0 ? y - 1 : y;
+			}
+
+			DrawRegion(manager, scene, result, scene.regions[y * kGridSize + x], 0);
+			for (uint32_t dy = y > 0 ? y - 1 : 0; dy <= std::min(y + 1, kGridSize - 1); ++dy)
+			{
+				for (uint32_t dx = x > 0 ? x - 1 : 0; dx <= std::min(x + 1, kGridSize - 1); ++dx)
+				{
+					if (dx != x || dy != y)
+						DrawRegion(manager, scene, result, scene.regions[dy * kGridSize + dx], dx != x && dy != y ? 3 : 2);
+				}
+			}
+			for (uint32_t texture : scene.shared)
+				Use(manager, scene, result, texture, 1);
+			for (uint32_t target : scene.pinned)
+				Use(manager, scene, result, target, 0);
+
+			manager.Update(changes);
+			result.mismatches += CheckUpdate(manager, scene, changes, handleAssets);
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.stats = manager.GetStats();
+		return result;
+	}
+
+	void PrintResult(const char* name, const SimResult& result, bool last)
+	{
+		const ResidencyStats& stats = result.stats;
+		printf("\t\"%s\": { \"hitRate\": %.4f, \"evictedUses\": %llu, \"peakBytes\": %llu, \"overBudgetUpdates\": %u,\n", name,
+			result.uses ? static_cast<double>(result.hits) / result.uses : 1.0, static_cast<unsigned long long>(result.evictedUses),
+			static_cast<unsigned long long>(stats.peakBytes), stats.overBudgetUpdates);
+		printf("\t\t\"reductions\": %llu, \"evictions\": %llu, \"restores\": %llu, \"restoredBytes\": %llu, \"missedRestores\": %llu,\n",
+			static_cast<unsigned long long>(stats.reductions), static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.restores),
+			static_cast<unsigned long long>(stats.restoredBytes), static_cast<unsigned long long>(stats.missedRestores));
+		printf("\t\t\"residentBytes\": { \"vertexBuffers\": %llu, \"indexBuffers\": %llu, \"textures\": %llu, \"renderTargets\": %llu },\n",
+			static_cast<unsigned long long>(stats.kindBytes[RESIDENCY_VERTEX_BUFFER]), static_cast<unsigned long long>(stats.kindBytes[RESIDENCY_INDEX_BUFFER]),
+			static_cast<unsigned long long>(stats.kindBytes[RESIDENCY_TEXTURE]), static_cast<unsigned long long>(stats.kindBytes[RESIDENCY_RENDER_TARGET]));
+		printf("\t\t\"mismatches\": %llu, \"seconds\": %.6f, \"updatesPerSecond\": %.0f }%s\n", static_cast<unsigned long long>(result.mismatches),
+			result.seconds, result.seconds > 0.0 ? stats.updateCount / result.seconds : 0.0, last ? "" : ",");
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: ResidencySim [--frames count] [--budget percent] [--restores count] [--seed value]\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	long frames = 20000;
+	long budgetPercent = 40;
+	long restores = 8;
+	long seed = 0x2545F491;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+			return Usage();
+		const long value = strtol(argv[i + 1], nullptr, 10);
+		if (strcmp(argv[i], "--frames") == 0 && value > 0)
+			frames = value;
+		else if (strcmp(argv[i], "--budget") == 0 && value > 0 && value <= 100)
+			budgetPercent = value;
+		else if (strcmp(argv[i], "--restores") == 0 && value > 0)
+			restores = value;
+		else if (strcmp(argv[i], "--seed") == 0 && value != 0)
+			seed = value;
+		else
+			return Usage();
+		++i;
+	}
+
+	Scene scene;
+	BuildScene(scene, static_cast<uint32_t>(seed));
+	const uint64_t budget = scene.fullBytes * static_cast<uint64_t>(budgetPercent) / 100;
+	SimResult levels = Replay(scene, budget, static_cast<uint32_t>(restores), static_cast<uint32_t>(frames), static_cast<uint32_t>(seed), true);
+	SimResult evictOnly = Replay(scene, budget, static_cast<uint32_t>(restores), static_cast<uint32_t>(frames), static_cast<uint32_t>(seed), false);
+
+	printf("{\n\t\"scene\": { \"assets\": %u, \"regions\": %u, \"fullBytes\": %llu, \"budgetBytes\": %llu, \"frames\": %ld },\n",
+		static_cast<uint32_t>(scene.assets.size()), static_cast<uint32_t>(scene.regions.size()), static_cast<unsigned long long>(scene.fullBytes),
+		static_cast<unsigned long long>(budget), frames);
+	PrintResult("levels", levels, false);
+	PrintResult("evictOnly", evictOnly, true);
+	printf("}\n");
+	return levels.mismatches == 0 && evictOnly.mismatches == 0 ? 0 : 1;
+}
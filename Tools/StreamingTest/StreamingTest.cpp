@@ -0,0 +1,350 @@
+﻿// Memory check for mesh streaming: writes a large generated terrain OBJ to disk, converts it to
+// a chunk file with ImportObjChunked under an import budget, then flies a camera over it while a
+// MeshChunkPager keeps chunks resident under a resident budget, reading and releasing them as the
+// renderer's scan streaming does. It checks that the process's peak memory stays under each cap,
+// that the chunk file holds every triangle and that every chunk read back is well formed. It
+// needs no GPU and builds anywhere the import code does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o StreamingTest Tools/StreamingTest/StreamingTest.cpp
+//       DX11UWA/Content/{MeshStreaming,MeshCache,MeshPacking,MeshOptimizer,ObjLoader,IndexCodec,MeshSimplifier,MeshClusters}.cpp
+//       DX11UWA/Common/{MappedFile,LinearArena,FileIO,CompressedFile,ProcessMemory}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: StreamingTest [--size megabytes] [--budget megabytes] [--resident megabytes] [--frames count] [--path prefix]
+// The OBJ is about --size megabytes, 256 by default. The import may hold --budget megabytes, 64
+// by default and at least 32, and the pager --resident megabytes, 16 by default, which is less
+// than the chunks of the default OBJ so that the pager has to evict. The flight lasts --frames
+// frames, 600 by default. Files are written as prefix.obj and prefix.chunks, StreamingTest
+// in the working directory by default, and removed at the end. Memory is measured from the
+// process's usage once the OBJ is written, with kSlackBytes allowed for what the allocator keeps
+// back, and is only checked where QueryProcessMemory reports it. Prints JSON with every check.
+// The exit code is 1 when any check fails or a file cannot be written or imported, and 2 for bad
+// arguments.
+
+#include "Common/FileIO.h"
+#include "Common/ProcessMemory.h"
+#include "Content/MeshStreaming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX11UWA;
+
+namespace
+{
+	const float kPi = 3.14159265f;
+	// Room on top of a cap for freed memory the allocator has not returned yet and buffers
+	// outside the streaming code, such as stdio's.
+	const uint64_t kSlackBytes = 8ull << 20;
+	// Grid columns of the generated terrain; its rows grow with --size.
+	const uint32_t kTerrainWidth = 1024;
+	const uint32_t kLoadsPerFrame = 4;
+
+	bool g_firstCheck = true;
+	unsigned int g_failures = 0;
+
+	void Check(const char* name, bool passed, const std::string& detail)
+	{
+		printf("%s\t\t{ \"check\": \"%s\", \"passed\": %s%s%s }", g_firstCheck ? "" : ",\n", name, passed ? "true" : "false",
+			detail.empty() ? "" : ", ", detail.c_str());
+		g_firstCheck = false;
+		g_failures += passed ? 0 : 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: StreamingTest [--size megabytes] [--budget megabytes] [--resident megabytes] [--frames count] [--path prefix]\n");
+		return 2;
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("\n\t],\n\t\"path\": \"%s\", \"error\": \"%s\"\n}\n", path, error);
+		return 1;
+	}
+
+	double Megabytes(uint64_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	float TerrainHeight(float x, float z)
+	{
+		return 8.0f * sinf(x * 0.013f) * cosf(z * 0.011f) + 2.0f * sinf(x * 0.071f + z * 0.053f);
+	}
+
+	// Writes rows of a terrain one unit apart, each row's faces after its vertices, until the file
+	// reaches targetBytes. Only a line is held at a time. Returns the number of triangles.
+	uint64_t WriteTerrainObj(const char* path, uint64_t targetBytes)
+	{
+		FILE* file = DX::OpenFile(path, "wb");
+		if (!file)
+			return 0;
+		char line[256];
+		uint64_t bytes = 0;
+		uint64_t triangles = 0;
+		bool written = true;
+		for (uint32_t row = 0; written && (row < 2 || bytes < targetBytes); ++row)
+		{
+			for (uint32_t column = 0; column < kTerrainWidth && written; ++column)
+			{
+				const float x = float(column), z = float(row);
+				int length = snprintf(line, sizeof(line), "v %.3f %.3f %.3f\nvt %.4f %.4f\nvn 0 1 0\n", x, TerrainHeight(x, z), z,
+					x / kTerrainWidth, z / kTerrainWidth);
+				written = length > 0 && length < static_cast<int>(sizeof(line)) && fwrite(line, 1, length, file) == static_cast<size_t>(length);
+				bytes += length;
+			}
+			if (row == 0)
+				continue;
+
+			// OBJ indices count from 1, and every vertex has a uv and normal of the same number.
+			const uint64_t above = static_cast<uint64_t>(row - 1) * kTerrainWidth + 1;
+			const uint64_t below = above + kTerrainWidth;
+			for (uint32_t column = 0; column + 1 < kTerrainWidth && written; ++column)
+			{
+				const unsigned long long a = above + column, b = a + 1, c = below + column, d = c + 1;
+				int length = snprintf(line, sizeof(line), "f %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\nf %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\n",
+					a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+				written = length > 0 && length < static_cast<int>(sizeof(line)) && fwrite(line, 1, length, file) == static_cast<size_t>(length);
+				bytes += length;
+				triangles += 2;
+			}
+		}
+		written = (fclose(file) == 0) && written;
+		return written ? triangles : 0;
+	}
+
+	// Row-major view * projection for row vectors, as DirectXMath's LookAtLH and
+	// PerspectiveFovLH build them.
+	void BuildViewProjection(const MeshFloat3& eye, const MeshFloat3& at, float m[16])
+	{
+		MeshFloat3 z = { at.x - eye.x, at.y - eye.y, at.z - eye.z };
+		float length = sqrtf(z.x * z.x + z.y * z.y + z.z * z.z);
+		z.x /= length;
+		z.y /= length;
+		z.z /= length;
+		MeshFloat3 x = { z.z, 0.0f, -z.x };		// up (0, 1, 0) crossed with z
+		length = sqrtf(x.x * x.x + x.z * x.z);
+		x.x /= length;
+		x.z /= length;
+		const MeshFloat3 y = { z.y * x.z - z.z * x.y, z.z * x.x - z.x * x.z, z.x * x.y - z.y * x.x };
+		const float view[16] =
+		{
+			x.x, y.x, z.x, 0.0f,
+			x.y, y.y, z.y, 0.0f,
+			x.z, y.z, z.z, 0.0f,
+			-(x.x * eye.x + x.y * eye.y + x.z * eye.z), -(y.x * eye.x + y.y * eye.y + y.z * eye.z), -(z.x * eye.x + z.y * eye.y + z.z * eye.z), 1.0f
+		};
+		const float nearZ = 0.1f, farZ = 400.0f;
+		const float h = 1.0f / tanf(kPi / 6.0f);
+		const float q = farZ / (farZ - nearZ);
+		const float projection[16] =
+		{
+			h * 9.0f / 16.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, h, 0.0f, 0.0f,
+			0.0f, 0.0f, q, 1.0f,
+			0.0f, 0.0f, -q * nearZ, 0.0f
+		};
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				m[r * 4 + c] = 0.0f;
+				for (int k = 0; k < 4; ++k)
+					m[r * 4 + c] += view[r * 4 + k] * projection[k * 4 + c];
+			}
+		}
+	}
+
+	// Whether a chunk read back is one the renderer could draw: indices in range for its size.
+	bool ChunkWellFormed(const MeshChunk& chunk, const std::vector<uint8_t>& indices)
+	{
+		for (uint32_t i = 0; i < chunk.indexCount; ++i)
+		{
+			uint32_t index;
+			if (chunk.indexSize == 2)
+			{
+				uint16_t narrow;
+				memcpy(&narrow, &indices[i * 2], sizeof(narrow));
+				index = narrow;
+			}
+			else
+			{
+				memcpy(&index, &indices[i * 4], sizeof(index));
+			}
+			if (index >= chunk.vertexCount)
+				return false;
+		}
+		return chunk.indexCount % 3 == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t sizeMegabytes = 256;
+	uint64_t budgetMegabytes = 64;
+	uint64_t residentMegabytes = 16;
+	uint32_t frameCount = 600;
+	std::string prefix = "StreamingTest";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+			return Usage();
+		const char* option = argv[i];
+		const char* argument = argv[++i];
+		if (strcmp(option, "--path") == 0)
+		{
+			prefix = argument;
+			continue;
+		}
+		const long value = strtol(argument, nullptr, 10);
+		if (value <= 0)
+			return Usage();
+		if (strcmp(option, "--size") == 0)
+			sizeMegabytes = static_cast<uint64_t>(value);
+		else if (strcmp(option, "--budget") == 0)
+			budgetMegabytes = static_cast<uint64_t>(value);
+		else if (strcmp(option, "--resident") == 0)
+			residentMegabytes = static_cast<uint64_t>(value);
+		else if (strcmp(option, "--frames") == 0)
+			frameCount = static_cast<uint32_t>(value);
+		else
+			return Usage();
+	}
+	const uint64_t budgetBytes = budgetMegabytes << 20;
+	const uint64_t residentBytes = residentMegabytes << 20;
+	if (budgetBytes < MESH_STREAMING_MIN_BUDGET)
+		return Usage();
+	const std::string objPath = prefix + ".obj";
+	const std::string chunkPath = prefix + ".chunks";
+
+	printf("{\n\t\"checks\": [\n");
+	const auto writeStart = std::chrono::steady_clock::now();
+	const uint64_t triangleCount = WriteTerrainObj(objPath.c_str(), sizeMegabytes << 20);
+	if (triangleCount == 0)
+	{
+		DX::RemoveFile(objPath.c_str());
+		return Fail(objPath.c_str(), "could not write");
+	}
+	const double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+
+	// Everything the process holds from here on is the import's and then the streaming's.
+	DX::ProcessMemory baseline;
+	const bool measured = DX::QueryProcessMemory(baseline) && baseline.peakBytes != 0;
+
+	MeshStreamingStats stats;
+	MeshChunkFile chunkFile;
+	const auto importStart = std::chrono::steady_clock::now();
+	const bool imported = OpenObjChunked(objPath.c_str(), chunkPath.c_str(), MESH_VERTEX_QUANTIZED, chunkFile, budgetBytes, &stats);
+	const double importSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - importStart).count();
+	DX::RemoveFile(objPath.c_str());
+	if (!imported)
+	{
+		DX::RemoveFile(chunkPath.c_str());
+		return Fail(objPath.c_str(), "could not be imported");
+	}
+	DX::ProcessMemory afterImport;
+	DX::QueryProcessMemory(afterImport);
+
+	char detail[512];
+	snprintf(detail, sizeof(detail), "\"objMegabytes\": %.1f, \"triangles\": %llu, \"chunks\": %u, \"spillFlushes\": %u, \"budgetMegabytes\": %llu, "
+		"\"bufferMegabytes\": %.1f, \"writeSeconds\": %.2f, \"importSeconds\": %.2f", Megabytes(stats.sourceBytes), static_cast<unsigned long long>(stats.triangleCount),
+		stats.chunkCount, stats.spillFlushes, static_cast<unsigned long long>(budgetMegabytes), Megabytes(stats.bufferBytes), writeSeconds, importSeconds);
+	Check("import buffers stay under the budget", stats.bufferBytes <= budgetBytes, detail);
+	if (measured)
+	{
+		// The peak before the import is the generator's, well under any budget, so the peak after
+		// it over the usage before it is the import's.
+		const uint64_t importPeak = afterImport.peakBytes > baseline.currentBytes ? afterImport.peakBytes - baseline.currentBytes : 0;
+		snprintf(detail, sizeof(detail), "\"baselineMegabytes\": %.1f, \"peakMegabytes\": %.1f, \"capMegabytes\": %.1f", Megabytes(baseline.currentBytes),
+			Megabytes(importPeak), Megabytes(budgetBytes + kSlackBytes));
+		Check("import peak memory stays under the budget", importPeak <= budgetBytes + kSlackBytes, detail);
+	}
+	snprintf(detail, sizeof(detail), "\"written\": %llu, \"chunked\": %llu", static_cast<unsigned long long>(triangleCount),
+		static_cast<unsigned long long>(chunkFile.GetTriangleCount()));
+	uint64_t chunkTriangles = 0;
+	for (uint32_t c = 0; c < chunkFile.GetChunkCount(); ++c)
+		chunkTriangles += chunkFile.GetChunk(c).indexCount / 3;
+	Check("chunk file holds every triangle", chunkFile.GetTriangleCount() == triangleCount && chunkTriangles == triangleCount, detail);
+
+	// Fly low along the terrain and back, looking ahead and down, loading what the pager asks for.
+	MeshChunkPager pager;
+	pager.Reset(chunkFile.GetChunks(), chunkFile.GetChunkCount(), residentBytes, kLoadsPerFrame);
+	std::vector<std::vector<uint8_t>> vertexData(chunkFile.GetChunkCount());
+	std::vector<std::vector<uint8_t>> indexData(chunkFile.GetChunkCount());
+	std::vector<uint32_t> loads;
+	std::vector<uint32_t> evictions;
+	const MeshBounds& bounds = chunkFile.GetBounds();
+	uint64_t heldBytes = 0;
+	uint64_t peakHeld = 0;
+	uint64_t peakResident = 0;
+	uint64_t peakStreaming = 0;
+	uint64_t loadCount = 0;
+	uint64_t evictionCount = 0;
+	uint64_t chunkBytes = 0;
+	for (uint32_t c = 0; c < chunkFile.GetChunkCount(); ++c)
+		chunkBytes += GetMeshChunkBytes(chunkFile.GetChunk(c));
+	bool readAll = true;
+	bool wellFormed = true;
+	for (uint32_t frame = 0; frame < frameCount && readAll; ++frame)
+	{
+		const float t = 2.0f * float(frame) / frameCount;
+		const float along = t <= 1.0f ? t : 2.0f - t;
+		const float sway = sinf(t * 3.0f * kPi);
+		const MeshFloat3 eye = { bounds.min.x + (0.5f + 0.4f * sway) * (bounds.max.x - bounds.min.x), bounds.max.y + 20.0f,
+			bounds.min.z + along * (bounds.max.z - bounds.min.z) };
+		const MeshFloat3 at = { eye.x + 10.0f * cosf(t * kPi), bounds.min.y, eye.z + (t <= 1.0f ? 60.0f : -60.0f) };
+		float viewProjection[16];
+		BuildViewProjection(eye, at, viewProjection);
+		pager.Update(ComputeMeshClusterView(viewProjection, eye), loads, evictions);
+
+		evictionCount += evictions.size();
+		for (uint32_t c : evictions)
+		{
+			heldBytes -= vertexData[c].size() + indexData[c].size();
+			std::vector<uint8_t>().swap(vertexData[c]);
+			std::vector<uint8_t>().swap(indexData[c]);
+		}
+		for (uint32_t c : loads)
+		{
+			const MeshChunk& chunk = chunkFile.GetChunk(c);
+			vertexData[c].resize(static_cast<size_t>(chunk.vertexCount) * GetMeshVertexStride(static_cast<MeshVertexFormat>(chunk.vertexFormat)));
+			indexData[c].resize(static_cast<size_t>(chunk.indexCount) * chunk.indexSize);
+			readAll = chunkFile.ReadChunk(c, vertexData[c].data(), indexData[c].data());
+			wellFormed = wellFormed && readAll && ChunkWellFormed(chunk, indexData[c]);
+			heldBytes += vertexData[c].size() + indexData[c].size();
+			++loadCount;
+		}
+		peakHeld = std::max(peakHeld, heldBytes);
+		peakResident = std::max(peakResident, pager.GetResidentBytes());
+
+		DX::ProcessMemory memory;
+		if (measured && DX::QueryProcessMemory(memory) && memory.currentBytes > baseline.currentBytes)
+			peakStreaming = std::max(peakStreaming, memory.currentBytes - baseline.currentBytes);
+	}
+	chunkFile.Close();
+	DX::RemoveFile(chunkPath.c_str());
+
+	snprintf(detail, sizeof(detail), "\"frames\": %u, \"chunkMegabytes\": %.1f, \"loads\": %llu, \"evictions\": %llu, \"residentMegabytes\": %llu, "
+		"\"peakResidentMegabytes\": %.1f, \"peakHeldMegabytes\": %.1f", frameCount, Megabytes(chunkBytes), static_cast<unsigned long long>(loadCount),
+		static_cast<unsigned long long>(evictionCount), static_cast<unsigned long long>(residentMegabytes), Megabytes(peakResident), Megabytes(peakHeld));
+	Check("every chunk read back is well formed", readAll && wellFormed && loadCount > 0, "");
+	Check("resident chunks stay under the resident budget", peakResident <= residentBytes && peakHeld <= residentBytes, detail);
+	// A mesh whose chunks all fit never tests the cap.
+	if (chunkBytes > residentBytes)
+		Check("pager evicts to stay under the resident budget", evictionCount > 0, "");
+	if (measured)
+	{
+		snprintf(detail, sizeof(detail), "\"peakMegabytes\": %.1f, \"capMegabytes\": %.1f", Megabytes(peakStreaming), Megabytes(residentBytes + kSlackBytes));
+		Check("streaming memory stays under the resident budget", peakStreaming <= residentBytes + kSlackBytes, detail);
+	}
+	printf("\n\t],\n\t\"failures\": %u\n}\n", g_failures);
+	return g_failures ? 1 : 0;
+}
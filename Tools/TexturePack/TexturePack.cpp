@@ -0,0 +1,241 @@
+﻿// Packs DDS textures that share a format into atlases and texture arrays, writes each page as a
+// DDS file and a lookup table the renderer finds each texture's page, slice and uv remapping in,
+// then prints JSON with the pages, how full they are and the texture binds they save. It builds
+// anywhere the packer does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o TexturePack Tools/TexturePack/TexturePack.cpp
+//       DX11UWA/Common/{TexturePacker,BCEncoder,BCDecoder,DDSFile,MappedFile,CompressedFile,FileIO}.cpp -lz
+//
+// run from the repository root, all on one line.
+//
+// Usage: TexturePack [--layout atlas|array|auto] [--max-size texels] [--guard texels] [--mips count]
+//        table.tpk texture.dds...
+// The default layout is auto, the largest atlas side 4096, the guard 16 texels and the mips as many
+// as each page allows. Pages are written next to the table as table.0.dds, table.1.dds and so on,
+// and both pages and textures are named in the table by the paths given, so run it from where the
+// renderer loads its assets. Textures that cannot be packed or share a page with nothing else are
+// listed and drawn from their own files. Inputs may be gzip or zstd compressed. The exit code is 1
+// when a texture cannot be read or a page or the table written, and 2 for bad arguments.
+
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+#include "Common/TexturePacker.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kLayoutNames[TEXTURE_PACK_LAYOUT_COUNT] = { "atlas", "array", "auto" };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	// The whole file, decompressed when it is gzip or zstd.
+	bool ReadTexture(const char* path, MappedFile& file, std::vector<uint8_t>& decompressed, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+
+		outData = file.GetData();
+		outSize = static_cast<size_t>(file.GetSize());
+		if (DetectCompression(outData, outSize) == COMPRESSION_NONE)
+			return true;
+
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(outData, outSize) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK || desc.dataSize > SIZE_MAX - desc.headerSize)
+			return false;
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return false;
+		outData = decompressed.data();
+		outSize = decompressed.size();
+		return true;
+	}
+
+	bool WriteTexture(const char* path, const uint8_t* header, uint32_t headerSize, const std::vector<uint8_t>& bits)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(bits.data(), 1, bits.size(), file) == bits.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	// table.tpk gives table.<page>.dds.
+	std::string GetPagePath(const char* tablePath, uint32_t page)
+	{
+		std::string base(tablePath);
+		const size_t dot = base.find_last_of('.');
+		const size_t slash = base.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			base.resize(dot);
+		return base + "." + std::to_string(page) + ".dds";
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: TexturePack [--layout atlas|array|auto] [--max-size texels] [--guard texels] [--mips count] table.tpk texture.dds...\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	TexturePackOptions options;
+	options.layout = TEXTURE_PACK_AUTO;
+	options.maxSize = TEXTURE_PACK_DEFAULT_MAX_SIZE;
+	options.guard = TEXTURE_PACK_DEFAULT_GUARD;
+	options.mipCount = 0;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			options.layout = TEXTURE_PACK_LAYOUT_COUNT;
+			for (int l = 0; l < TEXTURE_PACK_LAYOUT_COUNT; ++l)
+				options.layout = strcmp(name, kLayoutNames[l]) == 0 ? static_cast<TexturePackLayout>(l) : options.layout;
+			if (options.layout == TEXTURE_PACK_LAYOUT_COUNT)
+				return Usage();
+		}
+		else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0 || value > 16384)
+				return Usage();
+			options.maxSize = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--guard") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value < 0 || value > 1024)
+				return Usage();
+			options.guard = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			options.mipCount = static_cast<uint32_t>(value);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() < 2)
+		return Usage();
+
+	const uint32_t sourceCount = static_cast<uint32_t>(paths.size() - 1);
+	std::vector<std::unique_ptr<MappedFile>> files(sourceCount);
+	std::vector<std::vector<uint8_t>> decompressed(sourceCount);
+	std::vector<TexturePackSource> sources(sourceCount);
+	for (uint32_t i = 0; i < sourceCount; ++i)
+	{
+		files[i].reset(new MappedFile);
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		if (!ReadTexture(paths[i + 1], *files[i], decompressed[i], data, size) || ValidateDDS(data, size, sources[i].desc) != DDS_OK)
+			return Fail(paths[i + 1], "not a valid texture");
+		sources[i].bits = data + sources[i].desc.headerSize;
+	}
+
+	std::vector<TexturePackPage> pages;
+	std::vector<TexturePackEntry> entries;
+	const auto start = std::chrono::steady_clock::now();
+	if (PackTextures(sources.data(), sourceCount, options, pages, entries) != DDS_OK)
+		return Usage();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<std::string> pagePaths;
+	std::vector<const char*> pageNames;
+	for (uint32_t page = 0; page < pages.size(); ++page)
+		pagePaths.push_back(GetPagePath(paths[0], page));
+	for (uint32_t page = 0; page < pages.size(); ++page)
+	{
+		uint8_t header[DDS_MAX_HEADER_SIZE];
+		const uint32_t headerSize = WriteDDSHeader(pages[page].desc, header);
+		if (!WriteTexture(pagePaths[page].c_str(), header, headerSize, pages[page].bits))
+			return Fail(pagePaths[page].c_str(), "could not write");
+		pageNames.push_back(pagePaths[page].c_str());
+	}
+	if (!WriteTexturePackTable(paths[0], pages.data(), pageNames.data(), static_cast<uint32_t>(pages.size()), entries.data(), paths.data() + 1, sourceCount))
+		return Fail(paths[0], "could not write");
+
+	// Objects drawn back to back from one page bind it once instead of binding each texture.
+	uint32_t packedCount = 0;
+	for (const TexturePackEntry& entry : entries)
+		packedCount += entry.page != TEXTURE_PACK_NONE ? 1 : 0;
+	printf("{\n\t\"table\": %s, \"layout\": \"%s\", \"maxSize\": %u, \"guard\": %u, \"textures\": %u, \"packed\": %u, \"bindsSaved\": %u, \"seconds\": %.6f,\n",
+		JsonString(paths[0]).c_str(), kLayoutNames[options.layout], options.maxSize, options.guard, sourceCount, packedCount,
+		packedCount - static_cast<uint32_t>(pages.size()), seconds);
+	printf("\t\"pages\": [\n");
+	for (uint32_t page = 0; page < pages.size(); ++page)
+	{
+		const DDSTextureDesc& desc = pages[page].desc;
+		printf("\t\t{ \"path\": %s, \"layout\": \"%s\", \"format\": %u, \"width\": %u, \"height\": %u, \"mips\": %u, \"arraySize\": %u, \"textures\": %u, "
+			"\"occupancy\": %.4f, \"bytes\": %llu }%s\n", JsonString(pagePaths[page].c_str()).c_str(), kLayoutNames[pages[page].layout],
+			static_cast<unsigned int>(desc.format), desc.width, desc.height, desc.mipCount, desc.arraySize, pages[page].sourceCount,
+			static_cast<double>(pages[page].sourceTexels) / (static_cast<double>(desc.width) * desc.height * desc.arraySize),
+			static_cast<unsigned long long>(desc.headerSize + desc.dataSize), page + 1 < pages.size() ? "," : "");
+	}
+	printf("\t],\n\t\"entries\": [\n");
+	for (uint32_t i = 0; i < sourceCount; ++i)
+	{
+		const TexturePackEntry& entry = entries[i];
+		if (entry.page == TEXTURE_PACK_NONE)
+			printf("\t\t{ \"path\": %s, \"page\": null }", JsonString(paths[i + 1]).c_str());
+		else
+			printf("\t\t{ \"path\": %s, \"page\": %u, \"slice\": %u, \"x\": %u, \"y\": %u, \"uvScaleOffset\": [%.9g, %.9g, %.9g, %.9g] }",
+				JsonString(paths[i + 1]).c_str(), entry.page, entry.slice, entry.x, entry.y, entry.uvScaleOffset[0], entry.uvScaleOffset[1],
+				entry.uvScaleOffset[2], entry.uvScaleOffset[3]);
+		printf("%s\n", i + 1 < sourceCount ? "," : "");
+	}
+	printf("\t]\n}\n");
+	return 0;
+}
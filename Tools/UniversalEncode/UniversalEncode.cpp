@@ -0,0 +1,275 @@
+﻿// Supercompresses an RGBA8 DDS texture into the universal container the renderer transcodes to
+// BC1, BC3 or BC7 as it loads, and prints JSON with its size against the BC texture it stands
+// for, then the rate and PSNR of transcoding it to each format, so size and quality can be
+// weighed per texture. It builds anywhere the encoder does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o UniversalEncode Tools/UniversalEncode/UniversalEncode.cpp
+//       DX11UWA/Common/{UniversalTexture,BCEncoder,BCDecoder,DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: UniversalEncode [--target bc1|bc3|bc7] [--quality 1-255] [--threads count] input.dds output.utx
+// The default target is bc3 for textures with alpha and bc1 without, the quality 128 and threads
+// one a core. Higher qualities give larger codebooks, so better colour and larger files. Every
+// mip and array slice is encoded; the input may be gzip or zstd compressed and in any 8 bit RGBA
+// or BGRA format, and sRGB stays sRGB. Transcode rates count the texels of every subresource
+// over one run on all threads; UniversalTranscode measures them properly. PSNR compares the
+// decoded blocks with the input over RGB and over alpha. The exit code is 1 when the input cannot
+// be read or encoded or the output written, and 2 for bad arguments.
+
+#include "Common/BCDecoder.h"
+#include "Common/BCEncoder.h"
+#include "Common/CompressedFile.h"
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+#include "Common/UniversalTexture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kFormatNames[BC_FORMAT_COUNT] = { "bc1", "bc3", "bc7" };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	// How an input format's texels map to RGBA8: whether red and blue are swapped and whether
+	// alpha is ignored.
+	bool GetSourceLayout(DXGI_FORMAT format, bool& outSwapRB, bool& outOpaque, bool& outSRGB)
+	{
+		outSwapRB = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		outOpaque = format == DXGI_FORMAT_B8G8R8X8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		outSRGB = format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+		return outSwapRB || format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	}
+
+	// The whole file, decompressed when it is gzip or zstd.
+	bool ReadTexture(const char* path, MappedFile& file, std::vector<uint8_t>& decompressed, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path) || file.GetSize() > SIZE_MAX)
+			return false;
+
+		outData = file.GetData();
+		outSize = static_cast<size_t>(file.GetSize());
+		if (DetectCompression(outData, outSize) == COMPRESSION_NONE)
+			return true;
+
+		CompressedFile stream;
+		DDSTextureDesc desc;
+		decompressed.resize(DDS_MAX_HEADER_SIZE);
+		if (!stream.Open(outData, outSize) || ReadDDSHeader(stream, decompressed.data(), desc) != DDS_OK || desc.dataSize > SIZE_MAX - desc.headerSize)
+			return false;
+		decompressed.resize(desc.headerSize + static_cast<size_t>(desc.dataSize));
+		if (!stream.ReadAll(decompressed.data() + desc.headerSize, static_cast<size_t>(desc.dataSize)))
+			return false;
+		outData = decompressed.data();
+		outSize = decompressed.size();
+		return true;
+	}
+
+	bool WriteFile(const char* path, const std::vector<uint8_t>& bytes)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	double GetPsnr(double squaredError, uint64_t samples)
+	{
+		return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+	}
+
+	// Lossless channels have no finite PSNR and are printed as null.
+	std::string FormatPsnr(double squaredError, uint64_t samples)
+	{
+		char text[32] = "null";
+		if (squaredError > 0.0)
+			snprintf(text, sizeof(text), "%.3f", GetPsnr(squaredError, samples));
+		return text;
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: UniversalEncode [--target bc1|bc3|bc7] [--quality 1-255] [--threads count] input.dds output.utx\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UniversalTextureOptions options;
+	options.target = BC_FORMAT_COUNT;
+	options.quality = UNIVERSAL_TEXTURE_DEFAULT_QUALITY;
+	options.threadCount = 0;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			options.target = BC_FORMAT_COUNT;
+			for (int f = 0; f < BC_FORMAT_COUNT; ++f)
+				options.target = strcmp(name, kFormatNames[f]) == 0 ? static_cast<BCFormat>(f) : options.target;
+			if (options.target == BC_FORMAT_COUNT)
+				return Usage();
+		}
+		else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value < 1 || value > 255)
+				return Usage();
+			options.quality = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			options.threadCount = static_cast<unsigned int>(value);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2)
+		return Usage();
+
+	MappedFile file;
+	std::vector<uint8_t> decompressed;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	DDSTextureDesc desc;
+	if (!ReadTexture(paths[0], file, decompressed, data, size) || ValidateDDS(data, size, desc) != DDS_OK)
+		return Fail(paths[0], "not a valid texture");
+
+	bool swapRB = false;
+	bool opaque = false;
+	bool srgb = false;
+	if (!GetSourceLayout(desc.format, swapRB, opaque, srgb) || desc.dimension != DDS_DIMENSION_TEXTURE2D)
+		return Fail(paths[0], "not an 8 bit RGBA 2D texture");
+
+	// The same layout as RGBA8, as every input format has 4 bytes a texel
+	DDSTextureDesc rgbaDesc = desc;
+	rgbaDesc.format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	std::vector<DDSSubresource> layout(desc.mipCount * desc.arraySize);
+	ComputeDDSLayout(rgbaDesc, layout.data());
+	std::vector<uint8_t> rgba(static_cast<size_t>(desc.dataSize));
+	const uint8_t* source = data + desc.headerSize;
+	for (size_t t = 0; t < rgba.size(); t += 4)
+	{
+		rgba[t] = source[t + (swapRB ? 2 : 0)];
+		rgba[t + 1] = source[t + 1];
+		rgba[t + 2] = source[t + (swapRB ? 0 : 2)];
+		rgba[t + 3] = opaque ? 255 : source[t + 3];
+	}
+
+	std::vector<uint8_t> encoded;
+	auto start = std::chrono::steady_clock::now();
+	if (EncodeUniversalTexture(rgbaDesc, rgba.data(), options, encoded) != DDS_OK)
+		return Fail(paths[0], "could not be encoded");
+	const double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!WriteFile(paths[1], encoded))
+		return Fail(paths[1], "could not write");
+
+	UniversalTextureHeader header;
+	memcpy(&header, encoded.data(), sizeof(header));
+	DDSTextureDesc targetDesc;
+	ParseUniversalTexture(encoded.data(), encoded.size(), targetDesc);
+	uint64_t texelCount = 0;
+	for (const DDSSubresource& subresource : layout)
+		texelCount += static_cast<uint64_t>(subresource.width) * subresource.height;
+
+	printf("{\n\t\"input\": %s, \"output\": %s,\n", JsonString(paths[0]).c_str(), JsonString(paths[1]).c_str());
+	printf("\t\"target\": \"%s\", \"width\": %u, \"height\": %u, \"mips\": %u, \"arraySize\": %u, \"alpha\": %s, \"quality\": %u,\n",
+		kFormatNames[header.target], desc.width, desc.height, desc.mipCount, desc.arraySize, (header.flags & UNIVERSAL_TEXTURE_ALPHA) ? "true" : "false",
+		options.quality);
+	printf("\t\"codebooks\": { \"endpoints\": %u, \"selectors\": %u, \"alphaEndpoints\": %u, \"alphaSelectors\": %u, \"bytes\": %u }, \"slices\": %u,\n",
+		header.endpointCount, header.selectorCount, header.alphaEndpointCount, header.alphaSelectorCount, header.codebookBytes, header.sliceCount);
+	printf("\t\"inputBytes\": %llu, \"targetBytes\": %llu, \"outputBytes\": %llu, \"ratio\": %.2f, \"bitsPerTexel\": %.3f,\n",
+		static_cast<unsigned long long>(desc.dataSize), static_cast<unsigned long long>(targetDesc.dataSize), static_cast<unsigned long long>(encoded.size()),
+		static_cast<double>(targetDesc.dataSize) / encoded.size(), encoded.size() * 8.0 / texelCount);
+	printf("\t\"encodeSeconds\": %.6f,\n\t\"transcode\": {\n", encodeSeconds);
+
+	std::vector<uint8_t> transcoded;
+	std::vector<uint8_t> decoded;
+	for (int f = 0; f < BC_FORMAT_COUNT; ++f)
+	{
+		start = std::chrono::steady_clock::now();
+		const unsigned int threadsUsed = TranscodeUniversalTexture(encoded.data(), encoded.size(), static_cast<BCFormat>(f), 0, transcoded, options.threadCount);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		DDSTextureDesc outDesc;
+		if (threadsUsed == 0 || ValidateDDS(transcoded.data(), transcoded.size(), outDesc) != DDS_OK)
+			return Fail(paths[1], "could not be transcoded");
+
+		// Only the texels inside each image count, not the edge copies padding its last blocks
+		std::vector<DDSSubresource> outLayout(layout.size());
+		ComputeDDSLayout(outDesc, outLayout.data());
+		double colorError = 0.0;
+		double alphaError = 0.0;
+		for (size_t s = 0; s < layout.size(); ++s)
+		{
+			const DDSSubresource& in = layout[s];
+			decoded.resize(static_cast<size_t>(in.width) * in.height * 4);
+			DecodeBCImage(outDesc.format, transcoded.data() + outDesc.headerSize + outLayout[s].offset, in.width, in.height, decoded.data(),
+				static_cast<size_t>(in.width) * 4);
+			const uint8_t* original = rgba.data() + in.offset;
+			for (size_t t = 0; t < decoded.size(); t += 4)
+			{
+				for (int c = 0; c < 3; ++c)
+					colorError += (decoded[t + c] - original[t + c]) * (decoded[t + c] - original[t + c]);
+				alphaError += (decoded[t + 3] - original[t + 3]) * (decoded[t + 3] - original[t + 3]);
+			}
+		}
+		printf("\t\t\"%s\": { \"threads\": %u, \"seconds\": %.6f, \"megapixelsPerSecond\": %.2f, \"psnr\": { \"rgb\": %s, \"alpha\": %s } }%s\n",
+			kFormatNames[f], threadsUsed, seconds, seconds > 0.0 ? texelCount / seconds / 1e6 : 0.0, FormatPsnr(colorError, texelCount * 3).c_str(),
+			FormatPsnr(alphaError, texelCount).c_str(), f + 1 < BC_FORMAT_COUNT ? "," : "");
+	}
+	printf("\t}\n}\n");
+	return 0;
+}
@@ -0,0 +1,179 @@
+﻿// Transcodes a universal texture container to a BC1, BC3 or BC7 DDS file, as TextureStreamer
+// does when it loads one, and prints JSON with the best transcode rate of a number of runs, so
+// how it scales with threads can be measured on any machine. It builds anywhere the transcoder
+// does, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -IDX11UWA -o UniversalTranscode Tools/UniversalTranscode/UniversalTranscode.cpp
+//       DX11UWA/Common/{UniversalTexture,BCEncoder,DDSFile,MappedFile,CompressedFile,FileIO}.cpp
+//
+// run from the repository root, all on one line.
+//
+// Usage: UniversalTranscode [--format bc1|bc3|bc7] [--skip-mips count] [--threads count] [--runs count]
+//        input.utx output.dds
+// The default format is the one the container was encoded for, threads one a core and runs 10.
+// --skip-mips leaves out the largest mips, as streaming in at a lower resolution does. Megapixels
+// and megabytes a second count the texels and BC bytes written over the best run's time. Check
+// the output's quality with BCDecode --reference. The exit code is 1 when the input cannot be read
+// or transcoded or the output written, and 2 for bad arguments.
+
+#include "Common/DDSFile.h"
+#include "Common/FileIO.h"
+#include "Common/MappedFile.h"
+#include "Common/UniversalTexture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const char* const kFormatNames[BC_FORMAT_COUNT] = { "bc1", "bc3", "bc7" };
+
+	std::string JsonString(const char* text)
+	{
+		std::string out = "\"";
+		for (const char* c = text; *c; ++c)
+		{
+			unsigned char value = static_cast<unsigned char>(*c);
+			if (value == '"' || value == '\\')
+			{
+				out += '\\';
+				out += *c;
+			}
+			else if (value < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", value);
+				out += escaped;
+			}
+			else
+			{
+				out += *c;
+			}
+		}
+		return out + "\"";
+	}
+
+	bool WriteFile(const char* path, const std::vector<uint8_t>& bytes)
+	{
+		FILE* file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	int Fail(const char* path, const char* error)
+	{
+		printf("{\n\t\"path\": %s, \"error\": \"%s\"\n}\n", JsonString(path).c_str(), error);
+		return 1;
+	}
+
+	int Usage(void)
+	{
+		fprintf(stderr, "usage: UniversalTranscode [--format bc1|bc3|bc7] [--skip-mips count] [--threads count] [--runs count] input.utx output.dds\n");
+		return 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BCFormat format = BC_FORMAT_COUNT;
+	uint32_t skipMip = 0;
+	unsigned int threadCount = 0;
+	uint32_t runCount = 10;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			format = BC_FORMAT_COUNT;
+			for (int f = 0; f < BC_FORMAT_COUNT; ++f)
+				format = strcmp(name, kFormatNames[f]) == 0 ? static_cast<BCFormat>(f) : format;
+			if (format == BC_FORMAT_COUNT)
+				return Usage();
+		}
+		else if (strcmp(argv[i], "--skip-mips") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value < 0)
+				return Usage();
+			skipMip = static_cast<uint32_t>(value);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			threadCount = static_cast<unsigned int>(value);
+		}
+		else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+		{
+			const long value = strtol(argv[++i], nullptr, 10);
+			if (value <= 0)
+				return Usage();
+			runCount = static_cast<uint32_t>(value);
+		}
+		else if (argv[i][0] == '-')
+		{
+			return Usage();
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2)
+		return Usage();
+
+	MappedFile file;
+	DDSTextureDesc desc;
+	if (!file.Open(paths[0]) || file.GetSize() > SIZE_MAX || ParseUniversalTexture(file.GetData(), static_cast<size_t>(file.GetSize()), desc) != DDS_OK)
+		return Fail(paths[0], "not a valid universal texture");
+	if (skipMip >= desc.mipCount)
+		return Usage();
+
+	// The best run, so that the first one's page faults and thread start-up do not count
+	std::vector<uint8_t> transcoded;
+	double bestSeconds = -1.0;
+	unsigned int threadsUsed = 0;
+	for (uint32_t run = 0; run < runCount; ++run)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		threadsUsed = TranscodeUniversalTexture(file.GetData(), static_cast<size_t>(file.GetSize()), format, skipMip, transcoded, threadCount);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (threadsUsed == 0)
+			return Fail(paths[0], "could not be transcoded");
+		bestSeconds = bestSeconds < 0.0 ? seconds : std::min(bestSeconds, seconds);
+	}
+	if (!WriteFile(paths[1], transcoded))
+		return Fail(paths[1], "could not write");
+
+	DDSTextureDesc outDesc;
+	ValidateDDS(transcoded.data(), transcoded.size(), outDesc);
+	std::vector<DDSSubresource> layout(outDesc.mipCount * outDesc.arraySize);
+	ComputeDDSLayout(outDesc, layout.data());
+	uint64_t texelCount = 0;
+	for (const DDSSubresource& subresource : layout)
+		texelCount += static_cast<uint64_t>(subresource.width) * subresource.height;
+
+	UniversalTextureHeader header;
+	memcpy(&header, file.GetData(), sizeof(header));
+	const BCFormat written = format != BC_FORMAT_COUNT ? format : static_cast<BCFormat>(header.target);
+	printf("{\n\t\"input\": %s, \"output\": %s,\n", JsonString(paths[0]).c_str(), JsonString(paths[1]).c_str());
+	printf("\t\"format\": \"%s\", \"dxgiFormat\": %u, \"width\": %u, \"height\": %u, \"mips\": %u, \"arraySize\": %u, \"skippedMips\": %u,\n",
+		kFormatNames[written], static_cast<unsigned int>(outDesc.format), outDesc.width, outDesc.height, outDesc.mipCount, outDesc.arraySize, skipMip);
+	printf("\t\"inputBytes\": %llu, \"outputBytes\": %llu, \"ratio\": %.2f,\n", static_cast<unsigned long long>(file.GetSize()),
+		static_cast<unsigned long long>(outDesc.dataSize), static_cast<double>(outDesc.dataSize) / file.GetSize());
+	printf("\t\"threads\": %u, \"runs\": %u, \"texels\": %llu, \"seconds\": %.6f, \"megapixelsPerSecond\": %.2f, \"megabytesPerSecond\": %.2f\n}\n",
+		threadsUsed, runCount, static_cast<unsigned long long>(texelCount), bestSeconds, bestSeconds > 0.0 ? texelCount / bestSeconds / 1e6 : 0.0,
+		bestSeconds > 0.0 ? outDesc.dataSize / bestSeconds / (1024.0 * 1024.0) : 0.0);
+	return 0;
+}